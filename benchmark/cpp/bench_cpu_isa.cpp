@@ -0,0 +1,103 @@
+// Host kernels at every CPU instruction set level this machine supports.
+//
+// Times rmsnorm, int8 and fp8 scaled_mm at decode and prefill sizes, with the
+// level forced through lk_set_cpu_isa; "scalar" is the portable baseline.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_cpu_isa [threads]
+#include "core/lightllm_c.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+const char* const kIsas[] = {"scalar", "avx2", "avx512", "avx512_bf16", "amx"};
+
+lk_tensor_t make_tensor(void* data, lk_dtype_t dtype, std::initializer_list<int64_t> shape) {
+    lk_tensor_t t;
+    std::memset(&t, 0, sizeof(t));
+    t.data = data;
+    t.dtype = dtype;
+    t.ndim = static_cast<int32_t>(shape.size());
+    int32_t d = 0;
+    for (int64_t s : shape) t.shape[d++] = s;
+    int64_t stride = 1;
+    for (d = t.ndim - 1; d >= 0; d--) {
+        t.strides[d] = stride;
+        stride *= t.shape[d];
+    }
+    t.device_type = LK_DEVICE_CPU;
+    return t;
+}
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+template <typename F>
+double us_per_call(const int64_t iters, const F& f) {
+    f();
+    const auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < iters; i++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iters;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1) check(lk_set_num_threads(std::atoi(argv[1])));
+    const char* detected = lk_get_cpu_isa(1);
+    std::printf("detected %s, %d threads\n", detected, lk_get_num_threads());
+
+    std::mt19937 rng(0);
+    const int64_t N = 4096, K = 4096;
+    std::vector<int8_t> b(N * K);
+    for (auto& x : b) x = static_cast<int8_t>(rng() % 255 - 127);
+    // bytes that are valid fp8_e4m3 values of moderate magnitude
+    std::vector<uint8_t> b8(N * K);
+    for (auto& x : b8) x = static_cast<uint8_t>(rng() % 0x50 | (rng() & 0x80));
+    std::vector<float> b_scales(N, 0.01f), w(N, 1.0f);
+
+    std::printf("%12s %14s %8s %12s %12s\n", "isa", "op", "M", "us", "GOPS");
+    for (const char* isa : kIsas) {
+        check(lk_set_cpu_isa(isa));
+        for (const int64_t M : {1, 16, 256}) {
+            std::vector<int8_t> a(M * K, 3);
+            std::vector<uint8_t> a8(M * K, 0x38);
+            std::vector<float> a_scales(M, 0.01f), x(M * N, 0.5f), y(M * N);
+            const int64_t iters = M == 256 ? 5 : 50;
+
+            lk_tensor_t X = make_tensor(x.data(), LK_DTYPE_FLOAT32, {M, N});
+            lk_tensor_t W = make_tensor(w.data(), LK_DTYPE_FLOAT32, {N});
+            lk_tensor_t Y = make_tensor(y.data(), LK_DTYPE_FLOAT32, {M, N});
+            const double norm = us_per_call(iters * 100, [&] { check(lk_rmsnorm(&X, &W, &Y, 1e-6f)); });
+            std::printf("%12s %14s %8lld %12.2f %12s\n", isa, "rmsnorm", (long long)M, norm, "-");
+
+            for (const bool fp8 : {false, true}) {
+                const lk_dtype_t dt = fp8 ? LK_DTYPE_FP8_E4M3 : LK_DTYPE_INT8;
+                lk_tensor_t A = make_tensor(fp8 ? (void*)a8.data() : (void*)a.data(), dt, {M, K});
+                // [K, N] column major
+                lk_tensor_t B = make_tensor(fp8 ? (void*)b8.data() : (void*)b.data(), dt, {K, N});
+                B.strides[0] = 1;
+                B.strides[1] = K;
+                lk_tensor_t AS = make_tensor(a_scales.data(), LK_DTYPE_FLOAT32, {M, 1});
+                lk_tensor_t BS = make_tensor(b_scales.data(), LK_DTYPE_FLOAT32, {N, 1});
+                lk_tensor_t C = make_tensor(y.data(), LK_DTYPE_FLOAT32, {M, N});
+                const double us = us_per_call(iters, [&] { check(lk_scaled_mm(&C, &A, &B, &AS, &BS, nullptr, nullptr)); });
+                std::printf("%12s %14s %8lld %12.1f %12.1f\n", isa, fp8 ? "scaled_mm_fp8" : "scaled_mm_int8",
+                            (long long)M, us, 2.0 * M * N * K / us * 1e-3);
+            }
+        }
+        if (std::strcmp(isa, detected) == 0) break;
+    }
+    return 0;
+}
@@ -0,0 +1,580 @@
+// One transformer decoder layer composed from the core library ops, end to end.
+//
+// Runs decode steps of a layer on the CPU backend with int8 weights and an
+// int8 KV cache, stage by stage on the same buffers, so cache reuse between
+// ops and the gaps around them are part of the step time:
+//
+//   attn_norm   lk_add_norm_quant (residual add + RMSNorm + per token int8 quant)
+//   qkv         lk_scaled_mm (+ bias for Qwen2.5, + the q_lora GEMM for MLA)
+//   rope_kv     rotary embedding of q / k, group-8 int8 store into the KV cache
+//   attention   lk_decode_attention over the int8 cache
+//   o_proj      per token int8 quant + lk_scaled_mm
+//   ffn_norm    lk_add_norm_quant
+//   dense MLP   gate_up (lk_scaled_mm), act (silu(g) * u + quant), down (lk_scaled_mm)
+//   MoE         router (lk_scaled_mm), topk (grouped top-k), shared and routed
+//               expert FFNs (lk_scaled_mm per expert), weighted combine
+//
+// Stages without a core op (quantization, rope, KV store,
+// routing, activation) are plain host loops here, timed like the rest.
+// Traffic counts weights, KV and activations read or written once per step,
+// so GB/s is the effective bandwidth of a stage.
+//
+// DeepSeek-V3 attention is MLA in its absorbed decode form: one 576 wide
+// latent KV head (K = V) shared by 128 query heads, W_UK folded into q_b.
+// W_UV is not modeled, o_proj reads the first 128 lanes of every head. MoE
+// layers allocate weights only for as many experts as a step can route to.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_decoder_layer [model|all] [batch] [context] [steps] [threads]
+#include "core/lightllm_c.h"
+#include "core/host_float.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using lightllm::core::from_float;
+using lightllm::core::host_bf16_t;
+using lightllm::core::to_float;
+
+struct ModelConfig {
+    const char* name;
+    int64_t hidden;
+    int64_t heads;
+    int64_t kv_heads;
+    int64_t head_dim;
+    int64_t v_head_dim;    // lanes of every head o_proj reads
+    int64_t rope_dim;      // trailing lanes of every q / k head that are rotated
+    int64_t q_lora_rank;   // 0: q comes out of the fused qkv GEMM
+    bool qkv_bias;
+    int64_t intermediate;  // of the dense MLP, or of one expert
+    int64_t experts;       // 0: dense MLP
+    int64_t topk;
+    int64_t n_group;
+    int64_t topk_group;
+    int64_t shared_experts;
+};
+
+const ModelConfig kModels[] = {
+    {"llama3-8b", 4096, 32, 8, 128, 128, 128, 0, false, 14336, 0, 0, 0, 0, 0},
+    {"llama3-70b", 8192, 64, 8, 128, 128, 128, 0, false, 28672, 0, 0, 0, 0, 0},
+    {"qwen2.5-7b", 3584, 28, 4, 128, 128, 128, 0, true, 18944, 0, 0, 0, 0, 0},
+    {"qwen2.5-72b", 8192, 64, 8, 128, 128, 128, 0, true, 29568, 0, 0, 0, 0, 0},
+    {"deepseek-v3", 7168, 128, 1, 576, 128, 64, 1536, false, 2048, 256, 8, 8, 4, 1},
+};
+
+lk_tensor_t make_tensor(void* data, lk_dtype_t dtype, std::initializer_list<int64_t> shape) {
+    lk_tensor_t t;
+    std::memset(&t, 0, sizeof(t));
+    t.data = data;
+    t.dtype = dtype;
+    t.ndim = static_cast<int32_t>(shape.size());
+    int32_t d = 0;
+    for (int64_t s : shape) t.shape[d++] = s;
+    int64_t stride = 1;
+    for (d = t.ndim - 1; d >= 0; d--) {
+        t.strides[d] = stride;
+        stride *= t.shape[d];
+    }
+    t.device_type = LK_DEVICE_CPU;
+    return t;
+}
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+// xorshift, fast enough to fill gigabytes of weights
+void fill_random(void* data, const int64_t bytes, uint64_t seed) {
+    uint8_t* p = static_cast<uint8_t*>(data);
+    seed |= 1;
+    for (int64_t i = 0; i < bytes; i += 8) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        std::memcpy(p + i, &seed, std::min<int64_t>(8, bytes - i));
+    }
+}
+
+// int8 [K, N] column major weight with per column scales, as cutlass_scaled_mm takes it.
+struct Linear {
+    int64_t K = 0;
+    int64_t N = 0;
+    std::vector<int8_t> w;  // [N][K]
+    std::vector<float> scales;
+    std::vector<host_bf16_t> bias;
+
+    void init(const int64_t k, const int64_t n, const bool with_bias, const uint64_t seed) {
+        K = k;
+        N = n;
+        w.resize(N * K);
+        fill_random(w.data(), N * K, seed);
+        // uniform int8 has a standard deviation of ~74, keep the outputs O(1)
+        scales.assign(N, 1.0f / (74.0f * std::sqrt(static_cast<float>(K))));
+        if (with_bias) bias.assign(N, from_float<host_bf16_t>(0.1f));
+    }
+
+    int64_t bytes() const { return N * K + N * 4 + static_cast<int64_t>(bias.size()) * 2; }
+
+    // c[M, N] = a[M, K] @ w, c bf16 or fp32
+    void run(const int8_t* a, const float* a_scales, const int64_t M, void* c, const lk_dtype_t c_dtype) const {
+        lk_tensor_t A = make_tensor(const_cast<int8_t*>(a), LK_DTYPE_INT8, {M, K});
+        lk_tensor_t B = make_tensor(const_cast<int8_t*>(w.data()), LK_DTYPE_INT8, {K, N});
+        B.strides[0] = 1;
+        B.strides[1] = K;
+        lk_tensor_t AS = make_tensor(const_cast<float*>(a_scales), LK_DTYPE_FLOAT32, {M});
+        lk_tensor_t BS = make_tensor(const_cast<float*>(scales.data()), LK_DTYPE_FLOAT32, {N});
+        lk_tensor_t BIAS = make_tensor(const_cast<host_bf16_t*>(bias.data()), LK_DTYPE_BFLOAT16, {N});
+        lk_tensor_t C = make_tensor(c, c_dtype, {M, N});
+        const bool with_bias = !bias.empty() && c_dtype == LK_DTYPE_BFLOAT16;
+        check(lk_scaled_mm(&C, &A, &B, &AS, &BS, with_bias ? &BIAS : nullptr, nullptr));
+    }
+};
+
+// Per token symmetric int8 of the first `cols` lanes of each of `heads` groups of `stride` lanes.
+template <typename T>
+void quant_rows(const T* x, const int64_t M, const int64_t heads, const int64_t stride, const int64_t cols,
+                const int64_t ldx, int8_t* q, float* scales) {
+    for (int64_t m = 0; m < M; m++) {
+        const T* row = x + m * ldx;
+        float amax = 0.0f;
+        for (int64_t h = 0; h < heads; h++) {
+            for (int64_t j = 0; j < cols; j++) amax = std::max(amax, std::fabs(to_float(row[h * stride + j])));
+        }
+        const float scale = std::max(amax, 1e-6f) / 127.0f;
+        const float inv = 1.0f / scale;
+        int8_t* dst = q + m * heads * cols;
+        for (int64_t h = 0; h < heads; h++) {
+            for (int64_t j = 0; j < cols; j++) {
+                dst[h * cols + j] = static_cast<int8_t>(std::lrintf(to_float(row[h * stride + j]) * inv));
+            }
+        }
+        scales[m] = scale;
+    }
+}
+
+// res += x, then int8 rmsnorm(res) * w, fused in one core op
+void add_norm_quant(host_bf16_t* res, const host_bf16_t* x, const std::vector<host_bf16_t>& w,
+                    const int64_t M, const int64_t N, int8_t* q, float* scales) {
+    lk_tensor_t X = make_tensor(res, LK_DTYPE_BFLOAT16, {M, N});
+    lk_tensor_t R = make_tensor(const_cast<host_bf16_t*>(x), LK_DTYPE_BFLOAT16, {M, N});
+    lk_tensor_t W = make_tensor(const_cast<host_bf16_t*>(w.data()), LK_DTYPE_BFLOAT16, {N});
+    lk_tensor_t Q = make_tensor(q, LK_DTYPE_INT8, {M, N});
+    lk_tensor_t S = make_tensor(scales, LK_DTYPE_FLOAT32, {M});
+    check(lk_add_norm_quant(&X, &R, &W, &Q, &S, 1e-6f));
+}
+
+// neox style rotation of the last rope_dim lanes of one head
+void rope_head(const host_bf16_t* x, host_bf16_t* y, const int64_t D, const int64_t rope_dim,
+               const float* cos_t, const float* sin_t) {
+    const int64_t base = D - rope_dim;
+    const int64_t half = rope_dim / 2;
+    for (int64_t j = 0; j < base; j++) y[j] = x[j];
+    for (int64_t j = 0; j < half; j++) {
+        const float a = to_float(x[base + j]);
+        const float b = to_float(x[base + half + j]);
+        y[base + j] = from_float<host_bf16_t>(a * cos_t[j] - b * sin_t[j]);
+        y[base + half + j] = from_float<host_bf16_t>(b * cos_t[j] + a * sin_t[j]);
+    }
+}
+
+// group-8 int8 of one head into the cache, scales in bf16 like the attention kernels read them
+void store_head(const host_bf16_t* x, const int64_t D, int8_t* dst, host_bf16_t* dst_s) {
+    for (int64_t g = 0; g < D / 8; g++) {
+        float amax = 0.0f;
+        for (int64_t j = 0; j < 8; j++) amax = std::max(amax, std::fabs(to_float(x[g * 8 + j])));
+        const host_bf16_t s = from_float<host_bf16_t>(std::max(amax, 1e-6f) / 127.0f);
+        const float inv = 1.0f / to_float(s);
+        for (int64_t j = 0; j < 8; j++) {
+            const long v = std::lrintf(to_float(x[g * 8 + j]) * inv);
+            dst[g * 8 + j] = static_cast<int8_t>(std::max(-127L, std::min(127L, v)));
+        }
+        dst_s[g] = s;
+    }
+}
+
+float silu(const float x) { return x / (1.0f + std::exp(-x)); }
+
+struct Stage {
+    std::string name;
+    double us = 0.0;
+    double bytes = 0.0;
+};
+
+class Timeline {
+public:
+    template <typename F>
+    void run(const char* name, const double bytes, const F& f) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const auto end = std::chrono::steady_clock::now();
+        if (!recording_) return;
+        Stage* stage = nullptr;
+        for (Stage& s : stages_) {
+            if (s.name == name) stage = &s;
+        }
+        if (stage == nullptr) {
+            stages_.push_back(Stage{name, 0.0, 0.0});
+            stage = &stages_.back();
+        }
+        stage->us += std::chrono::duration<double, std::micro>(end - start).count();
+        stage->bytes += bytes;
+    }
+
+    void record(const bool on) { recording_ = on; }
+
+    void print(const int64_t steps) const {
+        double total_us = 0.0, total_bytes = 0.0;
+        for (const Stage& s : stages_) {
+            total_us += s.us;
+            total_bytes += s.bytes;
+        }
+        std::printf("  %-12s %12s %7s %10s %8s\n", "stage", "us/step", "%", "MB/step", "GB/s");
+        for (const Stage& s : stages_) {
+            std::printf("  %-12s %12.1f %6.1f%% %10.2f %8.2f\n", s.name.c_str(), s.us / steps, 100.0 * s.us / total_us,
+                        s.bytes / steps * 1e-6, s.bytes / s.us * 1e-3);
+        }
+        std::printf("  %-12s %12.1f %6.1f%% %10.2f %8.2f\n", "total", total_us / steps, 100.0, total_bytes / steps * 1e-6,
+                    total_bytes / total_us * 1e-3);
+    }
+
+private:
+    std::vector<Stage> stages_;
+    bool recording_ = false;
+};
+
+class DecoderLayer {
+public:
+    DecoderLayer(const ModelConfig& cfg, const int64_t batch, const int64_t context, const int64_t steps)
+        : cfg_(cfg), B_(batch), max_len_(context + steps) {
+        const int64_t H = cfg.heads, Hkv = cfg.kv_heads, D = cfg.head_dim;
+        const bool mla = cfg.q_lora_rank > 0;
+        uint64_t seed = 1;
+        if (mla) {
+            // hidden -> [q_lora | kv latent], then q_lora -> H heads of the latent width
+            qkv_.init(cfg.hidden, cfg.q_lora_rank + Hkv * D, false, seed++);
+            q_b_.init(cfg.q_lora_rank, H * D, false, seed++);
+        } else {
+            qkv_.init(cfg.hidden, (H + 2 * Hkv) * D, cfg.qkv_bias, seed++);
+        }
+        o_proj_.init(H * cfg.v_head_dim, cfg.hidden, false, seed++);
+        if (cfg.experts == 0) {
+            gate_up_.init(cfg.hidden, 2 * cfg.intermediate, false, seed++);
+            down_.init(cfg.intermediate, cfg.hidden, false, seed++);
+        } else {
+            router_.init(cfg.hidden, cfg.experts, false, seed++);
+            const int64_t shared = cfg.intermediate * cfg.shared_experts;
+            if (shared > 0) {
+                gate_up_.init(cfg.hidden, 2 * shared, false, seed++);
+                down_.init(shared, cfg.hidden, false, seed++);
+            }
+            const int64_t pool = std::min(cfg.experts, B_ * cfg.topk);
+            expert_gate_up_.resize(pool);
+            expert_down_.resize(pool);
+            for (int64_t e = 0; e < pool; e++) {
+                expert_gate_up_[e].init(cfg.hidden, 2 * cfg.intermediate, false, seed++);
+                expert_down_[e].init(cfg.intermediate, cfg.hidden, false, seed++);
+            }
+        }
+        norm_w_.assign(cfg.hidden, from_float<host_bf16_t>(1.0f));
+
+        // KV cache: every request owns random slots of a shared pool, filled up to context
+        const int64_t slots = B_ * max_len_;
+        const int64_t planes = mla ? 1 : 2;
+        k_.resize(slots * Hkv * D);
+        k_s_.assign(slots * Hkv * D / 8, from_float<host_bf16_t>(0.01f));
+        fill_random(k_.data(), static_cast<int64_t>(k_.size()), seed++);
+        if (planes == 2) {
+            v_.resize(k_.size());
+            v_s_ = k_s_;
+            fill_random(v_.data(), static_cast<int64_t>(v_.size()), seed++);
+        }
+        req_to_tokens_.resize(slots);
+        std::iota(req_to_tokens_.begin(), req_to_tokens_.end(), 0);
+        std::shuffle(req_to_tokens_.begin(), req_to_tokens_.end(), std::mt19937(0));
+        b_req_idx_.resize(B_);
+        std::iota(b_req_idx_.begin(), b_req_idx_.end(), 0);
+        b_seq_len_.assign(B_, static_cast<int32_t>(context));
+
+        std::mt19937 rng(0);
+        std::normal_distribution<float> normal;
+        residual_.resize(B_ * cfg.hidden);
+        for (auto& x : residual_) x = from_float<host_bf16_t>(normal(rng));
+        x_.assign(B_ * cfg.hidden, from_float<host_bf16_t>(0.0f));
+        const int64_t widest = std::max({cfg.hidden, qkv_.N, q_b_.N, gate_up_.N, router_.N,
+                                         cfg.experts > 0 ? 2 * cfg.intermediate : int64_t(0)});
+        a8_.resize(B_ * widest);
+        a_s_.resize(B_);
+        qkv_out_.resize(B_ * qkv_.N);
+        q_out_.resize(B_ * q_b_.N);
+        q_.resize(B_ * H * D);
+        o_.resize(B_ * H * D);
+        ffn_.resize(B_ * widest);
+        ffn_a8_.resize(B_ * widest / 2);
+        ffn_a_s_.resize(B_);
+        logits_.resize(B_ * std::max<int64_t>(cfg.experts, 1));
+        acc_.resize(B_ * cfg.hidden);
+        down_out_.resize(B_ * cfg.hidden);
+        inv_freq_.resize(cfg.rope_dim / 2);
+        for (int64_t j = 0; j < cfg.rope_dim / 2; j++) {
+            inv_freq_[j] = std::pow(10000.0f, -2.0f * static_cast<float>(j) / static_cast<float>(cfg.rope_dim));
+        }
+    }
+
+    int64_t weight_bytes() const {
+        int64_t bytes = qkv_.bytes() + q_b_.bytes() + o_proj_.bytes() + gate_up_.bytes() + down_.bytes() + router_.bytes();
+        for (size_t e = 0; e < expert_gate_up_.size(); e++) bytes += expert_gate_up_[e].bytes() + expert_down_[e].bytes();
+        return bytes;
+    }
+
+    void step(Timeline& t) {
+        const ModelConfig& c = cfg_;
+        const int64_t H = c.heads, Hkv = c.kv_heads, D = c.head_dim, hidden = c.hidden;
+        const bool mla = c.q_lora_rank > 0;
+        const double act = static_cast<double>(B_ * hidden) * 2;
+
+        t.run("attn_norm", 3 * act + B_ * hidden, [&] {
+            add_norm_quant(residual_.data(), x_.data(), norm_w_, B_, hidden, a8_.data(), a_s_.data());
+        });
+
+        t.run("qkv", qkv_.bytes() + q_b_.bytes() + B_ * (hidden + 2 * qkv_.N + q_b_.K + 2 * q_b_.N), [&] {
+            qkv_.run(a8_.data(), a_s_.data(), B_, qkv_out_.data(), LK_DTYPE_BFLOAT16);
+            if (mla) {
+                quant_rows(qkv_out_.data(), B_, 1, c.q_lora_rank, c.q_lora_rank, qkv_.N, a8_.data(), a_s_.data());
+                q_b_.run(a8_.data(), a_s_.data(), B_, q_out_.data(), LK_DTYPE_BFLOAT16);
+            }
+        });
+
+        const int64_t kv_planes = mla ? 1 : 2;
+        t.run("rope_kv", B_ * ((H + kv_planes * Hkv) * D * 4.0 + kv_planes * Hkv * D / 8 * 2), [&] {
+            std::vector<float> cos_t(c.rope_dim / 2), sin_t(c.rope_dim / 2);
+            for (int64_t b = 0; b < B_; b++) {
+                const int32_t pos = b_seq_len_[b];
+                for (int64_t j = 0; j < c.rope_dim / 2; j++) {
+                    cos_t[j] = std::cos(pos * inv_freq_[j]);
+                    sin_t[j] = std::sin(pos * inv_freq_[j]);
+                }
+                const host_bf16_t* row = qkv_out_.data() + b * qkv_.N;
+                const host_bf16_t* q_src = mla ? q_out_.data() + b * q_b_.N : row;
+                const host_bf16_t* k_src = mla ? row + c.q_lora_rank : row + H * D;
+                for (int64_t h = 0; h < H; h++) rope_head(q_src + h * D, q_.data() + (b * H + h) * D, D, c.rope_dim, cos_t.data(), sin_t.data());
+                const int64_t slot = req_to_tokens_[b_req_idx_[b] * max_len_ + pos];
+                std::vector<host_bf16_t> k_rot(D);
+                for (int64_t h = 0; h < Hkv; h++) {
+                    rope_head(k_src + h * D, k_rot.data(), D, c.rope_dim, cos_t.data(), sin_t.data());
+                    store_head(k_rot.data(), D, k_.data() + (slot * Hkv + h) * D, k_s_.data() + (slot * Hkv + h) * D / 8);
+                    if (!mla) {
+                        store_head(k_src + (Hkv + h) * D, D, v_.data() + (slot * Hkv + h) * D,
+                                   v_s_.data() + (slot * Hkv + h) * D / 8);
+                    }
+                }
+                b_seq_len_[b] = pos + 1;
+            }
+        });
+
+        double kv_bytes = 0.0;
+        int32_t max_len = 0;
+        for (int64_t b = 0; b < B_; b++) {
+            kv_bytes += static_cast<double>(b_seq_len_[b]) * kv_planes * Hkv * (D + D / 8 * 2);
+            max_len = std::max(max_len, b_seq_len_[b]);
+        }
+        t.run("attention", kv_bytes + B_ * H * D * 4.0, [&] {
+            lk_tensor_t O = make_tensor(o_.data(), LK_DTYPE_BFLOAT16, {B_, H, D});
+            lk_tensor_t Q = make_tensor(q_.data(), LK_DTYPE_BFLOAT16, {B_, H, D});
+            const int64_t slots = B_ * max_len_;
+            lk_tensor_t K = make_tensor(k_.data(), LK_DTYPE_INT8, {slots, Hkv, D});
+            lk_tensor_t KS = make_tensor(k_s_.data(), LK_DTYPE_BFLOAT16, {slots, Hkv, D / 8});
+            lk_tensor_t V = mla ? K : make_tensor(v_.data(), LK_DTYPE_INT8, {slots, Hkv, D});
+            lk_tensor_t VS = mla ? KS : make_tensor(v_s_.data(), LK_DTYPE_BFLOAT16, {slots, Hkv, D / 8});
+            lk_tensor_t R = make_tensor(req_to_tokens_.data(), LK_DTYPE_INT32, {B_, max_len_});
+            lk_tensor_t BR = make_tensor(b_req_idx_.data(), LK_DTYPE_INT32, {B_});
+            lk_tensor_t BL = make_tensor(b_seq_len_.data(), LK_DTYPE_INT32, {B_});
+            check(lk_decode_attention(&O, &Q, &K, &KS, &V, &VS, &R, &BR, &BL, max_len));
+        });
+
+        t.run("o_proj", o_proj_.bytes() + B_ * (H * c.v_head_dim * 3.0 + hidden * 2), [&] {
+            quant_rows(o_.data(), B_, H, D, c.v_head_dim, H * D, a8_.data(), a_s_.data());
+            o_proj_.run(a8_.data(), a_s_.data(), B_, x_.data(), LK_DTYPE_BFLOAT16);
+        });
+
+        t.run("ffn_norm", 3 * act + B_ * hidden, [&] {
+            add_norm_quant(residual_.data(), x_.data(), norm_w_, B_, hidden, a8_.data(), a_s_.data());
+        });
+
+        if (c.experts == 0) {
+            mlp(t, gate_up_, down_, a8_.data(), a_s_.data(), B_, x_.data(), LK_DTYPE_BFLOAT16, "gate_up", "act", "down");
+        } else {
+            moe(t);
+        }
+    }
+
+private:
+    // gate_up -> silu(g) * u -> int8 -> down, out [M, hidden] of out_dtype
+    void mlp(Timeline& t, const Linear& gate_up, const Linear& down, const int8_t* a, const float* a_s, const int64_t M,
+             void* out, const lk_dtype_t out_dtype, const char* gate_up_name, const char* act_name,
+             const char* down_name) {
+        const int64_t I = down.K;
+        t.run(gate_up_name, gate_up.bytes() + M * (gate_up.K + 2.0 * gate_up.N), [&] {
+            gate_up.run(a, a_s, M, ffn_.data(), LK_DTYPE_BFLOAT16);
+        });
+        t.run(act_name, M * I * 5.0, [&] {
+            for (int64_t m = 0; m < M; m++) {
+                host_bf16_t* row = ffn_.data() + m * 2 * I;
+                for (int64_t j = 0; j < I; j++) {
+                    row[j] = from_float<host_bf16_t>(silu(to_float(row[j])) * to_float(row[I + j]));
+                }
+            }
+            quant_rows(ffn_.data(), M, 1, I, I, 2 * I, ffn_a8_.data(), ffn_a_s_.data());
+        });
+        t.run(down_name, down.bytes() + M * (I + down.N * (out_dtype == LK_DTYPE_FLOAT32 ? 4.0 : 2.0)), [&] {
+            down.run(ffn_a8_.data(), ffn_a_s_.data(), M, out, out_dtype);
+        });
+    }
+
+    void moe(Timeline& t) {
+        const ModelConfig& c = cfg_;
+        const int64_t E = c.experts, hidden = c.hidden;
+        std::vector<int32_t> ids(B_ * c.topk);
+        std::vector<float> weights(B_ * c.topk);
+
+        t.run("router", router_.bytes() + B_ * (hidden + E * 4.0), [&] {
+            router_.run(a8_.data(), a_s_.data(), B_, logits_.data(), LK_DTYPE_FLOAT32);
+        });
+
+        // DeepSeek-V3 routing: sigmoid scores, the topk_group groups with the
+        // largest sum of their two best experts, then top-k within them
+        t.run("topk", B_ * (E * 4.0 + c.topk * 8.0), [&] {
+            const int64_t per_group = E / c.n_group;
+            std::vector<float> scores(E), group_score(c.n_group);
+            std::vector<int32_t> order(std::max(E, c.n_group));
+            for (int64_t b = 0; b < B_; b++) {
+                for (int64_t e = 0; e < E; e++) scores[e] = 1.0f / (1.0f + std::exp(-logits_[b * E + e]));
+                for (int64_t g = 0; g < c.n_group; g++) {
+                    const float* s = scores.data() + g * per_group;
+                    float best = -1.0f, second = -1.0f;
+                    for (int64_t j = 0; j < per_group; j++) {
+                        if (s[j] > best) {
+                            second = best;
+                            best = s[j];
+                        } else if (s[j] > second) {
+                            second = s[j];
+                        }
+                    }
+                    group_score[g] = best + second;
+                }
+                std::iota(order.begin(), order.begin() + c.n_group, 0);
+                std::partial_sort(order.begin(), order.begin() + c.topk_group, order.begin() + c.n_group,
+                                  [&](int32_t x, int32_t y) { return group_score[x] > group_score[y]; });
+                std::vector<int32_t> candidates;
+                for (int64_t i = 0; i < c.topk_group; i++) {
+                    for (int64_t j = 0; j < per_group; j++) candidates.push_back(static_cast<int32_t>(order[i] * per_group + j));
+                }
+                std::partial_sort(candidates.begin(), candidates.begin() + c.topk, candidates.end(),
+                                  [&](int32_t x, int32_t y) { return scores[x] > scores[y]; });
+                float sum = 0.0f;
+                for (int64_t k = 0; k < c.topk; k++) sum += scores[candidates[k]];
+                for (int64_t k = 0; k < c.topk; k++) {
+                    ids[b * c.topk + k] = candidates[k];
+                    weights[b * c.topk + k] = scores[candidates[k]] / sum;
+                }
+            }
+        });
+
+        if (c.shared_experts > 0) {
+            mlp(t, gate_up_, down_, a8_.data(), a_s_.data(), B_, acc_.data(), LK_DTYPE_FLOAT32, "shared", "shared",
+                "shared");
+        } else {
+            std::fill(acc_.begin(), acc_.end(), 0.0f);
+        }
+
+        // tokens of every routed expert, experts take pool weights in order of first use
+        std::vector<std::vector<int32_t>> tokens(E);
+        std::vector<int32_t> used;
+        for (int64_t i = 0; i < B_ * c.topk; i++) {
+            if (tokens[ids[i]].empty()) used.push_back(ids[i]);
+            tokens[ids[i]].push_back(static_cast<int32_t>(i));
+        }
+        std::vector<int8_t> a_rows(B_ * hidden);
+        std::vector<float> a_rows_s(B_);
+        for (size_t u = 0; u < used.size(); u++) {
+            const std::vector<int32_t>& list = tokens[used[u]];
+            const int64_t M = static_cast<int64_t>(list.size());
+            for (int64_t r = 0; r < M; r++) {
+                const int64_t b = list[r] / c.topk;
+                std::memcpy(a_rows.data() + r * hidden, a8_.data() + b * hidden, hidden);
+                a_rows_s[r] = a_s_[b];
+            }
+            mlp(t, expert_gate_up_[u], expert_down_[u], a_rows.data(), a_rows_s.data(), M, down_out_.data(),
+                LK_DTYPE_FLOAT32, "experts", "experts", "experts");
+            t.run("experts", M * hidden * 8.0, [&] {
+                for (int64_t r = 0; r < M; r++) {
+                    const int64_t b = list[r] / c.topk;
+                    const float w = weights[list[r]];
+                    for (int64_t j = 0; j < hidden; j++) acc_[b * hidden + j] += w * down_out_[r * hidden + j];
+                }
+            });
+        }
+        t.run("experts", B_ * hidden * 6.0, [&] {
+            for (int64_t i = 0; i < B_ * hidden; i++) x_[i] = from_float<host_bf16_t>(acc_[i]);
+        });
+    }
+
+    const ModelConfig& cfg_;
+    const int64_t B_;
+    const int64_t max_len_;
+    Linear qkv_, q_b_, o_proj_, gate_up_, down_, router_;
+    std::vector<Linear> expert_gate_up_, expert_down_;
+    std::vector<host_bf16_t> norm_w_;
+    std::vector<int8_t> k_, v_;
+    std::vector<host_bf16_t> k_s_, v_s_;
+    std::vector<int32_t> req_to_tokens_, b_req_idx_, b_seq_len_;
+    std::vector<host_bf16_t> residual_, x_, qkv_out_, q_out_, q_, o_, ffn_;
+    std::vector<int8_t> a8_;
+    std::vector<float> a_s_, logits_, acc_, down_out_, inv_freq_;
+    std::vector<int8_t> ffn_a8_;
+    std::vector<float> ffn_a_s_;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string model = argc > 1 ? argv[1] : "all";
+    const int64_t batch = argc > 2 ? std::atoll(argv[2]) : 4;
+    const int64_t context = argc > 3 ? std::atoll(argv[3]) : 2048;
+    const int64_t steps = argc > 4 ? std::atoll(argv[4]) : 3;
+    if (argc > 5) check(lk_set_num_threads(std::atoi(argv[5])));
+    std::printf("cpu isa %s, %d threads, batch %lld, context %lld, %lld steps\n", lk_get_cpu_isa(0),
+                lk_get_num_threads(), (long long)batch, (long long)context, (long long)steps);
+
+    bool found = false;
+    for (const ModelConfig& cfg : kModels) {
+        if (model != "all" && model != cfg.name) continue;
+        found = true;
+        DecoderLayer layer(cfg, batch, context, steps + 1);
+        std::printf("\n%s: %.1f MB of int8 layer weights\n", cfg.name, layer.weight_bytes() * 1e-6);
+        Timeline timeline;
+        layer.step(timeline);  // warm up, not recorded
+        timeline.record(true);
+        for (int64_t s = 0; s < steps; s++) layer.step(timeline);
+        timeline.print(steps);
+    }
+    if (!found) {
+        std::fprintf(stderr, "unknown model %s, expected all", model.c_str());
+        for (const ModelConfig& cfg : kModels) std::fprintf(stderr, ", %s", cfg.name);
+        std::fprintf(stderr, "\n");
+        return 1;
+    }
+    return 0;
+}
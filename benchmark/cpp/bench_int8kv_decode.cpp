@@ -0,0 +1,103 @@
+// Decode attention over an int8 KV cache (lk_int8kv_decode_attention), float QK
+// against int8 QK (VNNI when the CPU has it, else exact int32 scalar sums).
+//
+// Llama-style GQA, bf16 q and group scales, every request owning random
+// slots of a shared pool.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_int8kv_decode
+#include "core/lightllm_c.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+lk_tensor_t make_tensor(void* data, lk_dtype_t dtype, std::initializer_list<int64_t> shape) {
+    lk_tensor_t t;
+    std::memset(&t, 0, sizeof(t));
+    t.data = data;
+    t.dtype = dtype;
+    t.ndim = static_cast<int32_t>(shape.size());
+    int32_t d = 0;
+    for (int64_t s : shape) t.shape[d++] = s;
+    int64_t stride = 1;
+    for (d = t.ndim - 1; d >= 0; d--) {
+        t.strides[d] = stride;
+        stride *= t.shape[d];
+    }
+    t.device_type = LK_DEVICE_CPU;
+    return t;
+}
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+template <typename F>
+double us_per_call(const int64_t iters, const F& f) {
+    f();
+    const auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < iters; i++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iters;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int64_t iters = argc > 1 ? std::atoll(argv[1]) : 5;
+    const int64_t heads = 32;
+    const int64_t kv_heads = 8;
+    const int64_t head_dim = 128;
+    const int64_t groups = head_dim / 8;
+
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int> byte(-127, 127);
+    std::printf("%8s %8s %14s %14s %10s\n", "batch", "seq_len", "float qk(us)", "int8 qk(us)", "speedup");
+    for (const int64_t batch : {1, 8}) {
+        for (const int64_t seq_len : {512, 4096}) {
+            const int64_t num_slots = batch * seq_len;
+            // bf16 ~ 0.5 and 0.01 scales as raw bits
+            std::vector<uint16_t> q(batch * heads * head_dim, 0x3f00), o(q.size());
+            std::vector<int8_t> k(num_slots * kv_heads * head_dim), v(k.size());
+            for (auto& x : k) x = static_cast<int8_t>(byte(rng));
+            for (auto& x : v) x = static_cast<int8_t>(byte(rng));
+            std::vector<uint16_t> k_s(num_slots * kv_heads * groups, 0x3c24), v_s(k_s.size(), 0x3c24);
+            std::vector<int32_t> req_to_tokens(num_slots);
+            std::iota(req_to_tokens.begin(), req_to_tokens.end(), 0);
+            std::shuffle(req_to_tokens.begin(), req_to_tokens.end(), rng);
+            std::vector<int32_t> b_req_idx(batch), b_seq_len(batch, static_cast<int32_t>(seq_len));
+            std::iota(b_req_idx.begin(), b_req_idx.end(), 0);
+
+            const lk_tensor_t Q = make_tensor(q.data(), LK_DTYPE_BFLOAT16, {batch, heads, head_dim});
+            lk_tensor_t O = make_tensor(o.data(), LK_DTYPE_BFLOAT16, {batch, heads, head_dim});
+            const lk_tensor_t K = make_tensor(k.data(), LK_DTYPE_INT8, {num_slots, kv_heads, head_dim});
+            const lk_tensor_t V = make_tensor(v.data(), LK_DTYPE_INT8, {num_slots, kv_heads, head_dim});
+            const lk_tensor_t KS = make_tensor(k_s.data(), LK_DTYPE_BFLOAT16, {num_slots, kv_heads, groups});
+            const lk_tensor_t VS = make_tensor(v_s.data(), LK_DTYPE_BFLOAT16, {num_slots, kv_heads, groups});
+            const lk_tensor_t R = make_tensor(req_to_tokens.data(), LK_DTYPE_INT32, {batch, seq_len});
+            const lk_tensor_t BR = make_tensor(b_req_idx.data(), LK_DTYPE_INT32, {batch});
+            const lk_tensor_t BL = make_tensor(b_seq_len.data(), LK_DTYPE_INT32, {batch});
+
+            double us[2];
+            for (int32_t int8_qk = 0; int8_qk < 2; int8_qk++) {
+                us[int8_qk] = us_per_call(iters, [&] {
+                    check(lk_int8kv_decode_attention(&O, &Q, &K, &KS, &V, &VS, &R, &BR, &BL, seq_len, int8_qk));
+                });
+            }
+            std::printf("%8lld %8lld %14.1f %14.1f %9.2fx\n", (long long)batch, (long long)seq_len, us[0], us[1],
+                        us[0] / us[1]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Scheduler-side cost of the paged KV allocator under a serving workload.
+//
+// Keeps `concurrency` requests running. Every step appends one decode token
+// to each of them in a single batched extend; finished requests are freed and
+// replaced by a new prompt (prefill) or, sometimes, a fork sharing a prefix of
+// a running request, so copy-on-writes and page sharing are exercised too.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_kv_allocator [steps]
+#include "core/lightllm_c.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+struct Workload {
+    int32_t concurrency;
+    int32_t page_size;
+    int32_t max_prompt;
+    int32_t max_output;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int64_t steps = argc > 1 ? std::atoll(argv[1]) : 2000;
+    const int32_t max_seq_len = 4096;
+
+    std::printf("%8s %6s %14s %14s %12s %12s %10s\n",
+                "reqs", "page", "step(us)", "token(ns)", "prefills", "forks", "cow");
+    for (const Workload wl : {Workload{256, 16, 1024, 512}, Workload{1024, 16, 1024, 512},
+                              Workload{1024, 64, 1024, 512}, Workload{4096, 16, 512, 256}}) {
+        const int32_t max_reqs = wl.concurrency * 2;
+        // forks can grow past a prompt + output, size for full rows
+        const int32_t num_pages = max_reqs * (max_seq_len / wl.page_size);
+        std::vector<int32_t> table(static_cast<size_t>(max_reqs) * max_seq_len);
+        lk_tensor_t t;
+        std::memset(&t, 0, sizeof(t));
+        t.data = table.data();
+        t.dtype = LK_DTYPE_INT32;
+        t.ndim = 2;
+        t.shape[0] = max_reqs;
+        t.shape[1] = max_seq_len;
+        t.strides[0] = max_seq_len;
+        t.strides[1] = 1;
+        t.device_type = LK_DEVICE_CPU;
+
+        lk_kv_allocator_t* alloc;
+        check(lk_kv_allocator_create(num_pages, wl.page_size, max_reqs, max_seq_len, &t, &alloc));
+
+        std::mt19937 rng(0);
+        std::vector<int32_t> running, remaining(max_reqs, 0);
+        std::vector<int32_t> reqs, num_new, slots;
+        std::vector<lk_kv_page_copy_t> copies(max_reqs);
+        int64_t prefills = 0, forks = 0, cows = 0, tokens = 0;
+        double seconds = 0.0;
+
+        for (int64_t step = 0; step < steps; step++) {
+            const auto start = std::chrono::steady_clock::now();
+            // Admit new requests: a fresh prompt, or one in eight forks a running one.
+            reqs.clear();
+            num_new.clear();
+            while (static_cast<int32_t>(running.size()) < wl.concurrency) {
+                int32_t req;
+                int32_t n;
+                const int32_t src = running.empty() ? -1 : running[rng() % running.size()];
+                int32_t src_len = 0;
+                if (src >= 0) check(lk_kv_seq_len(alloc, src, &src_len));
+                if (src >= 0 && rng() % 8 == 0 && src_len + wl.max_output <= max_seq_len) {
+                    // shares all pages of src, the partial last one is copied on the first write
+                    check(lk_kv_fork(alloc, src, src_len, &req));
+                    n = 1;
+                    forks++;
+                } else {
+                    check(lk_kv_alloc_req(alloc, &req));
+                    n = 1 + static_cast<int32_t>(rng() % wl.max_prompt);
+                    prefills++;
+                }
+                remaining[req] = 1 + static_cast<int32_t>(rng() % wl.max_output);
+                running.push_back(req);
+                reqs.push_back(req);
+                num_new.push_back(n);
+            }
+            // One decode token for every request that is not prefilled in this step.
+            const size_t num_admitted = reqs.size();
+            for (size_t i = 0; i + num_admitted < running.size(); i++) {
+                reqs.push_back(running[i]);
+                num_new.push_back(1);
+            }
+
+            int64_t total = 0;
+            for (const int32_t n : num_new) total += n;
+            slots.resize(total);
+            int32_t num_copies, ok;
+            check(lk_kv_extend(alloc, reqs.data(), num_new.data(), static_cast<int32_t>(reqs.size()),
+                               slots.data(), copies.data(), &num_copies, &ok));
+            if (!ok) {
+                std::fprintf(stderr, "out of pages at step %lld\n", (long long)step);
+                return 1;
+            }
+            cows += num_copies;
+            tokens += total;
+
+            // Retire the finished requests.
+            for (size_t i = 0; i < running.size();) {
+                if (--remaining[running[i]] == 0) {
+                    check(lk_kv_free_req(alloc, running[i]));
+                    running[i] = running.back();
+                    running.pop_back();
+                } else {
+                    i++;
+                }
+            }
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        std::printf("%8d %6d %14.2f %14.2f %12lld %12lld %10lld\n",
+                    wl.concurrency, wl.page_size, 1e6 * seconds / steps, 1e9 * seconds / tokens,
+                    (long long)prefills, (long long)forks, (long long)cows);
+        lk_kv_allocator_destroy(alloc);
+    }
+    return 0;
+}
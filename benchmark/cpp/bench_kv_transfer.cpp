@@ -0,0 +1,104 @@
+// Packed KV transfer buffers for prefill -> decode handoff (lk_kv_pack / lk_kv_unpack).
+//
+// One request's int8 K / V rows and their bf16 group scales, all layers,
+// packed from random slots into a transfer buffer and unpacked into other
+// random slots, with one thread and with the whole core thread pool.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_kv_transfer
+#include "core/lightllm_c.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+lk_tensor_t make_tensor(void* data, lk_dtype_t dtype, std::initializer_list<int64_t> shape) {
+    lk_tensor_t t;
+    std::memset(&t, 0, sizeof(t));
+    t.data = data;
+    t.dtype = dtype;
+    t.ndim = static_cast<int32_t>(shape.size());
+    int32_t d = 0;
+    for (int64_t s : shape) t.shape[d++] = s;
+    int64_t stride = 1;
+    for (d = t.ndim - 1; d >= 0; d--) {
+        t.strides[d] = stride;
+        stride *= t.shape[d];
+    }
+    t.device_type = LK_DEVICE_CPU;
+    return t;
+}
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+template <typename F>
+double us_per_call(const int64_t iters, const F& f) {
+    f();
+    const auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < iters; i++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iters;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int64_t iters = argc > 1 ? std::atoll(argv[1]) : 20;
+    const int32_t max_threads = lk_get_num_threads();
+    const int64_t layers = 16;
+    const int64_t num_slots = 4096;
+    const int64_t heads = 8;
+    const int64_t head_dim = 128;
+    const int64_t groups = head_dim / 8;
+
+    // k, v int8 [layers, slots, heads, head_dim], k_s, v_s bf16 [layers, slots, heads, groups]
+    std::vector<int8_t> k(layers * num_slots * heads * head_dim, 1), v(k.size(), 2);
+    std::vector<uint16_t> k_s(layers * num_slots * heads * groups, 3), v_s(k_s.size(), 4);
+    const lk_tensor_t caches[4] = {
+        make_tensor(k.data(), LK_DTYPE_INT8, {layers, num_slots, heads, head_dim}),
+        make_tensor(v.data(), LK_DTYPE_INT8, {layers, num_slots, heads, head_dim}),
+        make_tensor(k_s.data(), LK_DTYPE_BFLOAT16, {layers, num_slots, heads, groups}),
+        make_tensor(v_s.data(), LK_DTYPE_BFLOAT16, {layers, num_slots, heads, groups}),
+    };
+
+    std::vector<int32_t> perm(num_slots);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::mt19937 rng(0);
+
+    std::printf("%8s %8s %12s %12s %10s %12s %10s\n", "tokens", "threads", "buffer(MB)", "pack(us)", "GB/s",
+                "unpack(us)", "GB/s");
+    for (const int64_t n : {64, 512, 2048}) {
+        std::shuffle(perm.begin(), perm.end(), rng);
+        std::vector<int32_t> src(perm.begin(), perm.begin() + n);
+        std::vector<int32_t> dst(perm.begin() + n, perm.begin() + 2 * n);
+        int64_t bytes = 0;
+        check(lk_kv_transfer_bytes(caches, 4, 1, n, &bytes));
+        std::vector<uint8_t> buffer(bytes);
+        lk_tensor_t B = make_tensor(buffer.data(), LK_DTYPE_UINT8, {bytes});
+        lk_tensor_t S = make_tensor(src.data(), LK_DTYPE_INT32, {n});
+        lk_tensor_t D = make_tensor(dst.data(), LK_DTYPE_INT32, {n});
+
+        for (const int32_t threads : {1, max_threads}) {
+            check(lk_set_num_threads(threads));
+            const double pack = us_per_call(iters, [&] { check(lk_kv_pack(caches, 4, &S, 1, n, &B)); });
+            const double unpack = us_per_call(iters, [&] { check(lk_kv_unpack(caches, 4, &D, 1, &B)); });
+            std::printf("%8lld %8d %12.2f %12.1f %10.2f %12.1f %10.2f\n", (long long)n, threads, bytes / 1e6,
+                        pack, bytes / pack / 1e3, unpack, bytes / unpack / 1e3);
+            if (threads == max_threads) break;
+        }
+    }
+    check(lk_set_num_threads(max_threads));
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Chained page hashing for prefix cache lookups (lk_page_hashes).
+//
+// One 32K-token prompt (the latency a new request sees) and batches of
+// requests, with one thread and with the whole core thread pool.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_page_hash
+#include "core/lightllm_c.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+lk_tensor_t make_tensor(void* data, lk_dtype_t dtype, std::initializer_list<int64_t> shape) {
+    lk_tensor_t t;
+    std::memset(&t, 0, sizeof(t));
+    t.data = data;
+    t.dtype = dtype;
+    t.ndim = static_cast<int32_t>(shape.size());
+    int32_t d = 0;
+    for (int64_t s : shape) t.shape[d++] = s;
+    int64_t stride = 1;
+    for (d = t.ndim - 1; d >= 0; d--) {
+        t.strides[d] = stride;
+        stride *= t.shape[d];
+    }
+    t.device_type = LK_DEVICE_CPU;
+    return t;
+}
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+template <typename F>
+double us_per_call(const int64_t iters, const F& f) {
+    f();
+    const auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < iters; i++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iters;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int64_t iters = argc > 1 ? std::atoll(argv[1]) : 50;
+    const int32_t max_threads = lk_get_num_threads();
+    const int64_t page_size = 16;
+
+    std::printf("%6s %8s %8s %6s %12s %12s %10s\n", "batch", "tokens", "threads", "bits", "call(us)", "req(us)", "GB/s");
+    for (const auto& shape : {std::pair<int64_t, int64_t>{1, 32768}, {64, 8192}, {256, 2048}}) {
+        const int64_t B = shape.first;
+        const int64_t L = shape.second;
+        std::vector<int32_t> tokens(B * L);
+        std::mt19937 rng(0);
+        for (int32_t& t : tokens) t = static_cast<int32_t>(rng() % 150000);
+        std::vector<int32_t> lens(B, static_cast<int32_t>(L));
+        std::vector<int64_t> out(B * (L / page_size) * 2);
+
+        for (const int32_t threads : {1, max_threads}) {
+            check(lk_set_num_threads(threads));
+            for (const int64_t words : {1, 2}) {
+                lk_tensor_t T = make_tensor(tokens.data(), LK_DTYPE_INT32, {B, L});
+                lk_tensor_t N = make_tensor(lens.data(), LK_DTYPE_INT32, {B});
+                lk_tensor_t O = make_tensor(out.data(), LK_DTYPE_INT64, {B, L / page_size, words});
+                const double us = us_per_call(iters, [&] { check(lk_page_hashes(&T, &N, page_size, 0, &O)); });
+                std::printf("%6lld %8lld %8d %6lld %12.1f %12.2f %10.2f\n",
+                            (long long)B, (long long)L, threads, (long long)(64 * words), us, us / B,
+                            B * L * sizeof(int32_t) / us / 1e3);
+            }
+            if (threads == max_threads) break;
+        }
+    }
+    check(lk_set_num_threads(max_threads));
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Quest-style sparse decode (lk_quest_select_pages + lk_sparse_int8kv_decode_attention)
+// against dense int8-KV decode attention: time per step, the share of the dense
+// attention mass that falls on the selected pages (recall) and the relative
+// error of the output.
+//
+// Llama-style GQA over a paged cache; a few pages per request hold keys aligned
+// with the query (the tokens that matter), the rest is noise.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_quest_decode
+#include "core/lightllm_c.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+lk_tensor_t make_tensor(void* data, lk_dtype_t dtype, std::initializer_list<int64_t> shape) {
+    lk_tensor_t t;
+    std::memset(&t, 0, sizeof(t));
+    t.data = data;
+    t.dtype = dtype;
+    t.ndim = static_cast<int32_t>(shape.size());
+    int32_t d = 0;
+    for (int64_t s : shape) t.shape[d++] = s;
+    int64_t stride = 1;
+    for (d = t.ndim - 1; d >= 0; d--) {
+        t.strides[d] = stride;
+        stride *= t.shape[d];
+    }
+    t.device_type = LK_DEVICE_CPU;
+    return t;
+}
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+template <typename F>
+double us_per_call(const int64_t iters, const F& f) {
+    f();
+    const auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < iters; i++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iters;
+}
+
+uint16_t to_bf16(const float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, 4);
+    return static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+float from_bf16(const uint16_t x) {
+    const uint32_t bits = static_cast<uint32_t>(x) << 16;
+    float f;
+    std::memcpy(&f, &bits, 4);
+    return f;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int64_t iters = argc > 1 ? std::atoll(argv[1]) : 3;
+    const int64_t heads = 32;
+    const int64_t kv_heads = 8;
+    const int64_t group = heads / kv_heads;
+    const int64_t head_dim = 128;
+    const int64_t groups = head_dim / 8;
+    const int64_t page_size = 16;
+    const float kv_scale = from_bf16(0x3c24);  // ~0.01
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> noise(-20, 20);
+    std::printf("%6s %8s %6s %11s %11s %8s %8s %10s\n",
+                "batch", "seq_len", "pages", "dense(us)", "quest(us)", "speedup", "recall", "rel err");
+    for (const int64_t batch : {1, 4}) {
+        for (const int64_t seq_len : {8192, 32768}) {
+            const int64_t pages_per_req = seq_len / page_size;
+            const int64_t num_pages = batch * pages_per_req;
+            const int64_t num_slots = num_pages * page_size;
+
+            // the heads of a GQA group look alike
+            std::vector<uint16_t> q(batch * heads * head_dim), o(q.size()), o_dense(q.size());
+            for (int64_t i = 0; i < batch * kv_heads * head_dim; i++) {
+                const int64_t b = i / (kv_heads * head_dim);
+                const int64_t h = i / head_dim % kv_heads;
+                const int64_t d = i % head_dim;
+                const float base = uniform(rng);
+                for (int64_t g = 0; g < group; g++) {
+                    q[(b * heads + h * group + g) * head_dim + d] = to_bf16(base + 0.3f * uniform(rng));
+                }
+            }
+            std::vector<int8_t> k(num_slots * kv_heads * head_dim), v(k.size());
+            for (auto& x : k) x = static_cast<int8_t>(noise(rng) / 2);
+            for (auto& x : v) x = static_cast<int8_t>(noise(rng) * 6);
+            std::vector<uint16_t> k_s(num_slots * kv_heads * groups, 0x3c24), v_s(k_s.size(), 0x3c24);
+
+            // every request owns shuffled whole pages
+            std::vector<int32_t> page_order(num_pages);
+            std::iota(page_order.begin(), page_order.end(), 0);
+            std::shuffle(page_order.begin(), page_order.end(), rng);
+            std::vector<int32_t> req_to_tokens(num_slots);
+            for (int64_t p = 0; p < num_pages; p++) {
+                for (int64_t t = 0; t < page_size; t++) req_to_tokens[p * page_size + t] = page_order[p] * page_size + t;
+            }
+            // ~2% of the pages of a request hold keys along the summed query of their group
+            std::uniform_int_distribution<int64_t> pick(0, pages_per_req - 1);
+            for (int64_t b = 0; b < batch; b++) {
+                for (int64_t n = 0; n < pages_per_req / 50; n++) {
+                    const int64_t page = page_order[b * pages_per_req + pick(rng)];
+                    for (int64_t h = 0; h < kv_heads; h++) {
+                        for (int64_t d = 0; d < head_dim; d++) {
+                            float sum = 0.0f;
+                            for (int64_t g = 0; g < group; g++) sum += from_bf16(q[(b * heads + h * group + g) * head_dim + d]);
+                            for (int64_t t = 0; t < page_size; t++) {
+                                int8_t& x = k[((page * page_size + t) * kv_heads + h) * head_dim + d];
+                                x = static_cast<int8_t>(std::clamp(x + (sum > 0 ? 80 : -80), -127, 127));
+                            }
+                        }
+                    }
+                }
+            }
+            std::vector<int32_t> slots(num_slots);
+            std::iota(slots.begin(), slots.end(), 0);
+            std::vector<int32_t> b_req_idx(batch), b_seq_len(batch, static_cast<int32_t>(seq_len));
+            std::iota(b_req_idx.begin(), b_req_idx.end(), 0);
+            std::vector<uint16_t> page_min(num_pages * kv_heads * head_dim), page_max(page_min.size());
+
+            const lk_tensor_t Q = make_tensor(q.data(), LK_DTYPE_BFLOAT16, {batch, heads, head_dim});
+            lk_tensor_t O = make_tensor(o.data(), LK_DTYPE_BFLOAT16, {batch, heads, head_dim});
+            lk_tensor_t OD = make_tensor(o_dense.data(), LK_DTYPE_BFLOAT16, {batch, heads, head_dim});
+            const lk_tensor_t K = make_tensor(k.data(), LK_DTYPE_INT8, {num_slots, kv_heads, head_dim});
+            const lk_tensor_t V = make_tensor(v.data(), LK_DTYPE_INT8, {num_slots, kv_heads, head_dim});
+            const lk_tensor_t KS = make_tensor(k_s.data(), LK_DTYPE_BFLOAT16, {num_slots, kv_heads, groups});
+            const lk_tensor_t VS = make_tensor(v_s.data(), LK_DTYPE_BFLOAT16, {num_slots, kv_heads, groups});
+            const lk_tensor_t R = make_tensor(req_to_tokens.data(), LK_DTYPE_INT32, {batch, seq_len});
+            const lk_tensor_t BR = make_tensor(b_req_idx.data(), LK_DTYPE_INT32, {batch});
+            const lk_tensor_t BL = make_tensor(b_seq_len.data(), LK_DTYPE_INT32, {batch});
+            const lk_tensor_t S = make_tensor(slots.data(), LK_DTYPE_INT32, {num_slots});
+            lk_tensor_t PMIN = make_tensor(page_min.data(), LK_DTYPE_BFLOAT16, {num_pages, kv_heads, head_dim});
+            lk_tensor_t PMAX = make_tensor(page_max.data(), LK_DTYPE_BFLOAT16, {num_pages, kv_heads, head_dim});
+            check(lk_kv_page_minmax_update(&PMIN, &PMAX, &K, &KS, &S, page_size));
+
+            const double dense_us = us_per_call(iters, [&] {
+                check(lk_int8kv_decode_attention(&OD, &Q, &K, &KS, &V, &VS, &R, &BR, &BL, seq_len, 0));
+            });
+
+            // exact attention probabilities of every head, for the recall
+            std::vector<double> probs(batch * heads * seq_len);
+            for (int64_t b = 0; b < batch; b++) {
+                for (int64_t h = 0; h < heads; h++) {
+                    double* p = probs.data() + (b * heads + h) * seq_len;
+                    const uint16_t* qh = q.data() + (b * heads + h) * head_dim;
+                    double m = -1e300;
+                    for (int64_t t = 0; t < seq_len; t++) {
+                        const int8_t* kt = k.data() + (req_to_tokens[b * seq_len + t] * kv_heads + h / group) * head_dim;
+                        double dot = 0.0;
+                        for (int64_t d = 0; d < head_dim; d++) dot += from_bf16(qh[d]) * kt[d];
+                        p[t] = dot * kv_scale / std::sqrt(static_cast<double>(head_dim));
+                        m = std::max(m, p[t]);
+                    }
+                    double sum = 0.0;
+                    for (int64_t t = 0; t < seq_len; t++) sum += (p[t] = std::exp(p[t] - m));
+                    for (int64_t t = 0; t < seq_len; t++) p[t] /= sum;
+                }
+            }
+
+            for (const int64_t top : {16, 64, 256}) {
+                std::vector<int32_t> page_idx(batch * kv_heads * top);
+                std::vector<float> scores(batch * kv_heads * pages_per_req);
+                lk_tensor_t P = make_tensor(page_idx.data(), LK_DTYPE_INT32, {batch, kv_heads, top});
+                lk_tensor_t SC = make_tensor(scores.data(), LK_DTYPE_FLOAT32, {batch, kv_heads, pages_per_req});
+                const double quest_us = us_per_call(iters, [&] {
+                    check(lk_quest_select_pages(&P, &SC, &Q, &PMIN, &PMAX, &R, &BR, &BL, page_size));
+                    check(lk_sparse_int8kv_decode_attention(&O, &Q, &K, &KS, &V, &VS, &R, &BR, &BL, &P, page_size));
+                });
+
+                double recall = 0.0;
+                for (int64_t b = 0; b < batch; b++) {
+                    for (int64_t h = 0; h < heads; h++) {
+                        const double* p = probs.data() + (b * heads + h) * seq_len;
+                        const int32_t* sel = page_idx.data() + (b * kv_heads + h / group) * top;
+                        for (int64_t i = 0; i < top; i++) {
+                            if (sel[i] < 0) continue;
+                            for (int64_t t = 0; t < page_size; t++) recall += p[sel[i] * page_size + t];
+                        }
+                    }
+                }
+                recall /= batch * heads;
+                double num = 0.0, den = 0.0;
+                for (size_t i = 0; i < o.size(); i++) {
+                    const double diff = from_bf16(o[i]) - from_bf16(o_dense[i]);
+                    num += diff * diff;
+                    den += static_cast<double>(from_bf16(o_dense[i])) * from_bf16(o_dense[i]);
+                }
+                std::printf("%6lld %8lld %6lld %11.1f %11.1f %7.2fx %8.3f %10.2e\n", (long long)batch,
+                            (long long)seq_len, (long long)top, dense_us, quest_us, dense_us / quest_us, recall,
+                            std::sqrt(num / den));
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Host overhead of the checked rmsnorm entry point vs. a cached launch plan.
+//
+// Runs the CPU backend on tiny rows with one thread, so the numbers are
+// dominated by argument checks and kernel selection, the part a plan removes.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_rmsnorm_plan
+#include "core/lightllm_c.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+lk_tensor_t make_tensor(void* data, lk_dtype_t dtype, std::initializer_list<int64_t> shape) {
+    lk_tensor_t t;
+    std::memset(&t, 0, sizeof(t));
+    t.data = data;
+    t.dtype = dtype;
+    t.ndim = static_cast<int32_t>(shape.size());
+    int32_t d = 0;
+    for (int64_t s : shape) t.shape[d++] = s;
+    int64_t stride = 1;
+    for (d = t.ndim - 1; d >= 0; d--) {
+        t.strides[d] = stride;
+        stride *= t.shape[d];
+    }
+    t.device_type = LK_DEVICE_CPU;
+    return t;
+}
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+template <typename F>
+double ns_per_call(const int64_t iters, const F& f) {
+    for (int64_t i = 0; i < iters / 10; i++) f();
+    const auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < iters; i++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iters;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int64_t iters = argc > 1 ? std::atoll(argv[1]) : 2000000;
+    check(lk_set_num_threads(1));
+
+    std::printf("%8s %8s %14s %14s %14s %10s\n", "M", "N", "checked(ns)", "lookup(ns)", "plan(ns)", "saved");
+    for (const int64_t M : {1, 4}) {
+        for (const int64_t N : {16, 128, 4096}) {
+            std::vector<float> x(M * N, 0.5f), w(N, 1.0f), y(M * N);
+            const float eps = 1e-6f;
+
+            // What an op does on every call: build views, validate, pick the kernel, launch.
+            const double checked = ns_per_call(iters, [&] {
+                lk_tensor_t X = make_tensor(x.data(), LK_DTYPE_FLOAT32, {M, N});
+                lk_tensor_t W = make_tensor(w.data(), LK_DTYPE_FLOAT32, {N});
+                lk_tensor_t Y = make_tensor(y.data(), LK_DTYPE_FLOAT32, {M, N});
+                check(lk_rmsnorm(&X, &W, &Y, eps));
+            });
+
+            // Plan fetched from the cache on every call.
+            const double lookup = ns_per_call(iters, [&] {
+                lk_tensor_t X = make_tensor(x.data(), LK_DTYPE_FLOAT32, {M, N});
+                const lk_rmsnorm_plan_t* plan;
+                check(lk_make_rmsnorm_plan(&X, eps, &plan));
+                check(lk_rmsnorm_plan_run(plan, x.data(), w.data(), y.data(), M, nullptr));
+            });
+
+            // Plan kept by the caller: launch only.
+            lk_tensor_t X = make_tensor(x.data(), LK_DTYPE_FLOAT32, {M, N});
+            const lk_rmsnorm_plan_t* plan;
+            check(lk_make_rmsnorm_plan(&X, eps, &plan));
+            const double planned = ns_per_call(iters, [&] {
+                check(lk_rmsnorm_plan_run(plan, x.data(), w.data(), y.data(), M, nullptr));
+            });
+
+            std::printf("%8lld %8lld %14.1f %14.1f %14.1f %9.1f%%\n",
+                        (long long)M, (long long)N, checked, lookup, planned,
+                        100.0 * (checked - planned) / checked);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+// On-load weight quantization from an mmap'd safetensors shard
+// (lk_safetensors_open / lk_quantize_weights).
+//
+// Writes a BF16 shard of decoder layer shaped weights (qkv, o, gate_up, down)
+// to a temporary file, then quantizes all of them per channel to FP8 and
+// INT8 in the cutlass_scaled_mm b layout: with one thread and no read-ahead
+// (the straightforward loop), and with the whole core thread pool with and
+// without IO threads. "cold" drops the shard from the page cache first
+// (posix_fadvise, best effort), "warm" reads it from the page cache. GB/s
+// are BF16 source bytes.
+//
+//   cmake -S . -B build/core -DLIGHTLLM_CORE_ONLY=ON -DLIGHTLLM_CORE_WITH_CUDA=OFF -DLIGHTLLM_CORE_BENCHMARKS=ON
+//   cmake --build build/core -j && ./build/core/bench_weight_loader [shard MB] [path]
+#include "core/lightllm_c.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Weight {
+    std::string name;
+    int64_t n;
+    int64_t k;
+};
+
+void check(lk_status_t status) {
+    if (status != LK_SUCCESS) {
+        std::fprintf(stderr, "error %d: %s\n", status, lk_get_last_error());
+        std::exit(1);
+    }
+}
+
+// Layers of a 4096 hidden, 14336 intermediate, 8 KV head model until mb is reached.
+std::vector<Weight> make_weights(const int64_t mb) {
+    const int64_t H = 4096, I = 14336, KV = 1024;
+    std::vector<Weight> ws;
+    int64_t bytes = 0;
+    for (int64_t l = 0; bytes < mb << 20; l++) {
+        const std::string p = "model.layers." + std::to_string(l) + ".";
+        for (const Weight& w : {Weight{p + "self_attn.qkv_proj.weight", H + 2 * KV, H},
+                                Weight{p + "self_attn.o_proj.weight", H, H},
+                                Weight{p + "mlp.gate_up_proj.weight", 2 * I, H},
+                                Weight{p + "mlp.down_proj.weight", H, I}}) {
+            ws.push_back(w);
+            bytes += w.n * w.k * 2;
+        }
+    }
+    return ws;
+}
+
+void write_shard(const std::string& path, const std::vector<Weight>& ws) {
+    std::string header = "{";
+    int64_t offset = 0;
+    for (const Weight& w : ws) {
+        const int64_t bytes = w.n * w.k * 2;
+        header += (offset ? ",\"" : "\"") + w.name + "\":{\"dtype\":\"BF16\",\"shape\":[" + std::to_string(w.n) +
+                  "," + std::to_string(w.k) + "],\"data_offsets\":[" + std::to_string(offset) + "," +
+                  std::to_string(offset + bytes) + "]}";
+        offset += bytes;
+    }
+    header += "}";
+    while (header.size() % 8) header += ' ';
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        std::exit(1);
+    }
+    const uint64_t header_bytes = header.size();
+    std::fwrite(&header_bytes, 8, 1, f);
+    std::fwrite(header.data(), 1, header.size(), f);
+    // bf16 of N(0, 1) samples, one block repeated
+    std::vector<uint16_t> block(1 << 20);
+    std::mt19937 rng(0);
+    std::normal_distribution<float> dist;
+    for (uint16_t& b : block) {
+        const float x = dist(rng);
+        uint32_t u;
+        std::memcpy(&u, &x, 4);
+        b = static_cast<uint16_t>(u >> 16);
+    }
+    for (int64_t left = offset / 2; left > 0; left -= block.size()) {
+        std::fwrite(block.data(), 2, std::min<int64_t>(left, block.size()), f);
+    }
+    std::fflush(f);
+    ::fsync(fileno(f));
+    std::fclose(f);
+}
+
+void drop_page_cache(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int64_t mb = argc > 1 ? std::atoll(argv[1]) : 1024;
+    const std::string path = argc > 2 ? argv[2] : "/tmp/lightllm_bench_weights.safetensors";
+    const int32_t max_threads = lk_get_num_threads();
+    const std::vector<Weight> ws = make_weights(mb);
+    write_shard(path, ws);
+
+    std::vector<int8_t> q;
+    std::vector<float> scales;
+    int64_t q_bytes = 0, n_total = 0;
+    for (const Weight& w : ws) {
+        q_bytes += w.n * w.k;
+        n_total += w.n;
+    }
+    q.resize(q_bytes);
+    scales.resize(n_total);
+
+    std::printf("%8s %8s %6s %8s %10s %10s %10s\n", "dtype", "cache", "io", "threads", "GB(src)", "seconds", "GB/s");
+    for (const lk_dtype_t dtype : {LK_DTYPE_FP8_E4M3, LK_DTYPE_INT8}) {
+        for (const bool cold : {true, false}) {
+            // (io threads, kernel threads)
+            for (const auto& config : {std::make_pair(0, 1), std::make_pair(0, max_threads),
+                                       std::make_pair(4, max_threads)}) {
+                const int32_t io_threads = config.first;
+                const int32_t threads = config.second;
+                check(lk_set_num_threads(threads));
+                if (cold) drop_page_cache(path);
+                lk_safetensors_t* file = nullptr;
+                check(lk_safetensors_open(path.c_str(), &file));
+                std::vector<lk_tensor_t> w(ws.size()), qt(ws.size()), st(ws.size());
+                int64_t q_off = 0, s_off = 0;
+                for (size_t i = 0; i < ws.size(); i++) {
+                    check(lk_safetensors_tensor(file, ws[i].name.c_str(), &w[i]));
+                    // [K, N] column major view of the [N, K] rows
+                    std::memset(&qt[i], 0, sizeof(lk_tensor_t));
+                    qt[i].data = q.data() + q_off;
+                    qt[i].dtype = dtype;
+                    qt[i].ndim = 2;
+                    qt[i].shape[0] = ws[i].k;
+                    qt[i].shape[1] = ws[i].n;
+                    qt[i].strides[0] = 1;
+                    qt[i].strides[1] = ws[i].k;
+                    std::memset(&st[i], 0, sizeof(lk_tensor_t));
+                    st[i].data = scales.data() + s_off;
+                    st[i].dtype = LK_DTYPE_FLOAT32;
+                    st[i].ndim = 1;
+                    st[i].shape[0] = ws[i].n;
+                    st[i].strides[0] = 1;
+                    q_off += ws[i].n * ws[i].k;
+                    s_off += ws[i].n;
+                }
+                lk_weight_load_stats_t stats;
+                check(lk_quantize_weights(w.data(), qt.data(), st.data(), static_cast<int32_t>(ws.size()), io_threads,
+                                          int64_t(1) << 30, nullptr, nullptr, &stats));
+                lk_safetensors_close(file);
+                std::printf("%8s %8s %6d %8d %10.2f %10.3f %10.2f\n", dtype == LK_DTYPE_INT8 ? "int8" : "fp8",
+                            cold ? "cold" : "warm", io_threads, threads, stats.bytes_read / 1e9, stats.seconds,
+                            stats.bytes_read / stats.seconds / 1e9);
+            }
+        }
+    }
+    check(lk_set_num_threads(max_threads));
+    std::remove(path.c_str());
+    return 0;
+}
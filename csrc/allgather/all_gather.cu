@@ -61,10 +61,17 @@ bool _is_weak_contiguous_gather(torch::Tensor& t) {
  * If _reg_buffer is null, assumes inp.data_ptr() is already IPC-registered.
  * Otherwise, _reg_buffer is assumed to be IPC-registered and inp is first
  * copied into _reg_buffer.
+ *
+ * For CPU tensors _fa must come from init_shm_gather.
  */
 void all_gather(fptr_t _fa, torch::Tensor& inp, torch::Tensor& out,
   
                 fptr_t _reg_buffer, int64_t reg_buffer_sz_bytes) {
+  if (inp.is_cpu()) {
+    // host ranks go through the shared memory transport.
+    shm_all_gather(_fa, inp, out, _reg_buffer, reg_buffer_sz_bytes);
+    return;
+  }
   auto fa = reinterpret_cast<vllm::CustomAllgather*>(_fa);
   const at::cuda::OptionalCUDAGuard device_guard(device_of(inp));
   auto stream = c10::cuda::getCurrentCUDAStream().stream();
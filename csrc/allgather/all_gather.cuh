@@ -56,6 +56,66 @@ __global__ void __launch_bounds__(512, 1)
 
 }
 
+// Vocab parallel embedding: every token id is owned by exactly one rank, so
+// instead of all-reducing a mostly-zero [tokens, hidden] tensor, each rank
+// writes only the rows it owns into its registered buffer and then gathers
+// every row from the buffer of its owner.
+// Rows of ids outside [0, ngpus * vocab_per_rank), or beyond the owner's
+// shard, are zero.
+template <typename T, int ngpus>
+__global__ void __launch_bounds__(512, 1)
+    vocab_parallel_embedding_kernel(RankData* _dp, RankSignals sg,
+                                    Signal* self_sg,
+                                    const int64_t* __restrict__ ids,
+                                    const T* __restrict__ weight,
+                                    T* __restrict__ result, int rank,
+                                    int num_tokens, int hidden_packs,
+                                    int64_t num_local_rows,
+                                    int64_t vocab_per_rank) {
+  int tid = blockIdx.x * blockDim.x + threadIdx.x;
+  int stride = gridDim.x * blockDim.x;
+  using P = typename gather_packed_t<T>::P;
+  int size = num_tokens * hidden_packs;
+  const P* ptrs[ngpus];
+#pragma unroll
+  for (int i = 0; i < ngpus; i++) {
+    ptrs[i] = (const P*)_dp->ptrs[i];
+  }
+  P* self_buffer = (P*)_dp->ptrs[rank];
+  P zero;
+  *reinterpret_cast<int4*>(&zero) = make_int4(0, 0, 0, 0);
+
+  multi_gpu_barrier<ngpus, true>(sg, self_sg, rank);
+  // stage 1: masked gather of the rows owned by this rank
+  for (int idx = tid; idx < size; idx += stride) {
+    int row = idx / hidden_packs;
+    int col = idx % hidden_packs;
+    int64_t id = ids[row];
+    if (id >= 0 && id / vocab_per_rank == rank) {
+      int64_t local_id = id - rank * vocab_per_rank;
+      P val = local_id < num_local_rows
+                  ? ((const P*)weight)[local_id * hidden_packs + col]
+                  : zero;
+      self_buffer[idx] = val;
+      ((P*)result)[idx] = val;
+    }
+  }
+  multi_gpu_barrier<ngpus, false, true>(sg, self_sg, rank);
+
+  // stage 2: fetch the remaining rows from their owners. The tid mapping must
+  // match stage 1, see cross_device_reduce_2stage.
+  for (int idx = tid; idx < size; idx += stride) {
+    int row = idx / hidden_packs;
+    int64_t id = ids[row];
+    int64_t owner = id >= 0 ? id / vocab_per_rank : -1;
+    if (owner == rank) continue;
+    ((P*)result)[idx] = (owner >= 0 && owner < ngpus) ? ptrs[owner][idx] : zero;
+  }
+  // peers may still read this rank's buffer, keep the next call from
+  // overwriting it until they are done
+  multi_gpu_barrier<ngpus, false>(sg, self_sg, rank);
+}
+
 using IPC_KEY = std::array<uint8_t, sizeof(cudaIpcMemHandle_t)>;
 static_assert(sizeof(IPC_KEY) == sizeof(cudaIpcMemHandle_t));
 static_assert(alignof(IPC_KEY) == alignof(cudaIpcMemHandle_t));
@@ -272,6 +332,69 @@ class CustomAllgather {
 #undef KL
   }
 
+  /**
+   * Fused vocab parallel embedding lookup, see vocab_parallel_embedding_kernel.
+   * buffer must be registered and hold at least num_tokens * hidden elements.
+   */
+  template <typename T>
+  void vocab_parallel_embedding(cudaStream_t stream, const int64_t* ids,
+                                const T* weight, T* buffer, T* output,
+                                int num_tokens, int hidden,
+                                int64_t num_local_rows, int64_t vocab_per_rank,
+                                int threads = 512, int block_limit = 36) {
+    auto d = gather_packed_t<T>::P::size;
+    if (hidden % d != 0)
+      throw std::runtime_error(
+          "vocab parallel embedding requires hidden size to be multiple of " +
+          std::to_string(d));
+    if (block_limit > kMaxBlocks)
+      throw std::runtime_error("max supported block limit is " +
+                               std::to_string(kMaxBlocks) + ". Got " +
+                               std::to_string(block_limit));
+
+    RankData* ptrs;
+    cudaStreamCaptureStatus status;
+    CUDACHECK(cudaStreamIsCapturing(stream, &status));
+    if (status == cudaStreamCaptureStatusActive) {
+      ptrs = d_rank_data_base_ + graph_unreg_buffers_.size();
+      graph_unreg_buffers_.push_back(buffer);
+    } else {
+      auto it = buffers_.find(buffer);
+      if (it == buffers_.end())
+        throw std::runtime_error(
+            "buffer address " +
+            std::to_string(reinterpret_cast<uint64_t>(buffer)) +
+            " is not registered!");
+      ptrs = it->second;
+    }
+    int hidden_packs = hidden / d;
+    int size = num_tokens * hidden_packs;
+    if (size == 0) return;
+    int blocks = std::min(block_limit, (size + threads - 1) / threads);
+#define EMBEDDING_CASE(ngpus)                                                \
+  case ngpus: {                                                              \
+    vocab_parallel_embedding_kernel<T, ngpus>                                \
+        <<<blocks, threads, 0, stream>>>(ptrs, sg_, self_sg_, ids, weight,   \
+                                         output, rank_, num_tokens,          \
+                                         hidden_packs, num_local_rows,       \
+                                         vocab_per_rank);                    \
+    break;                                                                   \
+  }
+
+    switch (world_size_) {
+      EMBEDDING_CASE(2)
+      EMBEDDING_CASE(4)
+      EMBEDDING_CASE(6)
+      EMBEDDING_CASE(8)
+      default:
+        throw std::runtime_error(
+            "vocab parallel embedding only supports num gpus in (2,4,6,8). "
+            "Actual num gpus = " +
+            std::to_string(world_size_));
+    }
+#undef EMBEDDING_CASE
+  }
+
   ~CustomAllgather() {
     for (auto [_, ptr] : ipc_handles_) {
       CUDACHECK(cudaIpcCloseMemHandle(ptr));
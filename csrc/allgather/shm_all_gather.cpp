@@ -0,0 +1,121 @@
+#include <ATen/Parallel.h>
+#include <torch/all.h>
+
+#include "ops_common.h"
+#include "shm_all_gather.h"
+
+namespace lightllm {
+namespace ops {
+// Fake pointer type, same as all_gather.cu.
+using fptr_t = int64_t;
+
+fptr_t init_shm_gather(const std::vector<fptr_t>& fake_shm_ptrs, int64_t rank) {
+  int world_size = fake_shm_ptrs.size();
+  if (world_size > 8)
+    throw std::invalid_argument("world size > 8 is not supported");
+  if (rank < 0 || rank >= world_size)
+    throw std::invalid_argument("invalid rank passed in");
+
+  ShmSignal* signals[8];
+  for (int i = 0; i < world_size; i++) {
+    signals[i] = reinterpret_cast<ShmSignal*>(fake_shm_ptrs[i]);
+  }
+  return (fptr_t) new ShmAllgather(signals, rank, world_size);
+}
+
+void shm_gather_dispose(fptr_t _fa) {
+  delete reinterpret_cast<ShmAllgather*>(_fa);
+}
+
+int64_t shm_meta_size() { return sizeof(ShmSignal); }
+
+void shm_gather_register_buffer(fptr_t _fa, const std::vector<fptr_t>& fake_shm_ptrs) {
+  auto fa = reinterpret_cast<ShmAllgather*>(_fa);
+  TORCH_CHECK(fake_shm_ptrs.size() == fa->world_size_);
+  void* ptrs[8];
+  for (int i = 0; i < fake_shm_ptrs.size(); i++) {
+    ptrs[i] = reinterpret_cast<void*>(fake_shm_ptrs[i]);
+  }
+  fa->register_buffer(ptrs);
+}
+
+/**
+ * CPU path of all_gather, _fa is a ShmAllgather created by init_shm_gather.
+ */
+void shm_all_gather(fptr_t _fa, torch::Tensor& inp, torch::Tensor& out,
+                    fptr_t _reg_buffer, int64_t reg_buffer_sz_bytes) {
+  auto fa = reinterpret_cast<ShmAllgather*>(_fa);
+  TORCH_CHECK_EQ(inp.scalar_type(), out.scalar_type());
+  TORCH_CHECK(inp.is_contiguous() && out.is_contiguous());
+  TORCH_CHECK_EQ(out.numel(), inp.numel() * fa->world_size_);
+
+  auto input_size = inp.numel() * inp.element_size();
+  auto reg_buffer = reinterpret_cast<void*>(_reg_buffer);
+  if (reg_buffer) {
+    TORCH_CHECK_LE(input_size, reg_buffer_sz_bytes);
+    std::memcpy(reg_buffer, inp.data_ptr(), input_size);
+  } else {
+    reg_buffer = inp.data_ptr();
+  }
+  fa->allgather(reg_buffer, out.data_ptr(), input_size);
+}
+
+/**
+ * CPU path of vocab_parallel_embedding, same two stages as
+ * vllm::vocab_parallel_embedding_kernel with host barriers in between.
+ */
+void vocab_parallel_embedding_cpu(fptr_t _fa, torch::Tensor& out,
+                                  const torch::Tensor& ids,
+                                  const torch::Tensor& weight,
+                                  fptr_t _reg_buffer,
+                                  int64_t vocab_per_rank) {
+  auto fa = reinterpret_cast<ShmAllgather*>(_fa);
+  const int rank = fa->rank_;
+  const int world_size = fa->world_size_;
+  const int64_t num_tokens = ids.numel();
+  const int64_t row_bytes = weight.size(1) * weight.element_size();
+  const int64_t num_local_rows = weight.size(0);
+
+  const auto& ptrs = fa->peer_buffers(reinterpret_cast<void*>(_reg_buffer));
+  const int64_t* _ids = ids.data_ptr<int64_t>();
+  const char* _weight = static_cast<const char*>(weight.data_ptr());
+  char* _out = static_cast<char*>(out.data_ptr());
+  char* self_buffer = static_cast<char*>(ptrs[rank]);
+
+  fa->barrier();
+  // stage 1: masked gather of the rows owned by this rank
+  at::parallel_for(0, num_tokens, 64, [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; t++) {
+      const int64_t id = _ids[t];
+      if (id < 0 || id / vocab_per_rank != rank) continue;
+      const int64_t local_id = id - rank * vocab_per_rank;
+      if (local_id < num_local_rows) {
+        std::memcpy(self_buffer + t * row_bytes, _weight + local_id * row_bytes, row_bytes);
+      } else {
+        std::memset(self_buffer + t * row_bytes, 0, row_bytes);
+      }
+      std::memcpy(_out + t * row_bytes, self_buffer + t * row_bytes, row_bytes);
+    }
+  });
+  fa->barrier();
+
+  // stage 2: fetch the remaining rows from their owners
+  at::parallel_for(0, num_tokens, 64, [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; t++) {
+      const int64_t id = _ids[t];
+      const int64_t owner = id >= 0 ? id / vocab_per_rank : -1;
+      if (owner == rank) continue;
+      if (owner >= 0 && owner < world_size) {
+        std::memcpy(_out + t * row_bytes,
+                    static_cast<const char*>(ptrs[owner]) + t * row_bytes, row_bytes);
+      } else {
+        std::memset(_out + t * row_bytes, 0, row_bytes);
+      }
+    }
+  });
+  // peers may still read this rank's buffer
+  fa->barrier();
+}
+
+} // namespace ops
+} // namespace lightllm
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lightllm {
+
+/**
+ * Host counterpart of vllm::Signal. One per rank, placed in memory that is
+ * shared between all ranks (e.g. a /dev/shm segment mapped by every process).
+ */
+struct ShmSignal {
+  alignas(128) uint32_t self_counter[8];
+  // Two sets of peer counters, for the same reason as vllm::Signal: a fast
+  // peer may already signal the next barrier while we still wait on this one.
+  alignas(128) uint32_t peer_counter[2][8];
+};
+
+/**
+ * Host-side custom allgather over shared memory. It mirrors the protocol of
+ * vllm::CustomAllgather so CPU ranks (processes of one node sharing host
+ * memory) can run the same collectives as GPU ranks over IPC.
+ *
+ * Pointers passed in are the local mappings of every rank's signal / buffer.
+ * This class does not own any memory.
+ */
+class ShmAllgather {
+ public:
+  int rank_;
+  int world_size_;
+  ShmSignal* signals_[8];
+  ShmSignal* self_sg_;
+  // Stores an map from a pointer to its peer pointers from all ranks.
+  std::unordered_map<void*, std::vector<void*>> buffers_;
+
+  ShmAllgather(ShmSignal** signals, int rank, int world_size)
+      : rank_(rank), world_size_(world_size), self_sg_(signals[rank]) {
+    for (int i = 0; i < world_size_; i++) {
+      signals_[i] = signals[i];
+    }
+  }
+
+  void register_buffer(void** ptrs) {
+    buffers_[ptrs[rank_]] = std::vector<void*>(ptrs, ptrs + world_size_);
+  }
+
+  const std::vector<void*>& peer_buffers(void* buffer) const {
+    auto it = buffers_.find(buffer);
+    if (it == buffers_.end())
+      throw std::runtime_error(
+          "buffer address " +
+          std::to_string(reinterpret_cast<uint64_t>(buffer)) +
+          " is not registered!");
+    return it->second;
+  }
+
+  /**
+   * Same counter protocol as multi_gpu_barrier with a memory fence: writes
+   * issued before the barrier are visible to all peers after it.
+   */
+  void barrier() {
+    for (int peer = 0; peer < world_size_; peer++) {
+      uint32_t val = ++self_sg_->self_counter[peer];
+      __atomic_store_n(&signals_[peer]->peer_counter[val % 2][rank_], val,
+                       __ATOMIC_RELEASE);
+    }
+    for (int peer = 0; peer < world_size_; peer++) {
+      uint32_t val = self_sg_->self_counter[peer];
+      uint32_t* flag = &self_sg_->peer_counter[val % 2][peer];
+      for (int spin = 0; __atomic_load_n(flag, __ATOMIC_ACQUIRE) != val;
+           spin++) {
+        if (spin > 1024) std::this_thread::yield();
+      }
+    }
+  }
+
+  /**
+   * Performs allgather, assuming input has already been registered.
+   * output is [world_size, bytes] ordered by rank.
+   */
+  void allgather(void* input, void* output, size_t bytes) {
+    const auto& ptrs = peer_buffers(input);
+    barrier();
+    for (int r = 0; r < world_size_; r++) {
+      std::memcpy(static_cast<char*>(output) + r * bytes, ptrs[r], bytes);
+    }
+    // peers may overwrite their buffer once everyone has finished reading.
+    barrier();
+  }
+};
+
+}  // namespace lightllm
@@ -0,0 +1,103 @@
+#include <ATen/cuda/Exceptions.h>
+#include <c10/cuda/CUDAGuard.h>
+#include <c10/cuda/CUDAStream.h>
+#include <torch/all.h>
+
+#include "ops_common.h"
+#include "all_gather.cuh"
+
+namespace lightllm {
+namespace ops {
+// Fake pointer type, same as all_gather.cu.
+using fptr_t = int64_t;
+
+/**
+ * Vocab parallel embedding lookup fused with the cross-rank exchange.
+ *
+ * weight is this rank's shard [num_local_rows, hidden] covering token ids
+ * [rank * vocab_per_rank, rank * vocab_per_rank + num_local_rows). ids are the
+ * same on every rank. Every rank writes the rows it owns into the registered
+ * buffer _reg_buffer, then gathers all other rows from their owners, so out
+ * holds the full [num_tokens, hidden] embedding on every rank without an
+ * all-reduce. Ids outside of all shards produce zero rows.
+ *
+ * For CPU tensors _fa must come from init_shm_gather and _reg_buffer must be
+ * registered with shm_gather_register_buffer.
+ */
+void vocab_parallel_embedding(fptr_t _fa, torch::Tensor& out,
+                              const torch::Tensor& ids,
+                              const torch::Tensor& weight, fptr_t _reg_buffer,
+                              int64_t reg_buffer_sz_bytes,
+                              int64_t vocab_per_rank) {
+  TORCH_CHECK(ids.dim() == 1 && ids.scalar_type() == at::ScalarType::Long &&
+                  ids.is_contiguous(),
+              "ids must be a contiguous 1D int64 tensor");
+  TORCH_CHECK(weight.dim() == 2 && weight.is_contiguous(),
+              "weight must be a contiguous 2D tensor");
+  TORCH_CHECK(out.is_contiguous() && out.dim() == 2);
+  TORCH_CHECK_EQ(out.size(0), ids.size(0));
+  TORCH_CHECK_EQ(out.size(1), weight.size(1));
+  TORCH_CHECK_EQ(out.scalar_type(), weight.scalar_type());
+  TORCH_CHECK(vocab_per_rank > 0);
+  TORCH_CHECK(_reg_buffer != 0, "a registered buffer is required");
+  TORCH_CHECK_LE(out.numel() * out.element_size(), reg_buffer_sz_bytes);
+  TORCH_CHECK(ids.device() == weight.device() && out.device() == weight.device(),
+              "ids, out and weight must be on the same device");
+
+  if (weight.is_cpu()) {
+    vocab_parallel_embedding_cpu(_fa, out, ids, weight, _reg_buffer,
+                                 vocab_per_rank);
+    return;
+  }
+
+  auto fa = reinterpret_cast<vllm::CustomAllgather*>(_fa);
+  const at::cuda::OptionalCUDAGuard device_guard(device_of(weight));
+  auto stream = c10::cuda::getCurrentCUDAStream().stream();
+  auto reg_buffer = reinterpret_cast<void*>(_reg_buffer);
+  cudaPointerAttributes attr;
+  AT_CUDA_CHECK(cudaPointerGetAttributes(&attr, reg_buffer));
+  TORCH_CHECK(attr.type == cudaMemoryTypeDevice &&
+                  attr.device == weight.get_device(),
+              "the registered buffer must be on the device of weight");
+  const int num_tokens = ids.size(0);
+  const int hidden = weight.size(1);
+  const int64_t num_local_rows = weight.size(0);
+
+  switch (out.scalar_type()) {
+    case at::ScalarType::Float: {
+      fa->vocab_parallel_embedding<float>(
+          stream, ids.data_ptr<int64_t>(),
+          reinterpret_cast<float*>(weight.data_ptr()),
+          reinterpret_cast<float*>(reg_buffer),
+          reinterpret_cast<float*>(out.data_ptr()), num_tokens, hidden,
+          num_local_rows, vocab_per_rank);
+      break;
+    }
+    case at::ScalarType::Half: {
+      fa->vocab_parallel_embedding<half>(
+          stream, ids.data_ptr<int64_t>(),
+          reinterpret_cast<half*>(weight.data_ptr()),
+          reinterpret_cast<half*>(reg_buffer),
+          reinterpret_cast<half*>(out.data_ptr()), num_tokens, hidden,
+          num_local_rows, vocab_per_rank);
+      break;
+    }
+#if (__CUDA_ARCH__ >= 800 || !defined(__CUDA_ARCH__))
+    case at::ScalarType::BFloat16: {
+      fa->vocab_parallel_embedding<nv_bfloat16>(
+          stream, ids.data_ptr<int64_t>(),
+          reinterpret_cast<nv_bfloat16*>(weight.data_ptr()),
+          reinterpret_cast<nv_bfloat16*>(reg_buffer),
+          reinterpret_cast<nv_bfloat16*>(out.data_ptr()), num_tokens, hidden,
+          num_local_rows, vocab_per_rank);
+      break;
+    }
+#endif
+    default:
+      throw std::runtime_error(
+          "vocab parallel embedding only supports float32, float16 and bfloat16");
+  }
+}
+
+} // namespace ops
+} // namespace lightllm
@@ -0,0 +1,63 @@
+#include "ops_common.h"
+
+#include <cstring>
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+/**
+ * @brief Work list of mixed_int8kv_attention, see core::plan_mixed_attention.
+ *
+ * @param cu_q_lens  [B + 1] int32 CPU prefix sums of the query lengths.
+ * @param b_seq_len  [B] int32 CPU sequence lengths, including the queries.
+ * @return           [n, 4] int32 CPU units of (batch, kv_head, q_begin, q_end).
+ */
+Tensor plan_mixed_attention(
+    const Tensor& cu_q_lens, const Tensor& b_seq_len, int64_t num_heads, int64_t num_kv_heads
+) {
+    TORCH_CHECK(cu_q_lens.is_cpu() && cu_q_lens.scalar_type() == torch::kInt32, "cu_q_lens must be an int32 CPU tensor");
+    TORCH_CHECK(b_seq_len.is_cpu() && b_seq_len.scalar_type() == torch::kInt32, "b_seq_len must be an int32 CPU tensor");
+    TORCH_CHECK(cu_q_lens.numel() == b_seq_len.numel() + 1, "cu_q_lens must be [B + 1]");
+    Tensor cu = cu_q_lens.contiguous();
+    Tensor lens = b_seq_len.contiguous();
+    std::vector<core::MixedAttentionWork> work;
+    core::plan_mixed_attention(
+        cu.data_ptr<int32_t>(), lens.data_ptr<int32_t>(), lens.numel(), num_heads, num_kv_heads, &work
+    );
+    Tensor out = torch::empty({static_cast<int64_t>(work.size()), 4}, torch::kInt32);
+    if (!work.empty()) std::memcpy(out.data_ptr<int32_t>(), work.data(), work.size() * sizeof(core::MixedAttentionWork));
+    return out;
+}
+
+/**
+ * @brief PyTorch entry of core::mixed_int8kv_attention, writes o in place.
+ * With page_precision the tagged pages are read as kv_downgrade_pages packed them.
+ */
+void mixed_int8kv_attention(
+    Tensor o,
+    Tensor q,
+    Tensor k,
+    Tensor k_s,
+    Tensor v,
+    Tensor v_s,
+    Tensor req_to_tokens,
+    Tensor b_req_idx,
+    Tensor b_seq_len,
+    Tensor cu_q_lens,
+    Tensor work,
+    c10::optional<Tensor> const& page_precision,
+    int64_t page_size)
+{
+    core::mixed_int8kv_attention(
+        to_view(o), to_view(q),
+        to_view(k), to_view(k_s), to_view(v), to_view(v_s),
+        to_view(req_to_tokens), to_view(b_req_idx), to_view(b_seq_len),
+        to_view(cu_q_lens), to_view(work),
+        page_precision.has_value() ? to_view(*page_precision) : core::TensorView(), page_size
+    );
+}
+
+} // namespace ops
+} // namespace lightllm
@@ -0,0 +1,68 @@
+#include "ops_common.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+/**
+ * @brief PyTorch entry of core::kv_page_minmax_update, refreshes page_min /
+ * page_max ([num_pages, Hkv, D]) for the pages written at slots.
+ */
+void kv_page_minmax_update(
+    Tensor page_min, Tensor page_max, const Tensor& k, const Tensor& k_s, const Tensor& slots, int64_t page_size
+) {
+    Tensor s = slots.is_contiguous() ? slots : slots.contiguous();
+    core::kv_page_minmax_update(to_view(page_min), to_view(page_max), to_view(k), to_view(k_s), to_view(s), page_size);
+}
+
+/**
+ * @brief PyTorch entry of core::quest_select_pages.
+ *
+ * @param max_len_in_batch  Longest request, sizes the page scores.
+ * @return                  [B, Hkv, top_pages] int32 logical pages kept per
+ *                          (request, kv head), -1 padded.
+ */
+Tensor quest_select_pages(
+    const Tensor& q, const Tensor& page_min, const Tensor& page_max,
+    const Tensor& req_to_tokens, const Tensor& b_req_idx, const Tensor& b_seq_len,
+    int64_t page_size, int64_t top_pages, int64_t max_len_in_batch
+) {
+    TORCH_CHECK(page_size > 0 && top_pages > 0, "page_size and top_pages must be positive");
+    const int64_t B = q.size(0);
+    const int64_t Hkv = page_min.size(1);
+    Tensor page_idx = torch::empty({B, Hkv, top_pages}, q.options().dtype(torch::kInt32));
+    Tensor scores = torch::empty({B, Hkv, (max_len_in_batch + page_size - 1) / page_size}, q.options().dtype(torch::kFloat32));
+    core::quest_select_pages(
+        to_view(page_idx), to_view(scores), to_view(q), to_view(page_min), to_view(page_max),
+        to_view(req_to_tokens), to_view(b_req_idx), to_view(b_seq_len), page_size
+    );
+    return page_idx;
+}
+
+/**
+ * @brief PyTorch entry of core::sparse_int8kv_decode_attention, writes o in place.
+ */
+void sparse_int8kv_decode_attention(
+    Tensor o,
+    Tensor q,
+    Tensor k,
+    Tensor k_s,
+    Tensor v,
+    Tensor v_s,
+    Tensor req_to_tokens,
+    Tensor b_req_idx,
+    Tensor b_seq_len,
+    Tensor page_idx,
+    int64_t page_size)
+{
+    core::sparse_int8kv_decode_attention(
+        to_view(o), to_view(q),
+        to_view(k), to_view(k_s), to_view(v), to_view(v_s),
+        to_view(req_to_tokens), to_view(b_req_idx), to_view(b_seq_len),
+        to_view(page_idx), page_size
+    );
+}
+
+} // namespace ops
+} // namespace lightllm
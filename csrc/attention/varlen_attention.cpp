@@ -0,0 +1,32 @@
+#include "ops_common.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+/**
+ * @brief PyTorch entry of core::varlen_attention.
+ *
+ * @param q              [T, H, D] bf16 / fp16, D in {64, 80, 128}.
+ * @param k, v           [T, Hkv, D], H % Hkv == 0.
+ * @param cu_seqlens     [B + 1] int32 prefix sums of the sequence lengths.
+ * @param max_seqlen     Longest sequence of the batch.
+ * @param softmax_scale  Scale of q @ k^T.
+ * @return               [T, H, D] attention output.
+ */
+Tensor varlen_attention(
+    const Tensor& q, const Tensor& k, const Tensor& v, const Tensor& cu_seqlens,
+    const int64_t max_seqlen, const double softmax_scale
+) {
+    Tensor cu = cu_seqlens.is_contiguous() ? cu_seqlens : cu_seqlens.contiguous();
+    Tensor out = torch::empty(q.sizes(), q.options());
+    core::varlen_attention(
+        to_view(out), to_view(q), to_view(k), to_view(v), to_view(cu),
+        max_seqlen, static_cast<fp32_t>(softmax_scale)
+    );
+    return out;
+}
+
+} // namespace ops
+} // namespace lightllm
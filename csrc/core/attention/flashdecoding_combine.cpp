@@ -0,0 +1,183 @@
+#include "core/ops.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+constexpr fp32_t kFp8E4M3Max = 448.0f;
+
+/**
+ * @brief Merge the seq blocks of one token, all heads, into fp32 out [H, D]:
+ * every block holds its softmax normalised output and the log-sum-exp of its
+ * scores, so the blocks are weighted by exp(lse - max lse).
+ */
+template<typename T>
+void combine_token(
+    const int64_t b, const TensorView& mid_o_emb, const TensorView& mid_o_logexpsum,
+    const int64_t num_blocks, fp32_t* out
+) {
+    const int64_t H = mid_o_emb.size(1);
+    const int64_t D = mid_o_emb.size(3);
+    std::vector<fp32_t> w(num_blocks);
+    for (int64_t h = 0; h < H; h++) {
+        const T* lse = mid_o_logexpsum.data_ptr<const T>() + b * mid_o_logexpsum.stride(0)
+                     + h * mid_o_logexpsum.stride(1);
+        fp32_t m = -std::numeric_limits<fp32_t>::infinity();
+        for (int64_t s = 0; s < num_blocks; s++) m = std::max(m, to_float(lse[s * mid_o_logexpsum.stride(2)]));
+        fp32_t sum = 0.0f;
+        for (int64_t s = 0; s < num_blocks; s++) {
+            w[s] = std::exp(to_float(lse[s * mid_o_logexpsum.stride(2)]) - m);
+            sum += w[s];
+        }
+        fp32_t* acc = out + h * D;
+        std::fill(acc, acc + D, 0.0f);
+        for (int64_t s = 0; s < num_blocks; s++) {
+            const fp32_t ws = w[s] / sum;
+            const T* emb = mid_o_emb.data_ptr<const T>() + b * mid_o_emb.stride(0) + h * mid_o_emb.stride(1)
+                         + s * mid_o_emb.stride(2);
+            for (int64_t d = 0; d < D; d++) acc[d] += ws * to_float(emb[d]);
+        }
+    }
+}
+
+} // namespace
+
+void check_fp8_output(const char* op, const TensorView& o, const TensorView& o_scale) {
+    LK_CHECK(o.dtype == DType::Fp8E4M3, op, ": o must be float8_e4m3fn");
+    LK_CHECK(o.dim() == 3 && o.stride(2) == 1 && o.stride(1) == o.size(2),
+             op, ": an fp8 o must be [B, H, D] with the heads of a token contiguous");
+    LK_CHECK(o_scale.data != nullptr, op, ": an fp8 o needs o_scale");
+    LK_CHECK(o_scale.dtype == DType::Float32 && o_scale.is_contiguous() && o_scale.numel() == o.size(0),
+             op, ": o_scale must be a contiguous fp32 [B] or [B, 1] tensor");
+    LK_CHECK(o_scale.device == o.device && o_scale.device_index == o.device_index,
+             op, ": o_scale must be on the device of o");
+}
+
+/**
+ * @brief Per token FP8 quantization of x [B, H * D] into o, with the scale
+ * rule of per_token_quant_bf16_fp8: absmax / 448 over the whole row.
+ */
+void quantize_rows_fp8_cpu(const fp32_t* x, const TensorView& o, const TensorView& o_scale) {
+    const int64_t rows = o.size(0);
+    const int64_t cols = o.size(1) * o.size(2);
+    const CpuKernels& kernels = cpu_kernels();
+    parallel_for(0, rows, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t r = begin; r < end; r++) {
+            const fp32_t* row = x + r * cols;
+            const fp32_t scale = kernels.absmax(row, cols) / kFp8E4M3Max;
+            const fp32_t inv_scale = 1.0f / (scale + 1e-7f);
+            kernels.float_to_fp8(row, inv_scale, o.data_ptr<host_fp8_e4m3_t>() + r * o.stride(0), cols);
+            o_scale.data_ptr<fp32_t>()[r] = scale;
+        }
+    });
+}
+
+void flashdecoding_combine_cpu(
+    const TensorView& o, const TensorView& o_scale, const TensorView& mid_o_emb,
+    const TensorView& mid_o_logexpsum, const TensorView& b_seq_len, const int64_t seq_block_size
+) {
+    const int64_t B = o.size(0);
+    const int64_t H = o.size(1);
+    const int64_t D = o.size(2);
+    const bool fp8 = o.dtype == DType::Fp8E4M3;
+    const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+    std::vector<fp32_t> staging(fp8 ? B * H * D : 0);
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        parallel_for(0, B, 1, [&](int64_t begin, int64_t end) {
+            std::vector<fp32_t> token(H * D);
+            for (int64_t b = begin; b < end; b++) {
+                const int64_t num_blocks = (lens[b] + seq_block_size - 1) / seq_block_size;
+                fp32_t* out = fp8 ? staging.data() + b * H * D : token.data();
+                combine_token<T>(b, mid_o_emb, mid_o_logexpsum, num_blocks, out);
+                if (fp8) continue;
+                for (int64_t h = 0; h < H; h++) {
+                    T* dst = o.data_ptr<T>() + b * o.stride(0) + h * o.stride(1);
+                    for (int64_t d = 0; d < D; d++) dst[d] = from_float<T>(out[h * D + d]);
+                }
+            }
+        });
+    };
+
+    switch (mid_o_emb.dtype) {
+        case DType::BFloat16: run(host_bf16_t{}); break;
+        case DType::Float16: run(host_fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("flashdecoding_combine does not support ", dtype_name(mid_o_emb.dtype));
+    }
+    if (fp8) quantize_rows_fp8_cpu(staging.data(), o, o_scale);
+}
+
+/**
+ * @brief Second stage of flash decoding: merge the per seq block outputs of
+ * group8_int8kv_flashdecoding_stage1 into the attention output. With an
+ * fp8 o it also quantizes every token over all of its heads, so the result
+ * feeds cutlass_scaled_mm (o_proj) without a per_token_quant launch.
+ *
+ * @param o                [B, H, D] output, dtype of the mids or fp8_e4m3.
+ * @param o_scale          [B] / [B, 1] fp32 per token scales when o is fp8,
+ *                         else an empty view.
+ * @param mid_o_emb        [B, H, num_blocks, D] bf16 / fp16 normalised block outputs.
+ * @param mid_o_logexpsum  [B, H, num_blocks] log-sum-exp of the block scores.
+ * @param b_seq_len        [B] int32 lengths, 1..num_blocks * seq_block_size.
+ * @param seq_block_size   Tokens per block of stage1.
+ */
+void flashdecoding_combine(
+    const TensorView& o, const TensorView& o_scale, const TensorView& mid_o_emb,
+    const TensorView& mid_o_logexpsum, const TensorView& b_seq_len, const int64_t seq_block_size
+) {
+    LK_CHECK(mid_o_emb.dim() == 4 && mid_o_logexpsum.dim() == 3 && o.dim() == 3,
+             "mid_o_emb must be [B, H, blocks, D], mid_o_logexpsum [B, H, blocks] and o [B, H, D]");
+    LK_CHECK(mid_o_emb.dtype == DType::BFloat16 || mid_o_emb.dtype == DType::Float16,
+             "mid_o_emb must be bf16 or fp16");
+    LK_CHECK(mid_o_logexpsum.dtype == mid_o_emb.dtype, "mid_o_logexpsum must have the dtype of mid_o_emb");
+    const int64_t B = mid_o_emb.size(0);
+    const int64_t H = mid_o_emb.size(1);
+    const int64_t num_blocks = mid_o_emb.size(2);
+    const int64_t D = mid_o_emb.size(3);
+    LK_CHECK(mid_o_emb.stride(3) == 1, "the head dim of mid_o_emb must be contiguous");
+    LK_CHECK(mid_o_logexpsum.size(0) == B && mid_o_logexpsum.size(1) == H && mid_o_logexpsum.size(2) == num_blocks,
+             "mid_o_logexpsum must be [B, H, blocks]");
+    LK_CHECK(o.size(0) == B && o.size(1) == H && o.size(2) == D, "o must be [B, H, D]");
+    if (o.dtype == DType::Fp8E4M3) {
+        check_fp8_output("flashdecoding_combine", o, o_scale);
+    } else {
+        LK_CHECK(o.dtype == mid_o_emb.dtype && o.stride(2) == 1,
+                 "o must have the dtype of mid_o_emb (or be fp8_e4m3) and a contiguous head dim");
+    }
+    LK_CHECK(seq_block_size > 0, "seq_block_size must be > 0");
+    LK_CHECK(b_seq_len.dtype == DType::Int32 && b_seq_len.is_contiguous() && b_seq_len.numel() == B,
+             "b_seq_len must be a contiguous int32 [B] tensor");
+    for (const TensorView* t : {&o, &mid_o_logexpsum, &b_seq_len}) {
+        LK_CHECK(t->device == mid_o_emb.device && t->device_index == mid_o_emb.device_index,
+                 "all tensors must be on the device of mid_o_emb");
+    }
+    if (B == 0) return;
+
+    if (mid_o_emb.is_cpu()) {
+        const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+        for (int64_t b = 0; b < B; b++) {
+            LK_CHECK(lens[b] >= 1 && lens[b] <= num_blocks * seq_block_size,
+                     "b_seq_len[", b, "] = ", lens[b], " is out of range");
+        }
+        flashdecoding_combine_cpu(o, o_scale, mid_o_emb, mid_o_logexpsum, b_seq_len, seq_block_size);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    flashdecoding_combine_cuda(o, o_scale, mid_o_emb, mid_o_logexpsum, b_seq_len, seq_block_size);
+#else
+    LK_NOT_SUPPORTED("flashdecoding_combine: the core library was built without CUDA");
+#endif
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,136 @@
+#include "core/ops.h"
+#include "utils.h"
+#include "fp8_out.cuh"
+
+#include <cfloat>
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+namespace {
+
+constexpr int32_t kTPB = 256;
+constexpr int64_t kMaxShmSize = 48 * 1024;
+
+/**
+ * @brief Flash decoding stage 2, one block per token over all of its heads:
+ * a warp per head turns the block log-sum-exps into normalised weights in
+ * shared memory, then every thread merges elements of the [H, D] output.
+ * FP8_OUT keeps the merged fp32 token in shared memory and quantizes it with
+ * one scale, which needs the whole token in the block.
+ *
+ * dynamic smem: H * num_blocks weights (+ H * D fp32 for FP8_OUT)
+ */
+template<bool FP8_OUT, typename T>
+__global__ __launch_bounds__(kTPB)
+void device_flashdecoding_combine(
+    T* __restrict__ output, fp8_e4m3_t* __restrict__ output_fp8, fp32_t* __restrict__ output_scale,
+    const T* __restrict__ mid_o_emb, const T* __restrict__ mid_o_logexpsum,
+    const int32_t* __restrict__ b_seq_len, const int64_t seq_block_size,
+    const int64_t H, const int64_t D, const int64_t max_blocks,
+    const int64_t output_stride_b, const int64_t output_stride_h,
+    const int64_t emb_stride_b, const int64_t emb_stride_h, const int64_t emb_stride_s,
+    const int64_t lse_stride_b, const int64_t lse_stride_h, const int64_t lse_stride_s
+) {
+    constexpr int32_t WARP_SIZE = 32;
+    extern __shared__ fp32_t combine_smem[];
+    fp32_t* weights = combine_smem;                   // [H, max_blocks]
+    fp32_t* token = combine_smem + H * max_blocks;    // [H, D], FP8_OUT only
+
+    const int64_t b = blockIdx.x;
+    const int64_t num_blocks = (b_seq_len[b] + seq_block_size - 1) / seq_block_size;
+    const int32_t warp_id = threadIdx.x / WARP_SIZE;
+    const int32_t lane = threadIdx.x % WARP_SIZE;
+
+    for (int64_t h = warp_id; h < H; h += kTPB / WARP_SIZE) {
+        const T* lse = mid_o_logexpsum + b * lse_stride_b + h * lse_stride_h;
+        fp32_t m = -FLT_MAX;
+        for (int64_t s = lane; s < num_blocks; s += WARP_SIZE) m = fmaxf(m, static_cast<fp32_t>(lse[s * lse_stride_s]));
+        #pragma unroll
+        for (int32_t mask = WARP_SIZE / 2; mask >= 1; mask /= 2) m = fmaxf(m, __shfl_xor_sync(uint32_t(-1), m, mask));
+        fp32_t sum = 0.0f;
+        for (int64_t s = lane; s < num_blocks; s += WARP_SIZE) {
+            const fp32_t w = __expf(static_cast<fp32_t>(lse[s * lse_stride_s]) - m);
+            weights[h * max_blocks + s] = w;
+            sum += w;
+        }
+        #pragma unroll
+        for (int32_t mask = WARP_SIZE / 2; mask >= 1; mask /= 2) sum += __shfl_xor_sync(uint32_t(-1), sum, mask);
+        const fp32_t inv_sum = 1.0f / sum;
+        for (int64_t s = lane; s < num_blocks; s += WARP_SIZE) weights[h * max_blocks + s] *= inv_sum;
+    }
+    __syncthreads();
+
+    for (int64_t i = threadIdx.x; i < H * D; i += kTPB) {
+        const int64_t h = i / D;
+        const int64_t d = i % D;
+        const T* emb = mid_o_emb + b * emb_stride_b + h * emb_stride_h + d;
+        fp32_t acc = 0.0f;
+        for (int64_t s = 0; s < num_blocks; s++) {
+            acc += weights[h * max_blocks + s] * static_cast<fp32_t>(emb[s * emb_stride_s]);
+        }
+        if constexpr (FP8_OUT) {
+            token[i] = acc;
+        } else {
+            output[b * output_stride_b + h * output_stride_h + d] = static_cast<T>(acc);
+        }
+    }
+
+    if constexpr (FP8_OUT) {
+        __syncthreads();
+        block_quant_row_fp8<kTPB>(
+            [&](int64_t i) { return token[i]; }, H * D,
+            output_fp8 + b * output_stride_b, output_scale + b);
+    }
+}
+
+} // namespace
+
+/**
+ * @brief CUDA backend of core::flashdecoding_combine, the views are already validated.
+ */
+void flashdecoding_combine_cuda(
+    const TensorView& o, const TensorView& o_scale, const TensorView& mid_o_emb,
+    const TensorView& mid_o_logexpsum, const TensorView& b_seq_len, const int64_t seq_block_size
+) {
+    const int64_t B = mid_o_emb.size(0);
+    const int64_t H = mid_o_emb.size(1);
+    const int64_t max_blocks = mid_o_emb.size(2);
+    const int64_t D = mid_o_emb.size(3);
+    const bool fp8 = o.dtype == DType::Fp8E4M3;
+    const int64_t smem = (H * max_blocks + (fp8 ? H * D : 0)) * sizeof(fp32_t);
+    LK_CHECK(smem <= kMaxShmSize, "flashdecoding_combine: ", H, " heads of ", max_blocks, " blocks",
+             fp8 ? " and the fp8 token" : "", " do not fit in shared memory");
+
+    auto run = [&](auto type_tag, auto fp8_out) {
+        using T = decltype(type_tag);
+        constexpr bool FP8_OUT = decltype(fp8_out)::value;
+        device_flashdecoding_combine<FP8_OUT, T>
+        <<<B, kTPB, smem, static_cast<cudaStream_t>(mid_o_emb.stream)>>>(
+            FP8_OUT ? nullptr : o.data_ptr<T>(),
+            FP8_OUT ? o.data_ptr<fp8_e4m3_t>() : nullptr,
+            FP8_OUT ? o_scale.data_ptr<fp32_t>() : nullptr,
+            mid_o_emb.data_ptr<const T>(), mid_o_logexpsum.data_ptr<const T>(),
+            b_seq_len.data_ptr<const int32_t>(), seq_block_size,
+            H, D, max_blocks,
+            o.stride(0), o.stride(1),
+            mid_o_emb.stride(0), mid_o_emb.stride(1), mid_o_emb.stride(2),
+            mid_o_logexpsum.stride(0), mid_o_logexpsum.stride(1), mid_o_logexpsum.stride(2)
+        );
+    };
+    auto dispatch = [&](auto type_tag) {
+        if (fp8) run(type_tag, std::true_type{});
+        else run(type_tag, std::false_type{});
+    };
+
+    switch (mid_o_emb.dtype) {
+        case DType::BFloat16: dispatch(bf16_t{}); break;
+        case DType::Float16: dispatch(fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("flashdecoding_combine does not support ", dtype_name(mid_o_emb.dtype));
+    }
+}
+
+} // namespace core
+} // namespace lightllm
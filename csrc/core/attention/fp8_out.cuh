@@ -0,0 +1,32 @@
+#pragma once
+#include "utils.h"
+#include "reduce/sm70.cuh"
+
+namespace lightllm {
+namespace core {
+
+constexpr fp32_t kFp8E4M3Max = 448.0f;
+
+/**
+ * @brief Block-wide FP8 quantization of one token of n fp32 values, with the
+ * scale rule of per_token_quant_bf16_fp8 (absmax / 448). load(i) returns
+ * value i, so the row may live in shared or global memory.
+ */
+template<int32_t TPB, typename Load>
+__device__ inline
+void block_quant_row_fp8(const Load& load, const int64_t n, fp8_e4m3_t* __restrict__ out, fp32_t* __restrict__ scale) {
+    fp32_t local_max = 0.0f;
+    for (int64_t i = threadIdx.x; i < n; i += TPB) {
+        local_max = fmaxf(local_max, fabsf(load(i)));
+    }
+    const fp32_t amax = reduce::sm70::sync_block_reduce_max_f32<TPB>(local_max);
+    const fp32_t s = amax / kFp8E4M3Max;
+    const fp32_t inv_scale = 1.0f / (s + 1e-7f);
+    for (int64_t i = threadIdx.x; i < n; i += TPB) {
+        out[i] = fp8_e4m3_t(load(i) * inv_scale);
+    }
+    if (threadIdx.x == 0) *scale = s;
+}
+
+} // namespace core
+} // namespace lightllm
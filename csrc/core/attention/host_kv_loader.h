@@ -0,0 +1,81 @@
+#pragma once
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/tensor_view.h"
+
+#include <type_traits>
+
+namespace lightllm {
+namespace core {
+
+// Elements per scale of an int8 / fp8 cache.
+constexpr int64_t kHostKvQuantGroup = 8;
+
+/**
+ * @brief KV cache formats, the host side of kv_loader.cuh: load() writes
+ * the D values of one (slot, kv head) row in fp32. E is the element type,
+ * S the dtype of the group-8 scales, void for an unquantized cache.
+ */
+template<typename E, typename S>
+struct HostKvLoader {
+    static void load(const TensorView& cache, const TensorView& scale, const int64_t slot, const int64_t kv_head,
+                     const int64_t D, fp32_t* out) {
+        const E* x = cache.data_ptr<const E>() + slot * cache.stride(0) + kv_head * cache.stride(1);
+        if constexpr (std::is_same<E, host_bf16_t>::value) {
+            cpu_kernels().bf16_to_float(x, out, D);
+        } else if constexpr (std::is_same<E, host_fp16_t>::value) {
+            cpu_kernels().fp16_to_float(x, out, D);
+        } else {
+            constexpr int64_t G = kHostKvQuantGroup;
+            const S* s = scale.data_ptr<const S>() + slot * scale.stride(0) + kv_head * scale.stride(1);
+            for (int64_t g = 0; g < D / G; g++) {
+                const fp32_t sg = to_float(s[g]);
+                for (int64_t i = 0; i < G; i++) out[g * G + i] = sg * to_float(x[g * G + i]);
+            }
+        }
+    }
+
+    // Half `half` of a row packed by kv_downgrade_pages: int4 for an int8
+    // cache, int8 over the 2 * D bytes of a bf16 / fp16 row otherwise.
+    static void load_packed(const TensorView& cache, const TensorView& scale, const int64_t slot, const int64_t kv_head,
+                            const int64_t D, const int32_t half, fp32_t* out) {
+        const int64_t row = slot * cache.stride(0) + kv_head * cache.stride(1);
+        const uint8_t* x = reinterpret_cast<const uint8_t*>(cache.data_ptr<const E>() + row);
+        // the scales of a downgraded bf16 / fp16 page have the dtype of the cache
+        using P = typename std::conditional<std::is_void<S>::value, E, S>::type;
+        const P* s = scale.data_ptr<const P>() + row / kHostKvQuantGroup + half * D / 16;
+        for (int64_t d = 0; d < D; d++) {
+            int32_t q;
+            if constexpr (std::is_same<E, int8_t>::value) {
+                const uint8_t b = x[half * D / 2 + d / 2];
+                q = static_cast<int32_t>(static_cast<uint32_t>(b) << (d % 2 == 0 ? 28 : 24)) >> 28;
+            } else {
+                q = static_cast<int8_t>(x[half * D + d]);
+            }
+            out[d] = to_float(s[d / 16]) * static_cast<fp32_t>(q);
+        }
+    }
+};
+
+/**
+ * @brief Loads a row through the page_precision tags of KvPageAllocator
+ * (may be empty): slots at or past the cache are the second page of a
+ * downgraded pair, tagged pages are read in the packed format (the host
+ * side of resolve_kv_slot). The caller checks the slots.
+ */
+template<typename KV>
+void load_kv_row(const TensorView& cache, const TensorView& scale, int64_t slot, const int64_t kv_head,
+                 const int64_t D, const TensorView& page_precision, const int64_t page_size, fp32_t* out) {
+    if (page_precision.data != nullptr) {
+        const int32_t half = slot >= cache.size(0);
+        if (half) slot -= cache.size(0);
+        if (page_precision.data_ptr<const int8_t>()[slot / page_size] != 0) {
+            KV::load_packed(cache, scale, slot, kv_head, D, half, out);
+            return;
+        }
+    }
+    KV::load(cache, scale, slot, kv_head, D, out);
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,526 @@
+#include "core/ops.h"
+#include "host_kv_loader.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+constexpr int64_t kQuantGroup = 8;
+// int8 queries are padded to whole 64-byte chunks, see CpuKernels::int8_group8_dot.
+constexpr int64_t kChunk = 64;
+
+/**
+ * @brief One head of q quantized to int8 with a per-head scale, plus what
+ * the VNNI kernel needs: corr[i] = 128 * (sum of the 4 q bytes of int32 lane i).
+ */
+struct Int8Query {
+    fp32_t scale;
+    std::vector<int8_t> q8;     // [padded D]
+    std::vector<int32_t> corr;  // [padded D / 4]
+};
+
+void quantize_query(const fp32_t* q, const int64_t D, Int8Query& out) {
+    const int64_t padded = (D + kChunk - 1) / kChunk * kChunk;
+    fp32_t amax = 0.0f;
+    for (int64_t d = 0; d < D; d++) amax = std::max(amax, std::fabs(q[d]));
+    out.scale = amax > 0.0f ? amax / 127.0f : 1.0f;
+    const fp32_t inv = 1.0f / out.scale;
+    out.q8.assign(padded, 0);
+    out.corr.assign(padded / 4, 0);
+    for (int64_t d = 0; d < D; d++) {
+        out.q8[d] = static_cast<int8_t>(std::nearbyint(std::min(127.0f, std::max(-127.0f, q[d] * inv))));
+        out.corr[d / 4] += 128 * out.q8[d];
+    }
+}
+
+/**
+ * @brief One request and one kv head: the G query heads of the GQA group
+ * share every K / V row load. Two passes like the CUDA kernel: all scores,
+ * softmax, then the probability weighted sum of V.
+ */
+template<typename T, typename KV>
+void decode_kv_head(
+    const int64_t b, const int64_t kv_head, const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const DecodeAttentionOptions& options, const CpuKernels& kernels, fp32_t* staging
+) {
+    const int64_t D = q.size(2);
+    const int64_t G = q.size(1) / k.size(1);
+    const int64_t groups = D / kQuantGroup;
+    const fp32_t att_scale = 1.0f / std::sqrt(static_cast<fp32_t>(D));
+    const int64_t L = b_seq_len.data_ptr<const int32_t>()[b];
+    const int32_t* slots = req_to_tokens.data_ptr<const int32_t>()
+                         + b_req_idx.data_ptr<const int32_t>()[b] * req_to_tokens.stride(0);
+
+    std::vector<fp32_t> q_f(G * D);
+    std::vector<Int8Query> q8(options.int8_qk ? G : 0);
+    for (int64_t h = 0; h < G; h++) {
+        const T* src = q.data_ptr<const T>() + b * q.stride(0) + (kv_head * G + h) * q.stride(1);
+        for (int64_t d = 0; d < D; d++) q_f[h * D + d] = to_float(src[d]);
+        if (options.int8_qk) quantize_query(q_f.data() + h * D, D, q8[h]);
+    }
+
+    std::vector<fp32_t> scores(G * L);
+    std::vector<fp32_t> scale(groups + kQuantGroup);
+    std::vector<fp32_t> row(D);
+    for (int64_t t = 0; t < L; t++) {
+        const int64_t slot = slots[t];
+        if (!options.int8_qk) {
+            load_kv_row<KV>(k, k_s, slot, kv_head, D, options.page_precision, options.page_size, row.data());
+            for (int64_t h = 0; h < G; h++) {
+                scores[h * L + t] = kernels.dot(q_f.data() + h * D, row.data(), D) * att_scale;
+            }
+            continue;
+        }
+        // int8 QK: the raw int8 row and its group scales
+        const int8_t* k8 = k.data_ptr<const int8_t>() + slot * k.stride(0) + kv_head * k.stride(1);
+        const T* ks = k_s.data_ptr<const T>() + slot * k_s.stride(0) + kv_head * k_s.stride(1);
+        for (int64_t g = 0; g < groups; g++) scale[g] = to_float(ks[g]);
+        for (int64_t h = 0; h < G; h++) {
+            const fp32_t dot = kernels.int8_group8_dot(q8[h].q8.data(), q8[h].corr.data(), k8, scale.data(), D);
+            scores[h * L + t] = q8[h].scale * dot * att_scale;
+        }
+    }
+
+    for (int64_t h = 0; h < G; h++) {
+        fp32_t* s = scores.data() + h * L;
+        const fp32_t m = *std::max_element(s, s + L);
+        fp32_t sum = 0.0f;
+        for (int64_t t = 0; t < L; t++) {
+            s[t] = std::exp(s[t] - m);
+            sum += s[t];
+        }
+        const fp32_t inv = 1.0f / sum;
+        for (int64_t t = 0; t < L; t++) s[t] *= inv;
+    }
+
+    if (options.attn_mass.data != nullptr) {
+        const TensorView& mass = options.attn_mass;
+        fp32_t* dst = mass.data_ptr<fp32_t>() + b_req_idx.data_ptr<const int32_t>()[b] * mass.stride(0)
+                    + kv_head * mass.stride(1);
+        for (int64_t h = 0; h < G; h++) {
+            for (int64_t t = 0; t < L; t++) dst[t] += scores[h * L + t];
+        }
+    }
+
+    std::vector<fp32_t> acc(G * D, 0.0f);
+    for (int64_t t = 0; t < L; t++) {
+        load_kv_row<KV>(v, v_s, slots[t], kv_head, D, options.page_precision, options.page_size, row.data());
+        for (int64_t h = 0; h < G; h++) kernels.axpy(scores[h * L + t], row.data(), acc.data() + h * D, D);
+    }
+
+    if (staging != nullptr) {
+        // fp8 o: fp32 [B, H, D], quantized per token once all heads are done
+        std::copy(acc.begin(), acc.end(), staging + (b * q.size(1) + kv_head * G) * D);
+        return;
+    }
+    for (int64_t h = 0; h < G; h++) {
+        T* dst = o.data_ptr<T>() + b * o.stride(0) + (kv_head * G + h) * o.stride(1);
+        for (int64_t d = 0; d < D; d++) dst[d] = from_float<T>(acc[h * D + d]);
+    }
+}
+
+/**
+ * @brief One seq block of one request and kv head for flash decoding stage
+ * 1: decode_kv_head over the tokens of the block, the normalised outputs
+ * and the log-sum-exp of the scores of each head of the GQA group go to
+ * mid_o_emb / mid_o_logexpsum.
+ */
+template<typename T, typename KV>
+void stage1_kv_head_block(
+    const int64_t b, const int64_t kv_head, const int64_t block,
+    const TensorView& mid_o_emb, const TensorView& mid_o_logexpsum, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t seq_block_size, const fp32_t att_scale,
+    const TensorView& page_precision, const int64_t page_size, const CpuKernels& kernels
+) {
+    const int64_t begin = block * seq_block_size;
+    const int64_t L = std::min<int64_t>(b_seq_len.data_ptr<const int32_t>()[b] - begin, seq_block_size);
+    // past the end of the request, flashdecoding_combine does not read the block
+    if (L <= 0) return;
+    const int64_t D = q.size(2);
+    const int64_t G = q.size(1) / k.size(1);
+    const int32_t* slots = req_to_tokens.data_ptr<const int32_t>()
+                         + b_req_idx.data_ptr<const int32_t>()[b] * req_to_tokens.stride(0) + begin;
+
+    std::vector<fp32_t> q_f(G * D);
+    for (int64_t h = 0; h < G; h++) {
+        const T* src = q.data_ptr<const T>() + b * q.stride(0) + (kv_head * G + h) * q.stride(1);
+        for (int64_t d = 0; d < D; d++) q_f[h * D + d] = to_float(src[d]);
+    }
+
+    std::vector<fp32_t> scores(G * L);
+    std::vector<fp32_t> row(D);
+    for (int64_t t = 0; t < L; t++) {
+        load_kv_row<KV>(k, k_s, slots[t], kv_head, D, page_precision, page_size, row.data());
+        for (int64_t h = 0; h < G; h++) scores[h * L + t] = kernels.dot(q_f.data() + h * D, row.data(), D) * att_scale;
+    }
+
+    std::vector<fp32_t> inv_sum(G);
+    for (int64_t h = 0; h < G; h++) {
+        fp32_t* s = scores.data() + h * L;
+        const fp32_t m = *std::max_element(s, s + L);
+        fp32_t sum = 0.0f;
+        for (int64_t t = 0; t < L; t++) {
+            s[t] = std::exp(s[t] - m);
+            sum += s[t];
+        }
+        inv_sum[h] = 1.0f / sum;
+        T* lse = mid_o_logexpsum.data_ptr<T>() + b * mid_o_logexpsum.stride(0)
+               + (kv_head * G + h) * mid_o_logexpsum.stride(1) + block * mid_o_logexpsum.stride(2);
+        *lse = from_float<T>(std::log(sum) + m);
+    }
+
+    std::vector<fp32_t> acc(G * D, 0.0f);
+    for (int64_t t = 0; t < L; t++) {
+        load_kv_row<KV>(v, v_s, slots[t], kv_head, D, page_precision, page_size, row.data());
+        for (int64_t h = 0; h < G; h++) kernels.axpy(scores[h * L + t] * inv_sum[h], row.data(), acc.data() + h * D, D);
+    }
+    for (int64_t h = 0; h < G; h++) {
+        T* dst = mid_o_emb.data_ptr<T>() + b * mid_o_emb.stride(0) + (kv_head * G + h) * mid_o_emb.stride(1)
+               + block * mid_o_emb.stride(2);
+        for (int64_t d = 0; d < D; d++) dst[d] = from_float<T>(acc[h * D + d]);
+    }
+}
+
+/**
+ * @brief Checks shared by decode_attention and flashdecoding_stage1: q, the
+ * KV cache in one of its formats, the page tags and the request tables, all
+ * on the device of q.
+ */
+void check_paged_kv(
+    const char* op, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& page_precision, const int64_t page_size
+) {
+    LK_CHECK(q.dim() == 3 && q.stride(2) == 1, op, ": q must be [B, H, D] with a contiguous head dim");
+    LK_CHECK(q.dtype == DType::BFloat16 || q.dtype == DType::Float16, op, ": q must be bf16 or fp16");
+    const bool quantized = k.dtype == DType::Int8 || k.dtype == DType::Fp8E4M3;
+    LK_CHECK(v.dtype == k.dtype && (quantized || k.dtype == q.dtype),
+             op, ": k and v must both be int8, fp8_e4m3 or the dtype of q");
+    LK_CHECK(k.dim() == 3 && v.dim() == 3 && k.is_contiguous() && v.is_contiguous(),
+             op, ": k and v must be contiguous 3D");
+    const int64_t B = q.size(0);
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    LK_CHECK(D % 8 == 0 && k.size(2) == D && v.size(2) == D, op, ": k and v must be [slots, Hkv, D]");
+    LK_CHECK(v.size(1) == k.size(1) && H % k.size(1) == 0, op, ": the heads of q must be a multiple of the kv heads");
+    if (quantized || page_precision.data != nullptr) {
+        // only the downgraded pages of an unquantized cache are scaled
+        LK_CHECK(k_s.dtype == q.dtype && v_s.dtype == q.dtype, op, ": k_s and v_s must have the dtype of q");
+        LK_CHECK(k_s.dim() == 3 && v_s.dim() == 3 && k_s.is_contiguous() && v_s.is_contiguous(),
+                 op, ": k_s and v_s must be contiguous 3D");
+        LK_CHECK(k_s.size(0) == k.size(0) && v_s.size(0) == v.size(0) && k_s.size(1) == k.size(1) &&
+                 v_s.size(1) == k.size(1) && k_s.size(2) == D / 8 && v_s.size(2) == D / 8,
+                 op, ": the scales of k and v must be [slots, Hkv, D / 8]");
+        for (const TensorView* t : {&k_s, &v_s}) {
+            LK_CHECK(t->device == q.device && t->device_index == q.device_index,
+                     op, ": all tensors must be on the device of q");
+        }
+    } else {
+        LK_CHECK(k_s.data == nullptr && v_s.data == nullptr, op, ": an unquantized KV cache takes no scales");
+    }
+    if (page_precision.data != nullptr) {
+        LK_CHECK(k.dtype != DType::Fp8E4M3, op, ": an fp8 KV cache cannot be downgraded");
+        LK_CHECK(page_size > 0 && k.size(0) % page_size == 0 && D % 16 == 0,
+                 op, ": page_precision needs a page_size dividing the slots and D % 16 == 0");
+        LK_CHECK(page_precision.dtype == DType::Int8 && page_precision.is_contiguous() &&
+                 page_precision.numel() == k.size(0) / page_size,
+                 op, ": page_precision must be a contiguous int8 [num_pages] tensor");
+        LK_CHECK(page_precision.device == q.device && page_precision.device_index == q.device_index,
+                 op, ": all tensors must be on the device of q");
+    }
+    LK_CHECK(req_to_tokens.dtype == DType::Int32 && req_to_tokens.dim() == 2 && req_to_tokens.stride(1) == 1,
+             op, ": req_to_tokens must be a 2D int32 tensor with contiguous rows");
+    LK_CHECK(b_req_idx.dtype == DType::Int32 && b_seq_len.dtype == DType::Int32 &&
+             b_req_idx.is_contiguous() && b_seq_len.is_contiguous(),
+             op, ": b_req_idx and b_seq_len must be contiguous int32");
+    LK_CHECK(b_req_idx.numel() == B && b_seq_len.numel() == B, op, ": b_req_idx and b_seq_len must be [B]");
+    for (const TensorView* t : {&k, &v, &req_to_tokens, &b_req_idx, &b_seq_len}) {
+        LK_CHECK(t->device == q.device && t->device_index == q.device_index,
+                 op, ": all tensors must be on the device of q");
+    }
+}
+
+/**
+ * @brief Host checks of the tables before a CPU launch: lengths 1..max_len,
+ * request rows, and every slot read (virtual slots of downgraded pages
+ * follow the physical ones).
+ */
+void check_paged_slots(
+    const char* op, const TensorView& k, const TensorView& req_to_tokens, const TensorView& b_req_idx,
+    const TensorView& b_seq_len, const TensorView& page_precision, const int64_t max_len
+) {
+    const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+    const int32_t* reqs = b_req_idx.data_ptr<const int32_t>();
+    const int64_t num_slots = page_precision.data != nullptr ? 2 * k.size(0) : k.size(0);
+    for (int64_t b = 0; b < b_seq_len.numel(); b++) {
+        LK_CHECK(lens[b] >= 1 && lens[b] <= max_len, op, ": b_seq_len[", b, "] = ", lens[b], " is out of range");
+        LK_CHECK(reqs[b] >= 0 && reqs[b] < req_to_tokens.size(0),
+                 op, ": b_req_idx[", b, "] = ", reqs[b], " is out of range");
+        const int32_t* slots = req_to_tokens.data_ptr<const int32_t>() + reqs[b] * req_to_tokens.stride(0);
+        for (int64_t t = 0; t < lens[b]; t++) {
+            LK_CHECK(slots[t] >= 0 && slots[t] < num_slots, op, ": slot ", slots[t], " is out of range");
+        }
+    }
+}
+
+} // namespace
+
+void decode_attention_cpu(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const DecodeAttentionOptions& options
+) {
+    (void)max_len_in_batch;
+    const int64_t B = b_seq_len.size(0);
+    const int64_t kv_heads = k.size(1);
+    const CpuKernels& kernels = cpu_kernels();
+    const bool fp8 = o.dtype == DType::Fp8E4M3;
+    std::vector<fp32_t> staging(fp8 ? o.numel() : 0);
+
+    auto run = [&](auto type_tag, auto kv_tag) {
+        using T = decltype(type_tag);
+        using KV = decltype(kv_tag);
+        parallel_for(0, B * kv_heads, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t task = begin; task < end; task++) {
+                decode_kv_head<T, KV>(task / kv_heads, task % kv_heads, o, q, k, k_s, v, v_s,
+                                  req_to_tokens, b_req_idx, b_seq_len, options, kernels,
+                                  fp8 ? staging.data() : nullptr);
+            }
+        });
+    };
+
+    auto dispatch = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        switch (k.dtype) {
+            case DType::Int8: run(type_tag, HostKvLoader<int8_t, T>{}); break;
+            case DType::Fp8E4M3: run(type_tag, HostKvLoader<host_fp8_e4m3_t, T>{}); break;
+            default: run(type_tag, HostKvLoader<T, void>{}); break;
+        }
+    };
+    switch (q.dtype) {
+        case DType::BFloat16: dispatch(host_bf16_t{}); break;
+        case DType::Float16: dispatch(host_fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("decode_attention does not support ", dtype_name(q.dtype));
+    }
+    if (fp8) quantize_rows_fp8_cpu(staging.data(), o, options.o_scale);
+}
+
+/**
+ * @brief Size of DecodeAttentionOptions::workspace for an fp8 o on CUDA: one
+ * int32 arrival counter per token, then an fp32 copy of the [B, H, D] output.
+ */
+int64_t int8kv_decode_attention_workspace_bytes(const int64_t batch, const int64_t heads, const int64_t head_dim) {
+    return (batch * 4 + 255) / 256 * 256 + batch * heads * head_dim * 4;
+}
+
+/**
+ * @brief Decode attention, one query token per request, keys and values
+ * found through req_to_tokens. The KV cache is one of
+ *   - int8 with group-8 scales (k_s, v_s [slots, Hkv, D / 8], dtype of q),
+ *   - fp8_e4m3 with the same group-8 scales,
+ *   - unquantized in the dtype of q, k_s and v_s empty.
+ *
+ * @param o                  [B, H, D] output, dtype of q with a contiguous head
+ *                           dim, or fp8_e4m3 with options.o_scale.
+ * @param q                  [B, H, D] bf16 / fp16, head dim contiguous. D is
+ *                           a multiple of 8 on CPU, of 16 up to 1024 on CUDA.
+ * @param k, v               [slots, Hkv, D] contiguous, H % Hkv == 0.
+ * @param k_s, v_s           [slots, Hkv, D / 8] contiguous scales, dtype of q,
+ *                           for an int8 / fp8 cache.
+ * @param req_to_tokens      [max_reqs, max_len] int32 slots of every request.
+ * @param b_req_idx          [B] int32 request rows.
+ * @param b_seq_len          [B] int32 lengths, 1..max_len_in_batch.
+ * @param max_len_in_batch   Longest request, sizes the CUDA shared memory.
+ * @param options            See DecodeAttentionOptions, int8_qk needs an int8 cache.
+ *                           With page_precision the pages it tags are read in
+ *                           the format of kv_downgrade_pages.
+ */
+void decode_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const DecodeAttentionOptions& options
+) {
+    check_paged_kv("decode_attention", q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len,
+                   options.page_precision, options.page_size);
+    LK_CHECK(o.dim() == 3 && o.stride(2) == 1, "o must be [B, H, D] with a contiguous head dim");
+    if (o.dtype == DType::Fp8E4M3) {
+        check_fp8_output("decode_attention", o, options.o_scale);
+    } else {
+        LK_CHECK(o.dtype == q.dtype, "o must have the dtype of q or be fp8_e4m3");
+    }
+    LK_CHECK(!options.int8_qk || k.dtype == DType::Int8, "decode_attention: int8_qk needs an int8 KV cache");
+    LK_CHECK(!options.int8_qk || options.page_precision.data == nullptr,
+             "decode_attention: int8_qk reads no page_precision tags");
+    const int64_t B = q.size(0);
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    LK_CHECK(o.size(0) == B && o.size(1) == H && o.size(2) == D, "o must have the shape of q");
+    LK_CHECK(o.device == q.device && o.device_index == q.device_index, "all tensors must be on the device of q");
+    if (options.attn_mass.data != nullptr) {
+        const TensorView& mass = options.attn_mass;
+        LK_CHECK(mass.dtype == DType::Float32 && mass.dim() == 3 && mass.stride(2) == 1,
+                 "decode_attention: attn_mass must be fp32 [max_reqs, Hkv, max_len] with contiguous rows");
+        LK_CHECK(mass.size(0) >= req_to_tokens.size(0) && mass.size(1) == k.size(1) && mass.size(2) >= req_to_tokens.size(1),
+                 "decode_attention: attn_mass must cover req_to_tokens and every kv head");
+        LK_CHECK(mass.device == q.device && mass.device_index == q.device_index,
+                 "decode_attention: attn_mass must be on the device of q");
+    }
+    if (B == 0) return;
+
+    if (q.is_cpu()) {
+        check_paged_slots("decode_attention", k, req_to_tokens, b_req_idx, b_seq_len, options.page_precision,
+                          req_to_tokens.size(1));
+        decode_attention_cpu(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, max_len_in_batch, options);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    if (o.dtype == DType::Fp8E4M3) {
+        const TensorView& ws = options.workspace;
+        LK_CHECK(ws.data != nullptr && ws.is_contiguous() && ws.device == q.device && ws.device_index == q.device_index,
+                 "decode_attention: an fp8 o needs a contiguous workspace on the device of q");
+        LK_CHECK(ws.numel() * ws.element_size() >= int8kv_decode_attention_workspace_bytes(B, H, D) &&
+                 reinterpret_cast<uintptr_t>(ws.data) % 16 == 0,
+                 "decode_attention: the workspace must be 16-byte aligned with >= ",
+                 int8kv_decode_attention_workspace_bytes(B, H, D), " bytes");
+    }
+    decode_attention_cuda(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, max_len_in_batch, options);
+#else
+    LK_NOT_SUPPORTED("decode_attention: the core library was built without CUDA");
+#endif
+}
+
+void flashdecoding_stage1_cpu(
+    const TensorView& mid_o_emb, const TensorView& mid_o_logexpsum, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const int64_t seq_block_size, const fp32_t att_scale,
+    const TensorView& page_precision, const int64_t page_size
+) {
+    const int64_t B = b_seq_len.size(0);
+    const int64_t kv_heads = k.size(1);
+    const int64_t blocks = (max_len_in_batch + seq_block_size - 1) / seq_block_size;
+    const CpuKernels& kernels = cpu_kernels();
+
+    auto run = [&](auto type_tag, auto kv_tag) {
+        using T = decltype(type_tag);
+        using KV = decltype(kv_tag);
+        parallel_for(0, B * kv_heads * blocks, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t task = begin; task < end; task++) {
+                const int64_t b = task / (kv_heads * blocks);
+                const int64_t kv_head = task / blocks % kv_heads;
+                stage1_kv_head_block<T, KV>(b, kv_head, task % blocks, mid_o_emb, mid_o_logexpsum, q, k, k_s, v, v_s,
+                                            req_to_tokens, b_req_idx, b_seq_len, seq_block_size, att_scale,
+                                            page_precision, page_size, kernels);
+            }
+        });
+    };
+
+    auto dispatch = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        switch (k.dtype) {
+            case DType::Int8: run(type_tag, HostKvLoader<int8_t, T>{}); break;
+            case DType::Fp8E4M3: run(type_tag, HostKvLoader<host_fp8_e4m3_t, T>{}); break;
+            default: run(type_tag, HostKvLoader<T, void>{}); break;
+        }
+    };
+    switch (q.dtype) {
+        case DType::BFloat16: dispatch(host_bf16_t{}); break;
+        case DType::Float16: dispatch(host_fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("flashdecoding_stage1 does not support ", dtype_name(q.dtype));
+    }
+}
+
+/**
+ * @brief First stage of flash decoding: decode attention over every block of
+ * seq_block_size tokens of each request on its own, merged by
+ * flashdecoding_combine. The KV cache and page_precision / page_size are
+ * those of decode_attention. Blocks past the length of a request are not
+ * written.
+ *
+ * @param mid_o_emb          [B, H, blocks, D] softmax normalised block outputs,
+ *                           dtype of q, head dim contiguous.
+ * @param mid_o_logexpsum    [B, H, blocks] log-sum-exp of the scaled block scores.
+ * @param max_len_in_batch   Longest request, blocks >= its seq blocks.
+ * @param seq_block_size     Tokens per block; on CUDA a block's scores live in
+ *                           shared memory.
+ * @param att_scale          Scale of the QK scores, usually 1 / sqrt(D).
+ */
+void flashdecoding_stage1(
+    const TensorView& mid_o_emb, const TensorView& mid_o_logexpsum, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const int64_t seq_block_size, const fp32_t att_scale,
+    const TensorView& page_precision, const int64_t page_size
+) {
+    check_paged_kv("flashdecoding_stage1", q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len,
+                   page_precision, page_size);
+    const int64_t B = q.size(0);
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    LK_CHECK(seq_block_size > 0 && max_len_in_batch >= 0,
+             "flashdecoding_stage1: seq_block_size must be > 0 and max_len_in_batch >= 0");
+    LK_CHECK(mid_o_emb.dim() == 4 && mid_o_logexpsum.dim() == 3,
+             "flashdecoding_stage1: mid_o_emb must be [B, H, blocks, D] and mid_o_logexpsum [B, H, blocks]");
+    const int64_t blocks = mid_o_emb.size(2);
+    LK_CHECK(mid_o_emb.size(0) == B && mid_o_emb.size(1) == H && mid_o_emb.size(3) == D && mid_o_emb.stride(3) == 1,
+             "flashdecoding_stage1: mid_o_emb must be [B, H, blocks, D] with a contiguous head dim");
+    LK_CHECK(mid_o_logexpsum.size(0) == B && mid_o_logexpsum.size(1) == H && mid_o_logexpsum.size(2) == blocks,
+             "flashdecoding_stage1: mid_o_logexpsum must be [B, H, blocks]");
+    LK_CHECK(mid_o_emb.dtype == q.dtype && mid_o_logexpsum.dtype == q.dtype,
+             "flashdecoding_stage1: mid_o_emb and mid_o_logexpsum must have the dtype of q");
+    LK_CHECK(blocks * seq_block_size >= max_len_in_batch,
+             "flashdecoding_stage1: ", blocks, " blocks do not cover max_len_in_batch ", max_len_in_batch);
+    for (const TensorView* t : {&mid_o_emb, &mid_o_logexpsum}) {
+        LK_CHECK(t->device == q.device && t->device_index == q.device_index,
+                 "flashdecoding_stage1: all tensors must be on the device of q");
+    }
+    if (B == 0) return;
+    LK_CHECK(max_len_in_batch > 0, "flashdecoding_stage1: max_len_in_batch must be > 0");
+
+    if (q.is_cpu()) {
+        check_paged_slots("flashdecoding_stage1", k, req_to_tokens, b_req_idx, b_seq_len, page_precision,
+                          std::min(req_to_tokens.size(1), max_len_in_batch));
+        flashdecoding_stage1_cpu(mid_o_emb, mid_o_logexpsum, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len,
+                                 max_len_in_batch, seq_block_size, att_scale, page_precision, page_size);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    flashdecoding_stage1_cuda(mid_o_emb, mid_o_logexpsum, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len,
+                              max_len_in_batch, seq_block_size, att_scale, page_precision, page_size);
+#else
+    LK_NOT_SUPPORTED("flashdecoding_stage1: the core library was built without CUDA");
+#endif
+}
+
+/**
+ * @brief decode_attention over an int8 KV cache with group-8 scales.
+ */
+void int8kv_decode_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const DecodeAttentionOptions& options
+) {
+    LK_CHECK(k.dtype == DType::Int8 && v.dtype == DType::Int8, "k and v must be int8");
+    decode_attention(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, max_len_in_batch, options);
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,661 @@
+#include "core/ops.h"
+#include "utils.h"
+#include "fp8_out.cuh"
+#include "attention/kv_loader.cuh"
+
+#include <cfloat>
+#include <limits>
+#include <type_traits>
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+namespace {
+
+constexpr int64_t kMaxCudaHeadDim = 1024;
+
+template<int32_t THREAD_GROUP_SIZE, int32_t ELEMENT_NUM, typename T>
+__device__ inline
+float attn_thread_group_dot(const T* local_q, const fp32_t* local_k)
+{
+    // Helper function for QK Dot.
+    float qk = 0.0f;
+# pragma unroll
+    for(int32_t i = 0; i < ELEMENT_NUM; i++) {
+        qk += static_cast<float>(local_q[i]) * local_k[i];
+    }
+#pragma unroll
+    for (int32_t mask = THREAD_GROUP_SIZE / 2; mask >= 1; mask /= 2) {
+        qk += __shfl_xor_sync(uint32_t(-1), qk, mask);
+    }
+    return qk;
+}
+
+template<int32_t WPT>
+__device__ inline
+float attn_block_reduce_max(float reducing, float* shared_mem)
+{
+    // Helper function for reduce softmax qkmax.
+    constexpr int32_t WARP_SIZE = 32;
+    const int32_t lane_id = threadIdx.x % WARP_SIZE;
+    const int32_t warp_id = threadIdx.x / WARP_SIZE;
+
+# pragma unroll
+    for (int32_t mask = WARP_SIZE / 2; mask >= 1; mask /= 2) {
+        reducing = fmaxf(reducing, __shfl_xor_sync(uint32_t(-1), reducing, mask));
+    }
+
+    if (lane_id == 0) {
+        shared_mem[warp_id] = reducing;
+    }
+    __syncthreads();
+
+    if (lane_id < WPT) reducing = shared_mem[lane_id];
+    else reducing = -FLT_MAX;
+
+# pragma unroll
+    for (int32_t mask = WPT / 2; mask >= 1; mask /= 2) {
+        reducing = fmaxf(reducing, __shfl_xor_sync(uint32_t(-1), reducing, mask));
+    }
+
+    reducing = __shfl_sync(uint32_t(-1), reducing, 0);
+    return reducing;
+}
+
+template<int32_t WPT>
+__device__ inline
+float attn_block_reduce_sum(float reducing, float *shared_mem)
+{
+    // Helper function for reduce softmax exp sum.
+    constexpr int32_t WARP_SIZE = 32;
+    const int32_t lane_id = threadIdx.x % WARP_SIZE;
+    const int32_t warp_id = threadIdx.x / WARP_SIZE;
+
+# pragma unroll
+    for (int32_t mask = WARP_SIZE / 2; mask >= 1; mask /= 2) {
+        reducing += __shfl_xor_sync(uint32_t(-1), reducing, mask);
+    }
+
+    if (lane_id == 0) shared_mem[warp_id] = reducing;
+    __syncthreads();
+
+    if (lane_id < WPT) reducing = shared_mem[lane_id];
+
+# pragma unroll
+    for (int32_t mask = WPT / 2; mask >= 1; mask /= 2) {
+        reducing += __shfl_xor_sync(uint32_t(-1), reducing, mask);
+    }
+    reducing = __shfl_sync(uint32_t(-1), reducing, 0);
+    return reducing;
+}
+
+/**
+ * @brief Decode attention over a KV cache in the format of KV (see
+ * kv_loader.cuh: int8 or fp8 with group-8 scales, or the dtype of q), one
+ * block per (head, request).
+ *
+ * INT8_QK (int8 KV only) quantizes the query of the head to int8 once
+ * (absmax over the thread group) and computes QK with __dp4a: two dp4a per
+ * 8-element quant group, whose int32 partial sum takes the group's K scale,
+ * instead of dequantizing every K element.
+ *
+ * FP8_OUT writes the fp32 head output to staging instead; the last block of
+ * a token to arrive (counters[batch]) quantizes all heads of the token to
+ * output_fp8 with one scale and resets its counter.
+ *
+ * page_precision (int8 [num_pages] or nullptr) marks the pages packed by
+ * kv_downgrade_pages; slots at or past num_slots are the second page of a
+ * pair, see resolve_kv_slot.
+ *
+ * Flash decoding stage 1 runs it over seq blocks (blockIdx.z): a block
+ * attends over tokens [z * seq_block_size, (z + 1) * seq_block_size) of its
+ * request only, writes its normalised output at block z of output and the
+ * log-sum-exp of its scores to output_logexpsum. Decode is a single block
+ * over the whole request without output_logexpsum.
+ *
+ * A thread group covers HEAD_SIZE elements in vectors of one quant group.
+ * PADDED runs a head_dim (multiple of 8) below HEAD_SIZE: the vectors past
+ * head_dim are not loaded and count as zeros.
+ */
+template<
+    int32_t HEAD_SIZE,
+    int32_t THREAD_GROUP_SIZE,        // how many threads inside a group
+    int32_t TPB,
+    int32_t QUANT_GROUP,
+    bool PADDED,
+    bool INT8_QK,
+    bool FP8_OUT,
+    typename T,
+    typename KV>
+__global__
+void dynamic_batching_decoding_cache_attention_fp16_kernel(
+    T* __restrict__ output,          // [context_lens, num_heads..., head_size]
+
+    const T* __restrict__ query,     // [seq_lens, num_heads..., head_size]
+    const typename KV::elem_t* k_cache,   // [max_token, num_kv_heads, head_size]
+    const T* k_scale,                  // [max_token, num_kv_heads, head_size / quant_group(8)] or nullptr
+    const typename KV::elem_t* v_cache,   // [max_token, num_kv_heads, head_size]
+    const T* v_scale,                  // [max_token, num_kv_heads, head_size / quant_group(8)] or nullptr
+
+    const float attn_scale,
+
+    const int64_t output_stride_s,
+    const int64_t output_stride_h,
+
+    const int64_t query_stride_s,
+    const int64_t query_stride_h,
+
+    const int64_t kcache_stride_s,
+    const int64_t kcache_stride_h,
+
+    const int64_t vcache_stride_s,
+    const int64_t vcache_stride_h,
+
+    const int32_t * __restrict__ b_seq_len,
+    const int32_t * __restrict__ b_req_idx,
+    const int32_t * __restrict__ req_to_tokens,
+    const int64_t req_to_tokens_stride,
+    const int64_t max_len_in_batch,
+    const int64_t gqa_group_size,
+
+    fp8_e4m3_t* __restrict__ output_fp8,  // [context_lens, num_heads * head_size]
+    fp32_t* __restrict__ output_scale,    // [context_lens]
+    fp32_t* staging,                      // [context_lens, num_heads, head_size]
+    int32_t* counters,                    // [context_lens], zero between launches
+
+    fp32_t* attn_mass,                    // [max_reqs, num_kv_heads, max_len] or nullptr
+    const int64_t attn_mass_stride_r,
+    const int64_t attn_mass_stride_h,
+
+    const int8_t* __restrict__ page_precision,  // [num_pages] or nullptr
+    const int64_t page_size,
+    const int64_t num_slots,
+
+    const int64_t seq_block_size,
+    const int64_t output_stride_blk,
+    T* __restrict__ output_logexpsum,     // [context_lens, num_heads, blocks] or nullptr
+    const int64_t logexpsum_stride_s,
+    const int64_t logexpsum_stride_h,
+    const int64_t logexpsum_stride_blk,
+
+    const int64_t head_dim) {             // HEAD_SIZE unless PADDED
+
+    /* --- Decoding Attention Kernel Implementation --- */
+    constexpr int64_t WARP_SIZE = 32;                              // warp size
+    constexpr int64_t WPT       = TPB / WARP_SIZE;                 // warp per thread block， TPB for Thread per block 4, block_size
+    constexpr int64_t GPW       = WARP_SIZE / THREAD_GROUP_SIZE;       // thread group per warp 4
+    constexpr int64_t GPT       = WARP_SIZE / THREAD_GROUP_SIZE * WPT; // thread group per thread block 16
+
+    // const int64_t num_heads     = gridDim.x;
+    const int64_t head_idx      = blockIdx.x;
+    const int64_t batch_idx     = blockIdx.y;
+    const int64_t seq_block_idx = blockIdx.z;
+
+    const int64_t seq_len = b_seq_len[batch_idx];
+    const int64_t cur_req_idx = b_req_idx[batch_idx];
+    const int64_t block_begin = seq_block_idx * seq_block_size;
+    // seq blocks past the end of the request are not written
+    if (seq_len <= block_begin) return;
+    const int32_t * b_start_loc = req_to_tokens + cur_req_idx * req_to_tokens_stride + block_begin;
+
+    constexpr int64_t VEC_SIZE  = 16 / sizeof(T);  // 128 bits, 这个是 cuda 能操作的最大的一个单位的数吧，8
+
+    // ------------------------------------------------ //
+    // Step 1. Load Q into Thread Reg.
+    constexpr int64_t VEC_LEN = (HEAD_SIZE / VEC_SIZE) / THREAD_GROUP_SIZE; // 128 / 8 / 8 = 2
+
+    static_assert((HEAD_SIZE / THREAD_GROUP_SIZE) % VEC_SIZE == 0);
+    static_assert(HEAD_SIZE % THREAD_GROUP_SIZE == 0);
+    static_assert(QUANT_GROUP == 8);
+    static_assert(!INT8_QK || VEC_SIZE == QUANT_GROUP, "one vector of q per quant group");
+    static_assert(!INT8_QK || std::is_same<KV, attention::Int8KvLoader<T>>::value, "int8 QK needs an int8 KV cache");
+
+    constexpr int64_t QUANT_GROUP_SHIFT = 3;
+
+    // The elements in Q, K, and V will be evenly distributed across each thread group.
+    T local_q[VEC_SIZE * VEC_LEN]; // 2 * 8
+
+    const int64_t warp_id       = threadIdx.x / WARP_SIZE;
+    const int64_t warp_lane_id  = threadIdx.x % WARP_SIZE;
+    const int64_t group_id      = warp_lane_id / THREAD_GROUP_SIZE;
+    const int64_t group_lane_id = warp_lane_id % THREAD_GROUP_SIZE;
+    const int64_t kv_head_idx     = head_idx / gqa_group_size;
+
+    const int64_t head_size = PADDED ? head_dim : HEAD_SIZE;
+    // whether vector i of this lane lies inside the head
+    auto in_head = [&](int64_t i) { return !PADDED || (group_lane_id + i * THREAD_GROUP_SIZE) * VEC_SIZE < head_size; };
+
+    #pragma unroll
+    for (int64_t i = 0; i < VEC_LEN; i++) {
+        // copy 128(16 * 8) bits from Q to Local Q
+
+        // 这个地方是错开间隔读取的，不知道如果设置成为连续位置读取会不会一样呢？
+        if (!in_head(i)) {
+            #pragma unroll
+            for (int64_t j = 0; j < VEC_SIZE; j++) local_q[i * VEC_SIZE + j] = static_cast<T>(0.0f);
+            continue;
+        }
+        vec_copy<sizeof(T) * VEC_SIZE>(
+            &query[
+                batch_idx * query_stride_s +
+                head_idx * query_stride_h +
+                (group_lane_id + i * THREAD_GROUP_SIZE) * VEC_SIZE
+            ],
+            &local_q[i * VEC_SIZE]);
+    }
+
+    // int8 copy of the head, 4 values per word, and its scale
+    int32_t local_q8[INT8_QK ? VEC_SIZE * VEC_LEN / 4 : 1];
+    float q_scale = 1.0f;
+    if constexpr (INT8_QK) {
+        float amax = 0.0f;
+        #pragma unroll
+        for (int32_t i = 0; i < VEC_SIZE * VEC_LEN; i++) amax = fmaxf(amax, fabsf(static_cast<float>(local_q[i])));
+        #pragma unroll
+        for (int32_t mask = THREAD_GROUP_SIZE / 2; mask >= 1; mask /= 2) {
+            amax = fmaxf(amax, __shfl_xor_sync(uint32_t(-1), amax, mask));
+        }
+        q_scale = amax > 0.0f ? amax / 127.0f : 1.0f;
+        const float inv_scale = 1.0f / q_scale;
+        #pragma unroll
+        for (int32_t w = 0; w < VEC_SIZE * VEC_LEN / 4; w++) {
+            uint32_t word = 0;
+            #pragma unroll
+            for (int32_t j = 0; j < 4; j++) {
+                const int8_t x = float_to_int8_rn(static_cast<float>(local_q[w * 4 + j]) * inv_scale);
+                word |= static_cast<uint32_t>(static_cast<uint8_t>(x)) << (8 * j);
+            }
+            local_q8[w] = static_cast<int32_t>(word);
+        }
+    }
+
+    // ------------------------------------------------ //
+    // Step 2. Solve QK Dot
+
+    const int64_t context_len = min(seq_len - block_begin, seq_block_size);
+    extern __shared__ float logits[];
+    float qk_max = -FLT_MAX;
+
+    for (int64_t base_id = warp_id * GPW; base_id < context_len; base_id += GPT) {
+        alignas(16) int8_t local_k_quant[INT8_QK ? VEC_SIZE * VEC_LEN : 1];
+        float local_k[VEC_SIZE * VEC_LEN];
+        T local_k_scale[INT8_QK ? VEC_LEN : 1];
+        const int64_t context_id = base_id + group_id;
+
+        // all thread groups within a warp must be launched together.
+        if (context_id >= context_len){
+            memset(local_k, 0, sizeof(local_k));
+            memset(local_k_quant, 0, sizeof(local_k_quant));
+            memset(local_k_scale, 0, sizeof(local_k_scale));
+        } else {
+            const int64_t mem_context_id = *(b_start_loc + context_id);
+            const attention::KvSlot kv = attention::resolve_kv_slot(mem_context_id, page_precision, page_size, num_slots);
+            const int64_t key_row = kv.slot * kcache_stride_s + kv_head_idx * kcache_stride_h;
+            const int64_t key_offset = key_row + group_lane_id * VEC_SIZE;
+            #pragma unroll
+            for (int64_t i = 0; i < VEC_LEN; i++) {
+                const int64_t key_idx = key_offset + i * THREAD_GROUP_SIZE * VEC_SIZE;
+                if constexpr (INT8_QK) {
+                    if (!in_head(i)) {
+                        memset(&local_k_quant[i * VEC_SIZE], 0, VEC_SIZE);
+                        local_k_scale[i] = static_cast<T>(0.0f);
+                        continue;
+                    }
+                    // the raw int8 vector and its group scale feed dp4a
+                    vec_copy<sizeof(int8_t) * VEC_SIZE>(&k_cache[key_idx],  &local_k_quant[i * VEC_SIZE]);
+                    local_k_scale[i] = k_scale[key_idx >> QUANT_GROUP_SHIFT];
+                } else {
+                    if (!in_head(i)) {
+                        #pragma unroll
+                        for (int64_t j = 0; j < VEC_SIZE; j++) local_k[i * VEC_SIZE + j] = 0.0f;
+                        continue;
+                    }
+                    if constexpr (KV::kPackable) {
+                        if (kv.packed) {
+                            KV::template load_packed<VEC_SIZE>(k_cache, k_scale, key_row, key_idx - key_row,
+                                                               head_size, kv.half, &local_k[i * VEC_SIZE]);
+                            continue;
+                        }
+                    }
+                    KV::template load<VEC_SIZE>(k_cache, k_scale, key_idx, &local_k[i * VEC_SIZE]);
+                }
+            }
+        }
+
+        // Ready for QK Dot
+        float qk_dot;
+        if constexpr (INT8_QK) {
+            float qk = 0.0f;
+            const int32_t* k_words = reinterpret_cast<const int32_t*>(local_k_quant);
+            #pragma unroll
+            for (int64_t i = 0; i < VEC_LEN; i++) {
+                int32_t dot = 0;
+                #pragma unroll
+                for (int64_t w = 0; w < VEC_SIZE / 4; w++) {
+                    dot = __dp4a(k_words[i * VEC_SIZE / 4 + w], local_q8[i * VEC_SIZE / 4 + w], dot);
+                }
+                qk += static_cast<float>(dot) * static_cast<float>(local_k_scale[i]);
+            }
+            #pragma unroll
+            for (int32_t mask = THREAD_GROUP_SIZE / 2; mask >= 1; mask /= 2) {
+                qk += __shfl_xor_sync(uint32_t(-1), qk, mask);
+            }
+            qk_dot = attn_scale * q_scale * qk;
+        } else {
+            qk_dot = attn_scale * attn_thread_group_dot<THREAD_GROUP_SIZE, VEC_LEN * VEC_SIZE>(local_q, local_k);
+        }
+
+        if (group_lane_id == 0 && context_id < context_len) {
+            logits[context_id] = qk_dot;
+            qk_max = fmaxf(qk_dot, qk_max);
+        }
+    }
+
+    // ------------------------------------------------ //
+    // Step 3. Softmax
+
+    __shared__ float red_smem[WPT];
+
+    qk_max = attn_block_reduce_max<WPT>(qk_max, red_smem);
+
+    float exp_sum = 0.0f;
+    for (int64_t context_id = threadIdx.x; context_id < context_len; context_id += TPB){
+        logits[context_id] -= qk_max;
+        logits[context_id] = exp(logits[context_id]);
+        exp_sum += logits[context_id];
+    }
+
+    static_assert(WPT == 2 || WPT == 4 || WPT == 8 || WPT == 16 || WPT == 32 || WPT == 64);
+    exp_sum = attn_block_reduce_sum<WPT>(exp_sum, red_smem);
+
+    const float inv_sum = __fdividef(1.f, exp_sum + 1e-6f);
+    // the heads of a GQA group add their probabilities to the same attn_mass row
+    fp32_t* mass = attn_mass == nullptr ? nullptr
+                 : attn_mass + cur_req_idx * attn_mass_stride_r + head_idx / gqa_group_size * attn_mass_stride_h
+                   + block_begin;
+    for (int64_t context_id = threadIdx.x; context_id < context_len; context_id += TPB) {
+        logits[context_id] *= inv_sum;
+        if (mass != nullptr) atomicAdd(mass + context_id, logits[context_id]);
+    }
+    __syncthreads(); // Must have this.
+
+    // ------------------------------------------------ //
+    // Step 4. Solve logits * V
+
+    float local_v[VEC_SIZE * VEC_LEN];
+
+    #pragma unroll
+    for(int32_t i = 0; i < VEC_SIZE * VEC_LEN; i++) {
+        local_v[i] = 0;
+    }
+
+    for (int64_t base_id = warp_id * GPW; base_id < context_len; base_id += GPT) {
+        const int64_t context_id = base_id + group_id;
+        // all thread groups within a warp must be launched together.
+        if (context_id < context_len){
+            const int64_t mem_context_id = *(b_start_loc + context_id);
+            const attention::KvSlot kv = attention::resolve_kv_slot(mem_context_id, page_precision, page_size, num_slots);
+            const int64_t value_row = kv.slot * vcache_stride_s + kv_head_idx * vcache_stride_h;
+            const int64_t value_offset = value_row + group_lane_id * VEC_SIZE;
+            const float p = logits[context_id];
+            #pragma unroll
+            for (int64_t i = 0; i < VEC_LEN; i++) {
+                if (!in_head(i)) continue;
+                const int64_t value_idx = value_offset + i * THREAD_GROUP_SIZE * VEC_SIZE;
+                float value[VEC_SIZE];
+                bool packed = false;
+                if constexpr (KV::kPackable) {
+                    packed = kv.packed;
+                    if (packed) {
+                        KV::template load_packed<VEC_SIZE>(v_cache, v_scale, value_row, value_idx - value_row,
+                                                           head_size, kv.half, value);
+                    }
+                }
+                if (!packed) KV::template load<VEC_SIZE>(v_cache, v_scale, value_idx, value);
+                #pragma unroll
+                for (int64_t j = 0; j < VEC_SIZE; j++) {
+                    local_v[i * VEC_SIZE + j] += value[j] * p;
+                }
+            }
+        }
+    }
+
+    #pragma unroll
+    for (int32_t i = 0; i < VEC_SIZE * VEC_LEN; i++) {
+        #pragma unroll
+        for (int32_t mask = THREAD_GROUP_SIZE; mask <= WARP_SIZE >> 1; mask = mask << 1) {
+            local_v[i] += __shfl_xor_sync(uint32_t(-1), local_v[i], mask);
+        }
+    }
+
+    __syncthreads();
+
+    // do some reuse
+    for (int64_t i = threadIdx.x; i < head_size; i += TPB){
+        logits[i] = 0;
+    }
+
+    __syncthreads();
+
+    if (warp_lane_id < THREAD_GROUP_SIZE) {
+        #pragma unroll
+        for (int32_t i = 0; i < VEC_LEN; i++) {
+            if (!in_head(i)) continue;
+            #pragma unroll
+            for (int32_t j = 0; j < VEC_SIZE; j++) {
+                atomicAdd(
+                    logits + i * THREAD_GROUP_SIZE * VEC_SIZE + warp_lane_id * VEC_SIZE + j,
+                    local_v[i * VEC_SIZE + j]
+                );
+            }
+        }
+    }
+
+    __syncthreads();
+
+    if constexpr (FP8_OUT) {
+        const int64_t num_heads = gridDim.x;
+        fp32_t* token = staging + batch_idx * num_heads * head_size;
+        for (int64_t i = threadIdx.x; i < head_size; i += TPB){
+            token[head_idx * head_size + i] = logits[i];
+        }
+        __threadfence();
+        __syncthreads();
+
+        __shared__ bool is_last;
+        if (threadIdx.x == 0) {
+            is_last = atomicAdd(counters + batch_idx, 1) == num_heads - 1;
+        }
+        __syncthreads();
+        if (!is_last) return;
+
+        // every head of the token is in staging, read it past L1
+        __threadfence();
+        block_quant_row_fp8<TPB>(
+            [&](int64_t i) { return __ldcg(token + i); }, num_heads * head_size,
+            output_fp8 + batch_idx * output_stride_s, output_scale + batch_idx);
+        if (threadIdx.x == 0) counters[batch_idx] = 0;
+    } else {
+        T* out = output + batch_idx * output_stride_s + head_idx * output_stride_h + seq_block_idx * output_stride_blk;
+        for (int64_t i = threadIdx.x; i < head_size; i += TPB){
+            out[i] = static_cast<T>(logits[i]);
+        }
+        if (output_logexpsum != nullptr && threadIdx.x == 0) {
+            output_logexpsum[batch_idx * logexpsum_stride_s + head_idx * logexpsum_stride_h
+                             + seq_block_idx * logexpsum_stride_blk] = static_cast<T>(logf(exp_sum) + qk_max);
+        }
+    }
+}
+
+/**
+ * @brief Seq blocks of a launch: flash decoding stage 1 writes its block
+ * outputs to o ([B, H, blocks, D]) and the log-sum-exps to mid_o_logexpsum,
+ * decode_attention runs one block (size 0, mid_o_logexpsum empty).
+ */
+struct SeqBlocks {
+    int64_t size = 0;
+    TensorView mid_o_logexpsum;
+};
+
+template<int32_t HEAD_SIZE, int32_t THREAD_GROUP_SIZE, bool PADDED, bool INT8_QK, bool FP8_OUT, typename T, typename KV>
+void launch_decode_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const float attn_scale, const int64_t logits_size,
+    const DecodeAttentionOptions& options, const SeqBlocks& blocks
+) {
+    constexpr int32_t TPB = 256;
+    const int64_t batch = b_seq_len.size(0);
+    const bool split = blocks.size > 0;
+    const int64_t block_size = split ? blocks.size : std::numeric_limits<int64_t>::max();
+    const int64_t num_blocks = split ? (max_len_in_batch + block_size - 1) / block_size : 1;
+    const dim3 grid_size = {(unsigned int)q.size(1), (unsigned int)batch, (unsigned int)num_blocks};
+    const TensorView& lse = blocks.mid_o_logexpsum;
+    using E = typename KV::elem_t;
+    // workspace: int32 counters, then the fp32 staging rows (see int8kv_decode_attention_workspace_bytes)
+    char* workspace = static_cast<char*>(options.workspace.data);
+    int32_t* counters = FP8_OUT ? reinterpret_cast<int32_t*>(workspace) : nullptr;
+    fp32_t* staging = FP8_OUT ? reinterpret_cast<fp32_t*>(workspace + (batch * 4 + 255) / 256 * 256) : nullptr;
+    dynamic_batching_decoding_cache_attention_fp16_kernel<HEAD_SIZE, THREAD_GROUP_SIZE, TPB, 8, PADDED, INT8_QK, FP8_OUT, T, KV>
+    <<<grid_size, TPB, logits_size, static_cast<cudaStream_t>(q.stream)>>>
+    (
+        FP8_OUT ? nullptr : o.data_ptr<T>(), q.data_ptr<const T>(),
+        k.data_ptr<const E>(), static_cast<const T*>(k_s.data),
+        v.data_ptr<const E>(), static_cast<const T*>(v_s.data),
+        attn_scale,
+        o.stride(0), o.stride(1),
+        q.stride(0), q.stride(1),
+        k.stride(0), k.stride(1),
+        v.stride(0), v.stride(1),
+        b_seq_len.data_ptr<const int32_t>(), b_req_idx.data_ptr<const int32_t>(),
+        req_to_tokens.data_ptr<const int32_t>(),
+        req_to_tokens.stride(0),
+        max_len_in_batch,
+        q.size(1) / k.size(1),
+        FP8_OUT ? o.data_ptr<fp8_e4m3_t>() : nullptr,
+        FP8_OUT ? options.o_scale.data_ptr<fp32_t>() : nullptr,
+        staging, counters,
+        static_cast<fp32_t*>(options.attn_mass.data),
+        options.attn_mass.data != nullptr ? options.attn_mass.stride(0) : 0,
+        options.attn_mass.data != nullptr ? options.attn_mass.stride(1) : 0,
+        static_cast<const int8_t*>(options.page_precision.data), options.page_size, k.size(0),
+        block_size, split ? o.stride(2) : 0,
+        split ? lse.data_ptr<T>() : nullptr,
+        split ? lse.stride(0) : 0, split ? lse.stride(1) : 0, split ? lse.stride(2) : 0,
+        q.size(2)
+    );
+}
+
+/**
+ * @brief Launches the decode kernel over seq blocks of blocks.size tokens
+ * (or whole requests), the views are already validated; the scores of a
+ * block live in shared memory.
+ */
+void run_decode_attention(
+    const char* op, const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const float attn_scale, const DecodeAttentionOptions& options,
+    const SeqBlocks& blocks
+) {
+    constexpr int64_t WARP_SIZE = 32;
+    constexpr int64_t TPB = 256;
+    constexpr int64_t MAX_SHM_SIZE = 48 * 1024;
+
+    const int64_t head_dim = q.size(2);
+    const int64_t block_tokens = blocks.size > 0 ? blocks.size : max_len_in_batch;
+    constexpr int64_t reduce_shm_size = TPB / WARP_SIZE * sizeof(float);
+    const int64_t logits_size = std::max<int64_t>(block_tokens * sizeof(float), head_dim * sizeof(float));
+    LK_CHECK(reduce_shm_size + logits_size <= MAX_SHM_SIZE,
+             op, ": ", blocks.size > 0 ? "seq_block_size " : "max_len_in_batch ", block_tokens,
+             " does not fit in shared memory", blocks.size > 0 ? "" : ", use the flash decoding kernel");
+    LK_CHECK(head_dim % 16 == 0 && head_dim <= kMaxCudaHeadDim,
+             op, ": CUDA needs a head_dim that is a multiple of 16 up to ", kMaxCudaHeadDim, ", got ", head_dim);
+
+    auto run = [&](auto type_tag, auto kv_tag, auto int8_qk, auto fp8_out) {
+        using T = decltype(type_tag);
+        using KV = decltype(kv_tag);
+        constexpr bool INT8_QK = decltype(int8_qk)::value;
+        constexpr bool FP8_OUT = decltype(fp8_out)::value;
+        auto launch = [&](auto head_size, auto group_size, auto padded) {
+            launch_decode_attention<decltype(head_size)::value, decltype(group_size)::value,
+                                    decltype(padded)::value, INT8_QK, FP8_OUT, T, KV>(
+                o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len,
+                max_len_in_batch, attn_scale, logits_size, options, blocks);
+        };
+        using std::integral_constant;
+        // exact kernels for the common sizes, padded ones (by thread group width) for the rest
+        switch (head_dim) {
+            case 64: launch(integral_constant<int32_t, 64>{}, integral_constant<int32_t, 4>{}, std::false_type{}); return;
+            case 96: launch(integral_constant<int32_t, 96>{}, integral_constant<int32_t, 4>{}, std::false_type{}); return;
+            case 128: launch(integral_constant<int32_t, 128>{}, integral_constant<int32_t, 8>{}, std::false_type{}); return;
+            case 256: launch(integral_constant<int32_t, 256>{}, integral_constant<int32_t, 16>{}, std::false_type{}); return;
+        }
+        if (head_dim <= 128) launch(integral_constant<int32_t, 128>{}, integral_constant<int32_t, 8>{}, std::true_type{});
+        else if (head_dim <= 256) launch(integral_constant<int32_t, 256>{}, integral_constant<int32_t, 16>{}, std::true_type{});
+        else if (head_dim <= 512) launch(integral_constant<int32_t, 512>{}, integral_constant<int32_t, 32>{}, std::true_type{});
+        else if (head_dim <= 768) launch(integral_constant<int32_t, 768>{}, integral_constant<int32_t, 32>{}, std::true_type{});
+        else launch(integral_constant<int32_t, 1024>{}, integral_constant<int32_t, 32>{}, std::true_type{});
+    };
+    auto dispatch_fp8 = [&](auto type_tag, auto kv_tag, auto int8_qk) {
+        if (o.dtype == DType::Fp8E4M3) run(type_tag, kv_tag, int8_qk, std::true_type{});
+        else run(type_tag, kv_tag, int8_qk, std::false_type{});
+    };
+    // int8 QK only exists for the int8 cache
+    auto dispatch = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        if (k.dtype == DType::Int8 && options.int8_qk) dispatch_fp8(type_tag, attention::Int8KvLoader<T>{}, std::true_type{});
+        else if (k.dtype == DType::Int8) dispatch_fp8(type_tag, attention::Int8KvLoader<T>{}, std::false_type{});
+        else if (k.dtype == DType::Fp8E4M3) dispatch_fp8(type_tag, attention::Fp8KvLoader<T>{}, std::false_type{});
+        else dispatch_fp8(type_tag, attention::HalfKvLoader<T>{}, std::false_type{});
+    };
+
+    switch (q.dtype) {
+        case DType::Float16: dispatch(fp16_t{}); break;
+        case DType::BFloat16: dispatch(bf16_t{}); break;
+        default: LK_NOT_SUPPORTED(op, " does not support ", dtype_name(q.dtype));
+    }
+}
+
+} // namespace
+
+/**
+ * @brief CUDA backend of core::decode_attention, the views are already validated.
+ */
+void decode_attention_cuda(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const DecodeAttentionOptions& options
+) {
+    const float attn_scale = 1.0f / std::sqrt(static_cast<float>(q.size(2)));
+    run_decode_attention("decode_attention", o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len,
+                         max_len_in_batch, attn_scale, options, SeqBlocks());
+}
+
+/**
+ * @brief CUDA backend of core::flashdecoding_stage1: the decode kernel with
+ * a block per (head, request, seq block).
+ */
+void flashdecoding_stage1_cuda(
+    const TensorView& mid_o_emb, const TensorView& mid_o_logexpsum, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const int64_t seq_block_size, const fp32_t att_scale,
+    const TensorView& page_precision, const int64_t page_size
+) {
+    DecodeAttentionOptions options;
+    options.page_precision = page_precision;
+    options.page_size = page_size;
+    SeqBlocks blocks;
+    blocks.size = seq_block_size;
+    blocks.mid_o_logexpsum = mid_o_logexpsum;
+    run_decode_attention("flashdecoding_stage1", mid_o_emb, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len,
+                         max_len_in_batch, att_scale, options, blocks);
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,297 @@
+#include "core/ops.h"
+#include "host_kv_loader.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+// Keys per tile of the host kernel.
+constexpr int64_t kBlockN = 64;
+
+/**
+ * @brief One work unit: its G * tokens query rows against the keys of the
+ * request up to the last row's position, with the online softmax of
+ * varlen_attention. Every K / V tile is dequantized once for all rows; a
+ * row stops at its own position (causal), so the decode row of a request
+ * (q_len 1) sees the whole sequence.
+ */
+template<typename T>
+void mixed_work(
+    const MixedAttentionWork& w, const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int32_t* cu, const TensorView& page_precision, const int64_t page_size, std::vector<fp32_t>& scratch
+) {
+    using KV = HostKvLoader<int8_t, T>;
+    const int64_t D = q.size(2);
+    const int64_t G = q.size(1) / k.size(1);
+    const int64_t rows = (w.q_end - w.q_begin) * G;
+    const fp32_t scale = 1.0f / std::sqrt(static_cast<fp32_t>(D));
+    // first query token of the request sits at this position of its sequence
+    const int64_t start = b_seq_len.data_ptr<const int32_t>()[w.batch] - (cu[w.batch + 1] - cu[w.batch]);
+    const int64_t kv_len = start + w.q_end - cu[w.batch];
+    const int32_t* slots = req_to_tokens.data_ptr<const int32_t>()
+                         + b_req_idx.data_ptr<const int32_t>()[w.batch] * req_to_tokens.stride(0);
+
+    scratch.resize(rows * D * 2 + kBlockN * D * 2 + rows * (kBlockN + 2) + D);
+    const CpuKernels& kernels = cpu_kernels();
+    fp32_t* q_f = scratch.data();            // [rows, D], pre-scaled
+    fp32_t* acc = q_f + rows * D;            // [rows, D]
+    fp32_t* k_t = acc + rows * D;            // [D, N]
+    fp32_t* v_f = k_t + kBlockN * D;         // [N, D]
+    fp32_t* s = v_f + kBlockN * D;           // [rows, N]
+    fp32_t* row_max = s + rows * kBlockN;    // [rows]
+    fp32_t* row_sum = row_max + rows;        // [rows]
+    fp32_t* k_row = row_sum + rows;          // [D]
+
+    auto token = [&](int64_t r) { return w.q_begin + r / G; };
+    auto head = [&](int64_t r) { return w.kv_head * G + r % G; };
+    for (int64_t r = 0; r < rows; r++) {
+        const T* src = q.data_ptr<const T>() + token(r) * q.stride(0) + head(r) * q.stride(1);
+        for (int64_t d = 0; d < D; d++) q_f[r * D + d] = to_float(src[d]) * scale;
+        row_max[r] = -std::numeric_limits<fp32_t>::infinity();
+        row_sum[r] = 0.0f;
+    }
+    std::fill(acc, acc + rows * D, 0.0f);
+
+    for (int64_t j0 = 0; j0 < kv_len; j0 += kBlockN) {
+        const int64_t n = std::min(kBlockN, kv_len - j0);
+        for (int64_t j = 0; j < n; j++) {
+            load_kv_row<KV>(k, k_s, slots[j0 + j], w.kv_head, D, page_precision, page_size, k_row);
+            load_kv_row<KV>(v, v_s, slots[j0 + j], w.kv_head, D, page_precision, page_size, v_f + j * D);
+            for (int64_t d = 0; d < D; d++) k_t[d * kBlockN + j] = k_row[d];
+        }
+
+        for (int64_t r = 0; r < rows; r++) {
+            // keys up to the row's own position
+            const int64_t pos = start + token(r) - cu[w.batch];
+            const int64_t valid = std::min(n, pos + 1 - j0);
+            if (valid <= 0) continue;
+            fp32_t* s_r = s + r * kBlockN;
+            std::fill(s_r, s_r + valid, 0.0f);
+            for (int64_t d = 0; d < D; d++) {
+                const fp32_t qd = q_f[r * D + d];
+                const fp32_t* k_d = k_t + d * kBlockN;
+                for (int64_t j = 0; j < valid; j++) s_r[j] += qd * k_d[j];
+            }
+
+            fp32_t tile_max = row_max[r];
+            for (int64_t j = 0; j < valid; j++) tile_max = std::max(tile_max, s_r[j]);
+            const fp32_t alpha = std::exp(row_max[r] - tile_max);
+            fp32_t sum = 0.0f;
+            for (int64_t j = 0; j < valid; j++) {
+                s_r[j] = std::exp(s_r[j] - tile_max);
+                sum += s_r[j];
+            }
+            row_sum[r] = row_sum[r] * alpha + sum;
+            row_max[r] = tile_max;
+
+            fp32_t* acc_r = acc + r * D;
+            for (int64_t d = 0; d < D; d++) acc_r[d] *= alpha;
+            for (int64_t j = 0; j < valid; j++) kernels.axpy(s_r[j], v_f + j * D, acc_r, D);
+        }
+    }
+
+    for (int64_t r = 0; r < rows; r++) {
+        T* dst = o.data_ptr<T>() + token(r) * o.stride(0) + head(r) * o.stride(1);
+        const fp32_t inv = 1.0f / row_sum[r];
+        for (int64_t d = 0; d < D; d++) dst[d] = from_float<T>(acc[r * D + d] * inv);
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Work list of mixed_int8kv_attention for one step, on the host.
+ *
+ * A request of q_len tokens (its last q_len positions, 1 for decode) is cut
+ * into tiles of kMixedAttentionRows / G tokens, one unit per tile and kv
+ * head, so the G heads of a group share every K / V load. The units are
+ * sorted by cost (rows x keys), longest first: the persistent CUDA launch
+ * hands them out round robin, which then approximates longest-processing-
+ * time scheduling and keeps the prefill tiles off the tail of the launch.
+ *
+ * @param cu_q_lens  [batch + 1] prefix sums of the query lengths.
+ * @param seq_lens   [batch] sequence lengths, including the query tokens.
+ * @return           Number of units appended to work, at most
+ *                   cu_q_lens[batch] * num_kv_heads.
+ */
+int64_t plan_mixed_attention(
+    const int32_t* cu_q_lens, const int32_t* seq_lens, const int64_t batch,
+    const int64_t num_heads, const int64_t num_kv_heads, std::vector<MixedAttentionWork>* work
+) {
+    LK_CHECK(num_kv_heads > 0 && num_heads % num_kv_heads == 0, "plan_mixed_attention: heads must be a multiple of kv heads");
+    const int64_t G = num_heads / num_kv_heads;
+    LK_CHECK(G <= kMixedAttentionRows, "plan_mixed_attention: GQA groups of more than ", kMixedAttentionRows, " heads are not supported");
+    const int64_t tile = kMixedAttentionRows / G;
+
+    std::vector<std::pair<int64_t, MixedAttentionWork>> units;
+    for (int64_t b = 0; b < batch; b++) {
+        const int64_t q_len = cu_q_lens[b + 1] - cu_q_lens[b];
+        LK_CHECK(q_len >= 1 && q_len <= seq_lens[b], "plan_mixed_attention: request ", b, " has ", q_len,
+                 " query tokens for a sequence of ", seq_lens[b]);
+        const int64_t start = seq_lens[b] - q_len;
+        for (int64_t t0 = 0; t0 < q_len; t0 += tile) {
+            const int64_t t1 = std::min(q_len, t0 + tile);
+            const int64_t cost = (t1 - t0) * G * (start + t1);
+            for (int64_t h = 0; h < num_kv_heads; h++) {
+                units.push_back({cost, {static_cast<int32_t>(b), static_cast<int32_t>(h),
+                                        static_cast<int32_t>(cu_q_lens[b] + t0), static_cast<int32_t>(cu_q_lens[b] + t1)}});
+            }
+        }
+    }
+    std::stable_sort(units.begin(), units.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (const auto& u : units) work->push_back(u.second);
+    return static_cast<int64_t>(units.size());
+}
+
+void mixed_int8kv_attention_cpu(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& cu_q_lens, const TensorView& work, const TensorView& page_precision, const int64_t page_size
+) {
+    const MixedAttentionWork* units = reinterpret_cast<const MixedAttentionWork*>(work.data);
+    const int32_t* cu = cu_q_lens.data_ptr<const int32_t>();
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        parallel_for(0, work.size(0), 1, [&](int64_t begin, int64_t end) {
+            std::vector<fp32_t> scratch;
+            for (int64_t i = begin; i < end; i++) {
+                mixed_work<T>(units[i], o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu,
+                              page_precision, page_size, scratch);
+            }
+        });
+    };
+
+    switch (q.dtype) {
+        case DType::BFloat16: run(host_bf16_t{}); break;
+        case DType::Float16: run(host_fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("mixed_int8kv_attention does not support ", dtype_name(q.dtype));
+    }
+}
+
+/**
+ * @brief Attention of a chunked-prefill step in one launch: prefill chunks
+ * and decode tokens of many requests over the int8 KV cache (group-8
+ * scales) of int8kv_decode_attention. Query token i of request b sits at
+ * position b_seq_len[b] - q_len[b] + i and attends causally to the positions
+ * up to its own; its K / V must already be in the cache.
+ *
+ * @param o                  [Tq, H, D] output, dtype of q.
+ * @param q                  [Tq, H, D] bf16 / fp16 query tokens of all
+ *                           requests back to back, head dim contiguous. D is
+ *                           a multiple of 8 on CPU, of 32 up to 256 on CUDA.
+ * @param k, v               [slots, Hkv, D] contiguous int8, H % Hkv == 0.
+ * @param k_s, v_s           [slots, Hkv, D / 8] contiguous scales, dtype of q.
+ * @param req_to_tokens      [max_reqs, max_len] int32 slots of every request.
+ * @param b_req_idx          [B] int32 request rows.
+ * @param b_seq_len          [B] int32 sequence lengths including the queries.
+ * @param cu_q_lens          [B + 1] int32 prefix sums of the query lengths.
+ * @param work               [n, 4] int32 units of plan_mixed_attention, on
+ *                           the device of q.
+ * @param page_precision     Optional int8 [num_pages] tags of
+ *                           KvPageAllocator::downgrade on the device of q,
+ *                           see DecodeAttentionOptions::page_precision.
+ * @param page_size          Slots per page of page_precision.
+ */
+void mixed_int8kv_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& cu_q_lens, const TensorView& work, const TensorView& page_precision, const int64_t page_size
+) {
+    static_assert(sizeof(MixedAttentionWork) == 4 * sizeof(int32_t), "MixedAttentionWork is four int32");
+    LK_CHECK(q.dim() == 3 && o.dim() == 3 && q.stride(2) == 1 && o.stride(2) == 1,
+             "mixed_int8kv_attention: q and o must be [Tq, H, D] with a contiguous head dim");
+    LK_CHECK(q.dtype == DType::BFloat16 || q.dtype == DType::Float16, "mixed_int8kv_attention: q must be bf16 or fp16");
+    LK_CHECK(o.dtype == q.dtype && k_s.dtype == q.dtype && v_s.dtype == q.dtype,
+             "mixed_int8kv_attention: o, k_s and v_s must have the dtype of q");
+    LK_CHECK(k.dtype == DType::Int8 && v.dtype == DType::Int8, "mixed_int8kv_attention: k and v must be int8");
+    LK_CHECK(k.dim() == 3 && v.dim() == 3 && k_s.dim() == 3 && v_s.dim() == 3, "mixed_int8kv_attention: k, v and their scales must be 3D");
+    LK_CHECK(k.is_contiguous() && v.is_contiguous() && k_s.is_contiguous() && v_s.is_contiguous(),
+             "mixed_int8kv_attention: k, v and their scales must be contiguous");
+    const int64_t Tq = q.size(0);
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    const int64_t B = b_seq_len.numel();
+    LK_CHECK(o.size(0) == Tq && o.size(1) == H && o.size(2) == D, "mixed_int8kv_attention: o must have the shape of q");
+    LK_CHECK(D % 8 == 0 && k.size(2) == D && v.size(2) == D && k_s.size(2) == D / 8 && v_s.size(2) == D / 8,
+             "mixed_int8kv_attention: head_dim must be a multiple of 8 shared by q, k and v");
+    LK_CHECK(v.size(1) == k.size(1) && k_s.size(1) == k.size(1) && v_s.size(1) == k.size(1) && H % k.size(1) == 0,
+             "mixed_int8kv_attention: heads of q must be a multiple of kv heads");
+    LK_CHECK(req_to_tokens.dtype == DType::Int32 && req_to_tokens.dim() == 2 && req_to_tokens.stride(1) == 1,
+             "mixed_int8kv_attention: req_to_tokens must be [max_reqs, max_len] int32");
+    LK_CHECK(b_req_idx.dtype == DType::Int32 && b_seq_len.dtype == DType::Int32 && cu_q_lens.dtype == DType::Int32 &&
+             b_req_idx.is_contiguous() && b_seq_len.is_contiguous() && cu_q_lens.is_contiguous(),
+             "mixed_int8kv_attention: b_req_idx, b_seq_len and cu_q_lens must be contiguous int32");
+    LK_CHECK(b_req_idx.numel() == B && cu_q_lens.numel() == B + 1, "mixed_int8kv_attention: b_req_idx must be [B] and cu_q_lens [B + 1]");
+    LK_CHECK(work.dtype == DType::Int32 && work.dim() == 2 && work.size(1) == 4 && work.is_contiguous(),
+             "mixed_int8kv_attention: work must be a contiguous [n, 4] int32 tensor");
+    if (page_precision.data != nullptr) {
+        LK_CHECK(page_size > 0 && k.size(0) % page_size == 0 && D % 16 == 0,
+                 "mixed_int8kv_attention: page_precision needs a page_size dividing the slots and D % 16 == 0");
+        LK_CHECK(page_precision.dtype == DType::Int8 && page_precision.is_contiguous() &&
+                 page_precision.numel() == k.size(0) / page_size,
+                 "mixed_int8kv_attention: page_precision must be a contiguous int8 [num_pages] tensor");
+        LK_CHECK(page_precision.device == q.device && page_precision.device_index == q.device_index,
+                 "mixed_int8kv_attention: all tensors must be on the device of q");
+    }
+    for (const TensorView* t : {&o, &k, &k_s, &v, &v_s, &req_to_tokens, &b_req_idx, &b_seq_len, &cu_q_lens}) {
+        LK_CHECK(t->device == q.device && t->device_index == q.device_index,
+                 "mixed_int8kv_attention: all tensors must be on the device of q");
+    }
+    // the work list is copied to the device once per step, never here
+    LK_CHECK(work.device == q.device && work.device_index == q.device_index,
+             "mixed_int8kv_attention: work must be on the device of q, plan it there once per step");
+    if (work.size(0) == 0) return;
+
+    if (q.is_cpu()) {
+        const int32_t* cu = cu_q_lens.data_ptr<const int32_t>();
+        const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+        const int32_t* reqs = b_req_idx.data_ptr<const int32_t>();
+        // virtual slots of downgraded pages follow the physical ones
+        const int64_t num_slots = page_precision.data != nullptr ? 2 * k.size(0) : k.size(0);
+        LK_CHECK(cu[0] == 0 && cu[B] == Tq, "mixed_int8kv_attention: cu_q_lens must go from 0 to the number of query tokens");
+        for (int64_t b = 0; b < B; b++) {
+            LK_CHECK(cu[b + 1] > cu[b] && cu[b + 1] - cu[b] <= lens[b] && lens[b] <= req_to_tokens.size(1),
+                     "mixed_int8kv_attention: request ", b, " has ", cu[b + 1] - cu[b], " query tokens and length ", lens[b]);
+            LK_CHECK(reqs[b] >= 0 && reqs[b] < req_to_tokens.size(0), "b_req_idx[", b, "] = ", reqs[b], " is out of range");
+            const int32_t* slots = req_to_tokens.data_ptr<const int32_t>() + reqs[b] * req_to_tokens.stride(0);
+            for (int64_t t = 0; t < lens[b]; t++) {
+                LK_CHECK(slots[t] >= 0 && slots[t] < num_slots, "mixed_int8kv_attention: slot ", slots[t], " is out of range");
+            }
+        }
+        const MixedAttentionWork* units = reinterpret_cast<const MixedAttentionWork*>(work.data);
+        for (int64_t i = 0; i < work.size(0); i++) {
+            const MixedAttentionWork& w = units[i];
+            LK_CHECK(w.batch >= 0 && w.batch < B && w.kv_head >= 0 && w.kv_head < k.size(1) &&
+                     w.q_begin >= cu[w.batch] && w.q_begin < w.q_end && w.q_end <= cu[w.batch + 1] &&
+                     (w.q_end - w.q_begin) * (H / k.size(1)) <= kMixedAttentionRows,
+                     "mixed_int8kv_attention: work unit ", i, " is out of range");
+        }
+        mixed_int8kv_attention_cpu(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu_q_lens, work,
+                                   page_precision, page_size);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    mixed_int8kv_attention_cuda(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu_q_lens, work,
+                                page_precision, page_size);
+#else
+    LK_NOT_SUPPORTED("mixed_int8kv_attention: the core library was built without CUDA");
+#endif
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,219 @@
+#include "core/ops.h"
+#include "utils.h"
+#include "attention/kv_loader.cuh"
+
+#include <cfloat>
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+namespace {
+
+constexpr int32_t kTPB = 256;
+constexpr int32_t kWarps = kTPB / 32;
+constexpr int32_t kRowsPerWarp = kMixedAttentionRows / kWarps;
+constexpr int32_t kKeys = 16;           // keys per shared memory tile
+constexpr int32_t kQuantGroup = 8;
+
+/**
+ * @brief Persistent mixed prefill + decode attention over the int8 KV cache.
+ * Every block walks the work list (sorted longest first) round robin; a unit
+ * is up to kMixedAttentionRows query rows of one GQA group, prefill tile or
+ * decode token alike. The block dequantizes the K / V of the unit's request
+ * in tiles of kKeys into shared memory, once for all of its rows. A warp
+ * owns kRowsPerWarp rows, a lane every 32nd element of the head dim, with
+ * the online softmax state in registers; a row stops at its own position.
+ * Pages tagged in page_precision (or nullptr) are read in the format of
+ * kv_downgrade_pages, see resolve_kv_slot.
+ *
+ * grid: min(units, 2 * SMs), persistent
+ */
+template<int32_t DPL, typename T>
+__global__ __launch_bounds__(kTPB)
+void device_mixed_int8kv_attention(
+    T* __restrict__ o, const T* __restrict__ q,
+    const int8_t* __restrict__ k, const T* __restrict__ k_scale,
+    const int8_t* __restrict__ v, const T* __restrict__ v_scale,
+    const int32_t* __restrict__ req_to_tokens, const int32_t* __restrict__ b_req_idx,
+    const int32_t* __restrict__ b_seq_len, const int32_t* __restrict__ cu_q_lens,
+    const int4* __restrict__ work, const int64_t num_work,
+    const int32_t group, const fp32_t scale,
+    const int64_t o_stride_s, const int64_t o_stride_h, const int64_t q_stride_s, const int64_t q_stride_h,
+    const int64_t kv_stride_s, const int64_t kv_stride_h, const int64_t scale_stride_s, const int64_t scale_stride_h,
+    const int64_t req_to_tokens_stride,
+    const int8_t* __restrict__ page_precision, const int64_t page_size, const int64_t num_slots
+) {
+    using KV = attention::Int8KvLoader<T>;
+    constexpr int32_t D = DPL * 32;
+    __shared__ fp32_t k_tile[kKeys][D];
+    __shared__ fp32_t v_tile[kKeys][D];
+    const int32_t warp = threadIdx.x / 32;
+    const int32_t lane = threadIdx.x % 32;
+
+    for (int64_t u = blockIdx.x; u < num_work; u += gridDim.x) {
+        const int4 unit = work[u];
+        const int32_t b = unit.x;
+        const int32_t kv_head = unit.y;
+        const int32_t q0 = cu_q_lens[b];
+        // first query token of the request sits at this position of its sequence
+        const int32_t start = b_seq_len[b] - (cu_q_lens[b + 1] - q0);
+        const int32_t kv_len = start + unit.w - q0;
+        const int32_t rows = (unit.w - unit.z) * group;
+        const int32_t* slots = req_to_tokens + b_req_idx[b] * req_to_tokens_stride;
+
+        fp32_t q_reg[kRowsPerWarp][DPL];
+        fp32_t o_reg[kRowsPerWarp][DPL];
+        fp32_t row_max[kRowsPerWarp];
+        fp32_t row_sum[kRowsPerWarp];
+        int32_t pos[kRowsPerWarp];
+        #pragma unroll
+        for (int32_t r = 0; r < kRowsPerWarp; r++) {
+            const int32_t row = warp + r * kWarps;
+            const int64_t token = unit.z + row / group;
+            const int64_t head = (int64_t)kv_head * group + row % group;
+            pos[r] = row < rows ? start + (int32_t)(token - q0) : -1;
+            #pragma unroll
+            for (int32_t i = 0; i < DPL; i++) {
+                q_reg[r][i] = row < rows ? static_cast<fp32_t>(q[token * q_stride_s + head * q_stride_h + lane + i * 32]) * scale : 0.0f;
+                o_reg[r][i] = 0.0f;
+            }
+            row_max[r] = -FLT_MAX;
+            row_sum[r] = 0.0f;
+        }
+
+        for (int32_t n0 = 0; n0 < kv_len; n0 += kKeys) {
+            const int32_t n = min(kKeys, kv_len - n0);
+            __syncthreads();  // the previous tile is consumed
+            // a thread loads two elements, one byte of a packed int4 row
+            for (int32_t e = threadIdx.x; e < n * D / 2; e += kTPB) {
+                const int32_t j = e / (D / 2);
+                const int32_t d = e % (D / 2) * 2;
+                const attention::KvSlot slot = attention::resolve_kv_slot(slots[n0 + j], page_precision, page_size, num_slots);
+                const int64_t row = slot.slot * kv_stride_s + (int64_t)kv_head * kv_stride_h;
+                if (slot.packed) {
+                    KV::template load_packed<2>(k, k_scale, row, d, D, slot.half, &k_tile[j][d]);
+                    KV::template load_packed<2>(v, v_scale, row, d, D, slot.half, &v_tile[j][d]);
+                    continue;
+                }
+                const int64_t s = slot.slot * scale_stride_s + (int64_t)kv_head * scale_stride_h + d / kQuantGroup;
+                #pragma unroll
+                for (int32_t i = 0; i < 2; i++) {
+                    k_tile[j][d + i] = static_cast<fp32_t>(k_scale[s]) * static_cast<fp32_t>(k[row + d + i]);
+                    v_tile[j][d + i] = static_cast<fp32_t>(v_scale[s]) * static_cast<fp32_t>(v[row + d + i]);
+                }
+            }
+            __syncthreads();
+
+            #pragma unroll
+            for (int32_t r = 0; r < kRowsPerWarp; r++) {
+                const int32_t valid = min(n, pos[r] + 1 - n0);
+                if (valid <= 0) continue;  // uniform across the warp
+
+                fp32_t s[kKeys];
+                fp32_t tile_max = row_max[r];
+                #pragma unroll
+                for (int32_t j = 0; j < kKeys; j++) {
+                    fp32_t dot = 0.0f;
+                    #pragma unroll
+                    for (int32_t i = 0; i < DPL; i++) dot += q_reg[r][i] * k_tile[j][lane + i * 32];
+                    #pragma unroll
+                    for (int32_t mask = 16; mask >= 1; mask /= 2) dot += __shfl_xor_sync(uint32_t(-1), dot, mask);
+                    s[j] = j < valid ? dot : -FLT_MAX;
+                    tile_max = fmaxf(tile_max, s[j]);
+                }
+
+                const fp32_t alpha = __expf(row_max[r] - tile_max);
+                row_sum[r] *= alpha;
+                #pragma unroll
+                for (int32_t i = 0; i < DPL; i++) o_reg[r][i] *= alpha;
+                #pragma unroll
+                for (int32_t j = 0; j < kKeys; j++) {
+                    const fp32_t p = j < valid ? __expf(s[j] - tile_max) : 0.0f;
+                    row_sum[r] += p;
+                    #pragma unroll
+                    for (int32_t i = 0; i < DPL; i++) o_reg[r][i] += p * v_tile[j][lane + i * 32];
+                }
+                row_max[r] = tile_max;
+            }
+        }
+
+        #pragma unroll
+        for (int32_t r = 0; r < kRowsPerWarp; r++) {
+            const int32_t row = warp + r * kWarps;
+            if (row >= rows) continue;
+            const int64_t token = unit.z + row / group;
+            const int64_t head = (int64_t)kv_head * group + row % group;
+            const fp32_t inv = 1.0f / row_sum[r];
+            #pragma unroll
+            for (int32_t i = 0; i < DPL; i++) {
+                o[token * o_stride_s + head * o_stride_h + lane + i * 32] = static_cast<T>(o_reg[r][i] * inv);
+            }
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @brief CUDA backend of core::mixed_int8kv_attention, the views are already validated.
+ */
+void mixed_int8kv_attention_cuda(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& cu_q_lens, const TensorView& work, const TensorView& page_precision, const int64_t page_size
+) {
+    const int64_t D = q.size(2);
+    LK_CHECK(D % 32 == 0 && D <= 256, "mixed_int8kv_attention: CUDA needs a head_dim that is a multiple of 32 up to 256, got ", D);
+    const int32_t group = static_cast<int32_t>(q.size(1) / k.size(1));
+    LK_CHECK(group <= kMixedAttentionRows, "mixed_int8kv_attention: GQA groups of more than ", kMixedAttentionRows,
+             " heads are not supported");
+
+    LK_CHECK(reinterpret_cast<uintptr_t>(work.data) % 16 == 0, "mixed_int8kv_attention: work must be 16-byte aligned");
+
+    int32_t sms = 0;
+    cudaDeviceGetAttribute(&sms, cudaDevAttrMultiProcessorCount, q.device_index);
+    const int64_t num_work = work.size(0);
+    const int64_t blocks = std::min<int64_t>(num_work, 2 * std::max(sms, 1));
+
+    auto run = [&](auto type_tag, auto dims_per_lane) {
+        using T = decltype(type_tag);
+        device_mixed_int8kv_attention<decltype(dims_per_lane)::value, T>
+        <<<blocks, kTPB, 0, static_cast<cudaStream_t>(q.stream)>>>(
+            o.data_ptr<T>(), q.data_ptr<const T>(),
+            k.data_ptr<const int8_t>(), k_s.data_ptr<const T>(), v.data_ptr<const int8_t>(), v_s.data_ptr<const T>(),
+            req_to_tokens.data_ptr<const int32_t>(), b_req_idx.data_ptr<const int32_t>(),
+            b_seq_len.data_ptr<const int32_t>(), cu_q_lens.data_ptr<const int32_t>(),
+            reinterpret_cast<const int4*>(work.data), num_work,
+            group, 1.0f / std::sqrt(static_cast<fp32_t>(D)),
+            o.stride(0), o.stride(1), q.stride(0), q.stride(1),
+            k.stride(0), k.stride(1), k_s.stride(0), k_s.stride(1),
+            req_to_tokens.stride(0),
+            static_cast<const int8_t*>(page_precision.data), page_size, k.size(0)
+        );
+    };
+    auto dispatch = [&](auto type_tag) {
+        using std::integral_constant;
+        switch (D / 32) {
+            case 1: run(type_tag, integral_constant<int32_t, 1>{}); break;
+            case 2: run(type_tag, integral_constant<int32_t, 2>{}); break;
+            case 3: run(type_tag, integral_constant<int32_t, 3>{}); break;
+            case 4: run(type_tag, integral_constant<int32_t, 4>{}); break;
+            case 5: run(type_tag, integral_constant<int32_t, 5>{}); break;
+            case 6: run(type_tag, integral_constant<int32_t, 6>{}); break;
+            case 7: run(type_tag, integral_constant<int32_t, 7>{}); break;
+            case 8: run(type_tag, integral_constant<int32_t, 8>{}); break;
+        }
+    };
+
+    switch (q.dtype) {
+        case DType::BFloat16: dispatch(bf16_t{}); break;
+        case DType::Float16: dispatch(fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("mixed_int8kv_attention does not support ", dtype_name(q.dtype));
+    }
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,467 @@
+#include "core/ops.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+constexpr int64_t kQuantGroup = 8;
+
+// The page summaries match the keys of k (Hkv, D) and the dtype of their scales.
+void check_page_summary(const char* op, const TensorView& page_min, const TensorView& page_max,
+                        const DType dtype, const int64_t kv_heads, const int64_t head_dim) {
+    for (const TensorView* t : {&page_min, &page_max}) {
+        LK_CHECK(t->dtype == dtype && t->dim() == 3 && t->is_contiguous(),
+                 op, ": page_min and page_max must be contiguous [num_pages, Hkv, D] in the dtype of the scales");
+        LK_CHECK(t->size(0) == page_min.size(0) && t->size(1) == kv_heads && t->size(2) == head_dim,
+                 op, ": page_min and page_max must be [num_pages, ", kv_heads, ", ", head_dim, "]");
+        LK_CHECK(t->device == page_min.device && t->device_index == page_min.device_index,
+                 op, ": page_min and page_max must be on the same device");
+    }
+}
+
+// Checks b_req_idx / b_seq_len on the host and that every logical page maps to a summarized page.
+void check_requests_cpu(const char* op, const TensorView& req_to_tokens, const TensorView& b_req_idx,
+                        const TensorView& b_seq_len, const int64_t page_size, const int64_t num_pages) {
+    const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+    const int32_t* reqs = b_req_idx.data_ptr<const int32_t>();
+    for (int64_t b = 0; b < b_seq_len.numel(); b++) {
+        LK_CHECK(lens[b] >= 1 && lens[b] <= req_to_tokens.size(1), op, ": b_seq_len[", b, "] = ", lens[b], " is out of range");
+        LK_CHECK(reqs[b] >= 0 && reqs[b] < req_to_tokens.size(0), op, ": b_req_idx[", b, "] = ", reqs[b], " is out of range");
+        const int32_t* row = req_to_tokens.data_ptr<const int32_t>() + reqs[b] * req_to_tokens.stride(0);
+        for (int64_t t = 0; t < lens[b]; t += page_size) {
+            LK_CHECK(row[t] >= 0 && row[t] / page_size < num_pages,
+                     op, ": slot ", row[t], " of request ", b, " has no page summary");
+        }
+    }
+}
+
+} // namespace
+
+void kv_page_minmax_update_cpu(
+    const TensorView& page_min, const TensorView& page_max, const TensorView& k, const TensorView& k_s,
+    const TensorView& slots, const int64_t page_size
+) {
+    const int64_t Hkv = k.size(1);
+    const int64_t D = k.size(2);
+    const int64_t n = slots.numel();
+    const int32_t* s = slots.data_ptr<const int32_t>();
+    // the last entry of every run of a page covers the others
+    std::vector<int64_t> last;
+    for (int64_t i = 0; i < n; i++) {
+        if (i + 1 == n || s[i + 1] / page_size != s[i] / page_size) last.push_back(i);
+    }
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        parallel_for(0, static_cast<int64_t>(last.size()) * Hkv, 1, [&](int64_t begin, int64_t end) {
+            std::vector<fp32_t> lo(D), hi(D);
+            for (int64_t i = begin; i < end; i++) {
+                const int64_t slot = s[last[i / Hkv]];
+                const int64_t h = i % Hkv;
+                const int64_t page = slot / page_size;
+                std::fill(lo.begin(), lo.end(), std::numeric_limits<fp32_t>::infinity());
+                std::fill(hi.begin(), hi.end(), -std::numeric_limits<fp32_t>::infinity());
+                for (int64_t t = page * page_size; t <= slot; t++) {
+                    const int8_t* k8 = k.data_ptr<const int8_t>() + t * k.stride(0) + h * k.stride(1);
+                    const T* ks = k_s.data_ptr<const T>() + t * k_s.stride(0) + h * k_s.stride(1);
+                    for (int64_t d = 0; d < D; d++) {
+                        const fp32_t x = to_float(ks[d / kQuantGroup]) * k8[d];
+                        lo[d] = std::min(lo[d], x);
+                        hi[d] = std::max(hi[d], x);
+                    }
+                }
+                T* mn = page_min.data_ptr<T>() + (page * Hkv + h) * D;
+                T* mx = page_max.data_ptr<T>() + (page * Hkv + h) * D;
+                for (int64_t d = 0; d < D; d++) {
+                    mn[d] = from_float<T>(lo[d]);
+                    mx[d] = from_float<T>(hi[d]);
+                }
+            }
+        });
+    };
+
+    switch (k_s.dtype) {
+        case DType::BFloat16: run(host_bf16_t{}); break;
+        case DType::Float16: run(host_fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("kv_page_minmax_update does not support ", dtype_name(k_s.dtype));
+    }
+}
+
+/**
+ * @brief Refreshes the page summaries after K was stored at slots: every
+ * page that slots touch is recomputed over its slots up to the last one
+ * written, so a page reused after a free starts over.
+ *
+ * @param page_min, page_max  [num_pages, Hkv, D] contiguous, dtype of k_s.
+ * @param k                   [cache slots, Hkv, D] contiguous int8.
+ * @param k_s                 [cache slots, Hkv, D / 8] contiguous bf16 / fp16.
+ * @param slots               [n] int32 slots stored this step. The slots of a
+ *                            page must be consecutive and ascending, as in the
+ *                            out_slots of KvPageAllocator::extend.
+ * @param page_size           Slots per page.
+ */
+void kv_page_minmax_update(
+    const TensorView& page_min, const TensorView& page_max, const TensorView& k, const TensorView& k_s,
+    const TensorView& slots, const int64_t page_size
+) {
+    LK_CHECK(page_size > 0, "kv_page_minmax_update: page_size must be positive");
+    LK_CHECK(k.dtype == DType::Int8 && k.dim() == 3 && k.is_contiguous(), "kv_page_minmax_update: k must be contiguous [slots, Hkv, D] int8");
+    LK_CHECK(k_s.dtype == DType::BFloat16 || k_s.dtype == DType::Float16, "kv_page_minmax_update: k_s must be bf16 or fp16");
+    LK_CHECK(k_s.dim() == 3 && k_s.is_contiguous() && k_s.size(0) == k.size(0) && k_s.size(1) == k.size(1) &&
+             k.size(2) % kQuantGroup == 0 && k_s.size(2) == k.size(2) / kQuantGroup,
+             "kv_page_minmax_update: k_s must be contiguous [slots, Hkv, D / 8]");
+    check_page_summary("kv_page_minmax_update", page_min, page_max, k_s.dtype, k.size(1), k.size(2));
+    LK_CHECK(page_min.size(0) * page_size <= k.size(0), "kv_page_minmax_update: ", page_min.size(0), " pages of ",
+             page_size, " slots do not fit in a cache of ", k.size(0), " slots");
+    LK_CHECK(slots.dtype == DType::Int32 && slots.dim() == 1 && slots.is_contiguous(), "kv_page_minmax_update: slots must be [n] int32");
+    for (const TensorView* t : {&page_min, &k_s, &slots}) {
+        LK_CHECK(t->device == k.device && t->device_index == k.device_index, "kv_page_minmax_update: all tensors must be on the device of k");
+    }
+    if (slots.numel() == 0) return;
+
+    if (k.is_cpu()) {
+        const int32_t* s = slots.data_ptr<const int32_t>();
+        for (int64_t i = 0; i < slots.numel(); i++) {
+            LK_CHECK(s[i] >= 0 && s[i] < page_min.size(0) * page_size, "kv_page_minmax_update: slot ", s[i], " has no page summary");
+        }
+        kv_page_minmax_update_cpu(page_min, page_max, k, k_s, slots, page_size);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    kv_page_minmax_update_cuda(page_min, page_max, k, k_s, slots, page_size);
+#else
+    LK_NOT_SUPPORTED("kv_page_minmax_update: the core library was built without CUDA");
+#endif
+}
+
+void quest_select_pages_cpu(
+    const TensorView& page_idx, const TensorView& scores, const TensorView& q,
+    const TensorView& page_min, const TensorView& page_max,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t page_size
+) {
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    const int64_t Hkv = page_min.size(1);
+    const int64_t G = H / Hkv;
+    const int64_t top = page_idx.size(2);
+    const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+    const int32_t* reqs = b_req_idx.data_ptr<const int32_t>();
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        parallel_for(0, b_seq_len.numel() * Hkv, 1, [&](int64_t begin, int64_t end) {
+            std::vector<fp32_t> q_f(G * D), mn(D), mx(D);
+            std::vector<int32_t> order;
+            for (int64_t i = begin; i < end; i++) {
+                const int64_t b = i / Hkv;
+                const int64_t h = i % Hkv;
+                const int64_t n = (lens[b] + page_size - 1) / page_size;
+                const int32_t* row = req_to_tokens.data_ptr<const int32_t>() + reqs[b] * req_to_tokens.stride(0);
+                for (int64_t g = 0; g < G; g++) {
+                    const T* src = q.data_ptr<const T>() + b * q.stride(0) + (h * G + g) * q.stride(1);
+                    for (int64_t d = 0; d < D; d++) q_f[g * D + d] = to_float(src[d]);
+                }
+
+                fp32_t* sc = scores.data_ptr<fp32_t>() + i * scores.size(2);
+                for (int64_t j = 0; j < n; j++) {
+                    const int64_t page = row[j * page_size] / page_size;
+                    const T* lo = page_min.data_ptr<const T>() + (page * Hkv + h) * D;
+                    const T* hi = page_max.data_ptr<const T>() + (page * Hkv + h) * D;
+                    for (int64_t d = 0; d < D; d++) {
+                        mn[d] = to_float(lo[d]);
+                        mx[d] = to_float(hi[d]);
+                    }
+                    fp32_t best = -std::numeric_limits<fp32_t>::infinity();
+                    for (int64_t g = 0; g < G; g++) {
+                        const fp32_t* qg = q_f.data() + g * D;
+                        fp32_t bound = 0.0f;
+                        for (int64_t d = 0; d < D; d++) bound += std::max(qg[d] * mn[d], qg[d] * mx[d]);
+                        best = std::max(best, bound);
+                    }
+                    // the page of the current token is always attended
+                    sc[j] = j == n - 1 ? std::numeric_limits<fp32_t>::max() : best;
+                }
+
+                int32_t* out = page_idx.data_ptr<int32_t>() + i * top;
+                order.resize(n);
+                std::iota(order.begin(), order.end(), 0);
+                const int64_t m = std::min(n, top);
+                if (n > top) {
+                    std::nth_element(order.begin(), order.begin() + top, order.end(), [&](int32_t x, int32_t y) {
+                        return sc[x] > sc[y] || (sc[x] == sc[y] && x < y);
+                    });
+                    std::sort(order.begin(), order.begin() + top);
+                }
+                std::copy(order.begin(), order.begin() + m, out);
+                std::fill(out + m, out + top, -1);
+            }
+        });
+    };
+
+    switch (q.dtype) {
+        case DType::BFloat16: run(host_bf16_t{}); break;
+        case DType::Float16: run(host_fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("quest_select_pages does not support ", dtype_name(q.dtype));
+    }
+}
+
+/**
+ * @brief Phase one of the sparse decode: scores the pages of every request
+ * with the Quest upper bound of q . k, sum over d of max(q_d * min_d,
+ * q_d * max_d), taking the max over the heads of a GQA group, and keeps the
+ * top pages per (request, kv head). The page of the current token always
+ * makes it; ties go to the earlier page.
+ *
+ * @param page_idx           [B, Hkv, top] int32 output, the logical pages
+ *                           (position / page_size) kept in ascending order,
+ *                           then -1 for a request of fewer than top pages.
+ * @param scores             [B, Hkv, max_pages] fp32 output, the bound of
+ *                           every page of the request (FLT_MAX for the last
+ *                           one); max_pages covers the longest request.
+ * @param q                  [B, H, D] bf16 / fp16, head dim contiguous.
+ * @param page_min, page_max [num_pages, Hkv, D], see kv_page_minmax_update.
+ * @param req_to_tokens      [max_reqs, max_len] int32 slots, page aligned,
+ *                           of summarized pages (so no virtual slots of
+ *                           downgraded pages).
+ * @param b_req_idx          [B] int32 request rows.
+ * @param b_seq_len          [B] int32 lengths.
+ * @param page_size          Slots per page.
+ */
+void quest_select_pages(
+    const TensorView& page_idx, const TensorView& scores, const TensorView& q,
+    const TensorView& page_min, const TensorView& page_max,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t page_size
+) {
+    LK_CHECK(page_size > 0, "quest_select_pages: page_size must be positive");
+    LK_CHECK(q.dim() == 3 && q.stride(2) == 1, "quest_select_pages: q must be [B, H, D] with a contiguous head dim");
+    LK_CHECK(q.dtype == DType::BFloat16 || q.dtype == DType::Float16, "quest_select_pages: q must be bf16 or fp16");
+    check_page_summary("quest_select_pages", page_min, page_max, q.dtype, page_min.size(1), q.size(2));
+    LK_CHECK(q.size(1) % page_min.size(1) == 0, "quest_select_pages: heads of q must be a multiple of kv heads");
+    const int64_t B = q.size(0);
+    LK_CHECK(page_idx.dtype == DType::Int32 && page_idx.dim() == 3 && page_idx.is_contiguous() &&
+             page_idx.size(0) == B && page_idx.size(1) == page_min.size(1) && page_idx.size(2) >= 1,
+             "quest_select_pages: page_idx must be contiguous [B, Hkv, top] int32");
+    LK_CHECK(scores.dtype == DType::Float32 && scores.dim() == 3 && scores.is_contiguous() &&
+             scores.size(0) == B && scores.size(1) == page_min.size(1),
+             "quest_select_pages: scores must be contiguous [B, Hkv, max_pages] fp32");
+    LK_CHECK(req_to_tokens.dtype == DType::Int32 && req_to_tokens.dim() == 2 && req_to_tokens.stride(1) == 1,
+             "quest_select_pages: req_to_tokens must be [max_reqs, max_len] int32");
+    LK_CHECK(b_req_idx.dtype == DType::Int32 && b_seq_len.dtype == DType::Int32 &&
+             b_req_idx.is_contiguous() && b_seq_len.is_contiguous() && b_req_idx.numel() == B && b_seq_len.numel() == B,
+             "quest_select_pages: b_req_idx and b_seq_len must be [B] int32");
+    for (const TensorView* t : {&page_idx, &scores, &page_min, &req_to_tokens, &b_req_idx, &b_seq_len}) {
+        LK_CHECK(t->device == q.device && t->device_index == q.device_index, "quest_select_pages: all tensors must be on the device of q");
+    }
+    if (B == 0) return;
+
+    if (q.is_cpu()) {
+        check_requests_cpu("quest_select_pages", req_to_tokens, b_req_idx, b_seq_len, page_size, page_min.size(0));
+        const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+        for (int64_t b = 0; b < B; b++) {
+            LK_CHECK((lens[b] + page_size - 1) / page_size <= scores.size(2),
+                     "quest_select_pages: scores has ", scores.size(2), " pages, request ", b, " needs more");
+        }
+        quest_select_pages_cpu(page_idx, scores, q, page_min, page_max, req_to_tokens, b_req_idx, b_seq_len, page_size);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    quest_select_pages_cuda(page_idx, scores, q, page_min, page_max, req_to_tokens, b_req_idx, b_seq_len, page_size);
+#else
+    LK_NOT_SUPPORTED("quest_select_pages: the core library was built without CUDA");
+#endif
+}
+
+void sparse_int8kv_decode_attention_cpu(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& page_idx, const int64_t page_size
+) {
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    const int64_t Hkv = k.size(1);
+    const int64_t G = H / Hkv;
+    const int64_t top = page_idx.size(2);
+    const fp32_t scale = 1.0f / std::sqrt(static_cast<fp32_t>(D));
+    const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+    const int32_t* reqs = b_req_idx.data_ptr<const int32_t>();
+    const CpuKernels& kernels = cpu_kernels();
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        parallel_for(0, b_seq_len.numel() * Hkv, 1, [&](int64_t begin, int64_t end) {
+            std::vector<fp32_t> q_f(G * D), acc(G * D), k_f(page_size * D), v_f(page_size * D), s(page_size);
+            std::vector<fp32_t> row_max(G), row_sum(G);
+            for (int64_t i = begin; i < end; i++) {
+                const int64_t b = i / Hkv;
+                const int64_t h = i % Hkv;
+                const int32_t* row = req_to_tokens.data_ptr<const int32_t>() + reqs[b] * req_to_tokens.stride(0);
+                for (int64_t g = 0; g < G; g++) {
+                    const T* src = q.data_ptr<const T>() + b * q.stride(0) + (h * G + g) * q.stride(1);
+                    for (int64_t d = 0; d < D; d++) q_f[g * D + d] = to_float(src[d]) * scale;
+                }
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                std::fill(row_max.begin(), row_max.end(), -std::numeric_limits<fp32_t>::infinity());
+                std::fill(row_sum.begin(), row_sum.end(), 0.0f);
+
+                const int32_t* pages = page_idx.data_ptr<const int32_t>() + i * top;
+                for (int64_t p = 0; p < top; p++) {
+                    if (pages[p] < 0) continue;
+                    const int64_t t0 = pages[p] * page_size;
+                    const int64_t n = std::min<int64_t>(page_size, lens[b] - t0);
+                    for (int64_t t = 0; t < n; t++) {
+                        const int64_t slot = row[t0 + t];
+                        const int8_t* k8 = k.data_ptr<const int8_t>() + slot * k.stride(0) + h * k.stride(1);
+                        const int8_t* v8 = v.data_ptr<const int8_t>() + slot * v.stride(0) + h * v.stride(1);
+                        const T* ks = k_s.data_ptr<const T>() + slot * k_s.stride(0) + h * k_s.stride(1);
+                        const T* vs = v_s.data_ptr<const T>() + slot * v_s.stride(0) + h * v_s.stride(1);
+                        for (int64_t d = 0; d < D; d++) {
+                            k_f[t * D + d] = to_float(ks[d / kQuantGroup]) * k8[d];
+                            v_f[t * D + d] = to_float(vs[d / kQuantGroup]) * v8[d];
+                        }
+                    }
+
+                    for (int64_t g = 0; g < G; g++) {
+                        const fp32_t* qg = q_f.data() + g * D;
+                        fp32_t tile_max = row_max[g];
+                        for (int64_t t = 0; t < n; t++) {
+                            const fp32_t dot = kernels.dot(qg, k_f.data() + t * D, D);
+                            s[t] = dot;
+                            tile_max = std::max(tile_max, dot);
+                        }
+                        const fp32_t alpha = std::exp(row_max[g] - tile_max);
+                        fp32_t* acc_g = acc.data() + g * D;
+                        for (int64_t d = 0; d < D; d++) acc_g[d] *= alpha;
+                        fp32_t sum = 0.0f;
+                        for (int64_t t = 0; t < n; t++) {
+                            const fp32_t pr = std::exp(s[t] - tile_max);
+                            sum += pr;
+                            kernels.axpy(pr, v_f.data() + t * D, acc_g, D);
+                        }
+                        row_sum[g] = row_sum[g] * alpha + sum;
+                        row_max[g] = tile_max;
+                    }
+                }
+
+                for (int64_t g = 0; g < G; g++) {
+                    T* dst = o.data_ptr<T>() + b * o.stride(0) + (h * G + g) * o.stride(1);
+                    const fp32_t inv = 1.0f / row_sum[g];
+                    for (int64_t d = 0; d < D; d++) dst[d] = from_float<T>(acc[g * D + d] * inv);
+                }
+            }
+        });
+    };
+
+    switch (q.dtype) {
+        case DType::BFloat16: run(host_bf16_t{}); break;
+        case DType::Float16: run(host_fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("sparse_int8kv_decode_attention does not support ", dtype_name(q.dtype));
+    }
+}
+
+/**
+ * @brief Phase two of the sparse decode: int8kv_decode_attention of every
+ * (request, kv head) restricted to the tokens of its selected pages.
+ *
+ * @param o                  [B, H, D] output, dtype of q.
+ * @param q                  [B, H, D] bf16 / fp16, head dim contiguous. D is
+ *                           a multiple of 8 on CPU, of 32 up to 256 on CUDA.
+ * @param k, v               [slots, Hkv, D] contiguous int8, H % Hkv == 0.
+ * @param k_s, v_s           [slots, Hkv, D / 8] contiguous scales, dtype of q.
+ * @param req_to_tokens      [max_reqs, max_len] int32 slots of every request,
+ *                           all in the cache: the virtual slots of pages
+ *                           downgraded by KvPageAllocator are rejected.
+ * @param b_req_idx          [B] int32 request rows.
+ * @param b_seq_len          [B] int32 lengths.
+ * @param page_idx           [B, Hkv, top] int32 distinct logical pages, -1
+ *                           entries skipped (quest_select_pages). Every
+ *                           (request, kv head) needs at least one page.
+ * @param page_size          Tokens per page.
+ */
+void sparse_int8kv_decode_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& page_idx, const int64_t page_size
+) {
+    LK_CHECK(page_size > 0, "sparse_int8kv_decode_attention: page_size must be positive");
+    LK_CHECK(q.dim() == 3 && o.dim() == 3 && q.stride(2) == 1 && o.stride(2) == 1,
+             "sparse_int8kv_decode_attention: q and o must be [B, H, D] with a contiguous head dim");
+    LK_CHECK(q.dtype == DType::BFloat16 || q.dtype == DType::Float16, "sparse_int8kv_decode_attention: q must be bf16 or fp16");
+    LK_CHECK(o.dtype == q.dtype && k_s.dtype == q.dtype && v_s.dtype == q.dtype,
+             "sparse_int8kv_decode_attention: o, k_s and v_s must have the dtype of q");
+    LK_CHECK(k.dtype == DType::Int8 && v.dtype == DType::Int8, "sparse_int8kv_decode_attention: k and v must be int8");
+    LK_CHECK(k.dim() == 3 && v.dim() == 3 && k_s.dim() == 3 && v_s.dim() == 3,
+             "sparse_int8kv_decode_attention: k, v and their scales must be 3D");
+    LK_CHECK(k.is_contiguous() && v.is_contiguous() && k_s.is_contiguous() && v_s.is_contiguous(),
+             "sparse_int8kv_decode_attention: k, v and their scales must be contiguous");
+    const int64_t B = q.size(0);
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    LK_CHECK(o.size(0) == B && o.size(1) == H && o.size(2) == D, "sparse_int8kv_decode_attention: o must have the shape of q");
+    LK_CHECK(D % kQuantGroup == 0 && k.size(2) == D && v.size(2) == D && k_s.size(2) == D / kQuantGroup && v_s.size(2) == D / kQuantGroup,
+             "sparse_int8kv_decode_attention: head_dim must be a multiple of 8 shared by q, k and v");
+    LK_CHECK(v.size(1) == k.size(1) && k_s.size(1) == k.size(1) && v_s.size(1) == k.size(1) && H % k.size(1) == 0,
+             "sparse_int8kv_decode_attention: heads of q must be a multiple of kv heads");
+    LK_CHECK(req_to_tokens.dtype == DType::Int32 && req_to_tokens.dim() == 2 && req_to_tokens.stride(1) == 1,
+             "sparse_int8kv_decode_attention: req_to_tokens must be [max_reqs, max_len] int32");
+    LK_CHECK(b_req_idx.dtype == DType::Int32 && b_seq_len.dtype == DType::Int32 &&
+             b_req_idx.is_contiguous() && b_seq_len.is_contiguous() && b_req_idx.numel() == B && b_seq_len.numel() == B,
+             "sparse_int8kv_decode_attention: b_req_idx and b_seq_len must be [B] int32");
+    LK_CHECK(page_idx.dtype == DType::Int32 && page_idx.dim() == 3 && page_idx.is_contiguous() &&
+             page_idx.size(0) == B && page_idx.size(1) == k.size(1) && page_idx.size(2) >= 1,
+             "sparse_int8kv_decode_attention: page_idx must be contiguous [B, Hkv, top] int32");
+    for (const TensorView* t : {&o, &k, &k_s, &v, &v_s, &req_to_tokens, &b_req_idx, &b_seq_len, &page_idx}) {
+        LK_CHECK(t->device == q.device && t->device_index == q.device_index,
+                 "sparse_int8kv_decode_attention: all tensors must be on the device of q");
+    }
+    if (B == 0) return;
+
+    if (q.is_cpu()) {
+        const int32_t* lens = b_seq_len.data_ptr<const int32_t>();
+        const int32_t* reqs = b_req_idx.data_ptr<const int32_t>();
+        const int32_t* pages = page_idx.data_ptr<const int32_t>();
+        const int64_t top = page_idx.size(2);
+        for (int64_t b = 0; b < B; b++) {
+            LK_CHECK(lens[b] >= 1 && lens[b] <= req_to_tokens.size(1), "b_seq_len[", b, "] = ", lens[b], " is out of range");
+            LK_CHECK(reqs[b] >= 0 && reqs[b] < req_to_tokens.size(0), "b_req_idx[", b, "] = ", reqs[b], " is out of range");
+            const int32_t* slots = req_to_tokens.data_ptr<const int32_t>() + reqs[b] * req_to_tokens.stride(0);
+            for (int64_t t = 0; t < lens[b]; t++) {
+                LK_CHECK(slots[t] >= 0 && slots[t] < k.size(0), "sparse_int8kv_decode_attention: slot ", slots[t],
+                         " of request ", b, " is past the cache");
+            }
+            const int64_t n = (lens[b] + page_size - 1) / page_size;
+            for (int64_t i = b * k.size(1) * top; i < (b + 1) * k.size(1) * top; i++) {
+                LK_CHECK(pages[i] >= -1 && pages[i] < n, "sparse_int8kv_decode_attention: page ", pages[i],
+                         " of request ", b, " is out of range");
+            }
+            for (int64_t h = 0; h < k.size(1); h++) {
+                const int32_t* row = pages + (b * k.size(1) + h) * top;
+                LK_CHECK(std::any_of(row, row + top, [](int32_t p) { return p >= 0; }),
+                         "sparse_int8kv_decode_attention: request ", b, " kv head ", h, " selects no page");
+            }
+        }
+        sparse_int8kv_decode_attention_cpu(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, page_idx, page_size);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    sparse_int8kv_decode_attention_cuda(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, page_idx, page_size);
+#else
+    LK_NOT_SUPPORTED("sparse_int8kv_decode_attention: the core library was built without CUDA");
+#endif
+}
+
+} // namespace core
+} // namespace lightllm
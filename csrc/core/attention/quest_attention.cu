@@ -0,0 +1,453 @@
+#include "core/ops.h"
+#include "utils.h"
+
+#include <cfloat>
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+namespace {
+
+constexpr int32_t kQuantGroup = 8;
+constexpr int32_t kSummaryTPB = 128;
+constexpr int32_t kScoreWarps = 8;
+constexpr int32_t kSelectTPB = 256;
+constexpr int32_t kSelectWarps = kSelectTPB / 32;
+constexpr int32_t kDecodeWarps = 4;
+constexpr int32_t kKeys = 16;           // keys scored per warp step
+
+/**
+ * @brief Page summary refresh. grid: (slots, Hkv), only the last slot of a
+ * run of one page does work: its threads walk the head dim and reduce the
+ * page's slots up to that one. A slot past the summarized pages traps.
+ */
+template<typename T>
+__global__ __launch_bounds__(kSummaryTPB)
+void device_kv_page_minmax_update(
+    T* __restrict__ page_min, T* __restrict__ page_max,
+    const int8_t* __restrict__ k, const T* __restrict__ k_s,
+    const int32_t* __restrict__ slots, const int64_t n, const int64_t num_slots,
+    const int32_t page_size, const int32_t head_dim
+) {
+    const int64_t i = blockIdx.x;
+    const int32_t h = blockIdx.y;
+    const int32_t Hkv = gridDim.y;
+    const int64_t slot = slots[i];
+    check_kv_slot(slot, num_slots);
+    const int64_t page = slot / page_size;
+    if (i + 1 < n && slots[i + 1] / page_size == page) return;
+
+    for (int32_t d = threadIdx.x; d < head_dim; d += kSummaryTPB) {
+        fp32_t lo = FLT_MAX;
+        fp32_t hi = -FLT_MAX;
+        for (int64_t t = page * page_size; t <= slot; t++) {
+            const fp32_t x = static_cast<fp32_t>(k_s[(t * Hkv + h) * (head_dim / kQuantGroup) + d / kQuantGroup])
+                           * static_cast<fp32_t>(k[(t * Hkv + h) * head_dim + d]);
+            lo = fminf(lo, x);
+            hi = fmaxf(hi, x);
+        }
+        page_min[(page * Hkv + h) * head_dim + d] = static_cast<T>(lo);
+        page_max[(page * Hkv + h) * head_dim + d] = static_cast<T>(hi);
+    }
+}
+
+/**
+ * @brief Quest bound of every page. grid: (B, Hkv, pages / kScoreWarps),
+ * the GQA group of q in shared memory, one warp per page. A slot of a page
+ * with no summary traps.
+ */
+template<typename T>
+__global__ __launch_bounds__(kScoreWarps * 32)
+void device_quest_page_scores(
+    fp32_t* __restrict__ scores, const T* __restrict__ q,
+    const T* __restrict__ page_min, const T* __restrict__ page_max,
+    const int32_t* __restrict__ req_to_tokens, const int32_t* __restrict__ b_req_idx,
+    const int32_t* __restrict__ b_seq_len,
+    const int32_t group, const int32_t head_dim, const int32_t page_size, const int32_t max_pages,
+    const int64_t num_pages, const int64_t q_stride_b, const int64_t q_stride_h, const int64_t req_to_tokens_stride
+) {
+    extern __shared__ fp32_t q_group[];  // [group, head_dim]
+    const int32_t b = blockIdx.x;
+    const int32_t h = blockIdx.y;
+    const int32_t Hkv = gridDim.y;
+    const int32_t warp = threadIdx.x / 32;
+    const int32_t lane = threadIdx.x % 32;
+
+    for (int32_t e = threadIdx.x; e < group * head_dim; e += kScoreWarps * 32) {
+        q_group[e] = static_cast<fp32_t>(q[b * q_stride_b + (h * group + e / head_dim) * q_stride_h + e % head_dim]);
+    }
+    __syncthreads();
+
+    const int32_t n = (b_seq_len[b] + page_size - 1) / page_size;
+    const int32_t j = blockIdx.z * kScoreWarps + warp;
+    if (j >= n) return;
+    const int64_t slot = req_to_tokens[b_req_idx[b] * req_to_tokens_stride + (int64_t)j * page_size];
+    check_kv_slot(slot, num_pages * page_size);
+    const int64_t page = slot / page_size;
+    const T* lo = page_min + (page * Hkv + h) * head_dim;
+    const T* hi = page_max + (page * Hkv + h) * head_dim;
+
+    fp32_t best = -FLT_MAX;
+    for (int32_t g = 0; g < group; g++) {
+        fp32_t bound = 0.0f;
+        for (int32_t d = lane; d < head_dim; d += 32) {
+            const fp32_t qd = q_group[g * head_dim + d];
+            bound += fmaxf(qd * static_cast<fp32_t>(lo[d]), qd * static_cast<fp32_t>(hi[d]));
+        }
+        #pragma unroll
+        for (int32_t mask = 16; mask >= 1; mask /= 2) bound += __shfl_xor_sync(uint32_t(-1), bound, mask);
+        best = fmaxf(best, bound);
+    }
+    // the page of the current token is always attended
+    if (lane == 0) scores[((int64_t)b * Hkv + h) * max_pages + j] = j == n - 1 ? FLT_MAX : best;
+}
+
+// Unsigned key with the order of the float.
+__device__ inline
+uint32_t order_key(const fp32_t x) {
+    const uint32_t bits = __float_as_uint(x);
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// Exclusive count of the set flags of the threads before this one, and the block total.
+__device__ inline
+int32_t block_exclusive_count(const bool flag, int32_t* warp_counts, int32_t& total) {
+    const int32_t warp = threadIdx.x / 32;
+    const int32_t lane = threadIdx.x % 32;
+    const uint32_t ballot = __ballot_sync(uint32_t(-1), flag);
+    __syncthreads();  // warp_counts of the previous call are consumed
+    if (lane == 0) warp_counts[warp] = __popc(ballot);
+    __syncthreads();
+    int32_t before = 0;
+    total = 0;
+    #pragma unroll
+    for (int32_t w = 0; w < kSelectWarps; w++) {
+        before += w < warp ? warp_counts[w] : 0;
+        total += warp_counts[w];
+    }
+    return before + __popc(ballot & ((1u << lane) - 1));
+}
+
+/**
+ * @brief Top pages of every (request, kv head). grid: (B, Hkv). A radix
+ * select (8 bits per pass) finds the score of the top-th page; the pages
+ * above it and the earliest ties are then compacted in page order, so the
+ * result matches the host one.
+ */
+__global__ __launch_bounds__(kSelectTPB)
+void device_quest_select_pages(
+    int32_t* __restrict__ page_idx, const fp32_t* __restrict__ scores, const int32_t* __restrict__ b_seq_len,
+    const int32_t top, const int32_t page_size, const int32_t max_pages
+) {
+    __shared__ int32_t hist[256];
+    __shared__ uint32_t s_prefix;
+    __shared__ int32_t s_remaining;
+    __shared__ int32_t warp_counts[kSelectWarps];
+    const int32_t b = blockIdx.x;
+    const int64_t row = (int64_t)b * gridDim.y + blockIdx.y;
+    const fp32_t* sc = scores + row * max_pages;
+    int32_t* out = page_idx + row * top;
+    const int32_t n = (b_seq_len[b] + page_size - 1) / page_size;
+
+    if (n <= top) {
+        for (int32_t i = threadIdx.x; i < top; i += kSelectTPB) out[i] = i < n ? i : -1;
+        return;
+    }
+
+    if (threadIdx.x == 0) {
+        s_prefix = 0;
+        s_remaining = top;
+    }
+    uint32_t mask = 0;
+    for (int32_t shift = 24; shift >= 0; shift -= 8) {
+        for (int32_t i = threadIdx.x; i < 256; i += kSelectTPB) hist[i] = 0;
+        __syncthreads();
+        const uint32_t prefix = s_prefix;
+        for (int32_t i = threadIdx.x; i < n; i += kSelectTPB) {
+            const uint32_t key = order_key(sc[i]);
+            if ((key & mask) == prefix) atomicAdd(&hist[(key >> shift) & 0xff], 1);
+        }
+        __syncthreads();
+        if (threadIdx.x == 0) {
+            int32_t above = 0;
+            for (int32_t bin = 255; bin >= 0; bin--) {
+                if (above + hist[bin] >= s_remaining) {
+                    s_prefix = prefix | (static_cast<uint32_t>(bin) << shift);
+                    s_remaining -= above;
+                    break;
+                }
+                above += hist[bin];
+            }
+        }
+        mask |= 0xffu << shift;
+        __syncthreads();
+    }
+
+    // s_prefix is the key of the top-th page, s_remaining the ties to keep
+    const uint32_t kth = s_prefix;
+    const int32_t ties = s_remaining;
+    int32_t written = 0;
+    int32_t ties_seen = 0;
+    for (int32_t c = 0; c < n; c += kSelectTPB) {
+        const int32_t i = c + threadIdx.x;
+        const uint32_t key = i < n ? order_key(sc[i]) : 0;
+        const bool above = i < n && key > kth;
+        const bool tie = i < n && key == kth;
+        int32_t tie_total;
+        const int32_t tie_rank = ties_seen + block_exclusive_count(tie, warp_counts, tie_total);
+        const bool keep = above || (tie && tie_rank < ties);
+        int32_t keep_total;
+        const int32_t pos = written + block_exclusive_count(keep, warp_counts, keep_total);
+        if (keep) out[pos] = i;
+        written += keep_total;
+        ties_seen += tie_total;
+    }
+}
+
+/**
+ * @brief Decode attention over the selected pages. grid: (B, H), a warp per
+ * selected page in turn with the online softmax state in registers and a
+ * lane on every 32nd element of the head dim; the warps merge their states
+ * through shared memory at the end. A slot past the cache traps.
+ */
+template<int32_t DPL, typename T>
+__global__ __launch_bounds__(kDecodeWarps * 32)
+void device_sparse_int8kv_decode_attention(
+    T* __restrict__ o, const T* __restrict__ q,
+    const int8_t* __restrict__ k, const T* __restrict__ k_scale,
+    const int8_t* __restrict__ v, const T* __restrict__ v_scale,
+    const int32_t* __restrict__ req_to_tokens, const int32_t* __restrict__ b_req_idx,
+    const int32_t* __restrict__ b_seq_len, const int32_t* __restrict__ page_idx,
+    const int32_t group, const int32_t top, const int32_t page_size, const fp32_t scale,
+    const int64_t o_stride_b, const int64_t o_stride_h, const int64_t q_stride_b, const int64_t q_stride_h,
+    const int64_t kv_stride_s, const int64_t kv_stride_h, const int64_t scale_stride_s, const int64_t scale_stride_h,
+    const int64_t req_to_tokens_stride, const int64_t num_slots
+) {
+    constexpr int32_t D = DPL * 32;
+    __shared__ fp32_t warp_max[kDecodeWarps];
+    __shared__ fp32_t warp_sum[kDecodeWarps];
+    __shared__ fp32_t warp_acc[kDecodeWarps][D];
+    const int32_t b = blockIdx.x;
+    const int32_t head = blockIdx.y;
+    const int32_t kv_head = head / group;
+    const int32_t warp = threadIdx.x / 32;
+    const int32_t lane = threadIdx.x % 32;
+    const int32_t len = b_seq_len[b];
+    const int32_t* slots = req_to_tokens + b_req_idx[b] * req_to_tokens_stride;
+    const int32_t* pages = page_idx + ((int64_t)b * gridDim.y / group + kv_head) * top;
+
+    fp32_t q_reg[DPL];
+    fp32_t acc[DPL];
+    #pragma unroll
+    for (int32_t i = 0; i < DPL; i++) {
+        q_reg[i] = static_cast<fp32_t>(q[b * q_stride_b + head * q_stride_h + lane + i * 32]) * scale;
+        acc[i] = 0.0f;
+    }
+    fp32_t row_max = -FLT_MAX;
+    fp32_t row_sum = 0.0f;
+
+    for (int32_t p = warp; p < top; p += kDecodeWarps) {
+        const int32_t page = pages[p];
+        if (page < 0) continue;  // uniform across the warp
+        const int32_t t0 = page * page_size;
+        const int32_t n = min(page_size, len - t0);
+        for (int32_t c = 0; c < n; c += kKeys) {
+            const int32_t valid = min(kKeys, n - c);
+            fp32_t s[kKeys];
+            fp32_t tile_max = row_max;
+            #pragma unroll
+            for (int32_t j = 0; j < kKeys; j++) {
+                s[j] = -FLT_MAX;
+                if (j < valid) {
+                    // the V pass below reads the same slots
+                    const int64_t slot = slots[t0 + c + j];
+                    check_kv_slot(slot, num_slots);
+                    const int8_t* k8 = k + slot * kv_stride_s + (int64_t)kv_head * kv_stride_h;
+                    const T* ks = k_scale + slot * scale_stride_s + (int64_t)kv_head * scale_stride_h;
+                    fp32_t dot = 0.0f;
+                    #pragma unroll
+                    for (int32_t i = 0; i < DPL; i++) {
+                        const int32_t d = lane + i * 32;
+                        dot += q_reg[i] * static_cast<fp32_t>(ks[d / kQuantGroup]) * static_cast<fp32_t>(k8[d]);
+                    }
+                    #pragma unroll
+                    for (int32_t mask = 16; mask >= 1; mask /= 2) dot += __shfl_xor_sync(uint32_t(-1), dot, mask);
+                    s[j] = dot;
+                    tile_max = fmaxf(tile_max, dot);
+                }
+            }
+
+            const fp32_t alpha = __expf(row_max - tile_max);
+            row_sum *= alpha;
+            #pragma unroll
+            for (int32_t i = 0; i < DPL; i++) acc[i] *= alpha;
+            #pragma unroll
+            for (int32_t j = 0; j < kKeys; j++) {
+                if (j < valid) {
+                    const int64_t slot = slots[t0 + c + j];
+                    const int8_t* v8 = v + slot * kv_stride_s + (int64_t)kv_head * kv_stride_h;
+                    const T* vs = v_scale + slot * scale_stride_s + (int64_t)kv_head * scale_stride_h;
+                    const fp32_t pr = __expf(s[j] - tile_max);
+                    row_sum += pr;
+                    #pragma unroll
+                    for (int32_t i = 0; i < DPL; i++) {
+                        const int32_t d = lane + i * 32;
+                        acc[i] += pr * static_cast<fp32_t>(vs[d / kQuantGroup]) * static_cast<fp32_t>(v8[d]);
+                    }
+                }
+            }
+            row_max = tile_max;
+        }
+    }
+
+    if (lane == 0) {
+        warp_max[warp] = row_max;
+        warp_sum[warp] = row_sum;
+    }
+    #pragma unroll
+    for (int32_t i = 0; i < DPL; i++) warp_acc[warp][lane + i * 32] = acc[i];
+    __syncthreads();
+    if (warp != 0) return;
+
+    fp32_t m = -FLT_MAX;
+    #pragma unroll
+    for (int32_t w = 0; w < kDecodeWarps; w++) m = fmaxf(m, warp_max[w]);
+    fp32_t sum = 0.0f;
+    fp32_t weight[kDecodeWarps];
+    #pragma unroll
+    for (int32_t w = 0; w < kDecodeWarps; w++) {
+        weight[w] = warp_sum[w] > 0.0f ? __expf(warp_max[w] - m) : 0.0f;
+        sum += weight[w] * warp_sum[w];
+    }
+    const fp32_t inv = 1.0f / sum;
+    #pragma unroll
+    for (int32_t i = 0; i < DPL; i++) {
+        fp32_t x = 0.0f;
+        #pragma unroll
+        for (int32_t w = 0; w < kDecodeWarps; w++) x += weight[w] * warp_acc[w][lane + i * 32];
+        o[b * o_stride_b + head * o_stride_h + lane + i * 32] = static_cast<T>(x * inv);
+    }
+}
+
+} // namespace
+
+/**
+ * @brief CUDA backend of core::kv_page_minmax_update, the views are already validated.
+ */
+void kv_page_minmax_update_cuda(
+    const TensorView& page_min, const TensorView& page_max, const TensorView& k, const TensorView& k_s,
+    const TensorView& slots, const int64_t page_size
+) {
+    const dim3 grid(slots.numel(), k.size(1));
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        device_kv_page_minmax_update<T>
+        <<<grid, kSummaryTPB, 0, static_cast<cudaStream_t>(k.stream)>>>(
+            page_min.data_ptr<T>(), page_max.data_ptr<T>(), k.data_ptr<const int8_t>(), k_s.data_ptr<const T>(),
+            slots.data_ptr<const int32_t>(), slots.numel(), page_min.size(0) * page_size,
+            static_cast<int32_t>(page_size), static_cast<int32_t>(k.size(2))
+        );
+    };
+
+    switch (k_s.dtype) {
+        case DType::BFloat16: run(bf16_t{}); break;
+        case DType::Float16: run(fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("kv_page_minmax_update does not support ", dtype_name(k_s.dtype));
+    }
+}
+
+/**
+ * @brief CUDA backend of core::quest_select_pages, the views are already validated.
+ */
+void quest_select_pages_cuda(
+    const TensorView& page_idx, const TensorView& scores, const TensorView& q,
+    const TensorView& page_min, const TensorView& page_max,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t page_size
+) {
+    const int64_t B = q.size(0);
+    const int64_t Hkv = page_min.size(1);
+    const int64_t D = q.size(2);
+    const int32_t group = static_cast<int32_t>(q.size(1) / Hkv);
+    const int64_t max_pages = scores.size(2);
+    const size_t smem = static_cast<size_t>(group) * D * sizeof(fp32_t);
+    LK_CHECK(smem <= 48 * 1024, "quest_select_pages: a GQA group of ", group, " heads of ", D, " is too large");
+    const cudaStream_t stream = static_cast<cudaStream_t>(q.stream);
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        const dim3 grid(B, Hkv, (max_pages + kScoreWarps - 1) / kScoreWarps);
+        device_quest_page_scores<T>
+        <<<grid, kScoreWarps * 32, smem, stream>>>(
+            scores.data_ptr<fp32_t>(), q.data_ptr<const T>(), page_min.data_ptr<const T>(), page_max.data_ptr<const T>(),
+            req_to_tokens.data_ptr<const int32_t>(), b_req_idx.data_ptr<const int32_t>(), b_seq_len.data_ptr<const int32_t>(),
+            group, static_cast<int32_t>(D), static_cast<int32_t>(page_size), static_cast<int32_t>(max_pages),
+            page_min.size(0), q.stride(0), q.stride(1), req_to_tokens.stride(0)
+        );
+    };
+
+    switch (q.dtype) {
+        case DType::BFloat16: run(bf16_t{}); break;
+        case DType::Float16: run(fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("quest_select_pages does not support ", dtype_name(q.dtype));
+    }
+    device_quest_select_pages<<<dim3(B, Hkv), kSelectTPB, 0, stream>>>(
+        page_idx.data_ptr<int32_t>(), scores.data_ptr<const fp32_t>(), b_seq_len.data_ptr<const int32_t>(),
+        static_cast<int32_t>(page_idx.size(2)), static_cast<int32_t>(page_size), static_cast<int32_t>(max_pages)
+    );
+}
+
+/**
+ * @brief CUDA backend of core::sparse_int8kv_decode_attention, the views are already validated.
+ */
+void sparse_int8kv_decode_attention_cuda(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& page_idx, const int64_t page_size
+) {
+    const int64_t D = q.size(2);
+    LK_CHECK(D % 32 == 0 && D <= 256, "sparse_int8kv_decode_attention: CUDA needs a head_dim that is a multiple of 32 up to 256, got ", D);
+    const int32_t group = static_cast<int32_t>(q.size(1) / k.size(1));
+    const dim3 grid(q.size(0), q.size(1));
+
+    auto run = [&](auto type_tag, auto dims_per_lane) {
+        using T = decltype(type_tag);
+        device_sparse_int8kv_decode_attention<decltype(dims_per_lane)::value, T>
+        <<<grid, kDecodeWarps * 32, 0, static_cast<cudaStream_t>(q.stream)>>>(
+            o.data_ptr<T>(), q.data_ptr<const T>(),
+            k.data_ptr<const int8_t>(), k_s.data_ptr<const T>(), v.data_ptr<const int8_t>(), v_s.data_ptr<const T>(),
+            req_to_tokens.data_ptr<const int32_t>(), b_req_idx.data_ptr<const int32_t>(),
+            b_seq_len.data_ptr<const int32_t>(), page_idx.data_ptr<const int32_t>(),
+            group, static_cast<int32_t>(page_idx.size(2)), static_cast<int32_t>(page_size),
+            1.0f / std::sqrt(static_cast<fp32_t>(D)),
+            o.stride(0), o.stride(1), q.stride(0), q.stride(1),
+            k.stride(0), k.stride(1), k_s.stride(0), k_s.stride(1),
+            req_to_tokens.stride(0), k.size(0)
+        );
+    };
+    auto dispatch = [&](auto type_tag) {
+        using std::integral_constant;
+        switch (D / 32) {
+            case 1: run(type_tag, integral_constant<int32_t, 1>{}); break;
+            case 2: run(type_tag, integral_constant<int32_t, 2>{}); break;
+            case 3: run(type_tag, integral_constant<int32_t, 3>{}); break;
+            case 4: run(type_tag, integral_constant<int32_t, 4>{}); break;
+            case 5: run(type_tag, integral_constant<int32_t, 5>{}); break;
+            case 6: run(type_tag, integral_constant<int32_t, 6>{}); break;
+            case 7: run(type_tag, integral_constant<int32_t, 7>{}); break;
+            case 8: run(type_tag, integral_constant<int32_t, 8>{}); break;
+        }
+    };
+
+    switch (q.dtype) {
+        case DType::BFloat16: dispatch(bf16_t{}); break;
+        case DType::Float16: dispatch(fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("sparse_int8kv_decode_attention does not support ", dtype_name(q.dtype));
+    }
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,200 @@
+#include "core/ops.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+// Query rows and keys per tile of the host kernel.
+constexpr int64_t kBlockM = 16;
+constexpr int64_t kBlockN = 64;
+
+struct AttnTile {
+    int64_t q_begin;   // first token of the tile
+    int64_t rows;      // <= kBlockM
+    int64_t kv_begin;  // first token of the sequence
+    int64_t kv_len;
+    int64_t head;
+};
+
+/**
+ * @brief One query tile of one head against all keys of its sequence, with
+ * the online softmax of flash attention: fp32 tiles of Q, K^T and V in
+ * scratch, running (max, sum) per row and a rescaled fp32 accumulator, so
+ * the [L, L] score matrix is never materialised.
+ */
+template<typename T>
+void attention_tile(
+    const AttnTile& tile, const TensorView& out, const TensorView& q,
+    const TensorView& k, const TensorView& v, const int64_t D,
+    const int64_t group, const fp32_t scale, std::vector<fp32_t>& scratch
+) {
+    scratch.resize(kBlockM * D * 2 + kBlockN * D * 2 + kBlockM * (kBlockN + 2));
+    fp32_t* q_f = scratch.data();            // [M, D], pre-scaled
+    fp32_t* acc = q_f + kBlockM * D;         // [M, D]
+    fp32_t* k_t = acc + kBlockM * D;         // [D, N]
+    fp32_t* v_f = k_t + kBlockN * D;         // [N, D]
+    fp32_t* s = v_f + kBlockN * D;           // [M, N]
+    fp32_t* row_max = s + kBlockM * kBlockN; // [M]
+    fp32_t* row_sum = row_max + kBlockM;     // [M]
+    const CpuKernels& kernels = cpu_kernels();
+
+    const int64_t kv_head = tile.head / group;
+    for (int64_t i = 0; i < tile.rows; i++) {
+        const T* src = q.data_ptr<const T>() + (tile.q_begin + i) * q.stride(0) + tile.head * q.stride(1);
+        for (int64_t d = 0; d < D; d++) q_f[i * D + d] = to_float(src[d]) * scale;
+        row_max[i] = -std::numeric_limits<fp32_t>::infinity();
+        row_sum[i] = 0.0f;
+    }
+    std::fill(acc, acc + tile.rows * D, 0.0f);
+
+    for (int64_t j0 = 0; j0 < tile.kv_len; j0 += kBlockN) {
+        const int64_t n = std::min(kBlockN, tile.kv_len - j0);
+        for (int64_t j = 0; j < n; j++) {
+            const int64_t t = tile.kv_begin + j0 + j;
+            const T* k_row = k.data_ptr<const T>() + t * k.stride(0) + kv_head * k.stride(1);
+            const T* v_row = v.data_ptr<const T>() + t * v.stride(0) + kv_head * v.stride(1);
+            for (int64_t d = 0; d < D; d++) {
+                k_t[d * kBlockN + j] = to_float(k_row[d]);
+                v_f[j * D + d] = to_float(v_row[d]);
+            }
+        }
+
+        for (int64_t i = 0; i < tile.rows; i++) {
+            // scores of row i, vectorised over the keys
+            fp32_t* s_i = s + i * kBlockN;
+            std::fill(s_i, s_i + n, 0.0f);
+            for (int64_t d = 0; d < D; d++) {
+                const fp32_t qd = q_f[i * D + d];
+                const fp32_t* k_d = k_t + d * kBlockN;
+                for (int64_t j = 0; j < n; j++) s_i[j] += qd * k_d[j];
+            }
+
+            fp32_t tile_max = row_max[i];
+            for (int64_t j = 0; j < n; j++) tile_max = std::max(tile_max, s_i[j]);
+            const fp32_t alpha = std::exp(row_max[i] - tile_max);
+            fp32_t sum = 0.0f;
+            for (int64_t j = 0; j < n; j++) {
+                s_i[j] = std::exp(s_i[j] - tile_max);
+                sum += s_i[j];
+            }
+            row_sum[i] = row_sum[i] * alpha + sum;
+            row_max[i] = tile_max;
+
+            fp32_t* acc_i = acc + i * D;
+            for (int64_t d = 0; d < D; d++) acc_i[d] *= alpha;
+            for (int64_t j = 0; j < n; j++) kernels.axpy(s_i[j], v_f + j * D, acc_i, D);
+        }
+    }
+
+    for (int64_t i = 0; i < tile.rows; i++) {
+        T* dst = out.data_ptr<T>() + (tile.q_begin + i) * out.stride(0) + tile.head * out.stride(1);
+        const fp32_t inv = row_sum[i] > 0.0f ? 1.0f / row_sum[i] : 0.0f;
+        for (int64_t d = 0; d < D; d++) dst[d] = from_float<T>(acc[i * D + d] * inv);
+    }
+}
+
+} // namespace
+
+void varlen_attention_cpu(
+    const TensorView& out, const TensorView& q, const TensorView& k, const TensorView& v,
+    const TensorView& cu_seqlens, const int64_t max_seqlen, const fp32_t softmax_scale
+) {
+    (void)max_seqlen;
+    const int64_t B = cu_seqlens.numel() - 1;
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    const int64_t group = H / k.size(1);
+    const int32_t* cu = cu_seqlens.data_ptr<const int32_t>();
+
+    std::vector<AttnTile> tiles;
+    for (int64_t b = 0; b < B; b++) {
+        const int64_t len = cu[b + 1] - cu[b];
+        for (int64_t h = 0; h < H; h++) {
+            for (int64_t m = 0; m < len; m += kBlockM) {
+                tiles.push_back({cu[b] + m, std::min(kBlockM, len - m), cu[b], len, h});
+            }
+        }
+    }
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        parallel_for(0, static_cast<int64_t>(tiles.size()), 1, [&](int64_t begin, int64_t end) {
+            std::vector<fp32_t> scratch;
+            for (int64_t t = begin; t < end; t++) {
+                attention_tile<T>(tiles[t], out, q, k, v, D, group, softmax_scale, scratch);
+            }
+        });
+    };
+
+    switch (q.dtype) {
+        case DType::BFloat16: run(host_bf16_t{}); break;
+        case DType::Float16: run(host_fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("varlen_attention does not support ", dtype_name(q.dtype));
+    }
+}
+
+/**
+ * @brief Non-causal (bidirectional) attention over packed variable length
+ * sequences, e.g. the patches of the images of a ViT batch: every token
+ * attends to all tokens of its own sequence and to no other.
+ *
+ * @param out           [T, H, D] output, same dtype as q.
+ * @param q             [T, H, D] bf16 / fp16 queries of all sequences back to
+ *                      back; the head dim must be contiguous (e.g. a slice of
+ *                      a packed qkv projection).
+ * @param k, v          [T, Hkv, D] keys and values, H % Hkv == 0.
+ * @param cu_seqlens    [B + 1] contiguous int32 prefix sums of the sequence
+ *                      lengths, cu_seqlens[B] == T; on the device of q.
+ * @param max_seqlen    Longest sequence, sizes the CUDA grid (unused on CPU).
+ * @param softmax_scale Scale of q @ k^T, typically 1 / sqrt(D).
+ */
+void varlen_attention(
+    const TensorView& out, const TensorView& q, const TensorView& k, const TensorView& v,
+    const TensorView& cu_seqlens, const int64_t max_seqlen, const fp32_t softmax_scale
+) {
+    LK_CHECK(q.dim() == 3 && k.dim() == 3 && v.dim() == 3 && out.dim() == 3, "q, k, v and out must be [T, heads, D]");
+    LK_CHECK(q.dtype == k.dtype && q.dtype == v.dtype && q.dtype == out.dtype, "q, k, v and out must have one dtype");
+    LK_CHECK(q.stride(2) == 1 && k.stride(2) == 1 && v.stride(2) == 1 && out.stride(2) == 1,
+             "the head dim of q, k, v and out must be contiguous");
+    const int64_t T = q.size(0);
+    const int64_t H = q.size(1);
+    const int64_t D = q.size(2);
+    LK_CHECK(k.size(0) == T && v.size(0) == T && out.size(0) == T, "q, k, v and out must have the same tokens");
+    LK_CHECK(out.size(1) == H && out.size(2) == D && k.size(2) == D && v.size(2) == D, "shape mismatch");
+    LK_CHECK(k.size(1) == v.size(1) && k.size(1) > 0 && H % k.size(1) == 0, "heads of q must be a multiple of kv heads");
+    LK_CHECK(D == 64 || D == 80 || D == 128, "varlen_attention supports head_dim 64, 80 and 128, got ", D);
+    LK_CHECK(cu_seqlens.dtype == DType::Int32 && cu_seqlens.dim() == 1 && cu_seqlens.is_contiguous() &&
+             cu_seqlens.numel() >= 1, "cu_seqlens must be a contiguous [B + 1] int32 tensor");
+    LK_CHECK(cu_seqlens.device == q.device, "cu_seqlens must be on the device of q");
+    for (const TensorView* t : {&k, &v, &out}) {
+        LK_CHECK(t->device == q.device && t->device_index == q.device_index, "q, k, v and out must be on one device");
+    }
+    if (T == 0 || cu_seqlens.numel() == 1) return;
+
+    if (q.is_cpu()) {
+        const int32_t* cu = cu_seqlens.data_ptr<const int32_t>();
+        const int64_t B = cu_seqlens.numel() - 1;
+        LK_CHECK(cu[0] == 0 && cu[B] == T, "cu_seqlens must go from 0 to the number of tokens");
+        for (int64_t b = 0; b < B; b++) LK_CHECK(cu[b + 1] >= cu[b], "cu_seqlens must be non decreasing");
+        varlen_attention_cpu(out, q, k, v, cu_seqlens, max_seqlen, softmax_scale);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    LK_CHECK(max_seqlen > 0, "varlen_attention: max_seqlen must be > 0 on CUDA");
+    varlen_attention_cuda(out, q, k, v, cu_seqlens, max_seqlen, softmax_scale);
+#else
+    LK_NOT_SUPPORTED("varlen_attention: the core library was built without CUDA");
+#endif
+}
+
+} // namespace core
+} // namespace lightllm
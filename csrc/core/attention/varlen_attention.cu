@@ -0,0 +1,162 @@
+#include "core/ops.h"
+#include "utils.h"
+
+#include <cfloat>
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+namespace {
+
+constexpr int32_t kBlockM = 32;         // query rows per block
+constexpr int32_t kBlockN = 32;         // keys per shared memory tile
+constexpr int32_t kThreadsPerRow = 4;   // threads sharing one query row
+constexpr int32_t kTPB = kBlockM * kThreadsPerRow;
+
+/**
+ * @brief Non-causal varlen attention, flash attention style: a block owns
+ * kBlockM query rows of one head of one sequence and streams the keys and
+ * values of the sequence through shared memory in tiles of kBlockN, keeping
+ * the online softmax state (max, sum) and the output accumulator in
+ * registers. kThreadsPerRow adjacent lanes share a row, each holding every
+ * kThreadsPerRow-th element of the head dim; a dot product is finished with
+ * two xor shuffles.
+ *
+ * grid: (ceil(max_seqlen / kBlockM), H, B)
+ */
+template<int32_t D, typename T>
+__global__ __launch_bounds__(kTPB)
+void device_varlen_attention(
+    T* __restrict__ out, const T* __restrict__ q, const T* __restrict__ k, const T* __restrict__ v,
+    const int32_t* __restrict__ cu_seqlens,
+    const int64_t out_stride, const int64_t q_stride, const int64_t k_stride, const int64_t v_stride,
+    const int32_t group, const fp32_t scale
+) {
+    constexpr int32_t DPT = D / kThreadsPerRow;
+    __shared__ fp32_t k_tile[kBlockN][D];
+    __shared__ fp32_t v_tile[kBlockN][D];
+
+    const int32_t b = blockIdx.z;
+    const int32_t head = blockIdx.y;
+    const int32_t kv_head = head / group;
+    const int64_t seq_begin = cu_seqlens[b];
+    const int32_t len = cu_seqlens[b + 1] - cu_seqlens[b];
+    const int32_t m0 = blockIdx.x * kBlockM;
+    if (m0 >= len) return;  // uniform across the block
+
+    const int32_t row = threadIdx.x / kThreadsPerRow;
+    const int32_t part = threadIdx.x % kThreadsPerRow;
+    const bool valid = m0 + row < len;
+    const int64_t token = seq_begin + m0 + (valid ? row : 0);
+
+    fp32_t q_reg[DPT];
+    fp32_t o_reg[DPT];
+    #pragma unroll
+    for (int32_t i = 0; i < DPT; i++) {
+        q_reg[i] = static_cast<fp32_t>(q[token * q_stride + (int64_t)head * D + part + i * kThreadsPerRow]) * scale;
+        o_reg[i] = 0.0f;
+    }
+    fp32_t row_max = -FLT_MAX;
+    fp32_t row_sum = 0.0f;
+
+    for (int32_t n0 = 0; n0 < len; n0 += kBlockN) {
+        const int32_t n = min(kBlockN, len - n0);
+        for (int32_t e = threadIdx.x; e < kBlockN * D; e += kTPB) {
+            const int32_t j = e / D;
+            const int32_t d = e % D;
+            if (j < n) {
+                const int64_t t = seq_begin + n0 + j;
+                k_tile[j][d] = static_cast<fp32_t>(k[t * k_stride + (int64_t)kv_head * D + d]);
+                v_tile[j][d] = static_cast<fp32_t>(v[t * v_stride + (int64_t)kv_head * D + d]);
+            }
+        }
+        __syncthreads();
+
+        fp32_t s[kBlockN];
+        fp32_t tile_max = row_max;
+        #pragma unroll
+        for (int32_t j = 0; j < kBlockN; j++) {
+            fp32_t dot = 0.0f;
+            #pragma unroll
+            for (int32_t i = 0; i < DPT; i++) dot += q_reg[i] * k_tile[j][part + i * kThreadsPerRow];
+            #pragma unroll
+            for (int32_t mask = kThreadsPerRow / 2; mask >= 1; mask /= 2) {
+                dot += __shfl_xor_sync(uint32_t(-1), dot, mask);
+            }
+            s[j] = j < n ? dot : -FLT_MAX;
+            tile_max = fmaxf(tile_max, s[j]);
+        }
+
+        const fp32_t alpha = __expf(row_max - tile_max);
+        row_sum *= alpha;
+        #pragma unroll
+        for (int32_t i = 0; i < DPT; i++) o_reg[i] *= alpha;
+        #pragma unroll
+        for (int32_t j = 0; j < kBlockN; j++) {
+            const fp32_t p = j < n ? __expf(s[j] - tile_max) : 0.0f;
+            row_sum += p;
+            #pragma unroll
+            for (int32_t i = 0; i < DPT; i++) o_reg[i] += p * v_tile[j][part + i * kThreadsPerRow];
+        }
+        row_max = tile_max;
+        __syncthreads();
+    }
+
+    if (!valid) return;
+    const fp32_t inv = 1.0f / row_sum;
+    #pragma unroll
+    for (int32_t i = 0; i < DPT; i++) {
+        out[token * out_stride + (int64_t)head * D + part + i * kThreadsPerRow] = static_cast<T>(o_reg[i] * inv);
+    }
+}
+
+template<int32_t D, typename T>
+void launch_varlen_attention(
+    const TensorView& out, const TensorView& q, const TensorView& k, const TensorView& v,
+    const TensorView& cu_seqlens, const int64_t max_seqlen, const fp32_t softmax_scale
+) {
+    const int64_t B = cu_seqlens.numel() - 1;
+    const int64_t H = q.size(1);
+    const dim3 grid((max_seqlen + kBlockM - 1) / kBlockM, H, B);
+    device_varlen_attention<D, T>
+    <<<grid, kTPB, 0, static_cast<cudaStream_t>(q.stream)>>>(
+        out.data_ptr<T>(), q.data_ptr<const T>(), k.data_ptr<const T>(), v.data_ptr<const T>(),
+        cu_seqlens.data_ptr<const int32_t>(),
+        out.stride(0), q.stride(0), k.stride(0), v.stride(0),
+        static_cast<int32_t>(H / k.size(1)), softmax_scale
+    );
+}
+
+} // namespace
+
+/**
+ * @brief CUDA backend of core::varlen_attention, the views are already
+ * validated; heads are addressed as head * D, so dim 1 must be dense.
+ */
+void varlen_attention_cuda(
+    const TensorView& out, const TensorView& q, const TensorView& k, const TensorView& v,
+    const TensorView& cu_seqlens, const int64_t max_seqlen, const fp32_t softmax_scale
+) {
+    const int64_t D = q.size(2);
+    for (const TensorView* t : {&out, &q, &k, &v}) {
+        LK_CHECK(t->stride(1) == D, "varlen_attention: the heads of a token must be contiguous on CUDA");
+    }
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        switch (D) {
+            case 64: launch_varlen_attention<64, T>(out, q, k, v, cu_seqlens, max_seqlen, softmax_scale); break;
+            case 80: launch_varlen_attention<80, T>(out, q, k, v, cu_seqlens, max_seqlen, softmax_scale); break;
+            default: launch_varlen_attention<128, T>(out, q, k, v, cu_seqlens, max_seqlen, softmax_scale); break;
+        }
+    };
+    switch (q.dtype) {
+        case DType::BFloat16: run(bf16_t{}); break;
+        case DType::Float16: run(fp16_t{}); break;
+        default: LK_NOT_SUPPORTED("varlen_attention does not support ", dtype_name(q.dtype));
+    }
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,653 @@
+#include "core/lightllm_c.h"
+#include "core/cpu_isa.h"
+#include "core/cpu_stream.h"
+#include "core/expert_cache.h"
+#include "core/kv_allocator.h"
+#include "core/kv_transfer.h"
+#include "core/ops.h"
+#include "core/thread_pool.h"
+#include "core/weight_loader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace lightllm::core;
+
+namespace {
+
+thread_local std::string tls_last_error;
+
+/**
+ * Runs fn and converts the exceptions of the core library into status codes,
+ * nothing may unwind through the C ABI.
+ */
+template <typename F>
+lk_status_t guarded(const F& fn) {
+    try {
+        fn();
+        return LK_SUCCESS;
+    } catch (const std::invalid_argument& e) {
+        tls_last_error = e.what();
+        return LK_ERROR_INVALID_ARGUMENT;
+    } catch (const NotSupported& e) {
+        tls_last_error = e.what();
+        return LK_ERROR_NOT_SUPPORTED;
+    } catch (const std::exception& e) {
+        tls_last_error = e.what();
+        return LK_ERROR_RUNTIME;
+    } catch (...) {
+        tls_last_error = "unknown error";
+        return LK_ERROR_RUNTIME;
+    }
+}
+
+TensorView view(const lk_tensor_t* t, const char* name) {
+    if (t == nullptr) throw std::invalid_argument(std::string(name) + " must not be NULL");
+    return TensorView::from_c(*t);
+}
+
+std::vector<TensorView> views(const lk_tensor_t* caches, int32_t num_caches, const char* name = "caches") {
+    if (caches == nullptr || num_caches < 0) throw std::invalid_argument(std::string(name) + " must not be NULL");
+    std::vector<TensorView> vs;
+    for (int32_t i = 0; i < num_caches; i++) vs.push_back(TensorView::from_c(caches[i]));
+    return vs;
+}
+
+/**
+ * Runs an op, or enqueues it when the anchor tensor is on the CPU with an
+ * lk_cpu_stream_t as its stream. make_op resolves the views and returns the
+ * call with them bound by value, so the caller's lk_tensor_t may go away; the
+ * op itself validates its arguments, an enqueued one reports its errors via
+ * lk_cpu_stream_synchronize.
+ */
+template <typename Make>
+lk_status_t launch(const lk_tensor_t* anchor, const Make& make_op) {
+    return guarded([&] {
+        auto op = make_op();
+        CpuStream* stream = anchor != nullptr && anchor->device_type == LK_DEVICE_CPU
+                                ? reinterpret_cast<CpuStream*>(anchor->stream)
+                                : nullptr;
+        if (stream == nullptr) {
+            op();
+        } else {
+            stream->enqueue(std::move(op));
+        }
+    });
+}
+
+} // namespace
+
+extern "C" {
+
+int32_t lk_abi_version(void) { return LK_ABI_VERSION; }
+
+const char* lk_get_last_error(void) { return tls_last_error.c_str(); }
+
+int32_t lk_has_cuda(void) {
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+lk_status_t lk_set_num_threads(int32_t num_threads) {
+    return guarded([&] { set_num_threads(num_threads); });
+}
+
+int32_t lk_get_num_threads(void) { return get_num_threads(); }
+
+lk_status_t lk_set_cpu_isa(const char* isa) {
+    return guarded([&] { set_cpu_isa(parse_cpu_isa(isa)); });
+}
+
+const char* lk_get_cpu_isa(int32_t detected) {
+    return cpu_isa_name(detected != 0 ? detected_cpu_isa() : active_cpu_isa());
+}
+
+lk_status_t lk_cpu_stream_create(lk_cpu_stream_t** stream) {
+    return guarded([&] {
+        if (stream == nullptr) throw std::invalid_argument("stream must not be NULL");
+        *stream = reinterpret_cast<lk_cpu_stream_t*>(new CpuStream());
+    });
+}
+
+void lk_cpu_stream_destroy(lk_cpu_stream_t* stream) { delete reinterpret_cast<CpuStream*>(stream); }
+
+lk_status_t lk_cpu_stream_synchronize(lk_cpu_stream_t* stream) {
+    return guarded([&] {
+        if (stream == nullptr) throw std::invalid_argument("stream must not be NULL");
+        reinterpret_cast<CpuStream*>(stream)->synchronize();
+    });
+}
+
+int32_t lk_cpu_stream_query(lk_cpu_stream_t* stream) {
+    return stream == nullptr || reinterpret_cast<CpuStream*>(stream)->query() ? 1 : 0;
+}
+
+lk_status_t lk_cpu_stream_launch(lk_cpu_stream_t* stream, void (*fn)(void*), void* user_data) {
+    return guarded([&] {
+        if (stream == nullptr || fn == nullptr) throw std::invalid_argument("stream and fn must not be NULL");
+        reinterpret_cast<CpuStream*>(stream)->enqueue([fn, user_data] { fn(user_data); });
+    });
+}
+
+// An lk_cpu_event_t owns a reference to the event, the stream may complete it after destroy.
+lk_status_t lk_cpu_event_record(lk_cpu_stream_t* stream, lk_cpu_event_t** event) {
+    return guarded([&] {
+        if (stream == nullptr || event == nullptr) throw std::invalid_argument("stream and event must not be NULL");
+        auto* e = new std::shared_ptr<CpuEvent>(reinterpret_cast<CpuStream*>(stream)->record());
+        *event = reinterpret_cast<lk_cpu_event_t*>(e);
+    });
+}
+
+lk_status_t lk_cpu_stream_wait_event(lk_cpu_stream_t* stream, const lk_cpu_event_t* event) {
+    return guarded([&] {
+        if (stream == nullptr || event == nullptr) throw std::invalid_argument("stream and event must not be NULL");
+        reinterpret_cast<CpuStream*>(stream)->wait(*reinterpret_cast<const std::shared_ptr<CpuEvent>*>(event));
+    });
+}
+
+lk_status_t lk_cpu_event_synchronize(const lk_cpu_event_t* event) {
+    return guarded([&] {
+        if (event == nullptr) throw std::invalid_argument("event must not be NULL");
+        (*reinterpret_cast<const std::shared_ptr<CpuEvent>*>(event))->synchronize();
+    });
+}
+
+int32_t lk_cpu_event_query(const lk_cpu_event_t* event) {
+    return event == nullptr || (*reinterpret_cast<const std::shared_ptr<CpuEvent>*>(event))->query() ? 1 : 0;
+}
+
+void lk_cpu_event_destroy(lk_cpu_event_t* event) { delete reinterpret_cast<std::shared_ptr<CpuEvent>*>(event); }
+
+lk_status_t lk_rmsnorm(const lk_tensor_t* x, const lk_tensor_t* w, lk_tensor_t* y, float eps) {
+    return launch(y, [&] { return std::bind(rmsnorm, view(x, "x"), view(w, "w"), view(y, "y"), eps); });
+}
+
+lk_status_t lk_make_rmsnorm_plan(const lk_tensor_t* x, float eps, const lk_rmsnorm_plan_t** plan) {
+    return guarded([&] {
+        if (plan == nullptr) throw std::invalid_argument("plan must not be NULL");
+        const RmsNormPlan& p = make_rmsnorm_plan(TensorMeta::of(view(x, "x")), eps);
+        *plan = reinterpret_cast<const lk_rmsnorm_plan_t*>(&p);
+    });
+}
+
+lk_status_t lk_rmsnorm_plan_run(
+    const lk_rmsnorm_plan_t* plan, const void* x, const void* w, void* y, int64_t m, void* stream
+) {
+    return guarded([&] {
+        if (plan == nullptr) throw std::invalid_argument("plan must not be NULL");
+        if (m < 0) throw std::invalid_argument("m must not be negative");
+        reinterpret_cast<const RmsNormPlan*>(plan)->run(x, w, y, m, stream);
+    });
+}
+
+lk_status_t lk_add_norm_quant(
+    lk_tensor_t* x, const lk_tensor_t* r, const lk_tensor_t* w,
+    lk_tensor_t* y, lk_tensor_t* scales, float eps
+) {
+    return launch(y, [&] {
+        return std::bind(add_norm_quant, view(x, "x"), view(r, "r"), view(w, "w"), view(y, "y"),
+                         view(scales, "scales"), eps);
+    });
+}
+
+lk_status_t lk_scaled_mm(
+    lk_tensor_t* c, const lk_tensor_t* a, const lk_tensor_t* b,
+    const lk_tensor_t* a_scales, const lk_tensor_t* b_scales,
+    const lk_tensor_t* bias, const lk_tensor_t* ls
+) {
+    return launch(c, [&] {
+        return std::bind(scaled_mm, view(c, "c"), view(a, "a"), view(b, "b"), view(a_scales, "a_scales"),
+                         view(b_scales, "b_scales"), bias != nullptr ? view(bias, "bias") : TensorView(),
+                         ls != nullptr ? view(ls, "ls") : TensorView());
+    });
+}
+
+lk_status_t lk_logprobs_topn_partial(
+    lk_tensor_t* topn_vals, lk_tensor_t* topn_ids,
+    lk_tensor_t* sampled_vals, lk_tensor_t* stats,
+    const lk_tensor_t* logits, const lk_tensor_t* sampled_ids,
+    int64_t vocab_start, int32_t normalize
+) {
+    return launch(topn_vals, [&] {
+        return std::bind(
+            logprobs_topn_partial, view(topn_vals, "topn_vals"), view(topn_ids, "topn_ids"),
+            view(sampled_vals, "sampled_vals"), view(stats, "stats"),
+            view(logits, "logits"), view(sampled_ids, "sampled_ids"),
+            vocab_start, normalize != 0);
+    });
+}
+
+lk_status_t lk_logprobs_topn_merge(
+    lk_tensor_t* out_logprobs, lk_tensor_t* out_ids, lk_tensor_t* out_sampled,
+    const lk_tensor_t* stats, const lk_tensor_t* topn_vals,
+    const lk_tensor_t* topn_ids, const lk_tensor_t* sampled_vals
+) {
+    return launch(out_logprobs, [&] {
+        return std::bind(
+            logprobs_topn_merge, view(out_logprobs, "out_logprobs"), view(out_ids, "out_ids"),
+            view(out_sampled, "out_sampled"), view(stats, "stats"),
+            view(topn_vals, "topn_vals"), view(topn_ids, "topn_ids"),
+            view(sampled_vals, "sampled_vals"));
+    });
+}
+
+lk_status_t lk_varlen_attention(
+    lk_tensor_t* out, const lk_tensor_t* q, const lk_tensor_t* k, const lk_tensor_t* v,
+    const lk_tensor_t* cu_seqlens, int64_t max_seqlen, float softmax_scale
+) {
+    return launch(out, [&] {
+        return std::bind(varlen_attention, view(out, "out"), view(q, "q"), view(k, "k"), view(v, "v"),
+                         view(cu_seqlens, "cu_seqlens"), max_seqlen, softmax_scale);
+    });
+}
+
+lk_status_t lk_int8kv_decode_attention(
+    lk_tensor_t* o, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    int64_t max_len_in_batch, int32_t int8_qk
+) {
+    return launch(o, [&] {
+        DecodeAttentionOptions options;
+        options.int8_qk = int8_qk != 0;
+        return std::bind(int8kv_decode_attention, view(o, "o"), view(q, "q"), view(k, "k"), view(k_s, "k_s"),
+                         view(v, "v"), view(v_s, "v_s"), view(req_to_tokens, "req_to_tokens"),
+                         view(b_req_idx, "b_req_idx"), view(b_seq_len, "b_seq_len"), max_len_in_batch, options);
+    });
+}
+
+lk_status_t lk_decode_attention(
+    lk_tensor_t* o, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    int64_t max_len_in_batch
+) {
+    return launch(o, [&] {
+        return std::bind(decode_attention, view(o, "o"), view(q, "q"), view(k, "k"),
+                         k_s != nullptr ? view(k_s, "k_s") : TensorView(), view(v, "v"),
+                         v_s != nullptr ? view(v_s, "v_s") : TensorView(), view(req_to_tokens, "req_to_tokens"),
+                         view(b_req_idx, "b_req_idx"), view(b_seq_len, "b_seq_len"), max_len_in_batch,
+                         DecodeAttentionOptions());
+    });
+}
+
+lk_status_t lk_kv_page_minmax_update(
+    lk_tensor_t* page_min, lk_tensor_t* page_max, const lk_tensor_t* k, const lk_tensor_t* k_s,
+    const lk_tensor_t* slots, int64_t page_size
+) {
+    return launch(page_min, [&] {
+        return std::bind(kv_page_minmax_update, view(page_min, "page_min"), view(page_max, "page_max"), view(k, "k"),
+                         view(k_s, "k_s"), view(slots, "slots"), page_size);
+    });
+}
+
+lk_status_t lk_quest_select_pages(
+    lk_tensor_t* page_idx, lk_tensor_t* scores, const lk_tensor_t* q,
+    const lk_tensor_t* page_min, const lk_tensor_t* page_max,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    int64_t page_size
+) {
+    return launch(page_idx, [&] {
+        return std::bind(quest_select_pages, view(page_idx, "page_idx"), view(scores, "scores"), view(q, "q"),
+                         view(page_min, "page_min"), view(page_max, "page_max"),
+                         view(req_to_tokens, "req_to_tokens"), view(b_req_idx, "b_req_idx"),
+                         view(b_seq_len, "b_seq_len"), page_size);
+    });
+}
+
+lk_status_t lk_sparse_int8kv_decode_attention(
+    lk_tensor_t* o, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    const lk_tensor_t* page_idx, int64_t page_size
+) {
+    return launch(o, [&] {
+        return std::bind(sparse_int8kv_decode_attention, view(o, "o"), view(q, "q"), view(k, "k"), view(k_s, "k_s"),
+                         view(v, "v"), view(v_s, "v_s"), view(req_to_tokens, "req_to_tokens"),
+                         view(b_req_idx, "b_req_idx"), view(b_seq_len, "b_seq_len"),
+                         view(page_idx, "page_idx"), page_size);
+    });
+}
+
+lk_status_t lk_plan_mixed_attention(
+    const int32_t* cu_q_lens, const int32_t* seq_lens, int64_t batch,
+    int64_t num_heads, int64_t num_kv_heads, int32_t* work, int32_t* num_work
+) {
+    return guarded([&] {
+        std::vector<MixedAttentionWork> plan;
+        *num_work = static_cast<int32_t>(plan_mixed_attention(cu_q_lens, seq_lens, batch, num_heads, num_kv_heads, &plan));
+        std::memcpy(work, plan.data(), plan.size() * sizeof(MixedAttentionWork));
+    });
+}
+
+lk_status_t lk_mixed_int8kv_attention(
+    lk_tensor_t* o, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    const lk_tensor_t* cu_q_lens, const lk_tensor_t* work
+) {
+    return launch(o, [&] {
+        return std::bind(mixed_int8kv_attention, view(o, "o"), view(q, "q"), view(k, "k"), view(k_s, "k_s"),
+                         view(v, "v"), view(v_s, "v_s"), view(req_to_tokens, "req_to_tokens"),
+                         view(b_req_idx, "b_req_idx"), view(b_seq_len, "b_seq_len"), view(cu_q_lens, "cu_q_lens"),
+                         view(work, "work"), TensorView(), int64_t(0));
+    });
+}
+
+lk_status_t lk_flashdecoding_stage1(
+    lk_tensor_t* mid_o_emb, lk_tensor_t* mid_o_logexpsum, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    int64_t max_len_in_batch, int64_t seq_block_size, float att_scale
+) {
+    return launch(mid_o_emb, [&] {
+        return std::bind(flashdecoding_stage1, view(mid_o_emb, "mid_o_emb"), view(mid_o_logexpsum, "mid_o_logexpsum"),
+                         view(q, "q"), view(k, "k"), k_s != nullptr ? view(k_s, "k_s") : TensorView(), view(v, "v"),
+                         v_s != nullptr ? view(v_s, "v_s") : TensorView(), view(req_to_tokens, "req_to_tokens"),
+                         view(b_req_idx, "b_req_idx"), view(b_seq_len, "b_seq_len"), max_len_in_batch,
+                         seq_block_size, att_scale, TensorView(), int64_t(0));
+    });
+}
+
+lk_status_t lk_flashdecoding_combine(
+    lk_tensor_t* o, lk_tensor_t* o_scale, const lk_tensor_t* mid_o_emb,
+    const lk_tensor_t* mid_o_logexpsum, const lk_tensor_t* b_seq_len, int64_t seq_block_size
+) {
+    return launch(o, [&] {
+        return std::bind(flashdecoding_combine, view(o, "o"),
+                         o_scale != nullptr ? view(o_scale, "o_scale") : TensorView(), view(mid_o_emb, "mid_o_emb"),
+                         view(mid_o_logexpsum, "mid_o_logexpsum"), view(b_seq_len, "b_seq_len"), seq_block_size);
+    });
+}
+
+lk_status_t lk_kv_copy_slots(
+    const lk_tensor_t* caches, int32_t num_caches, const lk_tensor_t* pairs, int32_t slot_dim
+) {
+    return launch(num_caches > 0 ? caches : nullptr, [&] {
+        return std::bind(kv_copy_slots, views(caches, num_caches), view(pairs, "pairs"), slot_dim);
+    });
+}
+
+lk_status_t lk_kv_transfer_bytes(
+    const lk_tensor_t* caches, int32_t num_caches, int32_t slot_dim, int64_t num_tokens, int64_t* bytes
+) {
+    return guarded([&] {
+        *bytes = kv_transfer_bytes(make_kv_transfer_header(views(caches, num_caches), slot_dim, num_tokens, 0));
+    });
+}
+
+lk_status_t lk_kv_pack(
+    const lk_tensor_t* caches, int32_t num_caches, const lk_tensor_t* slots, int32_t slot_dim,
+    int64_t tag, lk_tensor_t* buffer
+) {
+    return launch(num_caches > 0 ? caches : nullptr, [&] {
+        return std::bind(kv_pack, views(caches, num_caches), view(slots, "slots"), slot_dim, tag,
+                         view(buffer, "buffer"));
+    });
+}
+
+lk_status_t lk_kv_transfer_info(const lk_tensor_t* buffer, int64_t* num_tokens, int64_t* tag) {
+    return guarded([&] {
+        const KvTransferHeader h = read_kv_transfer_header(view(buffer, "buffer"));
+        *num_tokens = h.num_tokens;
+        *tag = h.tag;
+    });
+}
+
+lk_status_t lk_kv_unpack(
+    const lk_tensor_t* caches, int32_t num_caches, const lk_tensor_t* slots, int32_t slot_dim,
+    const lk_tensor_t* buffer
+) {
+    return launch(num_caches > 0 ? caches : nullptr, [&] {
+        return std::bind(kv_unpack, views(caches, num_caches), view(slots, "slots"), slot_dim, view(buffer, "buffer"));
+    });
+}
+
+lk_status_t lk_page_hashes(
+    const lk_tensor_t* tokens, const lk_tensor_t* lens, int64_t page_size, uint64_t seed, lk_tensor_t* out
+) {
+    return launch(out, [&] {
+        return std::bind(page_hashes, view(tokens, "tokens"), view(lens, "lens"), page_size, seed, view(out, "out"));
+    });
+}
+
+lk_status_t lk_hybrid_moe_partition(
+    const lk_tensor_t* topk_ids, const lk_tensor_t* topk_weights, const lk_tensor_t* residency,
+    lk_tensor_t* device_ids, lk_tensor_t* device_weights, lk_tensor_t* cpu_offsets,
+    lk_tensor_t* cpu_tokens, lk_tensor_t* cpu_weights, int64_t* num_cpu_rows
+) {
+    return guarded([&] {
+        if (num_cpu_rows == nullptr) throw std::invalid_argument("num_cpu_rows must not be NULL");
+        *num_cpu_rows = hybrid_moe_partition(
+            view(topk_ids, "topk_ids"), view(topk_weights, "topk_weights"), view(residency, "residency"),
+            view(device_ids, "device_ids"), view(device_weights, "device_weights"),
+            view(cpu_offsets, "cpu_offsets"), view(cpu_tokens, "cpu_tokens"), view(cpu_weights, "cpu_weights"));
+    });
+}
+
+lk_status_t lk_moe_cpu_experts(
+    lk_tensor_t* out, const lk_tensor_t* x, const lk_tensor_t* cpu_offsets,
+    const lk_tensor_t* cpu_tokens, const lk_tensor_t* cpu_weights,
+    const lk_tensor_t* w13, const lk_tensor_t* w13_scales, const lk_tensor_t* w2,
+    const lk_tensor_t* w2_scales, int32_t num_experts
+) {
+    return launch(out, [&] {
+        return std::bind(moe_cpu_experts, view(out, "out"), view(x, "x"), view(cpu_offsets, "cpu_offsets"),
+                         view(cpu_tokens, "cpu_tokens"), view(cpu_weights, "cpu_weights"),
+                         views(w13, num_experts, "w13"), views(w13_scales, num_experts, "w13_scales"),
+                         views(w2, num_experts, "w2"), views(w2_scales, num_experts, "w2_scales"));
+    });
+}
+
+lk_status_t lk_expert_cache_create(
+    const lk_tensor_t* host_weights, const lk_tensor_t* pool, int32_t eviction, int32_t prefetch_per_layer,
+    int32_t fetch_misses, float decay, lk_expert_cache_t** cache
+) {
+    return guarded([&] {
+        if (cache == nullptr) throw std::invalid_argument("cache must not be NULL");
+        if (eviction != 0 && eviction != 1) throw std::invalid_argument("eviction must be 0 (LRU) or 1 (LFU)");
+        ExpertCacheOptions options;
+        options.eviction = static_cast<ExpertEviction>(eviction);
+        options.prefetch_per_layer = prefetch_per_layer;
+        options.fetch_misses = fetch_misses != 0;
+        options.decay = decay;
+        auto* c = new ExpertCache(view(host_weights, "host_weights"), view(pool, "pool"), options);
+        *cache = reinterpret_cast<lk_expert_cache_t*>(c);
+    });
+}
+
+void lk_expert_cache_destroy(lk_expert_cache_t* cache) { delete reinterpret_cast<ExpertCache*>(cache); }
+
+lk_status_t lk_expert_cache_access(
+    lk_expert_cache_t* cache, int32_t layer, const lk_tensor_t* topk_ids, const lk_tensor_t* topk_weights,
+    lk_tensor_t* residency
+) {
+    return guarded([&] {
+        reinterpret_cast<ExpertCache*>(cache)->access(layer, view(topk_ids, "topk_ids"),
+                                                      view(topk_weights, "topk_weights"), view(residency, "residency"));
+    });
+}
+
+lk_status_t lk_expert_cache_prefetch(
+    lk_expert_cache_t* cache, int32_t layer, const int32_t* experts, int32_t n, int32_t* started
+) {
+    return guarded([&] {
+        if (n < 0 || (n > 0 && experts == nullptr)) throw std::invalid_argument("experts must hold n entries");
+        const int32_t count = reinterpret_cast<ExpertCache*>(cache)->prefetch(layer, {experts, experts + n});
+        if (started != nullptr) *started = count;
+    });
+}
+
+lk_status_t lk_expert_cache_synchronize(lk_expert_cache_t* cache) {
+    return guarded([&] { reinterpret_cast<ExpertCache*>(cache)->synchronize(); });
+}
+
+lk_status_t lk_expert_cache_stats(const lk_expert_cache_t* cache, lk_expert_cache_stats_t* stats) {
+    return guarded([&] {
+        if (stats == nullptr) throw std::invalid_argument("stats must not be NULL");
+        const ExpertCacheStats& s = reinterpret_cast<const ExpertCache*>(cache)->stats();
+        *stats = {s.hits, s.misses, s.late_prefetches, s.prefetches, s.useful_prefetches, s.evictions,
+                  s.bytes_copied, s.stall_seconds};
+    });
+}
+
+void lk_expert_cache_reset_stats(lk_expert_cache_t* cache) { reinterpret_cast<ExpertCache*>(cache)->reset_stats(); }
+
+lk_status_t lk_safetensors_open(const char* path, lk_safetensors_t** file) {
+    return guarded([&] {
+        if (path == nullptr || file == nullptr) throw std::invalid_argument("path and file must not be NULL");
+        *file = reinterpret_cast<lk_safetensors_t*>(new SafetensorsFile(path));
+    });
+}
+
+void lk_safetensors_close(lk_safetensors_t* file) { delete reinterpret_cast<SafetensorsFile*>(file); }
+
+int32_t lk_safetensors_num_tensors(const lk_safetensors_t* file) {
+    return static_cast<int32_t>(reinterpret_cast<const SafetensorsFile*>(file)->entries().size());
+}
+
+lk_status_t lk_safetensors_name(const lk_safetensors_t* file, int32_t index, const char** name) {
+    return guarded([&] {
+        const auto& entries = reinterpret_cast<const SafetensorsFile*>(file)->entries();
+        if (index < 0 || index >= static_cast<int32_t>(entries.size())) {
+            throw std::invalid_argument("tensor index " + std::to_string(index) + " is out of range");
+        }
+        *name = entries[index].name.c_str();
+    });
+}
+
+lk_status_t lk_safetensors_tensor(const lk_safetensors_t* file, const char* name, lk_tensor_t* view) {
+    return guarded([&] {
+        if (name == nullptr || view == nullptr) throw std::invalid_argument("name and view must not be NULL");
+        const SafetensorsFile* f = reinterpret_cast<const SafetensorsFile*>(file);
+        const SafetensorsEntry* entry = f->find(name);
+        if (entry == nullptr) throw std::invalid_argument(f->path() + " has no tensor " + name);
+        *view = f->view(*entry).to_c();
+    });
+}
+
+lk_status_t lk_quantize_weight(const lk_tensor_t* w, lk_tensor_t* q, lk_tensor_t* scales) {
+    return launch(q, [&] {
+        return std::bind(quantize_weight_per_channel, view(w, "w"), view(q, "q"), view(scales, "scales"));
+    });
+}
+
+lk_status_t lk_quantize_weights(
+    const lk_tensor_t* w, lk_tensor_t* q, lk_tensor_t* scales, int32_t n, int32_t io_threads,
+    int64_t readahead_bytes, void (*on_done)(int32_t index, void* user_data), void* user_data,
+    lk_weight_load_stats_t* stats
+) {
+    return guarded([&] {
+        const std::vector<TensorView> ws = views(w, n, "w");
+        const std::vector<TensorView> qs = views(q, n, "q");
+        const std::vector<TensorView> ss = views(scales, n, "scales");
+        std::vector<WeightQuantJob> jobs;
+        for (int32_t i = 0; i < n; i++) jobs.push_back({ws[i], qs[i], ss[i]});
+        WeightLoadOptions options;
+        options.io_threads = io_threads;
+        options.readahead_bytes = readahead_bytes;
+        std::function<void(size_t)> done;
+        if (on_done != nullptr) done = [&](size_t i) { on_done(static_cast<int32_t>(i), user_data); };
+        const WeightLoadStats s = quantize_weights(jobs, options, done);
+        if (stats != nullptr) *stats = {s.bytes_read, s.bytes_written, s.seconds, s.read_wait_seconds};
+    });
+}
+
+lk_status_t lk_kv_allocator_create(
+    int32_t num_pages, int32_t page_size, int32_t max_reqs, int32_t max_seq_len,
+    const lk_tensor_t* req_to_tokens, lk_kv_allocator_t** allocator
+) {
+    return guarded([&] {
+        if (allocator == nullptr) throw std::invalid_argument("allocator must not be NULL");
+        auto* a = new KvPageAllocator(num_pages, page_size, max_reqs, max_seq_len, view(req_to_tokens, "req_to_tokens"));
+        *allocator = reinterpret_cast<lk_kv_allocator_t*>(a);
+    });
+}
+
+void lk_kv_allocator_destroy(lk_kv_allocator_t* allocator) {
+    delete reinterpret_cast<KvPageAllocator*>(allocator);
+}
+
+lk_status_t lk_kv_alloc_req(lk_kv_allocator_t* allocator, int32_t* req) {
+    return guarded([&] { *req = reinterpret_cast<KvPageAllocator*>(allocator)->alloc_req(); });
+}
+
+lk_status_t lk_kv_free_req(lk_kv_allocator_t* allocator, int32_t req) {
+    return guarded([&] { reinterpret_cast<KvPageAllocator*>(allocator)->free_req(req); });
+}
+
+lk_status_t lk_kv_fork(lk_kv_allocator_t* allocator, int32_t src, int32_t prefix_len, int32_t* req) {
+    return guarded([&] { *req = reinterpret_cast<KvPageAllocator*>(allocator)->fork(src, prefix_len); });
+}
+
+lk_status_t lk_kv_extend(
+    lk_kv_allocator_t* allocator, const int32_t* reqs, const int32_t* num_new, int32_t n,
+    int32_t* out_slots, lk_kv_page_copy_t* copies, int32_t* num_copies, int32_t* ok
+) {
+    static_assert(sizeof(lk_kv_page_copy_t) == sizeof(KvPageCopy), "same layout");
+    return guarded([&] {
+        // at most one copy-on-write per request, reuse the buffer across calls
+        thread_local std::vector<KvPageCopy> step_copies;
+        step_copies.clear();
+        *ok = reinterpret_cast<KvPageAllocator*>(allocator)->extend(reqs, num_new, n, out_slots, &step_copies);
+        for (size_t i = 0; i < step_copies.size(); i++) {
+            copies[i] = {step_copies[i].src_page, step_copies[i].dst_page, step_copies[i].num_tokens};
+        }
+        *num_copies = static_cast<int32_t>(step_copies.size());
+    });
+}
+
+lk_status_t lk_kv_truncate(lk_kv_allocator_t* allocator, int32_t req, int32_t new_len) {
+    return guarded([&] { reinterpret_cast<KvPageAllocator*>(allocator)->truncate(req, new_len); });
+}
+
+lk_status_t lk_kv_evict_select(
+    lk_tensor_t* attn_mass, int32_t seq_len, int32_t budget, int32_t num_sink, int32_t num_recent,
+    int32_t* keep, int32_t* n_keep
+) {
+    return guarded([&] {
+        KvEvictPolicy policy;
+        policy.num_sink = num_sink;
+        policy.num_recent = num_recent;
+        *n_keep = kv_evict_select(view(attn_mass, "attn_mass"), seq_len, budget, policy, keep);
+    });
+}
+
+lk_status_t lk_kv_evict(
+    lk_kv_allocator_t* allocator, int32_t req, const int32_t* keep, int32_t n_keep,
+    int32_t* pairs, int32_t* num_pairs, int32_t* ok
+) {
+    return guarded([&] {
+        std::vector<int32_t> moves;
+        *ok = reinterpret_cast<KvPageAllocator*>(allocator)->evict(req, keep, n_keep, &moves) ? 1 : 0;
+        std::copy(moves.begin(), moves.end(), pairs);
+        *num_pairs = static_cast<int32_t>(moves.size() / 2);
+    });
+}
+
+lk_status_t lk_kv_compact(lk_kv_allocator_t* allocator, lk_kv_page_copy_t* moves, int32_t* num_moves) {
+    return guarded([&] {
+        std::vector<KvPageCopy> plan;
+        *num_moves = reinterpret_cast<KvPageAllocator*>(allocator)->compact(&plan);
+        for (size_t i = 0; i < plan.size(); i++) moves[i] = {plan[i].src_page, plan[i].dst_page, plan[i].num_tokens};
+    });
+}
+
+lk_status_t lk_kv_seq_len(const lk_kv_allocator_t* allocator, int32_t req, int32_t* seq_len) {
+    return guarded([&] { *seq_len = reinterpret_cast<const KvPageAllocator*>(allocator)->seq_len(req); });
+}
+
+int32_t lk_kv_num_free_pages(const lk_kv_allocator_t* allocator) {
+    return reinterpret_cast<const KvPageAllocator*>(allocator)->num_free_pages();
+}
+
+} // extern "C"
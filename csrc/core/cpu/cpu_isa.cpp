@@ -0,0 +1,134 @@
+#include "core/cpu_isa.h"
+#include "cpu_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+const char* const kIsaNames[kNumCpuIsas] = {"scalar", "avx2", "avx512", "avx512_bf16", "amx"};
+
+#if defined(__x86_64__)
+uint64_t read_xcr0() {
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return static_cast<uint64_t>(hi) << 32 | lo;
+}
+
+// Linux keeps the 8 KB AMX tile data out of the thread state until a process asks for it.
+bool request_amx_permission() {
+#if defined(__linux__)
+    constexpr long kArchReqXcompPerm = 0x1023;
+    constexpr long kXfeatureXtiledata = 18;
+    return syscall(SYS_arch_prctl, kArchReqXcompPerm, kXfeatureXtiledata) == 0;
+#else
+    return false;
+#endif
+}
+
+bool has_vnni() {
+    uint32_t a, b, c, d;
+    return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (c >> 11 & 1);
+}
+
+CpuIsa detect() {
+    uint32_t a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return CpuIsa::Scalar;
+    const bool fma = c >> 12 & 1, osxsave = c >> 27 & 1, avx = c >> 28 & 1, f16c = c >> 29 & 1;
+    if (!(osxsave && avx && fma && f16c)) return CpuIsa::Scalar;
+    const uint64_t xcr0 = read_xcr0();
+    // the OS saves the xmm / ymm registers, then the AVX-512 mask and zmm state, then the AMX tiles
+    if ((xcr0 & 0x6) != 0x6) return CpuIsa::Scalar;
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d) || !(b >> 5 & 1)) return CpuIsa::Scalar;
+    const bool avx512 = (b >> 16 & 1) && (b >> 17 & 1) && (b >> 30 & 1) && (b >> 31 & 1);
+    if (!avx512 || (xcr0 & 0xe0) != 0xe0) return CpuIsa::Avx2;
+    const bool vnni = c >> 11 & 1;
+    const bool amx = (d >> 22 & 1) && (d >> 24 & 1) && (d >> 25 & 1);
+    uint32_t a1 = 0, b1, c1, d1;
+    __get_cpuid_count(7, 1, &a1, &b1, &c1, &d1);
+    const bool bf16 = a1 >> 5 & 1;
+    if (!vnni || !bf16) return CpuIsa::Avx512;
+    if (!amx || (xcr0 & 0x60000) != 0x60000 || !request_amx_permission()) return CpuIsa::Avx512Bf16;
+    return CpuIsa::Amx;
+}
+#else
+CpuIsa detect() { return CpuIsa::Scalar; }
+#endif
+
+struct Dispatch {
+    CpuIsa detected;
+    CpuKernels tables[kNumCpuIsas];
+    std::atomic<int32_t> active;
+
+    Dispatch() : detected(detect()) {
+        fill_cpu_kernels_scalar(tables[0]);
+#if defined(__x86_64__)
+        const int32_t top = static_cast<int32_t>(detected);
+        if (top >= 1) fill_cpu_kernels_avx2(tables[1]);
+        if (top >= 2) fill_cpu_kernels_avx512(tables[2], has_vnni());
+        if (top >= 3) fill_cpu_kernels_avx512_bf16(tables[3]);
+        if (top >= 4) fill_cpu_kernels_amx(tables[4]);
+#endif
+        int32_t level = static_cast<int32_t>(detected);
+        if (const char* env = std::getenv("LIGHTLLM_CPU_ISA")) {
+            // an unknown name is ignored, like a bad LIGHTLLM_NUM_THREADS
+            for (int32_t i = 0; i < kNumCpuIsas; i++) {
+                if (std::strcmp(env, kIsaNames[i]) == 0) level = std::min(level, i);
+            }
+        }
+        active.store(level);
+    }
+};
+
+Dispatch& dispatch() {
+    static Dispatch d;
+    return d;
+}
+
+} // namespace
+
+const char* cpu_isa_name(const CpuIsa isa) {
+    const int32_t i = static_cast<int32_t>(isa);
+    return i >= 0 && i < kNumCpuIsas ? kIsaNames[i] : "unknown";
+}
+
+CpuIsa parse_cpu_isa(const char* name) {
+    LK_CHECK(name != nullptr, "cpu isa name must not be NULL");
+    for (int32_t i = 0; i < kNumCpuIsas; i++) {
+        if (std::strcmp(name, kIsaNames[i]) == 0) return static_cast<CpuIsa>(i);
+    }
+    LK_CHECK(false, "unknown cpu isa '", name, "', expected scalar, avx2, avx512, avx512_bf16 or amx");
+    return CpuIsa::Scalar;
+}
+
+CpuIsa detected_cpu_isa() { return dispatch().detected; }
+
+CpuIsa active_cpu_isa() { return static_cast<CpuIsa>(dispatch().active.load(std::memory_order_relaxed)); }
+
+void set_cpu_isa(const CpuIsa isa) {
+    Dispatch& d = dispatch();
+    LK_CHECK(static_cast<int32_t>(isa) >= 0 && isa <= d.detected,
+             "set_cpu_isa: ", cpu_isa_name(isa), " is above the level of this CPU, ", cpu_isa_name(d.detected));
+    d.active.store(static_cast<int32_t>(isa));
+}
+
+const CpuKernels& cpu_kernels() {
+    Dispatch& d = dispatch();
+    return d.tables[d.active.load(std::memory_order_relaxed)];
+}
+
+} // namespace core
+} // namespace lightllm
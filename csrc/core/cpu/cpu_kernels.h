@@ -0,0 +1,19 @@
+#pragma once
+#include "core/cpu_isa.h"
+
+// Entry points of the per level translation units, only cpu_isa.cpp calls them.
+namespace lightllm {
+namespace core {
+
+void fill_cpu_kernels_scalar(CpuKernels& k);
+
+#if defined(__x86_64__)
+void fill_cpu_kernels_avx2(CpuKernels& k);
+// vnni: the CPU has AVX512_VNNI, which Skylake-SP lacks
+void fill_cpu_kernels_avx512(CpuKernels& k, bool vnni);
+void fill_cpu_kernels_avx512_bf16(CpuKernels& k);
+void fill_cpu_kernels_amx(CpuKernels& k);
+#endif
+
+} // namespace core
+} // namespace lightllm
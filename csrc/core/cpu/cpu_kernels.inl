@@ -0,0 +1,620 @@
+// Host kernels of one instruction set level, see core/cpu_isa.h.
+//
+// Included by kernels_<level>.cpp after its headers and its target pragma,
+// with LK_CPU_LEVEL set to the CpuIsa value, so every function below is
+// compiled for that level only. It has no includes of its own: code of
+// headers included here would be built for the level too, and the linker
+// could pick that copy for the callers of other levels.
+//
+//   Vec   one register of fp32 lanes with the conversions of host_float.h,
+//         kWidth lanes: 1 (Scalar), 8 (Avx2) or 16 (Avx512 and up)
+
+#ifndef LK_CPU_LEVEL
+#error "define LK_CPU_LEVEL before including cpu_kernels.inl"
+#endif
+
+namespace lightllm {
+namespace core {
+namespace {
+
+constexpr int64_t kGroup8 = 8;
+
+// Round to nearest even and saturate, like the vector stores of int8_t below.
+inline int8_t to_int8(const fp32_t x) {
+    return static_cast<int8_t>(std::max(-128.0f, std::min(127.0f, std::nearbyint(x))));
+}
+
+#if LK_CPU_LEVEL >= 2
+
+struct Vec {
+    static constexpr int64_t kWidth = 16;
+    __m512 v;
+
+    static Vec zero() { return {_mm512_setzero_ps()}; }
+    static Vec set1(const fp32_t x) { return {_mm512_set1_ps(x)}; }
+    static Vec load(const fp32_t* p) { return {_mm512_loadu_ps(p)}; }
+    static Vec load(const host_bf16_t* p) {
+        const __m512i u = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        return {_mm512_castsi512_ps(_mm512_slli_epi32(u, 16))};
+    }
+    static Vec load(const host_fp16_t* p) {
+        return {_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)))};
+    }
+
+    void store(fp32_t* p) const { _mm512_storeu_ps(p, v); }
+    void store(host_bf16_t* p) const {
+#if LK_CPU_LEVEL >= 3
+        // vcvtneps2bf16 rounds to nearest even, and flushes denormals to zero
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), (__m256i)_mm512_cvtneps_pbh(v));
+#else
+        const __m512i u = _mm512_castps_si512(v);
+        const __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(1));
+        __m512i r = _mm512_srli_epi32(_mm512_add_epi32(u, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7fff))), 16);
+        const __mmask16 nan = _mm512_cmpgt_epi32_mask(_mm512_and_si512(u, _mm512_set1_epi32(0x7fffffff)),
+                                                      _mm512_set1_epi32(0x7f800000));
+        r = _mm512_mask_or_epi32(r, nan, _mm512_srli_epi32(u, 16), _mm512_set1_epi32(0x40));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtepi32_epi16(r));
+#endif
+    }
+    void store(host_fp16_t* p) const {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+    // from_float<host_fp8_e4m3_t> on every lane
+    void store(host_fp8_e4m3_t* p) const {
+        const __m512i u = _mm512_castps_si512(v);
+        const __m512i sign = _mm512_and_si512(_mm512_srli_epi32(u, 24), _mm512_set1_epi32(0x80));
+        const __m512i a = _mm512_and_si512(u, _mm512_set1_epi32(0x7fffffff));
+        const __m512i sub = _mm512_sub_epi32(
+            _mm512_castps_si512(_mm512_add_ps(_mm512_castsi512_ps(a), _mm512_set1_ps(16384.0f))),
+            _mm512_set1_epi32(0x46800000));
+        const __m512i odd = _mm512_and_si512(_mm512_srli_epi32(a, 20), _mm512_set1_epi32(1));
+        __m512i r = _mm512_srli_epi32(_mm512_add_epi32(a, _mm512_add_epi32(odd, _mm512_set1_epi32(0x7ffff))), 20);
+        r = _mm512_min_epi32(_mm512_sub_epi32(r, _mm512_set1_epi32(120 << 3)), _mm512_set1_epi32(0x7e));
+        r = _mm512_mask_mov_epi32(r, _mm512_cmplt_epi32_mask(a, _mm512_set1_epi32(0x3c800000)), sub);
+        r = _mm512_mask_mov_epi32(r, _mm512_cmpge_epi32_mask(a, _mm512_set1_epi32(0x43e00000)), _mm512_set1_epi32(0x7e));
+        r = _mm512_mask_mov_epi32(r, _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7f800000)), _mm512_set1_epi32(0x7f));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_cvtepi32_epi8(_mm512_or_si512(r, sign)));
+    }
+    // rounds to nearest even, saturating to [-128, 127]
+    void store(int8_t* p) const {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_cvtsepi32_epi8(_mm512_cvtps_epi32(v)));
+    }
+
+    fp32_t hsum() const { return _mm512_reduce_add_ps(v); }
+    fp32_t hmax() const { return _mm512_reduce_max_ps(v); }
+    Vec abs() const { return {_mm512_abs_ps(v)}; }
+};
+
+inline Vec operator+(const Vec a, const Vec b) { return {_mm512_add_ps(a.v, b.v)}; }
+inline Vec operator*(const Vec a, const Vec b) { return {_mm512_mul_ps(a.v, b.v)}; }
+inline Vec max(const Vec a, const Vec b) { return {_mm512_max_ps(a.v, b.v)}; }
+// a * b + c
+inline Vec fmadd(const Vec a, const Vec b, const Vec c) { return {_mm512_fmadd_ps(a.v, b.v, c.v)}; }
+
+#elif LK_CPU_LEVEL == 1
+
+struct Vec {
+    static constexpr int64_t kWidth = 8;
+    __m256 v;
+
+    static Vec zero() { return {_mm256_setzero_ps()}; }
+    static Vec set1(const fp32_t x) { return {_mm256_set1_ps(x)}; }
+    static Vec load(const fp32_t* p) { return {_mm256_loadu_ps(p)}; }
+    static Vec load(const host_bf16_t* p) {
+        const __m256i u = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        return {_mm256_castsi256_ps(_mm256_slli_epi32(u, 16))};
+    }
+    static Vec load(const host_fp16_t* p) {
+        return {_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))};
+    }
+
+    void store(fp32_t* p) const { _mm256_storeu_ps(p, v); }
+    void store(host_bf16_t* p) const {
+        const __m256i u = _mm256_castps_si256(v);
+        const __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(1));
+        __m256i r = _mm256_srli_epi32(_mm256_add_epi32(u, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff))), 16);
+        const __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(u, _mm256_set1_epi32(0x7fffffff)),
+                                               _mm256_set1_epi32(0x7f800000));
+        r = _mm256_blendv_epi8(r, _mm256_or_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(0x40)), nan);
+        // packus works within 128-bit lanes, gather the two halves afterwards
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(r, r), 0x8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(packed));
+    }
+    void store(host_fp16_t* p) const {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+    // from_float<host_fp8_e4m3_t> on every lane
+    void store(host_fp8_e4m3_t* p) const {
+        const __m256i u = _mm256_castps_si256(v);
+        const __m256i sign = _mm256_and_si256(_mm256_srli_epi32(u, 24), _mm256_set1_epi32(0x80));
+        const __m256i a = _mm256_and_si256(u, _mm256_set1_epi32(0x7fffffff));
+        const __m256i sub = _mm256_sub_epi32(
+            _mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(a), _mm256_set1_ps(16384.0f))),
+            _mm256_set1_epi32(0x46800000));
+        const __m256i odd = _mm256_and_si256(_mm256_srli_epi32(a, 20), _mm256_set1_epi32(1));
+        __m256i r = _mm256_srli_epi32(_mm256_add_epi32(a, _mm256_add_epi32(odd, _mm256_set1_epi32(0x7ffff))), 20);
+        r = _mm256_min_epi32(_mm256_sub_epi32(r, _mm256_set1_epi32(120 << 3)), _mm256_set1_epi32(0x7e));
+        r = _mm256_blendv_epi8(r, sub, _mm256_cmpgt_epi32(_mm256_set1_epi32(0x3c800000), a));
+        r = _mm256_blendv_epi8(r, _mm256_set1_epi32(0x7e), _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x43dfffff)));
+        r = _mm256_blendv_epi8(r, _mm256_set1_epi32(0x7f), _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7f800000)));
+        r = _mm256_or_si256(r, sign);
+        // bytes 0..3 of each 128-bit lane hold the lanes 0..3 / 4..7
+        const __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(r, r), _mm256_setzero_si256());
+        const __m128i out = _mm_unpacklo_epi32(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), out);
+    }
+    // rounds to nearest even, saturating to [-128, 127]
+    void store(int8_t* p) const {
+        const __m256i r = _mm256_cvtps_epi32(v);
+        const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi16(words, words));
+    }
+
+    fp32_t hsum() const {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+    fp32_t hmax() const {
+        __m128 s = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_max_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_max_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+    Vec abs() const { return {_mm256_and_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)))}; }
+};
+
+inline Vec operator+(const Vec a, const Vec b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Vec operator*(const Vec a, const Vec b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Vec max(const Vec a, const Vec b) { return {_mm256_max_ps(a.v, b.v)}; }
+// a * b + c
+inline Vec fmadd(const Vec a, const Vec b, const Vec c) { return {_mm256_fmadd_ps(a.v, b.v, c.v)}; }
+
+#else
+
+struct Vec {
+    static constexpr int64_t kWidth = 1;
+    fp32_t v;
+
+    static Vec zero() { return {0.0f}; }
+    static Vec set1(const fp32_t x) { return {x}; }
+    template<typename T>
+    static Vec load(const T* p) { return {to_float(*p)}; }
+    template<typename T>
+    void store(T* p) const { *p = from_float<T>(v); }
+    void store(int8_t* p) const { *p = to_int8(v); }
+
+    fp32_t hsum() const { return v; }
+    fp32_t hmax() const { return v; }
+    Vec abs() const { return {std::fabs(v)}; }
+};
+
+inline Vec operator+(const Vec a, const Vec b) { return {a.v + b.v}; }
+inline Vec operator*(const Vec a, const Vec b) { return {a.v * b.v}; }
+inline Vec max(const Vec a, const Vec b) { return {std::max(a.v, b.v)}; }
+inline Vec fmadd(const Vec a, const Vec b, const Vec c) { return {a.v * b.v + c.v}; }
+
+#endif
+
+constexpr int64_t W = Vec::kWidth;
+
+// ---------------- conversions and reductions, a scalar tail after the full vectors ----------------
+
+template<typename S, typename D>
+void convert(const S* x, D* y, const int64_t n) {
+    int64_t i = 0;
+    for (; i + W <= n; i += W) Vec::load(x + i).store(y + i);
+    for (; i < n; i++) y[i] = from_float<D>(to_float(x[i]));
+}
+
+void float_to_fp8(const fp32_t* x, const fp32_t scale, host_fp8_e4m3_t* y, const int64_t n) {
+    const Vec s = Vec::set1(scale);
+    int64_t i = 0;
+    for (; i + W <= n; i += W) (Vec::load(x + i) * s).store(y + i);
+    for (; i < n; i++) y[i] = from_float<host_fp8_e4m3_t>(x[i] * scale);
+}
+
+void float_to_int8(const fp32_t* x, const fp32_t scale, int8_t* y, const int64_t n) {
+    const Vec s = Vec::set1(scale);
+    int64_t i = 0;
+    for (; i + W <= n; i += W) (Vec::load(x + i) * s).store(y + i);
+    for (; i < n; i++) y[i] = to_int8(x[i] * scale);
+}
+
+fp32_t dot(const fp32_t* a, const fp32_t* b, const int64_t n) {
+    // two accumulators hide the FMA latency
+    Vec acc0 = Vec::zero(), acc1 = Vec::zero();
+    int64_t i = 0;
+    for (; i + 2 * W <= n; i += 2 * W) {
+        acc0 = fmadd(Vec::load(a + i), Vec::load(b + i), acc0);
+        acc1 = fmadd(Vec::load(a + i + W), Vec::load(b + i + W), acc1);
+    }
+    for (; i + W <= n; i += W) acc0 = fmadd(Vec::load(a + i), Vec::load(b + i), acc0);
+    fp32_t sum = (acc0 + acc1).hsum();
+    for (; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+fp32_t sum_squares(const fp32_t* x, const int64_t n) { return dot(x, x, n); }
+
+fp32_t absmax(const fp32_t* x, const int64_t n) {
+    Vec m = Vec::zero();
+    int64_t i = 0;
+    for (; i + W <= n; i += W) m = max(m, Vec::load(x + i).abs());
+    fp32_t r = m.hmax();
+    for (; i < n; i++) r = std::max(r, std::fabs(x[i]));
+    return r;
+}
+
+void axpy(const fp32_t a, const fp32_t* x, fp32_t* y, const int64_t n) {
+    const Vec va = Vec::set1(a);
+    int64_t i = 0;
+    for (; i + W <= n; i += W) fmadd(va, Vec::load(x + i), Vec::load(y + i)).store(y + i);
+    for (; i < n; i++) y[i] += a * x[i];
+}
+
+void scale_mul(const fp32_t* x, const fp32_t s, const fp32_t* w, fp32_t* y, const int64_t n) {
+    const Vec vs = Vec::set1(s);
+    int64_t i = 0;
+    for (; i + W <= n; i += W) (Vec::load(x + i) * vs * Vec::load(w + i)).store(y + i);
+    for (; i < n; i++) y[i] = x[i] * s * w[i];
+}
+
+// ---------------- int8 attention dot ----------------
+
+#if LK_CPU_LEVEL <= 2
+// Also the tail of the AVX2 / AVX512 versions; the VNNI levels mask their tail instead.
+fp32_t int8_group8_dot_scalar(const int8_t* q8, const int32_t*, const int8_t* k8, const fp32_t* ks, const int64_t D) {
+    fp32_t acc = 0.0f;
+    for (int64_t g = 0; g < D / kGroup8; g++) {
+        int32_t dot = 0;
+        for (int64_t i = 0; i < kGroup8; i++) dot += q8[g * kGroup8 + i] * k8[g * kGroup8 + i];
+        acc += static_cast<fp32_t>(dot) * ks[g];
+    }
+    return acc;
+}
+#endif
+
+#if LK_CPU_LEVEL == 1
+// 16 bytes, two groups, per step: madd leaves 8 int32 lanes of 2 products, 4 lanes per group.
+fp32_t int8_group8_dot(const int8_t* q8, const int32_t* corr, const int8_t* k8, const fp32_t* ks, const int64_t D) {
+    __m256 acc = _mm256_setzero_ps();
+    int64_t c = 0;
+    for (; c + 16 <= D; c += 16) {
+        const __m256i q = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(q8 + c)));
+        const __m256i k = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(k8 + c)));
+        const __m256 s = _mm256_set_m128(_mm_set1_ps(ks[c / kGroup8 + 1]), _mm_set1_ps(ks[c / kGroup8]));
+        acc = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(q, k)), s, acc);
+    }
+    return Vec{acc}.hsum() + int8_group8_dot_scalar(q8 + c, corr, k8 + c, ks + c / kGroup8, D - c);
+}
+#endif
+
+#if LK_CPU_LEVEL >= 2
+#if LK_CPU_LEVEL == 2
+// 32 bytes, four groups, per step: 16 int32 lanes of 2 products, 4 lanes per group.
+// Levels with VNNI use int8_group8_dot_vnni instead.
+fp32_t int8_group8_dot(const int8_t* q8, const int32_t* corr, const int8_t* k8, const fp32_t* ks, const int64_t D) {
+    const __m512i quads = _mm512_set_epi32(3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0);
+    __m512 acc = _mm512_setzero_ps();
+    int64_t c = 0;
+    for (; c + 32 <= D; c += 32) {
+        const __m512i q = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(q8 + c)));
+        const __m512i k = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(k8 + c)));
+        const __m512 s = _mm512_permutexvar_ps(quads, _mm512_castps128_ps512(_mm_loadu_ps(ks + c / kGroup8)));
+        acc = _mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_madd_epi16(q, k)), s, acc);
+    }
+    return _mm512_reduce_add_ps(acc) + int8_group8_dot_scalar(q8 + c, corr, k8 + c, ks + c / kGroup8, D - c);
+}
+#endif
+
+#if LK_CPU_LEVEL == 2
+#define LK_VNNI_TARGET __attribute__((target("avx512f,avx512bw,avx512vnni")))
+#else
+#define LK_VNNI_TARGET
+#endif
+
+/**
+ * @brief int8_group8_dot with AVX512-VNNI: one vpdpbusd per 64 bytes leaves
+ * 16 int32 lanes of 4 products, two lanes make a quant group, so the group
+ * scales are broadcast pairwise onto the lanes and applied with one FMA.
+ * dpbusd multiplies unsigned by signed bytes, so K is fed as k + 128 and
+ * corr is subtracted again.
+ */
+LK_VNNI_TARGET
+fp32_t int8_group8_dot_vnni(const int8_t* q8, const int32_t* corr, const int8_t* k8, const fp32_t* ks, const int64_t D) {
+    constexpr int64_t kChunk = 64;
+    const __m512i sign = _mm512_set1_epi8(static_cast<char>(0x80));
+    const __m512i pairs = _mm512_set_epi32(7, 7, 6, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0, 0);
+    __m512 acc = _mm512_setzero_ps();
+    for (int64_t c = 0; c < D; c += kChunk) {
+        const int64_t n = std::min(kChunk, D - c);
+        const __mmask64 mask = n == kChunk ? ~__mmask64(0) : (__mmask64(1) << n) - 1;
+        // masked out bytes load as 0 and become 128, the padded q bytes are 0
+        const __m512i k = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, k8 + c), sign);
+        const __m512i qv = _mm512_loadu_si512(q8 + c);
+        __m512i lanes = _mm512_dpbusd_epi32(_mm512_setzero_si512(), k, qv);
+        lanes = _mm512_sub_epi32(lanes, _mm512_loadu_si512(corr + c / 4));
+        const __m512 scales = _mm512_maskz_loadu_ps(static_cast<__mmask16>((1u << (n / kGroup8)) - 1), ks + c / kGroup8);
+        acc = _mm512_fmadd_ps(_mm512_cvtepi32_ps(lanes), _mm512_permutexvar_ps(pairs, scales), acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+#undef LK_VNNI_TARGET
+#endif
+
+// ---------------- GEMM: c[m, n] = <a row m, b row n> ----------------
+
+void gemm_s8_scalar(const int8_t* a, const int64_t lda, const int8_t* b, const int64_t ldb,
+                    int32_t* c, const int64_t ldc, const int64_t M, const int64_t N, const int64_t K) {
+    for (int64_t m = 0; m < M; m++) {
+        for (int64_t n = 0; n < N; n++) {
+            int32_t acc = 0;
+            for (int64_t k = 0; k < K; k++) acc += a[m * lda + k] * b[n * ldb + k];
+            c[m * ldc + n] = acc;
+        }
+    }
+}
+
+void gemm_bf16_scalar(const host_bf16_t* a, const int64_t lda, const host_bf16_t* b, const int64_t ldb,
+                      fp32_t* c, const int64_t ldc, const int64_t M, const int64_t N, const int64_t K) {
+    for (int64_t m = 0; m < M; m++) {
+        for (int64_t n = 0; n < N; n++) {
+            fp32_t acc = 0.0f;
+            for (int64_t k = 0; k < K; k++) acc += to_float(a[m * lda + k]) * to_float(b[n * ldb + k]);
+            c[m * ldc + n] = acc;
+        }
+    }
+}
+
+#if LK_CPU_LEVEL >= 1
+// Rows of a times 4 rows of b at once, so every a vector is loaded once for 4 outputs.
+constexpr int64_t kGemmCols = 4;
+
+#if LK_CPU_LEVEL >= 2
+using IVec = __m512i;
+constexpr int64_t kS8Step = 32;
+inline IVec load_s8_as_s16(const int8_t* p) { return _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+inline IVec izero() { return _mm512_setzero_si512(); }
+#if LK_CPU_LEVEL >= 3
+inline IVec madd_s16(const IVec acc, const IVec x, const IVec y) { return _mm512_dpwssd_epi32(acc, x, y); }
+#else
+inline IVec madd_s16(const IVec acc, const IVec x, const IVec y) { return _mm512_add_epi32(acc, _mm512_madd_epi16(x, y)); }
+#endif
+inline int32_t ihsum(const IVec x) { return _mm512_reduce_add_epi32(x); }
+#else
+using IVec = __m256i;
+constexpr int64_t kS8Step = 16;
+inline IVec load_s8_as_s16(const int8_t* p) { return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+inline IVec izero() { return _mm256_setzero_si256(); }
+inline IVec madd_s16(const IVec acc, const IVec x, const IVec y) { return _mm256_add_epi32(acc, _mm256_madd_epi16(x, y)); }
+inline int32_t ihsum(const IVec x) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    return _mm_cvtsi128_si32(_mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1)));
+}
+#endif
+
+void gemm_s8(const int8_t* a, const int64_t lda, const int8_t* b, const int64_t ldb,
+             int32_t* c, const int64_t ldc, const int64_t M, const int64_t N, const int64_t K) {
+    const int64_t K_vec = K / kS8Step * kS8Step;
+    for (int64_t m = 0; m < M; m++) {
+        const int8_t* am = a + m * lda;
+        int64_t n = 0;
+        for (; n + kGemmCols <= N; n += kGemmCols) {
+            IVec acc[kGemmCols];
+            for (int64_t j = 0; j < kGemmCols; j++) acc[j] = izero();
+            for (int64_t k = 0; k < K_vec; k += kS8Step) {
+                const IVec x = load_s8_as_s16(am + k);
+                for (int64_t j = 0; j < kGemmCols; j++) acc[j] = madd_s16(acc[j], x, load_s8_as_s16(b + (n + j) * ldb + k));
+            }
+            for (int64_t j = 0; j < kGemmCols; j++) {
+                int32_t sum = ihsum(acc[j]);
+                for (int64_t k = K_vec; k < K; k++) sum += am[k] * b[(n + j) * ldb + k];
+                c[m * ldc + n + j] = sum;
+            }
+        }
+        if (n < N) gemm_s8_scalar(am, lda, b + n * ldb, ldb, c + m * ldc + n, ldc, 1, N - n, K);
+    }
+}
+
+void gemm_bf16(const host_bf16_t* a, const int64_t lda, const host_bf16_t* b, const int64_t ldb,
+               fp32_t* c, const int64_t ldc, const int64_t M, const int64_t N, const int64_t K) {
+#if LK_CPU_LEVEL >= 3
+    // vdpbf16ps: 32 bf16 pairs per step into 16 fp32 lanes
+    constexpr int64_t kStep = 32;
+#else
+    constexpr int64_t kStep = W;
+#endif
+    const int64_t K_vec = K / kStep * kStep;
+    for (int64_t m = 0; m < M; m++) {
+        const host_bf16_t* am = a + m * lda;
+        int64_t n = 0;
+        for (; n + kGemmCols <= N; n += kGemmCols) {
+            Vec acc[kGemmCols];
+            for (int64_t j = 0; j < kGemmCols; j++) acc[j] = Vec::zero();
+            for (int64_t k = 0; k < K_vec; k += kStep) {
+#if LK_CPU_LEVEL >= 3
+                const __m512bh x = (__m512bh)_mm512_loadu_si512(am + k);
+                for (int64_t j = 0; j < kGemmCols; j++) {
+                    acc[j].v = _mm512_dpbf16_ps(acc[j].v, x, (__m512bh)_mm512_loadu_si512(b + (n + j) * ldb + k));
+                }
+#else
+                const Vec x = Vec::load(am + k);
+                for (int64_t j = 0; j < kGemmCols; j++) acc[j] = fmadd(x, Vec::load(b + (n + j) * ldb + k), acc[j]);
+#endif
+            }
+            for (int64_t j = 0; j < kGemmCols; j++) {
+                fp32_t sum = acc[j].hsum();
+                for (int64_t k = K_vec; k < K; k++) sum += to_float(am[k]) * to_float(b[(n + j) * ldb + k]);
+                c[m * ldc + n + j] = sum;
+            }
+        }
+        if (n < N) gemm_bf16_scalar(am, lda, b + n * ldb, ldb, c + m * ldc + n, ldc, 1, N - n, K);
+    }
+}
+#endif
+
+#if LK_CPU_LEVEL >= 4
+/**
+ * @brief AMX tiles: tmm0..3 accumulate a 16 x 64 block of c from tmm4, 16
+ * rows of a times 64 bytes of k, and tmm5 / tmm6, the matching 16 columns of
+ * b each in the VNNI layout (row r holds the 4 / 2 consecutive k of r for
+ * every column). One a tile feeds four accumulators, which also keeps four
+ * independent tile dots in flight. b is packed once per 64 columns for all
+ * of K, a tile is loaded in place unless it runs past M or K, then it is
+ * copied into a zero padded tile.
+ */
+struct alignas(64) TileConfig {
+    uint8_t palette_id;
+    uint8_t start_row;
+    uint8_t reserved[14];
+    uint16_t colsb[16];
+    uint8_t rows[16];
+};
+
+constexpr int64_t kTileRows = 16;
+constexpr int64_t kTileBytes = 64;
+constexpr int64_t kAccTiles = 4;
+
+void configure_tiles() {
+    TileConfig cfg;
+    std::memset(&cfg, 0, sizeof(cfg));
+    cfg.palette_id = 1;
+    for (int32_t t = 0; t < kAccTiles + 3; t++) {
+        cfg.rows[t] = kTileRows;
+        cfg.colsb[t] = kTileBytes;
+    }
+    _tile_loadconfig(&cfg);
+}
+
+// the tile loads are asm statements that do not tell the compiler they read memory
+inline void memory_barrier() { __asm__ volatile("" ::: "memory"); }
+
+// E is int8_t (4 k per 32-bit cell, int32 c) or host_bf16_t (2 k per cell, fp32 c).
+template<typename E, typename C>
+void gemm_amx(const E* a, const int64_t lda, const E* b, const int64_t ldb,
+              C* c, const int64_t ldc, const int64_t M, const int64_t N, const int64_t K) {
+    constexpr int64_t kPack = 4 / sizeof(E);             // k per 32-bit cell
+    constexpr int64_t kTileK = kTileBytes / sizeof(E);   // k per tile step
+    constexpr int64_t kCols = kAccTiles * kTileRows;
+    const int64_t K_pad = (K + kTileK - 1) / kTileK * kTileK;
+    const int64_t tile_elems = K_pad * kTileRows;        // one packed 16 column tile for all of K
+    std::vector<E> panel(kAccTiles * tile_elems);
+    alignas(64) E a_tile[kTileRows * kTileK];
+    alignas(64) C c_tile[kTileRows * kTileRows];
+
+    configure_tiles();
+    for (int64_t n0 = 0; n0 < N; n0 += kCols) {
+        const int64_t nn = std::min(kCols, N - n0);
+        if (nn < kCols || K < K_pad) std::fill(panel.begin(), panel.end(), E{});
+        for (int64_t j = 0; j < nn; j++) {
+            const E* src = b + (n0 + j) * ldb;
+            E* dst = panel.data() + j / kTileRows * tile_elems + j % kTileRows * kPack;
+            for (int64_t k = 0; k + kPack <= K; k += kPack) std::memcpy(dst + k * kTileRows, src + k, 4);
+            for (int64_t k = K / kPack * kPack; k < K; k++) dst[k / kPack * kTileRows * kPack + k % kPack] = src[k];
+        }
+        for (int64_t m0 = 0; m0 < M; m0 += kTileRows) {
+            const int64_t mm = std::min(kTileRows, M - m0);
+            _tile_zero(0);
+            _tile_zero(1);
+            _tile_zero(2);
+            _tile_zero(3);
+            for (int64_t k0 = 0; k0 < K_pad; k0 += kTileK) {
+                if (mm == kTileRows && k0 + kTileK <= K) {
+                    _tile_loadd(4, a + m0 * lda + k0, lda * sizeof(E));
+                } else {
+                    const int64_t kk = std::min(kTileK, K - k0);
+                    std::memset(a_tile, 0, sizeof(a_tile));
+                    for (int64_t i = 0; i < mm; i++) std::memcpy(a_tile + i * kTileK, a + (m0 + i) * lda + k0, kk * sizeof(E));
+                    memory_barrier();
+                    _tile_loadd(4, a_tile, kTileBytes);
+                }
+                memory_barrier();
+                const E* bt = panel.data() + k0 * kTileRows;
+                _tile_loadd(5, bt, kTileBytes);
+                _tile_loadd(6, bt + tile_elems, kTileBytes);
+                if constexpr (std::is_same<E, int8_t>::value) {
+                    _tile_dpbssd(0, 4, 5);
+                    _tile_dpbssd(1, 4, 6);
+                } else {
+                    _tile_dpbf16ps(0, 4, 5);
+                    _tile_dpbf16ps(1, 4, 6);
+                }
+                _tile_loadd(5, bt + 2 * tile_elems, kTileBytes);
+                _tile_loadd(6, bt + 3 * tile_elems, kTileBytes);
+                if constexpr (std::is_same<E, int8_t>::value) {
+                    _tile_dpbssd(2, 4, 5);
+                    _tile_dpbssd(3, 4, 6);
+                } else {
+                    _tile_dpbf16ps(2, 4, 5);
+                    _tile_dpbf16ps(3, 4, 6);
+                }
+            }
+            // tile ids are immediates, so the four stores are spelled out
+            for (int64_t t = 0; t * kTileRows < nn; t++) {
+                switch (t) {
+                    case 0: _tile_stored(0, c_tile, kTileRows * sizeof(C)); break;
+                    case 1: _tile_stored(1, c_tile, kTileRows * sizeof(C)); break;
+                    case 2: _tile_stored(2, c_tile, kTileRows * sizeof(C)); break;
+                    default: _tile_stored(3, c_tile, kTileRows * sizeof(C)); break;
+                }
+                memory_barrier();
+                const int64_t cols = std::min(kTileRows, nn - t * kTileRows);
+                for (int64_t i = 0; i < mm; i++) {
+                    std::memcpy(c + (m0 + i) * ldc + n0 + t * kTileRows, c_tile + i * kTileRows, cols * sizeof(C));
+                }
+            }
+        }
+    }
+    _tile_release();
+}
+
+void gemm_s8_amx(const int8_t* a, const int64_t lda, const int8_t* b, const int64_t ldb,
+                 int32_t* c, const int64_t ldc, const int64_t M, const int64_t N, const int64_t K) {
+    // packing b costs as much as the tile dots of ~16 rows, fewer rows run faster on the vector kernel
+    if (M < kTileRows) return gemm_s8(a, lda, b, ldb, c, ldc, M, N, K);
+    gemm_amx<int8_t, int32_t>(a, lda, b, ldb, c, ldc, M, N, K);
+}
+
+void gemm_bf16_amx(const host_bf16_t* a, const int64_t lda, const host_bf16_t* b, const int64_t ldb,
+                   fp32_t* c, const int64_t ldc, const int64_t M, const int64_t N, const int64_t K) {
+    if (M < kTileRows) return gemm_bf16(a, lda, b, ldb, c, ldc, M, N, K);
+    gemm_amx<host_bf16_t, fp32_t>(a, lda, b, ldb, c, ldc, M, N, K);
+}
+#endif
+
+void fill(CpuKernels& k) {
+    k.isa = static_cast<CpuIsa>(LK_CPU_LEVEL);
+    k.bf16_to_float = convert<host_bf16_t, fp32_t>;
+    k.fp16_to_float = convert<host_fp16_t, fp32_t>;
+    k.float_to_bf16 = convert<fp32_t, host_bf16_t>;
+    k.float_to_fp16 = convert<fp32_t, host_fp16_t>;
+    k.float_to_fp8 = float_to_fp8;
+    k.float_to_int8 = float_to_int8;
+    k.dot = dot;
+    k.sum_squares = sum_squares;
+    k.absmax = absmax;
+    k.axpy = axpy;
+    k.scale_mul = scale_mul;
+#if LK_CPU_LEVEL >= 3
+    k.int8_group8_dot = int8_group8_dot_vnni;
+#elif LK_CPU_LEVEL >= 1
+    k.int8_group8_dot = int8_group8_dot;
+#else
+    k.int8_group8_dot = int8_group8_dot_scalar;
+#endif
+#if LK_CPU_LEVEL >= 4
+    k.gemm_s8 = gemm_s8_amx;
+    k.gemm_bf16 = gemm_bf16_amx;
+#elif LK_CPU_LEVEL >= 1
+    k.gemm_s8 = gemm_s8;
+    k.gemm_bf16 = gemm_bf16;
+#else
+    k.gemm_s8 = gemm_s8_scalar;
+    k.gemm_bf16 = gemm_bf16_scalar;
+#endif
+}
+
+} // namespace
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,40 @@
+#include "cpu_kernels.h"
+#include "core/host_float.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+// Haswell and up: every function below may use AVX2, FMA and F16C.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma,f16c"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma,f16c")
+#endif
+
+#define LK_CPU_LEVEL 1
+#include "cpu_kernels.inl"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+namespace lightllm {
+namespace core {
+
+void fill_cpu_kernels_avx2(CpuKernels& k) {
+    fill(k);
+}
+
+} // namespace core
+} // namespace lightllm
+
+#endif
@@ -0,0 +1,41 @@
+#include "cpu_kernels.h"
+#include "core/host_float.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+// Skylake-SP and up. VNNI is only used by int8_group8_dot_vnni, which carries its own target.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma,f16c,avx512f,avx512bw,avx512vl,avx512dq"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma,f16c,avx512f,avx512bw,avx512vl,avx512dq")
+#endif
+
+#define LK_CPU_LEVEL 2
+#include "cpu_kernels.inl"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+namespace lightllm {
+namespace core {
+
+void fill_cpu_kernels_avx512(CpuKernels& k, const bool vnni) {
+    fill(k);
+    if (vnni) k.int8_group8_dot = int8_group8_dot_vnni;
+}
+
+} // namespace core
+} // namespace lightllm
+
+#endif
@@ -0,0 +1,40 @@
+#include "cpu_kernels.h"
+#include "core/host_float.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+// Cooper Lake, Zen 4 and up: native bf16 conversions and dot products.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma,f16c,avx512f,avx512bw,avx512vl,avx512dq,avx512vnni,avx512bf16"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma,f16c,avx512f,avx512bw,avx512vl,avx512dq,avx512vnni,avx512bf16")
+#endif
+
+#define LK_CPU_LEVEL 3
+#include "cpu_kernels.inl"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+namespace lightllm {
+namespace core {
+
+void fill_cpu_kernels_avx512_bf16(CpuKernels& k) {
+    fill(k);
+}
+
+} // namespace core
+} // namespace lightllm
+
+#endif
@@ -0,0 +1,22 @@
+#include "cpu_kernels.h"
+#include "core/host_float.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Portable level, the reference the others are tested against.
+#define LK_CPU_LEVEL 0
+#include "cpu_kernels.inl"
+
+namespace lightllm {
+namespace core {
+
+void fill_cpu_kernels_scalar(CpuKernels& k) {
+    fill(k);
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,117 @@
+#include "core/cpu_stream.h"
+
+#include <utility>
+
+namespace lightllm {
+namespace core {
+
+bool CpuEvent::query() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return done_;
+}
+
+void CpuEvent::synchronize() const {
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&] { return done_; });
+        error = error_;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void CpuEvent::complete(std::exception_ptr error) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+        error_ = std::move(error);
+    }
+    cv_.notify_all();
+}
+
+CpuStream::CpuStream() : thread_([this] { loop(); }) {}
+
+CpuStream::~CpuStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    thread_.join();
+}
+
+void CpuStream::push(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(task));
+    }
+    work_cv_.notify_one();
+}
+
+void CpuStream::enqueue(std::function<void()> fn) { push(Task{std::move(fn), false}); }
+
+std::shared_ptr<CpuEvent> CpuStream::record() {
+    auto event = std::make_shared<CpuEvent>();
+    push(Task{[this, event] {
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error = error_;
+        }
+        event->complete(error);
+    }, true});
+    return event;
+}
+
+void CpuStream::wait(std::shared_ptr<CpuEvent> event) {
+    // the error of the other stream stays with its event
+    push(Task{[event] {
+        std::unique_lock<std::mutex> lock(event->mutex_);
+        event->cv_.wait(lock, [&] { return event->done_; });
+    }, true});
+}
+
+bool CpuStream::query() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.empty() && !busy_;
+}
+
+void CpuStream::synchronize() {
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_cv_.wait(lock, [&] { return queue_.empty() && !busy_; });
+        std::swap(error, error_);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void CpuStream::loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;  // stopped and drained
+        Task task = std::move(queue_.front());
+        queue_.pop_front();
+        const bool skip = error_ && !task.always;
+        busy_ = true;
+        lock.unlock();
+        std::exception_ptr error;
+        if (!skip) {
+            try {
+                task.fn();
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        // the callable may own resources, release them before the stream reads as idle
+        task.fn = nullptr;
+        lock.lock();
+        busy_ = false;
+        if (error && !error_) error_ = error;
+        if (queue_.empty()) idle_cv_.notify_all();
+    }
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,49 @@
+#include "core/device_util.h"
+
+#include <cuda_runtime.h>
+#include <string>
+
+namespace lightllm {
+namespace core {
+
+static void check_cuda(const cudaError_t status, const char* what) {
+    if (status != cudaSuccess) {
+        throw std::runtime_error(std::string(what) + ": " + cudaGetErrorString(status));
+    }
+}
+
+void* record_device_event(void* stream) {
+    cudaEvent_t event;
+    check_cuda(cudaEventCreateWithFlags(&event, cudaEventDisableTiming), "cudaEventCreate");
+    check_cuda(cudaEventRecord(event, static_cast<cudaStream_t>(stream)), "cudaEventRecord");
+    return event;
+}
+
+bool device_event_done(void* event) {
+    const cudaError_t status = cudaEventQuery(static_cast<cudaEvent_t>(event));
+    if (status == cudaErrorNotReady) return false;
+    check_cuda(status, "cudaEventQuery");
+    return true;
+}
+
+void sync_device_event(void* event) {
+    check_cuda(cudaEventSynchronize(static_cast<cudaEvent_t>(event)), "cudaEventSynchronize");
+}
+
+void destroy_device_event(void* event) {
+    cudaEventDestroy(static_cast<cudaEvent_t>(event));
+}
+
+void copy_device_to_host(void* dst, const void* src, const int64_t bytes, void* stream) {
+    const cudaStream_t s = static_cast<cudaStream_t>(stream);
+    check_cuda(cudaMemcpyAsync(dst, src, bytes, cudaMemcpyDeviceToHost, s), "cudaMemcpyAsync");
+    check_cuda(cudaStreamSynchronize(s), "cudaStreamSynchronize");
+}
+
+void copy_host_to_device_async(void* dst, const void* src, const int64_t bytes, void* stream) {
+    check_cuda(cudaMemcpyAsync(dst, src, bytes, cudaMemcpyHostToDevice, static_cast<cudaStream_t>(stream)),
+               "cudaMemcpyAsync");
+}
+
+} // namespace core
+} // namespace lightllm
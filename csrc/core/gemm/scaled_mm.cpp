@@ -0,0 +1,176 @@
+#include "core/ops.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+// A task computes one [kBlockM, kBlockN] block of c. The b panel stays in L2
+// while it is swept by the rows of a, and the AMX kernel packs it once per task.
+constexpr int64_t kBlockM = 256;
+constexpr int64_t kBlockN = 64;
+
+// fp8_e4m3 values are exact in bf16, one table lookup converts them.
+struct Fp8ToBf16 {
+    host_bf16_t table[256];
+    Fp8ToBf16() {
+        for (int32_t i = 0; i < 256; i++) {
+            host_fp8_e4m3_t x;
+            x.bits = static_cast<uint8_t>(i);
+            table[i] = from_float<host_bf16_t>(to_float(x));
+        }
+    }
+};
+
+void fp8_to_bf16(const host_fp8_e4m3_t* x, host_bf16_t* y, const int64_t n) {
+    static const Fp8ToBf16 lut;
+    for (int64_t i = 0; i < n; i++) y[i] = lut.table[x[i].bits];
+}
+
+template<typename T>
+void store_block(
+    const TensorView& c, const fp32_t* a_s, const fp32_t* b_s, const T* bias, const T* ls,
+    const int64_t m0, const int64_t mm, const int64_t n0, const int64_t nn, const bool per_token,
+    const bool per_channel, const fp32_t* acc
+) {
+    for (int64_t i = 0; i < mm; i++) {
+        const fp32_t sa = a_s[per_token ? m0 + i : 0];
+        T* dst = c.data_ptr<T>() + (m0 + i) * c.stride(0) + n0;
+        for (int64_t j = 0; j < nn; j++) {
+            fp32_t x = sa * b_s[per_channel ? n0 + j : 0] * acc[i * nn + j];
+            if (bias != nullptr) x += to_float(bias[n0 + j]);
+            if (ls != nullptr) x *= to_float(ls[n0 + j]);
+            dst[j] = from_float<T>(x);
+        }
+    }
+}
+
+} // namespace
+
+void scaled_mm_cpu(
+    const TensorView& c, const TensorView& a, const TensorView& b,
+    const TensorView& a_scales, const TensorView& b_scales,
+    const TensorView& bias, const TensorView& ls
+) {
+    const int64_t M = a.size(0);
+    const int64_t K = a.size(1);
+    const int64_t N = b.size(1);
+    const bool fp8 = a.dtype == DType::Fp8E4M3;
+    const bool per_token = a_scales.numel() == M;
+    const bool per_channel = b_scales.numel() == N;
+    const CpuKernels& kernels = cpu_kernels();
+
+    // fp8 operands run the bf16 GEMM
+    std::vector<host_bf16_t> a16(fp8 ? M * K : 0);
+    if (fp8) {
+        parallel_for(0, M, std::max<int64_t>(1, 65536 / std::max<int64_t>(K, 1)), [&](int64_t begin, int64_t end) {
+            for (int64_t m = begin; m < end; m++) {
+                fp8_to_bf16(a.data_ptr<const host_fp8_e4m3_t>() + m * a.stride(0), a16.data() + m * K, K);
+            }
+        });
+    }
+
+    const int64_t m_blocks = (M + kBlockM - 1) / kBlockM;
+    const int64_t n_blocks = (N + kBlockN - 1) / kBlockN;
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        const T* bias_p = bias.data != nullptr ? bias.data_ptr<const T>() : nullptr;
+        const T* ls_p = ls.data != nullptr ? ls.data_ptr<const T>() : nullptr;
+        // consecutive tasks share the b panel, so a worker converts it once per run of them
+        parallel_for(0, n_blocks * m_blocks, 1, [&](int64_t begin, int64_t end) {
+            std::vector<fp32_t> acc(kBlockM * kBlockN);
+            std::vector<int32_t> acc_i(fp8 ? 0 : kBlockM * kBlockN);
+            std::vector<host_bf16_t> b16(fp8 ? kBlockN * K : 0);
+            int64_t panel = -1;
+            for (int64_t task = begin; task < end; task++) {
+                const int64_t nb = task / m_blocks;
+                const int64_t m0 = task % m_blocks * kBlockM;
+                const int64_t n0 = nb * kBlockN;
+                const int64_t mm = std::min(kBlockM, M - m0);
+                const int64_t nn = std::min(kBlockN, N - n0);
+                if (fp8) {
+                    if (panel != nb) {
+                        for (int64_t j = 0; j < nn; j++) {
+                            fp8_to_bf16(b.data_ptr<const host_fp8_e4m3_t>() + (n0 + j) * b.stride(1), b16.data() + j * K, K);
+                        }
+                        panel = nb;
+                    }
+                    kernels.gemm_bf16(a16.data() + m0 * K, K, b16.data(), K, acc.data(), nn, mm, nn, K);
+                } else {
+                    kernels.gemm_s8(a.data_ptr<const int8_t>() + m0 * a.stride(0), a.stride(0),
+                                    b.data_ptr<const int8_t>() + n0 * b.stride(1), b.stride(1),
+                                    acc_i.data(), nn, mm, nn, K);
+                    // int32 sums of int8 products are exact for K < 2^17
+                    for (int64_t i = 0; i < mm * nn; i++) acc[i] = static_cast<fp32_t>(acc_i[i]);
+                }
+                store_block<T>(c, a_scales.data_ptr<const fp32_t>(), b_scales.data_ptr<const fp32_t>(),
+                               bias_p, ls_p, m0, mm, n0, nn, per_token, per_channel, acc.data());
+            }
+        });
+    };
+    switch (c.dtype) {
+        case DType::BFloat16: run(host_bf16_t{}); break;
+        case DType::Float16: run(host_fp16_t{}); break;
+        default: run(fp32_t{}); break;
+    }
+}
+
+/**
+ * @brief Host scaled GEMM, see ops.h. The inner products run on the GEMM
+ * kernels of the active CPU instruction set (VNNI / AVX512_BF16 / AMX).
+ *
+ * @param c         [M, N] bf16 / fp16 / fp32 output, rows contiguous.
+ * @param a         [M, K] int8 or fp8_e4m3, rows contiguous.
+ * @param b         [K, N] of the dtype of a, column major (stride(0) == 1).
+ * @param a_scales  fp32 [M] per token or [1] per tensor, contiguous.
+ * @param b_scales  fp32 [N] per channel or [1] per tensor, contiguous.
+ * @param bias      Optional contiguous [N] of the dtype of c.
+ * @param ls        Optional contiguous [N] of the dtype of c, applied after bias.
+ */
+void scaled_mm(
+    const TensorView& c, const TensorView& a, const TensorView& b,
+    const TensorView& a_scales, const TensorView& b_scales,
+    const TensorView& bias, const TensorView& ls
+) {
+    LK_CHECK(a.dim() == 2 && b.dim() == 2 && c.dim() == 2, "scaled_mm expects 2D a, b and c");
+    LK_CHECK(c.size(0) == a.size(0) && a.size(1) == b.size(0) && b.size(1) == c.size(1),
+             "scaled_mm shape mismatch");
+    LK_CHECK(a.dtype == b.dtype && (a.dtype == DType::Int8 || a.dtype == DType::Fp8E4M3),
+             "scaled_mm: a and b must both be int8 or both float8_e4m3fn");
+    LK_CHECK(c.dtype == DType::BFloat16 || c.dtype == DType::Float16 || c.dtype == DType::Float32,
+             "scaled_mm: c must be bf16, fp16 or fp32, got ", dtype_name(c.dtype));
+    LK_CHECK(a.stride(1) == 1 && c.stride(1) == 1, "scaled_mm: a and c must be row major");
+    LK_CHECK(b.stride(0) == 1, "scaled_mm: b must be column major");
+    LK_CHECK(a_scales.dtype == DType::Float32 && a_scales.is_contiguous() &&
+             (a_scales.numel() == 1 || a_scales.numel() == a.size(0)),
+             "scaled_mm: a_scales must be a contiguous fp32 [M] or [1] tensor");
+    LK_CHECK(b_scales.dtype == DType::Float32 && b_scales.is_contiguous() &&
+             (b_scales.numel() == 1 || b_scales.numel() == b.size(1)),
+             "scaled_mm: b_scales must be a contiguous fp32 [N] or [1] tensor");
+    for (const TensorView* t : {&bias, &ls}) {
+        if (t->data == nullptr) continue;
+        LK_CHECK(t->dim() == 1 && t->numel() == b.size(1) && t->is_contiguous() && t->dtype == c.dtype,
+                 "scaled_mm: bias and ls must be contiguous [N] tensors of the dtype of c");
+    }
+    for (const TensorView* t : {&a, &b, &a_scales, &b_scales, &bias, &ls}) {
+        if (t->data == nullptr) continue;
+        LK_CHECK(t->device == c.device && t->device_index == c.device_index,
+                 "scaled_mm expects all tensors on the same device");
+    }
+    if (c.numel() == 0) return;
+
+    if (c.is_cpu()) {
+        scaled_mm_cpu(c, a, b, a_scales, b_scales, bias, ls);
+        return;
+    }
+    LK_NOT_SUPPORTED("scaled_mm: CUDA tensors go through cutlass_scaled_mm");
+}
+
+} // namespace core
+} // namespace lightllm
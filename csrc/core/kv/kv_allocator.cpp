@@ -0,0 +1,358 @@
+#include "core/kv_allocator.h"
+
+#include <algorithm>
+
+namespace lightllm {
+namespace core {
+
+KvPageAllocator::KvPageAllocator(
+    int32_t num_pages, int32_t page_size, int32_t max_reqs,
+    int32_t max_seq_len, const TensorView& req_to_tokens, const TensorView& page_precision
+) : num_pages_(num_pages), page_size_(page_size), max_reqs_(max_reqs), max_seq_len_(max_seq_len) {
+    LK_CHECK(num_pages > 0 && page_size > 0 && max_reqs > 0 && max_seq_len > 0);
+    LK_CHECK(static_cast<int64_t>(num_pages) * page_size <= INT32_MAX, "token slots must fit in int32");
+    LK_CHECK(req_to_tokens.is_cpu(), "req_to_tokens must be in host memory");
+    LK_CHECK(req_to_tokens.dtype == DType::Int32, "req_to_tokens must be int32");
+    LK_CHECK(req_to_tokens.dim() == 2 && req_to_tokens.stride(1) == 1, "req_to_tokens must be 2D with contiguous rows");
+    LK_CHECK(req_to_tokens.size(0) >= max_reqs && req_to_tokens.size(1) >= max_seq_len,
+             "req_to_tokens must be at least [", max_reqs, ", ", max_seq_len, "]");
+    table_ = req_to_tokens.data_ptr<int32_t>();
+    table_stride_ = req_to_tokens.stride(0);
+    if (page_precision.data != nullptr) {
+        LK_CHECK(page_precision.is_cpu() && page_precision.dtype == DType::Int8 && page_precision.is_contiguous() &&
+                 page_precision.numel() >= num_pages, "page_precision must be a contiguous [num_pages] int8 host tensor");
+        // the virtual slots of downgraded pages follow the physical ones
+        LK_CHECK(2 * static_cast<int64_t>(num_pages) * page_size <= INT32_MAX,
+                 "twice the token slots must fit in int32 to downgrade pages");
+        precision_ = page_precision.data_ptr<int8_t>();
+        std::fill(precision_, precision_ + num_pages, 0);
+    }
+
+    // Pop from the back, so hand out low page / row ids first.
+    free_pages_.resize(num_pages);
+    for (int32_t i = 0; i < num_pages; i++) free_pages_[i] = num_pages - 1 - i;
+    free_reqs_.resize(max_reqs);
+    for (int32_t i = 0; i < max_reqs; i++) free_reqs_[i] = max_reqs - 1 - i;
+    page_refs_.assign(2 * static_cast<size_t>(num_pages), 0);
+    reqs_.resize(max_reqs);
+    batch_stamp_.assign(max_reqs, 0);
+}
+
+void KvPageAllocator::check_req(int32_t req) const {
+    LK_CHECK(req >= 0 && req < max_reqs_ && reqs_[req].active, "request ", req, " is not allocated");
+}
+
+int32_t KvPageAllocator::alloc_req() {
+    if (free_reqs_.empty()) return -1;
+    const int32_t req = free_reqs_.back();
+    free_reqs_.pop_back();
+    Request& r = reqs_[req];
+    r.active = true;
+    r.seq_len = 0;
+    r.pages.clear();
+    return req;
+}
+
+void KvPageAllocator::release_page(int32_t page) {
+    if (--page_refs_[page] != 0) return;
+    const int32_t physical = page % num_pages_;
+    if (!downgraded(physical)) {
+        free_pages_.push_back(page);
+        return;
+    }
+    // a downgraded page is free once both halves are, then it holds full precision rows again
+    if (in_use(physical)) return;
+    precision_[physical] = 0;
+    free_pages_.push_back(physical);
+}
+
+void KvPageAllocator::free_req(int32_t req) {
+    check_req(req);
+    Request& r = reqs_[req];
+    for (const int32_t page : r.pages) release_page(page);
+    r.pages.clear();
+    r.seq_len = 0;
+    r.active = false;
+    free_reqs_.push_back(req);
+}
+
+void KvPageAllocator::free_reqs(const int32_t* reqs, int32_t n) {
+    stamp_++;
+    for (int32_t i = 0; i < n; i++) {
+        check_req(reqs[i]);
+        LK_CHECK(batch_stamp_[reqs[i]] != stamp_, "request ", reqs[i], " appears twice in one free_reqs");
+        batch_stamp_[reqs[i]] = stamp_;
+    }
+    for (int32_t i = 0; i < n; i++) free_req(reqs[i]);
+}
+
+int32_t KvPageAllocator::fork(int32_t src, int32_t prefix_len) {
+    check_req(src);
+    LK_CHECK(prefix_len >= 0 && prefix_len <= reqs_[src].seq_len,
+             "prefix_len ", prefix_len, " exceeds the length of request ", src);
+    LK_CHECK(prefix_len % page_size_ == 0 || !downgraded(reqs_[src].pages[prefix_len / page_size_]),
+             "fork: a prefix cannot end inside a downgraded page");
+    const int32_t req = alloc_req();
+    if (req < 0) return -1;
+
+    const Request& s = reqs_[src];
+    Request& r = reqs_[req];
+    const int32_t num_shared = (prefix_len + page_size_ - 1) / page_size_;
+    r.pages.assign(s.pages.begin(), s.pages.begin() + num_shared);
+    for (const int32_t page : r.pages) page_refs_[page]++;
+    r.seq_len = prefix_len;
+    std::copy(row(src), row(src) + prefix_len, row(req));
+    return req;
+}
+
+int32_t KvPageAllocator::pages_needed(const Request& r, int32_t n) const {
+    if (n == 0) return 0;
+    const int32_t total = (r.seq_len + n + page_size_ - 1) / page_size_;
+    int32_t needed = total - static_cast<int32_t>(r.pages.size());
+    // the partially filled last page is written, copy it first if it is shared
+    if (r.seq_len % page_size_ != 0 && page_refs_[r.pages.back()] > 1) needed++;
+    return needed;
+}
+
+bool KvPageAllocator::extend(
+    const int32_t* reqs, const int32_t* num_new, int32_t n,
+    int32_t* out_slots, std::vector<KvPageCopy>* copies
+) {
+    // Validate the whole batch and count its pages before touching anything.
+    stamp_++;
+    int64_t needed = 0;
+    for (int32_t i = 0; i < n; i++) {
+        const int32_t req = reqs[i];
+        check_req(req);
+        LK_CHECK(batch_stamp_[req] != stamp_, "request ", req, " appears twice in one extend");
+        batch_stamp_[req] = stamp_;
+        LK_CHECK(num_new[i] >= 0, "num_new must be >= 0");
+        LK_CHECK(static_cast<int64_t>(reqs_[req].seq_len) + num_new[i] <= max_seq_len_,
+                 "request ", req, " would exceed max_seq_len ", max_seq_len_);
+        needed += pages_needed(reqs_[req], num_new[i]);
+    }
+    if (needed > static_cast<int64_t>(free_pages_.size())) return false;
+
+    int32_t* out = out_slots;
+    for (int32_t i = 0; i < n; i++) {
+        Request& r = reqs_[reqs[i]];
+        int32_t* table_row = row(reqs[i]);
+        const int32_t end = r.seq_len + num_new[i];
+        if (num_new[i] == 0) continue;
+
+        const int32_t offset = r.seq_len % page_size_;
+        if (offset != 0 && page_refs_[r.pages.back()] > 1) {
+            const int32_t shared = r.pages.back();
+            const int32_t page = free_pages_.back();
+            free_pages_.pop_back();
+            page_refs_[page] = 1;
+            page_refs_[shared]--;
+            r.pages.back() = page;
+            if (copies != nullptr) copies->push_back({shared, page, offset});
+            // tokens already in the page now live in the copy
+            const int32_t first = r.seq_len - offset;
+            for (int32_t t = 0; t < offset; t++) table_row[first + t] = page * page_size_ + t;
+        }
+
+        for (int32_t pos = r.seq_len; pos < end; pos++) {
+            const int32_t offset_in_page = pos % page_size_;
+            if (offset_in_page == 0) {
+                const int32_t page = free_pages_.back();
+                free_pages_.pop_back();
+                page_refs_[page] = 1;
+                r.pages.push_back(page);
+            }
+            const int32_t slot = r.pages.back() * page_size_ + offset_in_page;
+            table_row[pos] = slot;
+            *out++ = slot;
+        }
+        r.seq_len = end;
+    }
+    return true;
+}
+
+void KvPageAllocator::truncate(int32_t req, int32_t new_len) {
+    check_req(req);
+    Request& r = reqs_[req];
+    LK_CHECK(new_len >= 0 && new_len <= r.seq_len, "truncate can only shrink a request");
+    LK_CHECK(new_len % page_size_ == 0 || !downgraded(r.pages[new_len / page_size_]),
+             "truncate: request ", req, " cannot end inside a downgraded page");
+    const size_t keep = (new_len + page_size_ - 1) / page_size_;
+    while (r.pages.size() > keep) {
+        release_page(r.pages.back());
+        r.pages.pop_back();
+    }
+    r.seq_len = new_len;
+}
+
+bool KvPageAllocator::evict(int32_t req, const int32_t* keep, int32_t n_keep, std::vector<int32_t>* slot_pairs) {
+    check_req(req);
+    Request& r = reqs_[req];
+    LK_CHECK(n_keep >= 0 && n_keep <= r.seq_len, "evict: n_keep must be in [0, seq_len]");
+    for (int32_t i = 0; i < n_keep; i++) {
+        LK_CHECK(keep[i] >= 0 && keep[i] < r.seq_len && (i == 0 || keep[i] > keep[i - 1]),
+                 "evict: keep must be ascending positions of request ", req);
+    }
+    for (const int32_t page : r.pages) {
+        LK_CHECK(!downgraded(page), "evict: request ", req, " holds downgraded pages");
+    }
+    // positions before first are kept in place
+    int32_t first = 0;
+    while (first < n_keep && keep[first] == first) first++;
+
+    // pages from the one holding first up to the new end are written, shared ones are copied
+    const int32_t first_page = first / page_size_;
+    const int32_t end_page = (n_keep + page_size_ - 1) / page_size_;
+    int32_t needed = 0;
+    for (int32_t p = first_page; p < end_page && first < n_keep; p++) {
+        if (page_refs_[r.pages[p]] > 1) needed++;
+    }
+    if (needed > num_free_pages()) return false;
+
+    int32_t* table_row = row(req);
+    std::vector<int32_t> src(table_row, table_row + r.seq_len);
+    for (int32_t p = first_page; p < end_page && first < n_keep; p++) {
+        if (page_refs_[r.pages[p]] == 1) continue;
+        const int32_t page = free_pages_.back();
+        free_pages_.pop_back();
+        page_refs_[page] = 1;
+        release_page(r.pages[p]);
+        r.pages[p] = page;
+        // kept positions of the page before first move with it
+        for (int32_t pos = p * page_size_; pos < std::min(first, (p + 1) * page_size_); pos++) {
+            table_row[pos] = page * page_size_ + pos % page_size_;
+            if (slot_pairs != nullptr) slot_pairs->insert(slot_pairs->end(), {src[pos], table_row[pos]});
+        }
+    }
+    for (int32_t pos = first; pos < n_keep; pos++) {
+        table_row[pos] = r.pages[pos / page_size_] * page_size_ + pos % page_size_;
+        if (slot_pairs != nullptr) slot_pairs->insert(slot_pairs->end(), {src[keep[pos]], table_row[pos]});
+    }
+    truncate(req, n_keep);
+    return true;
+}
+
+int32_t KvPageAllocator::compact(std::vector<KvPageCopy>* moves) {
+    const int32_t num_used = num_pages_ - num_free_pages();
+
+    // Pair the used pages at or above num_used with the free pages below it, both ascending.
+    std::vector<int32_t> remap(num_pages_, -1);
+    std::vector<int32_t> fill(num_pages_, 0);
+    int32_t hole = 0;
+    int32_t num_moves = 0;
+    for (int32_t page = num_used; page < num_pages_; page++) {
+        if (!in_use(page)) continue;
+        while (in_use(hole)) hole++;
+        remap[page] = hole++;
+        num_moves++;
+    }
+    if (num_moves == 0) return 0;
+
+    for (int32_t req = 0; req < max_reqs_; req++) {
+        Request& r = reqs_[req];
+        if (!r.active) continue;
+        int32_t* table_row = row(req);
+        for (size_t i = 0; i < r.pages.size(); i++) {
+            const int32_t page = r.pages[i];
+            const int32_t physical = page % num_pages_;
+            if (remap[physical] < 0) continue;
+            // the virtual half of a downgraded page follows its physical page
+            const int32_t moved = remap[physical] + (page - physical);
+            const int32_t first = static_cast<int32_t>(i) * page_size_;
+            const int32_t filled = std::min(page_size_, r.seq_len - first);
+            fill[physical] = downgraded(physical) ? page_size_ : std::max(fill[physical], filled);
+            r.pages[i] = moved;
+            for (int32_t t = 0; t < filled; t++) table_row[first + t] = moved * page_size_ + t;
+        }
+    }
+
+    for (int32_t page = num_used; page < num_pages_; page++) {
+        const int32_t dst = remap[page];
+        if (dst < 0) continue;
+        for (const int32_t half : {0, num_pages_}) {
+            page_refs_[half + dst] = page_refs_[half + page];
+            page_refs_[half + page] = 0;
+        }
+        if (precision_ != nullptr) {
+            precision_[dst] = precision_[page];
+            precision_[page] = 0;
+        }
+        if (moves != nullptr) moves->push_back({page, dst, fill[page]});
+    }
+    free_pages_.resize(num_pages_ - num_used);
+    for (int32_t i = 0; i < num_pages_ - num_used; i++) free_pages_[i] = num_pages_ - 1 - i;
+    return num_moves;
+}
+
+int32_t KvPageAllocator::downgrade(
+    int32_t num_pages, const KvDowngradePolicy& policy, std::vector<int32_t>* page_pairs
+) {
+    LK_CHECK(precision_ != nullptr, "downgrade: the allocator was created without page_precision");
+    LK_CHECK(policy.num_sink_pages >= 0 && policy.num_recent_pages >= 0, "downgrade: negative page counts");
+    if (num_pages <= 0) return 0;
+
+    // longest requests first, they hold the most cold pages
+    std::vector<int32_t> order;
+    for (int32_t req = 0; req < max_reqs_; req++) {
+        if (reqs_[req].active) order.push_back(req);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int32_t a, int32_t b) { return reqs_[a].seq_len > reqs_[b].seq_len; });
+
+    int32_t freed = 0;
+    std::vector<int32_t> cold;
+    for (const int32_t req : order) {
+        if (freed == num_pages) break;
+        Request& r = reqs_[req];
+        const int32_t end = r.seq_len / page_size_ - policy.num_recent_pages;
+        cold.clear();
+        for (int32_t i = policy.num_sink_pages; i < end; i++) {
+            const int32_t page = r.pages[i];
+            if (page < num_pages_ && !downgraded(page) && page_refs_[page] == 1) cold.push_back(i);
+        }
+        // oldest first, consecutive cold pages make a pair
+        int32_t* table_row = row(req);
+        for (size_t c = 0; c + 1 < cold.size() && freed < num_pages; c += 2) {
+            const int32_t lo = r.pages[cold[c]];
+            const int32_t hi = r.pages[cold[c + 1]];
+            const int32_t virtual_page = num_pages_ + lo;
+            page_refs_[hi] = 0;
+            page_refs_[virtual_page] = 1;
+            precision_[lo] = 1;
+            free_pages_.push_back(hi);
+            r.pages[cold[c + 1]] = virtual_page;
+            const int32_t first = cold[c + 1] * page_size_;
+            for (int32_t t = 0; t < page_size_; t++) table_row[first + t] = virtual_page * page_size_ + t;
+            if (page_pairs != nullptr) page_pairs->insert(page_pairs->end(), {lo, hi});
+            freed++;
+        }
+    }
+    return freed;
+}
+
+void KvPageAllocator::slot_pairs(const std::vector<KvPageCopy>& copies, std::vector<int32_t>* pairs) const {
+    for (const KvPageCopy& c : copies) {
+        for (int32_t t = 0; t < c.num_tokens; t++) {
+            pairs->push_back(c.src_page * page_size_ + t);
+            pairs->push_back(c.dst_page * page_size_ + t);
+        }
+    }
+}
+
+int32_t KvPageAllocator::seq_len(int32_t req) const {
+    check_req(req);
+    return reqs_[req].seq_len;
+}
+
+const std::vector<int32_t>& KvPageAllocator::pages(int32_t req) const {
+    check_req(req);
+    return reqs_[req].pages;
+}
+
+int32_t KvPageAllocator::page_ref(int32_t page) const {
+    LK_CHECK(page >= 0 && page < 2 * num_pages_, "page ", page, " out of range");
+    return page_refs_[page];
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,265 @@
+#include "core/ops.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+// Bytes of one token row: everything after the slot dim, which must be dense.
+int64_t row_bytes(const TensorView& t, const int32_t slot_dim) {
+    int64_t expected = 1;
+    for (int32_t d = t.dim() - 1; d > slot_dim; d--) {
+        LK_CHECK(t.size(d) == 1 || t.stride(d) == expected, "kv slot ops: the rows of a cache must be contiguous");
+        expected *= t.size(d);
+    }
+    return expected * t.element_size();
+}
+
+void check_caches(const char* op, const std::vector<TensorView>& caches, const int32_t slot_dim) {
+    LK_CHECK(!caches.empty() && caches.size() <= kMaxKvCopyTensors,
+             op, " takes 1 to ", kMaxKvCopyTensors, " tensors, got ", caches.size());
+    LK_CHECK(slot_dim == 0 || slot_dim == 1, op, ": slot_dim must be 0 or 1");
+    const TensorView& first = caches[0];
+    for (const TensorView& t : caches) {
+        LK_CHECK(t.dim() > slot_dim, op, ": a cache has no slot dim");
+        LK_CHECK(t.device == first.device && t.device_index == first.device_index,
+                 op, ": caches must be on the same device");
+        LK_CHECK(t.size(slot_dim) == first.size(slot_dim), op, ": caches must have the same number of slots");
+        LK_CHECK(slot_dim == 0 || t.size(0) == first.size(0), op, ": caches must have the same number of layers");
+        row_bytes(t, slot_dim);
+    }
+}
+
+void check_slots_in_range(const char* op, const int32_t* slots, const int64_t n, const int64_t num_slots) {
+    for (int64_t i = 0; i < n; i++) {
+        LK_CHECK(slots[i] >= 0 && slots[i] < num_slots, op, ": slot ", slots[i], " out of range [0, ", num_slots, ")");
+    }
+}
+
+struct HostCache {
+    char* data;
+    int64_t row_bytes;
+    int64_t slot_stride;   // bytes
+    int64_t layer_stride;  // bytes
+    int64_t packed_base;   // bytes, offset of this cache in the packed layout
+};
+
+std::vector<HostCache> host_caches(const std::vector<TensorView>& caches, const int32_t slot_dim, const int64_t n) {
+    const int64_t layers = slot_dim == 1 ? caches[0].size(0) : 1;
+    std::vector<HostCache> cs;
+    int64_t base = 0;
+    for (const TensorView& t : caches) {
+        const int64_t es = t.element_size();
+        cs.push_back({static_cast<char*>(t.data), row_bytes(t, slot_dim),
+                      t.stride(slot_dim) * es, slot_dim == 1 ? t.stride(0) * es : 0, base});
+        base += cs.back().row_bytes * layers * n;
+    }
+    return cs;
+}
+
+// Slot i, layer l of cache c <-> packed + c.packed_base + (l * n + i) * c.row_bytes.
+template<bool GATHER>
+void kv_pack_slots_cpu(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    char* packed, const int32_t slot_dim
+) {
+    const int64_t n = slots.numel();
+    const int64_t layers = slot_dim == 1 ? caches[0].size(0) : 1;
+    const int32_t* s = slots.data_ptr<const int32_t>();
+    const std::vector<HostCache> cs = host_caches(caches, slot_dim, n);
+    const int64_t bytes_per_slot = kv_slot_bytes(caches, slot_dim);
+
+    const int64_t grain = std::max<int64_t>(1, 65536 / std::max<int64_t>(bytes_per_slot, 1));
+    parallel_for(0, n, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; i++) {
+            for (const HostCache& c : cs) {
+                for (int64_t l = 0; l < layers; l++) {
+                    char* row = c.data + l * c.layer_stride + s[i] * c.slot_stride;
+                    char* p = packed + c.packed_base + (l * n + i) * c.row_bytes;
+                    if (GATHER) std::memcpy(p, row, c.row_bytes);
+                    else std::memcpy(row, p, c.row_bytes);
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+/**
+ * @brief Host side of the slot checks of the KV slot ops: slots in host
+ * memory must lie in [0, num_slots), which leaves out the virtual slots of
+ * pages downgraded by KvPageAllocator::downgrade. The kernels trap on device
+ * slots out of range (check_kv_slot).
+ */
+void check_kv_slots(const char* op, const TensorView& slots, const int64_t num_slots) {
+    if (slots.is_cpu()) check_slots_in_range(op, slots.data_ptr<const int32_t>(), slots.numel(), num_slots);
+}
+
+void check_kv_pack_args(
+    const char* op, const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+) {
+    check_caches(op, caches, slot_dim);
+    LK_CHECK(slots.dtype == DType::Int32 && slots.dim() == 1 && slots.is_contiguous(),
+             op, ": slots must be a contiguous 1D int32 tensor");
+    LK_CHECK(packed.is_contiguous(), op, ": the packed buffer must be contiguous");
+    LK_CHECK(packed.numel() * packed.element_size() >= slots.numel() * kv_slot_bytes(caches, slot_dim),
+             op, ": the packed buffer holds ", packed.numel() * packed.element_size(), " bytes, ",
+             slots.numel() * kv_slot_bytes(caches, slot_dim), " are needed");
+    if (caches[0].is_cpu()) {
+        LK_CHECK(slots.is_cpu() && packed.is_cpu(), op, ": CPU caches need CPU slots and buffer");
+    } else {
+        // pinned host memory is addressable from the device, device memory must be the caches' device
+        LK_CHECK(slots.is_cpu() || slots.device_index == caches[0].device_index, op, ": slots are on another device");
+        LK_CHECK(packed.is_cpu() || packed.device_index == caches[0].device_index, op, ": buffer is on another device");
+    }
+    check_kv_slots(op, slots, caches[0].size(slot_dim));
+}
+
+/**
+ * @brief Bytes one slot takes in the packed layout of kv_gather_slots: the
+ * sum of the row sizes of all caches times the number of layers.
+ */
+int64_t kv_slot_bytes(const std::vector<TensorView>& caches, const int32_t slot_dim) {
+    const int64_t layers = slot_dim == 1 ? caches[0].size(0) : 1;
+    int64_t bytes = 0;
+    for (const TensorView& t : caches) bytes += row_bytes(t, slot_dim) * layers;
+    return bytes;
+}
+
+void kv_copy_slots_cpu(
+    const std::vector<TensorView>& caches, const TensorView& pairs, const int32_t slot_dim
+) {
+    const int64_t n = pairs.size(0);
+    const int64_t layers = slot_dim == 1 ? caches[0].size(0) : 1;
+    const int32_t* p = pairs.data_ptr<const int32_t>();
+    check_slots_in_range("kv_copy_slots", p, 2 * n, caches[0].size(slot_dim));
+    const std::vector<HostCache> cs = host_caches(caches, slot_dim, 0);
+    const int64_t bytes_per_pair = kv_slot_bytes(caches, slot_dim);
+
+    // ~64KB per chunk, small batches are copied inline
+    const int64_t grain = std::max<int64_t>(1, 65536 / std::max<int64_t>(bytes_per_pair, 1));
+    parallel_for(0, n, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; i++) {
+            const int64_t src = p[2 * i];
+            const int64_t dst = p[2 * i + 1];
+            for (const HostCache& c : cs) {
+                for (int64_t l = 0; l < layers; l++) {
+                    char* base = c.data + l * c.layer_stride;
+                    std::memcpy(base + dst * c.slot_stride, base + src * c.slot_stride, c.row_bytes);
+                }
+            }
+        }
+    });
+}
+
+/**
+ * @brief Copy token rows of several KV cache tensors (e.g. K, V, k_s, v_s) in
+ * one launch: for every (src, dst) pair the row of slot src is copied over the
+ * row of slot dst in every tensor.
+ *
+ * @param caches    1..kMaxKvCopyTensors tensors on one device with the same
+ *                  number of slots, [slots, ...] (slot_dim 0) or
+ *                  [layers, slots, ...] (slot_dim 1, same layers for all);
+ *                  the part after the slot dim must be contiguous.
+ * @param pairs     [n, 2] contiguous int32 (src_slot, dst_slot) on the device
+ *                  of the caches. dst slots must be distinct and no dst slot
+ *                  may be a src slot, the copies run in no particular order.
+ *                  Out of range slots (e.g. the virtual slots of downgraded
+ *                  pages) throw on CPU and fail the launch on CUDA.
+ * @param slot_dim  0 or 1, see caches.
+ */
+void kv_copy_slots(
+    const std::vector<TensorView>& caches, const TensorView& pairs, const int32_t slot_dim
+) {
+    check_caches("kv_copy_slots", caches, slot_dim);
+    LK_CHECK(pairs.dtype == DType::Int32 && pairs.dim() == 2 && pairs.size(1) == 2 && pairs.is_contiguous(),
+             "kv_copy_slots: pairs must be a contiguous [n, 2] int32 tensor");
+    LK_CHECK(pairs.device == caches[0].device && pairs.device_index == caches[0].device_index,
+             "kv_copy_slots: caches and pairs must be on the same device");
+    if (pairs.size(0) == 0) return;
+
+    if (pairs.is_cpu()) {
+        kv_copy_slots_cpu(caches, pairs, slot_dim);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    kv_copy_slots_cuda(caches, pairs, slot_dim);
+#else
+    LK_NOT_SUPPORTED("kv_copy_slots: the core library was built without CUDA");
+#endif
+}
+
+void kv_gather_slots_cpu(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+) {
+    kv_pack_slots_cpu<true>(caches, slots, static_cast<char*>(packed.data), slot_dim);
+}
+
+void kv_scatter_slots_cpu(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+) {
+    kv_pack_slots_cpu<false>(caches, slots, static_cast<char*>(packed.data), slot_dim);
+}
+
+/**
+ * @brief Pack the rows of the given slots of all caches into one contiguous
+ * buffer, in one launch. Layout: cache by cache, layer by layer, the rows of
+ * slots[0..n) back to back (see kv_slot_bytes for the total size).
+ *
+ * @param caches    See kv_copy_slots.
+ * @param slots     [n] contiguous int32 slots, on the device of the caches or
+ *                  in pinned host memory. Out of range slots throw (host
+ *                  slots) or fail the launch, see check_kv_slots.
+ * @param packed    Contiguous buffer of >= n * kv_slot_bytes bytes. For CUDA
+ *                  caches it may be pinned host memory, which the kernel
+ *                  writes directly (no staging copy).
+ * @param slot_dim  0 or 1, see kv_copy_slots.
+ */
+void kv_gather_slots(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+) {
+    check_kv_pack_args("kv_gather_slots", caches, slots, packed, slot_dim);
+    if (slots.numel() == 0) return;
+    if (caches[0].is_cpu()) {
+        kv_gather_slots_cpu(caches, slots, packed, slot_dim);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    kv_gather_slots_cuda(caches, slots, packed, slot_dim);
+#else
+    LK_NOT_SUPPORTED("kv_gather_slots: the core library was built without CUDA");
+#endif
+}
+
+/**
+ * @brief Inverse of kv_gather_slots: write the packed rows into the given
+ * slots of all caches, in one launch. The slots must be distinct.
+ */
+void kv_scatter_slots(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+) {
+    check_kv_pack_args("kv_scatter_slots", caches, slots, packed, slot_dim);
+    if (slots.numel() == 0) return;
+    if (caches[0].is_cpu()) {
+        kv_scatter_slots_cpu(caches, slots, packed, slot_dim);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    kv_scatter_slots_cuda(caches, slots, packed, slot_dim);
+#else
+    LK_NOT_SUPPORTED("kv_scatter_slots: the core library was built without CUDA");
+#endif
+}
+
+} // namespace core
+} // namespace lightllm
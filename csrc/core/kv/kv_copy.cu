@@ -0,0 +1,191 @@
+#include "core/kv_transfer.h"
+#include "core/ops.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+namespace {
+
+struct KvCopyTensor {
+    char* data;
+    int64_t row_bytes;
+    int64_t slot_stride;   // bytes
+    int64_t layer_stride;  // bytes
+    int64_t packed_base;   // bytes, offset of this tensor in the packed layout
+    int32_t vec;           // widest access (16/8/4/1 bytes) all rows are aligned to
+};
+
+struct KvCopyArgs {
+    KvCopyTensor t[kMaxKvCopyTensors];
+    int32_t num_tensors;
+    int64_t num_slots;
+    int64_t layers;
+    int32_t header_words;  // Gather only: uint4 words of header written before packed
+    uint4 header[kKvTransferHeaderBytes / sizeof(uint4)];
+};
+
+enum class KvCopyMode { Copy, Gather, Scatter };
+
+template<typename V>
+__device__ inline
+void warp_copy_row(char* dst, const char* src, const int64_t bytes, const int32_t lane_id) {
+    const V* s = reinterpret_cast<const V*>(src);
+    V* d = reinterpret_cast<V*>(dst);
+    const int64_t n = bytes / sizeof(V);
+    for (int64_t i = lane_id; i < n; i += 32) d[i] = s[i];
+}
+
+__device__ inline
+void warp_copy_row(char* dst, const char* src, const int64_t bytes, const int32_t vec, const int32_t lane_id) {
+    switch (vec) {
+        case 16: warp_copy_row<uint4>(dst, src, bytes, lane_id); break;
+        case 8: warp_copy_row<uint2>(dst, src, bytes, lane_id); break;
+        case 4: warp_copy_row<uint32_t>(dst, src, bytes, lane_id); break;
+        default: warp_copy_row<uint8_t>(dst, src, bytes, lane_id); break;
+    }
+}
+
+/**
+ * @brief One warp per (task, layer) moves the row in every tensor, with the
+ * widest vector access the tensor allows. A task is a (src, dst) pair for
+ * Copy and the i-th slot for Gather / Scatter, whose other end is the packed
+ * buffer (which may be pinned host memory). A Gather may also write a
+ * transfer header in front of the packed buffer, from block 0. A slot out
+ * of range traps (check_kv_slot).
+ */
+template<int32_t TPB, KvCopyMode MODE>
+__global__
+void device_kv_copy_slots(
+    const KvCopyArgs args,
+    const int32_t* __restrict__ slots,   // [n, 2] (src, dst) for Copy, [n] otherwise
+    char* __restrict__ packed,           // Gather / Scatter only
+    const int64_t n
+) {
+    constexpr int32_t WARP_SIZE = 32;
+    constexpr int32_t WPB = TPB / WARP_SIZE;
+    const int32_t lane_id = threadIdx.x % WARP_SIZE;
+    const int64_t task = (int64_t)blockIdx.x * WPB + threadIdx.x / WARP_SIZE;
+    if (MODE == KvCopyMode::Gather && blockIdx.x == 0 && threadIdx.x < args.header_words) {
+        reinterpret_cast<uint4*>(packed - kKvTransferHeaderBytes)[threadIdx.x] = args.header[threadIdx.x];
+    }
+    if (task >= n * args.layers) return;
+
+    const int64_t i = task / args.layers;
+    const int64_t layer = task % args.layers;
+    const int64_t src = MODE == KvCopyMode::Copy ? slots[2 * i] : slots[i];
+    const int64_t dst = MODE == KvCopyMode::Copy ? slots[2 * i + 1] : src;
+    check_kv_slot(src, args.num_slots);
+    check_kv_slot(dst, args.num_slots);
+
+    for (int32_t k = 0; k < args.num_tensors; k++) {
+        const KvCopyTensor& t = args.t[k];
+        char* base = t.data + layer * t.layer_stride;
+        if (MODE == KvCopyMode::Copy) {
+            warp_copy_row(base + dst * t.slot_stride, base + src * t.slot_stride, t.row_bytes, t.vec, lane_id);
+            continue;
+        }
+        char* p = packed + t.packed_base + (layer * n + i) * t.row_bytes;
+        if (MODE == KvCopyMode::Gather) {
+            warp_copy_row(p, base + src * t.slot_stride, t.row_bytes, t.vec, lane_id);
+        } else {
+            warp_copy_row(base + dst * t.slot_stride, p, t.row_bytes, t.vec, lane_id);
+        }
+    }
+}
+
+KvCopyArgs make_args(
+    const std::vector<TensorView>& caches, const int32_t slot_dim,
+    const char* packed, const int64_t n
+) {
+    KvCopyArgs args;
+    args.header_words = 0;
+    args.num_tensors = static_cast<int32_t>(caches.size());
+    args.num_slots = caches[0].size(slot_dim);
+    args.layers = slot_dim == 1 ? caches[0].size(0) : 1;
+    int64_t base = 0;
+    for (int32_t k = 0; k < args.num_tensors; k++) {
+        const TensorView& c = caches[k];
+        const int64_t es = c.element_size();
+        KvCopyTensor& t = args.t[k];
+        t.data = static_cast<char*>(c.data);
+        t.row_bytes = es;
+        for (int32_t d = slot_dim + 1; d < c.dim(); d++) t.row_bytes *= c.size(d);
+        t.slot_stride = c.stride(slot_dim) * es;
+        t.layer_stride = slot_dim == 1 ? c.stride(0) * es : 0;
+        t.packed_base = base;
+        base += t.row_bytes * args.layers * n;
+        uint64_t align = reinterpret_cast<uint64_t>(t.data) | t.row_bytes | t.slot_stride | t.layer_stride;
+        if (packed != nullptr) align |= reinterpret_cast<uint64_t>(packed) + t.packed_base;
+        t.vec = align % 16 == 0 ? 16 : align % 8 == 0 ? 8 : align % 4 == 0 ? 4 : 1;
+    }
+    return args;
+}
+
+template<KvCopyMode MODE>
+void launch_kv_copy_slots(
+    const std::vector<TensorView>& caches, const int32_t slot_dim,
+    const int32_t* slots, char* packed, const int64_t n, void* stream,
+    const KvTransferHeader* header = nullptr
+) {
+    KvCopyArgs args = make_args(caches, slot_dim, packed, n);
+    if (header != nullptr) {
+        static_assert(kKvTransferHeaderBytes / sizeof(uint4) <= 256, "one thread per header word");
+        std::memset(args.header, 0, sizeof(args.header));
+        std::memcpy(args.header, header, sizeof(*header));
+        args.header_words = kKvTransferHeaderBytes / sizeof(uint4);
+    }
+    constexpr int32_t TPB = 256;
+    constexpr int32_t WPB = TPB / 32;
+    const int64_t blocks = std::max<int64_t>(1, (n * args.layers + WPB - 1) / WPB);
+    device_kv_copy_slots<TPB, MODE>
+    <<<blocks, TPB, 0, static_cast<cudaStream_t>(stream)>>>(args, slots, packed, n);
+}
+
+} // namespace
+
+void kv_copy_slots_cuda(
+    const std::vector<TensorView>& caches, const TensorView& pairs, const int32_t slot_dim
+) {
+    launch_kv_copy_slots<KvCopyMode::Copy>(
+        caches, slot_dim, pairs.data_ptr<const int32_t>(), nullptr, pairs.size(0), caches[0].stream
+    );
+}
+
+void kv_gather_slots_cuda(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+) {
+    launch_kv_copy_slots<KvCopyMode::Gather>(
+        caches, slot_dim, slots.data_ptr<const int32_t>(), static_cast<char*>(packed.data),
+        slots.numel(), caches[0].stream
+    );
+}
+
+void kv_scatter_slots_cuda(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+) {
+    launch_kv_copy_slots<KvCopyMode::Scatter>(
+        caches, slot_dim, slots.data_ptr<const int32_t>(), static_cast<char*>(packed.data),
+        slots.numel(), caches[0].stream
+    );
+}
+
+void kv_pack_cuda(
+    const std::vector<TensorView>& caches, const TensorView& slots, const int32_t slot_dim,
+    const KvTransferHeader& header, const TensorView& buffer
+) {
+    launch_kv_copy_slots<KvCopyMode::Gather>(
+        caches, slot_dim, slots.data_ptr<const int32_t>(),
+        static_cast<char*>(buffer.data) + header.header_bytes, slots.numel(), caches[0].stream, &header
+    );
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,167 @@
+#include "core/ops.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+constexpr int64_t kQuantGroup = 8;
+constexpr int64_t kPackedGroup = 16;
+
+/**
+ * @brief One (page pair, token, kv head) row: both full precision rows are
+ * read before the packed row overwrites the first one. E is the element type
+ * of the cache, S the dtype of its scales (E itself for a bf16 / fp16 cache).
+ */
+template<typename E, typename S>
+void downgrade_row(E* lo, S* lo_s, const E* hi, const S* hi_s, const int64_t D, fp32_t* row) {
+    constexpr bool kInt4 = std::is_same<E, int8_t>::value;
+    constexpr fp32_t kMax = kInt4 ? 7.0f : 127.0f;
+    const E* src[2] = {lo, hi};
+    const S* src_s[2] = {lo_s, hi_s};
+    for (int32_t h = 0; h < 2; h++) {
+        for (int64_t d = 0; d < D; d++) {
+            if constexpr (kInt4) row[h * D + d] = to_float(src_s[h][d / kQuantGroup]) * static_cast<fp32_t>(src[h][d]);
+            else row[h * D + d] = to_float(src[h][d]);
+        }
+    }
+
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(lo);
+    for (int64_t g = 0; g < 2 * D / kPackedGroup; g++) {
+        const fp32_t* x = row + g * kPackedGroup;
+        fp32_t amax = 0.0f;
+        for (int64_t i = 0; i < kPackedGroup; i++) amax = std::max(amax, std::fabs(x[i]));
+        // quantize with the rounded scale the readers see
+        const S s = from_float<S>(amax / kMax);
+        lo_s[g] = s;
+        const fp32_t inv = to_float(s) > 0.0f ? 1.0f / to_float(s) : 0.0f;
+        for (int64_t i = 0; i < kPackedGroup; i++) {
+            const int32_t q = static_cast<int32_t>(std::nearbyint(std::min(kMax, std::max(-kMax, x[i] * inv))));
+            // group g of the [2, D] row is element g * 16 of the packed row, whichever half it is in
+            const int64_t e = g * kPackedGroup + i;
+            if constexpr (kInt4) {
+                uint8_t& b = bytes[e / 2];
+                b = e % 2 == 0 ? static_cast<uint8_t>(q & 0xf) : static_cast<uint8_t>(b | (q & 0xf) << 4);
+            } else {
+                bytes[e] = static_cast<uint8_t>(static_cast<int8_t>(q));
+            }
+        }
+    }
+}
+
+} // namespace
+
+void kv_downgrade_pages_cpu(
+    const std::vector<TensorView>& caches, const std::vector<TensorView>& scales,
+    const TensorView& pairs, const int64_t page_size
+) {
+    const int64_t n = pairs.size(0);
+    const int32_t* p = pairs.data_ptr<const int32_t>();
+    for (size_t c = 0; c < caches.size(); c++) {
+        const TensorView& cache = caches[c];
+        const TensorView& scale = scales[c];
+        const int64_t kv_heads = cache.size(1);
+        const int64_t D = cache.size(2);
+        const int64_t rows_per_page = page_size * kv_heads;
+
+        auto run = [&](auto elem_tag, auto scale_tag) {
+            using E = decltype(elem_tag);
+            using S = decltype(scale_tag);
+            E* x = cache.data_ptr<E>();
+            S* s = scale.data_ptr<S>();
+            parallel_for(0, n * rows_per_page, std::max<int64_t>(1, 4096 / D), [&](int64_t begin, int64_t end) {
+                std::vector<fp32_t> row(2 * D);
+                for (int64_t task = begin; task < end; task++) {
+                    const int64_t i = task / rows_per_page;
+                    const int64_t lo = p[2 * i] * rows_per_page + task % rows_per_page;
+                    const int64_t hi = p[2 * i + 1] * rows_per_page + task % rows_per_page;
+                    downgrade_row<E, S>(x + lo * D, s + lo * (D / kQuantGroup), x + hi * D,
+                                        s + hi * (D / kQuantGroup), D, row.data());
+                }
+            });
+        };
+        auto dispatch_scale = [&](auto elem_tag) {
+            if (scale.dtype == DType::BFloat16) run(elem_tag, host_bf16_t{});
+            else run(elem_tag, host_fp16_t{});
+        };
+        switch (cache.dtype) {
+            case DType::Int8: dispatch_scale(int8_t{}); break;
+            case DType::BFloat16: run(host_bf16_t{}, host_bf16_t{}); break;
+            default: run(host_fp16_t{}, host_fp16_t{}); break;
+        }
+    }
+}
+
+/**
+ * @brief Pack page pairs of KV caches into their first pages at half the
+ * precision, see the format in ops.h and KvPageAllocator::downgrade.
+ *
+ * @param caches     [slots, Hkv, D] contiguous int8 / bf16 / fp16 caches on
+ *                   one device with the same slots, D % 16 == 0.
+ * @param scales     [slots, Hkv, D / 8] contiguous scales of every cache:
+ *                   bf16 / fp16 for int8, the dtype of the cache otherwise.
+ * @param pairs      [n, 2] contiguous int32 (p, q) pages on the device of the
+ *                   caches, all distinct. Out of range pages throw on CPU.
+ * @param page_size  Slots per page, divides the slots.
+ */
+void kv_downgrade_pages(
+    const std::vector<TensorView>& caches, const std::vector<TensorView>& scales,
+    const TensorView& pairs, const int64_t page_size
+) {
+    LK_CHECK(!caches.empty() && caches.size() == scales.size(), "kv_downgrade_pages takes one scale tensor per cache");
+    LK_CHECK(pairs.dtype == DType::Int32 && pairs.dim() == 2 && pairs.size(1) == 2 && pairs.is_contiguous(),
+             "kv_downgrade_pages: pairs must be a contiguous [n, 2] int32 tensor");
+    LK_CHECK(page_size > 0 && caches[0].dim() == 3 && caches[0].size(0) % page_size == 0,
+             "kv_downgrade_pages: page_size must divide the slots");
+    for (size_t c = 0; c < caches.size(); c++) {
+        const TensorView& cache = caches[c];
+        const TensorView& scale = scales[c];
+        LK_CHECK(cache.dim() == 3 && cache.is_contiguous() && cache.size(0) == caches[0].size(0),
+                 "kv_downgrade_pages: caches must be contiguous [slots, Hkv, D] with the same slots");
+        LK_CHECK(cache.size(2) % kPackedGroup == 0, "kv_downgrade_pages: D must be a multiple of 16, got ", cache.size(2));
+        if (cache.dtype == DType::Int8) {
+            LK_CHECK(scale.dtype == DType::BFloat16 || scale.dtype == DType::Float16,
+                     "kv_downgrade_pages: the scales of an int8 cache must be bf16 or fp16");
+        } else {
+            LK_CHECK(cache.dtype == DType::BFloat16 || cache.dtype == DType::Float16,
+                     "kv_downgrade_pages: caches must be int8, bf16 or fp16, got ", dtype_name(cache.dtype));
+            LK_CHECK(scale.dtype == cache.dtype, "kv_downgrade_pages: the scales of a bf16 / fp16 cache have its dtype");
+        }
+        LK_CHECK(scale.dim() == 3 && scale.is_contiguous() && scale.size(0) == cache.size(0) &&
+                 scale.size(1) == cache.size(1) && scale.size(2) == cache.size(2) / kQuantGroup,
+                 "kv_downgrade_pages: scales must be contiguous [slots, Hkv, D / 8]");
+        for (const TensorView* t : {&cache, &scale}) {
+            LK_CHECK(t->device == pairs.device && t->device_index == pairs.device_index,
+                     "kv_downgrade_pages: caches, scales and pairs must be on the same device");
+        }
+    }
+    if (pairs.size(0) == 0) return;
+
+    if (pairs.is_cpu()) {
+        const int64_t num_pages = caches[0].size(0) / page_size;
+        const int32_t* p = pairs.data_ptr<const int32_t>();
+        std::vector<char> seen(num_pages, 0);
+        for (int64_t i = 0; i < 2 * pairs.size(0); i++) {
+            LK_CHECK(p[i] >= 0 && p[i] < num_pages, "kv_downgrade_pages: page ", p[i], " out of range [0, ", num_pages, ")");
+            LK_CHECK(!seen[p[i]], "kv_downgrade_pages: page ", p[i], " appears twice");
+            seen[p[i]] = 1;
+        }
+        kv_downgrade_pages_cpu(caches, scales, pairs, page_size);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    kv_downgrade_pages_cuda(caches, scales, pairs, page_size);
+#else
+    LK_NOT_SUPPORTED("kv_downgrade_pages: the core library was built without CUDA");
+#endif
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,117 @@
+#include "core/ops.h"
+#include "utils.h"
+
+#include <type_traits>
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+namespace {
+
+constexpr int64_t kMaxCudaHeadDim = 1024;
+
+/**
+ * @brief One warp per (page pair, token, kv head) row: the lanes stage both
+ * full precision rows in shared memory before any lane writes the packed row
+ * over the first one, then every lane packs whole groups of 16. See
+ * kv_downgrade_pages for the format.
+ */
+template<int32_t TPB, typename E, typename S>
+__global__
+void device_kv_downgrade_pages(
+    E* __restrict__ cache,              // [slots, Hkv, D]
+    S* __restrict__ scale,              // [slots, Hkv, D / 8]
+    const int32_t* __restrict__ pairs,  // [n, 2]
+    const int64_t rows_per_page,        // page_size * Hkv
+    const int64_t num_rows,             // n * rows_per_page
+    const int64_t D
+) {
+    constexpr int32_t WARP_SIZE = 32;
+    constexpr bool INT4 = std::is_same<E, int8_t>::value;
+    constexpr fp32_t QMAX = INT4 ? 7.0f : 127.0f;
+    extern __shared__ fp32_t staged[];
+    const int32_t lane_id = threadIdx.x % WARP_SIZE;
+    const int64_t task = (int64_t)blockIdx.x * (TPB / WARP_SIZE) + threadIdx.x / WARP_SIZE;
+    if (task >= num_rows) return;
+
+    fp32_t* row = staged + threadIdx.x / WARP_SIZE * 2 * D;
+    const int64_t i = task / rows_per_page;
+    const int64_t lo = pairs[2 * i] * rows_per_page + task % rows_per_page;
+    #pragma unroll
+    for (int32_t h = 0; h < 2; h++) {
+        const int64_t r = h == 0 ? lo : pairs[2 * i + 1] * rows_per_page + task % rows_per_page;
+        for (int64_t d = lane_id; d < D; d += WARP_SIZE) {
+            const fp32_t x = static_cast<fp32_t>(cache[r * D + d]);
+            row[h * D + d] = INT4 ? x * static_cast<fp32_t>(scale[r * (D / 8) + d / 8]) : x;
+        }
+    }
+    __syncwarp();
+
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(cache + lo * D);
+    for (int64_t g = lane_id; g < 2 * D / 16; g += WARP_SIZE) {
+        const fp32_t* x = row + g * 16;
+        fp32_t amax = 0.0f;
+        #pragma unroll
+        for (int32_t j = 0; j < 16; j++) amax = fmaxf(amax, fabsf(x[j]));
+        const S s = static_cast<S>(amax / QMAX);
+        scale[lo * (D / 8) + g] = s;
+        const fp32_t sf = static_cast<fp32_t>(s);
+        const fp32_t inv = sf > 0.0f ? 1.0f / sf : 0.0f;
+        alignas(16) uint8_t packed[INT4 ? 8 : 16];
+        #pragma unroll
+        for (int32_t j = 0; j < 16; j++) {
+            const int32_t q = __float2int_rn(fminf(QMAX, fmaxf(-QMAX, x[j] * inv)));
+            if constexpr (INT4) {
+                if (j % 2 == 0) packed[j / 2] = q & 0xf;
+                else packed[j / 2] |= (q & 0xf) << 4;
+            } else {
+                packed[j] = static_cast<uint8_t>(q);
+            }
+        }
+        vec_copy<sizeof(packed)>(packed, bytes + g * sizeof(packed));
+    }
+}
+
+} // namespace
+
+void kv_downgrade_pages_cuda(
+    const std::vector<TensorView>& caches, const std::vector<TensorView>& scales,
+    const TensorView& pairs, const int64_t page_size
+) {
+    constexpr int32_t TPB = 128;
+    constexpr int32_t WPB = TPB / 32;
+    for (size_t c = 0; c < caches.size(); c++) {
+        const TensorView& cache = caches[c];
+        const TensorView& scale = scales[c];
+        const int64_t D = cache.size(2);
+        LK_CHECK(D <= kMaxCudaHeadDim, "kv_downgrade_pages: CUDA supports D up to ", kMaxCudaHeadDim);
+        const int64_t rows_per_page = page_size * cache.size(1);
+        const int64_t num_rows = pairs.size(0) * rows_per_page;
+        const int64_t blocks = (num_rows + WPB - 1) / WPB;
+        const int64_t shm = WPB * 2 * D * sizeof(fp32_t);
+
+        auto run = [&](auto elem_tag, auto scale_tag) {
+            using E = decltype(elem_tag);
+            using S = decltype(scale_tag);
+            device_kv_downgrade_pages<TPB, E, S>
+            <<<blocks, TPB, shm, static_cast<cudaStream_t>(cache.stream)>>>(
+                cache.data_ptr<E>(), scale.data_ptr<S>(), pairs.data_ptr<const int32_t>(),
+                rows_per_page, num_rows, D
+            );
+        };
+        auto dispatch_scale = [&](auto elem_tag) {
+            if (scale.dtype == DType::BFloat16) run(elem_tag, bf16_t{});
+            else run(elem_tag, fp16_t{});
+        };
+        switch (cache.dtype) {
+            case DType::Int8: dispatch_scale(int8_t{}); break;
+            case DType::BFloat16: run(bf16_t{}, bf16_t{}); break;
+            default: run(fp16_t{}, fp16_t{}); break;
+        }
+    }
+}
+
+} // namespace core
+} // namespace lightllm
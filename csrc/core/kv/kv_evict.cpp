@@ -0,0 +1,65 @@
+#include "core/ops.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+int32_t kv_evict_select(
+    const TensorView& attn_mass, const int32_t seq_len, const int32_t budget,
+    const KvEvictPolicy& policy, int32_t* keep
+) {
+    LK_CHECK(attn_mass.is_cpu(), "kv_evict_select: attn_mass must be in host memory");
+    LK_CHECK(attn_mass.dtype == DType::Float32, "kv_evict_select: attn_mass must be fp32");
+    LK_CHECK(attn_mass.dim() == 2 && attn_mass.stride(1) == 1, "kv_evict_select: attn_mass must be [Hkv, max_len] with contiguous rows");
+    LK_CHECK(seq_len >= 0 && seq_len <= attn_mass.size(1), "kv_evict_select: seq_len ", seq_len, " exceeds attn_mass");
+    LK_CHECK(budget >= 0, "kv_evict_select: budget must be non-negative");
+    LK_CHECK(policy.num_sink >= 0 && policy.num_recent >= 0, "kv_evict_select: negative policy window");
+
+    const int64_t Hkv = attn_mass.size(0);
+    fp32_t* mass = attn_mass.data_ptr<fp32_t>();
+    auto head_row = [&](int64_t h) { return mass + h * attn_mass.stride(0); };
+
+    if (seq_len <= budget) {
+        std::iota(keep, keep + seq_len, 0);
+        return seq_len;
+    }
+
+    // sinks and the recent window first, as many as the budget allows
+    const int32_t num_sink = std::min(policy.num_sink, budget);
+    const int32_t num_recent = std::min(policy.num_recent, budget - num_sink);
+    const int32_t mid_end = seq_len - num_recent;
+    const int32_t num_heavy = budget - num_sink - num_recent;
+
+    std::vector<fp32_t> score(mid_end - num_sink, 0.0f);
+    for (int64_t h = 0; h < Hkv; h++) {
+        const fp32_t* row = head_row(h) + num_sink;
+        for (size_t i = 0; i < score.size(); i++) score[i] += row[i];
+    }
+    std::vector<int32_t> heavy(score.size());
+    std::iota(heavy.begin(), heavy.end(), 0);
+    // highest mass first, the earlier token on ties so the choice is deterministic
+    std::nth_element(heavy.begin(), heavy.begin() + num_heavy, heavy.end(), [&](int32_t a, int32_t b) {
+        return score[a] > score[b] || (score[a] == score[b] && a < b);
+    });
+    std::sort(heavy.begin(), heavy.begin() + num_heavy);
+
+    int32_t n = 0;
+    for (int32_t t = 0; t < num_sink; t++) keep[n++] = t;
+    for (int32_t i = 0; i < num_heavy; i++) keep[n++] = num_sink + heavy[i];
+    for (int32_t t = mid_end; t < seq_len; t++) keep[n++] = t;
+
+    // keep is ascending, so each column moves down (or stays) and the rows compact in place
+    for (int64_t h = 0; h < Hkv; h++) {
+        fp32_t* row = head_row(h);
+        for (int32_t i = 0; i < n; i++) row[i] = row[keep[i]];
+        std::memset(row + n, 0, sizeof(fp32_t) * (seq_len - n));
+    }
+    return n;
+}
+
+} // namespace core
+} // namespace lightllm
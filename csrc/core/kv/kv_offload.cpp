@@ -0,0 +1,369 @@
+#include "core/kv_offload.h"
+#include "core/device_util.h"
+#include "core/ops.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace lightllm {
+namespace core {
+
+RangeAllocator::RangeAllocator(int64_t capacity) : capacity_(capacity), free_bytes_(capacity) {
+    LK_CHECK(capacity >= 0);
+    if (capacity > 0) free_[0] = capacity;
+}
+
+int64_t RangeAllocator::alloc(int64_t bytes) {
+    LK_CHECK(bytes > 0);
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+        if (it->second < bytes) continue;
+        const int64_t offset = it->first;
+        const int64_t rest = it->second - bytes;
+        free_.erase(it);
+        if (rest > 0) free_[offset + bytes] = rest;
+        free_bytes_ -= bytes;
+        return offset;
+    }
+    return -1;
+}
+
+void RangeAllocator::free(int64_t offset, int64_t bytes) {
+    free_bytes_ += bytes;
+    auto next = free_.lower_bound(offset);
+    if (next != free_.end() && next->first == offset + bytes) {
+        bytes += next->second;
+        next = free_.erase(next);
+    }
+    if (next != free_.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += bytes;
+            return;
+        }
+    }
+    free_[offset] = bytes;
+}
+
+KvOffloadEngine::KvOffloadEngine(const TensorView& host_arena, const std::string& disk_path, int64_t disk_bytes)
+    : host_base_(static_cast<char*>(host_arena.data)),
+      host_(host_arena.numel() * host_arena.element_size()) {
+    LK_CHECK(host_arena.is_cpu() && host_arena.is_contiguous(), "the host arena must be a contiguous CPU buffer");
+    if (!disk_path.empty()) {
+        LK_CHECK(disk_bytes > 0, "disk_bytes must be > 0 with a disk tier");
+        disk_fd_ = ::open(disk_path.c_str(), O_RDWR | O_CREAT, 0600);
+        if (disk_fd_ < 0) throw std::runtime_error("cannot open " + disk_path + ": " + std::strerror(errno));
+        void* base = MAP_FAILED;
+        if (::ftruncate(disk_fd_, disk_bytes) == 0) {
+            base = ::mmap(nullptr, disk_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, disk_fd_, 0);
+        }
+        if (base == MAP_FAILED) {
+            const std::string error = std::strerror(errno);
+            ::close(disk_fd_);
+            throw std::runtime_error("cannot map " + disk_path + ": " + error);
+        }
+        disk_base_ = static_cast<char*>(base);
+        disk_bytes_ = disk_bytes;
+        disk_ = RangeAllocator(disk_bytes);
+    }
+    io_thread_ = std::thread([this] { io_loop(); });
+}
+
+KvOffloadEngine::~KvOffloadEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    io_cv_.notify_all();
+    io_thread_.join();
+    // the device may still use the host arena, which the caller frees after us
+    for (auto& kv : entries_) {
+        if (kv.second.device_event == nullptr) continue;
+        sync_device_event(kv.second.device_event);
+        destroy_device_event(kv.second.device_event);
+    }
+    for (const PendingFree& p : pending_free_) {
+        sync_device_event(p.device_event);
+        destroy_device_event(p.device_event);
+    }
+    if (disk_base_ != nullptr) ::munmap(disk_base_, disk_bytes_);
+    if (disk_fd_ >= 0) ::close(disk_fd_);
+}
+
+KvOffloadEngine::Entry& KvOffloadEngine::entry(int64_t key) {
+    auto it = entries_.find(key);
+    LK_CHECK(it != entries_.end(), "key ", key, " is not offloaded");
+    return it->second;
+}
+
+const KvOffloadEngine::Entry& KvOffloadEngine::entry(int64_t key) const {
+    auto it = entries_.find(key);
+    LK_CHECK(it != entries_.end(), "key ", key, " is not offloaded");
+    return it->second;
+}
+
+void KvOffloadEngine::touch(int64_t key, Entry& e) {
+    if (e.in_lru) lru_.erase(e.lru);
+    lru_.push_front(key);
+    e.lru = lru_.begin();
+    e.in_lru = true;
+}
+
+void KvOffloadEngine::release_host(Entry& e, void* device_event) {
+    if (e.in_lru) {
+        lru_.erase(e.lru);
+        e.in_lru = false;
+    }
+    if (device_event == nullptr) {
+        host_.free(e.host_offset, e.bytes);
+    } else {
+        pending_free_.push_back({e.host_offset, e.bytes, device_event});
+    }
+    e.host_offset = -1;
+}
+
+void KvOffloadEngine::reclaim_host(bool wait) {
+    for (size_t i = 0; i < pending_free_.size();) {
+        PendingFree& p = pending_free_[i];
+        if (wait) sync_device_event(p.device_event);
+        if (wait || device_event_done(p.device_event)) {
+            destroy_device_event(p.device_event);
+            host_.free(p.offset, p.bytes);
+            p = pending_free_.back();
+            pending_free_.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+bool KvOffloadEngine::demote_lru(int64_t keep_key) {
+    if (disk_base_ == nullptr) return false;
+    for (auto it = lru_.rbegin(); it != lru_.rend(); ++it) {
+        const int64_t key = *it;
+        Entry& e = entries_.at(key);
+        if (key == keep_key || e.io_pending || e.prefetched) continue;
+        const int64_t disk_offset = disk_.alloc(e.bytes);
+        if (disk_offset < 0) return false;
+        if (e.device_event != nullptr) {
+            sync_device_event(e.device_event);
+            destroy_device_event(e.device_event);
+            e.device_event = nullptr;
+        }
+        std::memcpy(disk_base_ + disk_offset, host_base_ + e.host_offset, e.bytes);
+        release_host(e, nullptr);
+        e.disk_offset = disk_offset;
+        e.tier = KvTier::Disk;
+        return true;
+    }
+    return false;
+}
+
+int64_t KvOffloadEngine::alloc_host(int64_t bytes, int64_t keep_key) {
+    while (true) {
+        reclaim_host(false);
+        const int64_t offset = host_.alloc(bytes);
+        if (offset >= 0) return offset;
+        if (!pending_free_.empty()) {
+            reclaim_host(true);
+            continue;
+        }
+        if (!demote_lru(keep_key)) return -1;
+    }
+}
+
+bool KvOffloadEngine::offload(
+    int64_t key, const std::vector<TensorView>& caches,
+    const TensorView& slots, int32_t slot_dim
+) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LK_CHECK(entries_.find(key) == entries_.end(), "key ", key, " is already offloaded");
+    LK_CHECK(!caches.empty(), "offload needs at least one cache");
+    const int64_t bytes = slots.numel() * kv_slot_bytes(caches, slot_dim);
+    LK_CHECK(bytes > 0, "offload of an empty request");
+
+    const int64_t offset = alloc_host(bytes, key);
+    if (offset < 0) return false;
+    try {
+        const TensorView packed(host_base_ + offset, DType::UInt8, {bytes}, Device::CPU);
+        kv_gather_slots(caches, slots, packed, slot_dim);
+    } catch (...) {
+        host_.free(offset, bytes);
+        throw;
+    }
+
+    Entry& e = entries_[key];
+    e.tier = KvTier::Host;
+    e.num_tokens = slots.numel();
+    e.bytes = bytes;
+    e.host_offset = offset;
+    e.device_event = caches[0].is_cuda() ? record_device_event(caches[0].stream) : nullptr;
+    touch(key, e);
+    return true;
+}
+
+void KvOffloadEngine::request_prefetch(int64_t key, int32_t priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& e = entry(key);
+    if (e.tier != KvTier::Disk || e.queued) return;
+    e.queued = true;
+    prefetch_queue_.push_back({key, priority, prefetch_order_++});
+}
+
+std::vector<int64_t> KvOffloadEngine::issue_prefetches(int64_t budget_bytes) {
+    std::vector<int64_t> issued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::stable_sort(prefetch_queue_.begin(), prefetch_queue_.end(), [](const Prefetch& a, const Prefetch& b) {
+            return a.priority != b.priority ? a.priority > b.priority : a.order < b.order;
+        });
+        int64_t issued_bytes = 0;
+        std::vector<Prefetch> waiting;
+        for (const Prefetch& p : prefetch_queue_) {
+            auto it = entries_.find(p.key);
+            // restored or dropped since it was queued
+            if (it == entries_.end() || it->second.tier != KvTier::Disk) continue;
+            Entry& e = it->second;
+            const bool over_budget = !issued.empty() && issued_bytes + e.bytes > budget_bytes;
+            const int64_t offset = over_budget ? -1 : alloc_host(e.bytes, p.key);
+            if (offset < 0) {
+                waiting.push_back(p);
+                continue;
+            }
+            e.queued = false;
+            e.host_offset = offset;
+            e.tier = KvTier::Host;
+            e.io_pending = true;
+            e.prefetched = true;
+            touch(p.key, e);
+            io_jobs_.push_back({p.key, host_base_ + offset, disk_base_ + e.disk_offset, e.bytes});
+            issued.push_back(p.key);
+            issued_bytes += e.bytes;
+        }
+        prefetch_queue_.swap(waiting);
+    }
+    if (!issued.empty()) io_cv_.notify_one();
+    return issued;
+}
+
+void KvOffloadEngine::io_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        io_cv_.wait(lock, [this] { return stop_ || !io_jobs_.empty(); });
+        if (io_jobs_.empty()) return;
+        const IoJob job = io_jobs_.front();
+        io_jobs_.pop_front();
+
+        lock.unlock();
+        const auto start = std::chrono::steady_clock::now();
+        std::memcpy(job.dst, job.src, job.bytes);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+
+        io_seconds_ += seconds;
+        io_bytes_ += job.bytes;
+        Entry& e = entries_.at(job.key);
+        disk_.free(e.disk_offset, e.bytes);
+        e.disk_offset = -1;
+        e.io_pending = false;
+        done_cv_.notify_all();
+    }
+}
+
+void KvOffloadEngine::wait_io(Entry& e, std::unique_lock<std::mutex>& lock) {
+    done_cv_.wait(lock, [&] { return !e.io_pending; });
+}
+
+bool KvOffloadEngine::ready(int64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Entry& e = entry(key);
+    return e.tier == KvTier::Host && !e.io_pending
+        && (e.device_event == nullptr || device_event_done(e.device_event));
+}
+
+void KvOffloadEngine::wait(int64_t key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Entry& e = entry(key);
+    wait_io(e, lock);
+    if (e.device_event != nullptr) sync_device_event(e.device_event);
+}
+
+void KvOffloadEngine::restore(
+    int64_t key, const std::vector<TensorView>& caches,
+    const TensorView& slots, int32_t slot_dim
+) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Entry& e = entry(key);
+    LK_CHECK(slots.numel() == e.num_tokens, "key ", key, " holds ", e.num_tokens, " tokens, got ", slots.numel(), " slots");
+    LK_CHECK(slots.numel() * kv_slot_bytes(caches, slot_dim) == e.bytes, "restore with caches of another layout");
+    check_kv_slots("restore", slots, caches[0].size(slot_dim));
+    wait_io(e, lock);
+    if (e.tier == KvTier::Disk) {
+        const int64_t offset = alloc_host(e.bytes, key);
+        if (offset < 0) throw std::runtime_error("restore: no room in the host arena");
+        std::memcpy(host_base_ + offset, disk_base_ + e.disk_offset, e.bytes);
+        disk_.free(e.disk_offset, e.bytes);
+        e.disk_offset = -1;
+        e.host_offset = offset;
+        e.tier = KvTier::Host;
+    }
+    // the gather may have run on another stream
+    if (e.device_event != nullptr) {
+        sync_device_event(e.device_event);
+        destroy_device_event(e.device_event);
+        e.device_event = nullptr;
+    }
+
+    const TensorView packed(host_base_ + e.host_offset, DType::UInt8, {e.bytes}, Device::CPU);
+    kv_scatter_slots(caches, slots, packed, slot_dim);
+    // the scatter reads the range asynchronously, reuse it once it is done
+    release_host(e, caches[0].is_cuda() ? record_device_event(caches[0].stream) : nullptr);
+    entries_.erase(key);
+}
+
+void KvOffloadEngine::drop(int64_t key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Entry& e = entry(key);
+    wait_io(e, lock);
+    if (e.tier == KvTier::Host) {
+        release_host(e, e.device_event);
+    } else if (e.tier == KvTier::Disk) {
+        disk_.free(e.disk_offset, e.bytes);
+    }
+    entries_.erase(key);
+}
+
+KvTier KvOffloadEngine::tier(int64_t key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    return it == entries_.end() ? KvTier::None : it->second.tier;
+}
+
+int64_t KvOffloadEngine::num_tokens(int64_t key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entry(key).num_tokens;
+}
+
+int64_t KvOffloadEngine::host_free_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return host_.free_bytes();
+}
+
+int64_t KvOffloadEngine::disk_free_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return disk_.free_bytes();
+}
+
+double KvOffloadEngine::io_bandwidth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return io_seconds_ > 0.0 ? io_bytes_ / io_seconds_ : 0.0;
+}
+
+} // namespace core
+} // namespace lightllm
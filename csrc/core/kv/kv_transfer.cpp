@@ -0,0 +1,143 @@
+#include "core/kv_transfer.h"
+#include "core/device_util.h"
+
+#include <cstring>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+int64_t buffer_bytes(const TensorView& buffer) { return buffer.numel() * buffer.element_size(); }
+
+// The payload part of a transfer buffer, on the buffer's device.
+TensorView payload_view(const TensorView& buffer, const KvTransferHeader& h) {
+    return TensorView(static_cast<char*>(buffer.data) + h.header_bytes, DType::UInt8, {h.payload_bytes},
+                      buffer.device, buffer.device_index, buffer.stream);
+}
+
+} // namespace
+
+/**
+ * @brief Header of a transfer of num_tokens slots of caches. The row size and
+ * dtype of every cache are recorded so the receiver can reject a buffer
+ * packed from a differently shaped or quantized cache.
+ */
+KvTransferHeader make_kv_transfer_header(
+    const std::vector<TensorView>& caches, const int32_t slot_dim,
+    const int64_t num_tokens, const int64_t tag
+) {
+    LK_CHECK(!caches.empty() && caches.size() <= kMaxKvCopyTensors,
+             "kv transfer takes 1 to ", kMaxKvCopyTensors, " tensors, got ", caches.size());
+    LK_CHECK(slot_dim == 0 || slot_dim == 1, "kv transfer: slot_dim must be 0 or 1");
+    LK_CHECK(num_tokens >= 0, "kv transfer: num_tokens must be >= 0");
+    KvTransferHeader h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = kKvTransferMagic;
+    h.version = kKvTransferVersion;
+    h.header_bytes = static_cast<uint16_t>(kKvTransferHeaderBytes);
+    h.num_tensors = static_cast<int32_t>(caches.size());
+    h.num_tokens = num_tokens;
+    h.layers = slot_dim == 1 ? caches[0].size(0) : 1;
+    h.tag = tag;
+    for (int32_t k = 0; k < h.num_tensors; k++) {
+        h.tensors[k].dtype = static_cast<int32_t>(caches[k].dtype);
+        h.tensors[k].row_bytes = kv_slot_bytes({caches[k]}, slot_dim) / h.layers;
+    }
+    h.payload_bytes = num_tokens * kv_slot_bytes(caches, slot_dim);
+    return h;
+}
+
+KvTransferHeader read_kv_transfer_header(const TensorView& buffer) {
+    LK_CHECK(buffer.is_contiguous(), "kv transfer: the buffer must be contiguous");
+    LK_CHECK(buffer_bytes(buffer) >= kKvTransferHeaderBytes,
+             "kv transfer: the buffer holds ", buffer_bytes(buffer), " bytes, less than a header");
+    KvTransferHeader h;
+    if (buffer.is_cpu()) {
+        std::memcpy(&h, buffer.data, sizeof(h));
+    } else {
+        copy_device_to_host(&h, buffer.data, sizeof(h), buffer.stream);
+    }
+    LK_CHECK(h.magic == kKvTransferMagic, "kv transfer: not a KV transfer buffer (bad magic)");
+    LK_CHECK(h.version == kKvTransferVersion,
+             "kv transfer: buffer version ", h.version, ", this build reads version ", kKvTransferVersion);
+    LK_CHECK(h.header_bytes == kKvTransferHeaderBytes, "kv transfer: unexpected header size ", h.header_bytes);
+    LK_CHECK(h.num_tensors >= 1 && h.num_tensors <= kMaxKvCopyTensors && h.num_tokens >= 0 && h.payload_bytes >= 0,
+             "kv transfer: corrupt header");
+    LK_CHECK(buffer_bytes(buffer) >= kv_transfer_bytes(h), "kv transfer: the buffer holds ", buffer_bytes(buffer),
+             " bytes, the header announces ", kv_transfer_bytes(h));
+    return h;
+}
+
+/**
+ * @brief Pack the rows of a request's slots in all caches (e.g. K, V and their
+ * group scales, all layers) into a transfer buffer: a KvTransferHeader, then
+ * the payload of kv_gather_slots. One launch; on CUDA the kernel also writes
+ * the header, so the buffer can be device memory or pinned host memory that
+ * a transport (NIC, NVLink, socket) sends as is.
+ *
+ * @param caches    See kv_copy_slots.
+ * @param slots     [n] contiguous int32 slots of the request, in token order
+ *                  (e.g. its row of req_to_tokens).
+ * @param slot_dim  0 or 1, see kv_copy_slots.
+ * @param tag       Stored in the header, e.g. the request id.
+ * @param buffer    Contiguous, >= kv_transfer_bytes bytes, 16-byte aligned
+ *                  for CUDA caches.
+ */
+void kv_pack(
+    const std::vector<TensorView>& caches, const TensorView& slots, const int32_t slot_dim,
+    const int64_t tag, const TensorView& buffer
+) {
+    const KvTransferHeader h = make_kv_transfer_header(caches, slot_dim, slots.numel(), tag);
+    LK_CHECK(buffer.is_contiguous() && buffer_bytes(buffer) >= kv_transfer_bytes(h),
+             "kv_pack: the buffer must be contiguous with >= ", kv_transfer_bytes(h), " bytes");
+    const TensorView payload = payload_view(buffer, h);
+    check_kv_pack_args("kv_pack", caches, slots, payload, slot_dim);
+
+    if (caches[0].is_cpu()) {
+        std::memcpy(buffer.data, &h, sizeof(h));
+        std::memset(static_cast<char*>(buffer.data) + sizeof(h), 0, kKvTransferHeaderBytes - sizeof(h));
+        if (slots.numel() > 0) kv_gather_slots_cpu(caches, slots, payload, slot_dim);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    LK_CHECK(reinterpret_cast<uintptr_t>(buffer.data) % 16 == 0, "kv_pack: the buffer must be 16-byte aligned");
+    kv_pack_cuda(caches, slots, slot_dim, h, buffer);
+#else
+    LK_NOT_SUPPORTED("kv_pack: the core library was built without CUDA");
+#endif
+}
+
+/**
+ * @brief Receiving side of kv_pack: validate the header against the local
+ * caches and write the payload into freshly allocated slots, in one launch.
+ * The sender may store its layers differently (slot_dim), rows and dtypes
+ * must match.
+ *
+ * @param slots   [num_tokens] distinct int32 slots, num_tokens from the
+ *                header (see read_kv_transfer_header).
+ * @param buffer  A buffer written by kv_pack, on the host (pinned for CUDA
+ *                caches) or the caches' device. A device buffer costs a
+ *                synchronous header read.
+ */
+void kv_unpack(
+    const std::vector<TensorView>& caches, const TensorView& slots, const int32_t slot_dim,
+    const TensorView& buffer
+) {
+    const KvTransferHeader h = read_kv_transfer_header(buffer);
+    const KvTransferHeader local = make_kv_transfer_header(caches, slot_dim, h.num_tokens, h.tag);
+    LK_CHECK(h.num_tensors == local.num_tensors, "kv_unpack: the buffer holds ", h.num_tensors,
+             " tensors, ", local.num_tensors, " caches were given");
+    LK_CHECK(h.layers == local.layers, "kv_unpack: the buffer holds ", h.layers, " layers, the caches ", local.layers);
+    for (int32_t k = 0; k < h.num_tensors; k++) {
+        LK_CHECK(h.tensors[k].dtype == local.tensors[k].dtype && h.tensors[k].row_bytes == local.tensors[k].row_bytes,
+                 "kv_unpack: tensor ", k, " of the buffer does not match cache ", k, " (dtype or row size)");
+    }
+    LK_CHECK(h.payload_bytes == local.payload_bytes, "kv_unpack: corrupt header (payload size)");
+    LK_CHECK(slots.numel() == h.num_tokens, "kv_unpack: the buffer holds ", h.num_tokens, " tokens, got ",
+             slots.numel(), " slots");
+    kv_scatter_slots(caches, slots, payload_view(buffer, h), slot_dim);
+}
+
+} // namespace core
+} // namespace lightllm
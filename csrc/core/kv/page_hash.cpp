@@ -0,0 +1,161 @@
+#include "core/ops.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+// Keys and primes of XXH3 (first bytes of its default secret).
+constexpr uint64_t kSecret[8] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+};
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+inline uint64_t fold64(const uint64_t a, const uint64_t b) {
+    const __uint128_t p = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(p) ^ static_cast<uint64_t>(p >> 64);
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    return h ^ (h >> 32);
+}
+
+/**
+ * XXH3-style hash of one page of token ids, each id taken as 32 bits so
+ * int32 and int64 ids hash alike. Two ids form a 64-bit word; words go
+ * round robin into 4 independent accumulators (32x32->64 multiply plus the
+ * raw word, as XXH3's accumulate step), which the compiler vectorises.
+ */
+template<typename T>
+uint64_t hash_page(const T* tokens, const int64_t n, const uint64_t seed) {
+    uint64_t acc[4] = {kPrime1 ^ seed, kPrime2 + seed, kSecret[6] ^ seed, kSecret[7] - seed};
+    int64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (int32_t l = 0; l < 4; l++) {
+            const uint64_t word = static_cast<uint32_t>(tokens[i + 2 * l])
+                                | static_cast<uint64_t>(static_cast<uint32_t>(tokens[i + 2 * l + 1])) << 32;
+            const uint64_t key = word ^ kSecret[l];
+            acc[l] += (key & 0xffffffffULL) * (key >> 32) + word;
+        }
+    }
+    for (int32_t l = 0; i < n; i++, l = (l + 1) % 4) {
+        const uint64_t key = static_cast<uint32_t>(tokens[i]) ^ kSecret[l];
+        acc[l] += (key & 0xffffffffULL) * (key >> 32 | 1) + key;
+    }
+    uint64_t h = static_cast<uint64_t>(n) * kPrime1;
+    h += fold64(acc[0] ^ kSecret[4], acc[1] ^ kSecret[5]);
+    h += fold64(acc[2] ^ kSecret[6], acc[3] ^ kSecret[7]);
+    return avalanche(h);
+}
+
+inline uint64_t chain(const uint64_t parent, const uint64_t content, const uint64_t key) {
+    return avalanche(fold64(parent ^ key, content ^ kSecret[3]) + content);
+}
+
+template<typename T>
+void page_hashes_impl(
+    const TensorView& tokens, const TensorView& lens, const int64_t page_size,
+    const uint64_t seed, const TensorView& out
+) {
+    const int64_t B = tokens.size(0);
+    const int64_t max_pages = out.size(1);
+    const int32_t words = static_cast<int32_t>(out.size(2));
+    const T* t = tokens.data_ptr<const T>();
+    uint64_t* o = reinterpret_cast<uint64_t*>(out.data);
+    auto length = [&](int64_t b) {
+        return lens.dtype == DType::Int64 ? lens.data_ptr<const int64_t>()[b]
+                                          : static_cast<int64_t>(lens.data_ptr<const int32_t>()[b]);
+    };
+
+    // Content hashes of all full pages in parallel ...
+    const int64_t grain = std::max<int64_t>(1, 8192 / page_size);
+    parallel_for(0, B * max_pages, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; task++) {
+            const int64_t b = task / max_pages;
+            const int64_t p = task % max_pages;
+            uint64_t* h = o + task * words;
+            if ((p + 1) * page_size > length(b)) {
+                for (int32_t w = 0; w < words; w++) h[w] = 0;
+                continue;
+            }
+            const T* page = t + b * tokens.stride(0) + p * page_size;
+            for (int32_t w = 0; w < words; w++) h[w] = hash_page(page, page_size, seed + w * kSecret[2]);
+        }
+    });
+
+    // ... then chained with the hash of the parent page, a cheap sequential pass per request.
+    parallel_for(0, B, std::max<int64_t>(1, 64 / std::max<int64_t>(max_pages, 1)), [&](int64_t begin, int64_t end) {
+        for (int64_t b = begin; b < end; b++) {
+            const int64_t num_pages = std::min(max_pages, length(b) / page_size);
+            uint64_t parent[2] = {seed, ~seed};
+            for (int64_t p = 0; p < num_pages; p++) {
+                uint64_t* h = o + (b * max_pages + p) * words;
+                if (words == 1) {
+                    h[0] = chain(parent[0], h[0], kSecret[0]);
+                    parent[0] = h[0];
+                } else {
+                    // each half depends on the whole parent
+                    const uint64_t lo = chain(parent[0] ^ (parent[1] >> 1), h[0], kSecret[0]);
+                    const uint64_t hi = chain(parent[1], h[1] ^ parent[0], kSecret[1]);
+                    h[0] = parent[0] = lo;
+                    h[1] = parent[1] = hi;
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+/**
+ * @brief Chained hashes of the full pages of token id sequences, for prefix
+ * cache lookups: hash p of a request covers tokens [0, (p + 1) * page_size),
+ * so two requests share hash p exactly when they share that prefix (up to
+ * collisions). Runs on the core thread pool.
+ *
+ * @param tokens     [B, L] int32 / int64 token ids, rows contiguous (e.g. the
+ *                   token ids laid out like the rows of req_to_tokens).
+ * @param lens       [B] int32 / int64 number of valid tokens per row, <= L.
+ * @param page_size  Tokens per page.
+ * @param seed       Root of every chain, e.g. to separate models / adapters.
+ * @param out        [B, L / page_size, W] int64, W = 1 (64-bit) or 2 (128-bit
+ *                   hashes). Entry [b, p] belongs to the tokens of page p in
+ *                   req_to_tokens row b; pages that are not full are 0.
+ */
+void page_hashes(
+    const TensorView& tokens, const TensorView& lens, const int64_t page_size,
+    const uint64_t seed, const TensorView& out
+) {
+    LK_CHECK(tokens.is_cpu() && lens.is_cpu() && out.is_cpu(), "page_hashes runs on host tensors");
+    LK_CHECK(tokens.dim() == 2 && tokens.stride(1) == 1, "tokens must be [B, L] with contiguous rows");
+    LK_CHECK(tokens.dtype == DType::Int32 || tokens.dtype == DType::Int64, "tokens must be int32 or int64");
+    LK_CHECK(lens.dim() == 1 && lens.size(0) == tokens.size(0) && lens.is_contiguous(), "lens must be [B]");
+    LK_CHECK(lens.dtype == DType::Int32 || lens.dtype == DType::Int64, "lens must be int32 or int64");
+    LK_CHECK(page_size > 0, "page_size must be > 0");
+    LK_CHECK(out.dtype == DType::Int64 && out.dim() == 3 && out.is_contiguous(), "out must be a contiguous 3D int64 tensor");
+    LK_CHECK(out.size(0) == tokens.size(0) && out.size(1) == tokens.size(1) / page_size,
+             "out must be [B, L / page_size, W]");
+    LK_CHECK(out.size(2) == 1 || out.size(2) == 2, "out must hold 64-bit (W = 1) or 128-bit (W = 2) hashes");
+    for (int64_t b = 0; b < lens.size(0); b++) {
+        const int64_t len = lens.dtype == DType::Int64 ? lens.data_ptr<const int64_t>()[b]
+                                                       : lens.data_ptr<const int32_t>()[b];
+        LK_CHECK(len >= 0 && len <= tokens.size(1), "lens[", b, "] = ", len, " is out of [0, ", tokens.size(1), "]");
+    }
+    if (out.numel() == 0) return;
+
+    if (tokens.dtype == DType::Int64) {
+        page_hashes_impl<int64_t>(tokens, lens, page_size, seed, out);
+    } else {
+        page_hashes_impl<int32_t>(tokens, lens, page_size, seed, out);
+    }
+}
+
+} // namespace core
+} // namespace lightllm
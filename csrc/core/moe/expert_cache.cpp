@@ -0,0 +1,275 @@
+#include "core/expert_cache.h"
+#include "core/device_util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+
+namespace lightllm {
+namespace core {
+
+ExpertCache::ExpertCache(const TensorView& host_weights, const TensorView& pool, const ExpertCacheOptions& options)
+    : options_(options) {
+    LK_CHECK(host_weights.is_cpu() && host_weights.dim() == 3 && host_weights.is_contiguous(),
+             "host_weights must be a contiguous [L, E, B] host tensor");
+    LK_CHECK(pool.dim() == 2 && pool.is_contiguous(), "pool must be a contiguous [S, B] tensor");
+    LK_CHECK(host_weights.dtype == DType::UInt8 && pool.dtype == DType::UInt8, "host_weights and pool must be uint8");
+    LK_CHECK(pool.size(1) == host_weights.size(2), "a pool slot must hold B bytes, one expert");
+    LK_CHECK(pool.size(0) > 0, "pool must have at least one slot");
+    LK_CHECK(options.prefetch_per_layer >= 0, "prefetch_per_layer must be >= 0");
+    LK_CHECK(options.decay > 0.0f && options.decay <= 1.0f, "decay must be in (0, 1]");
+    num_layers_ = static_cast<int32_t>(host_weights.size(0));
+    num_experts_ = static_cast<int32_t>(host_weights.size(1));
+    expert_bytes_ = host_weights.size(2);
+    host_base_ = static_cast<const char*>(host_weights.data);
+    pool_base_ = static_cast<char*>(pool.data);
+    pool_cuda_ = pool.is_cuda();
+    pool_stream_ = pool.stream;
+
+    const int64_t keys = static_cast<int64_t>(num_layers_) * num_experts_;
+    slots_.resize(pool.size(0));
+    slot_of_.assign(keys, -1);
+    use_.assign(keys, 0.0f);
+    transitions_.assign(keys * num_experts_, 0.0f);
+    if (!pool_cuda_) copy_stream_.reset(new CpuStream());
+}
+
+ExpertCache::~ExpertCache() {
+    for (Slot& s : slots_) {
+        if (s.device_event == nullptr) continue;
+        sync_device_event(s.device_event);
+        destroy_device_event(s.device_event);
+    }
+    // copy_stream_ drains its copies before the pool goes away
+}
+
+bool ExpertCache::copy_done(Slot& s) {
+    if (s.host_event && s.host_event->query()) s.host_event.reset();
+    if (s.device_event != nullptr && device_event_done(s.device_event)) {
+        destroy_device_event(s.device_event);
+        s.device_event = nullptr;
+    }
+    return !s.host_event && s.device_event == nullptr;
+}
+
+void ExpertCache::wait_copy(Slot& s) {
+    if (s.host_event) {
+        s.host_event->synchronize();
+        s.host_event.reset();
+    }
+    if (s.device_event != nullptr) {
+        sync_device_event(s.device_event);
+        destroy_device_event(s.device_event);
+        s.device_event = nullptr;
+    }
+}
+
+/**
+ * Free slot, or the one of the victim of the eviction policy. The experts of
+ * the current layer and the prefetched experts of the next one stay. Returns
+ * -1 if every slot is protected.
+ */
+int32_t ExpertCache::alloc_slot(const int32_t layer) {
+    const int32_t next = (layer + 1) % num_layers_;
+    int32_t victim = -1;
+    for (int32_t i = 0; i < num_slots(); i++) {
+        const Slot& s = slots_[i];
+        if (s.key < 0) return i;
+        const int32_t l = s.key / num_experts_;
+        if (l == layer || (s.prefetched && l == next)) continue;
+        if (victim < 0) {
+            victim = i;
+            continue;
+        }
+        const Slot& v = slots_[victim];
+        const bool better = options_.eviction == ExpertEviction::Lfu
+            ? use_[s.key] < use_[v.key] || (use_[s.key] == use_[v.key] && s.last_use < v.last_use)
+            : s.last_use < v.last_use;
+        if (better) victim = i;
+    }
+    if (victim < 0) return -1;
+    Slot& v = slots_[victim];
+    // a copy still writing the slot must land before the next one is issued
+    wait_copy(v);
+    slot_of_[v.key] = -1;
+    v.key = -1;
+    v.prefetched = false;
+    stats_.evictions++;
+    return victim;
+}
+
+// Starts the copy of an expert into a slot, -1 if there is no slot for it.
+int32_t ExpertCache::load(const int32_t layer, const int32_t expert, const bool prefetched) {
+    const int32_t key = layer * num_experts_ + expert;
+    if (slot_of_[key] >= 0) return slot_of_[key];
+    const int32_t i = alloc_slot(prefetched ? (layer + num_layers_ - 1) % num_layers_ : layer);
+    if (i < 0) return -1;
+    Slot& s = slots_[i];
+    char* dst = pool_base_ + static_cast<int64_t>(i) * expert_bytes_;
+    const char* src = host_base_ + static_cast<int64_t>(key) * expert_bytes_;
+    const int64_t bytes = expert_bytes_;
+    if (pool_cuda_) {
+        copy_host_to_device_async(dst, src, bytes, pool_stream_);
+        s.device_event = record_device_event(pool_stream_);
+    } else {
+        copy_stream_->enqueue([dst, src, bytes] { std::memcpy(dst, src, bytes); });
+        s.host_event = copy_stream_->record();
+    }
+    s.key = key;
+    s.last_use = tick_;
+    s.prefetched = prefetched;
+    slot_of_[key] = i;
+    stats_.bytes_copied += bytes;
+    if (prefetched) stats_.prefetches++;
+    return i;
+}
+
+// Counts, per token, expert e of the previous layer followed by expert e' of this one.
+void ExpertCache::learn(const int32_t layer, const int32_t* ids, const fp32_t*, const int64_t T, const int64_t K) {
+    if (prev_layer_ < 0 || (prev_layer_ + 1) % num_layers_ != layer || prev_T_ != T) return;
+    fp32_t* trans = transitions_.data() + static_cast<int64_t>(prev_layer_) * num_experts_ * num_experts_;
+    for (int64_t t = 0; t < T; t++) {
+        for (int64_t a = 0; a < prev_K_; a++) {
+            fp32_t* row = trans + static_cast<int64_t>(prev_ids_[t * prev_K_ + a]) * num_experts_;
+            for (int64_t b = 0; b < K; b++) row[ids[t * K + b]] += 1.0f;
+        }
+    }
+}
+
+/**
+ * Scores the experts of the next layer by
+ *   sum over (t, k) of weights[t, k] * P(e' | ids[t, k]) + eps * prior[e'] / max(prior)
+ * with P the learned transition frequencies and prior the decayed use counts
+ * of the next layer, then prefetches the best ones. The prior only breaks ties
+ * and covers the experts with no transitions learned yet.
+ */
+void ExpertCache::predict(const int32_t layer, const int32_t* ids, const fp32_t* weights, const int64_t T,
+                          const int64_t K) {
+    const int32_t next = (layer + 1) % num_layers_;
+    const int32_t E = num_experts_;
+    std::vector<fp32_t> score(E, 0.0f);
+    const fp32_t* trans = transitions_.data() + static_cast<int64_t>(layer) * E * E;
+    std::vector<fp32_t> row_sum(E, -1.0f);
+    for (int64_t i = 0; i < T * K; i++) {
+        const int32_t e = ids[i];
+        const fp32_t* row = trans + static_cast<int64_t>(e) * E;
+        if (row_sum[e] < 0.0f) row_sum[e] = std::accumulate(row, row + E, 0.0f);
+        if (row_sum[e] == 0.0f) continue;
+        const fp32_t w = weights[i] / row_sum[e];
+        for (int32_t n = 0; n < E; n++) score[n] += w * row[n];
+    }
+    const fp32_t* prior = use_.data() + static_cast<int64_t>(next) * E;
+    const fp32_t prior_max = *std::max_element(prior, prior + E);
+    if (prior_max > 0.0f) {
+        for (int32_t n = 0; n < E; n++) score[n] += 1e-3f * prior[n] / prior_max;
+    }
+
+    std::vector<int32_t> order(E);
+    std::iota(order.begin(), order.end(), 0);
+    const int32_t count = std::min(options_.prefetch_per_layer, E);
+    std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                      [&](int32_t a, int32_t b) { return score[a] > score[b]; });
+    order.resize(count);
+    // the ones with no evidence are not worth a copy
+    order.erase(std::remove_if(order.begin(), order.end(), [&](int32_t e) { return score[e] <= 0.0f; }), order.end());
+    prefetch(next, order);
+}
+
+void ExpertCache::access(const int32_t layer, const TensorView& topk_ids, const TensorView& topk_weights,
+                         const TensorView& residency) {
+    LK_CHECK(layer >= 0 && layer < num_layers_, "layer ", layer, " is out of [0, ", num_layers_, ")");
+    LK_CHECK(topk_ids.is_cpu() && topk_ids.is_contiguous() && topk_ids.dim() == 2 && topk_ids.dtype == DType::Int32,
+             "topk_ids must be a contiguous [T, K] int32 host tensor");
+    const int64_t T = topk_ids.size(0);
+    const int64_t K = topk_ids.size(1);
+    LK_CHECK(topk_weights.is_cpu() && topk_weights.is_contiguous() && topk_weights.dtype == DType::Float32 &&
+             topk_weights.numel() == T * K, "topk_weights must be a contiguous [T, K] fp32 host tensor");
+    LK_CHECK(residency.is_cpu() && residency.is_contiguous() && residency.dtype == DType::Int32 &&
+             residency.numel() == num_experts_, "residency must be a contiguous [E] int32 host tensor");
+    const int32_t* ids = topk_ids.data_ptr<const int32_t>();
+    const fp32_t* weights = topk_weights.data_ptr<const fp32_t>();
+    for (int64_t i = 0; i < T * K; i++) {
+        LK_CHECK(ids[i] >= 0 && ids[i] < num_experts_, "topk_ids holds expert ", ids[i], ", out of [0, ",
+                 num_experts_, ")");
+    }
+
+    tick_++;
+    // one decay per step, at its first layer
+    if (layer == 0) {
+        for (fp32_t& u : use_) u *= options_.decay;
+    }
+    learn(layer, ids, weights, T, K);
+
+    std::vector<char> routed(num_experts_, 0);
+    for (int64_t i = 0; i < T * K; i++) routed[ids[i]] = 1;
+    const int32_t base = layer * num_experts_;
+    std::vector<int32_t> wait;
+    for (int32_t e = 0; e < num_experts_; e++) {
+        if (!routed[e]) continue;
+        use_[base + e] += 1.0f;
+        int32_t i = slot_of_[base + e];
+        if (i >= 0) {
+            Slot& s = slots_[i];
+            stats_.hits++;
+            if (s.prefetched) stats_.useful_prefetches++;
+            if (!copy_done(s)) stats_.late_prefetches++;
+            s.prefetched = false;
+            s.last_use = tick_;
+            // without fetch_misses a copy in flight is reported as not resident, the caller runs it elsewhere
+            if (options_.fetch_misses) wait.push_back(i);
+            continue;
+        }
+        stats_.misses++;
+        i = load(layer, e, false);
+        if (i >= 0 && options_.fetch_misses) wait.push_back(i);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    bool stalled = false;
+    for (const int32_t i : wait) {
+        if (copy_done(slots_[i])) continue;
+        wait_copy(slots_[i]);
+        stalled = true;
+    }
+    if (stalled) {
+        stats_.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    int32_t* res = residency.data_ptr<int32_t>();
+    for (int32_t e = 0; e < num_experts_; e++) {
+        const int32_t i = slot_of_[base + e];
+        res[e] = i >= 0 && copy_done(slots_[i]) ? i : -1;
+    }
+
+    prev_ids_.assign(ids, ids + T * K);
+    prev_layer_ = layer;
+    prev_T_ = T;
+    prev_K_ = K;
+    if (options_.prefetch_per_layer > 0) predict(layer, ids, weights, T, K);
+}
+
+int32_t ExpertCache::prefetch(const int32_t layer, const std::vector<int32_t>& experts) {
+    LK_CHECK(layer >= 0 && layer < num_layers_, "layer ", layer, " is out of [0, ", num_layers_, ")");
+    int32_t started = 0;
+    for (const int32_t e : experts) {
+        LK_CHECK(e >= 0 && e < num_experts_, "expert ", e, " is out of [0, ", num_experts_, ")");
+        if (slot_of_[layer * num_experts_ + e] >= 0) continue;
+        if (load(layer, e, true) < 0) break;
+        started++;
+    }
+    return started;
+}
+
+int32_t ExpertCache::slot(const int32_t layer, const int32_t expert) const {
+    LK_CHECK(layer >= 0 && layer < num_layers_ && expert >= 0 && expert < num_experts_,
+             "(layer, expert) out of range");
+    return slot_of_[layer * num_experts_ + expert];
+}
+
+void ExpertCache::synchronize() {
+    for (Slot& s : slots_) wait_copy(s);
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,209 @@
+#include "core/ops.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+constexpr fp32_t kFp8E4M3Max = 448.0f;
+
+// Dynamic per token quantization of [n, K] fp32 rows into the operand dtype of the expert weights.
+void quantize_rows(const fp32_t* x, const int64_t n, const int64_t K, const DType dtype, void* q, fp32_t* scales) {
+    const CpuKernels& kernels = cpu_kernels();
+    parallel_for(0, n, std::max<int64_t>(1, 16384 / std::max<int64_t>(K, 1)), [&](int64_t begin, int64_t end) {
+        for (int64_t r = begin; r < end; r++) {
+            const fp32_t* row = x + r * K;
+            const fp32_t amax = kernels.absmax(row, K);
+            if (dtype == DType::Fp8E4M3) {
+                scales[r] = amax / kFp8E4M3Max;
+                kernels.float_to_fp8(row, 1.0f / (scales[r] + 1e-7f), static_cast<host_fp8_e4m3_t*>(q) + r * K, K);
+            } else {
+                scales[r] = amax / 127.0f;
+                const fp32_t inv = amax > 0.0f ? 127.0f / amax : 0.0f;
+                kernels.float_to_int8(row, inv, static_cast<int8_t*>(q) + r * K, K);
+            }
+        }
+    });
+}
+
+} // namespace
+
+/**
+ * @brief Splits the routing of a MoE layer between device and host experts.
+ *
+ * @param topk_ids        [T, K] int32 experts of every token, from grouped_topk.
+ * @param topk_weights    [T, K] fp32 routing weights.
+ * @param residency       [E] int32, the slot of expert e in the device weights
+ *                        or -1 when it runs on the CPU.
+ * @param device_ids      [T, K] int32 output, the device slot of (t, k) or -1
+ *                        when it went to the CPU.
+ * @param device_weights  [T, K] fp32 output, the weight of (t, k) or 0 when it
+ *                        went to the CPU.
+ * @param cpu_offsets     [E + 1] int32 output, rows [cpu_offsets[e],
+ *                        cpu_offsets[e + 1]) of cpu_tokens / cpu_weights
+ *                        belong to expert e (none for device experts).
+ * @param cpu_tokens      [>= T * K] int32 output, token of every CPU row.
+ * @param cpu_weights     [>= T * K] fp32 output, routing weight of every CPU row.
+ * @return                Number of CPU rows.
+ */
+int64_t hybrid_moe_partition(
+    const TensorView& topk_ids, const TensorView& topk_weights, const TensorView& residency,
+    const TensorView& device_ids, const TensorView& device_weights,
+    const TensorView& cpu_offsets, const TensorView& cpu_tokens, const TensorView& cpu_weights
+) {
+    for (const TensorView* t : {&topk_ids, &topk_weights, &residency, &device_ids, &device_weights,
+                                &cpu_offsets, &cpu_tokens, &cpu_weights}) {
+        LK_CHECK(t->is_cpu() && t->is_contiguous(), "hybrid_moe_partition runs on contiguous host tensors");
+    }
+    LK_CHECK(topk_ids.dim() == 2 && topk_ids.dtype == DType::Int32, "topk_ids must be [T, K] int32");
+    const int64_t T = topk_ids.size(0);
+    const int64_t K = topk_ids.size(1);
+    const int64_t E = residency.numel();
+    LK_CHECK(residency.dtype == DType::Int32, "residency must be [E] int32");
+    LK_CHECK(topk_weights.dtype == DType::Float32 && topk_weights.numel() == T * K, "topk_weights must be [T, K] fp32");
+    LK_CHECK(device_ids.dtype == DType::Int32 && device_ids.numel() == T * K, "device_ids must be [T, K] int32");
+    LK_CHECK(device_weights.dtype == DType::Float32 && device_weights.numel() == T * K,
+             "device_weights must be [T, K] fp32");
+    LK_CHECK(cpu_offsets.dtype == DType::Int32 && cpu_offsets.numel() == E + 1, "cpu_offsets must be [E + 1] int32");
+    LK_CHECK(cpu_tokens.dtype == DType::Int32 && cpu_tokens.numel() >= T * K, "cpu_tokens must hold T * K int32");
+    LK_CHECK(cpu_weights.dtype == DType::Float32 && cpu_weights.numel() >= T * K, "cpu_weights must hold T * K fp32");
+
+    const int32_t* ids = topk_ids.data_ptr<const int32_t>();
+    const fp32_t* weights = topk_weights.data_ptr<const fp32_t>();
+    const int32_t* slot_of = residency.data_ptr<const int32_t>();
+    int32_t* dev_ids = device_ids.data_ptr<int32_t>();
+    fp32_t* dev_weights = device_weights.data_ptr<fp32_t>();
+    int32_t* offsets = cpu_offsets.data_ptr<int32_t>();
+    // counting sort of the CPU rows by expert, tokens stay ascending within an expert
+    std::fill(offsets, offsets + E + 1, 0);
+    for (int64_t i = 0; i < T * K; i++) {
+        const int32_t e = ids[i];
+        LK_CHECK(e >= 0 && e < E, "topk_ids[", i / K, ", ", i % K, "] = ", e, " is out of [0, ", E, ")");
+        const int32_t slot = slot_of[e];
+        dev_ids[i] = slot;
+        dev_weights[i] = slot >= 0 ? weights[i] : 0.0f;
+        if (slot < 0) offsets[e + 1]++;
+    }
+    for (int64_t e = 0; e < E; e++) offsets[e + 1] += offsets[e];
+    std::vector<int32_t> fill(offsets, offsets + E);
+    int32_t* tokens = cpu_tokens.data_ptr<int32_t>();
+    fp32_t* cpu_w = cpu_weights.data_ptr<fp32_t>();
+    for (int64_t i = 0; i < T * K; i++) {
+        if (dev_ids[i] >= 0) continue;
+        const int32_t r = fill[ids[i]]++;
+        tokens[r] = static_cast<int32_t>(i / K);
+        cpu_w[r] = weights[i];
+    }
+    return offsets[E];
+}
+
+/**
+ * @brief Host expert FFNs of the CPU rows of hybrid_moe_partition:
+ *   out[t] = sum over the rows r of token t of cpu_weights[r] * w2 @ (silu(g) * u),
+ *   [g, u] = w13 @ x[t]
+ * with the scaled GEMMs of scaled_mm. The activations are quantized per token
+ * to the dtype of the expert weights, as the device W8A8 experts do.
+ *
+ * @param out         [T, H] fp32, rows without CPU rows are zeroed.
+ * @param x           [T, H] bf16 / fp16 / fp32 with contiguous rows.
+ * @param w13         Per expert [H, 2I] int8 / fp8_e4m3 column major (the b of
+ *                    cutlass_scaled_mm), gate rows first. Only experts with
+ *                    CPU rows are read, the others may be empty views.
+ * @param w13_scales  Per expert fp32 [2I] per channel or [1] scales.
+ * @param w2          Per expert [I, H] column major, dtype of w13.
+ * @param w2_scales   Per expert fp32 [H] or [1] scales.
+ */
+void moe_cpu_experts(
+    const TensorView& out, const TensorView& x, const TensorView& cpu_offsets,
+    const TensorView& cpu_tokens, const TensorView& cpu_weights,
+    const std::vector<TensorView>& w13, const std::vector<TensorView>& w13_scales,
+    const std::vector<TensorView>& w2, const std::vector<TensorView>& w2_scales
+) {
+    for (const TensorView* t : {&out, &x, &cpu_offsets, &cpu_tokens, &cpu_weights}) {
+        LK_CHECK(t->is_cpu(), "moe_cpu_experts runs on host tensors");
+    }
+    LK_CHECK(out.dim() == 2 && out.dtype == DType::Float32 && out.is_contiguous(),
+             "out must be contiguous [T, H] fp32");
+    LK_CHECK(x.dim() == 2 && x.size(0) == out.size(0) && x.size(1) == out.size(1) && x.stride(1) == 1,
+             "x must be [T, H] with contiguous rows");
+    LK_CHECK(x.dtype == DType::BFloat16 || x.dtype == DType::Float16 || x.dtype == DType::Float32,
+             "x must be bf16, fp16 or fp32, got ", dtype_name(x.dtype));
+    const int64_t E = static_cast<int64_t>(w13.size());
+    LK_CHECK(w13_scales.size() == w13.size() && w2.size() == w13.size() && w2_scales.size() == w13.size(),
+             "moe_cpu_experts takes w13, w13_scales, w2 and w2_scales of every expert");
+    LK_CHECK(cpu_offsets.dtype == DType::Int32 && cpu_offsets.is_contiguous() && cpu_offsets.numel() == E + 1,
+             "cpu_offsets must be [E + 1] int32");
+    const int32_t* offsets = cpu_offsets.data_ptr<const int32_t>();
+    LK_CHECK(cpu_tokens.dtype == DType::Int32 && cpu_tokens.is_contiguous() && cpu_tokens.numel() >= offsets[E],
+             "cpu_tokens must be int32 and hold every CPU row");
+    LK_CHECK(cpu_weights.dtype == DType::Float32 && cpu_weights.is_contiguous() && cpu_weights.numel() >= offsets[E],
+             "cpu_weights must be fp32 and hold every CPU row");
+
+    const int64_t T = x.size(0);
+    const int64_t H = x.size(1);
+    const int32_t* tokens = cpu_tokens.data_ptr<const int32_t>();
+    const fp32_t* weights = cpu_weights.data_ptr<const fp32_t>();
+    const CpuKernels& kernels = cpu_kernels();
+    std::fill(out.data_ptr<fp32_t>(), out.data_ptr<fp32_t>() + T * H, 0.0f);
+
+    std::vector<fp32_t> xs, gu, h, y, a_s;
+    std::vector<int8_t> a8;
+    for (int64_t e = 0; e < E; e++) {
+        const int64_t n = offsets[e + 1] - offsets[e];
+        LK_CHECK(offsets[e] >= 0 && n >= 0, "cpu_offsets must be ascending from 0");
+        if (n == 0) continue;
+        const TensorView& wa = w13[e];
+        const TensorView& wb = w2[e];
+        LK_CHECK(wa.dim() == 2 && wa.size(0) == H && wa.size(1) % 2 == 0, "w13 of expert ", e, " must be [H, 2I]");
+        const int64_t I = wa.size(1) / 2;
+        LK_CHECK(wb.dim() == 2 && wb.size(0) == I && wb.size(1) == H, "w2 of expert ", e, " must be [I, H]");
+        LK_CHECK(wa.is_cpu() && wb.is_cpu(), "moe_cpu_experts reads host expert weights");
+        const int32_t* rows = tokens + offsets[e];
+
+        // gather the tokens of the expert
+        xs.resize(n * H);
+        for (int64_t r = 0; r < n; r++) {
+            const int64_t t = rows[r];
+            LK_CHECK(t >= 0 && t < T, "cpu_tokens holds token ", t, ", out of [0, ", T, ")");
+            fp32_t* dst = xs.data() + r * H;
+            const int64_t at = t * x.stride(0);
+            switch (x.dtype) {
+                case DType::BFloat16: kernels.bf16_to_float(x.data_ptr<const host_bf16_t>() + at, dst, H); break;
+                case DType::Float16: kernels.fp16_to_float(x.data_ptr<const host_fp16_t>() + at, dst, H); break;
+                default: std::copy_n(x.data_ptr<const fp32_t>() + at, H, dst); break;
+            }
+        }
+
+        // gate / up projection and SiLU
+        a8.resize(n * std::max(H, I));
+        a_s.resize(n);
+        quantize_rows(xs.data(), n, H, wa.dtype, a8.data(), a_s.data());
+        gu.resize(n * 2 * I);
+        scaled_mm(TensorView(gu.data(), DType::Float32, {n, 2 * I}), TensorView(a8.data(), wa.dtype, {n, H}), wa,
+                  TensorView(a_s.data(), DType::Float32, {n}), w13_scales[e], TensorView(), TensorView());
+        h.resize(n * I);
+        for (int64_t r = 0; r < n; r++) {
+            const fp32_t* g = gu.data() + r * 2 * I;
+            for (int64_t i = 0; i < I; i++) h[r * I + i] = g[i] / (1.0f + std::exp(-g[i])) * g[I + i];
+        }
+
+        // down projection, weighted into the rows of the tokens
+        quantize_rows(h.data(), n, I, wb.dtype, a8.data(), a_s.data());
+        y.resize(n * H);
+        scaled_mm(TensorView(y.data(), DType::Float32, {n, H}), TensorView(a8.data(), wb.dtype, {n, I}), wb,
+                  TensorView(a_s.data(), DType::Float32, {n}), w2_scales[e], TensorView(), TensorView());
+        for (int64_t r = 0; r < n; r++) {
+            kernels.axpy(weights[offsets[e] + r], y.data() + r * H, out.data_ptr<fp32_t>() + rows[r] * H, H);
+        }
+    }
+}
+
+} // namespace core
+} // namespace lightllm
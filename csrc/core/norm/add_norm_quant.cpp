@@ -0,0 +1,119 @@
+#include "core/ops.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+constexpr fp32_t kFp8E4M3Max = 448.0f;
+
+void add_norm_quant_rows(
+    host_bf16_t* X, const host_bf16_t* R, const host_bf16_t* W, void* Y, fp32_t* scales,
+    const bool fp8, const int64_t begin, const int64_t end, const int64_t N, const fp32_t eps
+) {
+    const CpuKernels& k = cpu_kernels();
+    const fp32_t r_N = 1 / (fp32_t)N;
+    // [N] weight, [N] residual, [N] h = bf16(x + r), [N] h * w in fp32
+    std::vector<fp32_t> scratch(4 * N);
+    fp32_t* w = scratch.data();
+    fp32_t* r = w + N;
+    fp32_t* h = r + N;
+    fp32_t* hw = h + N;
+    k.bf16_to_float(W, w, N);
+    for (int64_t row = begin; row < end; row++) {
+        host_bf16_t* x = X + row * N;
+        k.bf16_to_float(x, h, N);
+        k.bf16_to_float(R + row * N, r, N);
+        k.axpy(1.0f, r, h, N);
+        // the sum is stored in bf16, the statistics use the rounded values the row keeps
+        k.float_to_bf16(h, x, N);
+        k.bf16_to_float(x, h, N);
+        k.scale_mul(h, 1.0f, w, hw, N);
+
+        const fp32_t inv_norm = 1.0f / std::sqrt(k.sum_squares(h, N) * r_N + eps);
+        const fp32_t amax = k.absmax(hw, N);
+        if (fp8) {
+            const fp32_t scale = amax * inv_norm / kFp8E4M3Max;
+            k.float_to_fp8(hw, inv_norm / (scale + 1e-7f), static_cast<host_fp8_e4m3_t*>(Y) + row * N, N);
+            scales[row] = scale;
+        } else {
+            // inv_norm cancels out of the int8 values, only the scale needs it
+            scales[row] = amax * inv_norm / 127.0f;
+            k.float_to_int8(hw, amax > 0.0f ? 127.0f / amax : 0.0f, static_cast<int8_t*>(Y) + row * N, N);
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Host add_norm_quant, chunks of rows run on the core thread pool with
+ * the kernels of the active CPU instruction set.
+ */
+void add_norm_quant_cpu(
+    const TensorView& X, const TensorView& R, const TensorView& W,
+    const TensorView& Y, const TensorView& scales, const fp32_t eps
+) {
+    const int64_t M = X.size(0);
+    const int64_t N = X.size(1);
+    const bool fp8 = Y.dtype == DType::Fp8E4M3;
+    const int64_t grain = std::max<int64_t>(1, 32768 / std::max<int64_t>(N, 1));
+    parallel_for(0, M, grain, [&](int64_t begin, int64_t end) {
+        add_norm_quant_rows(
+            X.data_ptr<host_bf16_t>(), R.data_ptr<const host_bf16_t>(), W.data_ptr<const host_bf16_t>(),
+            Y.data, scales.data_ptr<fp32_t>(), fp8, begin, end, N, eps
+        );
+    });
+}
+
+/**
+ * @brief Fused residual add, RMSNorm and per-token quantization, see ops.h.
+ *
+ * @param X       [M, N] bf16 input, receives X + R.
+ * @param R       [M, N] bf16 residual.
+ * @param W       [N] bf16 RMSNorm weight.
+ * @param Y       [M, N] fp8_e4m3 or int8 (CPU only) output.
+ * @param scales  M fp32 per-token scales, Y[m] * scales[m] ~= rmsnorm(X[m]) * W.
+ * @param eps     Epsilon for numerical stability.
+ */
+void add_norm_quant(
+    const TensorView& X, const TensorView& R, const TensorView& W,
+    const TensorView& Y, const TensorView& scales, const fp32_t eps
+) {
+    LK_CHECK(X.dim() == 2 && R.dim() == 2 && Y.dim() == 2 && W.dim() == 1,
+             "add_norm_quant expects X, R, Y [M, N] and W [N]");
+    LK_CHECK(X.is_contiguous() && R.is_contiguous() && W.is_contiguous() && Y.is_contiguous(),
+             "add_norm_quant expects contiguous tensors");
+    LK_CHECK(X.size(0) == R.size(0) && X.size(1) == R.size(1) && X.size(0) == Y.size(0)
+             && X.size(1) == Y.size(1) && X.size(1) == W.size(0), "add_norm_quant shape mismatch");
+    LK_CHECK(X.dtype == DType::BFloat16 && R.dtype == DType::BFloat16 && W.dtype == DType::BFloat16,
+             "add_norm_quant expects bf16 X, R and W");
+    LK_CHECK(Y.dtype == DType::Fp8E4M3 || Y.dtype == DType::Int8, "add_norm_quant: Y must be fp8_e4m3 or int8");
+    LK_CHECK(scales.dtype == DType::Float32 && scales.is_contiguous() && scales.numel() == X.size(0),
+             "add_norm_quant: scales must be a contiguous fp32 [M] or [M, 1] tensor");
+    for (const TensorView* t : {&R, &W, &Y, &scales}) {
+        LK_CHECK(t->device == X.device && t->device_index == X.device_index,
+                 "add_norm_quant expects tensors on the same device");
+    }
+    if (X.size(0) == 0) return;
+
+    if (X.device == Device::CPU) {
+        add_norm_quant_cpu(X, R, W, Y, scales, eps);
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    add_norm_quant_cuda(X, R, W, Y, scales, eps);
+#else
+    LK_NOT_SUPPORTED("add_norm_quant: the core library was built without CUDA");
+#endif
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,196 @@
+#include "core/ops.h"
+#include "reduce/sm70.cuh"
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+namespace {
+
+constexpr fp32_t kFp8E4M3Max = 448.0f;
+
+/**
+ * @brief add_norm_quant of one row per block, for N % 8 == 0.
+ *
+ * The first pass adds the residual, stores h = bf16(x + r) back to X and
+ * accumulates (sum h^2, max|h * w|); one sync_block_reduce_sum_max_f32 gives
+ * both statistics, as the absmax of the normalized row is inv_norm * max|h * w|.
+ * The second pass quantizes h * w straight from fp32. The first ITEMS vectors
+ * of every thread stay in registers between the passes, the rest of a longer
+ * row is read back from X (written by the same thread, so no barrier), and no
+ * shared memory is used besides the reduction.
+ */
+template<int32_t TPB, int32_t ITEMS>
+__global__ void device_add_norm_quant_bf16_fp8(
+    bf16_t* __restrict__ X,            // [M, N] input, receives x + r
+    const bf16_t* __restrict__ R,      // [M, N] residual
+    const bf16_t* __restrict__ W,      // [N] weight
+    fp8_e4m3_t* __restrict__ Y,        // [M, N] output
+    fp32_t* __restrict__ scales,       // [M] per-token scales
+    const int32_t N,
+    const fp32_t eps
+) {
+    constexpr int32_t VPT = 8;
+    const fp32_t r_N = 1 / (fp32_t)N;
+
+    const int32_t tid = threadIdx.x;
+    const int64_t bid = blockIdx.x;
+
+    bf16_t* _X = X + bid * N;
+    const bf16_t* _R = R + bid * N;
+    fp8_e4m3_t* _Y = Y + bid * N;
+
+    bf16x2_t local_h[ITEMS][VPT / 2];
+    bf16x2_t local_x[VPT / 2];  // vectors past the register part of the row
+    bf16x2_t local_r[VPT / 2];
+    bf16x2_t local_w[VPT / 2];
+    fp8x4_e4m3_t local_f8[VPT / 4];
+
+    // (sum of h^2, max of |h * w|) of this thread
+    fp32x2_t stats = make_float2(0.0f, 0.0f);
+    auto add_residual = [&](bf16x2_t* h, const int32_t i) {
+        vec_copy<sizeof(bf16_t) * VPT>(_X + i, h);
+        vec_copy<sizeof(bf16_t) * VPT>(_R + i, local_r);
+        vec_copy<sizeof(bf16_t) * VPT>(W + i, local_w);
+        #pragma unroll
+        for (int32_t j = 0; j < VPT / 2; j++) {
+            const fp32x2_t x = bf16x2_to_fp32x2(h[j]);
+            const fp32x2_t r = bf16x2_to_fp32x2(local_r[j]);
+            h[j] = _float22bf162_rn(make_float2(x.x + r.x, x.y + r.y));
+
+            const fp32x2_t v = bf16x2_to_fp32x2(h[j]);
+            const fp32x2_t w = bf16x2_to_fp32x2(local_w[j]);
+            stats.x += v.x * v.x + v.y * v.y;
+            stats.y = fmaxf(stats.y, fmaxf(fabsf(v.x * w.x), fabsf(v.y * w.y)));
+        }
+        vec_copy<sizeof(bf16_t) * VPT>(h, _X + i);
+    };
+
+    #pragma unroll
+    for (int32_t it = 0; it < ITEMS; it++) {
+        const int32_t i = (it * TPB + tid) * VPT;
+        if (i < N) add_residual(local_h[it], i);
+    }
+    for (int32_t i = (ITEMS * TPB + tid) * VPT; i < N; i += TPB * VPT) {
+        add_residual(local_x, i);
+    }
+
+    stats = lightllm::reduce::sm70::sync_block_reduce_sum_max_f32<TPB>(stats);
+
+    const fp32_t inv_norm = rsqrtf(stats.x * r_N + eps);
+    const fp32_t scale = stats.y * inv_norm / kFp8E4M3Max;
+    // maps h * w onto the fp8 grid
+    const fp32_t q = inv_norm / (scale + 1e-7f);
+
+    auto quantize = [&](const bf16x2_t* h, const int32_t i) {
+        vec_copy<sizeof(bf16_t) * VPT>(W + i, local_w);
+        #pragma unroll
+        for (int32_t j = 0; j < VPT / 4; j++) {
+            const fp32x2_t x0 = bf16x2_to_fp32x2(h[2 * j + 0]);
+            const fp32x2_t x1 = bf16x2_to_fp32x2(h[2 * j + 1]);
+            const fp32x2_t w0 = bf16x2_to_fp32x2(local_w[2 * j + 0]);
+            const fp32x2_t w1 = bf16x2_to_fp32x2(local_w[2 * j + 1]);
+            local_f8[j] = fp8x4_e4m3_t(make_float4(
+                x0.x * w0.x * q, x0.y * w0.y * q,
+                x1.x * w1.x * q, x1.y * w1.y * q
+            ));
+        }
+        vec_copy<sizeof(fp8_e4m3_t) * VPT>(local_f8, _Y + i);
+    };
+
+    #pragma unroll
+    for (int32_t it = 0; it < ITEMS; it++) {
+        const int32_t i = (it * TPB + tid) * VPT;
+        if (i < N) quantize(local_h[it], i);
+    }
+    for (int32_t i = (ITEMS * TPB + tid) * VPT; i < N; i += TPB * VPT) {
+        vec_copy<sizeof(bf16_t) * VPT>(_X + i, local_x);
+        quantize(local_x, i);
+    }
+
+    if (tid == 0) {
+        scales[bid] = scale;
+    }
+}
+
+/**
+ * @brief Scalar variant of device_add_norm_quant_bf16_fp8 for any N, the
+ * second pass reads h back from X.
+ */
+template<int32_t TPB>
+__global__ void device_add_norm_quant_bf16_fp8_general(
+    bf16_t* __restrict__ X,
+    const bf16_t* __restrict__ R,
+    const bf16_t* __restrict__ W,
+    fp8_e4m3_t* __restrict__ Y,
+    fp32_t* __restrict__ scales,
+    const int32_t N,
+    const fp32_t eps
+) {
+    const fp32_t r_N = 1 / (fp32_t)N;
+
+    const int32_t tid = threadIdx.x;
+    const int64_t bid = blockIdx.x;
+
+    bf16_t* _X = X + bid * N;
+    const bf16_t* _R = R + bid * N;
+    fp8_e4m3_t* _Y = Y + bid * N;
+
+    fp32x2_t stats = make_float2(0.0f, 0.0f);
+    for (int32_t i = tid; i < N; i += TPB) {
+        const bf16_t h = cvt_f32_bf16(cvt_bf16_f32(_X[i]) + cvt_bf16_f32(_R[i]));
+        _X[i] = h;
+        const fp32_t v = cvt_bf16_f32(h);
+        stats.x += v * v;
+        stats.y = fmaxf(stats.y, fabsf(v * cvt_bf16_f32(W[i])));
+    }
+
+    stats = lightllm::reduce::sm70::sync_block_reduce_sum_max_f32<TPB>(stats);
+
+    const fp32_t inv_norm = rsqrtf(stats.x * r_N + eps);
+    const fp32_t scale = stats.y * inv_norm / kFp8E4M3Max;
+    const fp32_t q = inv_norm / (scale + 1e-7f);
+
+    for (int32_t i = tid; i < N; i += TPB) {
+        _Y[i] = fp8_e4m3_t(cvt_bf16_f32(_X[i]) * cvt_bf16_f32(W[i]) * q);
+    }
+
+    if (tid == 0) {
+        scales[bid] = scale;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Launch add_norm_quant, one CUDA block per row. Rows up to
+ * TPB * ITEMS * 8 elements are held in registers between the two passes,
+ * ITEMS grows with N so common hidden sizes (up to 16384) never re-read X.
+ */
+void add_norm_quant_cuda(
+    const TensorView& X, const TensorView& R, const TensorView& W,
+    const TensorView& Y, const TensorView& scales, const fp32_t eps
+) {
+    LK_CHECK(Y.dtype == DType::Fp8E4M3, "add_norm_quant_cuda only supports a float8_e4m3fn output");
+    const int64_t M = X.size(0);
+    const int32_t N = static_cast<int32_t>(X.size(1));
+    const cudaStream_t stream = static_cast<cudaStream_t>(X.stream);
+
+    auto run = [&](auto kernel, const int32_t tpb) {
+        kernel<<<M, tpb, 0, stream>>>(
+            X.data_ptr<bf16_t>(), R.data_ptr<const bf16_t>(), W.data_ptr<const bf16_t>(),
+            Y.data_ptr<fp8_e4m3_t>(), scales.data_ptr<fp32_t>(), N, eps
+        );
+    };
+
+    if (N % 8 != 0) run(device_add_norm_quant_bf16_fp8_general<128>, 128);
+    else if (N <= 1024) run(device_add_norm_quant_bf16_fp8<128, 1>, 128);
+    else if (N <= 2048) run(device_add_norm_quant_bf16_fp8<256, 1>, 256);
+    else if (N <= 4096) run(device_add_norm_quant_bf16_fp8<256, 2>, 256);
+    else if (N <= 8192) run(device_add_norm_quant_bf16_fp8<512, 2>, 512);
+    else run(device_add_norm_quant_bf16_fp8<512, 4>, 512);
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,165 @@
+#include "core/ops.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+// Row conversions of the active CPU kernels, fp32 rows are used in place.
+inline const fp32_t* row_to_float(const CpuKernels&, const fp32_t* x, fp32_t*, const int64_t) { return x; }
+inline const fp32_t* row_to_float(const CpuKernels& k, const host_bf16_t* x, fp32_t* y, const int64_t n) {
+    k.bf16_to_float(x, y, n);
+    return y;
+}
+inline const fp32_t* row_to_float(const CpuKernels& k, const host_fp16_t* x, fp32_t* y, const int64_t n) {
+    k.fp16_to_float(x, y, n);
+    return y;
+}
+inline void row_from_float(const CpuKernels&, const fp32_t* x, fp32_t* y, const int64_t n) { std::copy(x, x + n, y); }
+inline void row_from_float(const CpuKernels& k, const fp32_t* x, host_bf16_t* y, const int64_t n) { k.float_to_bf16(x, y, n); }
+inline void row_from_float(const CpuKernels& k, const fp32_t* x, host_fp16_t* y, const int64_t n) { k.float_to_fp16(x, y, n); }
+
+template<typename T>
+void rmsnorm_rows(
+    const T* X, const T* W, T* Y,
+    const int64_t begin, const int64_t end,
+    const int64_t N, const fp32_t eps
+) {
+    const CpuKernels& k = cpu_kernels();
+    const fp32_t r_N = 1 / (fp32_t)N;
+    // [N] weight, [N] input row, [N] output row in fp32
+    std::vector<fp32_t> scratch(3 * N);
+    const fp32_t* w = row_to_float(k, W, scratch.data(), N);
+    fp32_t* y = scratch.data() + 2 * N;
+    for (int64_t row = begin; row < end; row++) {
+        const fp32_t* x = row_to_float(k, X + row * N, scratch.data() + N, N);
+        const fp32_t inv_norm = 1.0f / std::sqrt(k.sum_squares(x, N) * r_N + eps);
+        k.scale_mul(x, inv_norm, w, y, N);
+        row_from_float(k, y, Y + row * N, N);
+    }
+}
+
+/**
+ * @brief Host RMSNorm, chunks of rows run on the core thread pool with the
+ * kernels of the active CPU instruction set.
+ */
+template<typename T>
+void launch_rmsnorm_cpu(
+    const void* X, const void* W, void* Y,
+    const int64_t M, const int64_t N, const fp32_t eps, void*
+) {
+    // keep at least ~32K elements per chunk, smaller chunks are dominated by the hand off
+    const int64_t grain = std::max<int64_t>(1, 32768 / std::max<int64_t>(N, 1));
+    parallel_for(0, M, grain, [&](int64_t begin, int64_t end) {
+        rmsnorm_rows<T>(
+            static_cast<const T*>(X), static_cast<const T*>(W), static_cast<T*>(Y),
+            begin, end, N, eps
+        );
+    });
+}
+
+// The row layout of a plan: M is a run() argument, so the number of plans
+// does not grow with the token counts a server sees.
+struct RmsNormKey {
+    DType dtype;
+    Device device;
+    int32_t device_index;
+    int64_t N;
+    fp32_t eps;
+
+    bool operator==(const RmsNormKey& o) const {
+        return dtype == o.dtype && device == o.device && device_index == o.device_index && N == o.N && eps == o.eps;
+    }
+};
+
+struct RmsNormKeyHash {
+    size_t operator()(const RmsNormKey& k) const {
+        uint32_t eps_bits;
+        std::memcpy(&eps_bits, &k.eps, sizeof(eps_bits));
+        size_t h = static_cast<size_t>(k.dtype) * 31 + static_cast<size_t>(k.device);
+        h = h * 31 + static_cast<size_t>(k.device_index);
+        h = h * 1000003 ^ static_cast<size_t>(k.N);
+        return h * 31 + eps_bits;
+    }
+};
+
+} // namespace
+
+RmsNormLaunchFn resolve_rmsnorm_cpu(const DType dtype) {
+    switch (dtype) {
+        case DType::Float32: return launch_rmsnorm_cpu<fp32_t>;
+        case DType::Float16: return launch_rmsnorm_cpu<host_fp16_t>;
+        case DType::BFloat16: return launch_rmsnorm_cpu<host_bf16_t>;
+        default: LK_NOT_SUPPORTED("rmsnorm_cpu does not support ", dtype_name(dtype));
+    }
+}
+
+RmsNormLaunchFn resolve_rmsnorm(const Device device, const DType dtype, const int64_t N) {
+    if (device == Device::CPU) return resolve_rmsnorm_cpu(dtype);
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    return resolve_rmsnorm_cuda(dtype, N);
+#else
+    (void)N;
+    LK_NOT_SUPPORTED("rmsnorm: the core library was built without CUDA");
+#endif
+}
+
+/**
+ * @brief Validate the layout of X once and resolve the kernel and its launch
+ * configuration. Plans are cached by (row size, dtype, device, eps), so
+ * calling this on every step only costs a hash lookup, and the cache stays
+ * as small as the set of norms of a model whatever the batch sizes are;
+ * keeping the returned plan skips even the lookup.
+ *
+ * @param X    Metadata of the input, [..., N] contiguous. Only its rows
+ *             shape the plan, run() takes the number of rows.
+ * @param eps  Epsilon for numerical stability.
+ */
+const RmsNormPlan& make_rmsnorm_plan(const TensorMeta& X, const fp32_t eps) {
+    static PlanCache<RmsNormKey, RmsNormPlan, RmsNormKeyHash> cache;
+    LK_CHECK(X.ndim >= 1, "rmsnorm expects at least 1 dim");
+    LK_CHECK(X.is_contiguous(), "rmsnorm plans expect a contiguous input");
+    const int64_t N = X.shape[X.ndim - 1];
+    return cache.get_or_create(RmsNormKey{X.dtype, X.device, X.device_index, N, eps}, [&] {
+        RmsNormPlan plan;
+        plan.N = N;
+        plan.eps = eps;
+        plan.launch = resolve_rmsnorm(X.device, X.dtype, N);
+        return plan;
+    });
+}
+
+/**
+ * @brief RMSNorm over the last dim: Y = X / sqrt(mean(X^2) + eps) * W.
+ *
+ * @param X    [M, N] contiguous input.
+ * @param W    [N] weight, same dtype as X.
+ * @param Y    [M, N] contiguous output, same dtype as X.
+ * @param eps  Epsilon for numerical stability.
+ */
+void rmsnorm(
+    const TensorView& X, const TensorView& W,
+    const TensorView& Y, const fp32_t eps
+) {
+    LK_CHECK(X.dim() == 2 && Y.dim() == 2 && W.dim() == 1, "rmsnorm expects X, Y [M, N] and W [N]");
+    LK_CHECK(X.is_contiguous() && W.is_contiguous() && Y.is_contiguous(), "rmsnorm expects contiguous tensors");
+    LK_CHECK(X.size(0) == Y.size(0) && X.size(1) == Y.size(1) && X.size(1) == W.size(0),
+             "rmsnorm shape mismatch");
+    LK_CHECK(X.dtype == W.dtype && X.dtype == Y.dtype, "rmsnorm expects X, W and Y of the same dtype");
+    LK_CHECK(X.device == W.device && X.device == Y.device, "rmsnorm expects tensors on the same device");
+    if (X.size(0) == 0) return;
+
+    const RmsNormLaunchFn launch = resolve_rmsnorm(X.device, X.dtype, X.size(1));
+    launch(X.data, W.data, Y.data, X.size(0), X.size(1), eps, X.stream);
+}
+
+} // namespace core
+} // namespace lightllm
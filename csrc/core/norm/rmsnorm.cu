@@ -0,0 +1,289 @@
+#include "core/ops.h"
+#include "reduce/sm70.cuh"
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+template<int32_t TPB>
+__global__
+void device_rmsnorm_align16_bf16_general(
+    bf16_t __restrict__ *X,           // [M, N] Input tensor pointer.
+    const bf16_t __restrict__ *W,     // [N] Weight tensor pointer.
+    bf16_t __restrict__ *Y,                        // [M, N] Output tensor pointer.
+    const int32_t M,                  // Number of rows.
+    const int32_t N,
+    const fp32_t eps                  // Epsilon for numerical stability.
+) {
+    const fp32_t r_N = 1 / (fp32_t)N;       // Reciprocal of N.
+
+    const int32_t tid = threadIdx.x;
+    const int32_t bid = blockIdx.x;
+
+    // Each block processes one row of the input tensor.
+    bf16_t* _X = X + bid * N;
+    bf16_t* _Y = Y + bid * N;
+
+    // Each thread computes a partial sum of squares.
+    fp32_t local_square_sum = 0.0f;
+    for (int32_t i = tid; i < N; i += TPB) {
+        fp32_t tmp = cvt_bf16_f32(_X[i]);
+        local_square_sum += tmp* tmp;
+    }
+    
+
+    // Reduce the partial sums across the block, block reduce sum will invoke __syncthread();
+    fp32_t reduced_square_sum = lightllm::reduce::sm70::sync_block_reduce_sum_f32<TPB>(local_square_sum);
+    // Compute the mean square and then the inverse RMS normalization factor.
+    // For RMSNorm, the normalization factor is 1/sqrt(mean(x^2)+eps).
+    fp32_t mean_square = reduced_square_sum * r_N;
+    fp32_t inv_norm = rsqrtf(mean_square + eps);
+    
+    // // Normalize each element using the computed normalization factor.
+    for (int32_t i = tid; i < N; i += TPB) {
+        fp32_t x = cvt_bf16_f32(_X[i]);
+        fp32_t w = cvt_bf16_f32(W[i]);
+        // Apply normalization: multiply by inv_norm and then scale by the weight.
+        fp32_t ret = x* inv_norm * w;
+        _Y[i] = cvt_f32_bf16(ret);
+    }
+}
+
+template<int32_t TPB>
+__global__
+void device_rmsnorm_align16_bf16_vpt(
+    bf16_t __restrict__ *X,           // [M, N] Input tensor pointer.
+    const bf16_t __restrict__ *W,     // [N] Weight tensor pointer.
+    bf16_t __restrict__ *Y,                        // [M, N] Output tensor pointer.
+    const int32_t M,                  // Number of rows.
+    const int32_t N,
+    const fp32_t eps                  // Epsilon for numerical stability.
+) {
+    constexpr int32_t VPT = 8;                // Number of FP16 values processed per thread.
+    const fp32_t r_N = 1 / (fp32_t)N;       // Reciprocal of N.
+
+    const int32_t tid = threadIdx.x;
+    const int32_t bid = blockIdx.x;
+
+    // Each block processes one row of the input tensor.
+    bf16_t* _X = X + bid * N;
+    bf16_t* _Y = Y + bid * N;
+
+    // Shared memory workspace to store vectorized (half2) data.
+    // Note: since each bf16x2_t holds 2 half values, the workspace size is N/2.
+    // __shared__ bf16x2_t workspace[N / 2];
+    extern __shared__ bf16x2_t workspace2[];
+
+    // Local registers to hold vectorized data.
+    bf16x2_t local_x[VPT / 2];
+    bf16x2_t local_w[VPT / 2];
+    bf16x2_t local_y[VPT / 2];
+
+    // Each thread computes a partial sum of squares.
+    fp32_t local_square_sum = 0.0f;
+    for (int32_t i = tid * VPT; i < N; i += TPB * VPT) {
+        // Load VPT FP16 elements from global memory (_X) into local vector (local_x).
+        vec_copy<sizeof(bf16_t) * VPT>(_X + i, local_x);
+        // Store the loaded data into shared memory.
+        // Divide index by 2 because 'workspace' is an array of bf16x2_t.
+        vec_copy<sizeof(bf16_t) * VPT>(local_x, workspace2 + (i >> 1));
+
+        // Compute the sum of squares for the VPT elements.
+        #pragma unroll
+        for (int32_t j = 0; j < VPT / 2; j++) {
+            fp32x2_t tmp = bf16x2_to_fp32x2(local_x[j]);
+            local_square_sum += (tmp.x * tmp.x + tmp.y * tmp.y);
+        }
+    }
+
+    // Reduce the partial sums across the block, block reduce sum will invoke __syncthread();
+    fp32_t reduced_square_sum = lightllm::reduce::sm70::sync_block_reduce_sum_f32<TPB>(local_square_sum);
+    // Compute the mean square and then the inverse RMS normalization factor.
+    // For RMSNorm, the normalization factor is 1/sqrt(mean(x^2)+eps).
+    fp32_t mean_square = reduced_square_sum * r_N;
+    fp32_t inv_norm = rsqrtf(mean_square + eps);
+
+    // Normalize each element using the computed normalization factor.
+    for (int32_t i = tid * VPT; i < N; i += TPB * VPT) {
+        // Load the previously stored vectorized data from shared memory.
+        vec_copy<sizeof(bf16_t) * VPT>(workspace2 + (i >> 1), local_x);
+        // Load the corresponding weight values from global memory.
+        vec_copy<sizeof(bf16_t) * VPT>(W + i, local_w);
+
+        #pragma unroll
+        for (int32_t j = 0; j < VPT / 2; j++) {
+            fp32x2_t x = bf16x2_to_fp32x2(local_x[j]);
+            fp32x2_t w = bf16x2_to_fp32x2(local_w[j]);
+            // Apply normalization: multiply by inv_norm and then scale by the weight.
+            fp32x2_t ret = make_float2(
+                x.x * inv_norm * w.x,
+                x.y * inv_norm * w.y
+            );
+            local_y[j] = _float22bf162_rn(ret);
+        }
+        // Write the normalized vectorized data back to global memory.
+        vec_copy<sizeof(bf16_t) * VPT>(local_y, _Y + i);
+    }
+}
+
+/**
+ * @brief CUDA kernel to perform RMS normalization on an FP16 tensor.
+ *
+ * Each block processes one row of the input tensor. The kernel loads the
+ * data in a vectorized manner (using half2), computes the mean square,
+ * calculates the reciprocal square root (i.e. 1/sqrt(mean_square+eps)),
+ * and then normalizes the input row element‐wise while scaling with a weight.
+ *
+ * @tparam TPB   Threads per block.
+ * @tparam N     Number of FP16 elements in one row (must be a multiple of VPT).
+ *
+ * @param X       Pointer to the input tensor in global memory. [M, N]
+ * @param W       Pointer to the weight tensor in global memory. [N]
+ * @param Y       Pointer to the output tensor in global memory. [M, N]
+ * @param M       Number of rows in the tensor.
+ * @param eps     Epsilon for numerical stability.
+ */
+template<int32_t TPB, int32_t N>
+__global__
+void device_rmsnorm_align16_bf16(
+    bf16_t __restrict__ *X,           // [M, N] Input tensor pointer.
+    const bf16_t __restrict__ *W,     // [N] Weight tensor pointer.
+    bf16_t __restrict__ *Y,                        // [M, N] Output tensor pointer.
+    const int32_t M,                  // Number of rows.
+    const fp32_t eps                  // Epsilon for numerical stability.
+) {
+    constexpr int32_t VPT = 8;                // Number of FP16 values processed per thread.
+    constexpr fp32_t r_N = 1 / (fp32_t)N;       // Reciprocal of N.
+
+    static_assert(N % 2 == 0, "N must be even.");
+    static_assert(N % VPT == 0, "N must be a multiple of VPT.");
+
+    const int32_t tid = threadIdx.x;
+    const int32_t bid = blockIdx.x;
+
+    // Each block processes one row of the input tensor.
+    bf16_t* _X = X + bid * N;
+    bf16_t* _Y = Y + bid * N;
+
+    // Shared memory workspace to store vectorized (half2) data.
+    // Note: since each bf16x2_t holds 2 half values, the workspace size is N/2.
+    __shared__ bf16x2_t workspace[N / 2];
+
+    // Local registers to hold vectorized data.
+    bf16x2_t local_x[VPT / 2];
+    bf16x2_t local_w[VPT / 2];
+    bf16x2_t local_y[VPT / 2];
+
+    // Each thread computes a partial sum of squares.
+    fp32_t local_square_sum = 0.0f;
+    # pragma unroll
+    for (int32_t i = tid * VPT; i < N; i += TPB * VPT) {
+        // Load VPT FP16 elements from global memory (_X) into local vector (local_x).
+        vec_copy<sizeof(bf16_t) * VPT>(_X + i, local_x);
+        // Store the loaded data into shared memory.
+        // Divide index by 2 because 'workspace' is an array of bf16x2_t.
+        vec_copy<sizeof(bf16_t) * VPT>(local_x, workspace + (i >> 1));
+
+        // Compute the sum of squares for the VPT elements.
+        #pragma unroll
+        for (int32_t j = 0; j < VPT / 2; j++) {
+            fp32x2_t tmp = bf16x2_to_fp32x2(local_x[j]);
+            local_square_sum += (tmp.x * tmp.x + tmp.y * tmp.y);
+        }
+    }
+
+    // Reduce the partial sums across the block, block reduce sum will invoke __syncthread();
+    fp32_t reduced_square_sum = lightllm::reduce::sm70::sync_block_reduce_sum_f32<TPB>(local_square_sum);
+    // Compute the mean square and then the inverse RMS normalization factor.
+    // For RMSNorm, the normalization factor is 1/sqrt(mean(x^2)+eps).
+    fp32_t mean_square = reduced_square_sum * r_N;
+    fp32_t inv_norm = rsqrtf(mean_square + eps);
+
+    // Normalize each element using the computed normalization factor.
+    for (int32_t i = tid * VPT; i < N; i += TPB * VPT) {
+        // Load the previously stored vectorized data from shared memory.
+        vec_copy<sizeof(bf16_t) * VPT>(workspace + (i >> 1), local_x);
+        // Load the corresponding weight values from global memory.
+        vec_copy<sizeof(bf16_t) * VPT>(W + i, local_w);
+
+        #pragma unroll
+        for (int32_t j = 0; j < VPT / 2; j++) {
+            fp32x2_t x = bf16x2_to_fp32x2(local_x[j]);
+            fp32x2_t w = bf16x2_to_fp32x2(local_w[j]);
+            // Apply normalization: multiply by inv_norm and then scale by the weight.
+            fp32x2_t ret = make_float2(
+                x.x * inv_norm * w.x,
+                x.y * inv_norm * w.y
+            );
+            local_y[j] = _float22bf162_rn(ret);
+        }
+        // Write the normalized vectorized data back to global memory.
+        vec_copy<sizeof(bf16_t) * VPT>(local_y, _Y + i);
+    }
+}
+
+template<int32_t TPB, int32_t N>
+void launch_rmsnorm_align16_bf16(
+    const void* X, const void* W, void* Y,
+    const int64_t M, const int64_t, const fp32_t eps, void* stream
+) {
+    device_rmsnorm_align16_bf16<TPB, N>
+    <<<M, TPB, 0, static_cast<cudaStream_t>(stream)>>>(
+        static_cast<bf16_t*>(const_cast<void*>(X)), static_cast<const bf16_t*>(W),
+        static_cast<bf16_t*>(Y), M, eps
+    );
+}
+
+template<int32_t TPB>
+void launch_rmsnorm_align16_bf16_vpt(
+    const void* X, const void* W, void* Y,
+    const int64_t M, const int64_t N, const fp32_t eps, void* stream
+) {
+    const int64_t shared_mem_size = N * sizeof(bf16_t);
+    device_rmsnorm_align16_bf16_vpt<TPB>
+    <<<M, TPB, shared_mem_size, static_cast<cudaStream_t>(stream)>>>(
+        static_cast<bf16_t*>(const_cast<void*>(X)), static_cast<const bf16_t*>(W),
+        static_cast<bf16_t*>(Y), M, N, eps
+    );
+}
+
+template<int32_t TPB>
+void launch_rmsnorm_align16_bf16_general(
+    const void* X, const void* W, void* Y,
+    const int64_t M, const int64_t N, const fp32_t eps, void* stream
+) {
+    device_rmsnorm_align16_bf16_general<TPB>
+    <<<M, TPB, 0, static_cast<cudaStream_t>(stream)>>>(
+        static_cast<bf16_t*>(const_cast<void*>(X)), static_cast<const bf16_t*>(W),
+        static_cast<bf16_t*>(Y), M, N, eps
+    );
+}
+
+/**
+ * @brief Pick the RMSNorm kernel and launch config for BF16 rows of N elements.
+ *
+ * Common hidden sizes get a kernel with N fixed at compile time, other sizes
+ * fall back to the vectorized (N % 8 == 0) or the general kernel. Each CUDA
+ * block processes one row.
+ */
+RmsNormLaunchFn resolve_rmsnorm_cuda(const DType dtype, const int64_t N) {
+    if (dtype != DType::BFloat16) {
+        LK_NOT_SUPPORTED("rmsnorm_cuda only supports bfloat16, got ", dtype_name(dtype));
+    }
+    switch (N) {
+        case 768: return launch_rmsnorm_align16_bf16<128, 768>;
+        case 1024: return launch_rmsnorm_align16_bf16<128, 1024>;
+        case 2048: return launch_rmsnorm_align16_bf16<128, 2048>;
+        case 3200: return launch_rmsnorm_align16_bf16<256, 3200>;
+        case 4096: return launch_rmsnorm_align16_bf16<256, 4096>;
+        case 8192: return launch_rmsnorm_align16_bf16<512, 8192>;
+        case 10240: return launch_rmsnorm_align16_bf16<512, 10240>;
+        default:
+            if (N % 8 == 0) return launch_rmsnorm_align16_bf16_vpt<256>;
+            return launch_rmsnorm_align16_bf16_general<256>;
+    }
+}
+
+} // namespace core
+} // namespace lightllm
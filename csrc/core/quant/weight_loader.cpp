@@ -0,0 +1,469 @@
+#include "core/weight_loader.h"
+#include "core/cpu_isa.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+constexpr fp32_t kFp8E4M3Max = 448.0f;
+constexpr int64_t kPageBytes = 4096;
+
+/**
+ * Just enough JSON for a safetensors header: objects, arrays, strings,
+ * integers and the literals. Values the header does not use are skipped.
+ */
+class HeaderParser {
+ public:
+    HeaderParser(const char* p, const char* end, const std::string& path) : p_(p), end_(end), path_(path) {}
+
+    void expect(const char c) {
+        skip_ws();
+        if (p_ >= end_ || *p_ != c) fail(std::string("expected '") + c + "'");
+        p_++;
+    }
+
+    // Consumes c if it is the next character.
+    bool accept(const char c) {
+        skip_ws();
+        if (p_ < end_ && *p_ == c) {
+            p_++;
+            return true;
+        }
+        return false;
+    }
+
+    std::string string() {
+        expect('"');
+        std::string s;
+        while (p_ < end_ && *p_ != '"') {
+            if (*p_ != '\\') {
+                s.push_back(*p_++);
+                continue;
+            }
+            if (++p_ >= end_) break;
+            const char e = *p_++;
+            switch (e) {
+                case 'b': s.push_back('\b'); break;
+                case 'f': s.push_back('\f'); break;
+                case 'n': s.push_back('\n'); break;
+                case 'r': s.push_back('\r'); break;
+                case 't': s.push_back('\t'); break;
+                case 'u': utf8(s, hex4()); break;
+                default: s.push_back(e); break;
+            }
+        }
+        expect('"');
+        return s;
+    }
+
+    int64_t integer() {
+        skip_ws();
+        const char* start = p_;
+        if (p_ < end_ && *p_ == '-') p_++;
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '9') p_++;
+        if (p_ == start || (p_ == start + 1 && *start == '-')) fail("expected an integer");
+        return std::stoll(std::string(start, p_));
+    }
+
+    std::vector<int64_t> integers() {
+        std::vector<int64_t> v;
+        expect('[');
+        if (accept(']')) return v;
+        do v.push_back(integer()); while (accept(','));
+        expect(']');
+        return v;
+    }
+
+    void skip_value() {
+        skip_ws();
+        if (p_ >= end_) fail("unexpected end");
+        if (*p_ == '"') {
+            string();
+        } else if (*p_ == '{' || *p_ == '[') {
+            const char close = *p_ == '{' ? '}' : ']';
+            p_++;
+            if (accept(close)) return;
+            do {
+                if (close == '}') {
+                    string();
+                    expect(':');
+                }
+                skip_value();
+            } while (accept(','));
+            expect(close);
+        } else {
+            // numbers and literals
+            while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' &&
+                   !std::isspace(static_cast<unsigned char>(*p_))) {
+                p_++;
+            }
+        }
+    }
+
+    bool at_end() {
+        skip_ws();
+        return p_ >= end_;
+    }
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::invalid_argument(path_ + ": bad safetensors header, " + what);
+    }
+
+ private:
+    void skip_ws() {
+        // the header is padded with spaces to 8 bytes
+        while (p_ < end_ && (std::isspace(static_cast<unsigned char>(*p_)) || *p_ == '\0')) p_++;
+    }
+
+    uint32_t hex4() {
+        if (end_ - p_ < 4) fail("bad \\u escape");
+        const uint32_t u = static_cast<uint32_t>(std::stoul(std::string(p_, p_ + 4), nullptr, 16));
+        p_ += 4;
+        return u;
+    }
+
+    static void utf8(std::string& s, const uint32_t u) {
+        if (u < 0x80) {
+            s.push_back(static_cast<char>(u));
+        } else if (u < 0x800) {
+            s.push_back(static_cast<char>(0xc0 | (u >> 6)));
+            s.push_back(static_cast<char>(0x80 | (u & 0x3f)));
+        } else {
+            s.push_back(static_cast<char>(0xe0 | (u >> 12)));
+            s.push_back(static_cast<char>(0x80 | ((u >> 6) & 0x3f)));
+            s.push_back(static_cast<char>(0x80 | (u & 0x3f)));
+        }
+    }
+
+    const char* p_;
+    const char* end_;
+    const std::string& path_;
+};
+
+// Element size of a safetensors dtype, 0 if unknown.
+int64_t dtype_bytes(const std::string& dtype) {
+    if (dtype == "F64" || dtype == "I64" || dtype == "U64") return 8;
+    if (dtype == "F32" || dtype == "I32" || dtype == "U32") return 4;
+    if (dtype == "F16" || dtype == "BF16" || dtype == "I16" || dtype == "U16") return 2;
+    if (dtype == "I8" || dtype == "U8" || dtype == "BOOL" || dtype == "F8_E4M3" || dtype == "F8_E5M2") return 1;
+    return 0;
+}
+
+bool to_dtype(const std::string& dtype, DType* out) {
+    static const std::map<std::string, DType> kDTypes = {
+        {"F32", DType::Float32}, {"F16", DType::Float16}, {"BF16", DType::BFloat16}, {"F8_E4M3", DType::Fp8E4M3},
+        {"I8", DType::Int8}, {"U8", DType::UInt8}, {"I32", DType::Int32}, {"I64", DType::Int64},
+    };
+    const auto it = kDTypes.find(dtype);
+    if (it == kDTypes.end()) return false;
+    *out = it->second;
+    return true;
+}
+
+void check_job(const WeightQuantJob& job) {
+    const TensorView& w = job.w;
+    const TensorView& q = job.q;
+    const TensorView& scales = job.scales;
+    LK_CHECK(w.is_cpu() && q.is_cpu() && scales.is_cpu(), "weight quantization runs on host tensors");
+    LK_CHECK(w.dim() == 2 && w.stride(1) == 1, "w must be a [N, K] tensor with contiguous rows");
+    LK_CHECK(w.dtype == DType::BFloat16 || w.dtype == DType::Float16 || w.dtype == DType::Float32,
+             "w must be bf16, fp16 or fp32, got ", dtype_name(w.dtype));
+    LK_CHECK(q.dim() == 2 && q.size(0) == w.size(1) && q.size(1) == w.size(0), "q must be [K, N] for a [N, K] w");
+    LK_CHECK(q.stride(0) == 1 && q.stride(1) >= q.size(0), "q must be column major like the b of scaled_mm");
+    LK_CHECK(q.dtype == DType::Int8 || q.dtype == DType::Fp8E4M3, "q must be int8 or fp8_e4m3");
+    LK_CHECK(scales.dtype == DType::Float32 && scales.is_contiguous() && scales.numel() == w.size(0),
+             "scales must be a contiguous fp32 [N] tensor");
+}
+
+void quantize_job(const WeightQuantJob& job) {
+    const CpuKernels& kernels = cpu_kernels();
+    const int64_t N = job.w.size(0);
+    const int64_t K = job.w.size(1);
+    const bool fp8 = job.q.dtype == DType::Fp8E4M3;
+    fp32_t* scales = job.scales.data_ptr<fp32_t>();
+    parallel_for(0, N, std::max<int64_t>(1, 16384 / std::max<int64_t>(K, 1)), [&](int64_t begin, int64_t end) {
+        std::vector<fp32_t> buf(job.w.dtype == DType::Float32 ? 0 : K);
+        for (int64_t n = begin; n < end; n++) {
+            const char* src = static_cast<const char*>(job.w.data) + n * job.w.stride(0) * job.w.element_size();
+            const fp32_t* row = reinterpret_cast<const fp32_t*>(src);
+            if (job.w.dtype == DType::BFloat16) {
+                kernels.bf16_to_float(reinterpret_cast<const host_bf16_t*>(src), buf.data(), K);
+                row = buf.data();
+            } else if (job.w.dtype == DType::Float16) {
+                kernels.fp16_to_float(reinterpret_cast<const host_fp16_t*>(src), buf.data(), K);
+                row = buf.data();
+            }
+            const fp32_t amax = kernels.absmax(row, K);
+            char* dst = static_cast<char*>(job.q.data) + n * job.q.stride(1);
+            if (fp8) {
+                scales[n] = amax / kFp8E4M3Max;
+                kernels.float_to_fp8(row, 1.0f / (scales[n] + 1e-7f), reinterpret_cast<host_fp8_e4m3_t*>(dst), K);
+            } else {
+                scales[n] = amax / 127.0f;
+                kernels.float_to_int8(row, amax > 0.0f ? 127.0f / amax : 0.0f, reinterpret_cast<int8_t*>(dst), K);
+            }
+        }
+    });
+}
+
+int64_t source_bytes(const TensorView& w) {
+    if (w.numel() == 0) return 0;
+    return ((w.size(0) - 1) * w.stride(0) + w.size(1)) * w.element_size();
+}
+
+// Faults the pages of [p, p + bytes) in.
+void touch(const char* p, const int64_t bytes) {
+    const uintptr_t page = reinterpret_cast<uintptr_t>(p) & ~static_cast<uintptr_t>(kPageBytes - 1);
+    ::madvise(reinterpret_cast<void*>(page), reinterpret_cast<uintptr_t>(p) + bytes - page, MADV_WILLNEED);
+    const volatile char* v = p;
+    char sink = 0;
+    for (int64_t i = 0; i < bytes; i += kPageBytes) sink ^= v[i];
+    if (bytes > 0) sink ^= v[bytes - 1];
+    (void)sink;
+}
+
+} // namespace
+
+SafetensorsFile::SafetensorsFile(const std::string& path) : path_(path) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (::fstat(fd_, &st) == 0 && st.st_size > 0) {
+        base = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd_, 0);
+    }
+    if (base == MAP_FAILED) {
+        const std::string error = st.st_size > 0 ? std::strerror(errno) : "empty file";
+        ::close(fd_);
+        throw std::runtime_error("cannot map " + path + ": " + error);
+    }
+    base_ = static_cast<char*>(base);
+    size_ = st.st_size;
+
+    try {
+        LK_CHECK(size_ >= 8, path, " is too small for a safetensors file");
+        uint64_t header_bytes = 0;
+        for (int i = 7; i >= 0; i--) header_bytes = header_bytes << 8 | static_cast<unsigned char>(base_[i]);
+        LK_CHECK(header_bytes <= static_cast<uint64_t>(size_ - 8), path, ": the header runs past the end of the file");
+        const int64_t data_start = 8 + static_cast<int64_t>(header_bytes);
+        HeaderParser parser(base_ + 8, base_ + data_start, path_);
+        parser.expect('{');
+        if (!parser.accept('}')) {
+            do {
+                const std::string name = parser.string();
+                parser.expect(':');
+                if (name == "__metadata__") {
+                    parser.expect('{');
+                    if (parser.accept('}')) continue;
+                    do {
+                        const std::string key = parser.string();
+                        parser.expect(':');
+                        metadata_[key] = parser.string();
+                    } while (parser.accept(','));
+                    parser.expect('}');
+                    continue;
+                }
+                SafetensorsEntry e;
+                e.name = name;
+                std::vector<int64_t> offsets;
+                parser.expect('{');
+                do {
+                    const std::string field = parser.string();
+                    parser.expect(':');
+                    if (field == "dtype") {
+                        e.dtype = parser.string();
+                    } else if (field == "shape") {
+                        e.shape = parser.integers();
+                    } else if (field == "data_offsets") {
+                        offsets = parser.integers();
+                    } else {
+                        parser.skip_value();
+                    }
+                } while (parser.accept(','));
+                parser.expect('}');
+                if (offsets.size() != 2 || offsets[0] < 0 || offsets[1] < offsets[0] ||
+                    offsets[1] > size_ - data_start) {
+                    parser.fail("bad data_offsets of " + name);
+                }
+                int64_t numel = 1;
+                for (const int64_t d : e.shape) {
+                    if (d < 0) parser.fail("bad shape of " + name);
+                    numel *= d;
+                }
+                const int64_t elem = dtype_bytes(e.dtype);
+                if (elem == 0) parser.fail("unknown dtype " + e.dtype + " of " + name);
+                if (numel * elem != offsets[1] - offsets[0]) parser.fail("the size of " + name + " does not match");
+                e.offset = data_start + offsets[0];
+                e.bytes = offsets[1] - offsets[0];
+                if (index_.count(name)) parser.fail("duplicate tensor " + name);
+                index_[name] = entries_.size();
+                entries_.push_back(std::move(e));
+            } while (parser.accept(','));
+            parser.expect('}');
+        }
+        if (!parser.at_end()) parser.fail("trailing data");
+    } catch (...) {
+        ::munmap(base_, size_);
+        ::close(fd_);
+        throw;
+    }
+    std::sort(entries_.begin(), entries_.end(),
+              [](const SafetensorsEntry& a, const SafetensorsEntry& b) { return a.offset < b.offset; });
+    for (size_t i = 0; i < entries_.size(); i++) index_[entries_[i].name] = i;
+}
+
+SafetensorsFile::~SafetensorsFile() {
+    ::munmap(base_, size_);
+    ::close(fd_);
+}
+
+const SafetensorsEntry* SafetensorsFile::find(const std::string& name) const {
+    const auto it = index_.find(name);
+    return it == index_.end() ? nullptr : &entries_[it->second];
+}
+
+TensorView SafetensorsFile::view(const SafetensorsEntry& entry) const {
+    DType dtype;
+    if (!to_dtype(entry.dtype, &dtype)) {
+        LK_NOT_SUPPORTED("safetensors dtype ", entry.dtype, " of ", entry.name, " has no TensorView dtype");
+    }
+    LK_CHECK(static_cast<int32_t>(entry.shape.size()) <= TensorView::kMaxDims, entry.name, " has too many dims");
+    TensorView v(base_ + entry.offset, dtype, {});
+    v.ndim = static_cast<int32_t>(entry.shape.size());
+    int64_t stride = 1;
+    for (int32_t d = v.ndim - 1; d >= 0; d--) {
+        v.shape[d] = entry.shape[d];
+        v.strides[d] = stride;
+        stride *= entry.shape[d];
+    }
+    return v;
+}
+
+/**
+ * Quantizes w [N, K] row by row: scales[n] = absmax(w[n]) / qmax and
+ * q[k, n] = round(w[n, k] / scales[n]), the per channel weight scales of
+ * cutlass_scaled_mm with the same rounding as the activation quantization of
+ * moe_cpu_experts.
+ */
+void quantize_weight_per_channel(const TensorView& w, const TensorView& q, const TensorView& scales) {
+    const WeightQuantJob job{w, q, scales};
+    check_job(job);
+    quantize_job(job);
+}
+
+WeightLoadStats quantize_weights(
+    const std::vector<WeightQuantJob>& jobs, const WeightLoadOptions& options,
+    const std::function<void(size_t)>& on_done
+) {
+    LK_CHECK(options.readahead_bytes > 0 && options.chunk_bytes > 0, "readahead_bytes and chunk_bytes must be > 0");
+    for (const WeightQuantJob& job : jobs) check_job(job);
+    const auto start = std::chrono::steady_clock::now();
+    WeightLoadStats stats;
+
+    // chunks of the sources in job order, at source byte offsets of the whole list
+    struct Chunk {
+        size_t job;
+        const char* data;
+        int64_t bytes;
+        int64_t offset;
+    };
+    std::vector<Chunk> chunks;
+    std::vector<int64_t> job_end(jobs.size());
+    std::vector<int32_t> unread(jobs.size(), 0);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const char* data = static_cast<const char*>(jobs[i].w.data);
+        const int64_t bytes = source_bytes(jobs[i].w);
+        for (int64_t b = 0; b < bytes; b += options.chunk_bytes) {
+            chunks.push_back({i, data + b, std::min(options.chunk_bytes, bytes - b), stats.bytes_read + b});
+            unread[i]++;
+        }
+        stats.bytes_read += bytes;
+        job_end[i] = stats.bytes_read;
+        stats.bytes_written += jobs[i].w.numel() + jobs[i].scales.numel() * static_cast<int64_t>(sizeof(fp32_t));
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t next = 0;
+    size_t current = 0;     // job the quantization is at, read regardless of the window
+    int64_t quantized = 0;  // source bytes of the finished jobs
+    bool stop = false;
+    auto io_loop = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cv.wait(lock, [&] {
+                return stop || next == chunks.size() || chunks[next].job <= current ||
+                       chunks[next].offset - quantized < options.readahead_bytes;
+            });
+            if (stop || next == chunks.size()) return;
+            const Chunk& c = chunks[next++];
+            lock.unlock();
+            touch(c.data, c.bytes);
+            lock.lock();
+            if (--unread[c.job] == 0) cv.notify_all();
+        }
+    };
+    std::vector<std::thread> io_threads;
+    if (options.io_threads <= 0) std::fill(unread.begin(), unread.end(), 0);
+    for (int32_t t = 0; t < options.io_threads && !chunks.empty(); t++) io_threads.emplace_back(io_loop);
+    // the IO threads stop and join on every exit, also when a consumer throws
+    struct Join {
+        std::vector<std::thread>& threads;
+        std::mutex& mutex;
+        std::condition_variable& cv;
+        bool& stop;
+        ~Join() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            cv.notify_all();
+            for (std::thread& t : threads) t.join();
+        }
+    } join{io_threads, mutex, cv, stop};
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            current = i;
+            cv.notify_all();
+            if (unread[i] > 0) {
+                const auto wait_start = std::chrono::steady_clock::now();
+                cv.wait(lock, [&] { return unread[i] == 0; });
+                stats.read_wait_seconds +=
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_start).count();
+            }
+        }
+        quantize_job(jobs[i]);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quantized = job_end[i];
+        }
+        cv.notify_all();
+        if (on_done) on_done(i);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,283 @@
+#include "core/ops.h"
+#include "core/host_float.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+constexpr fp32_t kNegInf = -std::numeric_limits<fp32_t>::infinity();
+
+/**
+ * @brief Host version of one row of device_logprobs_topn_partial.
+ *
+ * A single pass keeps the online (max, sum of exp) state and a min-heap holding
+ * the topn best logits seen so far.
+ */
+template<typename T>
+void logprobs_topn_partial_row(
+    const T* logits, const int64_t sampled_id,
+    fp32_t* topn_vals, int64_t* topn_ids,
+    fp32_t* sampled_val, fp32_t* stats,
+    const int64_t V, const int64_t vocab_start,
+    const int32_t topn, const bool normalize,
+    std::vector<std::pair<fp32_t, int64_t>>& heap
+) {
+    // Heap ordering: the worst candidate (smallest value, then largest id) on top.
+    auto worse = [](const std::pair<fp32_t, int64_t>& a, const std::pair<fp32_t, int64_t>& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+
+    fp32_t row_max = -std::numeric_limits<fp32_t>::max();
+    fp32_t row_sum = 0.0f;
+    heap.clear();
+    for (int64_t i = 0; i < V; i++) {
+        const fp32_t x = to_float(logits[i]);
+        if (x > row_max) {
+            row_sum = row_sum * std::exp(row_max - x) + 1.0f;
+            row_max = x;
+        } else {
+            row_sum += std::exp(x - row_max);
+        }
+
+        if (topn == 0 || x == kNegInf) continue;
+        if ((int32_t)heap.size() < topn) {
+            heap.emplace_back(x, vocab_start + i);
+            std::push_heap(heap.begin(), heap.end(), worse);
+        } else if (x > heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end(), worse);
+            heap.back() = {x, vocab_start + i};
+            std::push_heap(heap.begin(), heap.end(), worse);
+        }
+    }
+
+    const fp32_t lse = normalize ? row_max + std::log(row_sum) : 0.0f;
+
+    std::sort_heap(heap.begin(), heap.end(), worse);
+    for (int32_t k = 0; k < topn; k++) {
+        if (k < (int32_t)heap.size()) {
+            topn_vals[k] = heap[k].first - lse;
+            topn_ids[k] = heap[k].second;
+        } else {
+            topn_vals[k] = kNegInf;
+            topn_ids[k] = -1;
+        }
+    }
+
+    const int64_t local_id = sampled_id - vocab_start;
+    *sampled_val = (local_id >= 0 && local_id < V)
+        ? to_float(logits[local_id]) - lse
+        : kNegInf;
+    stats[0] = row_max;
+    stats[1] = row_sum;
+}
+
+} // namespace
+
+void logprobs_topn_partial_cpu(
+    const TensorView& topn_vals, const TensorView& topn_ids,
+    const TensorView& sampled_vals, const TensorView& stats,
+    const TensorView& logits, const TensorView& sampled_ids,
+    const int64_t vocab_start, const bool normalize
+) {
+    const int64_t B = logits.size(0);
+    const int64_t V = logits.size(1);
+    const int64_t stride = logits.stride(0);
+    const int32_t topn = topn_vals.dim() == 2 ? topn_vals.size(1) : 0;
+
+    const int64_t* ids = sampled_ids.data_ptr<const int64_t>();
+    fp32_t* _topn_vals = topn_vals.data_ptr<fp32_t>();
+    int64_t* _topn_ids = topn_ids.data_ptr<int64_t>();
+    fp32_t* _sampled_vals = sampled_vals.data_ptr<fp32_t>();
+    fp32_t* _stats = stats.data_ptr<fp32_t>();
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        const T* _logits = logits.data_ptr<const T>();
+        parallel_for(0, B, 1, [&](int64_t begin, int64_t end) {
+            std::vector<std::pair<fp32_t, int64_t>> heap;
+            heap.reserve(topn + 1);
+            for (int64_t b = begin; b < end; b++) {
+                logprobs_topn_partial_row<T>(
+                    _logits + b * stride, ids[b],
+                    _topn_vals + b * topn, _topn_ids + b * topn,
+                    _sampled_vals + b, _stats + b * 2,
+                    V, vocab_start, topn, normalize, heap
+                );
+            }
+        });
+    };
+
+    switch (logits.dtype) {
+        case DType::Float32: run(fp32_t{}); break;
+        case DType::Float16: run(host_fp16_t{}); break;
+        case DType::BFloat16: run(host_bf16_t{}); break;
+        default: LK_NOT_SUPPORTED("logprobs_topn_partial does not support ", dtype_name(logits.dtype));
+    }
+}
+
+void logprobs_topn_merge_cpu(
+    const TensorView& out_logprobs, const TensorView& out_ids, const TensorView& out_sampled,
+    const TensorView& stats, const TensorView& topn_vals,
+    const TensorView& topn_ids, const TensorView& sampled_vals
+) {
+    const int32_t S = stats.size(0);
+    const int64_t B = stats.size(1);
+    const int32_t topn = topn_vals.dim() == 3 ? topn_vals.size(2) : 0;
+
+    const fp32_t* _stats = stats.data_ptr<const fp32_t>();
+    const fp32_t* _topn_vals = topn_vals.data_ptr<const fp32_t>();
+    const int64_t* _topn_ids = topn_ids.data_ptr<const int64_t>();
+    const fp32_t* _sampled_vals = sampled_vals.data_ptr<const fp32_t>();
+    fp32_t* _out_logprobs = out_logprobs.data_ptr<fp32_t>();
+    int64_t* _out_ids = out_ids.data_ptr<int64_t>();
+    fp32_t* _out_sampled = out_sampled.data_ptr<fp32_t>();
+
+    parallel_for(0, B, 16, [&](int64_t begin, int64_t end) {
+        std::vector<int32_t> heads(S);
+        for (int64_t row = begin; row < end; row++) {
+            fp32_t m = -std::numeric_limits<fp32_t>::max();
+            for (int32_t s = 0; s < S; s++) {
+                m = std::max(m, _stats[(s * B + row) * 2]);
+            }
+            fp32_t sum = 0.0f;
+            fp32_t sampled = kNegInf;
+            for (int32_t s = 0; s < S; s++) {
+                const fp32_t* _s = _stats + (s * B + row) * 2;
+                sum += _s[1] * std::exp(_s[0] - m);
+                sampled = std::max(sampled, _sampled_vals[s * B + row]);
+            }
+            const fp32_t lse = m + std::log(sum);
+
+            std::fill(heads.begin(), heads.end(), 0);
+            for (int32_t k = 0; k < topn; k++) {
+                int32_t best = -1;
+                fp32_t best_val = kNegInf;
+                int64_t best_id = std::numeric_limits<int64_t>::max();
+                for (int32_t s = 0; s < S; s++) {
+                    if (heads[s] >= topn) continue;
+                    const int64_t offset = (s * B + row) * topn + heads[s];
+                    const int64_t id = _topn_ids[offset];
+                    if (id < 0) continue;
+                    const fp32_t val = _topn_vals[offset];
+                    if (best < 0 || val > best_val || (val == best_val && id < best_id)) {
+                        best = s;
+                        best_val = val;
+                        best_id = id;
+                    }
+                }
+                if (best >= 0) heads[best]++;
+                _out_logprobs[row * topn + k] = best_val - lse;
+                _out_ids[row * topn + k] = best < 0 ? -1 : best_id;
+            }
+            _out_sampled[row] = sampled - lse;
+        }
+    });
+}
+
+/**
+ * @brief Per-shard fused log-softmax statistics and top-N logits.
+ *
+ * @param topn_vals     [B, topn] fp32 output.
+ * @param topn_ids      [B, topn] int64 output, global token ids.
+ * @param sampled_vals  [B] fp32 output.
+ * @param stats         [B, 2] fp32 output, (max, sum of exp) of the shard.
+ * @param logits        [B, V] fp32/fp16/bf16 logits of this shard, last dim contiguous.
+ * @param sampled_ids   [B] int64 global ids of the sampled tokens, contiguous.
+ * @param vocab_start   Global id of the first token of this shard.
+ * @param normalize     Write logprobs instead of raw logits, only valid for an unsharded vocab.
+ */
+void logprobs_topn_partial(
+    const TensorView& topn_vals, const TensorView& topn_ids,
+    const TensorView& sampled_vals, const TensorView& stats,
+    const TensorView& logits, const TensorView& sampled_ids,
+    const int64_t vocab_start, const bool normalize
+) {
+    LK_CHECK(logits.dim() == 2, "logits must be 2D");
+    LK_CHECK(logits.stride(1) == 1, "last dim of logits must be contiguous");
+    LK_CHECK(sampled_ids.dtype == DType::Int64 && sampled_ids.is_contiguous(), "sampled_ids must be contiguous int64");
+    LK_CHECK(topn_vals.dtype == DType::Float32 && topn_ids.dtype == DType::Int64);
+    LK_CHECK(sampled_vals.dtype == DType::Float32 && stats.dtype == DType::Float32);
+    LK_CHECK(topn_vals.is_contiguous() && topn_ids.is_contiguous());
+    LK_CHECK(sampled_vals.is_contiguous() && stats.is_contiguous());
+
+    const int64_t B = logits.size(0);
+    const int32_t topn = topn_vals.dim() == 2 ? topn_vals.size(1) : 0;
+    LK_CHECK(topn <= 32, "logprobs_topn supports topn <= 32");
+    LK_CHECK(sampled_ids.numel() == B && sampled_vals.numel() == B && stats.numel() == B * 2);
+    LK_CHECK(topn_vals.numel() == B * topn && topn_ids.numel() == B * topn);
+    if (B == 0) return;
+
+    if (logits.is_cpu()) {
+        logprobs_topn_partial_cpu(
+            topn_vals, topn_ids, sampled_vals, stats,
+            logits, sampled_ids, vocab_start, normalize
+        );
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    logprobs_topn_partial_cuda(
+        topn_vals, topn_ids, sampled_vals, stats,
+        logits, sampled_ids, vocab_start, normalize
+    );
+#else
+    LK_NOT_SUPPORTED("logprobs_topn_partial: the core library was built without CUDA");
+#endif
+}
+
+/**
+ * @brief Cross-shard merge of logprobs_topn_partial results.
+ *
+ * @param out_logprobs  [B, topn] fp32 output.
+ * @param out_ids       [B, topn] int64 output.
+ * @param out_sampled   [B] fp32 output, logprob of the sampled token.
+ * @param stats         [S, B, 2] gathered stats of all shards.
+ * @param topn_vals     [S, B, topn] gathered raw top logits.
+ * @param topn_ids      [S, B, topn] gathered token ids.
+ * @param sampled_vals  [S, B] gathered raw sampled logits.
+ */
+void logprobs_topn_merge(
+    const TensorView& out_logprobs, const TensorView& out_ids, const TensorView& out_sampled,
+    const TensorView& stats, const TensorView& topn_vals,
+    const TensorView& topn_ids, const TensorView& sampled_vals
+) {
+    LK_CHECK(stats.dim() == 3 && stats.size(2) == 2, "stats must be [S, B, 2]");
+    LK_CHECK(stats.is_contiguous() && topn_vals.is_contiguous());
+    LK_CHECK(topn_ids.is_contiguous() && sampled_vals.is_contiguous());
+    LK_CHECK(out_logprobs.is_contiguous() && out_ids.is_contiguous() && out_sampled.is_contiguous());
+    LK_CHECK(stats.dtype == DType::Float32 && topn_vals.dtype == DType::Float32 && sampled_vals.dtype == DType::Float32);
+    LK_CHECK(topn_ids.dtype == DType::Int64 && out_ids.dtype == DType::Int64);
+    LK_CHECK(out_logprobs.dtype == DType::Float32 && out_sampled.dtype == DType::Float32);
+
+    const int64_t S = stats.size(0);
+    const int64_t B = stats.size(1);
+    const int32_t topn = topn_vals.dim() == 3 ? topn_vals.size(2) : 0;
+    LK_CHECK(topn_vals.numel() == S * B * topn && topn_ids.numel() == S * B * topn && sampled_vals.numel() == S * B);
+    LK_CHECK(out_logprobs.numel() == B * topn && out_ids.numel() == B * topn && out_sampled.numel() == B);
+    if (B == 0) return;
+
+    if (stats.is_cpu()) {
+        logprobs_topn_merge_cpu(
+            out_logprobs, out_ids, out_sampled,
+            stats, topn_vals, topn_ids, sampled_vals
+        );
+        return;
+    }
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+    logprobs_topn_merge_cuda(
+        out_logprobs, out_ids, out_sampled,
+        stats, topn_vals, topn_ids, sampled_vals
+    );
+#else
+    LK_NOT_SUPPORTED("logprobs_topn_merge: the core library was built without CUDA");
+#endif
+}
+
+} // namespace core
+} // namespace lightllm
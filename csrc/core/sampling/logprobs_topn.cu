@@ -0,0 +1,393 @@
+#include "core/ops.h"
+#include "utils.h"
+
+#include <cfloat>
+
+namespace lightllm {
+namespace core {
+
+using namespace lightllm;
+
+/**
+ * @brief Merge two online-softmax states (running max, running sum of exp(x - max)).
+ */
+__device__ inline
+fp32x2_t online_softmax_merge(const fp32x2_t a, const fp32x2_t b) {
+    const fp32_t m = fmaxf(a.x, b.x);
+    return make_float2(m, a.y * __expf(a.x - m) + b.y * __expf(b.x - m));
+}
+
+/**
+ * @brief Block-wide reduction of online-softmax states, the result is broadcast to all threads.
+ */
+template<int32_t TPB>
+__device__ inline
+fp32x2_t sync_block_reduce_online_softmax(fp32x2_t state) {
+    constexpr int32_t WARP_SIZE = 32;
+    constexpr int32_t WPT = TPB / WARP_SIZE;
+    const int32_t lane_id = threadIdx.x % WARP_SIZE;
+    const int32_t warp_id = threadIdx.x / WARP_SIZE;
+
+    #pragma unroll
+    for (int32_t mask = WARP_SIZE / 2; mask >= 1; mask /= 2) {
+        fp32x2_t other;
+        other.x = __shfl_xor_sync(uint32_t(-1), state.x, mask);
+        other.y = __shfl_xor_sync(uint32_t(-1), state.y, mask);
+        state = online_softmax_merge(state, other);
+    }
+
+    __shared__ fp32x2_t shared_state[WPT];
+    if (lane_id == 0) shared_state[warp_id] = state;
+    __syncthreads();
+
+    state = shared_state[0];
+    #pragma unroll
+    for (int32_t i = 1; i < WPT; i++) {
+        state = online_softmax_merge(state, shared_state[i]);
+    }
+    __syncthreads();
+    return state;
+}
+
+/**
+ * @brief Block-wide argmax over (value, token id) pairs.
+ * Ties are broken towards the smaller token id so that the result is deterministic.
+ * The winner is broadcast to all threads.
+ */
+template<int32_t TPB>
+__device__ inline
+void sync_block_reduce_argmax(fp32_t& val, int64_t& id) {
+    constexpr int32_t WARP_SIZE = 32;
+    constexpr int32_t WPT = TPB / WARP_SIZE;
+    const int32_t lane_id = threadIdx.x % WARP_SIZE;
+    const int32_t warp_id = threadIdx.x / WARP_SIZE;
+
+    #pragma unroll
+    for (int32_t mask = WARP_SIZE / 2; mask >= 1; mask /= 2) {
+        const fp32_t other_val = __shfl_xor_sync(uint32_t(-1), val, mask);
+        const int64_t other_id = __shfl_xor_sync(uint32_t(-1), id, mask);
+        if (other_val > val || (other_val == val && other_id < id)) {
+            val = other_val;
+            id = other_id;
+        }
+    }
+
+    __shared__ fp32_t shared_val[WPT];
+    __shared__ int64_t shared_id[WPT];
+    if (lane_id == 0) {
+        shared_val[warp_id] = val;
+        shared_id[warp_id] = id;
+    }
+    __syncthreads();
+
+    val = shared_val[0];
+    id = shared_id[0];
+    #pragma unroll
+    for (int32_t i = 1; i < WPT; i++) {
+        if (shared_val[i] > val || (shared_val[i] == val && shared_id[i] < id)) {
+            val = shared_val[i];
+            id = shared_id[i];
+        }
+    }
+    __syncthreads();
+}
+
+/**
+ * @brief Insert (x, id) into a thread-local list sorted in descending order.
+ * All indices are static after unrolling so the list stays in registers.
+ */
+template<int32_t MAX_N>
+__device__ inline
+void topn_insert(fp32_t (&top_val)[MAX_N], int64_t (&top_id)[MAX_N], const fp32_t x, const int64_t id) {
+    if (x > top_val[MAX_N - 1]) {
+        top_val[MAX_N - 1] = x;
+        top_id[MAX_N - 1] = id;
+        #pragma unroll
+        for (int32_t j = MAX_N - 1; j > 0; j--) {
+            if (top_val[j] > top_val[j - 1]) {
+                const fp32_t tv = top_val[j]; top_val[j] = top_val[j - 1]; top_val[j - 1] = tv;
+                const int64_t ti = top_id[j]; top_id[j] = top_id[j - 1]; top_id[j - 1] = ti;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Fused log-softmax statistics + top-N selection over one vocabulary shard.
+ *
+ * Each block processes one row of logits in a single pass: every thread keeps an
+ * online (max, sum of exp) state and a sorted register list of its MAX_N best logits.
+ * The states are merged with one block reduction, and the global top-N is extracted
+ * with N rounds of block argmax over the heads of the thread-local lists.
+ * The full log_softmax is never written.
+ *
+ * @tparam TPB    Threads per block.
+ * @tparam MAX_N  Capacity of the thread-local top list, must be >= topn.
+ * @tparam VPT    Number of logits loaded per vectorized access (1 for the scalar path).
+ *
+ * @param logits        [B, V] logits of the shard, row stride = logits_stride.
+ * @param sampled_ids   [B] global ids of the sampled tokens.
+ * @param topn_vals     [B, topn] top logits (or logprobs if normalize), descending.
+ * @param topn_ids      [B, topn] global token ids of topn_vals.
+ * @param sampled_vals  [B] logit (or logprob) of the sampled token, -inf if outside the shard.
+ * @param stats         [B, 2] (row max, sum of exp(x - max)) of the shard.
+ */
+template<int32_t TPB, int32_t MAX_N, int32_t VPT, typename T>
+__global__
+void device_logprobs_topn_partial(
+    const T* __restrict__ logits,
+    const int64_t* __restrict__ sampled_ids,
+    fp32_t* __restrict__ topn_vals,
+    int64_t* __restrict__ topn_ids,
+    fp32_t* __restrict__ sampled_vals,
+    fp32_t* __restrict__ stats,
+    const int64_t V,
+    const int64_t logits_stride,
+    const int64_t vocab_start,
+    const int32_t topn,
+    const bool normalize
+) {
+    const int32_t tid = threadIdx.x;
+    const int64_t bid = blockIdx.x;
+    const T* _logits = logits + bid * logits_stride;
+
+    fp32x2_t state = make_float2(-FLT_MAX, 0.0f);
+    fp32_t top_val[MAX_N];
+    int64_t top_id[MAX_N];
+    #pragma unroll
+    for (int32_t j = 0; j < MAX_N; j++) {
+        top_val[j] = -INFINITY;
+        top_id[j] = -1;
+    }
+
+    // Single streaming pass over the vocabulary.
+    for (int64_t i = (int64_t)tid * VPT; i < V; i += (int64_t)TPB * VPT) {
+        T local_x[VPT];
+        if constexpr (VPT > 1) {
+            vec_copy<sizeof(T) * VPT>(_logits + i, local_x);
+        } else {
+            local_x[0] = _logits[i];
+        }
+
+        #pragma unroll
+        for (int32_t j = 0; j < VPT; j++) {
+            const fp32_t x = static_cast<fp32_t>(local_x[j]);
+            if (x > state.x) {
+                state.y = state.y * __expf(state.x - x) + 1.0f;
+                state.x = x;
+            } else {
+                state.y += __expf(x - state.x);
+            }
+            topn_insert<MAX_N>(top_val, top_id, x, vocab_start + i + j);
+        }
+    }
+
+    state = sync_block_reduce_online_softmax<TPB>(state);
+    const fp32_t lse = normalize ? state.x + __logf(state.y) : 0.0f;
+
+    // Extract the block top-N: each round the thread owning the winner pops its head.
+    for (int32_t k = 0; k < topn; k++) {
+        fp32_t val = top_val[0];
+        int64_t id = top_id[0] < 0 ? INT64_MAX : top_id[0];
+        sync_block_reduce_argmax<TPB>(val, id);
+
+        if (id == top_id[0]) {
+            #pragma unroll
+            for (int32_t j = 0; j < MAX_N - 1; j++) {
+                top_val[j] = top_val[j + 1];
+                top_id[j] = top_id[j + 1];
+            }
+            top_val[MAX_N - 1] = -INFINITY;
+            top_id[MAX_N - 1] = -1;
+        }
+        if (tid == 0) {
+            topn_vals[bid * topn + k] = val - lse;
+            topn_ids[bid * topn + k] = id == INT64_MAX ? -1 : id;
+        }
+    }
+
+    if (tid == 0) {
+        const int64_t local_id = sampled_ids[bid] - vocab_start;
+        sampled_vals[bid] = (local_id >= 0 && local_id < V)
+            ? static_cast<fp32_t>(_logits[local_id]) - lse
+            : -INFINITY;
+        stats[bid * 2 + 0] = state.x;
+        stats[bid * 2 + 1] = state.y;
+    }
+}
+
+/**
+ * @brief Merge the partial results of S vocabulary shards into final logprobs.
+ *
+ * One thread per row. The shard lists are already sorted, so the global top-N
+ * is an S-way merge of the list heads.
+ *
+ * @param stats         [S, B, 2] per-shard (max, sum of exp).
+ * @param topn_vals     [S, B, topn] per-shard raw top logits, descending.
+ * @param topn_ids      [S, B, topn] per-shard global token ids.
+ * @param sampled_vals  [S, B] per-shard raw sampled logit, -inf outside the owning shard.
+ */
+template<int32_t MAX_SHARDS>
+__global__
+void device_logprobs_topn_merge(
+    const fp32_t* __restrict__ stats,
+    const fp32_t* __restrict__ topn_vals,
+    const int64_t* __restrict__ topn_ids,
+    const fp32_t* __restrict__ sampled_vals,
+    fp32_t* __restrict__ out_logprobs,
+    int64_t* __restrict__ out_ids,
+    fp32_t* __restrict__ out_sampled,
+    const int32_t S,
+    const int64_t B,
+    const int32_t topn
+) {
+    const int64_t row = (int64_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (row >= B) return;
+
+    fp32x2_t state = make_float2(-FLT_MAX, 0.0f);
+    fp32_t sampled = -INFINITY;
+    for (int32_t s = 0; s < S; s++) {
+        const fp32_t* _stats = stats + (s * B + row) * 2;
+        state = online_softmax_merge(state, make_float2(_stats[0], _stats[1]));
+        sampled = fmaxf(sampled, sampled_vals[s * B + row]);
+    }
+    const fp32_t lse = state.x + __logf(state.y);
+
+    int32_t heads[MAX_SHARDS];
+    for (int32_t s = 0; s < S; s++) heads[s] = 0;
+
+    for (int32_t k = 0; k < topn; k++) {
+        int32_t best = -1;
+        fp32_t best_val = -INFINITY;
+        int64_t best_id = INT64_MAX;
+        for (int32_t s = 0; s < S; s++) {
+            if (heads[s] >= topn) continue;
+            const int64_t offset = (s * B + row) * topn + heads[s];
+            const int64_t id = topn_ids[offset];
+            if (id < 0) continue;
+            const fp32_t val = topn_vals[offset];
+            if (best < 0 || val > best_val || (val == best_val && id < best_id)) {
+                best = s;
+                best_val = val;
+                best_id = id;
+            }
+        }
+        if (best >= 0) heads[best]++;
+        out_logprobs[row * topn + k] = best_val - lse;
+        out_ids[row * topn + k] = best < 0 ? -1 : best_id;
+    }
+    out_sampled[row] = sampled - lse;
+}
+
+template<int32_t MAX_N, typename T>
+void run_logprobs_topn_partial(
+    const T* logits, const int64_t* sampled_ids,
+    fp32_t* topn_vals, int64_t* topn_ids, fp32_t* sampled_vals, fp32_t* stats,
+    const int64_t B, const int64_t V, const int64_t logits_stride,
+    const int64_t vocab_start, const int32_t topn, const bool normalize,
+    cudaStream_t stream
+) {
+    static constexpr int32_t TPB = 512;
+    constexpr int32_t VPT = 16 / sizeof(T);
+    const bool aligned = V % VPT == 0 && logits_stride % VPT == 0
+        && reinterpret_cast<uintptr_t>(logits) % 16 == 0;
+    if (aligned) {
+        device_logprobs_topn_partial<TPB, MAX_N, VPT, T>
+        <<<B, TPB, 0, stream>>>(
+            logits, sampled_ids, topn_vals, topn_ids, sampled_vals, stats,
+            V, logits_stride, vocab_start, topn, normalize
+        );
+    } else {
+        device_logprobs_topn_partial<TPB, MAX_N, 1, T>
+        <<<B, TPB, 0, stream>>>(
+            logits, sampled_ids, topn_vals, topn_ids, sampled_vals, stats,
+            V, logits_stride, vocab_start, topn, normalize
+        );
+    }
+}
+
+template<typename T>
+void dispatch_logprobs_topn_partial(
+    const T* logits, const int64_t* sampled_ids,
+    fp32_t* topn_vals, int64_t* topn_ids, fp32_t* sampled_vals, fp32_t* stats,
+    const int64_t B, const int64_t V, const int64_t logits_stride,
+    const int64_t vocab_start, const int32_t topn, const bool normalize,
+    cudaStream_t stream
+) {
+    // The thread-local list lives in registers, so keep its capacity close to topn.
+    if (topn <= 1) {
+        run_logprobs_topn_partial<1, T>(
+            logits, sampled_ids, topn_vals, topn_ids, sampled_vals, stats,
+            B, V, logits_stride, vocab_start, topn, normalize, stream);
+    } else if (topn <= 8) {
+        run_logprobs_topn_partial<8, T>(
+            logits, sampled_ids, topn_vals, topn_ids, sampled_vals, stats,
+            B, V, logits_stride, vocab_start, topn, normalize, stream);
+    } else if (topn <= 20) {
+        run_logprobs_topn_partial<20, T>(
+            logits, sampled_ids, topn_vals, topn_ids, sampled_vals, stats,
+            B, V, logits_stride, vocab_start, topn, normalize, stream);
+    } else {
+        run_logprobs_topn_partial<32, T>(
+            logits, sampled_ids, topn_vals, topn_ids, sampled_vals, stats,
+            B, V, logits_stride, vocab_start, topn, normalize, stream);
+    }
+}
+
+/**
+ * @brief CUDA backend of core::logprobs_topn_partial, the views are already validated.
+ */
+void logprobs_topn_partial_cuda(
+    const TensorView& topn_vals, const TensorView& topn_ids,
+    const TensorView& sampled_vals, const TensorView& stats,
+    const TensorView& logits, const TensorView& sampled_ids,
+    const int64_t vocab_start, const bool normalize
+) {
+    const int64_t B = logits.size(0);
+    const int64_t V = logits.size(1);
+    const int32_t topn = topn_vals.dim() == 2 ? topn_vals.size(1) : 0;
+    const cudaStream_t stream = static_cast<cudaStream_t>(logits.stream);
+
+    auto run = [&](auto type_tag) {
+        using T = decltype(type_tag);
+        dispatch_logprobs_topn_partial<T>(
+            logits.data_ptr<const T>(), sampled_ids.data_ptr<const int64_t>(),
+            topn_vals.data_ptr<fp32_t>(), topn_ids.data_ptr<int64_t>(),
+            sampled_vals.data_ptr<fp32_t>(), stats.data_ptr<fp32_t>(),
+            B, V, logits.stride(0), vocab_start, topn, normalize, stream
+        );
+    };
+
+    switch (logits.dtype) {
+        case DType::Float32: run(fp32_t{}); break;
+        case DType::Float16: run(fp16_t{}); break;
+        case DType::BFloat16: run(bf16_t{}); break;
+        default: LK_NOT_SUPPORTED("logprobs_topn_partial does not support ", dtype_name(logits.dtype));
+    }
+}
+
+/**
+ * @brief CUDA backend of core::logprobs_topn_merge, the views are already validated.
+ */
+void logprobs_topn_merge_cuda(
+    const TensorView& out_logprobs, const TensorView& out_ids, const TensorView& out_sampled,
+    const TensorView& stats, const TensorView& topn_vals,
+    const TensorView& topn_ids, const TensorView& sampled_vals
+) {
+    const int32_t S = stats.size(0);
+    const int64_t B = stats.size(1);
+    const int32_t topn = topn_vals.dim() == 3 ? topn_vals.size(2) : 0;
+    if (S > 16) LK_NOT_SUPPORTED("logprobs_topn_merge supports at most 16 shards on CUDA");
+
+    static constexpr int32_t TPB = 128;
+    device_logprobs_topn_merge<16>
+    <<<Cdiv<int64_t>(B, TPB), TPB, 0, static_cast<cudaStream_t>(stats.stream)>>>(
+        stats.data_ptr<const fp32_t>(), topn_vals.data_ptr<const fp32_t>(),
+        topn_ids.data_ptr<const int64_t>(), sampled_vals.data_ptr<const fp32_t>(),
+        out_logprobs.data_ptr<fp32_t>(), out_ids.data_ptr<int64_t>(),
+        out_sampled.data_ptr<fp32_t>(), S, B, topn
+    );
+}
+
+} // namespace core
+} // namespace lightllm
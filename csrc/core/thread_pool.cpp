@@ -0,0 +1,132 @@
+#include "core/thread_pool.h"
+
+#include <cstdlib>
+#include <memory>
+
+namespace lightllm {
+namespace core {
+
+namespace {
+
+thread_local bool tls_in_parallel_region = false;
+
+int32_t default_num_threads() {
+    if (const char* env = std::getenv("LIGHTLLM_NUM_THREADS")) {
+        const int32_t n = std::atoi(env);
+        if (n > 0) return n;
+    }
+    const int32_t n = static_cast<int32_t>(std::thread::hardware_concurrency());
+    return n > 0 ? n : 1;
+}
+
+std::mutex global_pool_mutex;
+std::unique_ptr<ThreadPool> global_pool;
+
+} // namespace
+
+ThreadPool::ThreadPool(int32_t num_threads) {
+    for (int32_t i = 1; i < num_threads; i++) {
+        workers_.emplace_back([this] { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+bool ThreadPool::in_parallel_region() { return tls_in_parallel_region; }
+
+void ThreadPool::work_on(const std::function<void(int64_t)>& fn, const uint64_t generation) {
+    tls_in_parallel_region = true;
+    while (true) {
+        int64_t task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // A worker woken late must not run tasks of a newer run with a stale fn.
+            if (generation_ != generation || next_task_ >= num_tasks_) break;
+            task = next_task_++;
+        }
+        try {
+            fn(task);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (++finished_tasks_ == num_tasks_) done_cv_.notify_all();
+    }
+    tls_in_parallel_region = false;
+}
+
+void ThreadPool::worker_loop() {
+    uint64_t seen = 0;
+    while (true) {
+        const std::function<void(int64_t)>* fn;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation = generation_;
+            fn = fn_;
+        }
+        // woken after the run already finished
+        if (fn == nullptr) continue;
+        work_on(*fn, generation);
+    }
+}
+
+void ThreadPool::run(int64_t num_tasks, const std::function<void(int64_t)>& fn) {
+    if (num_tasks <= 0) return;
+    if (workers_.empty() || num_tasks == 1 || tls_in_parallel_region) {
+        for (int64_t task = 0; task < num_tasks; task++) fn(task);
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        num_tasks_ = num_tasks;
+        next_task_ = 0;
+        finished_tasks_ = 0;
+        error_ = nullptr;
+        generation = ++generation_;
+    }
+    wake_cv_.notify_all();
+    work_on(fn, generation);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [&] { return finished_tasks_ == num_tasks_; });
+        // Late workers must not pick up tasks of this run any more.
+        num_tasks_ = 0;
+        next_task_ = 0;
+        fn_ = nullptr;
+        std::swap(error, error_);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+ThreadPool& global_thread_pool() {
+    std::lock_guard<std::mutex> lock(global_pool_mutex);
+    if (!global_pool) global_pool = std::make_unique<ThreadPool>(default_num_threads());
+    return *global_pool;
+}
+
+void set_num_threads(int32_t num_threads) {
+    std::lock_guard<std::mutex> lock(global_pool_mutex);
+    global_pool = std::make_unique<ThreadPool>(std::max<int32_t>(num_threads, 1));
+}
+
+int32_t get_num_threads() { return global_thread_pool().num_threads(); }
+
+} // namespace core
+} // namespace lightllm
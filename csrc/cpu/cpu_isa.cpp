@@ -0,0 +1,27 @@
+#include "ops_common.h"
+#include "core/cpu_isa.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+/**
+ * @brief Forces the instruction set level of the CPU kernels, see core::set_cpu_isa.
+ *
+ * @param isa  "scalar", "avx2", "avx512", "avx512_bf16" or "amx", at most the detected level.
+ */
+void set_cpu_isa(const std::string& isa) {
+    core::set_cpu_isa(core::parse_cpu_isa(isa.c_str()));
+}
+
+/**
+ * @brief Name of the active instruction set level of the CPU kernels, or of
+ * the highest one this CPU supports when detected is true.
+ */
+std::string get_cpu_isa(const bool detected) {
+    return core::cpu_isa_name(detected ? core::detected_cpu_isa() : core::active_cpu_isa());
+}
+
+} // namespace ops
+} // namespace lightllm
@@ -0,0 +1,93 @@
+#include "ops_common.h"
+#include "core/cpu_stream.h"
+
+#include <memory>
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+namespace py = pybind11;
+
+namespace {
+
+core::CpuStream* stream(int64_t _stream) {
+    return reinterpret_cast<core::CpuStream*>(_stream);
+}
+
+const std::shared_ptr<core::CpuEvent>& event(int64_t _event) {
+    return *reinterpret_cast<std::shared_ptr<core::CpuEvent>*>(_event);
+}
+
+} // namespace
+
+/**
+ * @brief Create a CPU stream, see core::CpuStream.
+ *
+ * @return  Handle, release it with cpu_stream_dispose.
+ */
+int64_t init_cpu_stream() {
+    return reinterpret_cast<int64_t>(new core::CpuStream());
+}
+
+// Runs the queued work first, which may need the GIL.
+void cpu_stream_dispose(int64_t _stream) {
+    py::gil_scoped_release release;
+    delete stream(_stream);
+}
+
+/**
+ * @brief Enqueue a Python callable, it runs on the stream thread with the GIL
+ * held. The ops of this extension release the GIL while their kernels run, so
+ * the caller keeps going meanwhile. An exception of fn is sticky, see
+ * core::CpuStream; lightllm_kernel.ops.CpuStream.submit catches them instead.
+ */
+void cpu_stream_submit(int64_t _stream, py::function fn) {
+    // the last reference may be dropped by the stream thread, without the GIL
+    std::shared_ptr<py::object> owned(new py::object(std::move(fn)), [](py::object* o) {
+        py::gil_scoped_acquire acquire;
+        delete o;
+    });
+    stream(_stream)->enqueue([owned] {
+        py::gil_scoped_acquire acquire;
+        (*owned)();
+    });
+}
+
+/**
+ * @brief Record an event of the work enqueued so far.
+ *
+ * @return  Handle, release it with cpu_event_dispose.
+ */
+int64_t cpu_stream_record(int64_t _stream) {
+    return reinterpret_cast<int64_t>(new std::shared_ptr<core::CpuEvent>(stream(_stream)->record()));
+}
+
+void cpu_stream_wait_event(int64_t _stream, int64_t _event) {
+    stream(_stream)->wait(event(_event));
+}
+
+bool cpu_stream_query(int64_t _stream) {
+    return stream(_stream)->query();
+}
+
+void cpu_stream_synchronize(int64_t _stream) {
+    py::gil_scoped_release release;
+    stream(_stream)->synchronize();
+}
+
+bool cpu_event_query(int64_t _event) {
+    return event(_event)->query();
+}
+
+void cpu_event_synchronize(int64_t _event) {
+    py::gil_scoped_release release;
+    event(_event)->synchronize();
+}
+
+void cpu_event_dispose(int64_t _event) {
+    delete reinterpret_cast<std::shared_ptr<core::CpuEvent>*>(_event);
+}
+
+} // namespace ops
+} // namespace lightllm
@@ -64,6 +64,13 @@ void cutlass_scaled_mm(torch::Tensor& c, torch::Tensor const& a,
                 ls->dim() == 1);
   }
 
+  if (c.is_cpu()) {
+    core::scaled_mm(to_view(c), to_view(a), to_view(b), to_view(a_scales),
+                    to_view(b_scales), bias ? to_view(*bias) : core::TensorView(),
+                    ls ? to_view(*ls) : core::TensorView());
+    return;
+  }
+
   at::cuda::OptionalCUDAGuard const device_guard(device_of(a));
   int32_t version_num = get_sm_version_num();
 
@@ -0,0 +1,182 @@
+#include "ops_common.h"
+#include "core/kv_allocator.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+namespace {
+
+core::KvPageAllocator* allocator(int64_t _alloc) {
+    return reinterpret_cast<core::KvPageAllocator*>(_alloc);
+}
+
+} // namespace
+
+/**
+ * @brief Create a paged KV allocator, see core::KvPageAllocator.
+ *
+ * @param num_pages      Number of KV cache pages.
+ * @param page_size      Token slots per page.
+ * @param max_reqs       Number of request rows.
+ * @param max_seq_len    Max tokens per request.
+ * @param req_to_tokens  [>= max_reqs, >= max_seq_len] int32 CPU tensor, written in place.
+ *                       Only a view is kept, the caller keeps the tensor alive.
+ * @param page_precision Optional [num_pages] int8 CPU tensor of the downgrade
+ *                       tags, written in place like req_to_tokens.
+ * @return               Handle, release it with kv_allocator_dispose.
+ */
+int64_t init_kv_allocator(
+    int64_t num_pages, int64_t page_size,
+    int64_t max_reqs, int64_t max_seq_len,
+    Tensor& req_to_tokens,
+    const c10::optional<Tensor>& page_precision
+) {
+    return reinterpret_cast<int64_t>(new core::KvPageAllocator(
+        num_pages, page_size, max_reqs, max_seq_len, to_view(req_to_tokens),
+        page_precision.has_value() ? to_view(*page_precision) : core::TensorView()
+    ));
+}
+
+void kv_allocator_dispose(int64_t _alloc) {
+    delete allocator(_alloc);
+}
+
+int64_t kv_alloc_req(int64_t _alloc) {
+    return allocator(_alloc)->alloc_req();
+}
+
+/**
+ * @brief Release the rows of a batch of finished requests. Nothing is
+ * released if any row is not allocated or appears twice.
+ *
+ * @param reqs  [n] int32 CPU tensor of request rows.
+ */
+void kv_free_reqs(int64_t _alloc, const Tensor& reqs) {
+    TORCH_CHECK(reqs.is_cpu() && reqs.scalar_type() == torch::kInt32, "reqs must be an int32 CPU tensor");
+    Tensor r = reqs.contiguous();
+    allocator(_alloc)->free_reqs(r.data_ptr<int32_t>(), static_cast<int32_t>(r.numel()));
+}
+
+int64_t kv_fork(int64_t _alloc, int64_t src, int64_t prefix_len) {
+    return allocator(_alloc)->fork(src, prefix_len);
+}
+
+/**
+ * @brief Allocate the KV slots of one scheduler step.
+ *
+ * @param reqs     [n] int32 CPU tensor of request rows, no duplicates.
+ * @param num_new  [n] int32 CPU tensor, tokens appended to each request.
+ * @return         (ok, slots [sum(num_new)] int32, copies [c, 3] int32 rows of
+ *                 (src_page, dst_page, num_tokens) to apply to the KV cache
+ *                 before the step runs). ok is false and nothing is allocated
+ *                 if the free pages do not cover the batch.
+ */
+std::tuple<bool, Tensor, Tensor> kv_extend(
+    int64_t _alloc, const Tensor& reqs, const Tensor& num_new
+) {
+    TORCH_CHECK(reqs.is_cpu() && reqs.scalar_type() == torch::kInt32, "reqs must be an int32 CPU tensor");
+    TORCH_CHECK(num_new.is_cpu() && num_new.scalar_type() == torch::kInt32, "num_new must be an int32 CPU tensor");
+    TORCH_CHECK(reqs.numel() == num_new.numel(), "reqs and num_new must have the same length");
+    Tensor r = reqs.contiguous();
+    Tensor n = num_new.contiguous();
+
+    const int64_t total = n.sum().item<int64_t>();
+    Tensor slots = torch::empty({total}, r.options());
+    std::vector<core::KvPageCopy> copies;
+    const bool ok = allocator(_alloc)->extend(
+        r.data_ptr<int32_t>(), n.data_ptr<int32_t>(), static_cast<int32_t>(r.numel()),
+        slots.data_ptr<int32_t>(), &copies
+    );
+    static_assert(sizeof(core::KvPageCopy) == 3 * sizeof(int32_t), "KvPageCopy is three int32");
+    Tensor out_copies = torch::empty({static_cast<int64_t>(copies.size()), 3}, r.options());
+    if (!copies.empty()) std::memcpy(out_copies.data_ptr<int32_t>(), copies.data(), copies.size() * sizeof(core::KvPageCopy));
+    return {ok, ok ? slots : slots.narrow(0, 0, 0), out_copies};
+}
+
+/**
+ * @brief Compaction plan, see core::KvPageAllocator::compact.
+ *
+ * @return  [c, 3] int32 rows of (src_page, dst_page, num_tokens), to apply
+ *          with kv_copy_slots before the next step.
+ */
+Tensor kv_compact(int64_t _alloc) {
+    std::vector<core::KvPageCopy> moves;
+    allocator(_alloc)->compact(&moves);
+    Tensor out = torch::empty({static_cast<int64_t>(moves.size()), 3}, torch::kInt32);
+    if (!moves.empty()) std::memcpy(out.data_ptr<int32_t>(), moves.data(), moves.size() * sizeof(core::KvPageCopy));
+    return out;
+}
+
+void kv_truncate(int64_t _alloc, int64_t req, int64_t new_len) {
+    allocator(_alloc)->truncate(req, new_len);
+}
+
+/**
+ * @brief Rewrite a request to the kept positions, see core::KvPageAllocator::evict.
+ *
+ * @param keep  [n_keep] int32 CPU tensor of ascending positions, e.g. from kv_evict_select.
+ * @return      (ok, pairs [p, 2] int32 rows of (src_slot, dst_slot)). The
+ *              moves may chain, apply them with kv_pack then kv_unpack before
+ *              the next step. ok is false and nothing changes if the pages a
+ *              copy-on-write needs are not free.
+ */
+std::tuple<bool, Tensor> kv_evict(int64_t _alloc, int64_t req, const Tensor& keep) {
+    TORCH_CHECK(keep.is_cpu() && keep.scalar_type() == torch::kInt32, "keep must be an int32 CPU tensor");
+    Tensor k = keep.contiguous();
+    std::vector<int32_t> pairs;
+    const bool ok = allocator(_alloc)->evict(req, k.data_ptr<int32_t>(), static_cast<int32_t>(k.numel()), &pairs);
+    Tensor out = torch::empty({static_cast<int64_t>(pairs.size() / 2), 2}, k.options());
+    if (!pairs.empty()) std::memcpy(out.data_ptr<int32_t>(), pairs.data(), pairs.size() * sizeof(int32_t));
+    return {ok, out};
+}
+
+/**
+ * @brief Tokens a request keeps, see core::kv_evict_select.
+ *
+ * @param attn_mass  fp32 [Hkv, max_len] CPU row of the request, compacted in place.
+ * @return           [n_keep] int32 ascending positions.
+ */
+Tensor kv_evict_select(
+    Tensor& attn_mass, int64_t seq_len, int64_t budget, int64_t num_sink, int64_t num_recent
+) {
+    core::KvEvictPolicy policy;
+    policy.num_sink = num_sink;
+    policy.num_recent = num_recent;
+    Tensor keep = torch::empty({std::min(seq_len, budget)}, torch::kInt32);
+    core::kv_evict_select(to_view(attn_mass), seq_len, budget, policy, keep.data_ptr<int32_t>());
+    return keep;
+}
+
+/**
+ * @brief Free pages by downgrading cold ones, see core::KvPageAllocator::downgrade.
+ *
+ * @return  [n, 2] int32 rows of (p, q) pages to convert with kv_downgrade_pages
+ *          before the next extend, one per freed page.
+ */
+Tensor kv_downgrade(int64_t _alloc, int64_t num_pages, int64_t num_sink_pages, int64_t num_recent_pages) {
+    core::KvDowngradePolicy policy;
+    policy.num_sink_pages = num_sink_pages;
+    policy.num_recent_pages = num_recent_pages;
+    std::vector<int32_t> pairs;
+    allocator(_alloc)->downgrade(num_pages, policy, &pairs);
+    Tensor out = torch::empty({static_cast<int64_t>(pairs.size() / 2), 2}, torch::kInt32);
+    if (!pairs.empty()) std::memcpy(out.data_ptr<int32_t>(), pairs.data(), pairs.size() * sizeof(int32_t));
+    return out;
+}
+
+int64_t kv_seq_len(int64_t _alloc, int64_t req) {
+    return allocator(_alloc)->seq_len(req);
+}
+
+int64_t kv_num_free_pages(int64_t _alloc) {
+    return allocator(_alloc)->num_free_pages();
+}
+
+int64_t kv_num_free_reqs(int64_t _alloc) {
+    return allocator(_alloc)->num_free_reqs();
+}
+
+} // namespace ops
+} // namespace lightllm
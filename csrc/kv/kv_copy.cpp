@@ -0,0 +1,47 @@
+#include "ops_common.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+/**
+ * @brief PyTorch entry of core::kv_copy_slots.
+ *
+ * @param caches    KV cache tensors moved together, e.g. [k, v, k_s, v_s].
+ * @param pairs     [n, 2] int32 (src_slot, dst_slot) on the device of the caches.
+ * @param slot_dim  0 for [slots, ...] caches, 1 for [layers, slots, ...].
+ */
+void kv_copy_slots(
+    const std::vector<Tensor>& caches, const Tensor& pairs, const int64_t slot_dim
+) {
+    std::vector<core::TensorView> views;
+    views.reserve(caches.size());
+    for (const Tensor& c : caches) views.push_back(to_view(c));
+    Tensor contiguous_pairs = pairs.is_contiguous() ? pairs : pairs.contiguous();
+    core::kv_copy_slots(views, to_view(contiguous_pairs), slot_dim);
+}
+
+/**
+ * @brief PyTorch entry of core::kv_downgrade_pages.
+ *
+ * @param caches     [slots, Hkv, D] int8 / bf16 / fp16 caches, e.g. the k and v of every layer.
+ * @param scales     [slots, Hkv, D / 8] scales of every cache.
+ * @param pairs      [n, 2] int32 (p, q) pages on the device of the caches.
+ * @param page_size  Slots per page.
+ */
+void kv_downgrade_pages(
+    const std::vector<Tensor>& caches, const std::vector<Tensor>& scales, const Tensor& pairs, const int64_t page_size
+) {
+    TORCH_CHECK(caches.size() == scales.size(), "kv_downgrade_pages takes one scale tensor per cache");
+    std::vector<core::TensorView> cache_views, scale_views;
+    for (size_t i = 0; i < caches.size(); i++) {
+        cache_views.push_back(to_view(caches[i]));
+        scale_views.push_back(to_view(scales[i]));
+    }
+    Tensor contiguous_pairs = pairs.is_contiguous() ? pairs : pairs.contiguous();
+    core::kv_downgrade_pages(cache_views, scale_views, to_view(contiguous_pairs), page_size);
+}
+
+} // namespace ops
+} // namespace lightllm
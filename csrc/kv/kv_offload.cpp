@@ -0,0 +1,96 @@
+#include "ops_common.h"
+#include "core/kv_offload.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+namespace {
+
+core::KvOffloadEngine* engine(int64_t _engine) {
+    return reinterpret_cast<core::KvOffloadEngine*>(_engine);
+}
+
+std::vector<core::TensorView> views(const std::vector<Tensor>& caches) {
+    std::vector<core::TensorView> v;
+    v.reserve(caches.size());
+    for (const Tensor& c : caches) v.push_back(to_view(c));
+    return v;
+}
+
+} // namespace
+
+/**
+ * @brief Create a KV offload engine, see core::KvOffloadEngine.
+ *
+ * @param host_arena  Contiguous CPU tensor backing the host tier, pinned for
+ *                    CUDA caches. Only a view is kept, the caller keeps it alive.
+ * @param disk_path   File of the disk tier, empty for none.
+ * @param disk_bytes  Size of the disk tier.
+ * @return            Handle, release it with kv_offload_dispose.
+ */
+int64_t init_kv_offload(Tensor& host_arena, const std::string& disk_path, int64_t disk_bytes) {
+    return reinterpret_cast<int64_t>(new core::KvOffloadEngine(to_view(host_arena), disk_path, disk_bytes));
+}
+
+void kv_offload_dispose(int64_t _engine) {
+    delete engine(_engine);
+}
+
+/**
+ * @brief Pack the rows of slots of caches (e.g. [k, v, k_s, v_s]) under key.
+ *
+ * @param slots     [n] int32 slots, on the device of the caches.
+ * @param slot_dim  0 for [slots, ...] caches, 1 for [layers, slots, ...].
+ * @return          False if neither tier has room.
+ */
+bool kv_offload(
+    int64_t _engine, int64_t key, const std::vector<Tensor>& caches,
+    const Tensor& slots, int64_t slot_dim
+) {
+    Tensor contiguous_slots = slots.is_contiguous() ? slots : slots.contiguous();
+    return engine(_engine)->offload(key, views(caches), to_view(contiguous_slots), slot_dim);
+}
+
+void kv_offload_prefetch(int64_t _engine, int64_t key, int64_t priority) {
+    engine(_engine)->request_prefetch(key, priority);
+}
+
+std::vector<int64_t> kv_offload_issue_prefetches(int64_t _engine, int64_t budget_bytes) {
+    return engine(_engine)->issue_prefetches(budget_bytes);
+}
+
+bool kv_offload_ready(int64_t _engine, int64_t key) {
+    return engine(_engine)->ready(key);
+}
+
+void kv_offload_wait(int64_t _engine, int64_t key) {
+    engine(_engine)->wait(key);
+}
+
+void kv_offload_restore(
+    int64_t _engine, int64_t key, const std::vector<Tensor>& caches,
+    const Tensor& slots, int64_t slot_dim
+) {
+    Tensor contiguous_slots = slots.is_contiguous() ? slots : slots.contiguous();
+    engine(_engine)->restore(key, views(caches), to_view(contiguous_slots), slot_dim);
+}
+
+void kv_offload_drop(int64_t _engine, int64_t key) {
+    engine(_engine)->drop(key);
+}
+
+// 0: not offloaded, 1: host, 2: disk
+int64_t kv_offload_tier(int64_t _engine, int64_t key) {
+    return static_cast<int64_t>(engine(_engine)->tier(key));
+}
+
+// (host free bytes, disk free bytes, measured disk read bandwidth in bytes/s)
+std::tuple<int64_t, int64_t, double> kv_offload_stats(int64_t _engine) {
+    core::KvOffloadEngine* e = engine(_engine);
+    return {e->host_free_bytes(), e->disk_free_bytes(), e->io_bandwidth()};
+}
+
+} // namespace ops
+} // namespace lightllm
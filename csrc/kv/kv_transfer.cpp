@@ -0,0 +1,66 @@
+#include "ops_common.h"
+#include "core/kv_transfer.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+namespace {
+
+std::vector<core::TensorView> cache_views(const std::vector<Tensor>& caches) {
+    std::vector<core::TensorView> views;
+    views.reserve(caches.size());
+    for (const Tensor& c : caches) views.push_back(to_view(c));
+    return views;
+}
+
+} // namespace
+
+/**
+ * @brief Bytes of a KV transfer buffer for num_tokens slots of caches.
+ */
+int64_t kv_transfer_bytes(const std::vector<Tensor>& caches, const int64_t slot_dim, const int64_t num_tokens) {
+    return core::kv_transfer_bytes(core::make_kv_transfer_header(cache_views(caches), slot_dim, num_tokens, 0));
+}
+
+/**
+ * @brief PyTorch entry of core::kv_pack.
+ *
+ * @param caches    KV cache tensors moved together, e.g. [k, v, k_s, v_s].
+ * @param slots     [n] int32 slots of the request, in token order.
+ * @param slot_dim  0 for [slots, ...] caches, 1 for [layers, slots, ...].
+ * @param tag       Stored in the header, e.g. the request id.
+ * @param buffer    Contiguous uint8 buffer of >= kv_transfer_bytes bytes, on the
+ *                  device of the caches or pinned host memory.
+ */
+void kv_pack(
+    const std::vector<Tensor>& caches, const Tensor& slots, const int64_t slot_dim,
+    const int64_t tag, Tensor& buffer
+) {
+    Tensor s = slots.is_contiguous() ? slots : slots.contiguous();
+    core::kv_pack(cache_views(caches), to_view(s), slot_dim, tag, to_view(buffer));
+}
+
+/**
+ * @brief (num_tokens, tag) from the header of a received transfer buffer.
+ */
+std::tuple<int64_t, int64_t> kv_transfer_info(const Tensor& buffer) {
+    const core::KvTransferHeader h = core::read_kv_transfer_header(to_view(buffer));
+    return {h.num_tokens, h.tag};
+}
+
+/**
+ * @brief PyTorch entry of core::kv_unpack: writes the rows of buffer into
+ * slots ([num_tokens] distinct int32 slots) of caches.
+ */
+void kv_unpack(
+    const std::vector<Tensor>& caches, const Tensor& slots, const int64_t slot_dim,
+    const Tensor& buffer
+) {
+    Tensor s = slots.is_contiguous() ? slots : slots.contiguous();
+    core::kv_unpack(cache_views(caches), to_view(s), slot_dim, to_view(buffer));
+}
+
+} // namespace ops
+} // namespace lightllm
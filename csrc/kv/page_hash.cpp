@@ -0,0 +1,34 @@
+#include "ops_common.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+/**
+ * @brief Chained per-page hashes for prefix cache lookups, see core::page_hashes.
+ *
+ * @param tokens     [B, L] int32 / int64 CPU token ids.
+ * @param lens       [B] int32 / int64 CPU valid lengths.
+ * @param page_size  Tokens per page.
+ * @param seed       Root of the chains.
+ * @param bits       64 or 128.
+ * @return           [B, L / page_size] (64-bit) or [B, L / page_size, 2] (128-bit)
+ *                   int64, 0 for pages that are not full.
+ */
+Tensor page_hashes(
+    const Tensor& tokens, const Tensor& lens, const int64_t page_size,
+    const int64_t seed, const int64_t bits
+) {
+    TORCH_CHECK(bits == 64 || bits == 128, "bits must be 64 or 128");
+    TORCH_CHECK(page_size > 0, "page_size must be > 0");
+    Tensor t = tokens.stride(-1) == 1 ? tokens : tokens.contiguous();
+    Tensor l = lens.is_contiguous() ? lens : lens.contiguous();
+    const int64_t words = bits / 64;
+    Tensor out = torch::empty({t.size(0), t.size(1) / page_size, words}, t.options().dtype(torch::kInt64));
+    core::page_hashes(to_view(t), to_view(l), page_size, static_cast<uint64_t>(seed), to_view(out));
+    return bits == 64 ? out.squeeze(-1) : out;
+}
+
+} // namespace ops
+} // namespace lightllm
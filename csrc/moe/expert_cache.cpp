@@ -0,0 +1,93 @@
+#include "ops_common.h"
+#include "core/expert_cache.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+namespace {
+
+core::ExpertCache* cache(int64_t _cache) {
+    return reinterpret_cast<core::ExpertCache*>(_cache);
+}
+
+} // namespace
+
+/**
+ * @brief Create an expert weight cache, see core::ExpertCache.
+ *
+ * @param host_weights        [L, E, B] uint8 CPU tensor (pinned for a CUDA pool), one blob per expert.
+ * @param pool                [S, B] uint8 CPU or CUDA tensor of the resident experts. Copies into a
+ *                            CUDA pool run on the stream current at creation. Only views are kept,
+ *                            the caller keeps both tensors alive.
+ * @param eviction            0 for LRU, 1 for LFU.
+ * @param prefetch_per_layer  Experts of the next layer prefetched per access, 0 turns the predictor off.
+ * @param fetch_misses        Whether access() waits for the copies of missing experts.
+ * @param decay               Per step decay of the LFU counts and the predictor prior.
+ * @return                    Handle, release it with expert_cache_dispose.
+ */
+int64_t init_expert_cache(
+    const Tensor& host_weights, Tensor& pool, int64_t eviction, int64_t prefetch_per_layer,
+    bool fetch_misses, double decay
+) {
+    TORCH_CHECK(eviction == 0 || eviction == 1, "eviction must be 0 (LRU) or 1 (LFU)");
+    core::ExpertCacheOptions options;
+    options.eviction = static_cast<core::ExpertEviction>(eviction);
+    options.prefetch_per_layer = static_cast<int32_t>(prefetch_per_layer);
+    options.fetch_misses = fetch_misses;
+    options.decay = static_cast<float>(decay);
+    return reinterpret_cast<int64_t>(new core::ExpertCache(to_view(host_weights), to_view(pool), options));
+}
+
+void expert_cache_dispose(int64_t _cache) {
+    delete cache(_cache);
+}
+
+/**
+ * @brief Route one MoE layer through the cache.
+ *
+ * @param topk_ids      [T, K] int32 CPU experts of every token.
+ * @param topk_weights  [T, K] fp32 CPU routing weights.
+ * @return              [E] int32 CPU pool slot of every expert of the layer,
+ *                      -1 if it is not resident, the residency of hybrid_moe_partition.
+ */
+Tensor expert_cache_access(int64_t _cache, int64_t layer, const Tensor& topk_ids, const Tensor& topk_weights) {
+    TORCH_CHECK(topk_ids.is_cpu() && topk_weights.is_cpu(), "the routing must be in host memory");
+    Tensor ids = topk_ids.to(torch::kInt32).contiguous();
+    Tensor weights = topk_weights.to(torch::kFloat32).contiguous();
+    Tensor residency = torch::empty({cache(_cache)->num_experts()}, ids.options());
+    cache(_cache)->access(layer, to_view(ids), to_view(weights), to_view(residency));
+    return residency;
+}
+
+int64_t expert_cache_prefetch(int64_t _cache, int64_t layer, const std::vector<int64_t>& experts) {
+    return cache(_cache)->prefetch(layer, std::vector<int32_t>(experts.begin(), experts.end()));
+}
+
+int64_t expert_cache_slot(int64_t _cache, int64_t layer, int64_t expert) {
+    return cache(_cache)->slot(layer, expert);
+}
+
+void expert_cache_synchronize(int64_t _cache) {
+    cache(_cache)->synchronize();
+}
+
+/**
+ * @return (hits, misses, late_prefetches, prefetches, useful_prefetches,
+ *         evictions, bytes_copied, stall_seconds) since the last reset.
+ */
+std::tuple<int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, double> expert_cache_stats(
+    int64_t _cache
+) {
+    const core::ExpertCacheStats& s = cache(_cache)->stats();
+    return {s.hits, s.misses, s.late_prefetches, s.prefetches, s.useful_prefetches, s.evictions, s.bytes_copied,
+            s.stall_seconds};
+}
+
+void expert_cache_reset_stats(int64_t _cache) {
+    cache(_cache)->reset_stats();
+}
+
+} // namespace ops
+} // namespace lightllm
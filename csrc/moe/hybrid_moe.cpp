@@ -0,0 +1,69 @@
+#include "ops_common.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+namespace {
+
+std::vector<core::TensorView> views(const std::vector<Tensor>& ts) {
+    std::vector<core::TensorView> v;
+    v.reserve(ts.size());
+    for (const Tensor& t : ts) v.push_back(to_view(t));
+    return v;
+}
+
+} // namespace
+
+/**
+ * @brief Split the routing of a MoE layer between device and CPU experts, see
+ * core::hybrid_moe_partition.
+ *
+ * @param topk_ids      [T, K] int32 CPU experts of every token.
+ * @param topk_weights  [T, K] fp32 CPU routing weights.
+ * @param residency     [E] int32 CPU device slot of every expert, -1 for CPU experts.
+ * @return              device_ids [T, K] int32 and device_weights [T, K] fp32,
+ *                      cpu_offsets [E + 1] int32, cpu_tokens [n] int32 and
+ *                      cpu_weights [n] fp32 of the n CPU rows.
+ */
+std::tuple<Tensor, Tensor, Tensor, Tensor, Tensor> hybrid_moe_partition(
+    const Tensor& topk_ids, const Tensor& topk_weights, const Tensor& residency
+) {
+    Tensor ids = topk_ids.contiguous();
+    Tensor weights = topk_weights.contiguous();
+    Tensor slots = residency.contiguous();
+    Tensor device_ids = torch::empty_like(ids);
+    Tensor device_weights = torch::empty_like(weights);
+    Tensor cpu_offsets = torch::empty({slots.numel() + 1}, slots.options());
+    Tensor cpu_tokens = torch::empty({ids.numel()}, ids.options());
+    Tensor cpu_weights = torch::empty({weights.numel()}, weights.options());
+    const int64_t n = core::hybrid_moe_partition(
+        to_view(ids), to_view(weights), to_view(slots), to_view(device_ids), to_view(device_weights),
+        to_view(cpu_offsets), to_view(cpu_tokens), to_view(cpu_weights));
+    return {device_ids, device_weights, cpu_offsets, cpu_tokens.narrow(0, 0, n), cpu_weights.narrow(0, 0, n)};
+}
+
+/**
+ * @brief Host FFNs of the CPU experts, see core::moe_cpu_experts.
+ *
+ * @param out         [T, H] fp32 CPU output, fully written.
+ * @param x           [T, H] bf16 / fp16 / fp32 CPU hidden states.
+ * @param w13         Per expert [H, 2I] int8 / fp8 column major CPU weights,
+ *                    empty tensors for the experts without CPU rows.
+ * @param w13_scales  Per expert fp32 [2I] or [1] scales.
+ * @param w2          Per expert [I, H] column major CPU weights.
+ * @param w2_scales   Per expert fp32 [H] or [1] scales.
+ */
+void moe_cpu_experts(
+    Tensor& out, const Tensor& x, const Tensor& cpu_offsets, const Tensor& cpu_tokens, const Tensor& cpu_weights,
+    const std::vector<Tensor>& w13, const std::vector<Tensor>& w13_scales,
+    const std::vector<Tensor>& w2, const std::vector<Tensor>& w2_scales
+) {
+    Tensor xs = x.stride(-1) == 1 ? x : x.contiguous();
+    core::moe_cpu_experts(to_view(out), to_view(xs), to_view(cpu_offsets), to_view(cpu_tokens),
+                          to_view(cpu_weights), views(w13), views(w13_scales), views(w2), views(w2_scales));
+}
+
+} // namespace ops
+} // namespace lightllm
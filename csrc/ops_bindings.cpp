@@ -6,15 +6,36 @@ namespace lightllm {
 namespace ops {
 
 PYBIND11_MODULE(_C, m) {
+    // kernels with a CPU path run without the GIL, so Python threads and CPU streams overlap them
+    const auto nogil = pybind11::call_guard<pybind11::gil_scoped_release>();
     m.def("grouped_topk", &grouped_topk,"GROUPED TOP-K (CUDA)");
-    m.def("rmsnorm_align16_bf16", &rmsnorm_align16_bf16, "RMSNORM (CUDA)");
+    m.def("hybrid_moe_partition", &hybrid_moe_partition, "HYBRID MOE ROUTING PARTITION (CPU)");
+    m.def("moe_cpu_experts", &moe_cpu_experts, "MOE CPU EXPERTS (CPU)", nogil);
+    m.def("init_expert_cache", &init_expert_cache, "INIT EXPERT CACHE (CUDA/CPU)");
+    m.def("expert_cache_dispose", &expert_cache_dispose, "EXPERT CACHE DISPOSE (CUDA/CPU)", nogil);
+    m.def("expert_cache_access", &expert_cache_access, "EXPERT CACHE ACCESS (CUDA/CPU)", nogil);
+    m.def("expert_cache_prefetch", &expert_cache_prefetch, "EXPERT CACHE PREFETCH (CUDA/CPU)");
+    m.def("expert_cache_slot", &expert_cache_slot, "EXPERT CACHE SLOT (CPU)");
+    m.def("expert_cache_synchronize", &expert_cache_synchronize, "EXPERT CACHE SYNCHRONIZE (CUDA/CPU)", nogil);
+    m.def("expert_cache_stats", &expert_cache_stats, "EXPERT CACHE STATS (CPU)");
+    m.def("expert_cache_reset_stats", &expert_cache_reset_stats, "EXPERT CACHE RESET STATS (CPU)");
+    m.def("rmsnorm_align16_bf16", &rmsnorm_align16_bf16, "RMSNORM (CUDA/CPU)", nogil);
+    m.def("make_rmsnorm_plan", &make_rmsnorm_plan, "MAKE RMSNORM PLAN (CUDA/CPU)");
+    m.def("rmsnorm_plan_run", &rmsnorm_plan_run, "RMSNORM PLAN RUN (CUDA/CPU)", nogil);
     m.def("pre_tp_norm_bf16", &pre_tp_norm_bf16, "PRE TP NORM (CUDA)");
     m.def("post_tp_norm_bf16", &post_tp_norm_bf16, "POST TP NORM (CUDA)");
     m.def("per_token_quant_bf16_fp8", &per_token_quant_bf16_fp8, "PER TOKEN QUANT FP8 (CUDA)");
     m.def("per_token_quant_bf16_int8", &per_token_quant_bf16_int8, "PER TOKEN QUANT INT8 (CUDA)");
-    m.def("add_norm_quant_bf16_fp8", &add_norm_quant_bf16_fp8, "ADD NORM QUANT FUSED (CUDA)");
+    m.def("init_safetensors", &init_safetensors, "INIT SAFETENSORS MMAP (CPU)");
+    m.def("safetensors_dispose", &safetensors_dispose, "SAFETENSORS MMAP DISPOSE (CPU)");
+    m.def("safetensors_entries", &safetensors_entries, "SAFETENSORS ENTRIES (CPU)");
+    m.def("safetensors_metadata", &safetensors_metadata, "SAFETENSORS METADATA (CPU)");
+    m.def("safetensors_tensor", &safetensors_tensor, "SAFETENSORS TENSOR (CPU)", nogil);
+    m.def("quantize_weight_per_channel", &quantize_weight_per_channel, "PER CHANNEL WEIGHT QUANT (CPU)", nogil);
+    m.def("quantize_weights", &quantize_weights, "PIPELINED WEIGHT LOAD QUANT (CPU)", nogil);
+    m.def("add_norm_quant_bf16_fp8", &add_norm_quant_bf16_fp8, "ADD NORM QUANT FUSED (CUDA/CPU)", nogil);
     m.def("gelu_per_token_quant_bf16_fp8", &gelu_per_token_quant_bf16_fp8, "GELU QUANT FUSED (CUDA)");
-    m.def("cutlass_scaled_mm", &cutlass_scaled_mm, "CUTLASS SCALED MM (CUDA)");
+    m.def("cutlass_scaled_mm", &cutlass_scaled_mm, "CUTLASS SCALED MM (CUDA/CPU)", nogil);
     m.def("all_gather", &all_gather, "ALL GATHER (CUDA)");
     m.def("allgather_dispose", &allgather_dispose, "ALL GATHER DISPOSE (CUDA)");
     m.def("init_custom_gather_ar", &init_custom_gather_ar, "INIT CUSTOM GATHER AR (CUDA)");
@@ -22,8 +43,69 @@ PYBIND11_MODULE(_C, m) {
     m.def("allgather_register_graph_buffers", &allgather_register_graph_buffers, "ALL GATHER REGISTER BRAPH BUFFERS (CUDA)");
     m.def("allgather_get_graph_buffer_ipc_meta", &allgather_get_graph_buffer_ipc_meta, "ALL GATHER GET GRAPH BUFFER IPC META (CUDA)");
     m.def("meta_size", &lightllm::ops::meta_size, "Size (in bytes) of vllm::Signal metadata");
+    m.def("init_shm_gather", &init_shm_gather, "INIT SHARED MEMORY GATHER (CPU)");
+    m.def("shm_gather_dispose", &shm_gather_dispose, "SHARED MEMORY GATHER DISPOSE (CPU)");
+    m.def("shm_gather_register_buffer", &shm_gather_register_buffer, "SHARED MEMORY GATHER REGISTER BUFFER (CPU)");
+    m.def("shm_meta_size", &shm_meta_size, "Size (in bytes) of ShmSignal metadata");
+    m.def("vocab_parallel_embedding", &vocab_parallel_embedding, "VOCAB PARALLEL EMBEDDING (CUDA/CPU)");
     m.def("group8_int8kv_flashdecoding_stage1", &group_int8kv_flashdecoding_attention, "INT8KV FLASHDECODING ATTENTION (CUDA)");
-    m.def("group_int8kv_decode_attention", &group_int8kv_decode_attention, "INT8KV DECODE ATTENTION (CUDA)");
+    m.def("flashdecoding_stage1", &flashdecoding_stage1, "FLASHDECODING STAGE1 (CUDA)");
+    m.def("group_int8kv_decode_attention", &group_int8kv_decode_attention, "INT8KV DECODE ATTENTION (CUDA/CPU)", nogil);
+    m.def("decode_attention", &decode_attention, "DECODE ATTENTION (CUDA/CPU)", nogil);
+    m.def("int8kv_decode_attention_workspace_bytes", &int8kv_decode_attention_workspace_bytes, "INT8KV DECODE ATTENTION WORKSPACE BYTES");
+    m.def("flashdecoding_combine", &flashdecoding_combine, "FLASHDECODING COMBINE (CUDA/CPU)", nogil);
+    m.def("varlen_attention", &varlen_attention, "VARLEN BIDIRECTIONAL ATTENTION (CUDA/CPU)", nogil);
+    m.def("plan_mixed_attention", &plan_mixed_attention, "PLAN MIXED ATTENTION (CPU)");
+    m.def("mixed_int8kv_attention", &mixed_int8kv_attention, "MIXED INT8KV ATTENTION (CUDA/CPU)", nogil);
+    m.def("kv_page_minmax_update", &kv_page_minmax_update, "KV PAGE MIN/MAX UPDATE (CUDA/CPU)", nogil);
+    m.def("quest_select_pages", &quest_select_pages, "QUEST SELECT PAGES (CUDA/CPU)", nogil);
+    m.def("sparse_int8kv_decode_attention", &sparse_int8kv_decode_attention, "SPARSE INT8KV DECODE ATTENTION (CUDA/CPU)", nogil);
+    m.def("logprobs_topn_partial", &logprobs_topn_partial, "LOGPROBS TOPN PARTIAL (CUDA/CPU)", nogil);
+    m.def("logprobs_topn_merge", &logprobs_topn_merge, "LOGPROBS TOPN MERGE (CUDA/CPU)", nogil);
+    m.def("init_kv_allocator", &init_kv_allocator, "INIT KV PAGE ALLOCATOR (CPU)");
+    m.def("kv_allocator_dispose", &kv_allocator_dispose, "KV PAGE ALLOCATOR DISPOSE (CPU)");
+    m.def("kv_alloc_req", &kv_alloc_req, "KV ALLOC REQUEST (CPU)");
+    m.def("kv_free_reqs", &kv_free_reqs, "KV FREE REQUESTS (CPU)");
+    m.def("kv_fork", &kv_fork, "KV FORK REQUEST (CPU)");
+    m.def("kv_extend", &kv_extend, "KV EXTEND REQUESTS (CPU)");
+    m.def("kv_compact", &kv_compact, "KV COMPACTION PLAN (CPU)");
+    m.def("kv_truncate", &kv_truncate, "KV TRUNCATE REQUEST (CPU)");
+    m.def("kv_evict", &kv_evict, "KV EVICT TOKENS OF REQUEST (CPU)");
+    m.def("kv_evict_select", &kv_evict_select, "KV EVICTION SELECT (CPU)");
+    m.def("kv_downgrade", &kv_downgrade, "KV DOWNGRADE COLD PAGES (CPU)");
+    m.def("kv_seq_len", &kv_seq_len, "KV REQUEST LENGTH (CPU)");
+    m.def("kv_num_free_pages", &kv_num_free_pages, "KV FREE PAGES (CPU)");
+    m.def("kv_num_free_reqs", &kv_num_free_reqs, "KV FREE REQUESTS COUNT (CPU)");
+    m.def("kv_copy_slots", &kv_copy_slots, "KV COPY SLOTS (CUDA/CPU)", nogil);
+    m.def("kv_downgrade_pages", &kv_downgrade_pages, "KV DOWNGRADE PAGES (CUDA/CPU)", nogil);
+    m.def("kv_transfer_bytes", &kv_transfer_bytes, "KV TRANSFER BUFFER SIZE (CPU)");
+    m.def("kv_pack", &kv_pack, "KV PACK FOR TRANSFER (CUDA/CPU)", nogil);
+    m.def("kv_transfer_info", &kv_transfer_info, "KV TRANSFER HEADER INFO (CUDA/CPU)");
+    m.def("kv_unpack", &kv_unpack, "KV UNPACK TRANSFER (CUDA/CPU)", nogil);
+    m.def("page_hashes", &page_hashes, "CHAINED PAGE HASHES (CPU)", nogil);
+    m.def("init_kv_offload", &init_kv_offload, "INIT KV OFFLOAD ENGINE (CUDA/CPU)");
+    m.def("kv_offload_dispose", &kv_offload_dispose, "KV OFFLOAD ENGINE DISPOSE (CUDA/CPU)");
+    m.def("kv_offload", &kv_offload, "KV OFFLOAD (CUDA/CPU)");
+    m.def("kv_offload_prefetch", &kv_offload_prefetch, "KV OFFLOAD REQUEST PREFETCH (CPU)");
+    m.def("kv_offload_issue_prefetches", &kv_offload_issue_prefetches, "KV OFFLOAD ISSUE PREFETCHES (CPU)");
+    m.def("kv_offload_ready", &kv_offload_ready, "KV OFFLOAD READY (CUDA/CPU)");
+    m.def("kv_offload_wait", &kv_offload_wait, "KV OFFLOAD WAIT (CUDA/CPU)");
+    m.def("kv_offload_restore", &kv_offload_restore, "KV OFFLOAD RESTORE (CUDA/CPU)");
+    m.def("kv_offload_drop", &kv_offload_drop, "KV OFFLOAD DROP (CPU)");
+    m.def("kv_offload_tier", &kv_offload_tier, "KV OFFLOAD TIER (CPU)");
+    m.def("kv_offload_stats", &kv_offload_stats, "KV OFFLOAD STATS (CPU)");
+    m.def("set_cpu_isa", &set_cpu_isa, "SET CPU KERNEL INSTRUCTION SET (CPU)");
+    m.def("get_cpu_isa", &get_cpu_isa, "GET CPU KERNEL INSTRUCTION SET (CPU)");
+    m.def("init_cpu_stream", &init_cpu_stream, "INIT CPU STREAM (CPU)");
+    m.def("cpu_stream_dispose", &cpu_stream_dispose, "CPU STREAM DISPOSE (CPU)");
+    m.def("cpu_stream_submit", &cpu_stream_submit, "CPU STREAM SUBMIT (CPU)");
+    m.def("cpu_stream_record", &cpu_stream_record, "CPU STREAM RECORD EVENT (CPU)");
+    m.def("cpu_stream_wait_event", &cpu_stream_wait_event, "CPU STREAM WAIT EVENT (CPU)");
+    m.def("cpu_stream_query", &cpu_stream_query, "CPU STREAM QUERY (CPU)");
+    m.def("cpu_stream_synchronize", &cpu_stream_synchronize, "CPU STREAM SYNCHRONIZE (CPU)");
+    m.def("cpu_event_query", &cpu_event_query, "CPU EVENT QUERY (CPU)");
+    m.def("cpu_event_synchronize", &cpu_event_synchronize, "CPU EVENT SYNCHRONIZE (CPU)");
+    m.def("cpu_event_dispose", &cpu_event_dispose, "CPU EVENT DISPOSE (CPU)");
 }
 
 } // namespace ops
@@ -0,0 +1,123 @@
+#include "ops_common.h"
+#include "core/weight_loader.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+namespace {
+
+core::SafetensorsFile* file(int64_t _file) {
+    return reinterpret_cast<core::SafetensorsFile*>(_file);
+}
+
+const core::SafetensorsEntry& entry(int64_t _file, const std::string& name) {
+    const core::SafetensorsEntry* e = file(_file)->find(name);
+    TORCH_CHECK(e != nullptr, file(_file)->path(), " has no tensor ", name);
+    return *e;
+}
+
+torch::ScalarType scalar_type(const core::DType dtype) {
+    switch (dtype) {
+        case core::DType::Float32: return torch::kFloat32;
+        case core::DType::Float16: return torch::kFloat16;
+        case core::DType::BFloat16: return torch::kBFloat16;
+        case core::DType::Fp8E4M3: return torch::kFloat8_e4m3fn;
+        case core::DType::Int8: return torch::kInt8;
+        case core::DType::UInt8: return torch::kUInt8;
+        case core::DType::Int32: return torch::kInt32;
+        case core::DType::Int64: return torch::kInt64;
+    }
+    TORCH_CHECK(false, "unknown dtype");
+}
+
+} // namespace
+
+/**
+ * @brief Map a safetensors shard, see core::SafetensorsFile.
+ *
+ * @return  Handle, release it with safetensors_dispose.
+ */
+int64_t init_safetensors(const std::string& path) {
+    return reinterpret_cast<int64_t>(new core::SafetensorsFile(path));
+}
+
+void safetensors_dispose(int64_t _file) {
+    delete file(_file);
+}
+
+/**
+ * @return  (name, safetensors dtype, shape) of every tensor, in file order.
+ */
+std::vector<std::tuple<std::string, std::string, std::vector<int64_t>>> safetensors_entries(int64_t _file) {
+    std::vector<std::tuple<std::string, std::string, std::vector<int64_t>>> entries;
+    for (const core::SafetensorsEntry& e : file(_file)->entries()) entries.emplace_back(e.name, e.dtype, e.shape);
+    return entries;
+}
+
+std::map<std::string, std::string> safetensors_metadata(int64_t _file) {
+    return file(_file)->metadata();
+}
+
+/**
+ * @brief Copy of a tensor of the shard in host memory.
+ */
+Tensor safetensors_tensor(int64_t _file, const std::string& name) {
+    const core::TensorView v = file(_file)->view(entry(_file, name));
+    const std::vector<int64_t> shape(v.shape, v.shape + v.ndim);
+    return torch::from_blob(v.data, shape, torch::dtype(scalar_type(v.dtype))).clone();
+}
+
+/**
+ * @brief Per output channel quantization of a weight, see
+ * core::quantize_weight_per_channel.
+ *
+ * @param w       [N, K] bf16 / fp16 / fp32 CPU weight, rows contiguous.
+ * @param q       [K, N] int8 / fp8 CPU output, column major (e.g. empty(N, K).t()).
+ * @param scales  [N] or [N, 1] fp32 CPU output.
+ */
+void quantize_weight_per_channel(const Tensor& w, Tensor& q, Tensor& scales) {
+    core::quantize_weight_per_channel(to_view(w), to_view(q), to_view(scales));
+}
+
+/**
+ * @brief Quantize weights of mapped shards with the reads overlapped, see
+ * core::quantize_weights.
+ *
+ * @param files            Shard handle of every weight.
+ * @param names            Tensor name of every weight.
+ * @param q                [K, N] column major CPU outputs.
+ * @param scales           [N] / [N, 1] fp32 CPU outputs.
+ * @param on_done          None or a callable taking the index of a finished
+ *                         weight, called in order while the next ones load.
+ * @return                 (source bytes, written bytes, seconds, seconds waited for reads).
+ */
+std::tuple<int64_t, int64_t, double, double> quantize_weights(
+    const std::vector<int64_t>& files, const std::vector<std::string>& names,
+    const std::vector<Tensor>& q, const std::vector<Tensor>& scales,
+    int64_t io_threads, int64_t readahead_bytes, const pybind11::object& on_done
+) {
+    TORCH_CHECK(files.size() == names.size() && names.size() == q.size() && q.size() == scales.size(),
+                "files, names, q and scales must have one entry per weight");
+    std::vector<core::WeightQuantJob> jobs;
+    for (size_t i = 0; i < names.size(); i++) {
+        jobs.push_back({file(files[i])->view(entry(files[i], names[i])), to_view(q[i]), to_view(scales[i])});
+    }
+    core::WeightLoadOptions options;
+    options.io_threads = static_cast<int32_t>(io_threads);
+    options.readahead_bytes = readahead_bytes;
+    // runs without the GIL, on_done is borrowed from the caller's frame
+    std::function<void(size_t)> done;
+    if (!on_done.is_none()) {
+        done = [&](size_t i) {
+            pybind11::gil_scoped_acquire acquire;
+            on_done(i);
+        };
+    }
+    const core::WeightLoadStats s = core::quantize_weights(jobs, options, done);
+    return {s.bytes_read, s.bytes_written, s.seconds, s.read_wait_seconds};
+}
+
+} // namespace ops
+} // namespace lightllm
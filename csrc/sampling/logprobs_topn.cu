@@ -0,0 +1,56 @@
+#include "ops_common.h"
+
+namespace lightllm {
+namespace ops {
+
+using namespace lightllm;
+
+/**
+ * @brief PyTorch entry of core::logprobs_topn_partial.
+ *
+ * @param topn_vals     [B, topn] fp32 output.
+ * @param topn_ids      [B, topn] int64 output, global token ids.
+ * @param sampled_vals  [B] fp32 output.
+ * @param stats         [B, 2] fp32 output, (max, sum of exp) of the shard.
+ * @param logits        [B, V] fp32/fp16/bf16 logits of this shard, last dim contiguous.
+ * @param sampled_ids   [B] int64 global ids of the sampled tokens.
+ * @param vocab_start   Global id of the first token of this shard.
+ * @param normalize     Write logprobs instead of raw logits, only valid for an unsharded vocab.
+ */
+void logprobs_topn_partial(
+    Tensor& topn_vals, Tensor& topn_ids,
+    Tensor& sampled_vals, Tensor& stats,
+    const Tensor& logits, const Tensor& sampled_ids,
+    const int64_t vocab_start, const bool normalize
+) {
+    Tensor contiguous_ids = sampled_ids.is_contiguous() ? sampled_ids : sampled_ids.contiguous();
+    core::logprobs_topn_partial(
+        to_view(topn_vals), to_view(topn_ids), to_view(sampled_vals), to_view(stats),
+        to_view(logits), to_view(contiguous_ids), vocab_start, normalize
+    );
+}
+
+/**
+ * @brief PyTorch entry of core::logprobs_topn_merge.
+ *
+ * @param out_logprobs  [B, topn] fp32 output.
+ * @param out_ids       [B, topn] int64 output.
+ * @param out_sampled   [B] fp32 output, logprob of the sampled token.
+ * @param stats         [S, B, 2] gathered stats of all shards.
+ * @param topn_vals     [S, B, topn] gathered raw top logits.
+ * @param topn_ids      [S, B, topn] gathered token ids.
+ * @param sampled_vals  [S, B] gathered raw sampled logits.
+ */
+void logprobs_topn_merge(
+    Tensor& out_logprobs, Tensor& out_ids, Tensor& out_sampled,
+    const Tensor& stats, const Tensor& topn_vals,
+    const Tensor& topn_ids, const Tensor& sampled_vals
+) {
+    core::logprobs_topn_merge(
+        to_view(out_logprobs), to_view(out_ids), to_view(out_sampled),
+        to_view(stats), to_view(topn_vals), to_view(topn_ids), to_view(sampled_vals)
+    );
+}
+
+} // namespace ops
+} // namespace lightllm
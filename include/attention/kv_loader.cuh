@@ -0,0 +1,117 @@
+#pragma once
+#include "utils.h"
+
+namespace lightllm {
+namespace attention {
+/**
+ * @brief KV cache formats of the decode attention kernels, all over the
+ * same [slots, Hkv, D] cache addressed through req_to_tokens.
+ *
+ * load<N>(cache, scale, idx, out) reads the N elements of a token row that
+ * start at element idx and writes them dequantized to out in fp32. N is at
+ * most one quant group (8) and idx a multiple of N, so a load is a single
+ * aligned vector and takes a single scale.
+ *
+ *   Int8KvLoader<S>   int8 values, one S scale per 8 elements, [slots, Hkv, D / 8]
+ *   Fp8KvLoader<S>    fp8_e4m3 values with the same group-8 scales
+ *   HalfKvLoader<S>   unquantized S values (the dtype of q), no scales
+ *
+ * The int8 and half formats also read pages packed by kv_downgrade_pages:
+ * load_packed<N>(cache, scale, row, d, D, half, out) loads elements
+ * [d, d + N) of half `half` of the token row that starts at element row,
+ * int4 (int8 cache) or int8 (half cache) values with group-16 scales.
+ * resolve_kv_slot maps a slot of req_to_tokens to its physical row; slots
+ * past the cache (and past its virtual slots with page_precision) trap.
+ */
+struct KvSlot {
+    int64_t slot;   // physical slot
+    int32_t half;   // 1 for the virtual slots of the second page of a pair
+    bool packed;    // the page holds a downgraded pair
+};
+
+__device__ inline KvSlot resolve_kv_slot(
+    const int64_t slot, const int8_t* page_precision, const int64_t page_size, const int64_t num_slots
+) {
+    check_kv_slot(slot, page_precision == nullptr ? num_slots : 2 * num_slots);
+    if (page_precision == nullptr) return {slot, 0, false};
+    const int32_t half = slot >= num_slots;
+    const int64_t physical = half ? slot - num_slots : slot;
+    return {physical, half, page_precision[physical / page_size] != 0};
+}
+
+template<typename S>
+struct Int8KvLoader {
+    using elem_t = int8_t;
+    static constexpr bool kPackable = true;
+
+    template<int32_t N>
+    __device__ static inline void load(const elem_t* cache, const S* scale, const int64_t idx, fp32_t* out) {
+        static_assert(N <= 8 && 8 % N == 0, "a load stays inside one quant group");
+        alignas(N) elem_t raw[N];
+        vec_copy<N>(cache + idx, raw);
+        const fp32_t s = static_cast<fp32_t>(scale[idx >> 3]);
+#pragma unroll
+        for (int32_t j = 0; j < N; j++) out[j] = s * static_cast<fp32_t>(raw[j]);
+    }
+
+    template<int32_t N>
+    __device__ static inline void load_packed(const elem_t* cache, const S* scale, const int64_t row,
+                                              const int64_t d, const int64_t D, const int32_t half, fp32_t* out) {
+        static_assert(N % 2 == 0 && 16 % N == 0, "a load is whole bytes of one quant group");
+        alignas(N / 2) uint8_t raw[N / 2];
+        vec_copy<N / 2>(cache + row + half * (D / 2) + d / 2, raw);
+        const fp32_t s = static_cast<fp32_t>(scale[row / 8 + half * (D / 16) + d / 16]);
+#pragma unroll
+        for (int32_t j = 0; j < N; j++) {
+            // sign extend the nibble, low nibble first
+            const int32_t q = static_cast<int32_t>(static_cast<uint32_t>(raw[j / 2]) << (28 - 4 * (j % 2))) >> 28;
+            out[j] = s * static_cast<fp32_t>(q);
+        }
+    }
+};
+
+template<typename S>
+struct Fp8KvLoader {
+    using elem_t = fp8_e4m3_t;
+    static constexpr bool kPackable = false;
+
+    template<int32_t N>
+    __device__ static inline void load(const elem_t* cache, const S* scale, const int64_t idx, fp32_t* out) {
+        static_assert(N <= 8 && 8 % N == 0, "a load stays inside one quant group");
+        alignas(N) elem_t raw[N];
+        vec_copy<N>(cache + idx, raw);
+        const fp32_t s = static_cast<fp32_t>(scale[idx >> 3]);
+#pragma unroll
+        for (int32_t j = 0; j < N; j++) out[j] = s * static_cast<fp32_t>(raw[j]);
+    }
+};
+
+template<typename S>
+struct HalfKvLoader {
+    using elem_t = S;
+    static constexpr bool kPackable = true;
+
+    template<int32_t N>
+    __device__ static inline void load(const elem_t* cache, const S*, const int64_t idx, fp32_t* out) {
+        static_assert(N * sizeof(S) <= 16, "a load is one 128-bit vector at most");
+        alignas(N * sizeof(S)) elem_t raw[N];
+        vec_copy<N * sizeof(S)>(cache + idx, raw);
+#pragma unroll
+        for (int32_t j = 0; j < N; j++) out[j] = static_cast<fp32_t>(raw[j]);
+    }
+
+    // the packed row is 2 * D int8 values over the D elements of the row
+    template<int32_t N>
+    __device__ static inline void load_packed(const elem_t* cache, const S* scale, const int64_t row,
+                                              const int64_t d, const int64_t D, const int32_t half, fp32_t* out) {
+        static_assert(16 % N == 0, "a load stays inside one quant group");
+        alignas(N) int8_t raw[N];
+        vec_copy<N>(reinterpret_cast<const int8_t*>(cache + row) + half * D + d, raw);
+        const fp32_t s = static_cast<fp32_t>(scale[row / 8 + half * (D / 16) + d / 16]);
+#pragma unroll
+        for (int32_t j = 0; j < N; j++) out[j] = s * static_cast<fp32_t>(raw[j]);
+    }
+};
+
+} // namespace attention
+} // namespace lightllm
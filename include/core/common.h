@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Torch-free helpers shared by the core library. Nothing in include/core may
+// include torch, pybind11 or Python headers.
+namespace lightllm {
+namespace core {
+
+using fp32_t = float;
+
+/**
+ * Thrown when the arguments are valid but the requested combination
+ * (dtype, device, shape) has no kernel, mapped to LK_ERROR_NOT_SUPPORTED.
+ * Bad arguments throw std::invalid_argument (LK_ERROR_INVALID_ARGUMENT).
+ */
+class NotSupported : public std::runtime_error {
+ public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+inline void append(std::ostringstream&) {}
+
+template <typename T, typename... Args>
+inline void append(std::ostringstream& ss, const T& v, const Args&... args) {
+    ss << v;
+    append(ss, args...);
+}
+
+template <typename... Args>
+inline std::string concat(const Args&... args) {
+    std::ostringstream ss;
+    append(ss, args...);
+    return ss.str();
+}
+}  // namespace detail
+
+}  // namespace core
+}  // namespace lightllm
+
+// Same usage as TORCH_CHECK: LK_CHECK(x.ndim == 2, "x must be 2D, got ", x.ndim).
+#define LK_CHECK(cond, ...)                                                        \
+    do {                                                                           \
+        if (!(cond)) {                                                             \
+            throw std::invalid_argument(::lightllm::core::detail::concat(          \
+                "Expected " #cond " to be true. ", ##__VA_ARGS__));                \
+        }                                                                          \
+    } while (0)
+
+#define LK_NOT_SUPPORTED(...) \
+    throw ::lightllm::core::NotSupported(::lightllm::core::detail::concat(__VA_ARGS__))
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+
+#include "core/common.h"
+#include "core/host_float.h"
+
+// Runtime instruction set dispatch of the host kernels. Every level is
+// compiled into its own translation unit (csrc/core/cpu/kernels_*.cpp) and
+// the one the CPU supports is picked on first use, so one build runs on any
+// x86-64 machine from Haswell on, and on other architectures at Scalar.
+namespace lightllm {
+namespace core {
+
+/**
+ * @brief Instruction set levels, each one includes the previous ones.
+ *
+ *   Scalar      portable C++
+ *   Avx2        AVX2, FMA, F16C (Haswell, Zen)
+ *   Avx512      AVX-512 F / BW / VL / DQ (Skylake-SP), VNNI int8 dots when the CPU has them
+ *   Avx512Bf16  + VNNI and AVX512_BF16 (Cooper Lake, Zen 4)
+ *   Amx         + AMX tile / int8 / bf16 with the tile state granted by the OS (Sapphire Rapids)
+ */
+enum class CpuIsa : int32_t {
+    Scalar = 0,
+    Avx2 = 1,
+    Avx512 = 2,
+    Avx512Bf16 = 3,
+    Amx = 4,
+};
+
+constexpr int32_t kNumCpuIsas = 5;
+
+const char* cpu_isa_name(const CpuIsa isa);
+
+// "scalar", "avx2", "avx512", "avx512_bf16" or "amx", throws otherwise.
+CpuIsa parse_cpu_isa(const char* name);
+
+// Highest level this CPU and OS support.
+CpuIsa detected_cpu_isa();
+
+// Level the kernels run at: the detected one, capped by the
+// LIGHTLLM_CPU_ISA environment variable, or the last set_cpu_isa().
+CpuIsa active_cpu_isa();
+
+// Forces a level, for testing and for comparing them. Throws above the detected one.
+void set_cpu_isa(const CpuIsa isa);
+
+/**
+ * @brief Building blocks of the host kernels at one instruction set level.
+ * All of them take plain pointers and do no validation; results of the
+ * levels differ only in the order of fp32 sums, conversions round to nearest
+ * even like host_float.h (from Avx512Bf16 on, float_to_bf16 flushes fp32
+ * denormals to zero, as vcvtneps2bf16 does).
+ */
+struct CpuKernels {
+    CpuIsa isa;
+
+    // y[i] = x[i] in fp32, and back
+    void (*bf16_to_float)(const host_bf16_t* x, fp32_t* y, int64_t n);
+    void (*fp16_to_float)(const host_fp16_t* x, fp32_t* y, int64_t n);
+    void (*float_to_bf16)(const fp32_t* x, host_bf16_t* y, int64_t n);
+    void (*float_to_fp16)(const fp32_t* x, host_fp16_t* y, int64_t n);
+    // y[i] = fp8_e4m3(x[i] * scale), saturating to +-448
+    void (*float_to_fp8)(const fp32_t* x, fp32_t scale, host_fp8_e4m3_t* y, int64_t n);
+    // y[i] = int8(x[i] * scale), rounding to nearest even and saturating to [-128, 127]
+    void (*float_to_int8)(const fp32_t* x, fp32_t scale, int8_t* y, int64_t n);
+
+    fp32_t (*dot)(const fp32_t* a, const fp32_t* b, int64_t n);
+    fp32_t (*sum_squares)(const fp32_t* x, int64_t n);
+    fp32_t (*absmax)(const fp32_t* x, int64_t n);
+    // y[i] += a * x[i]
+    void (*axpy)(fp32_t a, const fp32_t* x, fp32_t* y, int64_t n);
+    // y[i] = x[i] * s * w[i]
+    void (*scale_mul)(const fp32_t* x, fp32_t s, const fp32_t* w, fp32_t* y, int64_t n);
+
+    // sum_g ks[g] * <q8, k8> over the D / 8 groups of 8 of one K row. q8 is
+    // zero padded to a multiple of 64 and corr[i] = 128 * (q8[4i] + ... + q8[4i + 3]).
+    fp32_t (*int8_group8_dot)(const int8_t* q8, const int32_t* corr, const int8_t* k8, const fp32_t* ks, int64_t D);
+
+    // c[m, n] = sum_k a[m, k] * b[n, k] for m < M, n < N over rows of K
+    // contiguous elements, lda / ldb / ldc in elements.
+    void (*gemm_s8)(const int8_t* a, int64_t lda, const int8_t* b, int64_t ldb,
+                    int32_t* c, int64_t ldc, int64_t M, int64_t N, int64_t K);
+    void (*gemm_bf16)(const host_bf16_t* a, int64_t lda, const host_bf16_t* b, int64_t ldb,
+                      fp32_t* c, int64_t ldc, int64_t M, int64_t N, int64_t K);
+};
+
+// Kernels of the active level.
+const CpuKernels& cpu_kernels();
+
+} // namespace core
+} // namespace lightllm
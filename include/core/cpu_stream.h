@@ -0,0 +1,90 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace lightllm {
+namespace core {
+
+/**
+ * @brief Marks the point of a CpuStream where it was recorded, like a
+ * cudaEvent_t: it completes once all work enqueued before it has run.
+ */
+class CpuEvent {
+ public:
+    bool query() const;
+
+    // Blocks until the event completes, then rethrows the error of a failed task before it.
+    void synchronize() const;
+
+ private:
+    friend class CpuStream;
+    void complete(std::exception_ptr error);
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable cv_;
+    bool done_ = false;
+    std::exception_ptr error_;
+};
+
+/**
+ * @brief Ordered queue of host work, the CPU counterpart of a CUDA stream.
+ *
+ * Work runs in enqueue order on a thread owned by the stream, so the caller
+ * returns right away and overlaps its own work (scheduling, device launches)
+ * with it. Kernels in the work still split across the global thread pool;
+ * work of different streams shares that pool, one parallel region at a time.
+ *
+ * Errors are sticky like CUDA's: once a task throws, the following tasks are
+ * skipped and events complete with that error until synchronize() reports it.
+ * Enqueue, record, wait and synchronize may be called from any thread.
+ */
+class CpuStream {
+ public:
+    CpuStream();
+    // Runs the queued work to completion, its errors are dropped.
+    ~CpuStream();
+
+    CpuStream(const CpuStream&) = delete;
+    CpuStream& operator=(const CpuStream&) = delete;
+
+    void enqueue(std::function<void()> fn);
+
+    // Event that completes once the work enqueued so far has run.
+    std::shared_ptr<CpuEvent> record();
+
+    // Work enqueued after this call starts once event completes, event may come from any stream.
+    void wait(std::shared_ptr<CpuEvent> event);
+
+    // True if all enqueued work has run.
+    bool query();
+
+    // Blocks until all enqueued work has run, then rethrows and clears the first error.
+    void synchronize();
+
+ private:
+    struct Task {
+        std::function<void()> fn;
+        bool always = false;  // event bookkeeping, runs even after an error
+    };
+
+    void push(Task task);
+    void loop();
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+    std::deque<Task> queue_;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+
+#include "core/common.h"
+
+// CUDA runtime helpers of the host code of the core library, which is built
+// without the CUDA headers (csrc/core/device_util.cu). Events are opaque
+// cudaEvent_t handles; without CUDA there is no device work to track and
+// the copies are not supported.
+namespace lightllm {
+namespace core {
+
+#ifdef LIGHTLLM_CORE_WITH_CUDA
+
+// Event recorded on a cudaStream_t, to poll or wait for the work before it.
+void* record_device_event(void* stream);
+bool device_event_done(void* event);
+void sync_device_event(void* event);
+void destroy_device_event(void* event);
+
+// Small synchronous reads of device memory, e.g. the header of a KV transfer buffer.
+void copy_device_to_host(void* dst, const void* src, const int64_t bytes, void* stream);
+// Asynchronous upload on stream, track its completion with record_device_event.
+void copy_host_to_device_async(void* dst, const void* src, const int64_t bytes, void* stream);
+
+#else
+
+inline void* record_device_event(void*) { return nullptr; }
+inline bool device_event_done(void*) { return true; }
+inline void sync_device_event(void*) {}
+inline void destroy_device_event(void*) {}
+
+inline void copy_device_to_host(void*, const void*, const int64_t, void*) {
+    LK_NOT_SUPPORTED("the core library was built without CUDA");
+}
+inline void copy_host_to_device_async(void*, const void*, const int64_t, void*) {
+    LK_NOT_SUPPORTED("the core library was built without CUDA");
+}
+
+#endif
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core/common.h"
+#include "core/cpu_stream.h"
+#include "core/tensor_view.h"
+
+namespace lightllm {
+namespace core {
+
+enum class ExpertEviction : int32_t {
+    Lru = 0,  // least recently used expert
+    Lfu = 1,  // lowest use count, decayed every step
+};
+
+struct ExpertCacheOptions {
+    ExpertEviction eviction = ExpertEviction::Lru;
+    // Experts of the next layer the predictor fetches ahead, 0 turns it off.
+    int32_t prefetch_per_layer = 4;
+    // Missing experts, and prefetched ones whose copy is still in flight, are
+    // copied in before access() returns (stalls). With false access() never
+    // waits: they are copied in the background and reported as not resident,
+    // e.g. for the CPU experts of hybrid_moe_partition.
+    bool fetch_misses = true;
+    // Factor the LFU use counts and the predictor's prior shrink by per step.
+    float decay = 0.9f;
+};
+
+struct ExpertCacheStats {
+    int64_t hits = 0;             // routed experts that were resident
+    int64_t misses = 0;           // routed experts that were not
+    int64_t late_prefetches = 0;  // hits whose prefetch was still copying
+    int64_t prefetches = 0;       // copies started by the predictor
+    int64_t useful_prefetches = 0;  // prefetched experts used before their eviction
+    int64_t evictions = 0;
+    int64_t bytes_copied = 0;
+    double stall_seconds = 0.0;   // time access() waited for copies
+};
+
+/**
+ * @brief Fixed-capacity pool of MoE expert weights in fast memory (HBM, or
+ * host memory for CPU pools) in front of the full set in host memory.
+ *
+ * Every expert is one blob of B bytes (e.g. w13, w2 and their scales packed
+ * together): host_weights is [L, E, B] uint8 in host memory (pinned for a
+ * CUDA pool), pool is [S, B] uint8 with one expert per slot. access() is
+ * called once per MoE layer with its routing: it makes the routed experts
+ * resident, evicting the least recently / frequently used ones, and reports
+ * the slot of every expert of the layer (the residency map of
+ * hybrid_moe_partition). It then predicts the experts of the next layer and
+ * starts copying them while the current one computes.
+ *
+ * The predictor learns, per layer, how often expert e' of layer l + 1 follows
+ * expert e of layer l on the same token (routing is strongly correlated from
+ * layer to layer) and scores the experts of the next layer by these
+ * transition frequencies weighted with the gating scores of the current
+ * routing; a decayed prior of the experts the next layer used in the previous
+ * steps breaks ties. The last layer predicts layer 0 of the next step.
+ *
+ * Copies into a CUDA pool are cudaMemcpyAsync calls on the stream of pool,
+ * into a CPU pool they run on an internal CpuStream. The experts of the layer
+ * passed to the last access() are never evicted, the caller orders a reuse
+ * of the slots of earlier layers after their compute (e.g. a copy stream that
+ * waits on the compute stream). Not thread safe, one scheduler thread owns a
+ * cache.
+ */
+class ExpertCache {
+ public:
+    ExpertCache(const TensorView& host_weights, const TensorView& pool, const ExpertCacheOptions& options = {});
+    ~ExpertCache();
+
+    ExpertCache(const ExpertCache&) = delete;
+    ExpertCache& operator=(const ExpertCache&) = delete;
+
+    /**
+     * Routing of layer: topk_ids [T, K] int32 and topk_weights [T, K] fp32 in
+     * host memory. residency ([E] int32, host) receives the slot of every
+     * expert of the layer whose copy is complete, -1 for the others.
+     */
+    void access(int32_t layer, const TensorView& topk_ids, const TensorView& topk_weights,
+                const TensorView& residency);
+
+    // Starts copying experts of layer in, e.g. from a routing hint; returns the number of copies started.
+    int32_t prefetch(int32_t layer, const std::vector<int32_t>& experts);
+
+    // Slot of the expert, -1 if it is not in the pool (its copy may be in flight).
+    int32_t slot(int32_t layer, int32_t expert) const;
+
+    // Waits for all copies.
+    void synchronize();
+
+    int32_t num_layers() const { return num_layers_; }
+    int32_t num_experts() const { return num_experts_; }
+    int32_t num_slots() const { return static_cast<int32_t>(slots_.size()); }
+    const ExpertCacheStats& stats() const { return stats_; }
+    void reset_stats() { stats_ = ExpertCacheStats(); }
+
+ private:
+    struct Slot {
+        int32_t key = -1;                // layer * E + expert, -1 when free
+        uint64_t last_use = 0;           // tick of the last access
+        bool prefetched = false;         // loaded by the predictor, not used yet
+        void* device_event = nullptr;    // copy into a CUDA pool
+        std::shared_ptr<CpuEvent> host_event;  // copy into a CPU pool
+    };
+
+    bool copy_done(Slot& s);
+    void wait_copy(Slot& s);
+    int32_t alloc_slot(int32_t layer);
+    int32_t load(int32_t layer, int32_t expert, bool prefetched);
+    void learn(int32_t layer, const int32_t* ids, const fp32_t* weights, int64_t T, int64_t K);
+    void predict(int32_t layer, const int32_t* ids, const fp32_t* weights, int64_t T, int64_t K);
+
+    int32_t num_layers_;
+    int32_t num_experts_;
+    int64_t expert_bytes_;
+    const char* host_base_;
+    char* pool_base_;
+    bool pool_cuda_;
+    void* pool_stream_;
+    ExpertCacheOptions options_;
+
+    std::vector<Slot> slots_;
+    std::vector<int32_t> slot_of_;  // [L * E]
+    std::vector<fp32_t> use_;       // [L * E] decayed use counts, LFU key and step prior
+    std::vector<fp32_t> transitions_;  // [L, E, E], layer l -> (l + 1) % L
+    std::vector<int32_t> prev_ids_;  // routing of the last access, for learn()
+    int32_t prev_layer_ = -1;
+    int64_t prev_T_ = 0;
+    int64_t prev_K_ = 0;
+    uint64_t tick_ = 0;
+    ExpertCacheStats stats_;
+    std::unique_ptr<CpuStream> copy_stream_;
+};
+
+} // namespace core
+} // namespace lightllm
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Host storage types for 16 bit floats, so the CPU kernels of the core
+// library do not need c10::Half / c10::BFloat16 or the CUDA headers.
+namespace lightllm {
+namespace core {
+
+struct host_bf16_t {
+    uint16_t bits;
+};
+
+struct host_fp16_t {
+    uint16_t bits;
+};
+
+// float8_e4m3fn: bias 7, no infinities, 0x7f / 0xff are NaN, max 448.
+struct host_fp8_e4m3_t {
+    uint8_t bits;
+};
+
+static_assert(sizeof(host_bf16_t) == 2 && sizeof(host_fp16_t) == 2, "16 bit storage types");
+
+inline float bits_to_float(const uint32_t u) {
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+inline uint32_t float_to_bits(const float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+inline float to_float(const float x) { return x; }
+
+inline float to_float(const host_bf16_t x) { return bits_to_float(static_cast<uint32_t>(x.bits) << 16); }
+
+inline float to_float(const host_fp16_t x) {
+    const uint32_t sign = static_cast<uint32_t>(x.bits & 0x8000) << 16;
+    const uint32_t exp = (x.bits >> 10) & 0x1f;
+    uint32_t mant = x.bits & 0x3ff;
+    if (exp == 0x1f) return bits_to_float(sign | 0x7f800000 | (mant << 13));
+    if (exp != 0) return bits_to_float(sign | ((exp + 112) << 23) | (mant << 13));
+    if (mant == 0) return bits_to_float(sign);
+    // subnormal half, renormalize
+    int32_t e = -1;
+    do {
+        e++;
+        mant <<= 1;
+    } while ((mant & 0x400) == 0);
+    return bits_to_float(sign | static_cast<uint32_t>(112 - e) << 23 | (mant & 0x3ff) << 13);
+}
+
+inline float to_float(const host_fp8_e4m3_t x) {
+    const uint32_t sign = static_cast<uint32_t>(x.bits & 0x80) << 24;
+    const uint32_t exp = (x.bits >> 3) & 0xf;
+    const uint32_t mant = x.bits & 0x7;
+    if (exp == 0xf && mant == 0x7) return bits_to_float(sign | 0x7fc00000);
+    if (exp != 0) return bits_to_float(sign | ((exp + 120) << 23) | (mant << 20));
+    // subnormal, mant * 2^-9
+    return bits_to_float(sign | float_to_bits(static_cast<float>(mant) * (1.0f / 512.0f)));
+}
+
+template <typename T>
+inline T from_float(const float x);
+
+template <>
+inline float from_float<float>(const float x) { return x; }
+
+// Round to nearest even, same as __float2bfloat16.
+template <>
+inline host_bf16_t from_float<host_bf16_t>(const float x) {
+    const uint32_t u = float_to_bits(x);
+    if ((u & 0x7fffffff) > 0x7f800000) return {static_cast<uint16_t>((u >> 16) | 0x40)};
+    return {static_cast<uint16_t>((u + 0x7fff + ((u >> 16) & 1)) >> 16)};
+}
+
+// Round to nearest even, same as __float2half.
+template <>
+inline host_fp16_t from_float<host_fp16_t>(const float x) {
+    const uint32_t u = float_to_bits(x);
+    const uint16_t sign = static_cast<uint16_t>((u >> 16) & 0x8000);
+    const uint32_t a = u & 0x7fffffff;
+    if (a > 0x7f800000) return {static_cast<uint16_t>(sign | 0x7e00)};
+    if (a >= 0x477ff000) return {static_cast<uint16_t>(sign | 0x7c00)};
+    if (a < 0x38800000) {
+        // result is a half subnormal (or zero), add the float in its fixed point range
+        const float f = bits_to_float(a) + 0.5f;
+        return {static_cast<uint16_t>(sign | (float_to_bits(f) - 0x3f000000))};
+    }
+    const uint32_t mant_odd = (a >> 13) & 1;
+    const uint32_t r = a + (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + mant_odd;
+    return {static_cast<uint16_t>(sign | (r >> 13))};
+}
+
+// Round to nearest even and saturate to +-448, same as __nv_fp8_e4m3 (__NV_SATFINITE).
+template <>
+inline host_fp8_e4m3_t from_float<host_fp8_e4m3_t>(const float x) {
+    const uint32_t u = float_to_bits(x);
+    const uint8_t sign = static_cast<uint8_t>((u >> 24) & 0x80);
+    const uint32_t a = u & 0x7fffffff;
+    if (a > 0x7f800000) return {static_cast<uint8_t>(sign | 0x7f)};
+    if (a >= 0x43e00000) return {static_cast<uint8_t>(sign | 0x7e)};  // >= 448, and inf
+    if (a < 0x3c800000) {
+        // result is subnormal (or zero): add 2^14, whose float ulp is the fp8 subnormal step 2^-9
+        const float f = bits_to_float(a) + 16384.0f;
+        return {static_cast<uint8_t>(sign | (float_to_bits(f) - 0x46800000))};
+    }
+    const uint32_t mant_odd = (a >> 20) & 1;
+    const uint32_t r = (a + 0x7ffff + mant_odd) >> 20;
+    const uint32_t bits = r - (static_cast<uint32_t>(127 - 7) << 3);
+    return {static_cast<uint8_t>(sign | (bits > 0x7e ? 0x7e : bits))};
+}
+
+}  // namespace core
+}  // namespace lightllm
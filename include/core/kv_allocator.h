@@ -0,0 +1,188 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "core/common.h"
+#include "core/tensor_view.h"
+
+namespace lightllm {
+namespace core {
+
+/**
+ * KV data a copy-on-write needs moved: the first num_tokens slots of src_page
+ * into dst_page. The allocator only does the bookkeeping, the caller copies
+ * the KV cache contents (e.g. with a batched page copy kernel).
+ */
+struct KvPageCopy {
+    int32_t src_page;
+    int32_t dst_page;
+    int32_t num_tokens;
+};
+
+// Pages of a request KvPageAllocator::downgrade never touches.
+struct KvDowngradePolicy {
+    int32_t num_sink_pages = 1;     // first pages (attention sinks)
+    int32_t num_recent_pages = 8;   // last full pages (local window)
+};
+
+/**
+ * @brief Host-side paged KV cache allocator that maintains req_to_tokens.
+ *
+ * The KV cache is split in num_pages pages of page_size token slots, token
+ * slot = page * page_size + offset. Pages and request rows come from free
+ * lists, so allocation and release are O(1). Pages are reference counted:
+ * fork() shares the pages of a prefix with a new request (prefix sharing,
+ * beam search), and a shared page that is partially filled is copied on the
+ * first write by any of its owners.
+ *
+ * Every change of a request's pages is written in place into req_to_tokens
+ * ([max_reqs, max_seq_len] int32 in host memory, row stride may be padded),
+ * so the table can be handed to the attention kernels as is (after a copy to
+ * the device). Not thread safe, one scheduler thread owns an allocator.
+ *
+ * With a page_precision tensor ([num_pages] int8 in host memory, also written
+ * in place) downgrade() reclaims pages under memory pressure by packing two
+ * cold pages into one at half the precision, see kv_downgrade_pages. The
+ * second page of a pair keeps its tokens under virtual page num_pages + p,
+ * slots [num_slots + p * page_size, ...), which decode_attention resolves
+ * through page_precision.
+ *
+ * A request that holds downgraded pages can only be read by the ops that
+ * take page_precision: decode_attention, mixed_int8kv_attention and (torch)
+ * flashdecoding_stage1. The ops that read slots without it (kv_copy_slots,
+ * kv_gather_slots / kv_scatter_slots, kv_pack / kv_unpack, KvOffloadEngine,
+ * kv_page_minmax_update, quest_select_pages, sparse_int8kv_decode_attention)
+ * reject its virtual slots: they throw on slots in host memory and the
+ * kernels trap on device ones. Of the allocator, free_req, extend, compact
+ * and downgrade handle downgraded pages; fork, truncate and evict restrict
+ * them as documented.
+ */
+class KvPageAllocator {
+ public:
+    KvPageAllocator(int32_t num_pages, int32_t page_size, int32_t max_reqs,
+                    int32_t max_seq_len, const TensorView& req_to_tokens,
+                    const TensorView& page_precision = TensorView());
+
+    // Row of a free request with seq_len 0, -1 if all rows are in use.
+    int32_t alloc_req();
+
+    // Releases the row and drops its references on its pages.
+    void free_req(int32_t req);
+
+    // free_req over a batch. All or nothing: every row is checked (allocated,
+    // no duplicates) before any is released.
+    void free_reqs(const int32_t* reqs, int32_t n);
+
+    /**
+     * New request sharing the first prefix_len tokens of src (and their
+     * pages), -1 if all rows are in use. Its table row is filled. The prefix
+     * must not end inside a downgraded page.
+     */
+    int32_t fork(int32_t src, int32_t prefix_len);
+
+    /**
+     * Appends num_new[i] tokens to request reqs[i] for one scheduler step.
+     * The slots of the new tokens are written to req_to_tokens and, in batch
+     * order, to out_slots (sum(num_new) entries). Copy-on-writes of shared
+     * pages are appended to copies (if not null).
+     *
+     * All or nothing: returns false and changes nothing if there are not
+     * enough free pages for the whole batch.
+     */
+    bool extend(const int32_t* reqs, const int32_t* num_new, int32_t n,
+                int32_t* out_slots, std::vector<KvPageCopy>* copies);
+
+    // Drops the tokens after new_len, e.g. rejected speculative tokens. The
+    // new last page must not be a partially kept downgraded page.
+    void truncate(int32_t req, int32_t new_len);
+
+    /**
+     * Keeps only the tokens at positions keep[0..n_keep) (ascending) of req,
+     * moved down to positions [0, n_keep), and frees the pages after them
+     * (KV eviction, see kv_evict_select). The (src_slot, dst_slot) moves are
+     * appended to slot_pairs; they may chain (a dst is a later src), so apply
+     * them with a gather then a scatter, not kv_copy_slots, before the next
+     * extend reuses the freed pages. A shared page that is written is first
+     * copied to a new page.
+     *
+     * Returns false and changes nothing if those copies need more free pages
+     * than there are. The request must not hold downgraded pages.
+     */
+    bool evict(int32_t req, const int32_t* keep, int32_t n_keep, std::vector<int32_t>* slot_pairs);
+
+    /**
+     * Compaction plan: moves the pages in use above the first num_used pages
+     * into the free pages below, so the used pages become [0, num_used). Each
+     * moved page is copied exactly once (the minimum), only the filled part
+     * of it is counted in num_tokens. The table rows of all owners are
+     * rewritten at once, so the moves must be applied to the KV cache before
+     * the next step reads it. Returns the number of moves appended to moves.
+     * A downgraded page moves with both its halves and its page_precision tag.
+     */
+    int32_t compact(std::vector<KvPageCopy>* moves);
+
+    /**
+     * Frees up to num_pages pages by downgrading cold ones: full pages owned
+     * by one request alone, outside the sink and recent pages of policy,
+     * taken oldest first from the longest requests. Each freed page q is
+     * packed with another cold page p of the same request into p, whose
+     * page_precision tag is set; the table row is rewritten to the virtual
+     * slots of q at once. The (p, q) pairs are appended to page_pairs and
+     * must be converted with kv_downgrade_pages before the next extend
+     * reuses the freed pages. Returns the number of pages freed.
+     */
+    int32_t downgrade(int32_t num_pages, const KvDowngradePolicy& policy, std::vector<int32_t>* page_pairs);
+
+    // (src_slot, dst_slot) pairs of the page copies, for kv_copy_slots.
+    void slot_pairs(const std::vector<KvPageCopy>& copies, std::vector<int32_t>* pairs) const;
+
+    int32_t seq_len(int32_t req) const;
+    const std::vector<int32_t>& pages(int32_t req) const;
+    int32_t page_ref(int32_t page) const;
+    // Whether the physical page behind page (or virtual page) holds a downgraded pair.
+    bool downgraded(int32_t page) const { return precision_ != nullptr && precision_[page % num_pages_] != 0; }
+
+    int32_t num_free_pages() const { return static_cast<int32_t>(free_pages_.size()); }
+    int32_t num_free_reqs() const { return static_cast<int32_t>(free_reqs_.size()); }
+
+    int32_t num_pages() const { return num_pages_; }
+    int32_t page_size() const { return page_size_; }
+    int32_t max_reqs() const { return max_reqs_; }
+    int32_t max_seq_len() const { return max_seq_len_; }
+
+ private:
+    struct Request {
+        bool active = false;
+        int32_t seq_len = 0;
+        std::vector<int32_t> pages;
+    };
+
+    int32_t* row(int32_t req) const { return table_ + static_cast<int64_t>(req) * table_stride_; }
+    void check_req(int32_t req) const;
+    // Pages extend needs for n more tokens, including a copy-on-write.
+    int32_t pages_needed(const Request& r, int32_t n) const;
+    void release_page(int32_t page);
+    // A physical page is in use while either of its halves is referenced.
+    bool in_use(int32_t page) const { return page_refs_[page] + page_refs_[num_pages_ + page] > 0; }
+
+    int32_t num_pages_;
+    int32_t page_size_;
+    int32_t max_reqs_;
+    int32_t max_seq_len_;
+
+    int32_t* table_;
+    int64_t table_stride_;
+    int8_t* precision_ = nullptr;
+
+    std::vector<int32_t> free_pages_;
+    std::vector<int32_t> free_reqs_;
+    // [2 * num_pages]: physical pages, then the virtual pages of downgraded pairs
+    std::vector<int32_t> page_refs_;
+    std::vector<Request> reqs_;
+    // Marks the requests of the current extend / free_reqs batch to reject duplicates.
+    std::vector<uint64_t> batch_stamp_;
+    uint64_t stamp_ = 0;
+};
+
+}  // namespace core
+}  // namespace lightllm
@@ -0,0 +1,186 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core/common.h"
+#include "core/tensor_view.h"
+
+namespace lightllm {
+namespace core {
+
+/**
+ * @brief First-fit allocator of byte ranges in [0, capacity), freed ranges
+ * merge with their free neighbours.
+ */
+class RangeAllocator {
+ public:
+    explicit RangeAllocator(int64_t capacity = 0);
+
+    // Offset of a free range of bytes, -1 if there is none.
+    int64_t alloc(int64_t bytes);
+    void free(int64_t offset, int64_t bytes);
+
+    int64_t capacity() const { return capacity_; }
+    int64_t free_bytes() const { return free_bytes_; }
+
+ private:
+    int64_t capacity_;
+    int64_t free_bytes_;
+    std::map<int64_t, int64_t> free_;  // offset -> bytes
+};
+
+enum class KvTier : int32_t {
+    None = 0,  // not offloaded
+    Host = 1,
+    Disk = 2,
+};
+
+/**
+ * @brief Moves the KV cache rows of paused requests to host memory and an
+ * mmap'd file and brings them back before the request runs again.
+ *
+ * offload() packs the rows of a request's slots (all caches, all layers, see
+ * kv_gather_slots) into one contiguous range of the host arena. For CUDA
+ * caches the arena must be pinned, the gather kernel writes it directly and
+ * runs asynchronously on the caches' stream. When the arena is full the least
+ * recently used entries are written to the disk tier; entries that were
+ * prefetched stay in the host tier until they are restored or dropped.
+ *
+ * Entries on disk come back to the host through prefetches: the scheduler
+ * queues them ahead of time with request_prefetch() and every step calls
+ * issue_prefetches() with the bytes its IO budget allows for the step (e.g.
+ * io_bandwidth() * step time); the reads run on a background IO thread.
+ * restore() scatters an entry into freshly allocated slots (one kernel for
+ * CUDA caches) and releases it.
+ *
+ * All methods must be called from one thread. Host ranges that are still
+ * read or written by the device are only reused once its work has finished.
+ */
+class KvOffloadEngine {
+ public:
+    /**
+     * @param host_arena  Contiguous CPU buffer backing the host tier, pinned
+     *                    for CUDA caches. Must outlive the engine.
+     * @param disk_path   File backing the disk tier, created or resized to
+     *                    disk_bytes; empty for no disk tier.
+     */
+    KvOffloadEngine(const TensorView& host_arena, const std::string& disk_path, int64_t disk_bytes);
+    ~KvOffloadEngine();
+
+    KvOffloadEngine(const KvOffloadEngine&) = delete;
+    KvOffloadEngine& operator=(const KvOffloadEngine&) = delete;
+
+    // Packs slots of caches under key. false if neither tier has room. The
+    // slots must be physical ones, see check_kv_slots.
+    bool offload(int64_t key, const std::vector<TensorView>& caches,
+                 const TensorView& slots, int32_t slot_dim);
+
+    // Queues key to be read back to the host tier, higher priority first.
+    void request_prefetch(int64_t key, int32_t priority = 0);
+
+    /**
+     * Starts the queued disk reads, in priority order, until budget_bytes are
+     * issued (at least one read). Returns the keys that were started; reads
+     * that find no host room stay queued.
+     */
+    std::vector<int64_t> issue_prefetches(int64_t budget_bytes);
+
+    // True if key is in the host tier with no read in flight.
+    bool ready(int64_t key);
+    void wait(int64_t key);
+
+    /**
+     * Writes the rows of key into slots (as many as were offloaded) and drops
+     * the entry. An entry still on disk is read synchronously first. Host
+     * slots are checked before the entry is touched.
+     */
+    void restore(int64_t key, const std::vector<TensorView>& caches,
+                 const TensorView& slots, int32_t slot_dim);
+
+    void drop(int64_t key);
+
+    KvTier tier(int64_t key) const;
+    int64_t num_tokens(int64_t key) const;
+    int64_t host_free_bytes() const;
+    int64_t disk_free_bytes() const;
+
+    // Measured disk -> host read bandwidth in bytes/s, 0 before the first read.
+    double io_bandwidth() const;
+
+ private:
+    struct Entry {
+        KvTier tier = KvTier::None;
+        int64_t num_tokens = 0;
+        int64_t bytes = 0;
+        int64_t host_offset = -1;
+        int64_t disk_offset = -1;
+        void* device_event = nullptr;  // device work writing the host range
+        bool io_pending = false;       // disk -> host read in flight
+        bool queued = false;           // waiting in prefetch_queue_
+        bool prefetched = false;       // read back for an upcoming restore, never demoted
+        bool in_lru = false;           // host entries only
+        std::list<int64_t>::iterator lru;
+    };
+
+    struct Prefetch {
+        int64_t key;
+        int32_t priority;
+        uint64_t order;
+    };
+
+    struct PendingFree {
+        int64_t offset;
+        int64_t bytes;
+        void* device_event;
+    };
+
+    Entry& entry(int64_t key);
+    const Entry& entry(int64_t key) const;
+    int64_t alloc_host(int64_t bytes, int64_t keep_key);
+    bool demote_lru(int64_t keep_key);
+    void reclaim_host(bool wait);
+    void release_host(Entry& e, void* device_event);
+    void touch(int64_t key, Entry& e);
+    void io_loop();
+    void wait_io(Entry& e, std::unique_lock<std::mutex>& lock);
+
+    char* host_base_;
+    RangeAllocator host_;
+    char* disk_base_ = nullptr;
+    int64_t disk_bytes_ = 0;
+    int disk_fd_ = -1;
+    RangeAllocator disk_;
+
+    std::unordered_map<int64_t, Entry> entries_;
+    std::list<int64_t> lru_;  // host entries, most recently used first
+    std::vector<Prefetch> prefetch_queue_;
+    uint64_t prefetch_order_ = 0;
+    std::vector<PendingFree> pending_free_;
+
+    // IO thread: disk -> host reads.
+    struct IoJob {
+        int64_t key;
+        char* dst;
+        const char* src;
+        int64_t bytes;
+    };
+    mutable std::mutex mutex_;
+    std::condition_variable io_cv_;
+    std::condition_variable done_cv_;
+    std::deque<IoJob> io_jobs_;
+    bool stop_ = false;
+    double io_seconds_ = 0.0;
+    int64_t io_bytes_ = 0;
+    std::thread io_thread_;
+};
+
+}  // namespace core
+}  // namespace lightllm
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "core/common.h"
+#include "core/ops.h"
+#include "core/tensor_view.h"
+
+namespace lightllm {
+namespace core {
+
+constexpr uint32_t kKvTransferMagic = 0x564b4b4c;  // "LKKV" little endian
+constexpr uint16_t kKvTransferVersion = 1;
+// The payload starts here, aligned for 16-byte accesses.
+constexpr int64_t kKvTransferHeaderBytes = 256;
+
+struct KvTransferTensor {
+    int32_t dtype;       // DType
+    int32_t reserved;
+    int64_t row_bytes;   // bytes of one token row of one layer
+};
+
+/**
+ * @brief Header of a packed KV transfer buffer (little endian), followed at
+ * kKvTransferHeaderBytes by the payload in the layout of kv_gather_slots:
+ * tensor by tensor, layer by layer, the token rows in request order. The
+ * payload does not depend on how the sender stores its layers (slot_dim).
+ */
+struct KvTransferHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_bytes;
+    int32_t num_tensors;
+    int32_t reserved;
+    int64_t num_tokens;
+    int64_t layers;
+    int64_t payload_bytes;
+    int64_t tag;         // caller defined, e.g. the request id
+    KvTransferTensor tensors[kMaxKvCopyTensors];
+};
+static_assert(sizeof(KvTransferHeader) <= kKvTransferHeaderBytes, "header does not fit");
+
+// Header of caches (layers from slot_dim) for num_tokens tokens.
+KvTransferHeader make_kv_transfer_header(
+    const std::vector<TensorView>& caches, const int32_t slot_dim,
+    const int64_t num_tokens, const int64_t tag
+);
+
+// Total buffer size: header plus payload.
+inline int64_t kv_transfer_bytes(const KvTransferHeader& h) { return h.header_bytes + h.payload_bytes; }
+
+// Reads and validates the header of buffer, a synchronous copy if it is device memory.
+KvTransferHeader read_kv_transfer_header(const TensorView& buffer);
+
+void kv_pack(
+    const std::vector<TensorView>& caches, const TensorView& slots, const int32_t slot_dim,
+    const int64_t tag, const TensorView& buffer
+);
+
+void kv_pack_cuda(
+    const std::vector<TensorView>& caches, const TensorView& slots, const int32_t slot_dim,
+    const KvTransferHeader& header, const TensorView& buffer
+);
+
+void kv_unpack(
+    const std::vector<TensorView>& caches, const TensorView& slots, const int32_t slot_dim,
+    const TensorView& buffer
+);
+
+}  // namespace core
+}  // namespace lightllm
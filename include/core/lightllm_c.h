@@ -0,0 +1,453 @@
+#ifndef LIGHTLLM_CORE_LIGHTLLM_C_H_
+#define LIGHTLLM_CORE_LIGHTLLM_C_H_
+
+/**
+ * Stable C ABI of the lightllm core library.
+ *
+ * This header is plain C and does not depend on libtorch, Python or CUDA, so
+ * it can be consumed by any C/C++ inference server (or a FFI) that links
+ * liblightllm_core. Tensors are described by lk_tensor_t, a non-owning view;
+ * the caller keeps the memory alive for the duration of the call.
+ *
+ * Every function returns an lk_status_t. On failure a description of the
+ * error can be retrieved with lk_get_last_error() on the same thread.
+ */
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define LK_API __declspec(dllexport)
+#else
+#define LK_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LK_ABI_VERSION 3
+#define LK_MAX_DIMS 8
+
+typedef enum {
+    LK_SUCCESS = 0,
+    LK_ERROR_INVALID_ARGUMENT = 1,
+    LK_ERROR_NOT_SUPPORTED = 2,
+    LK_ERROR_RUNTIME = 3,
+} lk_status_t;
+
+typedef enum {
+    LK_DTYPE_FLOAT32 = 0,
+    LK_DTYPE_FLOAT16 = 1,
+    LK_DTYPE_BFLOAT16 = 2,
+    LK_DTYPE_FP8_E4M3 = 3,
+    LK_DTYPE_INT8 = 4,
+    LK_DTYPE_UINT8 = 5,
+    LK_DTYPE_INT32 = 6,
+    LK_DTYPE_INT64 = 7,
+} lk_dtype_t;
+
+typedef enum {
+    LK_DEVICE_CPU = 0,
+    LK_DEVICE_CUDA = 1,
+} lk_device_type_t;
+
+/**
+ * Non-owning tensor view. strides are in elements. stream is the cudaStream_t
+ * kernels on this tensor are launched on (NULL for the default stream). For
+ * CPU tensors it is NULL to run the op on the calling thread, or an
+ * lk_cpu_stream_t* to enqueue it: ops read it from the tensor they write
+ * (caches[0] for lk_kv_copy_slots / lk_kv_pack / lk_kv_unpack,
+ * whose device and stream the copies run on) and return right away, the
+ * memory of all tensors must then stay valid until the op has run.
+ */
+typedef struct {
+    void* data;
+    lk_dtype_t dtype;
+    int32_t ndim;
+    int64_t shape[LK_MAX_DIMS];
+    int64_t strides[LK_MAX_DIMS];
+    lk_device_type_t device_type;
+    int32_t device_index;
+    void* stream;
+} lk_tensor_t;
+
+/** ABI version this library was built with, compare against LK_ABI_VERSION. */
+LK_API int32_t lk_abi_version(void);
+
+/** Message of the last failed call on this thread, "" if there is none. */
+LK_API const char* lk_get_last_error(void);
+
+/** Whether the library was built with CUDA kernels. */
+LK_API int32_t lk_has_cuda(void);
+
+/** Number of threads used by the CPU kernels. */
+LK_API lk_status_t lk_set_num_threads(int32_t num_threads);
+LK_API int32_t lk_get_num_threads(void);
+
+/**
+ * Instruction set level of the CPU kernels: "scalar", "avx2", "avx512",
+ * "avx512_bf16" or "amx". lk_get_cpu_isa returns the active level (detected
+ * = 0) or the highest one this CPU supports (detected = 1); the strings are
+ * static. lk_set_cpu_isa forces a level up to the detected one.
+ */
+LK_API lk_status_t lk_set_cpu_isa(const char* isa);
+LK_API const char* lk_get_cpu_isa(int32_t detected);
+
+/**
+ * Ordered queue of CPU work, the host counterpart of a cudaStream_t (see
+ * lightllm::core::CpuStream). Enqueued ops run in order on a thread of the
+ * stream and split across the CPU kernel threads. A failed op makes the
+ * following ones skip until lk_cpu_stream_synchronize returns its error.
+ * lk_cpu_stream_destroy runs the queued work first.
+ */
+typedef struct lk_cpu_stream lk_cpu_stream_t;
+typedef struct lk_cpu_event lk_cpu_event_t;
+
+LK_API lk_status_t lk_cpu_stream_create(lk_cpu_stream_t** stream);
+LK_API void lk_cpu_stream_destroy(lk_cpu_stream_t* stream);
+LK_API lk_status_t lk_cpu_stream_synchronize(lk_cpu_stream_t* stream);
+/** 1 if all enqueued work has run, 0 otherwise. */
+LK_API int32_t lk_cpu_stream_query(lk_cpu_stream_t* stream);
+/** Enqueues fn(user_data), like cudaLaunchHostFunc. */
+LK_API lk_status_t lk_cpu_stream_launch(lk_cpu_stream_t* stream, void (*fn)(void*), void* user_data);
+
+/**
+ * *event completes once the work enqueued on stream so far has run; its
+ * synchronize fails if an op before it did. lk_cpu_stream_wait_event makes
+ * the later work of stream wait for an event of any stream.
+ */
+LK_API lk_status_t lk_cpu_event_record(lk_cpu_stream_t* stream, lk_cpu_event_t** event);
+LK_API lk_status_t lk_cpu_stream_wait_event(lk_cpu_stream_t* stream, const lk_cpu_event_t* event);
+LK_API lk_status_t lk_cpu_event_synchronize(const lk_cpu_event_t* event);
+LK_API int32_t lk_cpu_event_query(const lk_cpu_event_t* event);
+LK_API void lk_cpu_event_destroy(lk_cpu_event_t* event);
+
+/**
+ * y = x / sqrt(mean(x^2) + eps) * w over the last dim.
+ * x, y: [M, N], w: [N]. CUDA: bf16. CPU: fp32 / fp16 / bf16.
+ */
+LK_API lk_status_t lk_rmsnorm(
+    const lk_tensor_t* x, const lk_tensor_t* w, lk_tensor_t* y, float eps);
+
+/** Opaque RMSNorm launch plan, owned by the library (never freed). */
+typedef struct lk_rmsnorm_plan lk_rmsnorm_plan_t;
+
+/**
+ * Validate the layout of x once (data is ignored) and resolve the kernel.
+ * Plans are cached by (N, dtype, device, eps), one plan serves every number
+ * of rows; keep *plan to skip even the lookup.
+ */
+LK_API lk_status_t lk_make_rmsnorm_plan(
+    const lk_tensor_t* x, float eps, const lk_rmsnorm_plan_t** plan);
+
+/**
+ * Only launches m rows: x and y must be contiguous [m, N] of the dtype and
+ * device of the plan, w a contiguous [N] tensor of the same dtype. m == 0
+ * launches nothing. stream is a cudaStream_t.
+ */
+LK_API lk_status_t lk_rmsnorm_plan_run(
+    const lk_rmsnorm_plan_t* plan, const void* x, const void* w, void* y, int64_t m, void* stream);
+
+/**
+ * x += r (bf16, in place), then y = quant(rmsnorm(x) * w) per token with
+ * scales absmax / 448 (fp8) or absmax / 127 (int8), see add_norm_quant.
+ * x, r, y: [M, N], w: [N] bf16, scales: M fp32. CUDA: fp8 y only.
+ */
+LK_API lk_status_t lk_add_norm_quant(
+    lk_tensor_t* x, const lk_tensor_t* r, const lk_tensor_t* w,
+    lk_tensor_t* y, lk_tensor_t* scales, float eps);
+
+/**
+ * c = (a_scales * b_scales * (a @ b) + bias) * ls on the CPU, see
+ * cutlass_scaled_mm. a: int8 / fp8 [M, K] row major, b: [K, N] column major,
+ * a_scales: fp32 [M] or [1], b_scales: fp32 [N] or [1], bias / ls: NULL or
+ * [N] of the dtype of c, c: bf16 / fp16 / fp32 [M, N].
+ */
+LK_API lk_status_t lk_scaled_mm(
+    lk_tensor_t* c, const lk_tensor_t* a, const lk_tensor_t* b,
+    const lk_tensor_t* a_scales, const lk_tensor_t* b_scales,
+    const lk_tensor_t* bias, const lk_tensor_t* ls);
+
+/**
+ * Per-shard fused log-softmax statistics and top-N logits,
+ * see lightllm_kernel.ops.logprobs_topn_partial.
+ */
+LK_API lk_status_t lk_logprobs_topn_partial(
+    lk_tensor_t* topn_vals, lk_tensor_t* topn_ids,
+    lk_tensor_t* sampled_vals, lk_tensor_t* stats,
+    const lk_tensor_t* logits, const lk_tensor_t* sampled_ids,
+    int64_t vocab_start, int32_t normalize);
+
+/**
+ * Cross-shard merge of lk_logprobs_topn_partial results,
+ * see lightllm_kernel.ops.logprobs_topn_merge.
+ */
+LK_API lk_status_t lk_logprobs_topn_merge(
+    lk_tensor_t* out_logprobs, lk_tensor_t* out_ids, lk_tensor_t* out_sampled,
+    const lk_tensor_t* stats, const lk_tensor_t* topn_vals,
+    const lk_tensor_t* topn_ids, const lk_tensor_t* sampled_vals);
+
+/**
+ * Non-causal attention over packed variable length sequences,
+ * see lightllm_kernel.ops.varlen_attention.
+ */
+LK_API lk_status_t lk_varlen_attention(
+    lk_tensor_t* out, const lk_tensor_t* q, const lk_tensor_t* k, const lk_tensor_t* v,
+    const lk_tensor_t* cu_seqlens, int64_t max_seqlen, float softmax_scale);
+
+/**
+ * Decode attention over an int8 KV cache with group-8 scales, int8_qk != 0
+ * computes QK with int8 dot products, see
+ * lightllm_kernel.ops.group_int8kv_decode_attention.
+ */
+LK_API lk_status_t lk_int8kv_decode_attention(
+    lk_tensor_t* o, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    int64_t max_len_in_batch, int32_t int8_qk);
+
+/**
+ * Decode attention over an int8 or fp8_e4m3 KV cache with group-8 scales,
+ * or an unquantized one of the dtype of q with k_s / v_s NULL, see
+ * lightllm_kernel.ops.decode_attention.
+ */
+LK_API lk_status_t lk_decode_attention(
+    lk_tensor_t* o, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    int64_t max_len_in_batch);
+
+/**
+ * Quest-style sparse decode: lk_kv_page_minmax_update refreshes the per page
+ * key min / max after K was stored at slots, lk_quest_select_pages writes
+ * the top pages of every (request, kv head) to page_idx ([B, Hkv, top] int32)
+ * using scores ([B, Hkv, max_pages] fp32) as scratch, and
+ * lk_sparse_int8kv_decode_attention attends over them, see
+ * lightllm_kernel.ops.quest_int8kv_decode_attention.
+ */
+LK_API lk_status_t lk_kv_page_minmax_update(
+    lk_tensor_t* page_min, lk_tensor_t* page_max, const lk_tensor_t* k, const lk_tensor_t* k_s,
+    const lk_tensor_t* slots, int64_t page_size);
+
+LK_API lk_status_t lk_quest_select_pages(
+    lk_tensor_t* page_idx, lk_tensor_t* scores, const lk_tensor_t* q,
+    const lk_tensor_t* page_min, const lk_tensor_t* page_max,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    int64_t page_size);
+
+LK_API lk_status_t lk_sparse_int8kv_decode_attention(
+    lk_tensor_t* o, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    const lk_tensor_t* page_idx, int64_t page_size);
+
+/**
+ * Work list of lk_mixed_int8kv_attention for a batch (host arrays):
+ * *num_work units of four int32 (batch, kv_head, q_begin, q_end) are
+ * written to work, which must hold cu_q_lens[batch] * num_kv_heads units.
+ */
+LK_API lk_status_t lk_plan_mixed_attention(
+    const int32_t* cu_q_lens, const int32_t* seq_lens, int64_t batch,
+    int64_t num_heads, int64_t num_kv_heads, int32_t* work, int32_t* num_work);
+
+/**
+ * Prefill chunks and decode tokens over the int8 KV cache in one launch,
+ * work is the [n, 4] int32 list of lk_plan_mixed_attention on the device
+ * of q, see lightllm_kernel.ops.mixed_int8kv_attention.
+ */
+LK_API lk_status_t lk_mixed_int8kv_attention(
+    lk_tensor_t* o, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    const lk_tensor_t* cu_q_lens, const lk_tensor_t* work);
+
+/**
+ * Flash decoding stage 1 over the KV caches of lk_decode_attention (k_s /
+ * v_s NULL for an unquantized one): writes the outputs and log-sum-exps of
+ * every seq block that lk_flashdecoding_combine merges, see
+ * lightllm_kernel.ops.flashdecoding_stage1.
+ */
+LK_API lk_status_t lk_flashdecoding_stage1(
+    lk_tensor_t* mid_o_emb, lk_tensor_t* mid_o_logexpsum, const lk_tensor_t* q,
+    const lk_tensor_t* k, const lk_tensor_t* k_s, const lk_tensor_t* v, const lk_tensor_t* v_s,
+    const lk_tensor_t* req_to_tokens, const lk_tensor_t* b_req_idx, const lk_tensor_t* b_seq_len,
+    int64_t max_len_in_batch, int64_t seq_block_size, float att_scale);
+
+/**
+ * Flash decoding stage 2, merges the per block outputs into o; an fp8_e4m3
+ * o is quantized per token with scales in o_scale (NULL otherwise), see
+ * lightllm_kernel.ops.flashdecoding_combine.
+ */
+LK_API lk_status_t lk_flashdecoding_combine(
+    lk_tensor_t* o, lk_tensor_t* o_scale, const lk_tensor_t* mid_o_emb,
+    const lk_tensor_t* mid_o_logexpsum, const lk_tensor_t* b_seq_len, int64_t seq_block_size);
+
+/**
+ * Copies token rows src -> dst of num_caches (<= 8) KV cache tensors in one
+ * launch. pairs is [n, 2] int32 (src_slot, dst_slot), slot_dim 0 or 1.
+ */
+LK_API lk_status_t lk_kv_copy_slots(
+    const lk_tensor_t* caches, int32_t num_caches, const lk_tensor_t* pairs, int32_t slot_dim);
+
+/**
+ * Packed KV transfer buffers (see lightllm::core::kv_pack): *bytes is the
+ * buffer size for num_tokens slots of the caches, lk_kv_pack writes the rows
+ * of slots with a versioned header, lk_kv_transfer_info reads the header of a
+ * received buffer and lk_kv_unpack writes its rows into slots.
+ */
+LK_API lk_status_t lk_kv_transfer_bytes(
+    const lk_tensor_t* caches, int32_t num_caches, int32_t slot_dim, int64_t num_tokens, int64_t* bytes);
+LK_API lk_status_t lk_kv_pack(
+    const lk_tensor_t* caches, int32_t num_caches, const lk_tensor_t* slots, int32_t slot_dim,
+    int64_t tag, lk_tensor_t* buffer);
+LK_API lk_status_t lk_kv_transfer_info(const lk_tensor_t* buffer, int64_t* num_tokens, int64_t* tag);
+LK_API lk_status_t lk_kv_unpack(
+    const lk_tensor_t* caches, int32_t num_caches, const lk_tensor_t* slots, int32_t slot_dim,
+    const lk_tensor_t* buffer);
+
+/**
+ * Chained 64-bit (out [B, L / page_size, 1]) or 128-bit (out [..., 2]) int64
+ * hashes of the full pages of tokens [B, L] with lens [B], on the host.
+ */
+LK_API lk_status_t lk_page_hashes(
+    const lk_tensor_t* tokens, const lk_tensor_t* lens, int64_t page_size, uint64_t seed, lk_tensor_t* out);
+
+/**
+ * Hybrid CPU / GPU MoE, see lightllm::core::hybrid_moe_partition: splits the
+ * [T, K] routing (host int32 ids, fp32 weights) by residency ([E] int32,
+ * device slot or -1) into device_ids / device_weights ([T, K]) and the CPU
+ * rows grouped by expert (cpu_offsets [E + 1], cpu_tokens / cpu_weights of
+ * T * K entries, *num_cpu_rows of them used). lk_moe_cpu_experts computes
+ * them into out ([T, H] fp32) from x ([T, H]) and the host weights of the
+ * num_experts experts: w13 [H, 2I] and w2 [I, H] int8 / fp8 column major,
+ * scales fp32 per channel or [1]; experts without CPU rows may have
+ * zero-filled lk_tensor_t entries.
+ */
+LK_API lk_status_t lk_hybrid_moe_partition(
+    const lk_tensor_t* topk_ids, const lk_tensor_t* topk_weights, const lk_tensor_t* residency,
+    lk_tensor_t* device_ids, lk_tensor_t* device_weights, lk_tensor_t* cpu_offsets,
+    lk_tensor_t* cpu_tokens, lk_tensor_t* cpu_weights, int64_t* num_cpu_rows);
+LK_API lk_status_t lk_moe_cpu_experts(
+    lk_tensor_t* out, const lk_tensor_t* x, const lk_tensor_t* cpu_offsets,
+    const lk_tensor_t* cpu_tokens, const lk_tensor_t* cpu_weights,
+    const lk_tensor_t* w13, const lk_tensor_t* w13_scales, const lk_tensor_t* w2,
+    const lk_tensor_t* w2_scales, int32_t num_experts);
+
+/**
+ * Expert weight cache in front of lk_hybrid_moe_partition, see
+ * lightllm::core::ExpertCache: host_weights [L, E, B] and pool [S, B] uint8,
+ * one expert per row. lk_expert_cache_access makes the routed experts of a
+ * layer resident, writes the residency map ([E] int32) and prefetches the
+ * predicted experts of the next layer. eviction is 0 for LRU, 1 for LFU.
+ */
+typedef struct lk_expert_cache lk_expert_cache_t;
+
+typedef struct {
+    int64_t hits;
+    int64_t misses;
+    int64_t late_prefetches;
+    int64_t prefetches;
+    int64_t useful_prefetches;
+    int64_t evictions;
+    int64_t bytes_copied;
+    double stall_seconds;
+} lk_expert_cache_stats_t;
+
+LK_API lk_status_t lk_expert_cache_create(
+    const lk_tensor_t* host_weights, const lk_tensor_t* pool, int32_t eviction, int32_t prefetch_per_layer,
+    int32_t fetch_misses, float decay, lk_expert_cache_t** cache);
+LK_API void lk_expert_cache_destroy(lk_expert_cache_t* cache);
+LK_API lk_status_t lk_expert_cache_access(
+    lk_expert_cache_t* cache, int32_t layer, const lk_tensor_t* topk_ids, const lk_tensor_t* topk_weights,
+    lk_tensor_t* residency);
+LK_API lk_status_t lk_expert_cache_prefetch(
+    lk_expert_cache_t* cache, int32_t layer, const int32_t* experts, int32_t n, int32_t* started);
+LK_API lk_status_t lk_expert_cache_synchronize(lk_expert_cache_t* cache);
+LK_API lk_status_t lk_expert_cache_stats(const lk_expert_cache_t* cache, lk_expert_cache_stats_t* stats);
+LK_API void lk_expert_cache_reset_stats(lk_expert_cache_t* cache);
+
+/**
+ * Read-only mmap of a safetensors shard, see lightllm::core::SafetensorsFile.
+ * lk_safetensors_name gives the tensor names in file order (valid while the
+ * file is open), lk_safetensors_tensor a host view into the mapping.
+ */
+typedef struct lk_safetensors lk_safetensors_t;
+
+LK_API lk_status_t lk_safetensors_open(const char* path, lk_safetensors_t** file);
+LK_API void lk_safetensors_close(lk_safetensors_t* file);
+LK_API int32_t lk_safetensors_num_tensors(const lk_safetensors_t* file);
+LK_API lk_status_t lk_safetensors_name(const lk_safetensors_t* file, int32_t index, const char** name);
+LK_API lk_status_t lk_safetensors_tensor(const lk_safetensors_t* file, const char* name, lk_tensor_t* view);
+
+/**
+ * Per output channel weight quantization into the b operand of scaled_mm:
+ * w [N, K] bf16 / fp16 / fp32 host, q [K, N] int8 / fp8 column major, scales
+ * [N] fp32. lk_quantize_weights runs n of them with the source reads
+ * (io_threads, up to readahead_bytes ahead) overlapped with the quantization
+ * and calls on_done(i, user_data) on the calling thread after weight i.
+ */
+typedef struct {
+    int64_t bytes_read;
+    int64_t bytes_written;
+    double seconds;
+    double read_wait_seconds;
+} lk_weight_load_stats_t;
+
+LK_API lk_status_t lk_quantize_weight(const lk_tensor_t* w, lk_tensor_t* q, lk_tensor_t* scales);
+LK_API lk_status_t lk_quantize_weights(
+    const lk_tensor_t* w, lk_tensor_t* q, lk_tensor_t* scales, int32_t n, int32_t io_threads,
+    int64_t readahead_bytes, void (*on_done)(int32_t index, void* user_data), void* user_data,
+    lk_weight_load_stats_t* stats);
+
+/** Paged KV cache allocator, see lightllm::core::KvPageAllocator. */
+typedef struct lk_kv_allocator lk_kv_allocator_t;
+
+typedef struct {
+    int32_t src_page;
+    int32_t dst_page;
+    int32_t num_tokens;
+} lk_kv_page_copy_t;
+
+/** req_to_tokens: host int32 [>= max_reqs, >= max_seq_len], must outlive the allocator. */
+LK_API lk_status_t lk_kv_allocator_create(
+    int32_t num_pages, int32_t page_size, int32_t max_reqs, int32_t max_seq_len,
+    const lk_tensor_t* req_to_tokens, lk_kv_allocator_t** allocator);
+LK_API void lk_kv_allocator_destroy(lk_kv_allocator_t* allocator);
+
+/** *req is -1 if all request rows are in use. */
+LK_API lk_status_t lk_kv_alloc_req(lk_kv_allocator_t* allocator, int32_t* req);
+LK_API lk_status_t lk_kv_free_req(lk_kv_allocator_t* allocator, int32_t req);
+LK_API lk_status_t lk_kv_fork(lk_kv_allocator_t* allocator, int32_t src, int32_t prefix_len, int32_t* req);
+
+/**
+ * Appends num_new[i] tokens to reqs[i]. out_slots receives sum(num_new)
+ * slots, copies at most n copy-on-writes (*num_copies of them). *ok is 0 and
+ * nothing changes if the free pages do not cover the whole batch.
+ */
+LK_API lk_status_t lk_kv_extend(
+    lk_kv_allocator_t* allocator, const int32_t* reqs, const int32_t* num_new, int32_t n,
+    int32_t* out_slots, lk_kv_page_copy_t* copies, int32_t* num_copies, int32_t* ok);
+LK_API lk_status_t lk_kv_truncate(lk_kv_allocator_t* allocator, int32_t req, int32_t new_len);
+/**
+ * KV eviction: lk_kv_evict_select picks the positions to keep (keep holds
+ * budget entries) from a request's fp32 [Hkv, max_len] attention mass row,
+ * lk_kv_evict rewrites the request to them. pairs receives *num_pairs
+ * (src_slot, dst_slot) moves, room for n_keep + page_size pairs; apply them
+ * with lk_kv_pack then lk_kv_unpack. See KvPageAllocator::evict.
+ */
+LK_API lk_status_t lk_kv_evict_select(
+    lk_tensor_t* attn_mass, int32_t seq_len, int32_t budget, int32_t num_sink, int32_t num_recent,
+    int32_t* keep, int32_t* n_keep);
+LK_API lk_status_t lk_kv_evict(
+    lk_kv_allocator_t* allocator, int32_t req, const int32_t* keep, int32_t n_keep,
+    int32_t* pairs, int32_t* num_pairs, int32_t* ok);
+/** Compaction plan, see KvPageAllocator::compact. moves must hold num_pages entries. */
+LK_API lk_status_t lk_kv_compact(lk_kv_allocator_t* allocator, lk_kv_page_copy_t* moves, int32_t* num_moves);
+LK_API lk_status_t lk_kv_seq_len(const lk_kv_allocator_t* allocator, int32_t req, int32_t* seq_len);
+LK_API int32_t lk_kv_num_free_pages(const lk_kv_allocator_t* allocator);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // LIGHTLLM_CORE_LIGHTLLM_C_H_
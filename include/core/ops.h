@@ -0,0 +1,493 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "core/common.h"
+#include "core/plan.h"
+#include "core/tensor_view.h"
+
+// Kernels of the torch-free core library. The entry points validate their
+// arguments and dispatch on the device of the views; *_cpu / *_cuda are the
+// backends. The PyTorch extension (_C) and the C ABI are thin adapters on top.
+namespace lightllm {
+namespace core {
+
+void rmsnorm(
+    const TensorView& X, const TensorView& W,
+    const TensorView& Y, const fp32_t eps
+);
+
+// Launches RMSNorm over M contiguous rows of N elements, no validation.
+using RmsNormLaunchFn = void (*)(
+    const void* X, const void* W, void* Y,
+    const int64_t M, const int64_t N, const fp32_t eps, void* stream
+);
+
+RmsNormLaunchFn resolve_rmsnorm(const Device device, const DType dtype, const int64_t N);
+RmsNormLaunchFn resolve_rmsnorm_cpu(const DType dtype);
+RmsNormLaunchFn resolve_rmsnorm_cuda(const DType dtype, const int64_t N);
+
+/**
+ * @brief Validated RMSNorm launch for one row layout (N, dtype, device, eps),
+ * see make_rmsnorm_plan. run() only launches: X and Y must be contiguous
+ * [M, N] rows of the plan's dtype and device, W a contiguous [N] tensor of
+ * the same dtype. One plan serves every M.
+ */
+struct RmsNormPlan {
+    RmsNormLaunchFn launch = nullptr;
+    int64_t N = 0;
+    fp32_t eps = 0.0f;
+
+    void run(const void* X, const void* W, void* Y, const int64_t M, void* stream = nullptr) const {
+        // no zero-row grid on CUDA
+        if (M > 0) launch(X, W, Y, M, N, eps, stream);
+    }
+};
+
+const RmsNormPlan& make_rmsnorm_plan(const TensorMeta& X, const fp32_t eps);
+
+/**
+ * @brief Residual add, RMSNorm and per-token quantization with a single row
+ * reduction: X = bf16(X + R) in place, then Y = quant(X * inv_norm * W) with
+ * the per-token scales of per_token_quant_bf16_fp8 (absmax / 448) or int8
+ * (absmax / 127). Since max|X * inv_norm * W| = inv_norm * max|X * W|, the
+ * square sum and the absmax come from the same pass. The normalized row is
+ * quantized from fp32, not from a bf16-rounded copy (see
+ * test/fusion/add_norm_quant_test.py for the tolerance against that).
+ *
+ * X, R: [M, N] bf16, W: [N] bf16, Y: [M, N] fp8_e4m3 (CUDA / CPU) or int8
+ * (CPU), scales: M fp32, e.g. [M, 1]. All contiguous.
+ */
+void add_norm_quant(
+    const TensorView& X, const TensorView& R, const TensorView& W,
+    const TensorView& Y, const TensorView& scales, const fp32_t eps
+);
+
+void add_norm_quant_cpu(
+    const TensorView& X, const TensorView& R, const TensorView& W,
+    const TensorView& Y, const TensorView& scales, const fp32_t eps
+);
+
+void add_norm_quant_cuda(
+    const TensorView& X, const TensorView& R, const TensorView& W,
+    const TensorView& Y, const TensorView& scales, const fp32_t eps
+);
+
+/**
+ * @brief Scaled GEMM of int8 / fp8_e4m3 operands, the host side of
+ * cutlass_scaled_mm (CUDA tensors go through cutlass_scaled_mm itself):
+ *   c[m, n] = (a_scales[m] * b_scales[n] * sum_k a[m, k] * b[k, n] + bias[n]) * ls[n]
+ * bias and ls are optional, an empty view skips them.
+ */
+void scaled_mm(
+    const TensorView& c, const TensorView& a, const TensorView& b,
+    const TensorView& a_scales, const TensorView& b_scales,
+    const TensorView& bias, const TensorView& ls
+);
+
+void scaled_mm_cpu(
+    const TensorView& c, const TensorView& a, const TensorView& b,
+    const TensorView& a_scales, const TensorView& b_scales,
+    const TensorView& bias, const TensorView& ls
+);
+
+void logprobs_topn_partial(
+    const TensorView& topn_vals, const TensorView& topn_ids,
+    const TensorView& sampled_vals, const TensorView& stats,
+    const TensorView& logits, const TensorView& sampled_ids,
+    const int64_t vocab_start, const bool normalize
+);
+
+void logprobs_topn_partial_cpu(
+    const TensorView& topn_vals, const TensorView& topn_ids,
+    const TensorView& sampled_vals, const TensorView& stats,
+    const TensorView& logits, const TensorView& sampled_ids,
+    const int64_t vocab_start, const bool normalize
+);
+
+void logprobs_topn_partial_cuda(
+    const TensorView& topn_vals, const TensorView& topn_ids,
+    const TensorView& sampled_vals, const TensorView& stats,
+    const TensorView& logits, const TensorView& sampled_ids,
+    const int64_t vocab_start, const bool normalize
+);
+
+void logprobs_topn_merge(
+    const TensorView& out_logprobs, const TensorView& out_ids, const TensorView& out_sampled,
+    const TensorView& stats, const TensorView& topn_vals,
+    const TensorView& topn_ids, const TensorView& sampled_vals
+);
+
+void logprobs_topn_merge_cpu(
+    const TensorView& out_logprobs, const TensorView& out_ids, const TensorView& out_sampled,
+    const TensorView& stats, const TensorView& topn_vals,
+    const TensorView& topn_ids, const TensorView& sampled_vals
+);
+
+void logprobs_topn_merge_cuda(
+    const TensorView& out_logprobs, const TensorView& out_ids, const TensorView& out_sampled,
+    const TensorView& stats, const TensorView& topn_vals,
+    const TensorView& topn_ids, const TensorView& sampled_vals
+);
+
+void varlen_attention(
+    const TensorView& out, const TensorView& q, const TensorView& k, const TensorView& v,
+    const TensorView& cu_seqlens, const int64_t max_seqlen, const fp32_t softmax_scale
+);
+
+void varlen_attention_cpu(
+    const TensorView& out, const TensorView& q, const TensorView& k, const TensorView& v,
+    const TensorView& cu_seqlens, const int64_t max_seqlen, const fp32_t softmax_scale
+);
+
+void varlen_attention_cuda(
+    const TensorView& out, const TensorView& q, const TensorView& k, const TensorView& v,
+    const TensorView& cu_seqlens, const int64_t max_seqlen, const fp32_t softmax_scale
+);
+
+/**
+ * One work unit of mixed_int8kv_attention: the GQA group of kv_head for the
+ * packed query rows [q_begin, q_end) of batch entry batch. A decode request
+ * is one unit per kv head, a prefill chunk is cut in query tiles.
+ */
+struct MixedAttentionWork {
+    int32_t batch;
+    int32_t kv_head;
+    int32_t q_begin;
+    int32_t q_end;
+};
+
+// Query rows (heads x tokens) of one mixed attention work unit.
+constexpr int64_t kMixedAttentionRows = 32;
+
+int64_t plan_mixed_attention(
+    const int32_t* cu_q_lens, const int32_t* seq_lens, const int64_t batch,
+    const int64_t num_heads, const int64_t num_kv_heads, std::vector<MixedAttentionWork>* work
+);
+
+void mixed_int8kv_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& cu_q_lens, const TensorView& work, const TensorView& page_precision, const int64_t page_size
+);
+
+void mixed_int8kv_attention_cpu(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& cu_q_lens, const TensorView& work, const TensorView& page_precision, const int64_t page_size
+);
+
+void mixed_int8kv_attention_cuda(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& cu_q_lens, const TensorView& work, const TensorView& page_precision, const int64_t page_size
+);
+
+// Options of decode_attention / int8kv_decode_attention.
+struct DecodeAttentionOptions {
+    // Quantize q to int8 per head and compute QK with packed int8 dot products
+    // (dp4a / VNNI); the K group scales apply to the 8-element partial sums.
+    bool int8_qk = false;
+    // Required when o is fp8_e4m3: [B] or [B, 1] fp32 per token scales,
+    // absmax over all heads of the token / 448, as per_token_quant_bf16_fp8.
+    TensorView o_scale;
+    // CUDA fp8 output only: int8kv_decode_attention_workspace_bytes bytes,
+    // zero filled before the first use; every launch leaves it zeroed.
+    TensorView workspace;
+    // Optional fp32 [max_reqs, Hkv, max_len] buffer, indexed like
+    // req_to_tokens: the softmax probabilities of every step are added to
+    // attn_mass[req, kv_head, pos], summed over the GQA group (H2O / SnapKV).
+    // The requests of a batch must be distinct.
+    TensorView attn_mass;
+    // Optional int8 [num_pages] tags of KvPageAllocator::downgrade, pages of
+    // page_size slots: a tagged page holds two pages in the format of
+    // kv_downgrade_pages and req_to_tokens may hold the virtual slots of the
+    // second one. An fp8 cache cannot be downgraded; an unquantized one then
+    // needs k_s / v_s. int8_qk reads no tags.
+    TensorView page_precision;
+    int64_t page_size = 0;
+};
+
+int64_t int8kv_decode_attention_workspace_bytes(const int64_t batch, const int64_t heads, const int64_t head_dim);
+
+// FP8 attention output: checks o_scale against o ([rows, ...] fp8_e4m3 with
+// a contiguous row), and the host quantization of fp32 rows into them.
+void check_fp8_output(const char* op, const TensorView& o, const TensorView& o_scale);
+void quantize_rows_fp8_cpu(const fp32_t* x, const TensorView& o, const TensorView& o_scale);
+
+// KV cache of int8 or fp8_e4m3 with group-8 scales, or of the dtype of q
+// with empty k_s / v_s; int8kv_decode_attention requires int8.
+void decode_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const DecodeAttentionOptions& options = {}
+);
+
+void int8kv_decode_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const DecodeAttentionOptions& options = {}
+);
+
+void decode_attention_cpu(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const DecodeAttentionOptions& options
+);
+
+void decode_attention_cuda(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const DecodeAttentionOptions& options
+);
+
+// Flash decoding over the KV caches of decode_attention: stage 1 attends
+// over every seq block on its own, flashdecoding_combine merges the blocks.
+void flashdecoding_stage1(
+    const TensorView& mid_o_emb, const TensorView& mid_o_logexpsum, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const int64_t seq_block_size, const fp32_t att_scale,
+    const TensorView& page_precision = {}, const int64_t page_size = 0
+);
+
+void flashdecoding_stage1_cpu(
+    const TensorView& mid_o_emb, const TensorView& mid_o_logexpsum, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const int64_t seq_block_size, const fp32_t att_scale,
+    const TensorView& page_precision, const int64_t page_size
+);
+
+void flashdecoding_stage1_cuda(
+    const TensorView& mid_o_emb, const TensorView& mid_o_logexpsum, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t max_len_in_batch, const int64_t seq_block_size, const fp32_t att_scale,
+    const TensorView& page_precision, const int64_t page_size
+);
+
+void flashdecoding_combine(
+    const TensorView& o, const TensorView& o_scale, const TensorView& mid_o_emb,
+    const TensorView& mid_o_logexpsum, const TensorView& b_seq_len, const int64_t seq_block_size
+);
+
+void flashdecoding_combine_cpu(
+    const TensorView& o, const TensorView& o_scale, const TensorView& mid_o_emb,
+    const TensorView& mid_o_logexpsum, const TensorView& b_seq_len, const int64_t seq_block_size
+);
+
+void flashdecoding_combine_cuda(
+    const TensorView& o, const TensorView& o_scale, const TensorView& mid_o_emb,
+    const TensorView& mid_o_logexpsum, const TensorView& b_seq_len, const int64_t seq_block_size
+);
+
+/**
+ * Quest-style sparse decode. page_min / page_max ([num_pages, Hkv, D], dtype
+ * of the K scales) hold the channel-wise min / max of the dequantized keys
+ * of every KV page; page p owns the slots [p * page_size, (p + 1) * page_size)
+ * as KvPageAllocator hands them out, so logical page j of a request is the
+ * page of req_to_tokens[req, j * page_size].
+ */
+void kv_page_minmax_update(
+    const TensorView& page_min, const TensorView& page_max, const TensorView& k, const TensorView& k_s,
+    const TensorView& slots, const int64_t page_size
+);
+
+void kv_page_minmax_update_cpu(
+    const TensorView& page_min, const TensorView& page_max, const TensorView& k, const TensorView& k_s,
+    const TensorView& slots, const int64_t page_size
+);
+
+void kv_page_minmax_update_cuda(
+    const TensorView& page_min, const TensorView& page_max, const TensorView& k, const TensorView& k_s,
+    const TensorView& slots, const int64_t page_size
+);
+
+void quest_select_pages(
+    const TensorView& page_idx, const TensorView& scores, const TensorView& q,
+    const TensorView& page_min, const TensorView& page_max,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t page_size
+);
+
+void quest_select_pages_cpu(
+    const TensorView& page_idx, const TensorView& scores, const TensorView& q,
+    const TensorView& page_min, const TensorView& page_max,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t page_size
+);
+
+void quest_select_pages_cuda(
+    const TensorView& page_idx, const TensorView& scores, const TensorView& q,
+    const TensorView& page_min, const TensorView& page_max,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const int64_t page_size
+);
+
+void sparse_int8kv_decode_attention(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& page_idx, const int64_t page_size
+);
+
+void sparse_int8kv_decode_attention_cpu(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& page_idx, const int64_t page_size
+);
+
+void sparse_int8kv_decode_attention_cuda(
+    const TensorView& o, const TensorView& q,
+    const TensorView& k, const TensorView& k_s, const TensorView& v, const TensorView& v_s,
+    const TensorView& req_to_tokens, const TensorView& b_req_idx, const TensorView& b_seq_len,
+    const TensorView& page_idx, const int64_t page_size
+);
+
+// Max number of tensors kv_copy_slots moves in one launch.
+constexpr int32_t kMaxKvCopyTensors = 8;
+
+void kv_copy_slots(
+    const std::vector<TensorView>& caches, const TensorView& pairs, const int32_t slot_dim
+);
+
+void kv_copy_slots_cpu(
+    const std::vector<TensorView>& caches, const TensorView& pairs, const int32_t slot_dim
+);
+
+void kv_copy_slots_cuda(
+    const std::vector<TensorView>& caches, const TensorView& pairs, const int32_t slot_dim
+);
+
+// Bytes of one slot in the packed layout of kv_gather_slots / kv_scatter_slots.
+int64_t kv_slot_bytes(const std::vector<TensorView>& caches, const int32_t slot_dim);
+
+// Throws for slots in host memory outside [0, num_slots), see kv_copy.cpp.
+void check_kv_slots(const char* op, const TensorView& slots, const int64_t num_slots);
+
+// Argument checks shared by kv_gather_slots / kv_scatter_slots and the transfer ops.
+void check_kv_pack_args(
+    const char* op, const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+);
+
+void kv_gather_slots(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+);
+
+void kv_gather_slots_cpu(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+);
+
+void kv_gather_slots_cuda(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+);
+
+void kv_scatter_slots(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+);
+
+void kv_scatter_slots_cpu(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+);
+
+void kv_scatter_slots_cuda(
+    const std::vector<TensorView>& caches, const TensorView& slots,
+    const TensorView& packed, const int32_t slot_dim
+);
+
+/**
+ * KV precision downgrade under memory pressure, in place: every (p, q) row of
+ * pairs ([n, 2] int32 pages, as KvPageAllocator::downgrade returns them)
+ * packs the tokens of pages p and q into page p, at half the bits:
+ *   - int8 cache, group-8 scales -> int4 with group-16 scales: token t of
+ *     page p (half 0) and of page q (half 1) share row t of p, half h in
+ *     bytes [h * D / 2, (h + 1) * D / 2), two values per byte (low nibble
+ *     first), scales [h * D / 16, (h + 1) * D / 16) of the scale row;
+ *   - bf16 / fp16 cache -> int8 with group-16 scales: half h in bytes
+ *     [h * D, (h + 1) * D) of the 2 * D byte row, scales as above. The cache
+ *     then needs a scale tensor of its dtype, only downgraded pages use it.
+ * Values are round-to-nearest symmetric (absmax / 7, absmax / 127). caches
+ * are [slots, Hkv, D] contiguous with D % 16 == 0, scales[i] the
+ * [slots, Hkv, D / 8] contiguous scales of caches[i], e.g. the k and v of
+ * every layer. Pages must be distinct, none of them downgraded already.
+ */
+void kv_downgrade_pages(
+    const std::vector<TensorView>& caches, const std::vector<TensorView>& scales,
+    const TensorView& pairs, const int64_t page_size
+);
+
+void kv_downgrade_pages_cpu(
+    const std::vector<TensorView>& caches, const std::vector<TensorView>& scales,
+    const TensorView& pairs, const int64_t page_size
+);
+
+void kv_downgrade_pages_cuda(
+    const std::vector<TensorView>& caches, const std::vector<TensorView>& scales,
+    const TensorView& pairs, const int64_t page_size
+);
+
+// Tokens an eviction always keeps, see kv_evict_select.
+struct KvEvictPolicy {
+    int32_t num_sink = 4;      // first tokens (attention sinks)
+    int32_t num_recent = 64;   // last tokens (local window)
+};
+
+/**
+ * H2O-style selection of the tokens one request keeps, on the host.
+ * attn_mass is its fp32 [Hkv, max_len] row of DecodeAttentionOptions::attn_mass
+ * in host memory. Keeps the sink and recent tokens of policy and fills the
+ * rest of budget with the other tokens of the highest mass summed over the
+ * kv heads. Writes the kept positions in ascending order to keep, compacts
+ * the mass row the same way (kept columns moved to the front, the rest of
+ * [0, seq_len) zeroed) and returns their count, min(seq_len, budget).
+ * Feed keep to KvPageAllocator::evict.
+ */
+int32_t kv_evict_select(
+    const TensorView& attn_mass, const int32_t seq_len, const int32_t budget,
+    const KvEvictPolicy& policy, int32_t* keep
+);
+
+void page_hashes(
+    const TensorView& tokens, const TensorView& lens, const int64_t page_size,
+    const uint64_t seed, const TensorView& out
+);
+
+/**
+ * Hybrid MoE with cold experts offloaded to host memory, on the host.
+ * hybrid_moe_partition splits the routing of grouped_topk by a residency map
+ * (device slot of every expert, -1 for CPU experts): the device experts get
+ * the slots and weights of their (token, k) pairs, -1 / 0 elsewhere, and the
+ * CPU rows come grouped by expert for moe_cpu_experts, which adds their
+ * weighted FFN outputs into a fp32 buffer the caller merges with the device
+ * result. Returns the number of CPU rows.
+ */
+int64_t hybrid_moe_partition(
+    const TensorView& topk_ids, const TensorView& topk_weights, const TensorView& residency,
+    const TensorView& device_ids, const TensorView& device_weights,
+    const TensorView& cpu_offsets, const TensorView& cpu_tokens, const TensorView& cpu_weights
+);
+
+void moe_cpu_experts(
+    const TensorView& out, const TensorView& x, const TensorView& cpu_offsets,
+    const TensorView& cpu_tokens, const TensorView& cpu_weights,
+    const std::vector<TensorView>& w13, const std::vector<TensorView>& w13_scales,
+    const std::vector<TensorView>& w2, const std::vector<TensorView>& w2_scales
+);
+
+} // namespace core
+} // namespace lightllm
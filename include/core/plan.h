@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "core/tensor_view.h"
+
+namespace lightllm {
+namespace core {
+
+/**
+ * @brief Everything of a tensor a launch depends on except its data pointer
+ * and stream: the key of the plan caches.
+ */
+struct TensorMeta {
+    DType dtype = DType::Float32;
+    Device device = Device::CPU;
+    int32_t device_index = 0;
+    int32_t ndim = 0;
+    int64_t shape[TensorView::kMaxDims] = {};
+    int64_t strides[TensorView::kMaxDims] = {};
+
+    TensorMeta() = default;
+
+    // strides may be empty for a contiguous tensor.
+    TensorMeta(const std::vector<int64_t>& sizes, DType dtype, const std::vector<int64_t>& given_strides,
+               Device device = Device::CPU, int32_t device_index = 0)
+        : dtype(dtype), device(device), device_index(device_index), ndim(static_cast<int32_t>(sizes.size())) {
+        LK_CHECK(ndim <= TensorView::kMaxDims, "at most ", TensorView::kMaxDims, " dims are supported");
+        LK_CHECK(given_strides.empty() || given_strides.size() == sizes.size(),
+                 "shape and strides must have the same length");
+        int64_t stride = 1;
+        for (int32_t d = ndim - 1; d >= 0; d--) {
+            shape[d] = sizes[d];
+            strides[d] = given_strides.empty() ? stride : given_strides[d];
+            stride *= sizes[d];
+        }
+    }
+
+    static TensorMeta of(const TensorView& t) {
+        TensorMeta m;
+        m.dtype = t.dtype;
+        m.device = t.device;
+        m.device_index = t.device_index;
+        m.ndim = t.ndim;
+        for (int32_t d = 0; d < t.ndim; d++) {
+            m.shape[d] = t.shape[d];
+            m.strides[d] = t.strides[d];
+        }
+        return m;
+    }
+
+    bool is_contiguous() const {
+        int64_t expected = 1;
+        for (int32_t d = ndim - 1; d >= 0; d--) {
+            if (shape[d] != 1 && strides[d] != expected) return false;
+            expected *= shape[d];
+        }
+        return true;
+    }
+
+    bool operator==(const TensorMeta& o) const {
+        return dtype == o.dtype && device == o.device && device_index == o.device_index && ndim == o.ndim
+            && std::memcmp(shape, o.shape, sizeof(int64_t) * ndim) == 0
+            && std::memcmp(strides, o.strides, sizeof(int64_t) * ndim) == 0;
+    }
+
+    size_t hash() const {
+        size_t h = static_cast<size_t>(dtype) * 31 + static_cast<size_t>(device);
+        h = h * 31 + static_cast<size_t>(device_index);
+        for (int32_t d = 0; d < ndim; d++) {
+            h = h * 1000003 ^ static_cast<size_t>(shape[d]);
+            h = h * 1000003 ^ static_cast<size_t>(strides[d]);
+        }
+        return h;
+    }
+};
+
+/**
+ * @brief Thread safe cache of launch plans. Plans are never evicted, so the
+ * returned references stay valid for the lifetime of the process and callers
+ * may keep them to skip the lookup. Keys must come from a bounded set (row
+ * layouts, not batch sizes), or the cache grows for as long as it serves.
+ */
+template <typename Key, typename Plan, typename Hash = std::hash<Key>>
+class PlanCache {
+ public:
+    // make() is only called on a miss; if it throws nothing is cached.
+    template <typename Make>
+    const Plan& get_or_create(const Key& key, const Make& make) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = plans_.find(key);
+        if (it == plans_.end()) it = plans_.emplace(key, make()).first;
+        return it->second;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return plans_.size();
+    }
+
+ private:
+    std::mutex mutex_;
+    std::unordered_map<Key, Plan, Hash> plans_;
+};
+
+}  // namespace core
+}  // namespace lightllm
@@ -0,0 +1,160 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+
+#include "core/common.h"
+#include "core/lightllm_c.h"
+
+namespace lightllm {
+namespace core {
+
+// Values are the ones of the C ABI so a view converts without a lookup table.
+enum class DType : int32_t {
+    Float32 = LK_DTYPE_FLOAT32,
+    Float16 = LK_DTYPE_FLOAT16,
+    BFloat16 = LK_DTYPE_BFLOAT16,
+    Fp8E4M3 = LK_DTYPE_FP8_E4M3,
+    Int8 = LK_DTYPE_INT8,
+    UInt8 = LK_DTYPE_UINT8,
+    Int32 = LK_DTYPE_INT32,
+    Int64 = LK_DTYPE_INT64,
+};
+
+enum class Device : int32_t {
+    CPU = LK_DEVICE_CPU,
+    CUDA = LK_DEVICE_CUDA,
+};
+
+inline int64_t dtype_size(const DType dtype) {
+    switch (dtype) {
+        case DType::Float32: case DType::Int32: return 4;
+        case DType::Float16: case DType::BFloat16: return 2;
+        case DType::Fp8E4M3: case DType::Int8: case DType::UInt8: return 1;
+        case DType::Int64: return 8;
+    }
+    return 0;
+}
+
+inline const char* dtype_name(const DType dtype) {
+    switch (dtype) {
+        case DType::Float32: return "float32";
+        case DType::Float16: return "float16";
+        case DType::BFloat16: return "bfloat16";
+        case DType::Fp8E4M3: return "float8_e4m3fn";
+        case DType::Int8: return "int8";
+        case DType::UInt8: return "uint8";
+        case DType::Int32: return "int32";
+        case DType::Int64: return "int64";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Non-owning view of a tensor: pointer, dtype, shape, strides (in
+ * elements), device and the CUDA stream work on it is issued to.
+ *
+ * This is what every core kernel takes instead of torch::Tensor. It has the
+ * same fields as lk_tensor_t from the C ABI.
+ */
+struct TensorView {
+    static constexpr int32_t kMaxDims = LK_MAX_DIMS;
+
+    void* data = nullptr;
+    DType dtype = DType::Float32;
+    int32_t ndim = 0;
+    int64_t shape[kMaxDims] = {};
+    int64_t strides[kMaxDims] = {};
+    Device device = Device::CPU;
+    int32_t device_index = 0;
+    void* stream = nullptr;
+
+    TensorView() = default;
+
+    /**
+     * @brief View of a contiguous (row major) buffer.
+     */
+    TensorView(void* data, DType dtype, std::initializer_list<int64_t> sizes,
+               Device device = Device::CPU, int32_t device_index = 0, void* stream = nullptr)
+        : data(data), dtype(dtype), ndim(static_cast<int32_t>(sizes.size())),
+          device(device), device_index(device_index), stream(stream) {
+        LK_CHECK(ndim <= kMaxDims, "at most ", kMaxDims, " dims are supported");
+        int32_t d = 0;
+        for (int64_t s : sizes) shape[d++] = s;
+        int64_t stride = 1;
+        for (d = ndim - 1; d >= 0; d--) {
+            strides[d] = stride;
+            stride *= shape[d];
+        }
+    }
+
+    static TensorView from_c(const lk_tensor_t& t) {
+        LK_CHECK(t.ndim >= 0 && t.ndim <= kMaxDims, "invalid ndim ", t.ndim);
+        TensorView v;
+        v.data = t.data;
+        v.dtype = static_cast<DType>(t.dtype);
+        v.ndim = t.ndim;
+        for (int32_t d = 0; d < t.ndim; d++) {
+            v.shape[d] = t.shape[d];
+            v.strides[d] = t.strides[d];
+        }
+        v.device = static_cast<Device>(t.device_type);
+        v.device_index = t.device_index;
+        v.stream = t.stream;
+        return v;
+    }
+
+    lk_tensor_t to_c() const {
+        lk_tensor_t t = {};
+        t.data = data;
+        t.dtype = static_cast<lk_dtype_t>(dtype);
+        t.ndim = ndim;
+        for (int32_t d = 0; d < ndim; d++) {
+            t.shape[d] = shape[d];
+            t.strides[d] = strides[d];
+        }
+        t.device_type = static_cast<lk_device_type_t>(device);
+        t.device_index = device_index;
+        t.stream = stream;
+        return t;
+    }
+
+    int32_t dim() const { return ndim; }
+
+    int64_t size(int32_t d) const {
+        d = d < 0 ? d + ndim : d;
+        LK_CHECK(d >= 0 && d < ndim, "dim ", d, " out of range for a ", ndim, "D tensor");
+        return shape[d];
+    }
+
+    int64_t stride(int32_t d) const {
+        d = d < 0 ? d + ndim : d;
+        LK_CHECK(d >= 0 && d < ndim, "dim ", d, " out of range for a ", ndim, "D tensor");
+        return strides[d];
+    }
+
+    int64_t numel() const {
+        int64_t n = 1;
+        for (int32_t d = 0; d < ndim; d++) n *= shape[d];
+        return n;
+    }
+
+    int64_t element_size() const { return dtype_size(dtype); }
+
+    bool is_contiguous() const {
+        int64_t expected = 1;
+        for (int32_t d = ndim - 1; d >= 0; d--) {
+            if (shape[d] != 1 && strides[d] != expected) return false;
+            expected *= shape[d];
+        }
+        return true;
+    }
+
+    bool is_cpu() const { return device == Device::CPU; }
+    bool is_cuda() const { return device == Device::CUDA; }
+
+    template <typename T>
+    T* data_ptr() const { return static_cast<T*>(data); }
+};
+
+}  // namespace core
+}  // namespace lightllm
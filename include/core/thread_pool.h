@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lightllm {
+namespace core {
+
+/**
+ * @brief Fixed size pool of worker threads used by the CPU kernels of the
+ * core library, so they do not depend on at::parallel_for / OpenMP.
+ *
+ * run() hands out task ids [0, num_tasks) to the workers and the calling
+ * thread, and returns once all of them are done. Calls from several threads
+ * are serialized; a run() issued from inside a task executes inline.
+ */
+class ThreadPool {
+ public:
+    // num_threads counts the calling thread, so num_threads - 1 workers are started.
+    explicit ThreadPool(int32_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int32_t num_threads() const { return static_cast<int32_t>(workers_.size()) + 1; }
+
+    // Rethrows the first exception thrown by a task.
+    void run(int64_t num_tasks, const std::function<void(int64_t)>& fn);
+
+    // Whether the calling thread is executing a task of any pool.
+    static bool in_parallel_region();
+
+ private:
+    void worker_loop();
+    void work_on(const std::function<void(int64_t)>& fn, uint64_t generation);
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(int64_t)>* fn_ = nullptr;
+    int64_t num_tasks_ = 0;
+    int64_t next_task_ = 0;
+    int64_t finished_tasks_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+};
+
+/**
+ * Pool shared by all core CPU kernels. Its size defaults to the
+ * LIGHTLLM_NUM_THREADS environment variable, or the number of hardware threads.
+ * set_num_threads replaces the pool and must not race with running kernels.
+ */
+ThreadPool& global_thread_pool();
+void set_num_threads(int32_t num_threads);
+int32_t get_num_threads();
+
+/**
+ * @brief Same contract as at::parallel_for: f(chunk_begin, chunk_end) is
+ * called on disjoint chunks covering [begin, end), each of at least grain_size
+ * elements (except the last one).
+ */
+template <typename F>
+void parallel_for(const int64_t begin, const int64_t end, const int64_t grain_size, const F& f) {
+    if (begin >= end) return;
+    const int64_t range = end - begin;
+    const int64_t grain = std::max<int64_t>(grain_size, 1);
+    if (range <= grain || ThreadPool::in_parallel_region()) {
+        f(begin, end);
+        return;
+    }
+    ThreadPool& pool = global_thread_pool();
+    const int64_t num_chunks = std::min<int64_t>(pool.num_threads(), (range + grain - 1) / grain);
+    if (num_chunks <= 1) {
+        f(begin, end);
+        return;
+    }
+    const int64_t chunk = (range + num_chunks - 1) / num_chunks;
+    pool.run(num_chunks, [&](int64_t task) {
+        const int64_t b = begin + task * chunk;
+        const int64_t e = std::min(end, b + chunk);
+        if (b < e) f(b, e);
+    });
+}
+
+}  // namespace core
+}  // namespace lightllm
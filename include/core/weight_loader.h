@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "core/common.h"
+#include "core/tensor_view.h"
+
+namespace lightllm {
+namespace core {
+
+struct SafetensorsEntry {
+    std::string name;
+    std::string dtype;           // safetensors dtype, e.g. "BF16"
+    std::vector<int64_t> shape;
+    int64_t offset = 0;          // from the start of the file
+    int64_t bytes = 0;
+};
+
+/**
+ * @brief Read-only mmap of a safetensors shard: an 8 byte little endian
+ * header length, a JSON header of name -> {dtype, shape, data_offsets} (plus
+ * an optional "__metadata__" string map) and the tensor data.
+ *
+ * Nothing is read up front besides the header, view() points into the
+ * mapping and its pages are faulted in by whoever touches them first.
+ */
+class SafetensorsFile {
+ public:
+    explicit SafetensorsFile(const std::string& path);
+    ~SafetensorsFile();
+
+    SafetensorsFile(const SafetensorsFile&) = delete;
+    SafetensorsFile& operator=(const SafetensorsFile&) = delete;
+
+    // In file order.
+    const std::vector<SafetensorsEntry>& entries() const { return entries_; }
+    // nullptr if the shard has no such tensor.
+    const SafetensorsEntry* find(const std::string& name) const;
+    const std::map<std::string, std::string>& metadata() const { return metadata_; }
+
+    // Host view of a tensor, valid while the file is open. Not supported for
+    // the dtypes without a DType (F64, I16, BOOL, F8_E5M2).
+    TensorView view(const SafetensorsEntry& entry) const;
+
+    const std::string& path() const { return path_; }
+    int64_t size() const { return size_; }
+
+ private:
+    std::string path_;
+    int fd_ = -1;
+    char* base_ = nullptr;
+    int64_t size_ = 0;
+    std::vector<SafetensorsEntry> entries_;
+    std::map<std::string, size_t> index_;
+    std::map<std::string, std::string> metadata_;
+};
+
+/**
+ * @brief Per output channel quantization of a weight into the b operand of
+ * scaled_mm / cutlass_scaled_mm.
+ *
+ * @param w       [N, K] bf16 / fp16 / fp32 weight of a linear layer (y = x w^T),
+ *                rows contiguous, e.g. a SafetensorsFile view.
+ * @param q       [K, N] int8 / fp8 output, column major (stride(0) == 1,
+ *                stride(1) == K), i.e. the rows of w quantized in place.
+ * @param scales  [N] fp32 output, w[n, k] ~= q[k, n] * scales[n].
+ */
+void quantize_weight_per_channel(const TensorView& w, const TensorView& q, const TensorView& scales);
+
+struct WeightQuantJob {
+    TensorView w;
+    TensorView q;
+    TensorView scales;
+};
+
+struct WeightLoadOptions {
+    // Threads faulting the source pages in ahead of the quantization.
+    int32_t io_threads = 4;
+    // Source bytes the reads may run ahead of the quantization.
+    int64_t readahead_bytes = int64_t(1) << 30;
+    // Unit of work of an IO thread.
+    int64_t chunk_bytes = int64_t(8) << 20;
+};
+
+struct WeightLoadStats {
+    int64_t bytes_read = 0;        // source bytes
+    int64_t bytes_written = 0;     // quantized weights and scales
+    double seconds = 0.0;
+    double read_wait_seconds = 0.0;  // time the quantization waited for reads
+};
+
+/**
+ * @brief Quantizes a list of weights (see quantize_weight_per_channel) with
+ * reads, quantization and the caller's consumer overlapped.
+ *
+ * IO threads walk the sources in job order and fault their pages in (one
+ * read per page, after MADV_WILLNEED) up to readahead_bytes ahead; the
+ * calling thread quantizes every job across the CPU kernel threads once its
+ * source is in memory, then calls on_done(i), e.g. to start an asynchronous
+ * upload of job i or to write it out, while the reads of the next jobs go on.
+ */
+WeightLoadStats quantize_weights(
+    const std::vector<WeightQuantJob>& jobs, const WeightLoadOptions& options = {},
+    const std::function<void(size_t)>& on_done = nullptr
+);
+
+} // namespace core
+} // namespace lightllm
@@ -5,6 +5,8 @@
 #include <tuple>
 
 #include "utils.h"
+#include "torch_utils.h"
+#include "core/ops.h"
 
 
 namespace lightllm {
@@ -26,6 +28,20 @@ Tensor rmsnorm_align16_bf16(
     const fp32_t eps
 );
 
+int64_t make_rmsnorm_plan(
+    const std::vector<int64_t>& shape,
+    const int64_t dtype,
+    const std::vector<int64_t>& strides,
+    const int64_t device_index,
+    const fp32_t eps
+);
+
+void rmsnorm_plan_run(
+    const int64_t plan,
+    const int64_t X, const int64_t W,
+    const int64_t Y, const int64_t M, const int64_t stream
+);
+
 void per_token_quant_bf16_fp8(
     Tensor& output,
     const Tensor& input,
@@ -71,6 +87,42 @@ Tensor grouped_topk(
         Tensor group_scores
 );
 
+std::tuple<Tensor, Tensor, Tensor, Tensor, Tensor> hybrid_moe_partition(
+    const Tensor& topk_ids, const Tensor& topk_weights, const Tensor& residency
+);
+
+void moe_cpu_experts(
+    Tensor& out, const Tensor& x, const Tensor& cpu_offsets, const Tensor& cpu_tokens, const Tensor& cpu_weights,
+    const std::vector<Tensor>& w13, const std::vector<Tensor>& w13_scales,
+    const std::vector<Tensor>& w2, const std::vector<Tensor>& w2_scales
+);
+
+int64_t init_expert_cache(
+    const Tensor& host_weights, Tensor& pool, int64_t eviction, int64_t prefetch_per_layer,
+    bool fetch_misses, double decay
+);
+void expert_cache_dispose(int64_t _cache);
+Tensor expert_cache_access(int64_t _cache, int64_t layer, const Tensor& topk_ids, const Tensor& topk_weights);
+int64_t expert_cache_prefetch(int64_t _cache, int64_t layer, const std::vector<int64_t>& experts);
+int64_t expert_cache_slot(int64_t _cache, int64_t layer, int64_t expert);
+void expert_cache_synchronize(int64_t _cache);
+std::tuple<int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, double> expert_cache_stats(
+    int64_t _cache
+);
+void expert_cache_reset_stats(int64_t _cache);
+
+int64_t init_safetensors(const std::string& path);
+void safetensors_dispose(int64_t _file);
+std::vector<std::tuple<std::string, std::string, std::vector<int64_t>>> safetensors_entries(int64_t _file);
+std::map<std::string, std::string> safetensors_metadata(int64_t _file);
+Tensor safetensors_tensor(int64_t _file, const std::string& name);
+void quantize_weight_per_channel(const Tensor& w, Tensor& q, Tensor& scales);
+std::tuple<int64_t, int64_t, double, double> quantize_weights(
+    const std::vector<int64_t>& files, const std::vector<std::string>& names,
+    const std::vector<Tensor>& q, const std::vector<Tensor>& scales,
+    int64_t io_threads, int64_t readahead_bytes, const pybind11::object& on_done
+);
+
 void all_gather(
     int64_t _fa,
     Tensor& inp,
@@ -94,6 +146,23 @@ void group_int8kv_flashdecoding_attention(
     Tensor b_seq_len, 
     int64_t max_len_in_batch);
 
+void flashdecoding_stage1(
+    const int64_t seq_block_size,
+    Tensor mid_o_emb,
+    Tensor mid_o_logexpsum,
+    fp32_t att_scale,
+    Tensor q,
+    Tensor k,
+    c10::optional<Tensor> const& k_s,
+    Tensor v,
+    c10::optional<Tensor> const& v_s,
+    Tensor req_to_tokens,
+    Tensor b_req_idx,
+    Tensor b_seq_len,
+    int64_t max_len_in_batch,
+    c10::optional<Tensor> const& page_precision,
+    int64_t page_size);
+
 void group_int8kv_decode_attention(
     Tensor o, 
     Tensor q, 
@@ -104,7 +173,98 @@ void group_int8kv_decode_attention(
     Tensor req_to_tokens, 
     Tensor b_req_idx, 
     Tensor b_seq_len, 
-    int64_t max_len_in_batch);
+    int64_t max_len_in_batch,
+    bool int8_qk,
+    c10::optional<Tensor> const& o_scale,
+    c10::optional<Tensor> const& workspace,
+    c10::optional<Tensor> const& attn_mass);
+
+void decode_attention(
+    Tensor o,
+    Tensor q,
+    Tensor k,
+    c10::optional<Tensor> const& k_s,
+    Tensor v,
+    c10::optional<Tensor> const& v_s,
+    Tensor req_to_tokens,
+    Tensor b_req_idx,
+    Tensor b_seq_len,
+    int64_t max_len_in_batch,
+    c10::optional<Tensor> const& o_scale,
+    c10::optional<Tensor> const& workspace,
+    c10::optional<Tensor> const& attn_mass,
+    c10::optional<Tensor> const& page_precision,
+    int64_t page_size);
+
+int64_t int8kv_decode_attention_workspace_bytes(int64_t batch, int64_t heads, int64_t head_dim);
+
+void flashdecoding_combine(
+    Tensor o,
+    c10::optional<Tensor> const& o_scale,
+    Tensor mid_o_emb,
+    Tensor mid_o_logexpsum,
+    Tensor b_seq_len,
+    int64_t seq_block_size);
+
+Tensor varlen_attention(
+    const Tensor& q, const Tensor& k, const Tensor& v, const Tensor& cu_seqlens,
+    const int64_t max_seqlen, const double softmax_scale
+);
+
+Tensor plan_mixed_attention(
+    const Tensor& cu_q_lens, const Tensor& b_seq_len, int64_t num_heads, int64_t num_kv_heads
+);
+
+void mixed_int8kv_attention(
+    Tensor o,
+    Tensor q,
+    Tensor k,
+    Tensor k_s,
+    Tensor v,
+    Tensor v_s,
+    Tensor req_to_tokens,
+    Tensor b_req_idx,
+    Tensor b_seq_len,
+    Tensor cu_q_lens,
+    Tensor work,
+    c10::optional<Tensor> const& page_precision,
+    int64_t page_size);
+
+void kv_page_minmax_update(
+    Tensor page_min, Tensor page_max, const Tensor& k, const Tensor& k_s, const Tensor& slots, int64_t page_size
+);
+
+Tensor quest_select_pages(
+    const Tensor& q, const Tensor& page_min, const Tensor& page_max,
+    const Tensor& req_to_tokens, const Tensor& b_req_idx, const Tensor& b_seq_len,
+    int64_t page_size, int64_t top_pages, int64_t max_len_in_batch
+);
+
+void sparse_int8kv_decode_attention(
+    Tensor o,
+    Tensor q,
+    Tensor k,
+    Tensor k_s,
+    Tensor v,
+    Tensor v_s,
+    Tensor req_to_tokens,
+    Tensor b_req_idx,
+    Tensor b_seq_len,
+    Tensor page_idx,
+    int64_t page_size);
+
+void logprobs_topn_partial(
+    Tensor& topn_vals, Tensor& topn_ids,
+    Tensor& sampled_vals, Tensor& stats,
+    const Tensor& logits, const Tensor& sampled_ids,
+    const int64_t vocab_start, const bool normalize
+);
+
+void logprobs_topn_merge(
+    Tensor& out_logprobs, Tensor& out_ids, Tensor& out_sampled,
+    const Tensor& stats, const Tensor& topn_vals,
+    const Tensor& topn_ids, const Tensor& sampled_vals
+);
 
 int64_t init_custom_gather_ar(
     const std::vector<int64_t>& fake_ipc_ptrs,
@@ -117,6 +277,49 @@ void allgather_dispose(
     int64_t _fa
 );
 
+int64_t init_shm_gather(
+    const std::vector<int64_t>& fake_shm_ptrs,
+    int64_t rank
+);
+
+void shm_gather_dispose(
+    int64_t _fa
+);
+
+int64_t shm_meta_size();
+
+void shm_gather_register_buffer(
+    int64_t _fa,
+    const std::vector<int64_t>& fake_shm_ptrs
+);
+
+void shm_all_gather(
+    int64_t _fa,
+    Tensor& inp,
+    Tensor& out,
+    int64_t _reg_buffer,
+    int64_t reg_buffer_sz_bytes
+);
+
+void vocab_parallel_embedding(
+    int64_t _fa,
+    Tensor& out,
+    const Tensor& ids,
+    const Tensor& weight,
+    int64_t _reg_buffer,
+    int64_t reg_buffer_sz_bytes,
+    int64_t vocab_per_rank
+);
+
+void vocab_parallel_embedding_cpu(
+    int64_t _fa,
+    Tensor& out,
+    const Tensor& ids,
+    const Tensor& weight,
+    int64_t _reg_buffer,
+    int64_t vocab_per_rank
+);
+
 void allgather_register_buffer(
     int64_t _fa,
     const std::vector<int64_t>& fake_ipc_ptrs
@@ -133,5 +336,91 @@ void allgather_register_graph_buffers(
     const std::vector<std::vector<int64_t>>& offsets
 );
 
+int64_t init_kv_allocator(
+    int64_t num_pages, int64_t page_size,
+    int64_t max_reqs, int64_t max_seq_len,
+    Tensor& req_to_tokens,
+    const c10::optional<Tensor>& page_precision
+);
+
+void kv_allocator_dispose(int64_t _alloc);
+int64_t kv_alloc_req(int64_t _alloc);
+void kv_free_reqs(int64_t _alloc, const Tensor& reqs);
+int64_t kv_fork(int64_t _alloc, int64_t src, int64_t prefix_len);
+
+std::tuple<bool, Tensor, Tensor> kv_extend(
+    int64_t _alloc, const Tensor& reqs, const Tensor& num_new
+);
+
+Tensor kv_compact(int64_t _alloc);
+void kv_truncate(int64_t _alloc, int64_t req, int64_t new_len);
+std::tuple<bool, Tensor> kv_evict(int64_t _alloc, int64_t req, const Tensor& keep);
+Tensor kv_evict_select(
+    Tensor& attn_mass, int64_t seq_len, int64_t budget, int64_t num_sink, int64_t num_recent
+);
+Tensor kv_downgrade(int64_t _alloc, int64_t num_pages, int64_t num_sink_pages, int64_t num_recent_pages);
+int64_t kv_seq_len(int64_t _alloc, int64_t req);
+int64_t kv_num_free_pages(int64_t _alloc);
+int64_t kv_num_free_reqs(int64_t _alloc);
+
+void kv_copy_slots(
+    const std::vector<Tensor>& caches, const Tensor& pairs, const int64_t slot_dim
+);
+void kv_downgrade_pages(
+    const std::vector<Tensor>& caches, const std::vector<Tensor>& scales, const Tensor& pairs, const int64_t page_size
+);
+
+int64_t kv_transfer_bytes(const std::vector<Tensor>& caches, const int64_t slot_dim, const int64_t num_tokens);
+void kv_pack(
+    const std::vector<Tensor>& caches, const Tensor& slots, const int64_t slot_dim,
+    const int64_t tag, Tensor& buffer
+);
+std::tuple<int64_t, int64_t> kv_transfer_info(const Tensor& buffer);
+void kv_unpack(
+    const std::vector<Tensor>& caches, const Tensor& slots, const int64_t slot_dim,
+    const Tensor& buffer
+);
+
+Tensor page_hashes(
+    const Tensor& tokens, const Tensor& lens, const int64_t page_size,
+    const int64_t seed, const int64_t bits
+);
+
+int64_t init_kv_offload(Tensor& host_arena, const std::string& disk_path, int64_t disk_bytes);
+void kv_offload_dispose(int64_t _engine);
+
+bool kv_offload(
+    int64_t _engine, int64_t key, const std::vector<Tensor>& caches,
+    const Tensor& slots, int64_t slot_dim
+);
+
+void kv_offload_prefetch(int64_t _engine, int64_t key, int64_t priority);
+std::vector<int64_t> kv_offload_issue_prefetches(int64_t _engine, int64_t budget_bytes);
+bool kv_offload_ready(int64_t _engine, int64_t key);
+void kv_offload_wait(int64_t _engine, int64_t key);
+
+void kv_offload_restore(
+    int64_t _engine, int64_t key, const std::vector<Tensor>& caches,
+    const Tensor& slots, int64_t slot_dim
+);
+
+void kv_offload_drop(int64_t _engine, int64_t key);
+int64_t kv_offload_tier(int64_t _engine, int64_t key);
+std::tuple<int64_t, int64_t, double> kv_offload_stats(int64_t _engine);
+
+void set_cpu_isa(const std::string& isa);
+std::string get_cpu_isa(const bool detected);
+
+int64_t init_cpu_stream();
+void cpu_stream_dispose(int64_t _stream);
+void cpu_stream_submit(int64_t _stream, pybind11::function fn);
+int64_t cpu_stream_record(int64_t _stream);
+void cpu_stream_wait_event(int64_t _stream, int64_t _event);
+bool cpu_stream_query(int64_t _stream);
+void cpu_stream_synchronize(int64_t _stream);
+bool cpu_event_query(int64_t _event);
+void cpu_event_synchronize(int64_t _event);
+void cpu_event_dispose(int64_t _event);
+
 } // namespace ops
 } // namespace lightllm
\ No newline at end of file
@@ -1,4 +1,6 @@
 #pragma once
+#include <climits>
+
 #include "utils.h"
 
 namespace lightllm {
@@ -114,76 +116,218 @@ fp32_t sync_block_reduce_max_f32(const fp32_t input) {
 }
 
 /**
- * @brief Performs a block-wide reduction to compute both sum and max
- * of floating-point values across all threads in a block.
+ * @brief Partial statistics of Welford's online mean / variance: the mean
+ * and the sum of squared deviations (m2) of count values. The variance of
+ * the reduced statistics is m2 / count.
+ */
+struct WelfordF32 {
+    fp32_t mean;
+    fp32_t m2;
+    fp32_t count;
+};
+
+/**
+ * @brief Running sum plus the max and the index of the max, e.g. the
+ * normalizer and the greedy token of a row of logits. Equal maxima keep the
+ * lowest index, so the result does not depend on the reduction order.
+ */
+struct SumArgmaxF32 {
+    fp32_t sum;
+    fp32_t max;
+    int32_t index;
+};
+
+// Adds one value to Welford statistics.
+__device__ inline
+WelfordF32 welford_push(WelfordF32 s, const fp32_t x) {
+    s.count += 1.0f;
+    const fp32_t delta = x - s.mean;
+    s.mean += delta / s.count;
+    s.m2 += delta * (x - s.mean);
+    return s;
+}
+
+/**
+ * @brief Combine functors of the multi-value reductions. identity() is the
+ * value of an empty partial result, operator() merges two partial results.
+ */
+struct SumMaxOp {
+    __device__ static fp32x2_t identity() { return make_float2(0.0f, -INFINITY); }
+    __device__ fp32x2_t operator()(const fp32x2_t a, const fp32x2_t b) const {
+        return make_float2(a.x + b.x, fmaxf(a.y, b.y));
+    }
+};
+
+struct WelfordOp {
+    __device__ static WelfordF32 identity() { return WelfordF32{0.0f, 0.0f, 0.0f}; }
+    // Chan et al. pairwise merge.
+    __device__ WelfordF32 operator()(const WelfordF32 a, const WelfordF32 b) const {
+        const fp32_t count = a.count + b.count;
+        if (count == 0.0f) return a;
+        const fp32_t delta = b.mean - a.mean;
+        const fp32_t rb = b.count / count;
+        return WelfordF32{a.mean + delta * rb, a.m2 + b.m2 + delta * delta * a.count * rb, count};
+    }
+};
+
+struct SumArgmaxOp {
+    __device__ static SumArgmaxF32 identity() { return SumArgmaxF32{0.0f, -INFINITY, INT_MAX}; }
+    __device__ SumArgmaxF32 operator()(const SumArgmaxF32 a, const SumArgmaxF32 b) const {
+        const bool take_b = b.max > a.max || (b.max == a.max && b.index < a.index);
+        return SumArgmaxF32{a.sum + b.sum, take_b ? b.max : a.max, take_b ? b.index : a.index};
+    }
+};
+
+// __shfl_xor_sync of the multi-value partial results, field by field.
+__device__ inline fp32x2_t warp_shfl_xor(const fp32x2_t v, const int32_t mask) {
+    return make_float2(__shfl_xor_sync(0xFFFFFFFF, v.x, mask), __shfl_xor_sync(0xFFFFFFFF, v.y, mask));
+}
+
+__device__ inline WelfordF32 warp_shfl_xor(const WelfordF32 v, const int32_t mask) {
+    return WelfordF32{
+        __shfl_xor_sync(0xFFFFFFFF, v.mean, mask),
+        __shfl_xor_sync(0xFFFFFFFF, v.m2, mask),
+        __shfl_xor_sync(0xFFFFFFFF, v.count, mask)
+    };
+}
+
+__device__ inline SumArgmaxF32 warp_shfl_xor(const SumArgmaxF32 v, const int32_t mask) {
+    return SumArgmaxF32{
+        __shfl_xor_sync(0xFFFFFFFF, v.sum, mask),
+        __shfl_xor_sync(0xFFFFFFFF, v.max, mask),
+        __shfl_xor_sync(0xFFFFFFFF, v.index, mask)
+    };
+}
+
+/**
+ * @brief Warp-wide reduction of a multi-value partial result with a
+ * butterfly of xor shuffles, so every lane of the warp gets the result.
+ *
+ * The lower lane of every exchanged pair is always the left operand of op,
+ * so all lanes compute bit identical results even for merges that are not
+ * exactly commutative in floating point (Welford).
  *
- * This function computes both the sum and maximum of all `input` values
- * provided by threads in a block using a combination of warp shuffle
- * and shared memory. The result is stored in the first thread of the block.
+ * @tparam T  Partial result, one of fp32x2_t, WelfordF32, SumArgmaxF32.
+ * @tparam Op Combine functor of T (SumMaxOp, WelfordOp, SumArgmaxOp).
+ * @param input The partial result of the calling lane, all 32 lanes must call.
+ * @return The warp-wide result.
+ */
+template<typename T, typename Op>
+__device__ inline
+T warp_reduce(const T input, const Op op) {
+    constexpr int32_t warpSize = 32;
+    const int32_t warp_lane = threadIdx.x % warpSize;
+
+    T local_result = input;
+    #pragma unroll
+    for (int32_t mask = warpSize / 2; mask > 0; mask /= 2) {
+        const T other = warp_shfl_xor(local_result, mask);
+        local_result = (warp_lane & mask) ? op(other, local_result) : op(local_result, other);
+    }
+    return local_result;
+}
+
+/**
+ * @brief Block-wide reduction of a multi-value partial result: a warp
+ * reduction, one partial result per warp in shared memory, then a reduction
+ * of these by every warp. Each statistic costs one pass over the data and a
+ * single __syncthreads(), instead of one block reduction per statistic.
  *
  * @tparam TPB Threads per block, must be a multiple of the warp size (32).
- * @param input The input value for the calling thread (contains .x for sum, .y for max).
- * @return The block-wide reduction result (sum in .x, max in .y). Only thread 0 of the block holds the valid result.
+ * @param input The partial result of the calling thread.
+ * @return The block-wide result, in every thread of the block.
  *
- * @note This function assumes that `TPB` is divisible by 32 (warp size).
+ * @note Two calls of the same instantiation in a row must be separated by a
+ * __syncthreads() (or another block reduction), like sync_block_reduce_*_f32.
  */
-template<int32_t TPB>
+template<int32_t TPB, typename T, typename Op>
 __device__ inline
-fp32x2_t sync_block_reduce_sum_max_f32(const fp32x2_t input) {
+T sync_block_reduce(const T input, const Op op) {
     constexpr int32_t warpSize = 32;
-    static_assert(TPB <= warpSize * warpSize);
+    static_assert(TPB % warpSize == 0 && TPB <= warpSize * warpSize);
 
-    // Thread ID within the current block
     const int32_t tid = threadIdx.x;
     const int32_t warp_lane = tid % warpSize;
     const int32_t warp_id   = tid / warpSize;
 
-    fp32x2_t local_result = input;
-
-    // Warp-level reduction using shuffle operations
-    for (int32_t stride = warpSize / 2; stride > 0; stride /= 2) {
-        // Sum reduction for .x component
-        float sum_val = __shfl_down_sync(0xFFFFFFFF, local_result.x, stride);
-        local_result.x += sum_val;
-        
-        // Max reduction for .y component
-        float max_val = __shfl_down_sync(0xFFFFFFFF, local_result.y, stride);
-        local_result.y = max(local_result.y, max_val);
-    }
+    const T warp_result = warp_reduce(input, op);
 
-    // Shared memory reduction across warps
-    __shared__ fp32x2_t shared_result[TPB / warpSize];
+    __shared__ T shared_result[TPB / warpSize];
     if (warp_lane == 0) {
-        shared_result[warp_id] = local_result;
+        shared_result[warp_id] = warp_result;
     }
     __syncthreads();
 
-    // Block-level reduction using the first warp
-    if (warp_id == 0) {
-        if (warp_lane < TPB / warpSize) {
-            local_result = shared_result[warp_lane];
-        } else {
-            local_result.x = 0.0f;  // Identity for sum
-            local_result.y = -INFINITY;  // Identity for max
-        }
+    // Every warp merges the per-warp results, no second barrier for a broadcast.
+    const T partial = warp_lane < TPB / warpSize ? shared_result[warp_lane] : Op::identity();
+    return warp_reduce(partial, op);
+}
 
-        for (int32_t stride = (TPB / warpSize) / 2; stride > 0; stride /= 2) {
-            // Sum reduction for .x component
-            float sum_val = __shfl_down_sync(0xFFFFFFFF, local_result.x, stride);
-            local_result.x += sum_val;
-            
-            // Max reduction for .y component
-            float max_val = __shfl_down_sync(0xFFFFFFFF, local_result.y, stride);
-            local_result.y = max(local_result.y, max_val);
-        }
-    }
+/**
+ * @brief Warp-wide (sum in .x, max in .y) reduction, in every lane.
+ */
+__device__ inline
+fp32x2_t warp_reduce_sum_max_f32(const fp32x2_t input) {
+    return warp_reduce(input, SumMaxOp{});
+}
 
-    if (warp_id == 0 && warp_lane == 0) {
-        shared_result[0] = local_result;
-    }
-    __syncthreads();
+/**
+ * @brief Performs a block-wide reduction to compute both sum and max
+ * of floating-point values across all threads in a block.
+ *
+ * @tparam TPB Threads per block, must be a multiple of the warp size (32).
+ * @param input The input value for the calling thread (contains .x for sum, .y for max).
+ * @return The block-wide reduction result (sum in .x, max in .y), in every thread of the block.
+ */
+template<int32_t TPB>
+__device__ inline
+fp32x2_t sync_block_reduce_sum_max_f32(const fp32x2_t input) {
+    return sync_block_reduce<TPB>(input, SumMaxOp{});
+}
 
-    return shared_result[0];
+/**
+ * @brief Warp-wide merge of Welford statistics, in every lane.
+ */
+__device__ inline
+WelfordF32 warp_reduce_welford_f32(const WelfordF32 input) {
+    return warp_reduce(input, WelfordOp{});
+}
+
+/**
+ * @brief Block-wide mean / variance in one pass: every thread accumulates its
+ * values with welford_push, the partial statistics are merged pairwise,
+ * which stays accurate when the mean is large compared to the deviations.
+ *
+ * @tparam TPB Threads per block, must be a multiple of the warp size (32).
+ * @param input The statistics of the values of the calling thread.
+ * @return The statistics of the whole block, in every thread of the block.
+ */
+template<int32_t TPB>
+__device__ inline
+WelfordF32 sync_block_reduce_welford_f32(const WelfordF32 input) {
+    return sync_block_reduce<TPB>(input, WelfordOp{});
+}
+
+/**
+ * @brief Warp-wide sum and argmax, in every lane.
+ */
+__device__ inline
+SumArgmaxF32 warp_reduce_sum_argmax_f32(const SumArgmaxF32 input) {
+    return warp_reduce(input, SumArgmaxOp{});
+}
+
+/**
+ * @brief Block-wide sum, max and index of the max (lowest index on ties).
+ *
+ * @tparam TPB Threads per block, must be a multiple of the warp size (32).
+ * @param input The partial result of the calling thread, index INT_MAX and
+ *              max -INFINITY when it has no values.
+ * @return The block-wide result, in every thread of the block.
+ */
+template<int32_t TPB>
+__device__ inline
+SumArgmaxF32 sync_block_reduce_sum_argmax_f32(const SumArgmaxF32 input) {
+    return sync_block_reduce<TPB>(input, SumArgmaxOp{});
 }
 
 } // namespace sm70
@@ -0,0 +1,106 @@
+#pragma once
+#include <torch/extension.h>
+#include <ATen/cuda/CUDAContext.h>
+
+#include "utils.h"
+#include "core/tensor_view.h"
+
+// mytorch, some wrappers and utils
+namespace lightllm {
+using Tensor = torch::Tensor;
+
+template <typename T>
+__host__ inline T *PTR(at::Tensor t) {
+    return reinterpret_cast<T *>(t.data_ptr());
+}
+
+template <>
+__host__ inline fp16_t *PTR(at::Tensor t) {
+    return reinterpret_cast<fp16_t *>(t.data_ptr());
+}
+
+template <>
+__host__ inline fp16x2_t *PTR(at::Tensor t) {
+    return reinterpret_cast<fp16x2_t *>(t.data_ptr());
+}
+
+template <>
+__host__ inline int8x4_t *PTR(at::Tensor t) {
+    return reinterpret_cast<int8x4_t *>(t.data_ptr());
+}
+
+template <>
+__host__ inline int8x2_t *PTR(at::Tensor t) {
+    return reinterpret_cast<int8x2_t *>(t.data_ptr());
+}
+
+template <>
+__host__ inline int8_t *PTR(at::Tensor t) {
+    return reinterpret_cast<int8_t *>(t.data_ptr());
+}
+
+template <>
+__host__ inline uint16_t *PTR(at::Tensor t) {
+    return reinterpret_cast<uint16_t *>(t.data_ptr());
+}
+
+template <>
+__host__ inline uint32_t *PTR(at::Tensor t) {
+    return reinterpret_cast<uint32_t *>(t.data_ptr());
+}
+
+template <>
+__host__ inline void *PTR(at::Tensor t) {
+    return reinterpret_cast<void *>(t.data_ptr());
+}
+
+__device__ inline
+void block_debug_print_matrix(fp16_t *ptr, int32_t M, int32_t N, int32_t stride) {
+    if(threadIdx.x == 0) {
+        printf("Debug Matrix [%d, %d, %d]: \n", blockIdx.x, blockIdx.y, blockIdx.z);
+        for(int32_t i = 0; i < M; i++) {
+            for(int32_t j = 0; j < N; j++) {
+                printf("%.2f ", __half2float(ptr[i * stride + j]));
+            }
+            printf("\n");
+        }
+    }
+}
+
+/**
+ * @brief Non-owning core::TensorView of a torch tensor, used by the thin
+ * PyTorch adapters around the core kernels. CUDA views carry the current
+ * stream of the tensor's device.
+ */
+__host__ inline core::TensorView to_view(const at::Tensor& t) {
+    TORCH_CHECK(t.dim() <= core::TensorView::kMaxDims, "at most ", core::TensorView::kMaxDims, " dims are supported");
+    core::TensorView v;
+    v.data = t.data_ptr();
+    switch (t.scalar_type()) {
+        case at::ScalarType::Float: v.dtype = core::DType::Float32; break;
+        case at::ScalarType::Half: v.dtype = core::DType::Float16; break;
+        case at::ScalarType::BFloat16: v.dtype = core::DType::BFloat16; break;
+        case at::ScalarType::Float8_e4m3fn: v.dtype = core::DType::Fp8E4M3; break;
+        case at::ScalarType::Char: v.dtype = core::DType::Int8; break;
+        case at::ScalarType::Byte: v.dtype = core::DType::UInt8; break;
+        case at::ScalarType::Int: v.dtype = core::DType::Int32; break;
+        case at::ScalarType::Long: v.dtype = core::DType::Int64; break;
+        default: TORCH_CHECK(false, "dtype ", t.scalar_type(), " is not supported by the core library");
+    }
+    v.ndim = t.dim();
+    for (int32_t d = 0; d < v.ndim; d++) {
+        v.shape[d] = t.size(d);
+        v.strides[d] = t.stride(d);
+    }
+    if (t.is_cuda()) {
+        v.device = core::Device::CUDA;
+        v.device_index = t.get_device();
+        v.stream = at::cuda::getCurrentCUDAStream(t.get_device()).stream();
+    } else {
+        TORCH_CHECK(t.is_cpu(), "only CPU and CUDA tensors are supported");
+        v.device = core::Device::CPU;
+    }
+    return v;
+}
+
+}  // namespace lightllm
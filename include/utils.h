@@ -168,6 +168,14 @@ __device__ inline void vec_copy(const void* src, void* dest)
     *out = *in;
 }
 
+// Device side of the host slot checks of the KV cache ops: a slot outside
+// [0, num_slots) (e.g. a virtual slot of a downgraded page, for an op that
+// reads no page_precision) traps, which fails the launch, instead of going
+// past the cache.
+__device__ inline void check_kv_slot(const int64_t slot, const int64_t num_slots) {
+    if (slot < 0 || slot >= num_slots) __trap();
+}
+
 template<int32_t divisor>
 __device__ inline int32x2_t divmod(const int32_t x);
 
@@ -207,67 +215,3 @@ __device__ inline int32x2_t divmod<2>(const int32_t x) {
 }
 
 }  // namespace lightllm
-
-// mytorch, some wrappers and utils
-namespace lightllm {
-using Tensor = torch::Tensor;
-
-template <typename T>
-__host__ inline T *PTR(at::Tensor t) {
-    return reinterpret_cast<T *>(t.data_ptr());
-}
-
-template <>
-__host__ inline fp16_t *PTR(at::Tensor t) {
-    return reinterpret_cast<fp16_t *>(t.data_ptr());
-}
-
-template <>
-__host__ inline fp16x2_t *PTR(at::Tensor t) {
-    return reinterpret_cast<fp16x2_t *>(t.data_ptr());
-}
-
-template <>
-__host__ inline int8x4_t *PTR(at::Tensor t) {
-    return reinterpret_cast<int8x4_t *>(t.data_ptr());
-}
-
-template <>
-__host__ inline int8x2_t *PTR(at::Tensor t) {
-    return reinterpret_cast<int8x2_t *>(t.data_ptr());
-}
-
-template <>
-__host__ inline int8_t *PTR(at::Tensor t) {
-    return reinterpret_cast<int8_t *>(t.data_ptr());
-}
-
-template <>
-__host__ inline uint16_t *PTR(at::Tensor t) {
-    return reinterpret_cast<uint16_t *>(t.data_ptr());
-}
-
-template <>
-__host__ inline uint32_t *PTR(at::Tensor t) {
-    return reinterpret_cast<uint32_t *>(t.data_ptr());
-}
-
-template <>
-__host__ inline void *PTR(at::Tensor t) {
-    return reinterpret_cast<void *>(t.data_ptr());
-}
-
-__device__ inline
-void block_debug_print_matrix(fp16_t *ptr, int32_t M, int32_t N, int32_t stride) {
-    if(threadIdx.x == 0) {
-        printf("Debug Matrix [%d, %d, %d]: \n", blockIdx.x, blockIdx.y, blockIdx.z);
-        for(int32_t i = 0; i < M; i++) {
-            for(int32_t j = 0; j < N; j++) {
-                printf("%.2f ", __half2float(ptr[i * stride + j]));
-            }
-            printf("\n");
-        }
-    }
-}
-
-}  // namespace lightllm
@@ -62,6 +62,7 @@ except ImportError:
         extra_ldflags=["-lcuda", "-L/usr/local/cuda/lib64"],
         extra_cuda_cflags=[
             "-DNDEBUG",
+            "-DLIGHTLLM_CORE_WITH_CUDA=1",
             "-O3",
             "-use_fast_math",
             # A100
@@ -75,13 +76,13 @@ except ImportError:
             "-gencode=arch=compute_90,code=compute_90",
             "-gencode=arch=compute_90a,code=sm_90a",
         ],
-        extra_cflags=["-O3"],
+        extra_cflags=["-O3", "-DLIGHTLLM_CORE_WITH_CUDA=1"],
     )
 
 meta_size = _C.meta_size
 # 向外暴露 Python 端接口
 from .fusion import pre_tp_norm_bf16, post_tp_norm_bf16, add_norm_quant_bf16_fp8, gelu_per_token_quant_bf16_fp8
-from .norm import rmsnorm_bf16
+from .norm import rmsnorm_bf16, make_rmsnorm_plan, RmsNormPlan
 from .allgather import (
     all_gather,
     allgather_dispose,
@@ -89,22 +90,81 @@ from .allgather import (
     allgather_register_buffer,
     allgather_register_graph_buffers,
     allgather_get_graph_buffer_ipc_meta,
+    init_shm_gather,
+    shm_gather_dispose,
+    shm_gather_register_buffer,
+    shm_meta_size,
+    vocab_parallel_embedding,
+)
+from .quant import (
+    per_token_quant_bf16_fp8,
+    per_token_quant_bf16_int8,
+    SafetensorsFile,
+    quantize_weight_per_channel,
+    load_quantized_weights,
 )
-from .quant import per_token_quant_bf16_fp8, per_token_quant_bf16_int8
 from .gemm import cutlass_scaled_mm_bias_ls
-from .moe import grouped_topk
-from .attention import group8_int8kv_flashdecoding_stage1, group_int8kv_decode_attention
+from .moe import grouped_topk, hybrid_moe_partition, moe_cpu_experts, HybridMoeScheduler, ExpertCache
+from .attention import (
+    flashdecoding_combine,
+    group8_int8kv_flashdecoding_stage1,
+    group_int8kv_decode_attention,
+    decode_attention,
+    decode_attention_workspace_bytes,
+    flashdecoding_stage1,
+    varlen_attention,
+    plan_mixed_attention,
+    mixed_int8kv_attention,
+    quest_select_pages,
+    sparse_int8kv_decode_attention,
+    quest_int8kv_decode_attention,
+)
+from .sampling import logprobs_topn, logprobs_topn_partial, logprobs_topn_merge
+from .cpu import (
+    CPU_ISAS,
+    CpuEvent,
+    CpuStream,
+    cpu_isa,
+    detected_cpu_isa,
+    get_cpu_isa,
+    set_cpu_isa,
+    supported_cpu_isas,
+)
+from .kv import (
+    KvPageAllocator,
+    KvOffloadEngine,
+    kv_copy_slots,
+    kv_downgrade_pages,
+    kv_evict_select,
+    kv_move_slots,
+    kv_pack,
+    kv_page_minmax_update,
+    kv_transfer_bytes,
+    kv_transfer_info,
+    kv_unpack,
+    page_copies_to_slot_pairs,
+    page_hashes,
+)
 
 __all__ = [
     "rmsnorm_bf16",
+    "make_rmsnorm_plan",
+    "RmsNormPlan",
     "per_token_quant_bf16_fp8",
     "per_token_quant_bf16_int8",
+    "SafetensorsFile",
+    "quantize_weight_per_channel",
+    "load_quantized_weights",
     "pre_tp_norm_bf16",
     "post_tp_norm_bf16",
     "add_norm_quant_bf16_fp8",
     "gelu_per_token_quant_bf16_fp8",
     "cutlass_scaled_mm_bias_ls",
     "grouped_topk",
+    "hybrid_moe_partition",
+    "moe_cpu_experts",
+    "HybridMoeScheduler",
+    "ExpertCache",
     "meta_size",
     "all_gather",
     "allgather_dispose",
@@ -112,6 +172,45 @@ __all__ = [
     "allgather_register_buffer",
     "allgather_get_graph_buffer_ipc_meta",
     "allgather_register_graph_buffers",
+    "init_shm_gather",
+    "shm_gather_dispose",
+    "shm_gather_register_buffer",
+    "shm_meta_size",
+    "vocab_parallel_embedding",
     "group8_int8kv_flashdecoding_stage1",
     "group_int8kv_decode_attention",
+    "decode_attention",
+    "decode_attention_workspace_bytes",
+    "flashdecoding_stage1",
+    "flashdecoding_combine",
+    "varlen_attention",
+    "plan_mixed_attention",
+    "mixed_int8kv_attention",
+    "quest_select_pages",
+    "sparse_int8kv_decode_attention",
+    "quest_int8kv_decode_attention",
+    "logprobs_topn",
+    "logprobs_topn_partial",
+    "logprobs_topn_merge",
+    "CPU_ISAS",
+    "CpuEvent",
+    "CpuStream",
+    "cpu_isa",
+    "detected_cpu_isa",
+    "get_cpu_isa",
+    "set_cpu_isa",
+    "supported_cpu_isas",
+    "KvPageAllocator",
+    "KvOffloadEngine",
+    "kv_copy_slots",
+    "kv_downgrade_pages",
+    "kv_evict_select",
+    "kv_move_slots",
+    "kv_pack",
+    "kv_page_minmax_update",
+    "kv_transfer_bytes",
+    "kv_transfer_info",
+    "kv_unpack",
+    "page_copies_to_slot_pairs",
+    "page_hashes",
 ]
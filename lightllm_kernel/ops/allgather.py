@@ -27,3 +27,35 @@ def allgather_get_graph_buffer_ipc_meta(_fa: int) -> Tuple[List[int], List[int]]
 
 def allgather_register_graph_buffers(_fa: int, handles: List[List[int]], offsets: List[List[int]]) -> None:
     _C.allgather_register_graph_buffers(_fa, handles, offsets)
+
+
+def init_shm_gather(fake_shm_ptrs: List[int], rank: int) -> int:
+    return _C.init_shm_gather(fake_shm_ptrs, rank)
+
+
+def shm_gather_dispose(_fa: int) -> None:
+    _C.shm_gather_dispose(_fa)
+
+
+def shm_gather_register_buffer(_fa: int, fake_shm_ptrs: List[int]) -> None:
+    _C.shm_gather_register_buffer(_fa, fake_shm_ptrs)
+
+
+def shm_meta_size() -> int:
+    return _C.shm_meta_size()
+
+
+def vocab_parallel_embedding(
+    _fa: int,
+    ids: torch.Tensor,
+    weight: torch.Tensor,
+    vocab_per_rank: int,
+    _reg_buffer: int,
+    reg_buffer_sz_bytes: int,
+    out: Optional[torch.Tensor] = None,
+) -> torch.Tensor:
+    """Embedding lookup over a vocab sharded weight, the full [tokens, hidden] result is returned on every rank"""
+    if out is None:
+        out = torch.empty((ids.shape[0], weight.shape[1]), device=weight.device, dtype=weight.dtype)
+    _C.vocab_parallel_embedding(_fa, out, ids, weight, _reg_buffer, reg_buffer_sz_bytes, vocab_per_rank)
+    return out
@@ -1,7 +1,30 @@
 import torch
-from typing import Optional, Tuple
+from typing import Dict, Optional, Tuple
 from . import _C
 
+# zero filled scratch of the CUDA fp8 decode output per (device, stream): the launches of one stream run in
+# order and each leaves it zeroed for the next, launches on other streams may overlap and get their own
+_decode_workspaces: Dict[Tuple[torch.device, int], torch.Tensor] = {}
+
+
+def decode_attention_workspace_bytes(batch: int, heads: int, head_dim: int) -> int:
+    """Bytes of the workspace of a CUDA decode attention launch with an fp8 o."""
+    return _C.int8kv_decode_attention_workspace_bytes(batch, heads, head_dim)
+
+
+def _decode_workspace(
+    o: torch.Tensor, q: torch.Tensor, workspace: Optional[torch.Tensor]
+) -> Optional[torch.Tensor]:
+    if workspace is not None or o.dtype != torch.float8_e4m3fn or not o.is_cuda:
+        return workspace
+    nbytes = decode_attention_workspace_bytes(q.shape[0], q.shape[1], q.shape[2])
+    key = (o.device, torch.cuda.current_stream(o.device).cuda_stream)
+    ws = _decode_workspaces.get(key)
+    if ws is None or ws.numel() < nbytes:
+        ws = torch.zeros(nbytes, dtype=torch.uint8, device=o.device)
+        _decode_workspaces[key] = ws
+    return ws
+
 
 def group8_int8kv_flashdecoding_stage1(
     seq_block_size: int,
@@ -47,8 +70,26 @@ def group_int8kv_decode_attention(
     b_req_idx: torch.Tensor,
     b_seq_len: torch.Tensor,
     max_len_in_batch: int,
+    int8_qk: bool = False,
+    o_scale: Optional[torch.Tensor] = None,
+    attn_mass: Optional[torch.Tensor] = None,
+    workspace: Optional[torch.Tensor] = None,
 ) -> None:
+    """Decode attention over an int8 KV cache with group-8 scales, writes o in place.
+
+    With int8_qk the query of every head is quantized to int8 (absmax scale) and QK^T runs as int8 dot
+    products (dp4a on CUDA, AVX512-VNNI on CPU), trading a little accuracy for less dequantization work.
 
+    o may be float8_e4m3fn: the output of every token is then quantized over all of its heads with the
+    scale written to o_scale ([B, 1] fp32), ready for cutlass_scaled_mm, as per_token_quant_bf16_fp8 would.
+    On CUDA this needs a zero filled workspace of decode_attention_workspace_bytes, which every
+    launch leaves zeroed: one per stream is kept here, or pass your own (e.g. one per CUDA graph).
+
+    attn_mass ([max_reqs, Hkv, max_len] fp32, zeroed when a request starts) accumulates the attention
+    probabilities of every step per (request, kv head, position), summed over the heads of a GQA group;
+    kv_evict_select turns a request's row into the tokens to keep (H2O / SnapKV style eviction).
+    """
+    workspace = _decode_workspace(o, q, workspace)
     return _C.group_int8kv_decode_attention(
         o,
         q,
@@ -60,4 +101,244 @@ def group_int8kv_decode_attention(
         b_req_idx,
         b_seq_len,
         max_len_in_batch,
+        int8_qk,
+        o_scale,
+        workspace,
+        attn_mass,
+    )
+
+
+def decode_attention(
+    o: torch.Tensor,
+    q: torch.Tensor,
+    k: torch.Tensor,
+    v: torch.Tensor,
+    req_to_tokens: torch.Tensor,
+    b_req_idx: torch.Tensor,
+    b_seq_len: torch.Tensor,
+    max_len_in_batch: int,
+    k_s: Optional[torch.Tensor] = None,
+    v_s: Optional[torch.Tensor] = None,
+    o_scale: Optional[torch.Tensor] = None,
+    attn_mass: Optional[torch.Tensor] = None,
+    page_precision: Optional[torch.Tensor] = None,
+    page_size: int = 0,
+    workspace: Optional[torch.Tensor] = None,
+) -> None:
+    """group_int8kv_decode_attention for any KV cache format over the same req_to_tokens layout, writes o.
+
+    k / v ([slots, Hkv, D]) are int8 or float8_e4m3fn with group-8 scales k_s / v_s ([slots, Hkv, D / 8],
+    dtype of q), or unquantized in the dtype of q with k_s / v_s None. o_scale, attn_mass and workspace
+    work as in group_int8kv_decode_attention.
+
+    page_precision ([num_pages] int8 on the device of q, pages of page_size slots) are the tags of
+    KvPageAllocator.downgrade: tagged pages are read as kv_downgrade_pages packed them, and req_to_tokens
+    may hold the virtual slots [slots, 2 * slots) of the second page of a pair. A bf16 / fp16 cache then
+    needs k_s / v_s for its downgraded pages; fp8 caches cannot be downgraded.
+    """
+    workspace = _decode_workspace(o, q, workspace)
+    return _C.decode_attention(
+        o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, max_len_in_batch, o_scale, workspace, attn_mass,
+        page_precision, page_size,
+    )
+
+
+def flashdecoding_stage1(
+    seq_block_size: int,
+    mid_o_emb: torch.Tensor,
+    mid_o_logexpsum: torch.Tensor,
+    att_scale: float,
+    q: torch.Tensor,
+    k: torch.Tensor,
+    v: torch.Tensor,
+    req_to_tokens: torch.Tensor,
+    b_req_idx: torch.Tensor,
+    b_seq_len: torch.Tensor,
+    max_len_in_batch: int,
+    k_s: Optional[torch.Tensor] = None,
+    v_s: Optional[torch.Tensor] = None,
+    page_precision: Optional[torch.Tensor] = None,
+    page_size: int = 0,
+) -> None:
+    """group8_int8kv_flashdecoding_stage1 for the KV cache formats of decode_attention, on CUDA or CPU.
+
+    page_precision and page_size read downgraded pages as in decode_attention.
+    """
+    return _C.flashdecoding_stage1(
+        seq_block_size,
+        mid_o_emb,
+        mid_o_logexpsum,
+        att_scale,
+        q,
+        k,
+        k_s,
+        v,
+        v_s,
+        req_to_tokens,
+        b_req_idx,
+        b_seq_len,
+        max_len_in_batch,
+        page_precision,
+        page_size,
+    )
+
+
+def quest_select_pages(
+    q: torch.Tensor,
+    page_min: torch.Tensor,
+    page_max: torch.Tensor,
+    req_to_tokens: torch.Tensor,
+    b_req_idx: torch.Tensor,
+    b_seq_len: torch.Tensor,
+    page_size: int,
+    top_pages: int,
+    max_len_in_batch: int,
+) -> torch.Tensor:
+    """Query-aware page selection (Quest): the top_pages pages of every (request, kv head).
+
+    A page scores sum_d max(q_d * min_d, q_d * max_d) over the summaries of kv_page_minmax_update, an
+    upper bound of q . k for its keys, taking the max over the heads of a GQA group. The page of the
+    current token is always kept. Returns [B, Hkv, top_pages] int32 logical pages (position // page_size)
+    in ascending order, -1 padded for requests of fewer pages.
+    """
+    return _C.quest_select_pages(
+        q, page_min, page_max, req_to_tokens, b_req_idx, b_seq_len, page_size, top_pages, max_len_in_batch
+    )
+
+
+def sparse_int8kv_decode_attention(
+    o: torch.Tensor,
+    q: torch.Tensor,
+    k: torch.Tensor,
+    k_s: torch.Tensor,
+    v: torch.Tensor,
+    v_s: torch.Tensor,
+    req_to_tokens: torch.Tensor,
+    b_req_idx: torch.Tensor,
+    b_seq_len: torch.Tensor,
+    page_idx: torch.Tensor,
+    page_size: int,
+) -> None:
+    """group_int8kv_decode_attention over the tokens of the pages in page_idx ([B, Hkv, top]) only, writes o."""
+    return _C.sparse_int8kv_decode_attention(
+        o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, page_idx, page_size
+    )
+
+
+def quest_int8kv_decode_attention(
+    o: torch.Tensor,
+    q: torch.Tensor,
+    k: torch.Tensor,
+    k_s: torch.Tensor,
+    v: torch.Tensor,
+    v_s: torch.Tensor,
+    req_to_tokens: torch.Tensor,
+    b_req_idx: torch.Tensor,
+    b_seq_len: torch.Tensor,
+    max_len_in_batch: int,
+    page_min: torch.Tensor,
+    page_max: torch.Tensor,
+    page_size: int,
+    top_pages: int,
+) -> torch.Tensor:
+    """Sparse decode attention for long contexts: quest_select_pages, then sparse_int8kv_decode_attention.
+
+    Streams top_pages * page_size tokens per (request, kv head) instead of the whole int8 KV cache; with
+    top_pages covering the longest request it equals group_int8kv_decode_attention. req_to_tokens must be
+    page aligned (logical page j of a request in physical page req_to_tokens[req, j * page_size] //
+    page_size). Returns the selected pages.
+    """
+    page_idx = quest_select_pages(
+        q, page_min, page_max, req_to_tokens, b_req_idx, b_seq_len, page_size, top_pages, max_len_in_batch
+    )
+    sparse_int8kv_decode_attention(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, page_idx, page_size)
+    return page_idx
+
+
+def flashdecoding_combine(
+    o: torch.Tensor,
+    mid_o_emb: torch.Tensor,
+    mid_o_logexpsum: torch.Tensor,
+    b_seq_len: torch.Tensor,
+    seq_block_size: int,
+    o_scale: Optional[torch.Tensor] = None,
+) -> None:
+    """Merge the per seq block outputs of group8_int8kv_flashdecoding_stage1 into o ([B, H, D]) in place.
+
+    o has the dtype of the mids, or is float8_e4m3fn with per token scales over all heads written to
+    o_scale ([B, 1] fp32).
+    """
+    return _C.flashdecoding_combine(o, o_scale, mid_o_emb, mid_o_logexpsum, b_seq_len, seq_block_size)
+
+
+def varlen_attention(
+    q: torch.Tensor,
+    k: torch.Tensor,
+    v: torch.Tensor,
+    cu_seqlens: torch.Tensor,
+    max_seqlen: Optional[int] = None,
+    softmax_scale: Optional[float] = None,
+) -> torch.Tensor:
+    """Non-causal attention over packed variable length sequences, e.g. the patches of a ViT batch.
+
+    q is [T, H, D] and k, v are [T, Hkv, D] (bf16 / fp16, D in 64 / 80 / 128) holding the tokens of all
+    sequences back to back; cu_seqlens is [B + 1] int32 with the prefix sums of the sequence lengths. Every
+    token attends to all tokens of its own sequence. Pass max_seqlen to avoid a device sync on CUDA.
+    """
+    cu_seqlens = cu_seqlens.to(device=q.device, dtype=torch.int32)
+    if max_seqlen is None:
+        max_seqlen = int((cu_seqlens[1:] - cu_seqlens[:-1]).max().item()) if cu_seqlens.numel() > 1 else 0
+    if softmax_scale is None:
+        softmax_scale = q.shape[-1] ** -0.5
+    return _C.varlen_attention(q, k, v, cu_seqlens, max_seqlen, softmax_scale)
+
+
+def plan_mixed_attention(
+    cu_q_lens: torch.Tensor,
+    b_seq_len: torch.Tensor,
+    num_heads: int,
+    num_kv_heads: int,
+    device: torch.device = "cpu",
+) -> torch.Tensor:
+    """Work list ([n, 4] int32 rows of batch, kv_head, q_begin, q_end) of mixed_int8kv_attention.
+
+    Decode requests get one unit per kv head, prefill chunks are cut in query tiles of 32 rows (tokens x
+    GQA heads); the units are sorted by their KV length times rows, longest first, so the persistent kernel
+    balances them. The list is planned on the host and copied once to device, the device of q; it only
+    depends on the batch shape and can be reused by every layer of a step and by CUDA graph replays.
+    """
+    work = _C.plan_mixed_attention(
+        cu_q_lens.to(device="cpu", dtype=torch.int32), b_seq_len.to(device="cpu", dtype=torch.int32),
+        num_heads, num_kv_heads,
+    )
+    return work.to(device)
+
+
+def mixed_int8kv_attention(
+    o: torch.Tensor,
+    q: torch.Tensor,
+    k: torch.Tensor,
+    k_s: torch.Tensor,
+    v: torch.Tensor,
+    v_s: torch.Tensor,
+    req_to_tokens: torch.Tensor,
+    b_req_idx: torch.Tensor,
+    b_seq_len: torch.Tensor,
+    cu_q_lens: torch.Tensor,
+    work: Optional[torch.Tensor] = None,
+    page_precision: Optional[torch.Tensor] = None,
+    page_size: int = 0,
+) -> None:
+    """Attention of a chunked-prefill step, prefill chunks and decode tokens alike, in one launch; writes o.
+
+    q and o are [Tq, H, D] with the query tokens of all requests back to back, cu_q_lens [B + 1] int32 their
+    prefix sums. Query token i of request b sits at position b_seq_len[b] - q_len[b] + i and attends causally
+    over the int8 KV cache of group8_int8kv_decode_attention, which already holds its K / V. work comes from
+    plan_mixed_attention on the device of q, planned once per step; it is planned here (with a device sync)
+    when not given. page_precision and page_size read downgraded pages as in decode_attention.
+    """
+    if work is None:
+        work = plan_mixed_attention(cu_q_lens, b_seq_len, q.shape[1], k.shape[1], q.device)
+    return _C.mixed_int8kv_attention(
+        o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu_q_lens, work, page_precision, page_size
     )
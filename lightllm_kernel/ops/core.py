@@ -0,0 +1,35 @@
+import torch
+
+# core::DType / lk_dtype_t codes of the torch-free core library (include/core/lightllm_c.h)
+_DTYPE_CODES = {
+    torch.float32: 0,
+    torch.float16: 1,
+    torch.bfloat16: 2,
+    torch.float8_e4m3fn: 3,
+    torch.int8: 4,
+    torch.uint8: 5,
+    torch.int32: 6,
+    torch.int64: 7,
+}
+
+
+def dtype_code(dtype: torch.dtype) -> int:
+    if dtype not in _DTYPE_CODES:
+        raise ValueError(f"dtype {dtype} is not supported by the core library")
+    return _DTYPE_CODES[dtype]
+
+
+def device_index(device: torch.device) -> int:
+    """Device index as passed to the core plans, -1 for CPU"""
+    device = torch.device(device)
+    if device.type == "cpu":
+        return -1
+    return device.index if device.index is not None else torch.cuda.current_device()
+
+
+def stream_handle(device: torch.device) -> int:
+    """cudaStream_t of the current stream of device, 0 for CPU"""
+    device = torch.device(device)
+    if device.type == "cpu":
+        return 0
+    return torch.cuda.current_stream(device).cuda_stream
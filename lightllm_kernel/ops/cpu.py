@@ -0,0 +1,113 @@
+import contextlib
+from concurrent.futures import Future
+from . import _C
+
+# instruction set levels of the CPU kernels, each one includes the previous ones
+CPU_ISAS = ("scalar", "avx2", "avx512", "avx512_bf16", "amx")
+
+
+def set_cpu_isa(isa: str) -> None:
+    """Force the instruction set level of the CPU kernels, at most detected_cpu_isa().
+    The LIGHTLLM_CPU_ISA environment variable caps the initial level the same way."""
+    _C.set_cpu_isa(isa)
+
+
+def get_cpu_isa() -> str:
+    """Level the CPU kernels run at"""
+    return _C.get_cpu_isa(False)
+
+
+def detected_cpu_isa() -> str:
+    """Highest level this CPU and OS support"""
+    return _C.get_cpu_isa(True)
+
+
+def supported_cpu_isas() -> list:
+    """Levels set_cpu_isa accepts on this machine, lowest first"""
+    return list(CPU_ISAS[: CPU_ISAS.index(detected_cpu_isa()) + 1])
+
+
+@contextlib.contextmanager
+def cpu_isa(isa: str):
+    """Run the CPU kernels at isa inside the block, e.g. to compare levels"""
+    previous = get_cpu_isa()
+    set_cpu_isa(isa)
+    try:
+        yield
+    finally:
+        set_cpu_isa(previous)
+
+
+class CpuEvent:
+    """Marks a point of a CpuStream, completes once the work submitted before it has run"""
+
+    def __init__(self, handle: int):
+        self._event = handle
+
+    def __del__(self):
+        if getattr(self, "_event", None):
+            _C.cpu_event_dispose(self._event)
+            self._event = None
+
+    def query(self) -> bool:
+        return _C.cpu_event_query(self._event)
+
+    def synchronize(self) -> None:
+        """Block until the event completes, the GIL is released meanwhile"""
+        _C.cpu_event_synchronize(self._event)
+
+
+class CpuStream:
+    """Ordered queue of host work, the CPU counterpart of torch.cuda.Stream.
+
+    submit() returns right away and the callables run one after the other on a thread of the stream, so
+    the caller overlaps its own work (scheduling, GPU launches) with them. The ops of this extension
+    release the GIL while their CPU kernels run, which is what lets the two proceed in parallel; the
+    kernels split across the threads of set_num_threads, shared by all streams. Order work across
+    streams with record_event() / wait_event().
+    """
+
+    def __init__(self):
+        self._stream = _C.init_cpu_stream()
+
+    def __del__(self):
+        self.close()
+
+    def close(self) -> None:
+        """Run the submitted work, then release the stream"""
+        if getattr(self, "_stream", None):
+            _C.cpu_stream_dispose(self._stream)
+            self._stream = None
+
+    def submit(self, fn, *args, **kwargs) -> Future:
+        """Enqueue fn(*args, **kwargs), the future receives its result or exception"""
+        future = Future()
+
+        def run():
+            if not future.set_running_or_notify_cancel():
+                return
+            try:
+                future.set_result(fn(*args, **kwargs))
+            except BaseException as e:
+                future.set_exception(e)
+
+        _C.cpu_stream_submit(self._stream, run)
+        return future
+
+    def record_event(self) -> CpuEvent:
+        return CpuEvent(_C.cpu_stream_record(self._stream))
+
+    def wait_event(self, event: CpuEvent) -> None:
+        """Work submitted after this call starts once event completes"""
+        _C.cpu_stream_wait_event(self._stream, event._event)
+
+    def wait_stream(self, stream: "CpuStream") -> None:
+        self.wait_event(stream.record_event())
+
+    def query(self) -> bool:
+        """True if all submitted work has run"""
+        return _C.cpu_stream_query(self._stream)
+
+    def synchronize(self) -> None:
+        """Block until all submitted work has run, the GIL is released meanwhile"""
+        _C.cpu_stream_synchronize(self._stream)
@@ -18,7 +18,12 @@ def post_tp_norm_bf16(
 def add_norm_quant_bf16_fp8(
     input: torch.Tensor, residual: torch.Tensor, weight: torch.Tensor, eps: float
 ) -> Tuple[torch.Tensor, torch.Tensor]:
-    """Apply add_norm_quant on given input, with residual and weight"""
+    """Apply add_norm_quant on given input, with residual and weight
+
+    input += residual (in place, bf16), then the rmsnorm of input times weight is quantized per token to fp8
+    with scales absmax / 448. Both row statistics come from one reduction and the normalized row is not rounded
+    to bf16 before the quantization. Runs on CUDA and CPU tensors.
+    """
     return _C.add_norm_quant_bf16_fp8(input, residual, weight, eps)
 
 
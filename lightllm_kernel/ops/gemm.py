@@ -12,5 +12,6 @@ def cutlass_scaled_mm_bias_ls(
     bias: Optional[torch.Tensor],
     ls: Optional[torch.Tensor],
 ) -> None:
-    """Apply scaled mm on the given input, with optional bias and ls weight"""
+    """Apply scaled mm on the given input, with optional bias and ls weight.
+    CPU tensors run the host GEMM of the active CPU instruction set (see set_cpu_isa)."""
     return _C.cutlass_scaled_mm(c, a, b, a_scales, b_scales, bias, ls)
@@ -0,0 +1,320 @@
+import torch
+from typing import List, Optional, Sequence, Tuple, Union
+from . import _C
+
+
+def _int32_cpu(x: Union[torch.Tensor, Sequence[int]]) -> torch.Tensor:
+    if isinstance(x, torch.Tensor):
+        return x.to(device="cpu", dtype=torch.int32)
+    return torch.tensor(x, dtype=torch.int32)
+
+
+def kv_copy_slots(caches: Sequence[torch.Tensor], pairs: torch.Tensor, slot_dim: int = 0) -> None:
+    """Copy the token rows src -> dst of all caches (e.g. [k, v, k_s, v_s]) in one launch.
+
+    pairs is [n, 2] int32 (src_slot, dst_slot) on the device of the caches; dst slots must be distinct
+    and must not be src slots. slot_dim is 0 for [slots, ...] caches and 1 for [layers, slots, ...].
+    """
+    _C.kv_copy_slots(list(caches), pairs, slot_dim)
+
+
+def kv_downgrade_pages(
+    caches: Sequence[torch.Tensor], scales: Sequence[torch.Tensor], pairs: torch.Tensor, page_size: int
+) -> None:
+    """Pack the (p, q) page pairs of KvPageAllocator.downgrade into page p at half the precision, in place.
+
+    caches are [slots, Hkv, D] (D % 16 == 0) and scales[i] the [slots, Hkv, D / 8] scales of caches[i], e.g.
+    the k and v of every layer. An int8 cache with group-8 scales becomes int4 with group-16 scales, a bf16 /
+    fp16 one becomes int8 with group-16 scales in its scale tensor (dtype of the cache). Row t of page p then
+    holds token t of p in its first half and token t of q in its second half; decode_attention reads them
+    through the page_precision tags.
+    """
+    pairs = pairs.to(device=caches[0].device, dtype=torch.int32)
+    _C.kv_downgrade_pages(list(caches), list(scales), pairs, page_size)
+
+
+def kv_transfer_bytes(caches: Sequence[torch.Tensor], num_tokens: int, slot_dim: int = 0) -> int:
+    """Size in bytes of a kv_pack buffer for num_tokens slots of caches (header included)."""
+    return _C.kv_transfer_bytes(list(caches), slot_dim, num_tokens)
+
+
+def kv_pack(
+    caches: Sequence[torch.Tensor],
+    slots: torch.Tensor,
+    slot_dim: int = 0,
+    tag: int = 0,
+    out: Optional[torch.Tensor] = None,
+) -> torch.Tensor:
+    """Pack the rows of a request's slots in all caches into one versioned transfer buffer, in one launch.
+
+    The buffer is a small header (format version, token count, tag, row size and dtype of every cache)
+    followed by the rows, cache by cache and layer by layer, in the order of slots. It is allocated on the
+    device of the caches unless out (a contiguous uint8 tensor, e.g. pinned host memory) is given.
+    """
+    nbytes = kv_transfer_bytes(caches, slots.numel(), slot_dim)
+    if out is None:
+        out = torch.empty(nbytes, dtype=torch.uint8, device=caches[0].device)
+    _C.kv_pack(list(caches), slots, slot_dim, tag, out)
+    return out
+
+
+def kv_transfer_info(buffer: torch.Tensor) -> Tuple[int, int]:
+    """(num_tokens, tag) from the header of a kv_pack buffer; raises on a foreign or newer buffer."""
+    return _C.kv_transfer_info(buffer)
+
+
+def kv_unpack(caches: Sequence[torch.Tensor], slots: torch.Tensor, buffer: torch.Tensor, slot_dim: int = 0) -> None:
+    """Write the rows of a kv_pack buffer into slots ([num_tokens] distinct int32) of caches, in one launch.
+
+    The caches must have the row sizes and dtypes of the sender's caches; the layer layout may differ.
+    """
+    _C.kv_unpack(list(caches), slots, slot_dim, buffer)
+
+
+def kv_move_slots(caches: Sequence[torch.Tensor], pairs: torch.Tensor, slot_dim: int = 0) -> None:
+    """Move the token rows src -> dst of all caches when the moves may chain (a dst is another src),
+    as KvPageAllocator.evict returns them: all rows are gathered first, then scattered."""
+    if pairs.numel() == 0:
+        return
+    pairs = pairs.to(caches[0].device)
+    kv_unpack(caches, pairs[:, 1].contiguous(), kv_pack(caches, pairs[:, 0].contiguous(), slot_dim), slot_dim)
+
+
+def kv_evict_select(
+    attn_mass: torch.Tensor,
+    req: int,
+    seq_len: int,
+    budget: int,
+    num_sink: int = 4,
+    num_recent: int = 64,
+) -> torch.Tensor:
+    """Positions of request req to keep after a KV eviction, H2O style.
+
+    attn_mass is the [max_reqs, Hkv, max_len] buffer group_int8kv_decode_attention accumulates. The first
+    num_sink and last num_recent tokens are kept, the rest of budget goes to the tokens of the highest mass
+    summed over the kv heads. The row of req is compacted to the kept tokens, so it keeps accumulating once
+    KvPageAllocator.evict has moved them. Returns [min(seq_len, budget)] ascending int32 CPU positions.
+    """
+    row = attn_mass[req] if attn_mass.is_cpu else attn_mass[req].cpu()
+    keep = _C.kv_evict_select(row, seq_len, budget, num_sink, num_recent)
+    if not attn_mass.is_cpu:
+        attn_mass[req].copy_(row)
+    return keep
+
+
+def kv_page_minmax_update(
+    page_min: torch.Tensor,
+    page_max: torch.Tensor,
+    k: torch.Tensor,
+    k_s: torch.Tensor,
+    slots: torch.Tensor,
+    page_size: int,
+) -> None:
+    """Refresh the per page key summary of quest_int8kv_decode_attention after storing K at slots.
+
+    page_min / page_max are [num_pages, Hkv, D] in the dtype of k_s: the channel-wise min / max of the
+    dequantized keys of every page of the int8 cache k ([slots, Hkv, D], group-8 scales k_s). Every page
+    that slots touch is recomputed up to its last written slot; the slots of a page must be consecutive
+    and ascending, as KvPageAllocator.extend returns them.
+    """
+    _C.kv_page_minmax_update(page_min, page_max, k, k_s, slots.to(device=k.device, dtype=torch.int32), page_size)
+
+
+def page_copies_to_slot_pairs(
+    copies: torch.Tensor, page_size: int, device: torch.device = "cpu"
+) -> torch.Tensor:
+    """Expand [c, 3] (src_page, dst_page, num_tokens) page copies into [n, 2] slot pairs"""
+    num_tokens = copies[:, 2].to(torch.int64)
+    page_pairs = torch.repeat_interleave(copies[:, :2], num_tokens, dim=0)
+    # offset of every token inside its page
+    starts = torch.cumsum(num_tokens, 0) - num_tokens
+    offsets = torch.arange(page_pairs.shape[0], dtype=torch.int64) - torch.repeat_interleave(starts, num_tokens)
+    pairs = page_pairs.to(torch.int64) * page_size + offsets[:, None]
+    return pairs.to(device=device, dtype=torch.int32)
+
+
+def page_hashes(
+    tokens: Union[torch.Tensor, Sequence[Sequence[int]]],
+    page_size: int,
+    lens: Optional[torch.Tensor] = None,
+    seed: int = 0,
+    bits: int = 64,
+) -> torch.Tensor:
+    """Chained hashes of the full pages of token id sequences, for prefix cache lookups.
+
+    Hash p of a sequence covers its tokens [0, (p + 1) * page_size), so sequences share hash p exactly when
+    they share that prefix. tokens is a 1D tensor (one sequence), a [B, L] tensor with lens [B] (rows laid
+    out like req_to_tokens), or a list of sequences. Returns int64 [..., L // page_size] (bits=64) or
+    [..., L // page_size, 2] (bits=128); entries of pages that are not full are 0. seed must fit in int64.
+    """
+    if not isinstance(tokens, torch.Tensor):
+        max_len = max((len(t) for t in tokens), default=0)
+        lens = torch.tensor([len(t) for t in tokens], dtype=torch.int64)
+        padded = torch.zeros((len(tokens), max_len), dtype=torch.int64)
+        for i, t in enumerate(tokens):
+            padded[i, : len(t)] = torch.as_tensor(t, dtype=torch.int64)
+        tokens = padded
+    squeeze = tokens.dim() == 1
+    if squeeze:
+        tokens = tokens[None]
+    if lens is None:
+        lens = torch.full((tokens.shape[0],), tokens.shape[1], dtype=torch.int64)
+    out = _C.page_hashes(tokens.cpu(), lens.cpu(), page_size, seed, bits)
+    return out[0] if squeeze else out
+
+
+class KvPageAllocator:
+    """Paged KV cache allocator that keeps a req_to_tokens table up to date.
+
+    The KV cache has num_pages pages of page_size token slots (slot = page * page_size + offset).
+    Every allocation writes the slots of the request into its row of req_to_tokens, an int32 CPU
+    tensor of at least [max_reqs, max_seq_len] (a pinned one can be copied to the GPU asynchronously).
+    fork() shares the pages of a prefix; a shared, partially filled page is copied on the first write
+    and extend() reports those copies, which the caller applies to the KV cache before the step.
+
+    With downgradable=True the allocator also keeps page_precision ([num_pages] int8 CPU tags, copy them
+    to the device with req_to_tokens) and downgrade() frees pages under memory pressure instead of
+    preempting requests.
+    """
+
+    def __init__(
+        self,
+        num_pages: int,
+        page_size: int,
+        max_reqs: int,
+        max_seq_len: int,
+        req_to_tokens: Optional[torch.Tensor] = None,
+        downgradable: bool = False,
+    ):
+        if req_to_tokens is None:
+            req_to_tokens = torch.zeros((max_reqs, max_seq_len), dtype=torch.int32)
+        # the allocator only keeps a view of the table and the tags
+        self.req_to_tokens = req_to_tokens
+        self.page_precision = torch.zeros((num_pages,), dtype=torch.int8) if downgradable else None
+        self.page_size = page_size
+        self._alloc = _C.init_kv_allocator(
+            num_pages, page_size, max_reqs, max_seq_len, req_to_tokens, self.page_precision
+        )
+
+    def __del__(self):
+        if getattr(self, "_alloc", None):
+            _C.kv_allocator_dispose(self._alloc)
+            self._alloc = None
+
+    def alloc_req(self) -> int:
+        """Row of a new empty request, -1 if all rows are in use"""
+        return _C.kv_alloc_req(self._alloc)
+
+    def free_reqs(self, reqs: Union[torch.Tensor, Sequence[int]]) -> None:
+        _C.kv_free_reqs(self._alloc, _int32_cpu(reqs))
+
+    def fork(self, src: int, prefix_len: int) -> int:
+        """New request sharing the first prefix_len tokens of src, -1 if all rows are in use"""
+        return _C.kv_fork(self._alloc, src, prefix_len)
+
+    def extend(
+        self, reqs: Union[torch.Tensor, Sequence[int]], num_new: Union[torch.Tensor, Sequence[int]]
+    ) -> Tuple[bool, torch.Tensor, torch.Tensor]:
+        """Allocate num_new[i] more tokens for reqs[i], all or nothing.
+
+        Returns (ok, slots, copies): the int32 slots of the new tokens in batch order and the
+        copy-on-writes as [c, 3] rows of (src_page, dst_page, num_tokens).
+        """
+        return _C.kv_extend(self._alloc, _int32_cpu(reqs), _int32_cpu(num_new))
+
+    def compact(self) -> torch.Tensor:
+        """Move the used pages to the lowest page ids with the fewest page copies.
+
+        req_to_tokens is rewritten immediately; the returned [c, 3] (src_page, dst_page, num_tokens)
+        moves must be applied to the KV cache (kv_copy_slots) before the next step reads it.
+        """
+        return _C.kv_compact(self._alloc)
+
+    def truncate(self, req: int, new_len: int) -> None:
+        _C.kv_truncate(self._alloc, req, new_len)
+
+    def evict(self, req: int, keep: Union[torch.Tensor, Sequence[int]]) -> Tuple[bool, torch.Tensor]:
+        """Keep only the tokens at the ascending positions keep of req, moved to positions [0, len(keep)).
+
+        Pages after them are freed and shared pages that are written get copied. Returns (ok, pairs):
+        [p, 2] int32 (src_slot, dst_slot) moves to apply with kv_move_slots before the next step. ok is
+        False and nothing changes if there are not enough free pages for the copies.
+        """
+        return _C.kv_evict(self._alloc, req, _int32_cpu(keep))
+
+    def downgrade(self, num_pages: int, num_sink_pages: int = 1, num_recent_pages: int = 8) -> torch.Tensor:
+        """Free up to num_pages pages by packing pairs of cold pages into one at half the precision.
+
+        Candidates are the full pages a request owns alone, outside its first num_sink_pages and last
+        num_recent_pages full pages, oldest first from the longest requests. req_to_tokens and
+        page_precision are rewritten immediately; the returned [n, 2] int32 (p, q) pages (one per freed
+        page) must be converted with kv_downgrade_pages before the next extend reuses them.
+        """
+        return _C.kv_downgrade(self._alloc, num_pages, num_sink_pages, num_recent_pages)
+
+    def seq_len(self, req: int) -> int:
+        return _C.kv_seq_len(self._alloc, req)
+
+    @property
+    def num_free_pages(self) -> int:
+        return _C.kv_num_free_pages(self._alloc)
+
+    @property
+    def num_free_reqs(self) -> int:
+        return _C.kv_num_free_reqs(self._alloc)
+
+
+class KvOffloadEngine:
+    """Offloads the KV cache rows of paused requests to host memory and a disk file.
+
+    offload() packs a request's rows of all caches (e.g. [k, v, k_s, v_s], all layers) into one contiguous
+    range of the host arena, demoting the least recently used entries to the mmap'd disk file when the
+    arena is full. Queue the requests that will run soon with prefetch() and call issue_prefetches() once
+    per scheduler step with the bytes the step's IO budget allows (bandwidth * step time); the disk reads
+    run in the background. restore() writes an entry back into newly allocated slots and releases it.
+    For CUDA caches the arena is pinned and the copies run on the current stream.
+    """
+
+    TIER_NONE, TIER_HOST, TIER_DISK = 0, 1, 2
+
+    def __init__(self, host_bytes: int, disk_path: str = "", disk_bytes: int = 0, pin_memory: bool = True):
+        pin_memory = pin_memory and torch.cuda.is_available()
+        # the engine only keeps a view of the arena
+        self.host_arena = torch.empty((host_bytes,), dtype=torch.uint8, pin_memory=pin_memory)
+        self._engine = _C.init_kv_offload(self.host_arena, disk_path, disk_bytes)
+
+    def __del__(self):
+        if getattr(self, "_engine", None):
+            _C.kv_offload_dispose(self._engine)
+            self._engine = None
+
+    def offload(self, key: int, caches: Sequence[torch.Tensor], slots: torch.Tensor, slot_dim: int = 0) -> bool:
+        """Pack the rows of slots under key, False if neither tier has room"""
+        slots = slots.to(device=caches[0].device, dtype=torch.int32)
+        return _C.kv_offload(self._engine, key, list(caches), slots, slot_dim)
+
+    def prefetch(self, key: int, priority: int = 0) -> None:
+        _C.kv_offload_prefetch(self._engine, key, priority)
+
+    def issue_prefetches(self, budget_bytes: int) -> List[int]:
+        return _C.kv_offload_issue_prefetches(self._engine, budget_bytes)
+
+    def ready(self, key: int) -> bool:
+        return _C.kv_offload_ready(self._engine, key)
+
+    def wait(self, key: int) -> None:
+        _C.kv_offload_wait(self._engine, key)
+
+    def restore(self, key: int, caches: Sequence[torch.Tensor], slots: torch.Tensor, slot_dim: int = 0) -> None:
+        slots = slots.to(device=caches[0].device, dtype=torch.int32)
+        _C.kv_offload_restore(self._engine, key, list(caches), slots, slot_dim)
+
+    def drop(self, key: int) -> None:
+        _C.kv_offload_drop(self._engine, key)
+
+    def tier(self, key: int) -> int:
+        return _C.kv_offload_tier(self._engine, key)
+
+    def stats(self) -> Tuple[int, int, float]:
+        """(host free bytes, disk free bytes, measured disk read bandwidth in bytes/s)"""
+        return _C.kv_offload_stats(self._engine)
@@ -1,6 +1,8 @@
 import torch
-from typing import Optional
+from concurrent.futures import Future
+from typing import Callable, Dict, Optional, Sequence, Tuple
 from . import _C
+from .cpu import CpuStream
 
 
 def grouped_topk(
@@ -29,3 +31,179 @@ def grouped_topk(
         scoring_func,
         group_scores,
     )
+
+
+def hybrid_moe_partition(
+    topk_ids: torch.Tensor, topk_weights: torch.Tensor, residency: torch.Tensor
+) -> Tuple[torch.Tensor, torch.Tensor, torch.Tensor, torch.Tensor, torch.Tensor]:
+    """Split the [T, K] routing of grouped_topk by residency ([E], device slot of every expert or -1 for
+    the experts offloaded to the CPU). Returns device_ids / device_weights ([T, K], -1 / 0 where the pair
+    went to the CPU) and cpu_offsets ([E + 1]), cpu_tokens, cpu_weights: the CPU rows grouped by expert.
+    """
+    return _C.hybrid_moe_partition(
+        topk_ids.to("cpu", torch.int32), topk_weights.to("cpu", torch.float32), residency.to("cpu", torch.int32)
+    )
+
+
+def moe_cpu_experts(
+    out: torch.Tensor,
+    x: torch.Tensor,
+    cpu_offsets: torch.Tensor,
+    cpu_tokens: torch.Tensor,
+    cpu_weights: torch.Tensor,
+    w13: Sequence[torch.Tensor],
+    w13_scales: Sequence[torch.Tensor],
+    w2: Sequence[torch.Tensor],
+    w2_scales: Sequence[torch.Tensor],
+) -> None:
+    """out ([T, H] fp32) = weighted SiLU FFNs of the CPU rows of hybrid_moe_partition on the host.
+    w13[e] is [H, 2I] (gate then up) and w2[e] [I, H], int8 or fp8 column major like the b of
+    cutlass_scaled_mm, with per channel or per tensor fp32 scales; activations are quantized per token."""
+    _C.moe_cpu_experts(
+        out, x, cpu_offsets, cpu_tokens, cpu_weights, list(w13), list(w13_scales), list(w2), list(w2_scales)
+    )
+
+
+class HybridMoeScheduler:
+    """Runs a MoE layer whose cold experts live in host memory.
+
+    Every step the routing is split by the residency map: the device experts run through device_experts
+    (e.g. the fused MoE kernel over the resident expert slots, which must skip slot -1), while the CPU
+    experts run on a CpuStream at the same time. x goes to the host with a non-blocking copy the CPU
+    work waits for, and the fp32 CPU result is added to the device output once both are done.
+    Host weights are indexed by expert id; experts that never run on the CPU may be None.
+    """
+
+    def __init__(
+        self,
+        residency: torch.Tensor,
+        w13: Sequence[Optional[torch.Tensor]],
+        w13_scales: Sequence[Optional[torch.Tensor]],
+        w2: Sequence[Optional[torch.Tensor]],
+        w2_scales: Sequence[Optional[torch.Tensor]],
+        stream: Optional[CpuStream] = None,
+    ):
+        empty = torch.empty(0)
+        self.w13 = [w if w is not None else empty for w in w13]
+        self.w13_scales = [w if w is not None else empty for w in w13_scales]
+        self.w2 = [w if w is not None else empty for w in w2]
+        self.w2_scales = [w if w is not None else empty for w in w2_scales]
+        self.stream = stream if stream is not None else CpuStream()
+        self.set_residency(residency)
+
+    def set_residency(self, residency: torch.Tensor) -> None:
+        """Device slot of every expert, -1 for the CPU ones; call it after moving experts"""
+        assert residency.numel() == len(self.w13), "residency must have one entry per expert"
+        self.residency = residency.to("cpu", torch.int32).contiguous()
+
+    def submit_cpu_experts(
+        self, x: torch.Tensor, cpu_offsets: torch.Tensor, cpu_tokens: torch.Tensor, cpu_weights: torch.Tensor
+    ) -> Future:
+        """Start the CPU experts of a partition on the stream, the future holds the [T, H] fp32 result"""
+        ready = None
+        if x.is_cuda:
+            host = torch.empty(x.shape, dtype=x.dtype, pin_memory=True)
+            host.copy_(x, non_blocking=True)
+            ready = torch.cuda.Event()
+            ready.record()
+            x = host
+
+        def run():
+            if ready is not None:
+                ready.synchronize()
+            out = torch.empty(x.shape, dtype=torch.float32, pin_memory=ready is not None)
+            moe_cpu_experts(
+                out, x, cpu_offsets, cpu_tokens, cpu_weights, self.w13, self.w13_scales, self.w2, self.w2_scales
+            )
+            return out
+
+        return self.stream.submit(run)
+
+    def forward(
+        self,
+        x: torch.Tensor,
+        topk_weights: torch.Tensor,
+        topk_ids: torch.Tensor,
+        device_experts: Callable[[torch.Tensor, torch.Tensor, torch.Tensor], torch.Tensor],
+    ) -> torch.Tensor:
+        """x [T, H], topk_* [T, K] from grouped_topk. device_experts(x, device_ids, device_weights) returns
+        the weighted sum of the resident experts; it is not called when every pair went to the CPU."""
+        device_ids, device_weights, cpu_offsets, cpu_tokens, cpu_weights = hybrid_moe_partition(
+            topk_ids, topk_weights, self.residency
+        )
+        future = None
+        if cpu_tokens.numel() > 0:
+            future = self.submit_cpu_experts(x, cpu_offsets, cpu_tokens, cpu_weights)
+        if cpu_tokens.numel() < topk_ids.numel():
+            y = device_experts(
+                x,
+                device_ids.to(x.device, non_blocking=True),
+                device_weights.to(device=x.device, dtype=topk_weights.dtype, non_blocking=True),
+            )
+        else:
+            y = torch.zeros_like(x)
+        if future is not None:
+            y = y + future.result().to(device=y.device, dtype=y.dtype, non_blocking=True)
+        return y
+
+
+class ExpertCache:
+    """Keeps the hot MoE experts of all layers in a fixed pool of fast memory, see core::ExpertCache.
+
+    host_weights is [L, E, B] uint8 with every expert packed into one blob of B bytes (weights and
+    scales), pool [S, B] uint8 on the device (or the host, e.g. to replay routing traces). Call access()
+    once per MoE layer with its routing: it copies the missing experts in, evicting the least recently
+    (LRU) or frequently (LFU) used ones, returns the residency map for hybrid_moe_partition /
+    HybridMoeScheduler.set_residency and prefetches the experts the next layer is predicted to route to
+    (learned layer to layer transitions weighted by the gating scores). Copies into a CUDA pool run on
+    the stream current at construction, create the cache under a side stream to overlap them.
+    """
+
+    LRU, LFU = 0, 1
+
+    def __init__(
+        self,
+        host_weights: torch.Tensor,
+        pool: torch.Tensor,
+        eviction: int = LRU,
+        prefetch_per_layer: int = 4,
+        fetch_misses: bool = True,
+        decay: float = 0.9,
+    ):
+        # the cache only keeps views of both
+        self.host_weights = host_weights
+        self.pool = pool
+        self._cache = _C.init_expert_cache(host_weights, pool, eviction, prefetch_per_layer, fetch_misses, decay)
+
+    def __del__(self):
+        if getattr(self, "_cache", None):
+            _C.expert_cache_dispose(self._cache)
+            self._cache = None
+
+    def access(self, layer: int, topk_ids: torch.Tensor, topk_weights: torch.Tensor) -> torch.Tensor:
+        """[E] int32 pool slot of every expert of layer, -1 for the ones that are not resident"""
+        return _C.expert_cache_access(self._cache, layer, topk_ids.cpu(), topk_weights.cpu())
+
+    def prefetch(self, layer: int, experts: Sequence[int]) -> int:
+        """Start copying experts of layer in, returns the number of copies started"""
+        return _C.expert_cache_prefetch(self._cache, layer, list(experts))
+
+    def slot(self, layer: int, expert: int) -> int:
+        return _C.expert_cache_slot(self._cache, layer, expert)
+
+    def synchronize(self) -> None:
+        _C.expert_cache_synchronize(self._cache)
+
+    def stats(self) -> Dict[str, float]:
+        """Counters since the last reset_stats(), with the derived hit_rate and prefetch_accuracy"""
+        names = (
+            "hits", "misses", "late_prefetches", "prefetches", "useful_prefetches", "evictions", "bytes_copied",
+            "stall_seconds",
+        )
+        stats = dict(zip(names, _C.expert_cache_stats(self._cache)))
+        stats["hit_rate"] = stats["hits"] / max(stats["hits"] + stats["misses"], 1)
+        stats["prefetch_accuracy"] = stats["useful_prefetches"] / max(stats["prefetches"], 1)
+        return stats
+
+    def reset_stats(self) -> None:
+        _C.expert_cache_reset_stats(self._cache)
@@ -1,7 +1,46 @@
 import torch
-from typing import Optional
+from typing import Optional, Sequence
 from . import _C
+from .core import dtype_code, device_index, stream_handle
 
 
 def rmsnorm_bf16(X: torch.Tensor, W: torch.Tensor, eps: float = 1e-12) -> torch.Tensor:
     return _C.rmsnorm_align16_bf16(X, W, eps)
+
+
+class RmsNormPlan:
+    """RMSNorm over the last dim with all validation and kernel selection done once.
+
+    The plan is bound to the row layout (N, dtype, device) it was made for, X of any number of rows
+    runs on it, and to the stream that is current when it is made, so make it inside the stream / graph
+    capture context it runs in. run() does no checks at all.
+    """
+
+    def __init__(
+        self,
+        shape: Sequence[int],
+        dtype: torch.dtype,
+        strides: Optional[Sequence[int]] = None,
+        device: torch.device = "cuda",
+        eps: float = 1e-12,
+    ):
+        self.shape = tuple(shape)
+        self._plan = _C.make_rmsnorm_plan(
+            list(shape), dtype_code(dtype), list(strides or []), device_index(device), eps
+        )
+        self._stream = stream_handle(device)
+
+    def run(self, X: torch.Tensor, W: torch.Tensor, Y: torch.Tensor) -> torch.Tensor:
+        rows = X.shape[:-1].numel()
+        _C.rmsnorm_plan_run(self._plan, X.data_ptr(), W.data_ptr(), Y.data_ptr(), rows, self._stream)
+        return Y
+
+
+def make_rmsnorm_plan(
+    shape: Sequence[int],
+    dtype: torch.dtype,
+    strides: Optional[Sequence[int]] = None,
+    device: torch.device = "cuda",
+    eps: float = 1e-12,
+) -> RmsNormPlan:
+    return RmsNormPlan(shape, dtype, strides, device, eps)
@@ -1,5 +1,5 @@
 import torch
-from typing import Optional, Tuple
+from typing import Callable, Dict, List, Optional, Sequence, Tuple, Union
 from . import _C
 
 
@@ -16,3 +16,107 @@ def per_token_quant_bf16_int8(input: torch.tensor) -> Tuple[torch.Tensor, torch.
     scales = torch.empty(size=(input.shape[0], 1), device=input.device, dtype=torch.float32)
     _C.per_token_quant_bf16_int8(output, input, scales)
     return output, scales
+
+
+class SafetensorsFile:
+    """Read-only mmap of a safetensors shard; only the header is read when it is opened"""
+
+    def __init__(self, path: str):
+        self.path = path
+        self._file = _C.init_safetensors(path)
+        self.entries = {name: (dtype, tuple(shape)) for name, dtype, shape in _C.safetensors_entries(self._file)}
+
+    def __del__(self):
+        if getattr(self, "_file", None):
+            _C.safetensors_dispose(self._file)
+            self._file = None
+
+    def __contains__(self, name: str) -> bool:
+        return name in self.entries
+
+    def keys(self) -> List[str]:
+        """Tensor names in file order"""
+        return list(self.entries)
+
+    def metadata(self) -> Dict[str, str]:
+        return _C.safetensors_metadata(self._file)
+
+    def get_tensor(self, name: str) -> torch.Tensor:
+        """Host copy of a tensor"""
+        return _C.safetensors_tensor(self._file, name)
+
+
+def quantize_weight_per_channel(
+    w: torch.Tensor, dtype: torch.dtype = torch.float8_e4m3fn
+) -> Tuple[torch.Tensor, torch.Tensor]:
+    """[N, K] weight -> (q [K, N] column major, scales [N, 1] fp32), the b / b_scales of cutlass_scaled_mm"""
+    q = torch.empty((w.shape[0], w.shape[1]), dtype=dtype).t()
+    scales = torch.empty((w.shape[0], 1), dtype=torch.float32)
+    _C.quantize_weight_per_channel(w.contiguous(), q, scales)
+    return q, scales
+
+
+def _quantizable(name: str, dtype: str, shape: Tuple[int, ...]) -> bool:
+    return len(shape) == 2 and dtype in ("BF16", "F16", "F32") and name.endswith(".weight")
+
+
+def load_quantized_weights(
+    paths: Sequence[str],
+    quantize: Callable[[str, str, Tuple[int, ...]], bool] = _quantizable,
+    dtype: torch.dtype = torch.float8_e4m3fn,
+    device: Union[str, torch.device] = "cpu",
+    io_threads: int = 4,
+    readahead_bytes: int = 1 << 30,
+) -> Tuple[Dict[str, Union[torch.Tensor, Tuple[torch.Tensor, torch.Tensor]]], Dict[str, float]]:
+    """Load safetensors shards, quantizing the weights on the way.
+
+    Every tensor for which quantize(name, safetensors dtype, shape) holds (by default the 2D bf16 / fp16 / fp32
+    "*.weight" ones; exclude the embeddings and lm_head as needed) becomes (q [K, N] column major, scales
+    [N, 1] fp32) of dtype (fp8_e4m3fn or int8) for cutlass_scaled_mm; the others are returned as they are.
+    The shards are mmap'd, IO threads fault their pages in ahead of the quantization, which runs on the CPU
+    kernel threads, and for a CUDA device every weight is uploaded from a pinned buffer on a side stream
+    while the next ones quantize (at most two shards of pinned buffers are alive). Returns the tensors by
+    name and the pipeline stats (bytes_read, bytes_written, seconds, read_wait_seconds, GB/s)."""
+    device = torch.device(device)
+    cuda = device.type == "cuda"
+    stream = torch.cuda.Stream(device) if cuda else None
+    tensors = {}
+    stats = {"bytes_read": 0, "bytes_written": 0, "seconds": 0.0, "read_wait_seconds": 0.0}
+    uploads = None  # event of the previous shard's uploads and its pinned buffers
+    for path in paths:
+        f = SafetensorsFile(path)
+        names, qs, scales = [], [], []
+        for name, (st_dtype, shape) in f.entries.items():
+            if not quantize(name, st_dtype, shape):
+                tensors[name] = f.get_tensor(name).to(device)
+                continue
+            n, k = shape
+            names.append(name)
+            qs.append(torch.empty((n, k), dtype=dtype, pin_memory=cuda).t())
+            scales.append(torch.empty((n, 1), dtype=torch.float32, pin_memory=cuda))
+
+        def upload(i):
+            with torch.cuda.stream(stream):
+                tensors[names[i]] = (
+                    qs[i].to(device, non_blocking=True),
+                    scales[i].to(device, non_blocking=True),
+                )
+
+        result = _C.quantize_weights(
+            [f._file] * len(names), names, qs, scales, io_threads, readahead_bytes, upload if cuda else None
+        )
+        for key, value in zip(("bytes_read", "bytes_written", "seconds", "read_wait_seconds"), result):
+            stats[key] += value
+        if cuda:
+            if uploads is not None:
+                uploads[0].synchronize()
+            event = torch.cuda.Event()
+            event.record(stream)
+            uploads = (event, qs, scales)
+        else:
+            tensors.update({name: (q, s) for name, q, s in zip(names, qs, scales)})
+    if cuda:
+        stream.synchronize()
+        torch.cuda.current_stream(device).wait_stream(stream)
+    stats["GB/s"] = stats["bytes_read"] / max(stats["seconds"], 1e-9) / 1e9
+    return tensors, stats
@@ -0,0 +1,49 @@
+import torch
+from typing import Tuple
+from . import _C
+
+
+def logprobs_topn_partial(
+    logits: torch.Tensor, sampled_ids: torch.Tensor, topn: int, vocab_start: int = 0, normalize: bool = False
+) -> Tuple[torch.Tensor, torch.Tensor, torch.Tensor, torch.Tensor]:
+    """Single pass log-softmax statistics and top-n logits over one vocab shard.
+
+    Returns (topn_vals [B, topn], topn_ids [B, topn], sampled_vals [B], stats [B, 2]), where stats holds
+    the (max, sum of exp) of the shard. With normalize=True the values are already logprobs, which is
+    only meaningful when the shard covers the whole vocabulary.
+    """
+    B = logits.shape[0]
+    topn_vals = torch.empty((B, topn), device=logits.device, dtype=torch.float32)
+    topn_ids = torch.empty((B, topn), device=logits.device, dtype=torch.int64)
+    sampled_vals = torch.empty((B,), device=logits.device, dtype=torch.float32)
+    stats = torch.empty((B, 2), device=logits.device, dtype=torch.float32)
+    _C.logprobs_topn_partial(topn_vals, topn_ids, sampled_vals, stats, logits, sampled_ids, vocab_start, normalize)
+    return topn_vals, topn_ids, sampled_vals, stats
+
+
+def logprobs_topn_merge(
+    topn_vals: torch.Tensor, topn_ids: torch.Tensor, sampled_vals: torch.Tensor, stats: torch.Tensor
+) -> Tuple[torch.Tensor, torch.Tensor, torch.Tensor]:
+    """Merge the gathered partial results of all vocab shards ([S, B, ...]) into final logprobs"""
+    S, B, topn = topn_vals.shape
+    out_logprobs = torch.empty((B, topn), device=stats.device, dtype=torch.float32)
+    out_ids = torch.empty((B, topn), device=stats.device, dtype=torch.int64)
+    out_sampled = torch.empty((B,), device=stats.device, dtype=torch.float32)
+    _C.logprobs_topn_merge(
+        out_logprobs,
+        out_ids,
+        out_sampled,
+        stats.contiguous(),
+        topn_vals.contiguous(),
+        topn_ids.contiguous(),
+        sampled_vals.contiguous(),
+    )
+    return out_logprobs, out_ids, out_sampled
+
+
+def logprobs_topn(
+    logits: torch.Tensor, sampled_ids: torch.Tensor, topn: int
+) -> Tuple[torch.Tensor, torch.Tensor, torch.Tensor]:
+    """Top-n logprobs and the logprob of the sampled token, without materializing log_softmax(logits)"""
+    topn_vals, topn_ids, sampled_vals, _ = logprobs_topn_partial(logits, sampled_ids, topn, 0, True)
+    return topn_vals, topn_ids, sampled_vals
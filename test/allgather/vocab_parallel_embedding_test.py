@@ -0,0 +1,125 @@
+import unittest
+import torch
+import torch.multiprocessing as mp
+from lightllm_kernel.ops import (
+    all_gather,
+    init_shm_gather,
+    shm_gather_dispose,
+    shm_gather_register_buffer,
+    shm_meta_size,
+    vocab_parallel_embedding,
+)
+from test.utils import error
+
+
+def torch_vocab_parallel_embedding(ids, weight):
+    mask = (ids >= 0) & (ids < weight.shape[0])
+    out = torch.nn.functional.embedding(ids.clamp(0, weight.shape[0] - 1), weight)
+    return out * mask.unsqueeze(-1).to(weight.dtype)
+
+
+def run_rank(rank, world_size, signals, buffers, ids, weight, vocab_per_rank, results):
+    fa = init_shm_gather([s.data_ptr() for s in signals], rank)
+    shm_gather_register_buffer(fa, [b.data_ptr() for b in buffers])
+    shard = weight[rank * vocab_per_rank : (rank + 1) * vocab_per_rank].contiguous()
+    buffer_bytes = buffers[rank].numel() * buffers[rank].element_size()
+    # run twice to check the buffers can be reused back to back
+    for _ in range(2):
+        out = vocab_parallel_embedding(fa, ids, shard, vocab_per_rank, buffers[rank].data_ptr(), buffer_bytes)
+    results[rank].copy_(out)
+    shm_gather_dispose(fa)
+
+
+def run_rank_then_gather(rank, world_size, signals, buffers, ids, weight, vocab_per_rank, expected, ok):
+    fa = init_shm_gather([s.data_ptr() for s in signals], rank)
+    shm_gather_register_buffer(fa, [b.data_ptr() for b in buffers])
+    shard = weight[rank * vocab_per_rank : (rank + 1) * vocab_per_rank].contiguous()
+    buffer_bytes = buffers[rank].numel() * buffers[rank].element_size()
+    gathered = torch.empty((world_size,) + buffers[rank].shape, dtype=weight.dtype)
+    # an all_gather right after the embedding overwrites the buffer the peers read rows from
+    for step in range(8):
+        out = vocab_parallel_embedding(fa, ids, shard, vocab_per_rank, buffers[rank].data_ptr(), buffer_bytes)
+        inp = torch.full(buffers[rank].shape, rank + world_size * step, dtype=weight.dtype)
+        all_gather(fa, inp, gathered, buffers[rank].data_ptr(), buffer_bytes)
+        ranks = torch.arange(world_size, dtype=weight.dtype).view(-1, 1, 1) + world_size * step
+        if not torch.equal(out, expected) or not torch.equal(gathered, ranks.expand_as(gathered)):
+            ok[rank] = False
+    shm_gather_dispose(fa)
+
+
+class TestVocabParallelEmbedding(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.world_sizes = [2, 4]
+        self.tokens = [1, 37, 1024]
+        self.vocab = 1003
+        self.hidden = 256
+        self.dtypes = [torch.bfloat16, torch.float32]
+
+    def test_accuracy_cpu(self):
+        """Test the shared memory transport path against a full embedding lookup."""
+        ctx = mp.get_context("fork")
+        for world_size in self.world_sizes:
+            for num_tokens in self.tokens:
+                for dtype in self.dtypes:
+                    with self.subTest(world_size=world_size, tokens=num_tokens, dtype=dtype):
+                        vocab_per_rank = (self.vocab + world_size - 1) // world_size
+                        weight = torch.randn(size=[self.vocab, self.hidden], dtype=dtype)
+                        # include padding ids that no rank owns
+                        ids = torch.randint(-1, self.vocab + 8, (num_tokens,), dtype=torch.int64)
+                        signals = [torch.zeros(shm_meta_size(), dtype=torch.uint8).share_memory_() for _ in range(world_size)]
+                        buffers = [torch.empty((num_tokens, self.hidden), dtype=dtype).share_memory_() for _ in range(world_size)]
+                        results = [torch.empty((num_tokens, self.hidden), dtype=dtype).share_memory_() for _ in range(world_size)]
+
+                        procs = [
+                            ctx.Process(
+                                target=run_rank,
+                                args=(r, world_size, signals, buffers, ids, weight, vocab_per_rank, results),
+                            )
+                            for r in range(world_size)
+                        ]
+                        for p in procs:
+                            p.start()
+                        for p in procs:
+                            p.join()
+                            self.assertEqual(p.exitcode, 0)
+
+                        y_real = torch_vocab_parallel_embedding(ids, weight)
+                        for r in range(world_size):
+                            self.assertTrue(
+                                error(results[r], y_real) < 1e-6,
+                                f"Accuracy test failed on rank {r}. y_real={y_real}, y_pred={results[r]}",
+                            )
+
+
+    def test_then_all_gather_cpu(self):
+        """Test an all_gather on the registered buffer right after an embedding on it."""
+        ctx = mp.get_context("fork")
+        num_tokens, dtype = 1024, torch.float32
+        for world_size in self.world_sizes:
+            with self.subTest(world_size=world_size):
+                vocab_per_rank = (self.vocab + world_size - 1) // world_size
+                weight = torch.randn(size=[self.vocab, self.hidden], dtype=dtype)
+                ids = torch.randint(0, self.vocab, (num_tokens,), dtype=torch.int64)
+                expected = torch_vocab_parallel_embedding(ids, weight)
+                signals = [torch.zeros(shm_meta_size(), dtype=torch.uint8).share_memory_() for _ in range(world_size)]
+                buffers = [torch.empty((num_tokens, self.hidden), dtype=dtype).share_memory_() for _ in range(world_size)]
+                ok = torch.ones(world_size, dtype=torch.bool).share_memory_()
+
+                procs = [
+                    ctx.Process(
+                        target=run_rank_then_gather,
+                        args=(r, world_size, signals, buffers, ids, weight, vocab_per_rank, expected, ok),
+                    )
+                    for r in range(world_size)
+                ]
+                for p in procs:
+                    p.start()
+                for p in procs:
+                    p.join()
+                    self.assertEqual(p.exitcode, 0)
+                self.assertTrue(bool(ok.all()), f"Ranks {(~ok).nonzero().flatten().tolist()} read overwritten rows.")
+
+
+if __name__ == "__main__":
+    unittest.main()
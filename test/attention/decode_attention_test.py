@@ -0,0 +1,93 @@
+import unittest
+import torch
+from lightllm_kernel.ops import decode_attention, flashdecoding_combine, flashdecoding_stage1, group_int8kv_decode_attention
+from test.utils import available_devices, benchmark, error, make_decode_inputs, torch_decode_attention
+
+
+class TestDecodeAttention(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.seq_lens = [[1], [256], [17, 1000, 333]]
+        self.head_dims = [64, 80, 128]
+        self.heads = [(8, 8), (32, 4)]
+        self.kv_formats = ["half", "fp8", "int8"]
+        self.devices = available_devices()
+        self.dtypes = [torch.bfloat16, torch.float16]
+        self.seq_block_size = 256
+
+    def test_accuracy(self):
+        """Test decode_attention against torch for every KV cache format."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for kv_format in self.kv_formats:
+                    for seq_lens in self.seq_lens:
+                        for head_dim in self.head_dims:
+                            for heads, kv_heads in self.heads:
+                                shape = [seq_lens, heads, kv_heads, head_dim, kv_format]
+                                with self.subTest(shape=shape, device=device, dtype=dtype):
+                                    args = make_decode_inputs(
+                                        seq_lens, heads, kv_heads, head_dim, device, dtype, kv_format
+                                    )
+                                    q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len = args
+                                    real = torch_decode_attention(*args)
+                                    o = torch.empty_like(q)
+                                    decode_attention(
+                                        o, q, k, v, req_to_tokens, b_req_idx, b_seq_len, max(seq_lens), k_s=k_s, v_s=v_s
+                                    )
+                                    self.assertTrue(error(o, real) < 1e-4, f"Accuracy test failed for size {shape}.")
+
+    def test_int8_matches(self):
+        """With an int8 cache decode_attention is group_int8kv_decode_attention."""
+        for device in self.devices:
+            with self.subTest(device=device):
+                seq_lens = [17, 1000, 333]
+                q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len = make_decode_inputs(
+                    seq_lens, 32, 8, 128, device, torch.bfloat16, "int8"
+                )
+                o, real = torch.empty_like(q), torch.empty_like(q)
+                decode_attention(o, q, k, v, req_to_tokens, b_req_idx, b_seq_len, 1000, k_s=k_s, v_s=v_s)
+                group_int8kv_decode_attention(real, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, 1000)
+                self.assertTrue(error(o, real) < 1e-5)
+
+    def test_stage1(self):
+        """Test flash decoding stage1 + combine against decode_attention for every KV cache format."""
+        seq_lens, heads, kv_heads = [17, 3000, 333], 32, 8
+        for device in self.devices:
+            for kv_format in self.kv_formats:
+                for head_dim in self.head_dims:
+                    with self.subTest(device=device, kv_format=kv_format, head_dim=head_dim):
+                        q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len = make_decode_inputs(
+                            seq_lens, heads, kv_heads, head_dim, device, torch.bfloat16, kv_format
+                        )
+                        B, max_len = len(seq_lens), max(seq_lens)
+                        blocks = (max_len + self.seq_block_size - 1) // self.seq_block_size
+                        mid_o_emb = torch.empty((B, heads, blocks, head_dim), dtype=q.dtype, device=device)
+                        mid_o_logexpsum = torch.empty((B, heads, blocks), dtype=q.dtype, device=device)
+                        flashdecoding_stage1(
+                            self.seq_block_size, mid_o_emb, mid_o_logexpsum, head_dim**-0.5,
+                            q, k, v, req_to_tokens, b_req_idx, b_seq_len, max_len, k_s=k_s, v_s=v_s,
+                        )
+                        o = torch.empty_like(q)
+                        flashdecoding_combine(o, mid_o_emb, mid_o_logexpsum, b_seq_len, self.seq_block_size)
+                        real = torch_decode_attention(q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len)
+                        self.assertTrue(error(o, real) < 1e-4)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test decode attention over a bf16 cache against the fp8 and int8 caches of the same shape."""
+        seq_lens, heads, kv_heads, head_dim = [4096] * 32, 32, 8, 128
+        for kv_format in self.kv_formats:
+            q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len = make_decode_inputs(
+                seq_lens, heads, kv_heads, head_dim, "cuda", torch.bfloat16, kv_format
+            )
+            o = torch.empty_like(q)
+            shape = [list(q.shape), seq_lens[:1], kv_format]
+            tflops = 4 * len(seq_lens) * heads * head_dim * max(seq_lens) / 1e12
+            benchmark(
+                decode_attention, shape, tflops, 100,
+                o, q, k, v, req_to_tokens, b_req_idx, b_seq_len, max(seq_lens), k_s, v_s,
+            )
+
+
+if __name__ == "__main__":
+    unittest.main()
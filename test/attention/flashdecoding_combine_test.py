@@ -0,0 +1,106 @@
+import unittest
+import torch
+from lightllm_kernel.ops import (
+    flashdecoding_combine,
+    group8_int8kv_flashdecoding_stage1,
+    group_int8kv_decode_attention,
+    per_token_quant_bf16_fp8,
+)
+from test.utils import available_devices, benchmark, error, make_decode_inputs
+
+
+def torch_flashdecoding_combine(mid_o_emb, mid_o_logexpsum, b_seq_len, seq_block_size):
+    B, H, _, D = mid_o_emb.shape
+    out = torch.empty((B, H, D), dtype=mid_o_emb.dtype, device=mid_o_emb.device)
+    for b in range(B):
+        n = (int(b_seq_len[b]) + seq_block_size - 1) // seq_block_size
+        w = mid_o_logexpsum[b, :, :n].float().softmax(-1)  # [H, n]
+        out[b] = torch.einsum("hs,hsd->hd", w, mid_o_emb[b, :, :n].float()).to(out.dtype)
+    return out
+
+
+class TestFlashDecodingCombine(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.seq_lens = [[1], [256], [17, 1000, 333]]
+        self.seq_block_size = 256
+        self.heads = [8, 32]
+        self.head_dims = [64, 128]
+        self.devices = available_devices()
+        self.dtypes = [torch.bfloat16, torch.float16]
+
+    def make_inputs(self, seq_lens, heads, head_dim, device, dtype):
+        B = len(seq_lens)
+        blocks = (max(seq_lens) + self.seq_block_size - 1) // self.seq_block_size
+        mid_o_emb = torch.randn((B, heads, blocks, head_dim), dtype=dtype, device=device)
+        mid_o_logexpsum = (torch.randn((B, heads, blocks), device=device) * 3).to(dtype)
+        b_seq_len = torch.tensor(seq_lens, dtype=torch.int32, device=device)
+        return mid_o_emb, mid_o_logexpsum, b_seq_len
+
+    def test_accuracy(self):
+        """Test flashdecoding_combine against torch, with the output in the mid dtype and in fp8."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for seq_lens in self.seq_lens:
+                    for heads in self.heads:
+                        for head_dim in self.head_dims:
+                            shape = [seq_lens, heads, head_dim]
+                            with self.subTest(shape=shape, device=device, dtype=dtype):
+                                args = self.make_inputs(seq_lens, heads, head_dim, device, dtype)
+                                real = torch_flashdecoding_combine(*args, self.seq_block_size)
+                                o = torch.empty_like(real)
+                                flashdecoding_combine(o, *args, self.seq_block_size)
+                                self.assertTrue(error(o, real) < 1e-4, f"Accuracy test failed for size {shape}.")
+
+                                o8 = torch.empty_like(real, dtype=torch.float8_e4m3fn)
+                                o_scale = torch.empty((len(seq_lens), 1), dtype=torch.float32, device=device)
+                                flashdecoding_combine(o8, *args, self.seq_block_size, o_scale=o_scale)
+                                real_scale = real.float().flatten(1).abs().amax(-1, keepdim=True) / 448
+                                torch.testing.assert_close(o_scale, real_scale, rtol=1e-2, atol=0)
+                                self.assertTrue(error(o8.float() * o_scale.unsqueeze(-1), real) < 2e-3)
+
+    def test_stage1(self):
+        """Test stage1 + combine against the single pass decode attention, for every head size."""
+        seq_lens, heads, kv_heads = [17, 1000, 333], 32, 8
+        # exact and padded (80, 112, 192, 576) head sizes on CUDA
+        for device in self.devices:
+            for head_dim in [64, 80, 112, 128, 192, 256, 576]:
+                with self.subTest(device=device, head_dim=head_dim):
+                    q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len = make_decode_inputs(
+                        seq_lens, heads, kv_heads, head_dim, device, torch.bfloat16
+                    )
+                    B, max_len = len(seq_lens), max(seq_lens)
+                    blocks = (max_len + self.seq_block_size - 1) // self.seq_block_size
+                    mid_o_emb = torch.empty((B, heads, blocks, head_dim), dtype=q.dtype, device=device)
+                    mid_o_logexpsum = torch.empty((B, heads, blocks), dtype=q.dtype, device=device)
+                    group8_int8kv_flashdecoding_stage1(
+                        self.seq_block_size, mid_o_emb, mid_o_logexpsum, head_dim**-0.5,
+                        q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, max_len,
+                    )
+                    o = torch.empty_like(q)
+                    flashdecoding_combine(o, mid_o_emb, mid_o_logexpsum, b_seq_len, self.seq_block_size)
+                    real = torch.empty_like(q)
+                    group_int8kv_decode_attention(real, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, max_len)
+                    self.assertTrue(error(o, real) < 1e-4)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test the performance of the fp8 combine against the bf16 combine followed by per_token_quant_bf16_fp8."""
+        B, heads, head_dim = 64, 32, 128
+        args = self.make_inputs([8192] * B, heads, head_dim, "cuda", torch.bfloat16)
+        o = torch.empty((B, heads, head_dim), dtype=torch.bfloat16, device="cuda")
+        o8 = torch.empty_like(o, dtype=torch.float8_e4m3fn)
+        o_scale = torch.empty((B, 1), dtype=torch.float32, device="cuda")
+
+        def separate_quant():
+            flashdecoding_combine(o, *args, self.seq_block_size)
+            return per_token_quant_bf16_fp8(o.view(B, -1))
+
+        shape = [list(args[0].shape), [B, heads, head_dim]]
+        tflops = 2 * args[0].numel() / 1e12
+        benchmark(flashdecoding_combine, shape, tflops, 100, o8, *args, self.seq_block_size, o_scale)
+        benchmark(separate_quant, shape, tflops, 100)
+
+
+if __name__ == "__main__":
+    unittest.main()
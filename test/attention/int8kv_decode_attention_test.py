@@ -0,0 +1,137 @@
+import unittest
+import torch
+from lightllm_kernel.ops import (
+    decode_attention_workspace_bytes,
+    group_int8kv_decode_attention,
+    per_token_quant_bf16_fp8,
+)
+from test.utils import available_devices, benchmark, dequantize, error, make_decode_inputs, torch_decode_attention
+
+
+class TestInt8KvDecodeAttention(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.seq_lens = [[1], [256], [17, 1000, 333]]
+        # 80, 112, 192 and 576 run the padded CUDA kernels
+        self.head_dims = [64, 80, 112, 128, 192, 256, 576]
+        self.heads = [(8, 8), (32, 4)]
+        self.devices = available_devices()
+        self.dtypes = [torch.bfloat16, torch.float16]
+
+    def test_accuracy(self):
+        """Compare the float and int8 QK paths against an fp32 reference, and report both errors."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for seq_lens in self.seq_lens:
+                    for head_dim in self.head_dims:
+                        for heads, kv_heads in self.heads:
+                            shape = [seq_lens, heads, kv_heads, head_dim]
+                            with self.subTest(shape=shape, device=device, dtype=dtype):
+                                args = make_decode_inputs(seq_lens, heads, kv_heads, head_dim, device, dtype)
+                                real = torch_decode_attention(*args)
+                                errs = []
+                                for int8_qk in [False, True]:
+                                    o = torch.empty_like(args[0])
+                                    group_int8kv_decode_attention(o, *args, max(seq_lens), int8_qk=int8_qk)
+                                    errs.append(error(o, real))
+                                print(f"{device} {dtype} {shape}: float qk {errs[0]:.2e}, int8 qk {errs[1]:.2e}")
+                                self.assertTrue(errs[0] < 1e-4, f"Accuracy test failed for size {shape}.")
+                                self.assertTrue(errs[1] < 1e-3, f"Int8 qk accuracy test failed for size {shape}.")
+
+    def test_fp8_output(self):
+        """Test the fp8 output with per token scales against the bf16 output quantized by per_token_quant_bf16_fp8."""
+        for device in self.devices:
+            for int8_qk in [False, True]:
+                with self.subTest(device=device, int8_qk=int8_qk):
+                    seq_lens, heads, kv_heads, head_dim = [17, 1000, 333], 32, 4, 128
+                    args = make_decode_inputs(seq_lens, heads, kv_heads, head_dim, device, torch.bfloat16)
+                    o = torch.empty_like(args[0])
+                    group_int8kv_decode_attention(o, *args, max(seq_lens), int8_qk=int8_qk)
+                    o8 = torch.empty_like(o, dtype=torch.float8_e4m3fn)
+                    o_scale = torch.empty((o.shape[0], 1), dtype=torch.float32, device=device)
+                    # twice, the CUDA workspace must be left reusable
+                    for _ in range(2):
+                        group_int8kv_decode_attention(o8, *args, max(seq_lens), int8_qk=int8_qk, o_scale=o_scale)
+                        real_scale = o.float().flatten(1).abs().amax(-1, keepdim=True) / 448
+                        torch.testing.assert_close(o_scale, real_scale, rtol=1e-2, atol=0)
+                        self.assertTrue(error(o8.float() * o_scale.unsqueeze(-1), o) < 2e-3)
+                    if device == "cuda":
+                        ref8, ref_scale = per_token_quant_bf16_fp8(o.flatten(1))
+                        ref = ref8.float().view_as(o) * ref_scale.unsqueeze(-1)
+                        self.assertTrue(error(o8.float() * o_scale.unsqueeze(-1), ref) < 2e-3)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_fp8_output_streams(self):
+        """Test fp8 outputs on two streams at once, and with a workspace of the caller, on CUDA."""
+        seq_lens, heads, kv_heads, head_dim = [17, 1000, 333], 32, 4, 128
+        args = make_decode_inputs(seq_lens, heads, kv_heads, head_dim, "cuda", torch.bfloat16)
+        o = torch.empty_like(args[0])
+        group_int8kv_decode_attention(o, *args, max(seq_lens))
+        real_scale = o.float().flatten(1).abs().amax(-1, keepdim=True) / 448
+        streams = [torch.cuda.Stream(), torch.cuda.Stream()]
+        outs = [torch.empty_like(o, dtype=torch.float8_e4m3fn) for _ in streams]
+        scales = [torch.empty((o.shape[0], 1), dtype=torch.float32, device="cuda") for _ in streams]
+        torch.cuda.synchronize()
+        for _ in range(20):
+            for s, o8, o_scale in zip(streams, outs, scales):
+                with torch.cuda.stream(s):
+                    group_int8kv_decode_attention(o8, *args, max(seq_lens), o_scale=o_scale)
+        torch.cuda.synchronize()
+        for o8, o_scale in zip(outs, scales):
+            torch.testing.assert_close(o_scale, real_scale, rtol=1e-2, atol=0)
+            self.assertTrue(error(o8.float() * o_scale.unsqueeze(-1), o) < 2e-3)
+
+        nbytes = decode_attention_workspace_bytes(*o.shape)
+        workspace = torch.zeros(nbytes, dtype=torch.uint8, device="cuda")
+        group_int8kv_decode_attention(outs[0], *args, max(seq_lens), o_scale=scales[0], workspace=workspace)
+        self.assertTrue(error(outs[0].float() * scales[0].unsqueeze(-1), o) < 2e-3)
+        # the launch leaves the workspace zeroed for the next one
+        self.assertEqual(int(workspace.count_nonzero()), 0)
+
+    def test_attn_mass(self):
+        """Test that attn_mass accumulates the softmax probabilities summed over each GQA group."""
+        for device in self.devices:
+            with self.subTest(device=device):
+                seq_lens, heads, kv_heads, head_dim = [17, 300, 133], 32, 4, 128
+                q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len = make_decode_inputs(
+                    seq_lens, heads, kv_heads, head_dim, device, torch.bfloat16
+                )
+                attn_mass = torch.zeros((len(seq_lens), kv_heads, max(seq_lens)), dtype=torch.float32, device=device)
+                o = torch.empty_like(q)
+                for _ in range(2):
+                    group_int8kv_decode_attention(o, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len,
+                                                  max(seq_lens), attn_mass=attn_mass)
+                k_f = dequantize(k, k_s)
+                for b in range(len(seq_lens)):
+                    L, req = b_seq_len[b].item(), b_req_idx[b].item()
+                    ks = k_f[req_to_tokens[req, :L].long()].repeat_interleave(heads // kv_heads, dim=1)
+                    att = torch.einsum("hd,lhd->hl", q[b].float(), ks) / head_dim**0.5
+                    real = 2 * att.softmax(-1).view(kv_heads, -1, L).sum(1)
+                    torch.testing.assert_close(attn_mass[req, :, :L], real, rtol=1e-3, atol=1e-5)
+                    self.assertTrue(bool((attn_mass[req, :, L:] == 0).all()))
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test the performance of the float and int8 QK paths."""
+        B, heads, kv_heads, head_dim, seq_len = 64, 32, 8, 128, 4096
+        args = make_decode_inputs([seq_len] * B, heads, kv_heads, head_dim, "cuda", torch.bfloat16)
+        o = torch.empty_like(args[0])
+        shape = [[B, heads, head_dim], [B * seq_len, kv_heads, head_dim]]
+        tflops = 4 * B * heads * seq_len * head_dim / 1e12
+        for int8_qk in [False, True]:
+            benchmark(group_int8kv_decode_attention, shape, tflops, 100, o, *args, seq_len, int8_qk)
+
+        # fp8 output for o_proj: fused, against the bf16 output followed by per_token_quant_bf16_fp8
+        o8 = torch.empty_like(o, dtype=torch.float8_e4m3fn)
+        o_scale = torch.empty((B, 1), dtype=torch.float32, device="cuda")
+
+        def separate_quant():
+            group_int8kv_decode_attention(o, *args, seq_len)
+            return per_token_quant_bf16_fp8(o.view(B, -1))
+
+        benchmark(group_int8kv_decode_attention, shape, tflops, 100, o8, *args, seq_len, False, o_scale)
+        benchmark(separate_quant, shape, tflops, 100)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,138 @@
+import unittest
+import torch
+from lightllm_kernel.ops import group_int8kv_decode_attention, mixed_int8kv_attention, plan_mixed_attention
+from test.utils import available_devices, benchmark, dequantize, error, make_kv_cache
+
+
+def torch_mixed_int8kv_attention(q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu_q_lens):
+    D = q.shape[-1]
+    group = q.shape[1] // k.shape[1]
+    out = torch.empty_like(q)
+    k_f, v_f = dequantize(k, k_s), dequantize(v, v_s)
+    for b in range(b_seq_len.numel()):
+        s, e, L = int(cu_q_lens[b]), int(cu_q_lens[b + 1]), int(b_seq_len[b])
+        slots = req_to_tokens[b_req_idx[b], :L].long()
+        ks = k_f[slots].repeat_interleave(group, dim=1)  # [L, H, D]
+        vs = v_f[slots].repeat_interleave(group, dim=1)
+        att = torch.einsum("thd,lhd->htl", q[s:e].float(), ks) / D**0.5
+        # query token i sits at position L - q_len + i
+        pos = torch.arange(L - (e - s), L, device=q.device)
+        att.masked_fill_(torch.arange(L, device=q.device)[None, :] > pos[:, None], float("-inf"))
+        out[s:e] = torch.einsum("htl,lhd->thd", att.softmax(-1), vs).to(q.dtype)
+    return out
+
+
+class TestMixedInt8KvAttention(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        # (query tokens, sequence length) per request: decode tokens, a fresh prefill and prefill chunks
+        self.batches = [
+            [(1, 1)],
+            [(1, 300), (1, 17), (1, 1000)],
+            [(200, 200)],
+            [(1, 500), (77, 77), (1, 33), (64, 1064), (1, 1)],
+        ]
+        self.head_dims = [64, 128]
+        self.heads = [(8, 8), (32, 4)]
+        self.devices = available_devices()
+        self.dtypes = [torch.bfloat16, torch.float16]
+
+    def make_inputs(self, batch, heads, kv_heads, head_dim, device, dtype):
+        B, max_len = len(batch), max(L for _, L in batch)
+        q_lens = [n for n, _ in batch]
+        slots = B * max_len
+        q = torch.randn((sum(q_lens), heads, head_dim), dtype=dtype, device=device)
+        k, k_s, v, v_s = make_kv_cache(slots, kv_heads, head_dim, device, dtype)
+        req_to_tokens = torch.randperm(slots, device=device).to(torch.int32).view(B, max_len)
+        b_req_idx = torch.arange(B - 1, -1, -1, dtype=torch.int32, device=device)
+        b_seq_len = torch.tensor([L for _, L in batch], dtype=torch.int32, device=device)
+        cu_q_lens = torch.tensor([0] + q_lens, dtype=torch.int32).cumsum(0).to(torch.int32).to(device)
+        return q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu_q_lens
+
+    def test_accuracy(self):
+        """Test mixed_int8kv_attention against a causal fp32 reference per request."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for batch in self.batches:
+                    for head_dim in self.head_dims:
+                        for heads, kv_heads in self.heads:
+                            shape = [batch, heads, kv_heads, head_dim]
+                            with self.subTest(shape=shape, device=device, dtype=dtype):
+                                args = self.make_inputs(batch, heads, kv_heads, head_dim, device, dtype)
+                                real = torch_mixed_int8kv_attention(*args)
+                                o = torch.empty_like(args[0])
+                                mixed_int8kv_attention(o, *args)
+                                self.assertTrue(error(o, real) < 1e-4, f"Accuracy test failed for size {shape}.")
+
+    def test_plan(self):
+        """Every query row is covered exactly once and the units are sorted longest first."""
+        cu_q_lens = torch.tensor([0, 1, 78, 79, 143], dtype=torch.int32)
+        b_seq_len = torch.tensor([500, 77, 33, 1064], dtype=torch.int32)
+        work = plan_mixed_attention(cu_q_lens, b_seq_len, 32, 4)
+        self.assertEqual(work.shape[1], 4)
+        covered = torch.zeros((143, 4), dtype=torch.int32)
+        cost = []
+        for b, h, s, e in work.tolist():
+            self.assertTrue(int(cu_q_lens[b]) <= s < e <= int(cu_q_lens[b + 1]) and (e - s) * 8 <= 32)
+            covered[s:e, h] += 1
+            cost.append((e - s) * (int(b_seq_len[b]) - int(cu_q_lens[b + 1]) + e))
+        self.assertTrue(bool((covered == 1).all()))
+        self.assertEqual(cost, sorted(cost, reverse=True))
+
+    def test_decode_only(self):
+        """A batch of decode tokens matches group_int8kv_decode_attention."""
+        for device in self.devices:
+            with self.subTest(device=device):
+                batch = [(1, 17), (1, 1000), (1, 333)]
+                args = self.make_inputs(batch, 32, 8, 128, device, torch.bfloat16)
+                q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu_q_lens = args
+                o = torch.empty_like(q)
+                mixed_int8kv_attention(o, *args)
+                real = torch.empty_like(q)
+                group_int8kv_decode_attention(real, q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, 1000)
+                self.assertTrue(error(o, real) < 1e-4)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_work_device(self):
+        """Test that a work list on another device than q is rejected instead of copied on every call."""
+        args = self.make_inputs([(1, 300), (40, 77)], 32, 8, 128, "cuda", torch.bfloat16)
+        q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu_q_lens = args
+        work = plan_mixed_attention(cu_q_lens, b_seq_len, 32, 8)
+        with self.assertRaises(ValueError):
+            mixed_int8kv_attention(torch.empty_like(q), *args, work)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test one mixed launch against a decode launch plus a launch per prefill chunk."""
+        # chunked-prefill step: 2 prefill chunks of 512 tokens and 62 decode requests
+        batch = [(512, 2048), (512, 512)] + [(1, 4096)] * 62
+        heads, kv_heads, head_dim = 32, 8, 128
+        args = self.make_inputs(batch, heads, kv_heads, head_dim, "cuda", torch.bfloat16)
+        q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, cu_q_lens = args
+        o = torch.empty_like(q)
+        work = plan_mixed_attention(cu_q_lens, b_seq_len, heads, kv_heads, "cuda")
+        works = [
+            plan_mixed_attention(cu_q_lens[b : b + 2] - cu_q_lens[b], b_seq_len[b : b + 1], heads, kv_heads, "cuda")
+            for b in range(2)
+        ]
+        decode_q = q[1024:]
+
+        def separate():
+            for b in range(2):
+                s, e = int(cu_q_lens[b]), int(cu_q_lens[b + 1])
+                mixed_int8kv_attention(
+                    o[s:e], q[s:e], k, k_s, v, v_s, req_to_tokens, b_req_idx[b : b + 1], b_seq_len[b : b + 1],
+                    cu_q_lens[b : b + 2] - s, works[b],
+                )
+            group_int8kv_decode_attention(
+                o[1024:], decode_q, k, k_s, v, v_s, req_to_tokens, b_req_idx[2:], b_seq_len[2:], 4096
+            )
+
+        tflops = 4 * heads * head_dim * sum(n * (L - n) + n * (n + 1) / 2 for n, L in batch) / 1e12
+        shape = [list(q.shape), [len(batch) + 1]]
+        benchmark(mixed_int8kv_attention, shape, tflops, 100, o, *args, work)
+        benchmark(separate, shape, tflops, 100)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,145 @@
+import unittest
+import torch
+from lightllm_kernel.ops import (
+    group_int8kv_decode_attention,
+    kv_page_minmax_update,
+    quest_int8kv_decode_attention,
+    quest_select_pages,
+)
+from test.utils import available_devices, benchmark, dequantize, error, make_kv_cache, quantize_group8
+
+
+def torch_page_minmax(k, k_s, num_pages, page_size):
+    k_f = dequantize(k, k_s)[: num_pages * page_size].view(num_pages, page_size, *k.shape[1:])
+    return k_f.amin(1).to(k_s.dtype), k_f.amax(1).to(k_s.dtype)
+
+
+def torch_quest_select_pages(q, page_min, page_max, req_to_tokens, b_req_idx, b_seq_len, page_size, top):
+    B, H, _ = q.shape
+    Hkv = page_min.shape[1]
+    out = torch.full((B, Hkv, top), -1, dtype=torch.int32)
+    for b in range(B):
+        n = (int(b_seq_len[b]) + page_size - 1) // page_size
+        pages = req_to_tokens[b_req_idx[b], 0 : n * page_size : page_size].long() // page_size
+        qg = q[b].float().view(Hkv, H // Hkv, 1, -1)  # [Hkv, G, 1, D]
+        lo, hi = page_min[pages].float().transpose(0, 1)[:, None], page_max[pages].float().transpose(0, 1)[:, None]
+        scores = torch.maximum(qg * lo, qg * hi).sum(-1).amax(1)  # [Hkv, n]
+        scores[:, n - 1] = torch.finfo(torch.float32).max
+        for h in range(Hkv):
+            # ties go to the earlier page: a stable sort on the negated scores
+            keep = torch.sort(-scores[h].cpu(), stable=True).indices[:top].sort().values
+            out[b, h, : keep.numel()] = keep.to(torch.int32)
+    return out
+
+
+def torch_sparse_int8kv_decode_attention(q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, page_idx, page_size):
+    B, H, D = q.shape
+    group = H // k.shape[1]
+    out = torch.empty_like(q)
+    k_f, v_f = dequantize(k, k_s), dequantize(v, v_s)
+    for b in range(B):
+        L = int(b_seq_len[b])
+        for h in range(H):
+            pos = [t for p in page_idx[b, h // group].tolist() if p >= 0 for t in range(p * page_size, min(L, (p + 1) * page_size))]
+            slots = req_to_tokens[b_req_idx[b], pos].long()
+            att = (k_f[slots, h // group] @ q[b, h].float()) / D**0.5
+            out[b, h] = (att.softmax(-1) @ v_f[slots, h // group]).to(q.dtype)
+    return out
+
+
+class TestQuestAttention(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.seq_lens = [[1], [100], [17, 1000, 333]]
+        self.page_size = 16
+        self.top_pages = [1, 8, 64]
+        self.heads = [(8, 8), (32, 4)]
+        self.head_dim = 128
+        self.devices = available_devices()
+        self.dtypes = [torch.bfloat16, torch.float16]
+
+    def make_inputs(self, seq_lens, heads, kv_heads, device, dtype):
+        """Requests own shuffled whole pages; the summaries are built the way the store path does."""
+        B, ps = len(seq_lens), self.page_size
+        max_pages = (max(seq_lens) + ps - 1) // ps
+        num_pages = B * max_pages
+        q = torch.randn((B, heads, self.head_dim), dtype=dtype, device=device)
+        k, k_s, v, v_s = make_kv_cache(num_pages * ps, kv_heads, self.head_dim, device, dtype)
+        pages = torch.randperm(num_pages, device=device).view(B, max_pages, 1)
+        req_to_tokens = (pages * ps + torch.arange(ps, device=device)).view(B, -1).to(torch.int32)
+        b_req_idx = torch.arange(B - 1, -1, -1, dtype=torch.int32, device=device)
+        b_seq_len = torch.tensor(seq_lens[::-1], dtype=torch.int32, device=device)
+        page_min = torch.empty((num_pages, kv_heads, self.head_dim), dtype=dtype, device=device)
+        page_max = torch.empty_like(page_min)
+        # every page of the cache is written, request by request
+        for row in req_to_tokens:
+            kv_page_minmax_update(page_min, page_max, k, k_s, row, ps)
+        return q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len, page_min, page_max
+
+    def test_page_minmax(self):
+        """A prefill then single decode slots keep the summaries equal to a full recomputation."""
+        for device in self.devices:
+            with self.subTest(device=device):
+                ps, num_pages = self.page_size, 6
+                k, k_s = quantize_group8(torch.randn((num_pages * ps, 4, 64), dtype=torch.bfloat16, device=device))
+                page_min = torch.full((num_pages, 4, 64), 100.0, dtype=torch.bfloat16, device=device)
+                page_max = -page_min
+                slots = torch.arange(num_pages * ps, dtype=torch.int32, device=device)
+                kv_page_minmax_update(page_min, page_max, k, k_s, slots[: 3 * ps + 5], ps)
+                for s in range(3 * ps + 5, num_pages * ps):
+                    kv_page_minmax_update(page_min, page_max, k, k_s, slots[s : s + 1], ps)
+                real_min, real_max = torch_page_minmax(k, k_s, num_pages, ps)
+                torch.testing.assert_close(page_min, real_min, rtol=0, atol=0)
+                torch.testing.assert_close(page_max, real_max, rtol=0, atol=0)
+
+    def test_select(self):
+        """Test quest_select_pages against torch, including the always kept last page."""
+        for device in self.devices:
+            for seq_lens in self.seq_lens:
+                for top in self.top_pages:
+                    with self.subTest(seq_lens=seq_lens, top=top, device=device):
+                        q, _, _, _, _, req_to_tokens, b_req_idx, b_seq_len, page_min, page_max = self.make_inputs(
+                            seq_lens, 32, 4, device, torch.bfloat16
+                        )
+                        args = (q, page_min, page_max, req_to_tokens, b_req_idx, b_seq_len, self.page_size, top)
+                        page_idx = quest_select_pages(*args, max(seq_lens))
+                        self.assertTrue(torch.equal(page_idx.cpu(), torch_quest_select_pages(*args)))
+
+    def test_accuracy(self):
+        """Test the sparse decode against torch over the selected pages, and against dense with all pages."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for seq_lens in self.seq_lens:
+                    for heads, kv_heads in self.heads:
+                        for top in self.top_pages:
+                            shape = [seq_lens, heads, kv_heads, top]
+                            with self.subTest(shape=shape, device=device, dtype=dtype):
+                                args = self.make_inputs(seq_lens, heads, kv_heads, device, dtype)
+                                q = args[0]
+                                o = torch.empty_like(q)
+                                page_idx = quest_int8kv_decode_attention(
+                                    o, *args[:8], max(seq_lens), *args[8:], self.page_size, top
+                                )
+                                real = torch_sparse_int8kv_decode_attention(*args[:8], page_idx, self.page_size)
+                                self.assertTrue(error(o, real) < 1e-4, f"Accuracy test failed for size {shape}.")
+                                if top * self.page_size >= max(seq_lens):
+                                    dense = torch.empty_like(q)
+                                    group_int8kv_decode_attention(dense, *args[:8], max(seq_lens))
+                                    self.assertTrue(error(o, dense) < 1e-4)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test the sparse decode at 128K context against dense int8 KV decode attention."""
+        seq_lens, heads, kv_heads, top = [131072] * 4, 32, 8, 64
+        args = self.make_inputs(seq_lens, heads, kv_heads, "cuda", torch.bfloat16)
+        o = torch.empty_like(args[0])
+        dense_args = (o, *args[:8], max(seq_lens))
+        quest_args = (*dense_args, *args[8:], self.page_size, top)
+        shape = [list(o.shape), seq_lens]
+        tflops = 4 * len(seq_lens) * heads * self.head_dim * max(seq_lens) / 1e12
+        benchmark(group_int8kv_decode_attention, shape, tflops, 100, *dense_args)
+        benchmark(quest_int8kv_decode_attention, shape, tflops, 100, *quest_args)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,85 @@
+import unittest
+import torch
+import torch.nn.functional as F
+from lightllm_kernel.ops import varlen_attention
+from test.utils import available_devices, benchmark, error
+
+
+def torch_varlen_attention(q, k, v, cu_seqlens):
+    out = torch.empty_like(q)
+    group = q.shape[1] // k.shape[1]
+    for b in range(cu_seqlens.numel() - 1):
+        s, e = int(cu_seqlens[b]), int(cu_seqlens[b + 1])
+        qs = q[s:e].float().transpose(0, 1)
+        ks = k[s:e].float().repeat_interleave(group, dim=1).transpose(0, 1)
+        vs = v[s:e].float().repeat_interleave(group, dim=1).transpose(0, 1)
+        out[s:e] = F.scaled_dot_product_attention(qs, ks, vs).transpose(0, 1).to(q.dtype)
+    return out
+
+
+class TestVarlenAttention(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.seqlens = [[1], [256], [37, 1025, 64, 5]]
+        self.head_dims = [64, 80, 128]
+        self.heads = [(4, 4), (8, 2)]
+        self.devices = available_devices()
+        self.dtypes = [torch.bfloat16, torch.float16]
+
+    def make_inputs(self, seqlens, heads, kv_heads, head_dim, device, dtype):
+        T = sum(seqlens)
+        cu_seqlens = torch.tensor([0] + seqlens, dtype=torch.int32).cumsum(0).to(torch.int32)
+        q = torch.randn((T, heads, head_dim), dtype=dtype, device=device)
+        k = torch.randn((T, kv_heads, head_dim), dtype=dtype, device=device)
+        v = torch.randn((T, kv_heads, head_dim), dtype=dtype, device=device)
+        return q, k, v, cu_seqlens.to(device)
+
+    def test_accuracy(self):
+        """Test varlen_attention against per-sequence SDPA in fp32."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for seqlens in self.seqlens:
+                    for head_dim in self.head_dims:
+                        for heads, kv_heads in self.heads:
+                            shape = [seqlens, heads, kv_heads, head_dim]
+                            with self.subTest(shape=shape, device=device, dtype=dtype):
+                                q, k, v, cu = self.make_inputs(seqlens, heads, kv_heads, head_dim, device, dtype)
+                                real = torch_varlen_attention(q, k, v, cu)
+                                pred = varlen_attention(q, k, v, cu)
+                                self.assertTrue(error(pred, real) < 1e-4, f"Accuracy test failed for size {shape}.")
+
+    def test_packed_qkv(self):
+        """Test q, k, v sliced out of one packed qkv projection (token stride > heads * D)."""
+        for device in self.devices:
+            with self.subTest(device=device):
+                T, heads, head_dim = 300, 4, 80
+                qkv = torch.randn((T, 3, heads, head_dim), dtype=torch.bfloat16, device=device)
+                q, k, v = qkv.unbind(1)
+                cu = torch.tensor([0, 100, 300], dtype=torch.int32, device=device)
+                real = torch_varlen_attention(q, k, v, cu)
+                self.assertTrue(error(varlen_attention(q, k, v, cu, max_seqlen=200), real) < 1e-4)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test the performance of varlen_attention against SDPA on images padded to the longest one."""
+        # InternViT-style batch: 448px tiles of 1025 patches and a few smaller images
+        seqlens = [1025] * 6 + [257, 577]
+        heads, head_dim = 16, 64
+        q, k, v, cu = self.make_inputs(seqlens, heads, heads, head_dim, "cuda", torch.bfloat16)
+        B, L = len(seqlens), max(seqlens)
+        padded = [torch.zeros((B, heads, L, head_dim), dtype=torch.bfloat16, device="cuda") for _ in range(3)]
+        mask = torch.zeros((B, 1, 1, L), dtype=torch.bool, device="cuda")
+        for b, n in enumerate(seqlens):
+            mask[b, ..., :n] = True
+
+        def padded_sdpa():
+            return F.scaled_dot_product_attention(*padded, attn_mask=mask)
+
+        tflops = 4 * sum(n * n for n in seqlens) * heads * head_dim / 1e12
+        shape = [[sum(seqlens), heads, head_dim], [B + 1]]
+        benchmark(varlen_attention, shape, tflops, 100, q, k, v, cu, L)
+        benchmark(padded_sdpa, shape, tflops, 100)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,88 @@
+import unittest
+import torch
+from lightllm_kernel.ops import (
+    CPU_ISAS,
+    cpu_isa,
+    cutlass_scaled_mm_bias_ls,
+    decode_attention,
+    detected_cpu_isa,
+    get_cpu_isa,
+    rmsnorm_bf16,
+    set_cpu_isa,
+    supported_cpu_isas,
+)
+from test.utils import error, make_decode_inputs, torch_decode_attention
+
+
+def torch_scaled_mm(a, b, a_scales, b_scales, bias, ls, out_dtype):
+    y = (a.float() @ b.float()) * a_scales.view(-1, 1) * b_scales.view(1, -1)
+    return ((y + bias.float()) * ls.float()).to(out_dtype)
+
+
+class TestCpuIsa(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.isas = supported_cpu_isas()
+        self.gemm_shapes = [(1, 64, 128), (37, 200, 96), (130, 96, 1000)]
+
+    def test_levels(self):
+        """The detected level is active by default and every supported level can be forced."""
+        self.assertIn(detected_cpu_isa(), CPU_ISAS)
+        self.assertEqual(self.isas[0], "scalar")
+        self.assertEqual(self.isas[-1], detected_cpu_isa())
+        for isa in self.isas:
+            with cpu_isa(isa):
+                self.assertEqual(get_cpu_isa(), isa)
+        with self.assertRaises(ValueError):
+            set_cpu_isa("sse4")
+        if detected_cpu_isa() != CPU_ISAS[-1]:
+            with self.assertRaises(ValueError):
+                set_cpu_isa(CPU_ISAS[-1])
+
+    def test_rmsnorm(self):
+        """rmsnorm_bf16 on CPU matches torch at every level."""
+        for isa in self.isas:
+            for batch, size in [(1, 1025), (37, 3200)]:
+                with self.subTest(isa=isa, shape=[batch, size]), cpu_isa(isa):
+                    X = torch.rand(size=[batch, size], dtype=torch.bfloat16) - 0.5
+                    W = torch.rand(size=[size], dtype=torch.bfloat16) - 0.5
+                    y_real = torch.nn.functional.rms_norm(X, (size,), W)
+                    self.assertTrue(error(rmsnorm_bf16(X, W), y_real) < 0.01)
+
+    def test_decode_attention(self):
+        """decode_attention on CPU matches torch at every level and KV cache format."""
+        for isa in self.isas:
+            for kv_format in ["half", "fp8", "int8"]:
+                for head_dim in [80, 128]:
+                    with self.subTest(isa=isa, kv_format=kv_format, head_dim=head_dim), cpu_isa(isa):
+                        args = make_decode_inputs([17, 300], 32, 4, head_dim, "cpu", torch.bfloat16, kv_format)
+                        q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len = args
+                        real = torch_decode_attention(*args)
+                        o = torch.empty_like(q)
+                        decode_attention(o, q, k, v, req_to_tokens, b_req_idx, b_seq_len, 300, k_s=k_s, v_s=v_s)
+                        self.assertTrue(error(o, real) < 1e-4)
+
+    def test_scaled_mm(self):
+        """cutlass_scaled_mm_bias_ls on CPU matches torch at every level for int8 and fp8 operands."""
+        for isa in self.isas:
+            for dtype in [torch.int8, torch.float8_e4m3fn]:
+                for M, N, K in self.gemm_shapes:
+                    with self.subTest(isa=isa, dtype=dtype, shape=[M, N, K]), cpu_isa(isa):
+                        if dtype == torch.int8:
+                            a = torch.randint(-127, 128, (M, K), dtype=torch.int8)
+                            b = torch.randint(-127, 128, (N, K), dtype=torch.int8).t()
+                        else:
+                            a = torch.randn(M, K).to(dtype)
+                            b = torch.randn(N, K).to(dtype).t()
+                        a_scales = torch.rand(M, 1) * 0.01
+                        b_scales = torch.rand(N, 1) * 0.01
+                        bias = torch.randn(N, dtype=torch.bfloat16)
+                        ls = torch.randn(N, dtype=torch.bfloat16)
+                        c = torch.empty((M, N), dtype=torch.bfloat16)
+                        cutlass_scaled_mm_bias_ls(c, a, b, a_scales, b_scales, bias, ls)
+                        y_real = torch_scaled_mm(a, b, a_scales, b_scales, bias, ls, torch.bfloat16)
+                        self.assertTrue(error(c, y_real) < 1e-4)
+
+
+if __name__ == "__main__":
+    unittest.main()
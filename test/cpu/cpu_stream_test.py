@@ -0,0 +1,93 @@
+import threading
+import time
+import unittest
+import torch
+from lightllm_kernel.ops import CpuStream, cutlass_scaled_mm_bias_ls, rmsnorm_bf16
+from test.utils import error
+
+
+class TestCpuStream(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.stream = CpuStream()
+
+    def tearDown(self):
+        self.stream.close()
+
+    def test_order(self):
+        """Submitted callables run one at a time in submit order."""
+        seen = []
+        futures = [self.stream.submit(seen.append, i) for i in range(100)]
+        self.stream.synchronize()
+        self.assertEqual(seen, list(range(100)))
+        self.assertTrue(all(f.done() for f in futures))
+        self.assertTrue(self.stream.query())
+
+    def test_future(self):
+        """The future receives the result or the exception, later work still runs."""
+        ok = self.stream.submit(lambda a, b=0: a + b, 2, b=3)
+        bad = self.stream.submit(lambda: 1 / 0)
+        after = self.stream.submit(lambda: "after")
+        self.assertEqual(ok.result(), 5)
+        with self.assertRaises(ZeroDivisionError):
+            bad.result()
+        self.assertEqual(after.result(), "after")
+        self.stream.synchronize()
+
+    def test_events(self):
+        """wait_event orders the work of two streams, query reports pending work."""
+        other = CpuStream()
+        gate = threading.Event()
+        seen = []
+        self.stream.submit(gate.wait)
+        self.stream.submit(seen.append, "first")
+        event = self.stream.record_event()
+        other.wait_event(event)
+        second = other.submit(seen.append, "second")
+        time.sleep(0.05)
+        self.assertFalse(event.query())
+        self.assertFalse(other.query())
+        self.assertEqual(seen, [])
+        gate.set()
+        second.result()
+        event.synchronize()
+        self.assertTrue(event.query())
+        self.assertEqual(seen, ["first", "second"])
+        other.close()
+
+    def test_kernels(self):
+        """CPU kernels on a stream match the same calls on the caller's thread."""
+        X = torch.rand(size=[64, 4096], dtype=torch.bfloat16) - 0.5
+        W = torch.rand(size=[4096], dtype=torch.bfloat16) - 0.5
+        a = torch.randint(-127, 128, (64, 512), dtype=torch.int8)
+        b = torch.randint(-127, 128, (256, 512), dtype=torch.int8).t()
+        a_scales = torch.rand(64, 1) * 0.01
+        b_scales = torch.rand(256, 1) * 0.01
+        bias = torch.randn(256, dtype=torch.bfloat16)
+        ls = torch.randn(256, dtype=torch.bfloat16)
+        c = torch.empty((64, 256), dtype=torch.bfloat16)
+        y = self.stream.submit(rmsnorm_bf16, X, W)
+        self.stream.submit(cutlass_scaled_mm_bias_ls, c, a, b, a_scales, b_scales, bias, ls)
+        self.stream.synchronize()
+        c_real = torch.empty_like(c)
+        cutlass_scaled_mm_bias_ls(c_real, a, b, a_scales, b_scales, bias, ls)
+        self.assertTrue(error(y.result(), rmsnorm_bf16(X, W)) < 1e-6)
+        self.assertTrue(error(c, c_real) < 1e-6)
+
+    def test_overlap(self):
+        """The caller keeps running Python while a kernel runs on the stream."""
+        a = torch.randint(-127, 128, (512, 4096), dtype=torch.int8)
+        b = torch.randint(-127, 128, (4096, 4096), dtype=torch.int8).t()
+        a_scales = torch.ones(512, 1)
+        b_scales = torch.ones(4096, 1)
+        c = torch.empty((512, 4096), dtype=torch.bfloat16)
+        future = self.stream.submit(cutlass_scaled_mm_bias_ls, c, a, b, a_scales, b_scales, None, None)
+        steps = 0
+        while not future.done():
+            steps += 1
+        # with the GIL held by the kernel the loop could not run until it is done
+        self.assertGreater(steps, 1000)
+        future.result()
+
+if __name__ == "__main__":
+    unittest.main()
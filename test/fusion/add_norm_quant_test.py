@@ -2,7 +2,7 @@ import unittest
 import torch
 from lightllm_kernel.ops import add_norm_quant_bf16_fp8
 from lightllm.common.vllm_kernel import _custom_ops as ops
-from test.utils import benchmark, error
+from test.utils import available_devices, benchmark, error
 
 
 def torch_add_norm_quant_bf16_fp8(X, R, W, eps=1e-6):
@@ -17,6 +17,17 @@ def torch_add_norm_quant_bf16_fp8(X, R, W, eps=1e-6):
     return quantized, scales
 
 
+def bf16_intermediate_add_norm_quant_fp8(X, R, W, eps=1e-6):
+    """The two-reduction form: the normalized row is rounded to bf16 before its absmax and the quantization."""
+    X = X.add_(R)
+    h = X.float()
+    inv_norm = torch.rsqrt(h.pow(2).mean(dim=1, keepdim=True) + eps)
+    normalized = (h * inv_norm * W.float()).to(torch.bfloat16).float()
+    scales = normalized.abs().amax(dim=1, keepdim=True) / 448.0
+    quantized = (normalized / (scales + 1e-7)).clamp(-448.0, 448.0).to(torch.float8_e4m3fn)
+    return quantized, scales
+
+
 class TestFusedAddNormQuantBF16(unittest.TestCase):
     def setUp(self):
         """Set up common test parameters."""
@@ -56,6 +67,32 @@ class TestFusedAddNormQuantBF16(unittest.TestCase):
                             f"scales_real={scales_real}, scales_pred={scales_pred}",
                         )
 
+    def test_tolerance_vs_bf16_intermediate(self):
+        """Single-reduction add_norm_quant against the bf16-rounded-intermediate form, on every device."""
+        for device in available_devices():
+            for embed_dim in self.embed_dims:
+                with self.subTest(device=device, embed_dim=embed_dim):
+                    X1 = torch.randn(size=[257, embed_dim], device=device, dtype=self.dtype)
+                    X2 = X1.clone()
+                    R = torch.randn(size=[257, embed_dim], device=device, dtype=self.dtype) * 0.5
+                    R[:, 0] += 40.0
+                    W = 1.0 + 0.3 * torch.randn(size=[embed_dim], device=device, dtype=self.dtype)
+                    exact = torch.nn.functional.rms_norm((X1.float() + R.float()).bfloat16().float(), (embed_dim,),
+                                                         W.float(), eps=self.eps)
+                    q_ref, s_ref = bf16_intermediate_add_norm_quant_fp8(X1, R, W, self.eps)
+                    q, s = add_norm_quant_bf16_fp8(X2, R, W, self.eps)
+
+                    self.assertTrue(torch.equal(X1, X2))
+                    # the bf16 rounding of the absmax is the only difference of the scales
+                    self.assertLessEqual(((s - s_ref).abs() / s_ref).max().item(), 2**-8)
+                    # values move by at most one fp8 step (2^-3 relative, 2^-9 below the normals)
+                    q, q_ref = q.float(), q_ref.float()
+                    self.assertTrue(((q - q_ref).abs() <= q_ref.abs() * 2**-3 + 2**-9).all())
+                    # and without the intermediate rounding the result is no further from the exact norm
+                    err = (q * s - exact).abs().mean().item()
+                    err_ref = (q_ref * s_ref - exact).abs().mean().item()
+                    self.assertLessEqual(err, err_ref * 1.01)
+
     def test_performance(self):
         """Test the performance of FusedAddNormQuant using benchmark."""
         for batch in self.batchs:
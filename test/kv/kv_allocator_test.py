@@ -0,0 +1,200 @@
+import random
+import unittest
+import torch
+from lightllm_kernel.ops import (
+    KvPageAllocator,
+    kv_copy_slots,
+    kv_evict_select,
+    kv_move_slots,
+    page_copies_to_slot_pairs,
+)
+
+
+class TestKvPageAllocator(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.num_pages = 64
+        self.page_size = 4
+        self.max_reqs = 8
+        self.max_seq_len = 64
+
+    def make(self):
+        return KvPageAllocator(self.num_pages, self.page_size, self.max_reqs, self.max_seq_len)
+
+    def test_extend_writes_table(self):
+        """Test that the slots of a step land in req_to_tokens and in the returned slots."""
+        alloc = self.make()
+        a, b = alloc.alloc_req(), alloc.alloc_req()
+        ok, slots, copies = alloc.extend([a, b], [6, 3])
+        self.assertTrue(ok)
+        self.assertEqual(copies.shape, (0, 3))
+        self.assertTrue(torch.equal(slots[:6], alloc.req_to_tokens[a, :6]))
+        self.assertTrue(torch.equal(slots[6:], alloc.req_to_tokens[b, :3]))
+        self.assertEqual(len(set(slots.tolist())), 9)
+        self.assertEqual(alloc.num_free_pages, self.num_pages - 3)
+
+    def test_fork_copy_on_write(self):
+        """Test that a fork shares the prefix pages and copies a shared partial page on write."""
+        alloc = self.make()
+        a = alloc.alloc_req()
+        alloc.extend([a], [6])
+        b = alloc.fork(a, 6)
+        self.assertTrue(torch.equal(alloc.req_to_tokens[a, :6], alloc.req_to_tokens[b, :6]))
+        self.assertEqual(alloc.num_free_pages, self.num_pages - 2)
+
+        ok, slots, copies = alloc.extend([b], [1])
+        self.assertTrue(ok)
+        src_page, dst_page, num_tokens = copies[0].tolist()
+        self.assertEqual((src_page, num_tokens), (alloc.req_to_tokens[a, 4].item() // self.page_size, 2))
+        # the full first page stays shared, the partial one moved
+        self.assertTrue(torch.equal(alloc.req_to_tokens[a, :4], alloc.req_to_tokens[b, :4]))
+        expected = torch.arange(3, dtype=torch.int32) + dst_page * self.page_size
+        self.assertTrue(torch.equal(alloc.req_to_tokens[b, 4:7], expected))
+
+        alloc.free_reqs([a, b])
+        self.assertEqual(alloc.num_free_pages, self.num_pages)
+        self.assertEqual(alloc.num_free_reqs, self.max_reqs)
+
+    def test_all_or_nothing(self):
+        """Test that a step that does not fit allocates nothing."""
+        alloc = self.make()
+        reqs = [alloc.alloc_req() for _ in range(3)]
+        ok, _, _ = alloc.extend(reqs, [self.max_seq_len] * 3)
+        self.assertTrue(ok)
+        a = alloc.alloc_req()
+        b = alloc.alloc_req()
+        free = alloc.num_free_pages
+        ok, slots, _ = alloc.extend([a, b], [1, free * self.page_size])
+        self.assertFalse(ok)
+        self.assertEqual(slots.numel(), 0)
+        self.assertEqual((alloc.seq_len(a), alloc.seq_len(b), alloc.num_free_pages), (0, 0, free))
+        with self.assertRaises(ValueError):
+            alloc.extend([a, a], [1, 1])
+
+    def test_free_reqs_all_or_nothing(self):
+        """Test that a batch with a bad or repeated row frees nothing."""
+        alloc = self.make()
+        a = alloc.alloc_req()
+        b = alloc.alloc_req()
+        alloc.extend([a, b], [5, 9])
+        table = alloc.req_to_tokens.clone()
+        state = (alloc.num_free_reqs, alloc.num_free_pages)
+        for reqs in ([a, self.max_reqs], [b, a, b], [a, -1]):
+            with self.assertRaises(ValueError):
+                alloc.free_reqs(reqs)
+            self.assertEqual((alloc.num_free_reqs, alloc.num_free_pages), state)
+            self.assertEqual((alloc.seq_len(a), alloc.seq_len(b)), (5, 9))
+            self.assertTrue(torch.equal(alloc.req_to_tokens, table))
+        alloc.free_reqs([a, b])
+        self.assertEqual(alloc.num_free_pages, self.num_pages)
+
+    def test_compact(self):
+        """Test that compaction moves each used page above the used count once and keeps the KV data."""
+        alloc = self.make()
+        cache = torch.zeros((self.num_pages * self.page_size, 2), dtype=torch.float32)
+        reqs = [alloc.alloc_req() for _ in range(6)]
+        _, slots, _ = alloc.extend(reqs, [5, 9, 2, 13, 4, 7])
+        cache[slots.long()] = torch.randn((slots.numel(), 2))
+        fork = alloc.fork(reqs[3], 10)
+        alloc.free_reqs([reqs[0], reqs[2], reqs[4]])
+        live = [reqs[1], reqs[3], reqs[5], fork]
+        before = {r: cache[alloc.req_to_tokens[r, : alloc.seq_len(r)].long()].clone() for r in live}
+
+        used = self.num_pages - alloc.num_free_pages
+        moves = alloc.compact()
+        self.assertTrue(bool((moves[:, 0] >= used).all()) and bool((moves[:, 1] < used).all()))
+        self.assertEqual(len(set(moves[:, 0].tolist())), moves.shape[0])
+        kv_copy_slots([cache], page_copies_to_slot_pairs(moves, self.page_size))
+
+        for r in live:
+            table = alloc.req_to_tokens[r, : alloc.seq_len(r)]
+            self.assertTrue(bool((table < used * self.page_size).all()))
+            self.assertTrue(torch.equal(cache[table.long()], before[r]))
+        self.assertEqual(alloc.compact().shape[0], 0)
+
+    def test_evict(self):
+        """Test that an eviction keeps the selected tokens' KV in order, frees pages and copies shared ones."""
+        alloc = self.make()
+        cache = torch.zeros((self.num_pages * self.page_size, 2), dtype=torch.float32)
+        a = alloc.alloc_req()
+        _, slots, _ = alloc.extend([a], [30])
+        cache[slots.long()] = torch.randn((30, 2))
+        b = alloc.fork(a, 30)
+        before = cache[alloc.req_to_tokens[a, :30].long()].clone()
+
+        # 2 kv heads; sinks, recent window and the 4 heaviest middle tokens survive
+        attn_mass = torch.rand((self.max_reqs, 2, self.max_seq_len))
+        attn_mass[b, :, [7, 11, 12, 20]] += 10
+        mass = attn_mass[b].clone()
+        keep = kv_evict_select(attn_mass, b, 30, budget=12, num_sink=4, num_recent=4)
+        self.assertEqual(keep.tolist(), [0, 1, 2, 3, 7, 11, 12, 20, 26, 27, 28, 29])
+        self.assertTrue(torch.equal(attn_mass[b, :, :12], mass[:, keep.long()]))
+        self.assertTrue(bool((attn_mass[b, :, 12:30] == 0).all()))
+
+        free = alloc.num_free_pages
+        ok, pairs = alloc.evict(b, keep)
+        self.assertTrue(ok)
+        kv_move_slots([cache], pairs)
+        self.assertEqual(alloc.seq_len(b), 12)
+        self.assertTrue(torch.equal(cache[alloc.req_to_tokens[b, :12].long()], before[keep.long()]))
+        # a keeps its data, b copied its 2 written pages (the first page stays shared)
+        self.assertTrue(torch.equal(cache[alloc.req_to_tokens[a, :30].long()], before))
+        self.assertTrue(torch.equal(alloc.req_to_tokens[a, :4], alloc.req_to_tokens[b, :4]))
+        self.assertEqual(alloc.num_free_pages, free - 2)
+
+        # an unshared request is rewritten in place and frees its tail pages
+        alloc.free_reqs([b])
+        ok, pairs = alloc.evict(a, keep)
+        self.assertTrue(ok)
+        kv_move_slots([cache], pairs)
+        self.assertTrue(torch.equal(cache[alloc.req_to_tokens[a, :12].long()], before[keep.long()]))
+        self.assertEqual(alloc.num_free_pages, self.num_pages - 3)
+
+    def test_random(self):
+        """Test the table against a reference model under random alloc / fork / extend / free."""
+        alloc = self.make()
+        rng = random.Random(0)
+        tokens = {}  # req -> slots
+        for _ in range(2000):
+            op = rng.randrange(5)
+            if op == 0:
+                req = alloc.alloc_req()
+                if req >= 0:
+                    tokens[req] = []
+            elif op == 1 and tokens:
+                req = rng.choice(list(tokens))
+                alloc.free_reqs([req])
+                del tokens[req]
+            elif op == 2 and tokens:
+                src = rng.choice(list(tokens))
+                prefix = rng.randint(0, len(tokens[src]))
+                req = alloc.fork(src, prefix)
+                if req >= 0:
+                    tokens[req] = tokens[src][:prefix]
+            elif op == 3 and tokens:
+                req = rng.choice(list(tokens))
+                alloc.truncate(req, rng.randint(0, len(tokens[req])))
+                tokens[req] = tokens[req][: alloc.seq_len(req)]
+            elif tokens:
+                reqs = rng.sample(list(tokens), rng.randint(1, len(tokens)))
+                num_new = [min(rng.randrange(6), self.max_seq_len - len(tokens[r])) for r in reqs]
+                ok, slots, copies = alloc.extend(reqs, num_new)
+                if ok:
+                    pos = 0
+                    for r, n in zip(reqs, num_new):
+                        # copied pages move the tokens already written in them
+                        tokens[r] = alloc.req_to_tokens[r, : len(tokens[r])].tolist() + slots[pos : pos + n].tolist()
+                        pos += n
+            # no slot is owned by two requests unless it is in a shared prefix page
+            owners = {}
+            for r, t in tokens.items():
+                self.assertEqual(alloc.seq_len(r), len(t))
+                self.assertEqual(alloc.req_to_tokens[r, : len(t)].tolist(), t)
+                for i, s in enumerate(t):
+                    owners.setdefault(s, set()).add((r, i))
+            for s, o in owners.items():
+                self.assertEqual(len({i for _, i in o}), 1, f"slot {s} holds different positions")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,74 @@
+import unittest
+import torch
+from lightllm_kernel.ops import kv_copy_slots
+from test.utils import benchmark
+
+
+class TestKvCopySlots(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.num_slots = 4096
+        self.num_heads = 8
+        self.head_dim = 128
+        self.group_size = 8
+        self.num_pairs = [1, 37, 1024]
+
+    def make_cache(self, device):
+        shape = (self.num_slots, self.num_heads, self.head_dim)
+        scale_shape = (self.num_slots, self.num_heads, self.head_dim // self.group_size)
+        k = torch.randint(-128, 127, shape, dtype=torch.int8, device=device)
+        v = torch.randint(-128, 127, shape, dtype=torch.int8, device=device)
+        k_s = torch.rand(scale_shape, dtype=torch.bfloat16, device=device)
+        v_s = torch.rand(scale_shape, dtype=torch.bfloat16, device=device)
+        return [k, v, k_s, v_s]
+
+    def make_pairs(self, n, device):
+        # distinct dst slots disjoint from the src slots
+        perm = torch.randperm(self.num_slots)
+        return torch.stack([perm[:n], perm[n : 2 * n]], dim=1).to(device=device, dtype=torch.int32)
+
+    def test_accuracy(self):
+        """Test kv_copy_slots against indexed copies."""
+        for device in ["cuda", "cpu"]:
+            for n in self.num_pairs:
+                with self.subTest(device=device, n=n):
+                    caches = self.make_cache(device)
+                    pairs = self.make_pairs(n, device)
+                    expected = [c.clone() for c in caches]
+                    src, dst = pairs[:, 0].long(), pairs[:, 1].long()
+                    for e in expected:
+                        e[dst] = e[src]
+                    kv_copy_slots(caches, pairs)
+                    for c, e in zip(caches, expected):
+                        self.assertTrue(torch.equal(c, e))
+
+    def test_layers(self):
+        """Test a [layers, slots, ...] cache and an unaligned row size."""
+        for device in ["cuda", "cpu"]:
+            with self.subTest(device=device):
+                kv = torch.randn((4, self.num_slots, 3, 7), dtype=torch.float16, device=device)
+                pairs = self.make_pairs(100, device)
+                expected = kv.clone()
+                expected[:, pairs[:, 1].long()] = expected[:, pairs[:, 0].long()]
+                kv_copy_slots([kv], pairs, slot_dim=1)
+                self.assertTrue(torch.equal(kv, expected))
+
+    def test_performance(self):
+        """Test the performance of kv_copy_slots against per-tensor indexed copies."""
+        for n in self.num_pairs:
+            with self.subTest(n=n):
+                caches = self.make_cache("cuda")
+                pairs = self.make_pairs(n, "cuda")
+                src, dst = pairs[:, 0].long(), pairs[:, 1].long()
+
+                def indexed_copy():
+                    for c in caches:
+                        c.index_copy_(0, dst, c.index_select(0, src))
+
+                shape = [[n, 2]] + [list(c.shape) for c in caches]
+                benchmark(kv_copy_slots, shape, 0.0, 100, caches, pairs)
+                benchmark(indexed_copy, shape, 0.0, 100)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,289 @@
+import unittest
+import torch
+from lightllm_kernel.ops import (
+    KvPageAllocator,
+    decode_attention,
+    flashdecoding_combine,
+    flashdecoding_stage1,
+    kv_downgrade_pages,
+    kv_copy_slots,
+    mixed_int8kv_attention,
+    quest_select_pages,
+    sparse_int8kv_decode_attention,
+)
+from test.utils import available_devices, benchmark, dequantize, error, make_kv_cache, torch_decode_attention
+
+
+def torch_read_rows(cache, scale, page_precision, page_size, slots):
+    """fp32 [n, Hkv, D] rows of (possibly virtual) slots, downgraded pages decoded independently of the kernels"""
+    S, Hkv, D = cache.shape
+    half = (slots >= S).long()
+    phys = slots.long() - half * S
+    full = dequantize(cache[phys], scale[phys] if cache.dtype == torch.int8 else None)
+    raw = cache.view(torch.uint8)[phys]
+    if cache.dtype == torch.int8:
+        # two signed nibbles per byte, low nibble first
+        nibbles = torch.stack([raw & 0xF, raw >> 4], -1).view(len(slots), Hkv, 2 * D).to(torch.int32)
+        vals = torch.where(nibbles >= 8, nibbles - 16, nibbles)
+    else:
+        vals = raw.view(torch.int8).to(torch.int32)
+    vals = vals.view(len(slots), Hkv, 2, D)
+    s = scale[phys].float().view(len(slots), Hkv, 2, D // 16).repeat_interleave(16, -1)
+    idx = torch.arange(len(slots), device=cache.device)
+    packed = (vals.float() * s)[idx, :, half]
+    tagged = page_precision[phys // page_size] != 0
+    return torch.where(tagged[:, None, None], packed, full)
+
+
+class TestKvDowngrade(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.page_size = 16
+        self.kv_formats = ["int8", "half"]
+        self.head_dims = [64, 128]
+        self.devices = available_devices()
+        self.dtypes = [torch.bfloat16, torch.float16]
+
+    def make_cache(self, num_pages, kv_heads, head_dim, kv_format, device, dtype):
+        k, k_s, v, v_s = make_kv_cache(num_pages * self.page_size, kv_heads, head_dim, device, dtype, kv_format)
+        if kv_format == "half":
+            # a bf16 / fp16 cache only needs scales for its downgraded pages
+            k_s = torch.zeros(k.shape[:2] + (head_dim // 8,), dtype=dtype, device=device)
+            v_s = torch.zeros_like(k_s)
+        return k, k_s, v, v_s
+
+    def test_allocator(self):
+        """Test that downgrade frees cold pages, points the table at virtual slots and restores tags on release."""
+        ps, num_pages = 4, 16
+        alloc = KvPageAllocator(num_pages, ps, 4, 64, downgradable=True)
+        a, b = alloc.alloc_req(), alloc.alloc_req()
+        alloc.extend([a, b], [40, 13])
+        before = alloc.req_to_tokens[a, :40].clone()
+        before_b = alloc.req_to_tokens[b, :13].clone()
+        pairs = alloc.downgrade(3, num_sink_pages=1, num_recent_pages=2)
+        # pages 1..7 of the longest request are cold, three pairs of them are packed
+        self.assertEqual(pairs.shape, (3, 2))
+        self.assertEqual(alloc.num_free_pages, num_pages - 14 + 3)
+        table = alloc.req_to_tokens[a, :40]
+        for lo, hi in pairs.tolist():
+            self.assertEqual(alloc.page_precision[lo].item(), 1)
+            moved = (before // ps) == hi
+            self.assertTrue(torch.equal(table[moved], before[moved] - hi * ps + (num_pages + lo) * ps))
+        self.assertTrue(torch.equal(table[table < num_pages * ps], before[table < num_pages * ps]))
+        self.assertTrue(torch.equal(alloc.req_to_tokens[b, :13], before_b))
+
+        # pages stay packed while either half is referenced
+        c = alloc.fork(a, 40)
+        alloc.free_reqs([a])
+        self.assertEqual(int(alloc.page_precision.sum()), 3)
+        with self.assertRaises(ValueError):
+            alloc.truncate(c, 2 * ps + 1)
+        alloc.free_reqs([c, b])
+        self.assertEqual(alloc.num_free_pages, num_pages)
+        self.assertEqual(int(alloc.page_precision.abs().sum()), 0)
+
+    def test_downgrade_pages(self):
+        """Test that the packed rows of both pages are within half a quantization step of the originals."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for kv_format in self.kv_formats:
+                    for head_dim in self.head_dims:
+                        shape = [kv_format, head_dim]
+                        with self.subTest(shape=shape, device=device, dtype=dtype):
+                            k, k_s, v, v_s = self.make_cache(8, 4, head_dim, kv_format, device, dtype)
+                            slots = torch.arange(k.shape[0], device=device)
+                            full_k = torch_read_rows(k, k_s, torch.zeros(8, dtype=torch.int8, device=device), 16, slots)
+                            pairs = torch.tensor([[1, 6], [4, 2], [0, 7]], dtype=torch.int32, device=device)
+                            kv_downgrade_pages([k, v], [k_s, v_s], pairs, self.page_size)
+                            tags = torch.zeros(8, dtype=torch.int8, device=device)
+                            tags[pairs[:, 0].long()] = 1
+                            # the rows of q are read through the virtual slots of p
+                            virtual = slots.clone()
+                            for lo, hi in pairs.tolist():
+                                virtual[hi * 16 : hi * 16 + 16] = k.shape[0] + lo * 16 + torch.arange(16, device=device)
+                            packed_k = torch_read_rows(k, k_s, tags, self.page_size, virtual)
+                            qmax = 7 if kv_format == "int8" else 127
+                            step = full_k.view(*full_k.shape[:2], -1, 16).abs().amax(-1, keepdim=True) / qmax
+                            # rounding plus the clamp a scale rounded down to its dtype may cause
+                            tol = (step * (0.5 + qmax / 256)).expand(-1, -1, -1, 16).reshape(full_k.shape) + 1e-6
+                            keep = torch.ones(k.shape[0], dtype=torch.bool, device=device)
+                            for page in [3, 5]:
+                                keep[page * 16 : page * 16 + 16] = False
+                            err = (packed_k - full_k).abs()[keep]
+                            self.assertTrue(bool((err <= tol[keep]).all()))
+                            # untouched pages keep their bits
+                            self.assertTrue(torch.equal(packed_k[~keep], full_k[~keep]))
+
+    def test_accuracy(self):
+        """Test decode_attention over downgraded pages against torch, and against the full precision cache."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for kv_format in self.kv_formats:
+                    for head_dim in self.head_dims:
+                        shape = [kv_format, head_dim]
+                        with self.subTest(shape=shape, device=device, dtype=dtype):
+                            seq_lens, heads, kv_heads, ps = [700, 33, 300], 32, 8, self.page_size
+                            num_pages = sum((n + ps - 1) // ps for n in seq_lens) + 4
+                            k, k_s, v, v_s = self.make_cache(num_pages, kv_heads, head_dim, kv_format, device, dtype)
+                            alloc = KvPageAllocator(num_pages, ps, len(seq_lens), max(seq_lens), downgradable=True)
+                            reqs = [alloc.alloc_req() for _ in seq_lens]
+                            alloc.extend(reqs, seq_lens)
+                            q = torch.randn((len(seq_lens), heads, head_dim), dtype=dtype, device=device)
+                            args = (
+                                alloc.req_to_tokens.to(device),
+                                torch.tensor(reqs, dtype=torch.int32, device=device),
+                                torch.tensor(seq_lens, dtype=torch.int32, device=device),
+                            )
+                            full_s = (k_s, v_s) if kv_format == "int8" else (None, None)
+                            real = torch_decode_attention(q, k, full_s[0], v, full_s[1], *args)
+
+                            pairs = alloc.downgrade(20)
+                            self.assertEqual(pairs.shape[0], 20)
+                            kv_downgrade_pages([k, v], [k_s, v_s], pairs, ps)
+                            tags = alloc.page_precision.to(device)
+                            args = (alloc.req_to_tokens.to(device),) + args[1:]
+                            o = torch.empty_like(q)
+                            decode_attention(o, q, k, v, *args, max(seq_lens), k_s=k_s, v_s=v_s,
+                                             page_precision=tags, page_size=ps)
+
+                            B, H, D = q.shape
+                            expected = torch.empty_like(q)
+                            for b in range(B):
+                                slots = args[0][reqs[b], : seq_lens[b]]
+                                ks = torch_read_rows(k, k_s, tags, ps, slots).repeat_interleave(H // kv_heads, 1)
+                                vs = torch_read_rows(v, v_s, tags, ps, slots).repeat_interleave(H // kv_heads, 1)
+                                att = torch.einsum("hd,lhd->hl", q[b].float(), ks) / D**0.5
+                                expected[b] = torch.einsum("hl,lhd->hd", att.softmax(-1), vs).to(dtype)
+                            self.assertTrue(error(o, expected) < 1e-4, f"Accuracy test failed for size {shape}.")
+                            self.assertTrue(error(o, real) < (2e-2 if kv_format == "int8" else 1e-3))
+
+    def test_mixed_attention(self):
+        """Test mixed_int8kv_attention over downgraded pages against torch, and that it needs the tags."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                with self.subTest(device=device, dtype=dtype):
+                    seq_lens, q_lens, heads, kv_heads, head_dim, ps = [700, 300, 129], [1, 40, 1], 32, 8, 128, 16
+                    num_pages = sum((n + ps - 1) // ps for n in seq_lens) + 4
+                    k, k_s, v, v_s = self.make_cache(num_pages, kv_heads, head_dim, "int8", device, dtype)
+                    alloc = KvPageAllocator(num_pages, ps, len(seq_lens), max(seq_lens), downgradable=True)
+                    reqs = [alloc.alloc_req() for _ in seq_lens]
+                    alloc.extend(reqs, seq_lens)
+                    kv_downgrade_pages([k, v], [k_s, v_s], alloc.downgrade(16), ps)
+                    tags = alloc.page_precision.to(device)
+                    q = torch.randn((sum(q_lens), heads, head_dim), dtype=dtype, device=device)
+                    cu_q_lens = torch.tensor([0, 1, 41, 42], dtype=torch.int32, device=device)
+                    args = (
+                        alloc.req_to_tokens.to(device),
+                        torch.tensor(reqs, dtype=torch.int32, device=device),
+                        torch.tensor(seq_lens, dtype=torch.int32, device=device),
+                        cu_q_lens,
+                    )
+                    o = torch.empty_like(q)
+                    if device == "cpu":
+                        # the virtual slots are past the cache without the tags
+                        with self.assertRaises(ValueError):
+                            mixed_int8kv_attention(o, q, k, k_s, v, v_s, *args)
+                    mixed_int8kv_attention(o, q, k, k_s, v, v_s, *args, page_precision=tags, page_size=ps)
+
+                    expected = torch.empty_like(q)
+                    for b, (L, n) in enumerate(zip(seq_lens, q_lens)):
+                        s = int(cu_q_lens[b])
+                        slots = args[0][reqs[b], :L]
+                        ks = torch_read_rows(k, k_s, tags, ps, slots).repeat_interleave(heads // kv_heads, 1)
+                        vs = torch_read_rows(v, v_s, tags, ps, slots).repeat_interleave(heads // kv_heads, 1)
+                        att = torch.einsum("thd,lhd->htl", q[s : s + n].float(), ks) / head_dim**0.5
+                        # query token i sits at position L - n + i
+                        last = L - n + torch.arange(n, device=device)
+                        att = att.masked_fill(torch.arange(L, device=device)[None, :] > last[:, None], float("-inf"))
+                        expected[s : s + n] = torch.einsum("htl,lhd->thd", att.softmax(-1), vs).to(dtype)
+                    self.assertTrue(error(o, expected) < 1e-4, f"Accuracy test failed on {device}.")
+
+    def test_stage1(self):
+        """Test flash decoding stage1 + combine over downgraded pages against decode_attention."""
+        seq_lens, heads, kv_heads, head_dim, ps, block = [700, 33, 300], 32, 8, 128, self.page_size, 256
+        num_pages = sum((n + ps - 1) // ps for n in seq_lens) + 4
+        for device in self.devices:
+            for kv_format in self.kv_formats:
+                with self.subTest(device=device, kv_format=kv_format):
+                    k, k_s, v, v_s = self.make_cache(num_pages, kv_heads, head_dim, kv_format, device, torch.bfloat16)
+                    alloc = KvPageAllocator(num_pages, ps, len(seq_lens), max(seq_lens), downgradable=True)
+                    reqs = [alloc.alloc_req() for _ in seq_lens]
+                    alloc.extend(reqs, seq_lens)
+                    kv_downgrade_pages([k, v], [k_s, v_s], alloc.downgrade(20), ps)
+                    tags = alloc.page_precision.to(device)
+                    q = torch.randn((len(seq_lens), heads, head_dim), dtype=torch.bfloat16, device=device)
+                    args = (
+                        alloc.req_to_tokens.to(device),
+                        torch.tensor(reqs, dtype=torch.int32, device=device),
+                        torch.tensor(seq_lens, dtype=torch.int32, device=device),
+                        max(seq_lens),
+                    )
+                    blocks = (max(seq_lens) + block - 1) // block
+                    mid_o_emb = torch.empty((len(seq_lens), heads, blocks, head_dim), dtype=q.dtype, device=device)
+                    mid_o_logexpsum = torch.empty((len(seq_lens), heads, blocks), dtype=q.dtype, device=device)
+                    flashdecoding_stage1(
+                        block, mid_o_emb, mid_o_logexpsum, head_dim**-0.5, q, k, v, *args,
+                        k_s=k_s, v_s=v_s, page_precision=tags, page_size=ps,
+                    )
+                    o, real = torch.empty_like(q), torch.empty_like(q)
+                    flashdecoding_combine(o, mid_o_emb, mid_o_logexpsum, args[2], block)
+                    decode_attention(real, q, k, v, *args, k_s=k_s, v_s=v_s, page_precision=tags, page_size=ps)
+                    self.assertTrue(error(o, real) < 1e-4)
+
+    def test_reject_virtual_slots(self):
+        """Test that the ops reading no page_precision reject the virtual slots of a downgraded request."""
+        ps, num_pages, heads, kv_heads, head_dim = 16, 16, 8, 2, 64
+        k, k_s, v, v_s = self.make_cache(num_pages, kv_heads, head_dim, "int8", "cpu", torch.bfloat16)
+        alloc = KvPageAllocator(num_pages, ps, 1, num_pages * ps, downgradable=True)
+        req = alloc.alloc_req()
+        alloc.extend([req], [num_pages * ps])
+        kv_downgrade_pages([k, v], [k_s, v_s], alloc.downgrade(2, num_sink_pages=1, num_recent_pages=1), ps)
+        row = alloc.req_to_tokens[req]
+        virtual = int(row[row >= k.shape[0]][0])
+        b_req_idx = torch.tensor([req], dtype=torch.int32)
+        b_seq_len = torch.tensor([num_pages * ps], dtype=torch.int32)
+        q = torch.randn((1, heads, head_dim), dtype=torch.bfloat16)
+        page_min = torch.zeros((num_pages, kv_heads, head_dim), dtype=torch.bfloat16)
+        with self.assertRaises(ValueError):
+            quest_select_pages(q, page_min, page_min.clone(), alloc.req_to_tokens, b_req_idx, b_seq_len, ps, 4,
+                               num_pages * ps)
+        pages = torch.arange(num_pages, dtype=torch.int32).repeat(1, kv_heads, 1)
+        with self.assertRaises(ValueError):
+            sparse_int8kv_decode_attention(torch.empty_like(q), q, k, k_s, v, v_s, alloc.req_to_tokens, b_req_idx,
+                                           b_seq_len, pages, ps)
+        with self.assertRaises(ValueError):
+            kv_copy_slots([k, v], torch.tensor([[virtual, 0]], dtype=torch.int32))
+        mid_o_emb = torch.empty((1, heads, 1, head_dim), dtype=torch.bfloat16)
+        with self.assertRaises(ValueError):
+            flashdecoding_stage1(num_pages * ps, mid_o_emb, mid_o_emb[..., 0], head_dim**-0.5, q, k, v,
+                                 alloc.req_to_tokens, b_req_idx, b_seq_len, num_pages * ps, k_s=k_s, v_s=v_s)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test decode attention with half of the pages downgraded against none."""
+        seq_lens, heads, kv_heads, head_dim, ps = [4096] * 32, 32, 8, 128, self.page_size
+        num_pages = sum(seq_lens) // ps
+        for kv_format in self.kv_formats:
+            k, k_s, v, v_s = self.make_cache(num_pages, kv_heads, head_dim, kv_format, "cuda", torch.bfloat16)
+            alloc = KvPageAllocator(num_pages, ps, len(seq_lens), max(seq_lens), downgradable=True)
+            reqs = [alloc.alloc_req() for _ in seq_lens]
+            alloc.extend(reqs, seq_lens)
+            q = torch.randn((len(seq_lens), heads, head_dim), dtype=torch.bfloat16, device="cuda")
+            o = torch.empty_like(q)
+            b_req_idx = torch.tensor(reqs, dtype=torch.int32, device="cuda")
+            b_seq_len = torch.tensor(seq_lens, dtype=torch.int32, device="cuda")
+            shape = [list(q.shape), seq_lens[:1], kv_format]
+            tflops = 4 * len(seq_lens) * heads * head_dim * max(seq_lens) / 1e12
+            benchmark(
+                decode_attention, shape, tflops, 100, o, q, k, v, alloc.req_to_tokens.cuda(), b_req_idx, b_seq_len,
+                max(seq_lens), k_s, v_s, None, None, torch.zeros(num_pages, dtype=torch.int8, device="cuda"), ps,
+            )
+            kv_downgrade_pages([k, v], [k_s, v_s], alloc.downgrade(num_pages // 4), ps)
+            benchmark(
+                decode_attention, shape + ["downgraded"], tflops, 100, o, q, k, v, alloc.req_to_tokens.cuda(),
+                b_req_idx, b_seq_len, max(seq_lens), k_s, v_s, None, None, alloc.page_precision.cuda(), ps,
+            )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,99 @@
+import os
+import tempfile
+import unittest
+import torch
+from lightllm_kernel.ops import KvOffloadEngine
+
+
+class TestKvOffloadEngine(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.layers = 2
+        self.num_slots = 1024
+        self.num_heads = 4
+        self.head_dim = 16
+        self.group_size = 8
+        self.tokens = 40
+        self.tmp = tempfile.TemporaryDirectory()
+        self.disk_path = os.path.join(self.tmp.name, "kv.bin")
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def make_cache(self, device="cpu"):
+        shape = (self.layers, self.num_slots, self.num_heads, self.head_dim)
+        scale_shape = (self.layers, self.num_slots, self.num_heads, self.head_dim // self.group_size)
+        k = torch.randint(-128, 127, shape, dtype=torch.int8, device=device)
+        v = torch.randint(-128, 127, shape, dtype=torch.int8, device=device)
+        k_s = torch.rand(scale_shape, dtype=torch.bfloat16, device=device)
+        v_s = torch.rand(scale_shape, dtype=torch.bfloat16, device=device)
+        return [k, v, k_s, v_s]
+
+    def slot_bytes(self, caches):
+        return sum(c[:, 0].numel() * c.element_size() for c in caches)
+
+    def test_roundtrip_through_disk(self):
+        """Test that entries demoted to disk and prefetched back restore bit exact into other slots."""
+        caches = self.make_cache()
+        entry_bytes = self.tokens * self.slot_bytes(caches)
+        # room for two entries on the host, the rest goes to disk
+        engine = KvOffloadEngine(2 * entry_bytes + 100, self.disk_path, 16 * entry_bytes, pin_memory=False)
+
+        saved = {}
+        for key in range(8):
+            slots = torch.arange(key * self.tokens, (key + 1) * self.tokens, dtype=torch.int32)
+            saved[key] = [c[:, slots.long()].clone() for c in caches]
+            self.assertTrue(engine.offload(key, caches, slots, slot_dim=1))
+        tiers = [engine.tier(key) for key in range(8)]
+        self.assertEqual(tiers.count(KvOffloadEngine.TIER_HOST), 2)
+        self.assertEqual(tiers[0], KvOffloadEngine.TIER_DISK)
+        for c in caches:
+            c.zero_()
+
+        # higher priority first, one entry fits the budget
+        engine.prefetch(2)
+        engine.prefetch(0, priority=1)
+        self.assertEqual(engine.issue_prefetches(entry_bytes), [0])
+        engine.wait(0)
+        self.assertTrue(engine.ready(0))
+        self.assertEqual(engine.tier(0), KvOffloadEngine.TIER_HOST)
+
+        for key in range(8):
+            slots = torch.randperm(self.num_slots)[: self.tokens].to(torch.int32)
+            engine.restore(key, caches, slots, slot_dim=1)
+            self.assertEqual(engine.tier(key), KvOffloadEngine.TIER_NONE)
+            for c, s in zip(caches, saved[key]):
+                self.assertTrue(torch.equal(c[:, slots.long()], s))
+
+        host_free, disk_free, bandwidth = engine.stats()
+        self.assertEqual((host_free, disk_free), (2 * entry_bytes + 100, 16 * entry_bytes))
+        self.assertGreater(bandwidth, 0.0)
+
+    def test_no_room(self):
+        """Test that offload reports a full host tier without a disk tier and drop frees the space."""
+        caches = self.make_cache()
+        entry_bytes = self.tokens * self.slot_bytes(caches)
+        engine = KvOffloadEngine(entry_bytes, pin_memory=False)
+        slots = torch.arange(self.tokens, dtype=torch.int32)
+        self.assertTrue(engine.offload(0, caches, slots, slot_dim=1))
+        self.assertFalse(engine.offload(1, caches, slots, slot_dim=1))
+        engine.drop(0)
+        self.assertTrue(engine.offload(1, caches, slots, slot_dim=1))
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_roundtrip_cuda(self):
+        """Test the pinned host tier with CUDA caches."""
+        caches = self.make_cache("cuda")
+        entry_bytes = self.tokens * self.slot_bytes(caches)
+        engine = KvOffloadEngine(4 * entry_bytes, self.disk_path, 4 * entry_bytes)
+        slots = torch.arange(self.tokens, dtype=torch.int32, device="cuda")
+        saved = [c[:, slots.long()].clone() for c in caches]
+        self.assertTrue(engine.offload(0, caches, slots, slot_dim=1))
+        dst = slots + 100
+        engine.restore(0, caches, dst, slot_dim=1)
+        for c, s in zip(caches, saved):
+            self.assertTrue(torch.equal(c[:, dst.long()], s))
+
+
+if __name__ == "__main__":
+    unittest.main()
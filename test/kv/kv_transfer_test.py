@@ -0,0 +1,148 @@
+import socket
+import threading
+import unittest
+import torch
+from lightllm_kernel.ops import KvPageAllocator, kv_pack, kv_transfer_bytes, kv_transfer_info, kv_unpack
+from test.utils import benchmark
+
+
+class LoopbackTransport:
+    """Local stand-in for the prefill -> decode transport: the bytes of a buffer through a socket pair."""
+
+    def __init__(self):
+        self.tx, self.rx = socket.socketpair()
+
+    def close(self):
+        self.tx.close()
+        self.rx.close()
+
+    def send_recv(self, buffer: torch.Tensor) -> torch.Tensor:
+        data = buffer.cpu().numpy().tobytes()
+        sender = threading.Thread(target=self.tx.sendall, args=(len(data).to_bytes(8, "little") + data,))
+        sender.start()
+        size = int.from_bytes(self._recv(8), "little")
+        received = torch.frombuffer(bytearray(self._recv(size)), dtype=torch.uint8)
+        sender.join()
+        return received
+
+    def _recv(self, n):
+        chunks = []
+        while n > 0:
+            chunk = self.rx.recv(min(n, 1 << 20))
+            chunks.append(chunk)
+            n -= len(chunk)
+        return b"".join(chunks)
+
+
+class TestKvTransfer(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.layers = 4
+        self.num_pages = 64
+        self.page_size = 16
+        self.num_heads = 4
+        self.head_dim = 64
+        self.group_size = 8
+        self.tokens = [1, 37, 300]
+
+    def make_cache(self, device="cpu"):
+        num_slots = self.num_pages * self.page_size
+        shape = (self.layers, num_slots, self.num_heads, self.head_dim)
+        scale_shape = (self.layers, num_slots, self.num_heads, self.head_dim // self.group_size)
+        k = torch.randint(-128, 127, shape, dtype=torch.int8, device=device)
+        v = torch.randint(-128, 127, shape, dtype=torch.int8, device=device)
+        k_s = torch.rand(scale_shape, dtype=torch.bfloat16, device=device)
+        v_s = torch.rand(scale_shape, dtype=torch.bfloat16, device=device)
+        return [k, v, k_s, v_s]
+
+    def make_allocator(self):
+        return KvPageAllocator(self.num_pages, self.page_size, 8, self.num_pages * self.page_size)
+
+    def test_loopback(self):
+        """Test prefill -> decode handoff of requests through a loopback transport, bit exact."""
+        transport = LoopbackTransport()
+        prefill, decode = self.make_cache(), [torch.zeros_like(c) for c in self.make_cache()]
+        prefill_alloc, decode_alloc = self.make_allocator(), self.make_allocator()
+        # occupy some decode pages so the slots differ on both sides
+        decode_alloc.extend([decode_alloc.alloc_req()], [40])
+        for n in self.tokens:
+            with self.subTest(n=n):
+                req = prefill_alloc.alloc_req()
+                ok, src_slots, _ = prefill_alloc.extend([req], [n])
+                self.assertTrue(ok)
+                buffer = kv_pack(prefill, src_slots, slot_dim=1, tag=1000 + req)
+                self.assertEqual(buffer.numel(), kv_transfer_bytes(prefill, n, slot_dim=1))
+
+                received = transport.send_recv(buffer)
+                num_tokens, tag = kv_transfer_info(received)
+                self.assertEqual((num_tokens, tag), (n, 1000 + req))
+                ok, dst_slots, _ = decode_alloc.extend([decode_alloc.alloc_req()], [num_tokens])
+                self.assertTrue(ok)
+                kv_unpack(decode, dst_slots, received, slot_dim=1)
+                for p, d in zip(prefill, decode):
+                    self.assertTrue(torch.equal(d[:, dst_slots.long()], p[:, src_slots.long()]))
+        transport.close()
+
+    def test_rejects_mismatch(self):
+        """Test that buffers of another format version or cache layout are rejected."""
+        caches = self.make_cache()
+        slots = torch.arange(10, dtype=torch.int32)
+        buffer = kv_pack(caches, slots, slot_dim=1)
+        bad_version = buffer.clone()
+        bad_version[4] += 1
+        with self.assertRaises(Exception):
+            kv_transfer_info(bad_version)
+        with self.assertRaises(Exception):
+            kv_transfer_info(torch.zeros_like(buffer))
+        with self.assertRaises(Exception):
+            kv_transfer_info(buffer[:-1].clone())
+        # fp16 scales on the receiver
+        other = caches[:2] + [c.half() for c in caches[2:]]
+        with self.assertRaises(Exception):
+            kv_unpack(other, slots, buffer, slot_dim=1)
+        with self.assertRaises(Exception):
+            kv_unpack(caches[:3], slots, buffer, slot_dim=1)
+        with self.assertRaises(Exception):
+            kv_unpack(caches, slots[:5], buffer, slot_dim=1)
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_cuda(self):
+        """Test CUDA caches with a device buffer and a pinned host buffer."""
+        caches = self.make_cache("cuda")
+        cpu_caches = [c.cpu() for c in caches]
+        src = torch.randperm(self.num_pages * self.page_size)[:300].to(torch.int32)
+        dst = torch.randperm(self.num_pages * self.page_size)[:300].to(torch.int32)
+        # the packed bytes match the CPU path, header included
+        expected = kv_pack(cpu_caches, src, slot_dim=1)
+        device_buffer = kv_pack(caches, src.cuda(), slot_dim=1)
+        self.assertTrue(torch.equal(device_buffer.cpu(), expected))
+        pinned = torch.empty(expected.numel(), dtype=torch.uint8, pin_memory=True)
+        kv_pack(caches, src.cuda(), slot_dim=1, out=pinned)
+        torch.cuda.synchronize()
+        self.assertTrue(torch.equal(pinned, expected))
+
+        for buffer in [device_buffer, pinned]:
+            received = [torch.zeros_like(c) for c in caches]
+            kv_unpack(received, dst.cuda(), buffer, slot_dim=1)
+            for r, c in zip(received, cpu_caches):
+                self.assertTrue(torch.equal(r[:, dst.long()].cpu(), c[:, src.long()]))
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test the GB/s of kv_pack / kv_unpack into pinned host memory against per-tensor index copies."""
+        caches = self.make_cache("cuda")
+        n = 512
+        slots = torch.randperm(self.num_pages * self.page_size)[:n].to(device="cuda", dtype=torch.int32)
+        pinned = torch.empty(kv_transfer_bytes(caches, n, slot_dim=1), dtype=torch.uint8, pin_memory=True)
+
+        def indexed_gather():
+            return [c[:, slots.long()].to("cpu", non_blocking=True) for c in caches]
+
+        shape = [[n]] + [list(c.shape) for c in caches]
+        benchmark(kv_pack, shape, 0.0, 100, caches, slots, 1, 0, pinned)
+        benchmark(kv_unpack, shape, 0.0, 100, caches, slots, pinned, 1)
+        benchmark(indexed_gather, shape, 0.0, 100)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,52 @@
+import unittest
+import torch
+from lightllm_kernel.ops import page_hashes
+
+
+class TestPageHashes(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.page_size = 16
+        self.vocab = 150000
+
+    def test_prefix_property(self):
+        """Test that two sequences share exactly the hashes of their common full pages."""
+        for bits in [64, 128]:
+            with self.subTest(bits=bits):
+                a = torch.randint(0, self.vocab, (1000,), dtype=torch.int32)
+                b = a.clone()
+                b[200] += 1  # diverge inside page 12
+                ha, hb = page_hashes(a, self.page_size, bits=bits), page_hashes(b, self.page_size, bits=bits)
+                self.assertEqual(ha.shape[0], 1000 // self.page_size)
+                self.assertTrue(torch.equal(ha[:12], hb[:12]))
+                # every later page differs too, it is chained to the first difference
+                differ = (ha[12:] != hb[12:]) if bits == 64 else (ha[12:] != hb[12:]).any(-1)
+                self.assertTrue(bool(differ.all()))
+
+    def test_chained(self):
+        """Test that equal page contents at different positions or after different prefixes hash apart."""
+        page = torch.randint(0, self.vocab, (self.page_size,), dtype=torch.int64)
+        h = page_hashes(page.repeat(8), self.page_size)
+        self.assertEqual(len(set(h.tolist())), 8)
+        self.assertNotEqual(page_hashes(page, self.page_size, seed=1)[0].item(), page_hashes(page, self.page_size)[0].item())
+
+    def test_batched(self):
+        """Test that the batched form matches per-sequence hashing and leaves partial pages 0."""
+        seqs = [torch.randint(0, self.vocab, (n,), dtype=torch.int32) for n in [5, 16, 33, 1000, 32768]]
+        out = page_hashes([s.tolist() for s in seqs], self.page_size, bits=128)
+        for i, s in enumerate(seqs):
+            num_pages = s.numel() // self.page_size
+            self.assertTrue(torch.equal(out[i, :num_pages], page_hashes(s, self.page_size, bits=128)))
+            self.assertTrue(bool((out[i, num_pages:] == 0).all()))
+        # int64 ids hash like int32 ids
+        self.assertTrue(torch.equal(page_hashes(seqs[3].long(), self.page_size), page_hashes(seqs[3], self.page_size)))
+
+    def test_distinct(self):
+        """Test that many random pages do not collide."""
+        tokens = torch.randint(0, self.vocab, (4096, self.page_size), dtype=torch.int32)
+        h = page_hashes(tokens, self.page_size, torch.full((4096,), self.page_size))
+        self.assertEqual(len(set(h[:, 0].tolist())), 4096)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,103 @@
+import unittest
+import torch
+from lightllm_kernel.ops import ExpertCache
+
+
+def markov_trace(L, E, T, K, steps, p, seed=0):
+    """Routing trace [steps * L] of ([T, K] ids, [T, K] weights): with probability p a token moves from
+    expert e of layer l to perm[l][e] of layer l + 1, like the layer to layer correlation of real MoEs"""
+    g = torch.Generator().manual_seed(seed)
+    perms = [torch.randperm(E, generator=g) for _ in range(L)]
+    cur = torch.randint(0, E, (T * K,), generator=g)
+    trace = []
+    for s in range(steps):
+        for l in range(L):
+            if s or l:
+                follow = torch.rand(T * K, generator=g) < p
+                cur = torch.where(follow, perms[(l - 1) % L][cur], torch.randint(0, E, (T * K,), generator=g))
+            weights = torch.softmax(torch.rand(T, K, generator=g), dim=-1)
+            trace.append((cur.view(T, K).to(torch.int32).clone(), weights))
+    return trace
+
+
+class TestExpertCache(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.L, self.E, self.T, self.K, self.B = 6, 32, 2, 2, 1024
+        self.host = torch.randint(0, 256, (self.L, self.E, self.B), dtype=torch.uint8)
+        self.trace = markov_trace(self.L, self.E, self.T, self.K, steps=50, p=0.9)
+
+    def replay(self, slots, check=True, **kwargs):
+        pool = torch.zeros(slots, self.B, dtype=torch.uint8)
+        cache = ExpertCache(self.host, pool, **kwargs)
+        for i, (ids, weights) in enumerate(self.trace):
+            layer = i % self.L
+            residency = cache.access(layer, ids, weights)
+            if not check:
+                continue
+            for e in range(self.E):
+                slot = int(residency[e])
+                if slot >= 0:
+                    self.assertTrue(torch.equal(pool[slot], self.host[layer, e]))
+                    self.assertEqual(cache.slot(layer, e), slot)
+            if kwargs.get("fetch_misses", True) and slots >= self.E:
+                self.assertTrue(bool((residency[ids.flatten().long()] >= 0).all()))
+        cache.synchronize()
+        return cache.stats()
+
+    def test_resident_slots_hold_the_expert(self):
+        for eviction in (ExpertCache.LRU, ExpertCache.LFU):
+            with self.subTest(eviction=eviction):
+                stats = self.replay(24, eviction=eviction)
+                routed = sum(int(ids.unique().numel()) for ids, _ in self.trace)
+                self.assertEqual(stats["hits"] + stats["misses"], routed)
+                self.assertEqual(stats["bytes_copied"], (stats["misses"] + stats["prefetches"]) * self.B)
+                self.assertLessEqual(stats["useful_prefetches"], stats["prefetches"])
+
+    def test_predictor_beats_no_prefetch(self):
+        for eviction in (ExpertCache.LRU, ExpertCache.LFU):
+            with self.subTest(eviction=eviction):
+                base = self.replay(24, check=False, eviction=eviction, prefetch_per_layer=0)
+                pred = self.replay(24, check=False, eviction=eviction, prefetch_per_layer=4)
+                self.assertEqual(base["prefetches"], 0)
+                self.assertGreater(pred["hit_rate"], base["hit_rate"] + 0.2)
+                self.assertGreater(pred["prefetch_accuracy"], 0.4)
+
+    def test_everything_fits(self):
+        stats = self.replay(self.L * self.E, prefetch_per_layer=0)
+        self.assertEqual(stats["evictions"], 0)
+        self.assertLessEqual(stats["misses"], self.L * self.E)
+
+    def test_background_misses(self):
+        stats = self.replay(24, fetch_misses=False)
+        # neither misses nor prefetches still copying are waited for
+        self.assertEqual(stats["stall_seconds"], 0.0)
+
+    def test_lru_keeps_the_current_layer(self):
+        host = torch.randint(0, 256, (2, 4, 8), dtype=torch.uint8)
+        cache = ExpertCache(host, torch.zeros(2, 8, dtype=torch.uint8), prefetch_per_layer=0)
+        one = torch.ones(1, 1)
+
+        def access(layer, e):
+            return cache.access(layer, torch.tensor([[e]], dtype=torch.int32), one)
+
+        access(0, 0)
+        access(1, 0)
+        access(0, 1)
+        # the least recently used expert was the one of layer 1, the expert of layer 0 stays for this layer
+        self.assertGreaterEqual(cache.slot(0, 0), 0)
+        self.assertGreaterEqual(cache.slot(0, 1), 0)
+        self.assertEqual(cache.slot(1, 0), -1)
+        self.assertEqual(cache.stats()["evictions"], 1)
+        cache.reset_stats()
+        self.assertEqual(cache.stats()["evictions"], 0)
+        # both slots hold experts of the current layer, nothing can be prefetched
+        self.assertEqual(cache.prefetch(1, [2]), 0)
+        access(1, 2)
+        self.assertEqual(cache.prefetch(0, [3]), 1)
+        with self.assertRaises(ValueError):
+            access(0, 9)
+
+
+if __name__ == "__main__":
+    unittest.main()
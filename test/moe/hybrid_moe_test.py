@@ -0,0 +1,118 @@
+import unittest
+import torch
+from lightllm_kernel.ops import HybridMoeScheduler, hybrid_moe_partition, moe_cpu_experts
+from test.utils import error
+
+
+def quantize_weight(w, dtype):
+    """[N, K] fp32 -> column major [K, N] int8 / fp8 and fp32 [N] per channel scales"""
+    amax = w.abs().amax(dim=1).clamp(min=1e-6)
+    if dtype == torch.int8:
+        scales = amax / 127
+        q = torch.round(w / scales[:, None]).to(torch.int8)
+    else:
+        scales = amax / 448
+        q = (w / scales[:, None]).to(dtype)
+    return q.t(), scales
+
+
+def torch_expert(x, w13, w13_scales, w2, w2_scales):
+    gu = x.float() @ (w13.float() * w13_scales[None, :])
+    g, u = gu.chunk(2, dim=-1)
+    return (torch.nn.functional.silu(g) * u) @ (w2.float() * w2_scales[None, :])
+
+
+def torch_moe(x, topk_ids, topk_weights, experts, only=None):
+    y = torch.zeros(x.shape, dtype=torch.float32)
+    for t in range(x.shape[0]):
+        for k in range(topk_ids.shape[1]):
+            e = int(topk_ids[t, k])
+            if only is None or e in only:
+                y[t] += topk_weights[t, k] * torch_expert(x[t : t + 1], *experts[e])[0]
+    return y
+
+
+class TestHybridMoe(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        torch.manual_seed(0)
+        self.E, self.K, self.H, self.I = 8, 2, 256, 128
+
+    def make_experts(self, dtype):
+        experts = []
+        for _ in range(self.E):
+            w13, w13_scales = quantize_weight(torch.randn(2 * self.I, self.H) / self.H**0.5, dtype)
+            w2, w2_scales = quantize_weight(torch.randn(self.H, self.I) / self.I**0.5, dtype)
+            experts.append((w13, w13_scales, w2, w2_scales))
+        return experts
+
+    def make_routing(self, T):
+        scores = torch.rand(T, self.E)
+        topk_weights, topk_ids = scores.topk(self.K, dim=-1)
+        return topk_weights / topk_weights.sum(-1, keepdim=True), topk_ids.to(torch.int32)
+
+    def test_partition(self):
+        """Every (token, k) goes to its device slot or to the rows of its CPU expert, in token order."""
+        topk_weights, topk_ids = self.make_routing(37)
+        residency = torch.tensor([0, -1, 1, -1, -1, 2, 3, -1], dtype=torch.int32)
+        device_ids, device_weights, offsets, tokens, weights = hybrid_moe_partition(topk_ids, topk_weights, residency)
+        slots = residency[topk_ids.long()]
+        self.assertTrue(torch.equal(device_ids, slots))
+        self.assertTrue(torch.equal(device_weights, torch.where(slots >= 0, topk_weights, 0)))
+        self.assertEqual(int(offsets[-1]), int((slots < 0).sum()))
+        for e in range(self.E):
+            rows = slice(int(offsets[e]), int(offsets[e + 1]))
+            t, k = (topk_ids == e).nonzero(as_tuple=True)
+            if residency[e] >= 0:
+                self.assertEqual(rows.start, rows.stop)
+                continue
+            self.assertTrue(torch.equal(tokens[rows], t.to(torch.int32)))
+            self.assertTrue(torch.equal(weights[rows], topk_weights[t, k]))
+
+    def test_cpu_experts(self):
+        """moe_cpu_experts matches the weighted SiLU FFNs of the CPU experts."""
+        for dtype in [torch.int8, torch.float8_e4m3fn]:
+            for T in [1, 5, 64]:
+                with self.subTest(dtype=dtype, T=T):
+                    experts = self.make_experts(dtype)
+                    x = torch.randn(T, self.H, dtype=torch.bfloat16)
+                    topk_weights, topk_ids = self.make_routing(T)
+                    residency = torch.tensor([-1, 0, -1, 1, -1, -1, 2, -1], dtype=torch.int32)
+                    _, _, offsets, tokens, weights = hybrid_moe_partition(topk_ids, topk_weights, residency)
+                    out = torch.empty(T, self.H)
+                    moe_cpu_experts(out, x, offsets, tokens, weights, *zip(*experts))
+                    cpu = {e for e in range(self.E) if residency[e] < 0}
+                    y_real = torch_moe(x, topk_ids, topk_weights, experts, only=cpu)
+                    self.assertTrue(error(out, y_real) < 0.01)
+
+    def test_scheduler(self):
+        """Device and CPU experts together give the full MoE for any residency map."""
+        experts = self.make_experts(torch.int8)
+        x = torch.randn(16, self.H, dtype=torch.bfloat16)
+        topk_weights, topk_ids = self.make_routing(16)
+        y_real = torch_moe(x, topk_ids, topk_weights, experts)
+        for name, resident in [("device", range(8)), ("cpu", []), ("mixed", [0, 2, 3, 7])]:
+            with self.subTest(residency=name):
+                residency = torch.full((self.E,), -1, dtype=torch.int32)
+                for slot, e in enumerate(resident):
+                    residency[e] = slot
+                device_slots = list(resident)
+
+                def device_experts(x, device_ids, device_weights):
+                    # stands in for the fused device MoE over the resident slots
+                    y = torch.zeros(x.shape, dtype=torch.float32)
+                    for t in range(x.shape[0]):
+                        for k in range(device_ids.shape[1]):
+                            slot = int(device_ids[t, k])
+                            if slot >= 0:
+                                expert = experts[device_slots[slot]]
+                                y[t] += device_weights[t, k] * torch_expert(x[t : t + 1], *expert)[0]
+                    return y
+
+                scheduler = HybridMoeScheduler(residency, *zip(*experts))
+                y = scheduler.forward(x, topk_weights, topk_ids, device_experts)
+                self.assertTrue(error(y, y_real) < 0.01)
+
+
+if __name__ == "__main__":
+    unittest.main()
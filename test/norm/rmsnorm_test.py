@@ -1,6 +1,6 @@
 import unittest
 import torch
-from lightllm_kernel.ops import rmsnorm_bf16
+from lightllm_kernel.ops import rmsnorm_bf16, make_rmsnorm_plan
 from test.utils import benchmark, error
 
 
@@ -28,6 +28,55 @@ class TestRmsNormBF16(unittest.TestCase):
                     )
                     print(f"{error(y_pred, y_real) = }")
 
+    def test_accuracy_cpu(self):
+        """Test the accuracy of the CPU kernel of the core library against torch.rmsnorm."""
+        for batch in [1, 37]:
+            for size in self.sizes:
+                with self.subTest(shape=[batch, size]):
+                    X = torch.rand(size=[batch, size], dtype=self.dtype) - 0.5
+                    W = torch.rand(size=[size], dtype=self.dtype) - 0.5
+
+                    y_real = torch.nn.functional.rms_norm(X, (size,), W)
+                    y_pred = rmsnorm_bf16(X, W)
+                    self.assertTrue(
+                        error(y_pred, y_real) < 0.01,
+                        f"Accuracy test failed for size {batch}, {size}. y_real={y_real}, y_pred={y_pred}",
+                    )
+
+    def test_plan(self):
+        """Test that a cached plan gives the same result as the checked entry point."""
+        for device in [self.device, "cpu"]:
+            for batch in [1, 37]:
+                for size in self.sizes:
+                    with self.subTest(shape=[batch, size], device=device):
+                        X = torch.rand(size=[batch, size], device=device, dtype=self.dtype) - 0.5
+                        W = torch.rand(size=[size], device=device, dtype=self.dtype) - 0.5
+                        Y = torch.empty_like(X)
+
+                        plan = make_rmsnorm_plan(X.shape, X.dtype, X.stride(), X.device, 1e-6)
+                        # plans are cached by layout, a second plan shares the same launch
+                        self.assertEqual(plan._plan, make_rmsnorm_plan(X.shape, X.dtype, None, X.device, 1e-6)._plan)
+                        plan.run(X, W, Y)
+                        y_real = rmsnorm_bf16(X, W, 1e-6)
+                        self.assertTrue(torch.equal(Y, y_real), f"Plan mismatch for size {batch}, {size}.")
+
+    def test_plan_rows(self):
+        """Test that one plan serves every number of rows, none included."""
+        for device in [self.device, "cpu"]:
+            with self.subTest(device=device):
+                size = self.sizes[0]
+                plan = make_rmsnorm_plan([1, size], self.dtype, None, device, 1e-6)
+                # the plan cache is keyed on the row layout, not on the token count
+                self.assertEqual(plan._plan, make_rmsnorm_plan([1000, size], self.dtype, None, device, 1e-6)._plan)
+                W = torch.rand(size=[size], device=device, dtype=self.dtype) - 0.5
+                for batch in [3, 129]:
+                    X = torch.rand(size=[batch, size], device=device, dtype=self.dtype) - 0.5
+                    Y = plan.run(X, W, torch.empty_like(X))
+                    self.assertTrue(torch.equal(Y, rmsnorm_bf16(X, W, 1e-6)), f"Plan mismatch for {batch} rows.")
+                # no rows launches nothing
+                X = torch.empty(size=[0, size], device=device, dtype=self.dtype)
+                plan.run(X, W, torch.empty_like(X))
+
     def test_performance(self):
         """Test the performance of rmsnorm using benchmark."""
         for batch in self.batchs:
@@ -0,0 +1,125 @@
+import json
+import os
+import struct
+import tempfile
+import unittest
+import torch
+from lightllm_kernel.ops import (
+    SafetensorsFile,
+    cutlass_scaled_mm_bias_ls,
+    load_quantized_weights,
+    quantize_weight_per_channel,
+)
+from test.utils import error
+
+ST_DTYPES = {torch.bfloat16: "BF16", torch.float16: "F16", torch.float32: "F32", torch.int64: "I64"}
+
+
+def write_safetensors(path, tensors, metadata=None):
+    """Minimal safetensors writer, so the test does not need the safetensors package"""
+    header = {"__metadata__": metadata} if metadata else {}
+    blobs, offset = [], 0
+    for name, t in tensors.items():
+        data = t.contiguous().view(torch.uint8).numpy().tobytes()
+        header[name] = {
+            "dtype": ST_DTYPES[t.dtype],
+            "shape": list(t.shape),
+            "data_offsets": [offset, offset + len(data)],
+        }
+        blobs.append(data)
+        offset += len(data)
+    raw = json.dumps(header).encode()
+    raw += b" " * (-len(raw) % 8)
+    with open(path, "wb") as f:
+        f.write(struct.pack("<Q", len(raw)) + raw + b"".join(blobs))
+
+
+def torch_quantize(w, dtype):
+    amax = w.float().abs().amax(dim=1, keepdim=True)
+    if dtype == torch.int8:
+        scales = amax / 127
+        return torch.round(w.float() / scales.clamp(min=1e-12)).to(torch.int8), scales
+    scales = amax / 448
+    return (w.float() / (scales + 1e-7)).to(dtype), scales
+
+
+class TestWeightLoader(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        torch.manual_seed(0)
+        self.dir = tempfile.TemporaryDirectory()
+        self.tensors = [
+            {
+                "model.layers.0.mlp.down_proj.weight": torch.randn(256, 512, dtype=torch.bfloat16),
+                "model.layers.0.input_layernorm.weight": torch.randn(512, dtype=torch.bfloat16),
+                "model.layers.0.self_attn.o_proj.weight": torch.randn(100, 300, dtype=torch.float16) * 3,
+            },
+            {
+                "model.layers.1.mlp.down_proj.weight": torch.randn(64, 4096, dtype=torch.float32),
+                "model.layers.1.rotary.inv_freq": torch.arange(16, dtype=torch.int64),
+            },
+        ]
+        self.paths = []
+        for i, shard in enumerate(self.tensors):
+            self.paths.append(os.path.join(self.dir.name, f"model-{i:05d}.safetensors"))
+            write_safetensors(self.paths[-1], shard, {"format": "pt"} if i == 0 else None)
+
+    def tearDown(self):
+        self.dir.cleanup()
+
+    def test_safetensors_file(self):
+        f = SafetensorsFile(self.paths[0])
+        self.assertEqual(f.metadata(), {"format": "pt"})
+        self.assertEqual(sorted(f.keys()), sorted(self.tensors[0]))
+        for name, t in self.tensors[0].items():
+            self.assertIn(name, f)
+            self.assertTrue(torch.equal(f.get_tensor(name), t))
+        with self.assertRaises(RuntimeError):
+            f.get_tensor("missing")
+
+    def test_quantize_weight_per_channel(self):
+        for dtype in (torch.float8_e4m3fn, torch.int8):
+            for w in (torch.randn(33, 1000, dtype=torch.bfloat16), torch.randn(8, 7, dtype=torch.float32)):
+                with self.subTest(dtype=dtype, shape=tuple(w.shape)):
+                    q, scales = quantize_weight_per_channel(w, dtype)
+                    self.assertEqual(q.shape, (w.shape[1], w.shape[0]))
+                    self.assertEqual(q.stride(0), 1)
+                    q_ref, scales_ref = torch_quantize(w, dtype)
+                    self.assertTrue(torch.allclose(scales, scales_ref, rtol=1e-6))
+                    if dtype == torch.int8:
+                        self.assertLessEqual((q.t().int() - q_ref.int()).abs().max().item(), 1)
+                    self.assertLess(error(q.t().float() * scales, w.float()), 0.05)
+
+    def test_load_quantized_weights(self):
+        for dtype in (torch.float8_e4m3fn, torch.int8):
+            for io_threads in (0, 3):
+                with self.subTest(dtype=dtype, io_threads=io_threads):
+                    tensors, stats = load_quantized_weights(
+                        self.paths, dtype=dtype, io_threads=io_threads, readahead_bytes=64 << 10
+                    )
+                    expected = {**self.tensors[0], **self.tensors[1]}
+                    self.assertEqual(set(tensors), set(expected))
+                    for name, t in expected.items():
+                        if t.dim() != 2:
+                            self.assertTrue(torch.equal(tensors[name], t))
+                            continue
+                        q, scales = tensors[name]
+                        self.assertEqual(q.dtype, dtype)
+                        self.assertEqual(scales.shape, (t.shape[0], 1))
+                        self.assertLess(error(q.t().float() * scales, t.float()), 0.05)
+                    quantized = sum(t.numel() * t.element_size() for t in expected.values() if t.dim() == 2)
+                    self.assertEqual(stats["bytes_read"], quantized)
+
+    def test_scaled_mm_layout(self):
+        """The quantized weights plug into cutlass_scaled_mm as they are"""
+        w = torch.randn(96, 128, dtype=torch.bfloat16)
+        x = torch.randn(5, 128, dtype=torch.bfloat16)
+        q, scales = quantize_weight_per_channel(w, torch.int8)
+        x_q, x_scales = torch_quantize(x, torch.int8)
+        y = torch.empty(5, 96, dtype=torch.bfloat16)
+        cutlass_scaled_mm_bias_ls(y, x_q, q, x_scales, scales, None, None)
+        self.assertLess(error(y.float(), x.float() @ w.float().t()), 0.05)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,80 @@
+import unittest
+import torch
+from lightllm_kernel.ops import logprobs_topn, logprobs_topn_partial, logprobs_topn_merge
+from test.utils import available_devices, benchmark, error
+
+
+def torch_logprobs_topn(logits, sampled_ids, topn):
+    logprobs = torch.log_softmax(logits.float(), dim=-1)
+    topn_logprobs, topn_ids = torch.topk(logprobs, topn, dim=-1)
+    sampled_logprobs = logprobs.gather(-1, sampled_ids.view(-1, 1)).view(-1)
+    return topn_logprobs, topn_ids, sampled_logprobs
+
+
+def sharded_logprobs_topn(logits, sampled_ids, topn, num_shards):
+    """Emulate a vocab parallel run: each shard computes its partial result, then all of them are merged."""
+    shard_size = (logits.shape[1] + num_shards - 1) // num_shards
+    partials = []
+    for s in range(num_shards):
+        shard = logits[:, s * shard_size : (s + 1) * shard_size]
+        partials.append(logprobs_topn_partial(shard, sampled_ids, topn, s * shard_size))
+    topn_vals, topn_ids, sampled_vals, stats = [torch.stack(t) for t in zip(*partials)]
+    return logprobs_topn_merge(topn_vals, topn_ids, sampled_vals, stats)
+
+
+class TestLogprobsTopN(unittest.TestCase):
+    def setUp(self):
+        """Set up common test parameters."""
+        self.batchs = [1, 7, 256]
+        self.vocabs = [32000, 151936, 152064, 1023]
+        self.topns = [0, 1, 5, 20]
+        self.shards = [2, 4, 8]
+        self.devices = available_devices()
+        self.dtypes = [torch.bfloat16, torch.float32]
+
+    def check(self, pred, real, shape):
+        topn_logprobs, topn_ids, sampled_logprobs = pred
+        real_logprobs, real_ids, real_sampled = real
+        self.assertTrue(
+            error(topn_logprobs, real_logprobs) < 1e-4,
+            f"Accuracy test failed for size {shape}. real={real_logprobs}, pred={topn_logprobs}",
+        )
+        # ties may be ordered differently, so compare the selected id sets
+        self.assertTrue(error(topn_ids.cpu().sort(-1)[0], real_ids.cpu().sort(-1)[0]) < 1e-4)
+        self.assertTrue(
+            error(sampled_logprobs, real_sampled) < 1e-4,
+            f"Accuracy test failed for size {shape}. real={real_sampled}, pred={sampled_logprobs}",
+        )
+
+    def test_accuracy(self):
+        """Test the accuracy of logprobs_topn against torch.log_softmax + torch.topk."""
+        for device in self.devices:
+            for dtype in self.dtypes:
+                for batch in self.batchs:
+                    for vocab in self.vocabs:
+                        for topn in self.topns:
+                            with self.subTest(shape=[batch, vocab, topn], device=device, dtype=dtype):
+                                logits = torch.randn(size=[batch, vocab], device=device, dtype=dtype) * 4
+                                sampled_ids = torch.randint(0, vocab, (batch,), device=device, dtype=torch.int64)
+                                real = torch_logprobs_topn(logits, sampled_ids, topn)
+                                self.check(logprobs_topn(logits, sampled_ids, topn), real, [batch, vocab, topn])
+                                for num_shards in self.shards:
+                                    pred = sharded_logprobs_topn(logits, sampled_ids, topn, num_shards)
+                                    self.check(pred, real, [batch, vocab, topn, num_shards])
+
+    @unittest.skipIf(not torch.cuda.is_available(), "needs CUDA")
+    def test_performance(self):
+        """Test the performance of logprobs_topn using benchmark."""
+        for batch in self.batchs:
+            for vocab in self.vocabs:
+                with self.subTest(shape=[batch, vocab]):
+                    logits = torch.randn(size=[batch, vocab], device="cuda", dtype=torch.float32)
+                    sampled_ids = torch.randint(0, vocab, (batch,), device="cuda", dtype=torch.int64)
+                    shape = [[batch, vocab], [batch]]
+                    tflops = 0.0
+                    benchmark(logprobs_topn, shape, tflops, 100, logits, sampled_ids, 20)
+                    benchmark(torch_logprobs_topn, shape, tflops, 100, logits, sampled_ids, 20)
+
+
+if __name__ == "__main__":
+    unittest.main()
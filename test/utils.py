@@ -1,6 +1,7 @@
 import torch
 from typing import Callable
 from typing import List
+from typing import Optional
 
 
 def error(y_pred: torch.Tensor, y_real: torch.Tensor) -> torch.Tensor:
@@ -42,6 +43,79 @@ def error(y_pred: torch.Tensor, y_real: torch.Tensor) -> torch.Tensor:
     return snr.item()
 
 
+def available_devices() -> List[str]:
+    """Devices of the tests that cover both backends: CUDA when there is a GPU, and the CPU."""
+    return (["cuda"] if torch.cuda.is_available() else []) + ["cpu"]
+
+
+def quantize_group8(x: torch.Tensor):
+    """int8 values with one absmax / 127 scale (dtype of x) per 8 elements, the int8 KV cache format."""
+    groups = x.float().view(*x.shape[:-1], -1, 8)
+    scale = groups.abs().amax(-1, keepdim=True).clamp(min=1e-6) / 127
+    x8 = (groups / scale).round().clamp(-127, 127).to(torch.int8).view(x.shape)
+    return x8, scale.squeeze(-1).to(x.dtype)
+
+
+def quantize_fp8_group8(x: torch.Tensor):
+    """fp8_e4m3 values with one absmax / 448 scale per 8 elements, the fp8 KV cache format."""
+    groups = x.float().view(*x.shape[:-1], -1, 8)
+    scale = groups.abs().amax(-1, keepdim=True).clamp(min=1e-6) / 448
+    x8 = (groups / scale).to(torch.float8_e4m3fn).view(x.shape)
+    return x8, scale.squeeze(-1).to(x.dtype)
+
+
+def dequantize(k: torch.Tensor, k_s: Optional[torch.Tensor]) -> torch.Tensor:
+    """fp32 values of a KV cache with group-8 scales k_s, or of an unquantized one (k_s None)."""
+    if k_s is None:
+        return k.float()
+    return (k.float().view(*k.shape[:-1], -1, 8) * k_s.float().unsqueeze(-1)).view(k.shape)
+
+
+def make_kv_cache(num_slots: int, kv_heads: int, head_dim: int, device, dtype, kv_format: str = "int8"):
+    """Random k, k_s, v, v_s of num_slots slots; kv_format is "int8", "fp8" or "half" (scales None)."""
+    k = torch.randn((num_slots, kv_heads, head_dim), dtype=dtype, device=device)
+    v = torch.randn((num_slots, kv_heads, head_dim), dtype=dtype, device=device)
+    if kv_format == "half":
+        return k, None, v, None
+    quantize = quantize_group8 if kv_format == "int8" else quantize_fp8_group8
+    (k, k_s), (v, v_s) = quantize(k), quantize(v)
+    return k, k_s, v, v_s
+
+
+def make_requests(seq_lens: List[int], device):
+    """req_to_tokens, b_req_idx, b_seq_len of a batch: requests own shuffled slots of a cache of
+    len(seq_lens) * max(seq_lens) slots, and their rows (with seq_lens) are listed in reverse."""
+    B, max_len = len(seq_lens), max(seq_lens)
+    req_to_tokens = torch.randperm(B * max_len, device=device).to(torch.int32).view(B, max_len)
+    b_req_idx = torch.arange(B - 1, -1, -1, dtype=torch.int32, device=device)
+    b_seq_len = torch.tensor(seq_lens[::-1], dtype=torch.int32, device=device)
+    return req_to_tokens, b_req_idx, b_seq_len
+
+
+def make_decode_inputs(seq_lens: List[int], heads: int, kv_heads: int, head_dim: int, device, dtype,
+                       kv_format: str = "int8"):
+    """q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len of one decode step, see make_kv_cache and
+    make_requests."""
+    q = torch.randn((len(seq_lens), heads, head_dim), dtype=dtype, device=device)
+    kv = make_kv_cache(len(seq_lens) * max(seq_lens), kv_heads, head_dim, device, dtype, kv_format)
+    return (q,) + kv + make_requests(seq_lens, device)
+
+
+def torch_decode_attention(q, k, k_s, v, v_s, req_to_tokens, b_req_idx, b_seq_len):
+    """fp32 reference of decode attention over any KV cache format of make_kv_cache."""
+    B, H, D = q.shape
+    group = H // k.shape[1]
+    out = torch.empty_like(q)
+    k_f, v_f = dequantize(k, k_s), dequantize(v, v_s)
+    for b in range(B):
+        slots = req_to_tokens[b_req_idx[b], : b_seq_len[b]].long()
+        ks = k_f[slots].repeat_interleave(group, dim=1)  # [L, H, D]
+        vs = v_f[slots].repeat_interleave(group, dim=1)
+        att = torch.einsum("hd,lhd->hl", q[b].float(), ks) / D**0.5
+        out[b] = torch.einsum("hl,lhd->hd", att.softmax(-1), vs).to(q.dtype)
+    return out
+
+
 def benchmark(func: Callable, shape: List[int], tflops: float, steps: int, *args, **kwargs):
     """
     A decorator function to assist in performance testing of CUDA operations.